@@ -301,6 +301,51 @@ static inline void ioport_set_port_level(ioport_port_t port,
 	arch_ioport_set_port_level(port, mask, level);
 }
 
+#if SAM && !SAM4L
+/**
+ * \brief Drive a group of IOPORT output pins in a single port to the levels
+ * given by a value, with one register write for the pins going high and one
+ * for the pins going low.
+ *
+ * \param port IOPORT port to write to
+ * \param mask Pin mask of pins to modify
+ * \param value Levels of the pins, one bit per pin
+ */
+static inline void ioport_write_port(ioport_port_t port,
+		ioport_port_mask_t mask, ioport_port_mask_t value)
+{
+	arch_ioport_write_port(port, mask, value);
+}
+
+/**
+ * \brief Configure the pins of a port from a register image, one register
+ * write per property instead of one call per pin.
+ *
+ * \param port IOPORT port to configure
+ * \param cfg Register image, see IOPORT_MAP_PORT_CONFIG()
+ */
+static inline void ioport_configure_port(ioport_port_t port,
+		const struct ioport_port_config *cfg)
+{
+	arch_ioport_configure_port(port, cfg);
+}
+
+/**
+ * \brief Configure the pins of a port still at its reset state from a
+ * register image, see ioport_configure_port().
+ *
+ * The properties the image leaves at their reset value are not written.
+ *
+ * \param port IOPORT port to configure
+ * \param cfg Register image, see IOPORT_MAP_PORT_CONFIG()
+ */
+static inline void ioport_configure_port_from_reset(ioport_port_t port,
+		const struct ioport_port_config *cfg)
+{
+	arch_ioport_configure_port_from_reset(port, cfg);
+}
+#endif
+
 /**
  * \brief Get current value of an IOPORT pin, which has been configured as an
  * input.
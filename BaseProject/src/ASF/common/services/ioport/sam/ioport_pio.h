@@ -380,4 +380,217 @@ __always_inline static void arch_ioport_set_pin_sense_mode(ioport_pin_t pin,
 			arch_ioport_pin_to_mask(pin), pin_sense);
 }
 
+__always_inline static void arch_ioport_write_port(ioport_port_t port,
+		ioport_port_mask_t mask, ioport_port_mask_t value)
+{
+	Pio *base = arch_ioport_port_to_base(port);
+
+	base->PIO_SODR = mask & value;
+	base->PIO_CODR = mask & ~value;
+}
+
+/**
+ * \brief Register image of a whole PIO controller.
+ *
+ * Each field is the mask of the pins that get the property, the pins of
+ * \a pins that are not in the mask get the opposite one. Build it with
+ * IOPORT_MAP_PORT_CONFIG() so that all masks are compile time constants.
+ */
+struct ioport_port_config {
+	ioport_port_mask_t pins;       /*!< Pins owned by this configuration */
+	ioport_port_mask_t gpio;       /*!< PIO controlled, others peripheral */
+	ioport_port_mask_t output;     /*!< Outputs, among the gpio pins */
+	ioport_port_mask_t high;       /*!< Driven high, among the outputs */
+	ioport_port_mask_t pullup;
+	ioport_port_mask_t pulldown;
+	ioport_port_mask_t open_drain;
+	ioport_port_mask_t filter;     /*!< Glitch or debounce filter */
+	ioport_port_mask_t debounce;
+	ioport_port_mask_t mux0;       /*!< ABCDSR[0] */
+	ioport_port_mask_t mux1;       /*!< ABCDSR[1] */
+	ioport_port_mask_t sense;      /*!< Additional interrupt mode enabled */
+	ioport_port_mask_t level;      /*!< Level sense, else edge */
+	ioport_port_mask_t rise_high;  /*!< Rising edge or high level */
+};
+
+/**
+ * \brief Apply a register image to a PIO controller, one write per register.
+ *
+ * The level and direction are set before the pins are handed to the PIO so
+ * that outputs come up at their initial level. Writes whose mask is empty are
+ * skipped; with a constant image they are removed at compile time.
+ *
+ * With \a from_reset, the writes that would only restore the reset value of
+ * a property are skipped too: the pull-down, open drain, filters, output
+ * disable, edge and falling edge selections, additional interrupt modes and
+ * peripheral A selection. The pull-ups are enabled at reset, so their
+ * disable is always written.
+ */
+__always_inline static void arch_ioport_apply_port(ioport_port_t port,
+		const struct ioport_port_config *cfg, const bool from_reset)
+{
+	Pio *base = arch_ioport_port_to_base(port);
+	const ioport_port_mask_t pins = cfg->pins;
+	const ioport_port_mask_t gpio = cfg->gpio;
+	const ioport_port_mask_t sense = cfg->sense;
+
+#define IOPORT_WRITE_MASK(reg, mask) \
+	do { if (mask) { base->reg = (mask); } } while (0)
+#define IOPORT_WRITE_DEFAULT(reg, mask) \
+	do { if (!from_reset) { IOPORT_WRITE_MASK(reg, mask); } } while (0)
+
+	if (!pins) {
+		return;
+	}
+
+	IOPORT_WRITE_MASK(PIO_PUER, cfg->pullup);
+	IOPORT_WRITE_MASK(PIO_PUDR, pins & ~cfg->pullup);
+#if defined(IOPORT_MODE_PULLDOWN)
+	IOPORT_WRITE_MASK(PIO_PPDER, cfg->pulldown);
+	IOPORT_WRITE_DEFAULT(PIO_PPDDR, pins & ~cfg->pulldown);
+#endif
+	IOPORT_WRITE_MASK(PIO_MDER, cfg->open_drain);
+	IOPORT_WRITE_DEFAULT(PIO_MDDR, pins & ~cfg->open_drain);
+	IOPORT_WRITE_MASK(PIO_IFER, cfg->filter);
+	IOPORT_WRITE_DEFAULT(PIO_IFDR, pins & ~cfg->filter);
+	IOPORT_WRITE_MASK(PIO_IFSCER, cfg->debounce);
+	IOPORT_WRITE_DEFAULT(PIO_IFSCDR, pins & ~cfg->debounce);
+	if (!from_reset) {
+		base->PIO_ABCDSR[0] = (base->PIO_ABCDSR[0] & ~pins) | cfg->mux0;
+		base->PIO_ABCDSR[1] = (base->PIO_ABCDSR[1] & ~pins) | cfg->mux1;
+	} else {
+		if (cfg->mux0) {
+			base->PIO_ABCDSR[0] |= cfg->mux0;
+		}
+		if (cfg->mux1) {
+			base->PIO_ABCDSR[1] |= cfg->mux1;
+		}
+	}
+
+	IOPORT_WRITE_MASK(PIO_SODR, cfg->high);
+	IOPORT_WRITE_MASK(PIO_CODR, cfg->output & ~cfg->high);
+	IOPORT_WRITE_MASK(PIO_OER, cfg->output);
+	IOPORT_WRITE_DEFAULT(PIO_ODR, gpio & ~cfg->output);
+	IOPORT_WRITE_MASK(PIO_OWER, gpio);
+
+	IOPORT_WRITE_MASK(PIO_LSR, cfg->level);
+	IOPORT_WRITE_DEFAULT(PIO_ESR, sense & ~cfg->level);
+	IOPORT_WRITE_MASK(PIO_REHLSR, cfg->rise_high);
+	IOPORT_WRITE_DEFAULT(PIO_FELLSR, sense & ~cfg->rise_high);
+	IOPORT_WRITE_MASK(PIO_AIMER, sense);
+	IOPORT_WRITE_DEFAULT(PIO_AIMDR, pins & ~sense);
+
+	IOPORT_WRITE_MASK(PIO_PER, gpio);
+	IOPORT_WRITE_MASK(PIO_PDR, pins & ~gpio);
+
+#undef IOPORT_WRITE_DEFAULT
+#undef IOPORT_WRITE_MASK
+}
+
+__always_inline static void arch_ioport_configure_port(ioport_port_t port,
+		const struct ioport_port_config *cfg)
+{
+	arch_ioport_apply_port(port, cfg, false);
+}
+
+__always_inline static void arch_ioport_configure_port_from_reset(
+		ioport_port_t port, const struct ioport_port_config *cfg)
+{
+	arch_ioport_apply_port(port, cfg, true);
+}
+
+/**
+ * \name Compile time pin maps
+ *
+ * A pin map is an X-macro listing the pins of a board:
+ * \code
+	#define BOARD_PIN_MAP(X, arg) \
+		X(arg, LED0_GPIO, IOPORT_MAP_OUTPUT(LED0_INACTIVE_LEVEL), 0) \
+		X(arg, USART1_RXD_GPIO, IOPORT_MAP_PERIPH, USART1_RXD_FLAGS)
+\endcode
+ * Each entry gives the pin, its IOPORT_MAP_* type, optionally or'ed with
+ * IOPORT_MAP_SENSE(), and its IOPORT_MODE_* flags. IOPORT_MAP_PORT_CONFIG()
+ * folds the entries of one controller into a struct ioport_port_config made
+ * of constant masks.
+ * @{
+ */
+#define IOPORT_MAP_GPIO          (1u << 0)
+#define IOPORT_MAP_DIR_OUTPUT    (1u << 1)
+#define IOPORT_MAP_LEVEL_HIGH    (1u << 2)
+#define IOPORT_MAP_SENSE_Pos     4
+
+/** Pin handed to the peripheral selected by its IOPORT_MODE_MUX_* flag. */
+#define IOPORT_MAP_PERIPH        0
+/** PIO controlled input. */
+#define IOPORT_MAP_INPUT         IOPORT_MAP_GPIO
+/** PIO controlled output, driven at \a level (enum ioport_value). */
+#define IOPORT_MAP_OUTPUT(level) \
+	(IOPORT_MAP_GPIO | IOPORT_MAP_DIR_OUTPUT | \
+	((level) ? IOPORT_MAP_LEVEL_HIGH : 0))
+/** Interrupt sense of an input (enum ioport_sense). */
+#define IOPORT_MAP_SENSE(sense)  (((sense) + 1u) << IOPORT_MAP_SENSE_Pos)
+
+#define IOPORT_MAP_SENSE_IS_(type, sense) \
+	(((type) >> IOPORT_MAP_SENSE_Pos) == (sense) + 1u)
+
+#define IOPORT_MAP_BIT_(port, pin, cond) \
+	((((pin) >> 5) == (port) && (cond)) ? (1u << ((pin) & 0x1F)) : 0u)
+
+#define IOPORT_MAP_PINS_(port, pin, type, mode) \
+	| IOPORT_MAP_BIT_(port, pin, 1)
+#define IOPORT_MAP_GPIO_(port, pin, type, mode) \
+	| IOPORT_MAP_BIT_(port, pin, (type) & IOPORT_MAP_GPIO)
+#define IOPORT_MAP_OUTPUT_(port, pin, type, mode) \
+	| IOPORT_MAP_BIT_(port, pin, (type) & IOPORT_MAP_DIR_OUTPUT)
+#define IOPORT_MAP_HIGH_(port, pin, type, mode) \
+	| IOPORT_MAP_BIT_(port, pin, ((type) & IOPORT_MAP_DIR_OUTPUT) && \
+			((type) & IOPORT_MAP_LEVEL_HIGH))
+#define IOPORT_MAP_MODE_(port, pin, type, mode, flag) \
+	| IOPORT_MAP_BIT_(port, pin, (mode) & (flag))
+#define IOPORT_MAP_PULLUP_(port, pin, type, mode) \
+	IOPORT_MAP_MODE_(port, pin, type, mode, IOPORT_MODE_PULLUP)
+#define IOPORT_MAP_PULLDOWN_(port, pin, type, mode) \
+	IOPORT_MAP_MODE_(port, pin, type, mode, IOPORT_MODE_PULLDOWN)
+#define IOPORT_MAP_OPEN_DRAIN_(port, pin, type, mode) \
+	IOPORT_MAP_MODE_(port, pin, type, mode, IOPORT_MODE_OPEN_DRAIN)
+#define IOPORT_MAP_FILTER_(port, pin, type, mode) \
+	IOPORT_MAP_MODE_(port, pin, type, mode, \
+			IOPORT_MODE_GLITCH_FILTER | IOPORT_MODE_DEBOUNCE)
+#define IOPORT_MAP_DEBOUNCE_(port, pin, type, mode) \
+	IOPORT_MAP_MODE_(port, pin, type, mode, IOPORT_MODE_DEBOUNCE)
+#define IOPORT_MAP_MUX0_(port, pin, type, mode) \
+	IOPORT_MAP_MODE_(port, pin, type, mode, IOPORT_MODE_MUX_BIT0)
+#define IOPORT_MAP_MUX1_(port, pin, type, mode) \
+	IOPORT_MAP_MODE_(port, pin, type, mode, IOPORT_MODE_MUX_BIT1)
+#define IOPORT_MAP_SENSE_(port, pin, type, mode) \
+	| IOPORT_MAP_BIT_(port, pin, ((type) >> IOPORT_MAP_SENSE_Pos) && \
+			!IOPORT_MAP_SENSE_IS_(type, IOPORT_SENSE_BOTHEDGES))
+#define IOPORT_MAP_LEVEL_(port, pin, type, mode) \
+	| IOPORT_MAP_BIT_(port, pin, \
+			IOPORT_MAP_SENSE_IS_(type, IOPORT_SENSE_LEVEL_LOW) || \
+			IOPORT_MAP_SENSE_IS_(type, IOPORT_SENSE_LEVEL_HIGH))
+#define IOPORT_MAP_RISE_HIGH_(port, pin, type, mode) \
+	| IOPORT_MAP_BIT_(port, pin, \
+			IOPORT_MAP_SENSE_IS_(type, IOPORT_SENSE_RISING) || \
+			IOPORT_MAP_SENSE_IS_(type, IOPORT_SENSE_LEVEL_HIGH))
+
+/** Initializer of the struct ioport_port_config of \a port in \a map. */
+#define IOPORT_MAP_PORT_CONFIG(map, port) { \
+	.pins       = 0u map(IOPORT_MAP_PINS_, port), \
+	.gpio       = 0u map(IOPORT_MAP_GPIO_, port), \
+	.output     = 0u map(IOPORT_MAP_OUTPUT_, port), \
+	.high       = 0u map(IOPORT_MAP_HIGH_, port), \
+	.pullup     = 0u map(IOPORT_MAP_PULLUP_, port), \
+	.pulldown   = 0u map(IOPORT_MAP_PULLDOWN_, port), \
+	.open_drain = 0u map(IOPORT_MAP_OPEN_DRAIN_, port), \
+	.filter     = 0u map(IOPORT_MAP_FILTER_, port), \
+	.debounce   = 0u map(IOPORT_MAP_DEBOUNCE_, port), \
+	.mux0       = 0u map(IOPORT_MAP_MUX0_, port), \
+	.mux1       = 0u map(IOPORT_MAP_MUX1_, port), \
+	.sense      = 0u map(IOPORT_MAP_SENSE_, port), \
+	.level      = 0u map(IOPORT_MAP_LEVEL_, port), \
+	.rise_high  = 0u map(IOPORT_MAP_RISE_HIGH_, port), \
+}
+/** @} */
+
 #endif /* IOPORT_SAM_H */
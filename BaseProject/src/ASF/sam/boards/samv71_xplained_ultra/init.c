@@ -52,6 +52,13 @@
 #ifdef CONF_BOARD_CONFIG_MPU_AT_INIT
 #include "mpu.h"
 #endif
+#include "conf_tcm.h"
+
+/* The kernel placed in the TCMs runs from there once board_init() loads
+ * them. */
+#if CONF_TCM && !defined(CONF_BOARD_ENABLE_TCM_AT_INIT)
+#  error "CONF_TCM needs CONF_BOARD_ENABLE_TCM_AT_INIT"
+#endif
 
 /**
  * \brief Set peripheral mode for IOPORT pins.
@@ -335,9 +342,73 @@ static void _setup_memory_region( void )
 }
 #endif
 
+/** TCM size, GPNVM bits 8:7. 01 gives 32 Kbytes of ITCM and of DTCM. */
+#define BOARD_GPNVM_TCM_Pos     7
+#define BOARD_GPNVM_TCM_Msk     (0x3u << BOARD_GPNVM_TCM_Pos)
+#define BOARD_GPNVM_TCM_32K     (0x1u << BOARD_GPNVM_TCM_Pos)
+
+/**
+ * \brief Run an EEFC command and return its result. Runs from RAM, as the
+ * flash cannot be read while the command is in progress.
+ */
+__no_inline RAMFUNC static uint32_t board_efc_command(uint32_t ul_cmd,
+		uint32_t ul_arg)
+{
+	EFC->EEFC_FCR = EEFC_FCR_FKEY_PASSWD | ul_cmd | EEFC_FCR_FARG(ul_arg);
+	while (!(EFC->EEFC_FSR & EEFC_FSR_FRDY)) {
+	}
+	return EFC->EEFC_FRR;
+}
+
+/**
+ * \brief Make sure the GPNVM bits select a TCM size. The size is latched at
+ * reset, so the chip is reset after the bits are changed; this happens once,
+ * the bits are left alone when they already match.
+ *
+ * \param ul_tcm BOARD_GPNVM_TCM_* value.
+ */
+static void tcm_configure(uint32_t ul_tcm)
+{
+	uint32_t ul_gpnvm = board_efc_command(EEFC_FCR_FCMD_GGPB, 0);
+
+	if ((ul_gpnvm & BOARD_GPNVM_TCM_Msk) == ul_tcm) {
+		return;
+	}
+	board_efc_command((ul_tcm & (0x2u << BOARD_GPNVM_TCM_Pos)) ?
+			EEFC_FCR_FCMD_SGPB : EEFC_FCR_FCMD_CGPB, 8);
+	board_efc_command((ul_tcm & (0x1u << BOARD_GPNVM_TCM_Pos)) ?
+			EEFC_FCR_FCMD_SGPB : EEFC_FCR_FCMD_CGPB, 7);
+	RSTC->RSTC_CR = RSTC_CR_KEY_PASSWD | RSTC_CR_PROCRST;
+	while (1) {
+	}
+}
+
 #ifdef CONF_BOARD_ENABLE_TCM_AT_INIT
 #if defined(__GNUC__)
-extern char _itcm_lma, _sitcm, _eitcm;
+extern uint32_t _itcm_lma, _sitcm, _eitcm;
+extern uint32_t _dtcm_lma, _sdtcm, _edtcm;
+extern uint32_t _szero_dtcm, _ezero_dtcm;
+
+/**
+ * \brief Copy words from p_src to [p_dest, p_end).
+ */
+static void tcm_copy(uint32_t *p_dest, const uint32_t *p_end,
+		const uint32_t *p_src)
+{
+	while (p_dest < p_end) {
+		*p_dest++ = *p_src++;
+	}
+}
+
+/**
+ * \brief Clear [p_dest, p_end).
+ */
+static void tcm_zero(uint32_t *p_dest, const uint32_t *p_end)
+{
+	while (p_dest < p_end) {
+		*p_dest++ = 0;
+	}
+}
 #endif
 
 /** \brief  TCM memory enable
@@ -372,159 +443,259 @@ static inline void tcm_disable(void)
 }
 #endif
 
-void board_init(void)
-{
-#ifndef CONF_BOARD_KEEP_WATCHDOG_AT_INIT
-	/* Disable the watchdog */
-	WDT->WDT_MR = WDT_MR_WDDIS;
-#endif
-
-#ifdef CONF_BOARD_CONFIG_MPU_AT_INIT
-	_setup_memory_region();
-#endif
-
-#ifdef CONF_BOARD_ENABLE_CACHE_AT_INIT
-	/* Enabling the Cache */
-	SCB_EnableICache(); 
-	SCB_EnableDCache();
-#endif
+/**
+ * \name Board pin map
+ *
+ * Pins configured through the IOPORT register images, see
+ * IOPORT_MAP_PORT_CONFIG(). Each group expands to nothing when its
+ * CONF_BOARD_* option is off.
+ * @{
+ */
+#define BOARD_PIN_UNUSED(X, arg)
 
-#ifdef CONF_BOARD_ENABLE_TCM_AT_INIT
-	/* TCM Configuration */
-	EFC->EEFC_FCR = (EEFC_FCR_FKEY_PASSWD | EEFC_FCR_FCMD_CGPB 
-					| EEFC_FCR_FARG(8));
-	EFC->EEFC_FCR = (EEFC_FCR_FKEY_PASSWD | EEFC_FCR_FCMD_SGPB
-					| EEFC_FCR_FARG(7));
-	tcm_enable();
-#if defined(__GNUC__)
-	volatile char *dst = &_sitcm;
-	volatile char *src = &_itcm_lma;
-	/* copy code_TCM from flash to ITCM */
-	while(dst < &_eitcm){
-		*dst++ = *src++;
-	}
-#endif
+/* LEDs off; the reset pull-ups are kept. PA23 is PWM LED0 when enabled. */
+#ifndef CONF_BOARD_PWM_LED0
+#define BOARD_PINS_LED0(X, arg) \
+	X(arg, LED0_GPIO, IOPORT_MAP_OUTPUT(LED0_INACTIVE_LEVEL), \
+			IOPORT_MODE_PULLUP)
 #else
-	/* TCM Configuration */
-	EFC->EEFC_FCR = (EEFC_FCR_FKEY_PASSWD | EEFC_FCR_FCMD_CGPB 
-					| EEFC_FCR_FARG(8));
-	EFC->EEFC_FCR = (EEFC_FCR_FKEY_PASSWD | EEFC_FCR_FCMD_CGPB 
-					| EEFC_FCR_FARG(7));
-	
-	tcm_disable();
+#define BOARD_PINS_LED0 BOARD_PIN_UNUSED
 #endif
+#define BOARD_PINS_LED1(X, arg) \
+	X(arg, LED1_GPIO, IOPORT_MAP_OUTPUT(LED1_INACTIVE_LEVEL), \
+			IOPORT_MODE_PULLUP)
 
-	/* Initialize IOPORTs */
-	ioport_init();
-
-	/* Configure the pins connected to LED as output and set their
-	 * default initial state to high (LED off).
-	 */
-	ioport_set_pin_dir(LED0_GPIO, IOPORT_DIR_OUTPUT);
-	ioport_set_pin_level(LED0_GPIO, LED0_INACTIVE_LEVEL);
-	ioport_set_pin_dir(LED1_GPIO, IOPORT_DIR_OUTPUT);
-	ioport_set_pin_level(LED1_GPIO, LED0_INACTIVE_LEVEL);
-
-	/* Configure Push Button pins */
-	ioport_set_pin_input_mode(GPIO_PUSH_BUTTON_1, GPIO_PUSH_BUTTON_1_FLAGS,
-			GPIO_PUSH_BUTTON_1_SENSE);
+#define BOARD_PINS_BUTTON(X, arg) \
+	X(arg, GPIO_PUSH_BUTTON_1, \
+			IOPORT_MAP_INPUT | IOPORT_MAP_SENSE(GPIO_PUSH_BUTTON_1_SENSE), \
+			GPIO_PUSH_BUTTON_1_FLAGS)
 
 #ifdef CONF_BOARD_UART_CONSOLE
-	/* Configure UART pins */
-	ioport_set_pin_peripheral_mode(USART1_RXD_GPIO, USART1_RXD_FLAGS);
-	MATRIX->CCFG_SYSIO |= CCFG_SYSIO_SYSIO4;
-	ioport_set_pin_peripheral_mode(USART1_TXD_GPIO, USART1_TXD_FLAGS);
+#define BOARD_PINS_CONSOLE(X, arg) \
+	X(arg, USART1_RXD_GPIO, IOPORT_MAP_PERIPH, USART1_RXD_FLAGS) \
+	X(arg, USART1_TXD_GPIO, IOPORT_MAP_PERIPH, USART1_TXD_FLAGS)
+#else
+#define BOARD_PINS_CONSOLE BOARD_PIN_UNUSED
 #endif
 
 #ifdef CONF_BOARD_TWIHS0
-	ioport_set_pin_peripheral_mode(TWIHS0_DATA_GPIO, TWIHS0_DATA_FLAGS);
-	ioport_set_pin_peripheral_mode(TWIHS0_CLK_GPIO, TWIHS0_CLK_FLAGS);
+#define BOARD_PINS_TWIHS0(X, arg) \
+	X(arg, TWIHS0_DATA_GPIO, IOPORT_MAP_PERIPH, TWIHS0_DATA_FLAGS) \
+	X(arg, TWIHS0_CLK_GPIO, IOPORT_MAP_PERIPH, TWIHS0_CLK_FLAGS)
+#else
+#define BOARD_PINS_TWIHS0 BOARD_PIN_UNUSED
 #endif
 
-
 #ifdef CONF_BOARD_CAN0
-	/* Configure the CAN0 TX and RX pins. */
-	ioport_set_pin_peripheral_mode(PIN_CAN0_RX_IDX, PIN_CAN0_RX_FLAGS);
-	ioport_set_pin_peripheral_mode(PIN_CAN0_TX_IDX, PIN_CAN0_TX_FLAGS);
-	/* Configure the transiver0 RS & EN pins. */
-	ioport_set_pin_dir(PIN_CAN0_TR_RS_IDX, IOPORT_DIR_OUTPUT);
-	ioport_set_pin_dir(PIN_CAN0_TR_EN_IDX, IOPORT_DIR_OUTPUT);
+/* CAN0 RX/TX, and the RS & EN pins of its transceiver. */
+#define BOARD_PINS_CAN0(X, arg) \
+	X(arg, PIN_CAN0_RX_IDX, IOPORT_MAP_PERIPH, PIN_CAN0_RX_FLAGS) \
+	X(arg, PIN_CAN0_TX_IDX, IOPORT_MAP_PERIPH, PIN_CAN0_TX_FLAGS) \
+	X(arg, PIN_CAN0_TR_RS_IDX, IOPORT_MAP_OUTPUT(IOPORT_PIN_LEVEL_LOW), \
+			IOPORT_MODE_PULLUP) \
+	X(arg, PIN_CAN0_TR_EN_IDX, IOPORT_MAP_OUTPUT(IOPORT_PIN_LEVEL_LOW), \
+			IOPORT_MODE_PULLUP)
+#else
+#define BOARD_PINS_CAN0 BOARD_PIN_UNUSED
 #endif
 
 #ifdef CONF_BOARD_CAN1
-	/* Configure the CAN1 TX and RX pin. */
-	ioport_set_pin_peripheral_mode(PIN_CAN1_RX_IDX, PIN_CAN1_RX_FLAGS);
-	ioport_set_pin_peripheral_mode(PIN_CAN1_TX_IDX, PIN_CAN1_TX_FLAGS);
-
+#define BOARD_PINS_CAN1(X, arg) \
+	X(arg, PIN_CAN1_RX_IDX, IOPORT_MAP_PERIPH, PIN_CAN1_RX_FLAGS) \
+	X(arg, PIN_CAN1_TX_IDX, IOPORT_MAP_PERIPH, PIN_CAN1_TX_FLAGS)
+#else
+#define BOARD_PINS_CAN1 BOARD_PIN_UNUSED
 #endif
 
-
 #ifdef CONF_BOARD_SPI
-	ioport_set_pin_peripheral_mode(SPI0_MISO_GPIO, SPI0_MISO_FLAGS);
-	ioport_set_pin_peripheral_mode(SPI0_MOSI_GPIO, SPI0_MOSI_FLAGS);
-	ioport_set_pin_peripheral_mode(SPI0_NPCS0_GPIO, SPI0_NPCS0_FLAGS);
-	ioport_set_pin_peripheral_mode(SPI0_SPCK_GPIO, SPI0_SPCK_FLAGS);
+#define BOARD_PINS_SPI(X, arg) \
+	X(arg, SPI0_MISO_GPIO, IOPORT_MAP_PERIPH, SPI0_MISO_FLAGS) \
+	X(arg, SPI0_MOSI_GPIO, IOPORT_MAP_PERIPH, SPI0_MOSI_FLAGS) \
+	X(arg, SPI0_NPCS0_GPIO, IOPORT_MAP_PERIPH, SPI0_NPCS0_FLAGS) \
+	X(arg, SPI0_SPCK_GPIO, IOPORT_MAP_PERIPH, SPI0_SPCK_FLAGS)
+#else
+#define BOARD_PINS_SPI BOARD_PIN_UNUSED
 #endif
 
 #ifdef CONF_BOARD_QSPI
-	ioport_set_pin_peripheral_mode(QSPI_QSCK_GPIO, QSPI_QSCK_FLAGS);
-	ioport_set_pin_peripheral_mode(QSPI_QCS_GPIO, QSPI_QCS_FLAGS);
-	ioport_set_pin_peripheral_mode(QSPI_QIO0_GPIO, QSPI_QIO0_FLAGS);
-	ioport_set_pin_peripheral_mode(QSPI_QIO1_GPIO, QSPI_QIO1_FLAGS);
-	ioport_set_pin_peripheral_mode(QSPI_QIO2_GPIO, QSPI_QIO2_FLAGS);
-	ioport_set_pin_peripheral_mode(QSPI_QIO3_GPIO, QSPI_QIO3_FLAGS);
+#define BOARD_PINS_QSPI(X, arg) \
+	X(arg, QSPI_QSCK_GPIO, IOPORT_MAP_PERIPH, QSPI_QSCK_FLAGS) \
+	X(arg, QSPI_QCS_GPIO, IOPORT_MAP_PERIPH, QSPI_QCS_FLAGS) \
+	X(arg, QSPI_QIO0_GPIO, IOPORT_MAP_PERIPH, QSPI_QIO0_FLAGS) \
+	X(arg, QSPI_QIO1_GPIO, IOPORT_MAP_PERIPH, QSPI_QIO1_FLAGS) \
+	X(arg, QSPI_QIO2_GPIO, IOPORT_MAP_PERIPH, QSPI_QIO2_FLAGS) \
+	X(arg, QSPI_QIO3_GPIO, IOPORT_MAP_PERIPH, QSPI_QIO3_FLAGS)
+#else
+#define BOARD_PINS_QSPI BOARD_PIN_UNUSED
 #endif
 
 #ifdef CONF_BOARD_PWM_LED0
-	/* Configure PWM LED0 pin */
-	ioport_set_pin_peripheral_mode(PIN_PWM_LED0_GPIO, PIN_PWM_LED0_FLAGS);
+#define BOARD_PINS_PWM_LED0(X, arg) \
+	X(arg, PIN_PWM_LED0_GPIO, IOPORT_MAP_PERIPH, PIN_PWM_LED0_FLAGS)
+#else
+#define BOARD_PINS_PWM_LED0 BOARD_PIN_UNUSED
 #endif
 
 #ifdef CONF_BOARD_PWM_LED1
-	/* Configure PWM LED1 pin */
-	ioport_set_pin_peripheral_mode(PIN_PWM_LED1_GPIO, PIN_PWM_LED1_FLAGS);
+#define BOARD_PINS_PWM_LED1(X, arg) \
+	X(arg, PIN_PWM_LED1_GPIO, IOPORT_MAP_PERIPH, PIN_PWM_LED1_FLAGS)
+#else
+#define BOARD_PINS_PWM_LED1 BOARD_PIN_UNUSED
 #endif
 
-
 #ifdef CONF_BOARD_USART_RXD
-	/* Configure USART RXD pin */
-	ioport_set_pin_peripheral_mode(USART0_RXD_GPIO, USART0_RXD_FLAGS);
+#define BOARD_PINS_USART_RXD(X, arg) \
+	X(arg, USART0_RXD_GPIO, IOPORT_MAP_PERIPH, USART0_RXD_FLAGS)
+#else
+#define BOARD_PINS_USART_RXD BOARD_PIN_UNUSED
 #endif
 
 #ifdef CONF_BOARD_USART_TXD
-	/* Configure USART TXD pin */
-	ioport_set_pin_peripheral_mode(USART0_TXD_GPIO, USART0_TXD_FLAGS);
+#define BOARD_PINS_USART_TXD(X, arg) \
+	X(arg, USART0_TXD_GPIO, IOPORT_MAP_PERIPH, USART0_TXD_FLAGS)
+#else
+#define BOARD_PINS_USART_TXD BOARD_PIN_UNUSED
 #endif
 
 #ifdef CONF_BOARD_USART_SCK
-	/* Configure USART synchronous communication SCK pin */
-	ioport_set_pin_peripheral_mode(PIN_USART0_SCK_IDX,PIN_USART0_SCK_FLAGS);
+#define BOARD_PINS_USART_SCK(X, arg) \
+	X(arg, PIN_USART0_SCK_IDX, IOPORT_MAP_PERIPH, PIN_USART0_SCK_FLAGS)
+#else
+#define BOARD_PINS_USART_SCK BOARD_PIN_UNUSED
 #endif
 
 #ifdef CONF_BOARD_USART_CTS
-	/* Configure USART synchronous communication CTS pin */
-	ioport_set_pin_peripheral_mode(PIN_USART0_CTS_IDX,PIN_USART0_CTS_FLAGS);
+#define BOARD_PINS_USART_CTS(X, arg) \
+	X(arg, PIN_USART0_CTS_IDX, IOPORT_MAP_PERIPH, PIN_USART0_CTS_FLAGS)
+#else
+#define BOARD_PINS_USART_CTS BOARD_PIN_UNUSED
 #endif
 
 #ifdef CONF_BOARD_USART_RTS
-	/* Configure USART RTS pin */
-	ioport_set_pin_peripheral_mode(PIN_USART0_RTS_IDX, PIN_USART0_RTS_FLAGS);
+#define BOARD_PINS_USART_RTS(X, arg) \
+	X(arg, PIN_USART0_RTS_IDX, IOPORT_MAP_PERIPH, PIN_USART0_RTS_FLAGS)
+#else
+#define BOARD_PINS_USART_RTS BOARD_PIN_UNUSED
 #endif
 
 #ifdef CONF_BOARD_SD_MMC_HSMCI
-	/* Configure HSMCI pins */
-	ioport_set_pin_peripheral_mode(PIN_HSMCI_MCCDA_GPIO, PIN_HSMCI_MCCDA_FLAGS);
-	ioport_set_pin_peripheral_mode(PIN_HSMCI_MCCK_GPIO, PIN_HSMCI_MCCK_FLAGS);
-	ioport_set_pin_peripheral_mode(PIN_HSMCI_MCDA0_GPIO, PIN_HSMCI_MCDA0_FLAGS);
-	ioport_set_pin_peripheral_mode(PIN_HSMCI_MCDA1_GPIO, PIN_HSMCI_MCDA1_FLAGS);
-	ioport_set_pin_peripheral_mode(PIN_HSMCI_MCDA2_GPIO, PIN_HSMCI_MCDA2_FLAGS);
-	ioport_set_pin_peripheral_mode(PIN_HSMCI_MCDA3_GPIO, PIN_HSMCI_MCDA3_FLAGS);
+/* HSMCI pins and the SD/MMC card detect input. */
+#define BOARD_PINS_HSMCI(X, arg) \
+	X(arg, PIN_HSMCI_MCCDA_GPIO, IOPORT_MAP_PERIPH, PIN_HSMCI_MCCDA_FLAGS) \
+	X(arg, PIN_HSMCI_MCCK_GPIO, IOPORT_MAP_PERIPH, PIN_HSMCI_MCCK_FLAGS) \
+	X(arg, PIN_HSMCI_MCDA0_GPIO, IOPORT_MAP_PERIPH, PIN_HSMCI_MCDA0_FLAGS) \
+	X(arg, PIN_HSMCI_MCDA1_GPIO, IOPORT_MAP_PERIPH, PIN_HSMCI_MCDA1_FLAGS) \
+	X(arg, PIN_HSMCI_MCDA2_GPIO, IOPORT_MAP_PERIPH, PIN_HSMCI_MCDA2_FLAGS) \
+	X(arg, PIN_HSMCI_MCDA3_GPIO, IOPORT_MAP_PERIPH, PIN_HSMCI_MCDA3_FLAGS) \
+	X(arg, SD_MMC_0_CD_GPIO, IOPORT_MAP_INPUT, SD_MMC_0_CD_FLAGS)
+#else
+#define BOARD_PINS_HSMCI BOARD_PIN_UNUSED
+#endif
+
+#if defined(CONF_BOARD_USB_PORT) && defined(CONF_BOARD_USB_VBUS_DETECT)
+#define BOARD_PINS_USB_VBUS(X, arg) \
+	X(arg, USB_VBUS_PIN, IOPORT_MAP_INPUT, IOPORT_MODE_PULLUP)
+#else
+#define BOARD_PINS_USB_VBUS BOARD_PIN_UNUSED
+#endif
+
+#if defined(CONF_BOARD_USB_PORT) && defined(CONF_BOARD_USB_ID_DETECT)
+#define BOARD_PINS_USB_ID(X, arg) \
+	X(arg, USB_ID_PIN, IOPORT_MAP_INPUT, IOPORT_MODE_PULLUP)
+#else
+#define BOARD_PINS_USB_ID BOARD_PIN_UNUSED
+#endif
+
+#define board_pin_map(X, arg) \
+	BOARD_PINS_LED0(X, arg) \
+	BOARD_PINS_LED1(X, arg) \
+	BOARD_PINS_BUTTON(X, arg) \
+	BOARD_PINS_CONSOLE(X, arg) \
+	BOARD_PINS_TWIHS0(X, arg) \
+	BOARD_PINS_CAN0(X, arg) \
+	BOARD_PINS_CAN1(X, arg) \
+	BOARD_PINS_SPI(X, arg) \
+	BOARD_PINS_QSPI(X, arg) \
+	BOARD_PINS_PWM_LED0(X, arg) \
+	BOARD_PINS_PWM_LED1(X, arg) \
+	BOARD_PINS_USART_RXD(X, arg) \
+	BOARD_PINS_USART_TXD(X, arg) \
+	BOARD_PINS_USART_SCK(X, arg) \
+	BOARD_PINS_USART_CTS(X, arg) \
+	BOARD_PINS_USART_RTS(X, arg) \
+	BOARD_PINS_HSMCI(X, arg) \
+	BOARD_PINS_USB_VBUS(X, arg) \
+	BOARD_PINS_USB_ID(X, arg)
+
+/**
+ * Apply the constant register image of \a port built from board_pin_map.
+ * The PIO controllers are at their reset state, so the properties left at
+ * their reset value are not written, unless CONF_BOARD_PIO_WRITE_ALL says
+ * a bootloader may have changed them.
+ */
+#ifdef CONF_BOARD_PIO_WRITE_ALL
+#  define BOARD_APPLY_PORT ioport_configure_port
+#else
+#  define BOARD_APPLY_PORT ioport_configure_port_from_reset
+#endif
+#define BOARD_CONFIGURE_PORT(port) \
+	do {\
+		static const struct ioport_port_config cfg = \
+				IOPORT_MAP_PORT_CONFIG(board_pin_map, port);\
+		BOARD_APPLY_PORT(port, &cfg);\
+	} while (0)
+/** @} */
+
+void board_init(void)
+{
+#ifndef CONF_BOARD_KEEP_WATCHDOG_AT_INIT
+	/* Disable the watchdog */
+	WDT->WDT_MR = WDT_MR_WDDIS;
+#endif
 
-    /* Configure SD/MMC card detect pin */
-	ioport_set_pin_dir(SD_MMC_0_CD_GPIO, IOPORT_DIR_INPUT);
-	ioport_set_pin_mode(SD_MMC_0_CD_GPIO, SD_MMC_0_CD_FLAGS);
+#ifdef CONF_BOARD_CONFIG_MPU_AT_INIT
+	_setup_memory_region();
 #endif
 
+#ifdef CONF_BOARD_ENABLE_CACHE_AT_INIT
+	/* Enabling the Cache */
+	SCB_EnableICache(); 
+	SCB_EnableDCache();
+#endif
+
+#ifdef CONF_BOARD_ENABLE_TCM_AT_INIT
+	/* TCM Configuration */
+	tcm_configure(BOARD_GPNVM_TCM_32K);
+	tcm_enable();
+#if defined(__GNUC__)
+	/* Load the .itcm and .dtcm sections, clear .dtcm_bss */
+	tcm_copy(&_sitcm, &_eitcm, &_itcm_lma);
+	tcm_copy(&_sdtcm, &_edtcm, &_dtcm_lma);
+	tcm_zero(&_szero_dtcm, &_ezero_dtcm);
+	__DSB();
+	__ISB();
+#endif
+#else
+	/* TCM Configuration */
+	tcm_configure(0);
+	tcm_disable();
+#endif
+
+	/* Initialize IOPORTs */
+	ioport_init();
+
+#ifdef CONF_BOARD_UART_CONSOLE
+	/* PB4 is TDI until it is given to the PIO. */
+	MATRIX->CCFG_SYSIO |= CCFG_SYSIO_SYSIO4;
+#endif
+
+	/* Configure the pins of board_pin_map, a few writes per controller. */
+	BOARD_CONFIGURE_PORT(IOPORT_PIOA);
+	BOARD_CONFIGURE_PORT(IOPORT_PIOB);
+	BOARD_CONFIGURE_PORT(IOPORT_PIOC);
+	BOARD_CONFIGURE_PORT(IOPORT_PIOD);
+	BOARD_CONFIGURE_PORT(IOPORT_PIOE);
+
 #ifdef CONF_BOARD_ILI9488
 	/**LCD pin configure on EBI*/
 	pio_configure(PIN_EBI_RESET_PIO, PIN_EBI_RESET_TYPE, PIN_EBI_RESET_MASK, PIN_EBI_RESET_ATTRI);
@@ -539,15 +710,6 @@ void board_init(void)
 	pio_set(PIN_EBI_BACKLIGHT_PIO, PIN_EBI_BACKLIGHT_MASK);
 #endif
 
-#if (defined CONF_BOARD_USB_PORT)
-# if defined(CONF_BOARD_USB_VBUS_DETECT)
-	ioport_set_pin_dir(USB_VBUS_PIN, IOPORT_DIR_INPUT);
-# endif
-# if defined(CONF_BOARD_USB_ID_DETECT)
-	ioport_set_pin_dir(USB_ID_PIN, IOPORT_DIR_INPUT);
-# endif
-#endif
-
 #ifdef CONF_BOARD_SDRAMC
 	pio_configure_pin(SDRAM_BA0_PIO, SDRAM_BA0_FLAGS);
 	pio_configure_pin(SDRAM_SDCK_PIO, SDRAM_SDCK_FLAGS);
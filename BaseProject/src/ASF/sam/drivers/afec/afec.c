@@ -0,0 +1,119 @@
+/**
+ * \file
+ *
+ * \brief SAM Analog Front End Controller (AFEC) driver.
+ *
+ */
+
+#include "afec.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \addtogroup sam_drivers_afec_group
+ *
+ * @{
+ */
+
+/** Trigger fields of AFEC_MR. */
+#define AFEC_MR_TRIGGER_Msk \
+	(AFEC_MR_TRGEN | AFEC_MR_TRGSEL_Msk | AFEC_MR_FREERUN)
+
+/**
+ * \brief Reset a controller and set its clock and result format. All the
+ * channels are disabled and conversions are started by software.
+ *
+ * \param p_afec Pointer to an AFEC instance.
+ * \param p_cfg Configuration.
+ *
+ * \retval STATUS_OK Success.
+ * \retval ERR_INVALID_ARG The AFE clock cannot be reached.
+ */
+status_code_t afec_init(Afec *p_afec, const afec_config_t *p_cfg)
+{
+	p_afec->AFEC_CR = AFEC_CR_SWRST;
+	p_afec->AFEC_CHDR = 0xFFFFFFFF;
+	p_afec->AFEC_IDR = 0xFFFFFFFF;
+	p_afec->AFEC_MR = AFEC_MR_TRGEN_DIS | AFEC_MR_STARTUP_SUT64 |
+			AFEC_MR_ONE | AFEC_MR_TRACKTIM(15) | AFEC_MR_TRANSFER(2);
+	p_afec->AFEC_EMR = AFEC_EMR_RES(0) | (p_cfg->b_tag ? AFEC_EMR_TAG : 0);
+	p_afec->AFEC_ACR = AFEC_ACR_IBCTL(1) | AFEC_ACR_PGA0EN | AFEC_ACR_PGA1EN;
+
+	return afec_set_clock(p_afec, p_cfg->ul_mck, p_cfg->ul_afec_clock);
+}
+
+/**
+ * \brief Set the AFE clock of a controller, e.g. after a change of the
+ * peripheral clock. The fastest clock not above ul_afec_clock is taken.
+ *
+ * \param ul_mck Peripheral clock of the controller.
+ * \param ul_afec_clock AFE clock, at most AFEC_CLOCK_MAX.
+ *
+ * \retval STATUS_OK Success.
+ * \retval ERR_INVALID_ARG The AFE clock cannot be reached.
+ */
+status_code_t afec_set_clock(Afec *p_afec, uint32_t ul_mck,
+		uint32_t ul_afec_clock)
+{
+	uint32_t ul_prescal;
+
+	if (!ul_afec_clock || ul_afec_clock > AFEC_CLOCK_MAX) {
+		return ERR_INVALID_ARG;
+	}
+	ul_prescal = (ul_mck + ul_afec_clock - 1) / ul_afec_clock;
+	if (ul_prescal == 0 || ul_prescal > 256) {
+		return ERR_INVALID_ARG;
+	}
+	p_afec->AFEC_MR = (p_afec->AFEC_MR & ~AFEC_MR_PRESCAL_Msk) |
+			AFEC_MR_PRESCAL(ul_prescal - 1);
+
+	return STATUS_OK;
+}
+
+/**
+ * \brief AFE clock of a controller.
+ *
+ * \param ul_mck Peripheral clock of the controller.
+ */
+uint32_t afec_get_clock(Afec *p_afec, uint32_t ul_mck)
+{
+	uint32_t ul_prescal = (p_afec->AFEC_MR & AFEC_MR_PRESCAL_Msk) >>
+			AFEC_MR_PRESCAL_Pos;
+
+	return ul_mck / (ul_prescal + 1);
+}
+
+/**
+ * \brief Select what starts the conversions.
+ */
+void afec_set_trigger(Afec *p_afec, enum afec_trigger trigger)
+{
+	p_afec->AFEC_MR = (p_afec->AFEC_MR & ~AFEC_MR_TRIGGER_Msk) | trigger;
+}
+
+/**
+ * \brief Set the analog offset of a channel, AFEC_OFFSET_MID for a
+ * single-ended input.
+ */
+void afec_channel_set_analog_offset(Afec *p_afec, uint32_t ul_channel,
+		uint32_t ul_offset)
+{
+	p_afec->AFEC_CSELR = AFEC_CSELR_CSEL(ul_channel);
+	p_afec->AFEC_COCR = AFEC_COCR_AOFF(ul_offset);
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
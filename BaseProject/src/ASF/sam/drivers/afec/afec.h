@@ -0,0 +1,141 @@
+/**
+ * \file
+ *
+ * \brief SAM Analog Front End Controller (AFEC) driver.
+ *
+ */
+
+#ifndef AFEC_H_INCLUDED
+#define AFEC_H_INCLUDED
+
+#include "compiler.h"
+#include "status_codes.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \defgroup sam_drivers_afec_group Analog Front End Controller (AFEC)
+ *
+ * Setup of the AFEC controllers for 12-bit conversions of single-ended
+ * channels, with the function names of the ASF AFEC driver. Conversions of
+ * all the enabled channels run in channel order on each trigger, and the
+ * results are read from the last converted data register, typically by the
+ * XDMAC (interface XDMAC_PERID_AFEC0 or XDMAC_PERID_AFEC1).
+ *
+ * @{
+ */
+
+/** Highest AFE clock. */
+#define AFEC_CLOCK_MAX            40000000UL
+
+/** AFE clock periods per conversion, tracking included. */
+#define AFEC_CONVERSION_CLOCKS    20
+
+/** Number of channels of a controller. */
+#define AFEC_CHANNEL_NUM          12
+
+/** Mid-scale analog offset, for single-ended inputs. */
+#define AFEC_OFFSET_MID           0x200
+
+/** Conversion triggers. */
+enum afec_trigger {
+	/** Software start only, see afec_start_software_conversion(). */
+	AFEC_TRIG_SW = AFEC_MR_TRGEN_DIS,
+	/** AFEx_ADTRG pin. */
+	AFEC_TRIG_EXT = AFEC_MR_TRGSEL_AFEC_TRIG0 | AFEC_MR_TRGEN,
+	/** TIOA of TC0 channels 0 to 2 (AFEC0) or TC1 channels 0 to 2 (AFEC1). */
+	AFEC_TRIG_TIO_CH_0 = AFEC_MR_TRGSEL_AFEC_TRIG1 | AFEC_MR_TRGEN,
+	AFEC_TRIG_TIO_CH_1 = AFEC_MR_TRGSEL_AFEC_TRIG2 | AFEC_MR_TRGEN,
+	AFEC_TRIG_TIO_CH_2 = AFEC_MR_TRGSEL_AFEC_TRIG3 | AFEC_MR_TRGEN,
+	/** PWM0 (AFEC0) or PWM1 (AFEC1) event lines. */
+	AFEC_TRIG_PWM_EVENT_LINE_0 = AFEC_MR_TRGSEL_AFEC_TRIG4 | AFEC_MR_TRGEN,
+	AFEC_TRIG_PWM_EVENT_LINE_1 = AFEC_MR_TRGSEL_AFEC_TRIG5 | AFEC_MR_TRGEN,
+	AFEC_TRIG_ANALOG_COMPARATOR = AFEC_MR_TRGSEL_AFEC_TRIG6 | AFEC_MR_TRGEN,
+	/** Back-to-back conversions. */
+	AFEC_TRIG_FREERUN = AFEC_MR_FREERUN,
+};
+
+/** Controller configuration. */
+typedef struct {
+	/** Peripheral clock of the controller. */
+	uint32_t ul_mck;
+	/** AFE clock, at most AFEC_CLOCK_MAX; rounded down. */
+	uint32_t ul_afec_clock;
+	/** Report the channel number with each result (AFEC_LCDR.CHNB). */
+	bool b_tag;
+} afec_config_t;
+
+status_code_t afec_init(Afec *p_afec, const afec_config_t *p_cfg);
+status_code_t afec_set_clock(Afec *p_afec, uint32_t ul_mck,
+		uint32_t ul_afec_clock);
+uint32_t afec_get_clock(Afec *p_afec, uint32_t ul_mck);
+void afec_set_trigger(Afec *p_afec, enum afec_trigger trigger);
+void afec_channel_set_analog_offset(Afec *p_afec, uint32_t ul_channel,
+		uint32_t ul_offset);
+
+/**
+ * \brief Enable a channel, converted on each trigger.
+ */
+static inline void afec_channel_enable(Afec *p_afec, uint32_t ul_channel)
+{
+	p_afec->AFEC_CHER = 1u << ul_channel;
+}
+
+/**
+ * \brief Disable a channel.
+ */
+static inline void afec_channel_disable(Afec *p_afec, uint32_t ul_channel)
+{
+	p_afec->AFEC_CHDR = 1u << ul_channel;
+}
+
+/**
+ * \brief Enabled channels, one bit per channel.
+ */
+static inline uint32_t afec_channel_get_status(Afec *p_afec)
+{
+	return p_afec->AFEC_CHSR;
+}
+
+/**
+ * \brief Start the conversion of the enabled channels.
+ */
+static inline void afec_start_software_conversion(Afec *p_afec)
+{
+	p_afec->AFEC_CR = AFEC_CR_START;
+}
+
+/**
+ * \brief Last result, with the channel number in AFEC_LCDR_CHNB when
+ * tagging is on.
+ */
+static inline uint32_t afec_get_latest_value(Afec *p_afec)
+{
+	return p_afec->AFEC_LCDR;
+}
+
+/**
+ * \brief Read and clear the interrupt status.
+ */
+static inline uint32_t afec_get_interrupt_status(Afec *p_afec)
+{
+	return p_afec->AFEC_ISR;
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+#endif /* AFEC_H_INCLUDED */
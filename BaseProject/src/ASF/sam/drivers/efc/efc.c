@@ -0,0 +1,138 @@
+/**
+ * \file
+ *
+ * \brief SAM Enhanced Embedded Flash Controller (EEFC) driver.
+ *
+ */
+
+#include "efc.h"
+#include "interrupt.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \addtogroup sam_drivers_efc_group
+ *
+ * @{
+ */
+
+/** Command errors. */
+#define EFC_FSR_ERRORS  (EEFC_FSR_FCMDE | EEFC_FSR_FLOCKE | EEFC_FSR_FLERR)
+
+/**
+ * \brief Run a command and wait for its end. Runs from RAM, as the flash
+ * cannot be read meanwhile.
+ *
+ * \return The status bits seen, whose error bits clear on read.
+ */
+__no_inline RAMFUNC static uint32_t efc_command(Efc *p_efc, uint32_t ul_cmd,
+		uint32_t ul_arg)
+{
+	uint32_t ul_fsr;
+	uint32_t ul_status = 0;
+
+	p_efc->EEFC_FCR = EEFC_FCR_FKEY_PASSWD | ul_cmd | EEFC_FCR_FARG(ul_arg);
+	do {
+		ul_fsr = p_efc->EEFC_FSR;
+		ul_status |= ul_fsr;
+	} while (!(ul_fsr & EEFC_FSR_FRDY));
+
+	return ul_status;
+}
+
+/**
+ * \brief Run a command with interrupts masked.
+ */
+static status_code_t efc_run(Efc *p_efc, uint32_t ul_cmd, uint32_t ul_arg)
+{
+	irqflags_t flags;
+	uint32_t ul_status;
+
+	flags = cpu_irq_save();
+	ul_status = efc_command(p_efc, ul_cmd, ul_arg);
+	cpu_irq_restore(flags);
+
+	return (ul_status & EFC_FSR_ERRORS) ? ERR_IO_ERROR : STATUS_OK;
+}
+
+/**
+ * \brief Program a page.
+ *
+ * \param p_efc EEFC instance.
+ * \param ul_addr Page address, writable in the MPU.
+ * \param p_data EFC_PAGE_SIZE bytes.
+ *
+ * \retval STATUS_OK The page is programmed.
+ * \retval ERR_INVALID_ARG \a ul_addr is not a flash page.
+ * \retval ERR_IO_ERROR The command failed (locked region).
+ */
+status_code_t efc_write_page(Efc *p_efc, uint32_t ul_addr,
+		const uint32_t *p_data)
+{
+	volatile uint32_t *p_latch = (volatile uint32_t *)ul_addr;
+	uint32_t i;
+
+	if (ul_addr < IFLASH_ADDR || ul_addr >= IFLASH_ADDR + IFLASH_SIZE ||
+			(ul_addr % EFC_PAGE_SIZE)) {
+		return ERR_INVALID_ARG;
+	}
+
+	/* Writes at the page addresses fill the latch buffer. */
+	for (i = 0; i < EFC_PAGE_SIZE / 4; i++) {
+		p_latch[i] = p_data[i];
+	}
+	__DSB();
+
+	return efc_run(p_efc, EEFC_FCR_FCMD_WP,
+			(ul_addr - IFLASH_ADDR) / EFC_PAGE_SIZE);
+}
+
+/**
+ * \brief Erase pages.
+ *
+ * \param p_efc EEFC instance.
+ * \param ul_addr Address of the first page, aligned on \a ul_pages pages.
+ * \param ul_pages 4, 8, 16 or 32. Outside of the small sectors, at least
+ * 16.
+ *
+ * \retval STATUS_OK The pages are erased.
+ * \retval ERR_INVALID_ARG Bad address or count.
+ * \retval ERR_IO_ERROR The command failed (locked region, or count not
+ * allowed there).
+ */
+status_code_t efc_erase_pages(Efc *p_efc, uint32_t ul_addr,
+		uint32_t ul_pages)
+{
+	uint32_t ul_page = (ul_addr - IFLASH_ADDR) / EFC_PAGE_SIZE;
+	uint32_t ul_size;
+
+	/* FARG[1:0]: 4 << n pages. */
+	for (ul_size = 0; ul_size < 4; ul_size++) {
+		if (ul_pages == (4u << ul_size)) {
+			break;
+		}
+	}
+	if (ul_size == 4 || ul_addr < IFLASH_ADDR ||
+			ul_addr >= IFLASH_ADDR + IFLASH_SIZE ||
+			(ul_addr % (EFC_PAGE_SIZE * ul_pages))) {
+		return ERR_INVALID_ARG;
+	}
+
+	return efc_run(p_efc, EEFC_FCR_FCMD_EPA, ul_page | ul_size);
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
@@ -0,0 +1,58 @@
+/**
+ * \file
+ *
+ * \brief SAM Enhanced Embedded Flash Controller (EEFC) driver.
+ *
+ */
+
+#ifndef EFC_H_INCLUDED
+#define EFC_H_INCLUDED
+
+#include "compiler.h"
+#include "status_codes.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \defgroup sam_drivers_efc_group Enhanced Embedded Flash Controller (EEFC)
+ *
+ * Page programming and erasing of the internal flash.
+ *
+ * A page is programmed by filling the latch buffer, which is written at
+ * the page addresses, then running the write command: the pages to program
+ * must therefore be writable in the MPU. A page can only be programmed
+ * once between erases, and is erased along with the 4 to 32 pages of its
+ * erase block.
+ *
+ * The flash cannot be read while a command runs, so the commands run from
+ * RAM with interrupts masked: a page program takes about 1.5 ms, an erase
+ * of 16 pages several milliseconds, during which no interrupt is taken.
+ *
+ * @{
+ */
+
+/** Page size in bytes. */
+#define EFC_PAGE_SIZE             IFLASH_PAGE_SIZE
+
+status_code_t efc_write_page(Efc *p_efc, uint32_t ul_addr,
+		const uint32_t *p_data);
+status_code_t efc_erase_pages(Efc *p_efc, uint32_t ul_addr,
+		uint32_t ul_pages);
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+#endif /* EFC_H_INCLUDED */
@@ -0,0 +1,486 @@
+/**
+ * \file
+ *
+ * \brief SAM Ethernet MAC (GMAC) driver.
+ *
+ */
+
+#include "gmac.h"
+#include "interrupt.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \addtogroup sam_drivers_gmac_group
+ *
+ * @{
+ */
+
+/** Longest wait, in loop iterations, for a PHY management frame. */
+#define GMAC_TIMEOUT              100000
+
+/** Highest management clock allowed by IEEE 802.3. */
+#define GMAC_MDC_MAX_HZ           2500000UL
+
+/** Management frame fields: clause 22 read and write operations. */
+#define GMAC_MAN_READ             2
+#define GMAC_MAN_WRITE            1
+
+/** Number of priority queues, all unused. */
+#define GMAC_PRIORITY_QUEUES \
+	(sizeof(((Gmac *)0)->GMAC_TBQBAPQ) / sizeof(((Gmac *)0)->GMAC_TBQBAPQ[0]))
+
+/** Instance served by GMAC_Handler(). */
+static gmac_dev_t *gs_p_gmac_dev;
+
+/**
+ * \brief Descriptor memory needed by a configuration, in bytes.
+ *
+ * The rings are followed by the empty descriptors of the priority queues.
+ */
+uint32_t gmac_desc_size(const gmac_config_t *p_cfg)
+{
+	return sizeof(gmac_desc_t) * (p_cfg->us_rx_count + p_cfg->us_tx_count + 2);
+}
+
+/**
+ * \brief Set the management clock divider for a MCK frequency.
+ */
+void gmac_set_mdc_clock(Gmac *p_gmac, uint32_t ul_mck_hz)
+{
+	static const uint8_t uc_div[] = {8, 16, 32, 48, 64, 96};
+	uint32_t i;
+
+	for (i = 0; i < sizeof(uc_div) / sizeof(uc_div[0]) - 1; i++) {
+		if (ul_mck_hz / uc_div[i] <= GMAC_MDC_MAX_HZ) {
+			break;
+		}
+	}
+	p_gmac->GMAC_NCFGR = (p_gmac->GMAC_NCFGR & ~GMAC_NCFGR_CLK_Msk) |
+			GMAC_NCFGR_CLK(i);
+}
+
+/**
+ * \brief Configure the MAC and lay out the descriptor rings.
+ *
+ * The peripheral clock must be running and the pins set up. Every receive
+ * slot is left empty and both directions disabled: give the receive
+ * buffers with gmac_rx_refill(), then call gmac_enable().
+ *
+ * \retval STATUS_OK on success.
+ * \retval ERR_INVALID_ARG if a ring is empty, or the receive buffers are
+ * too small or not a multiple of GMAC_RX_UNIT_SIZE.
+ */
+status_code_t gmac_init(gmac_dev_t *p_dev, Gmac *p_gmac,
+		const gmac_config_t *p_cfg)
+{
+	gmac_desc_t *p_dummy;
+	uint32_t i, ul_ncfgr;
+
+	if (!p_cfg->us_rx_count || !p_cfg->us_tx_count ||
+			((uint32_t)p_cfg->p_desc & 7) ||
+			p_cfg->us_rx_buf_size < GMAC_FRAME_SIZE_MAX ||
+			(p_cfg->us_rx_buf_size % GMAC_RX_UNIT_SIZE)) {
+		return ERR_INVALID_ARG;
+	}
+
+	p_gmac->GMAC_NCR = 0;
+	p_gmac->GMAC_IDR = 0xFFFFFFFF;
+	(void)p_gmac->GMAC_ISR;
+	p_gmac->GMAC_TSR = 0xFFFFFFFF;
+	p_gmac->GMAC_RSR = 0xFFFFFFFF;
+	p_gmac->GMAC_NCR = GMAC_NCR_CLRSTAT;
+
+	p_dev->p_gmac = p_gmac;
+	p_dev->p_rx = p_cfg->p_desc;
+	p_dev->p_tx = p_cfg->p_desc + p_cfg->us_rx_count;
+	p_dev->us_rx_count = p_cfg->us_rx_count;
+	p_dev->us_tx_count = p_cfg->us_tx_count;
+	p_dev->us_rx_take = p_dev->us_rx_refill = p_dev->us_rx_posted = 0;
+	p_dev->us_tx_reclaim = p_dev->us_tx_post = p_dev->us_tx_posted = 0;
+	p_dev->b_tx_fault = false;
+	p_dev->ul_rx_frames = p_dev->ul_rx_errors = 0;
+	p_dev->ul_tx_frames = p_dev->ul_tx_errors = 0;
+
+	/* Receive slots owned by software until they get a buffer, transmit
+	 * slots used until they get a frame. */
+	for (i = 0; i < p_cfg->us_rx_count; i++) {
+		p_dev->p_rx[i].ul_status = 0;
+		p_dev->p_rx[i].ul_addr = GMAC_RXD_OWNERSHIP;
+	}
+	p_dev->p_rx[i - 1].ul_addr |= GMAC_RXD_WRAP;
+	for (i = 0; i < p_cfg->us_tx_count; i++) {
+		p_dev->p_tx[i].ul_addr = 0;
+		p_dev->p_tx[i].ul_status = GMAC_TXD_USED;
+	}
+	p_dev->p_tx[i - 1].ul_status |= GMAC_TXD_WRAP;
+	p_dummy = p_dev->p_tx + p_cfg->us_tx_count;
+	p_dummy[0].ul_addr = GMAC_RXD_OWNERSHIP | GMAC_RXD_WRAP;
+	p_dummy[0].ul_status = 0;
+	p_dummy[1].ul_addr = 0;
+	p_dummy[1].ul_status = GMAC_TXD_USED | GMAC_TXD_WRAP;
+	__DMB();
+
+	ul_ncfgr = GMAC_NCFGR_SPD | GMAC_NCFGR_FD | GMAC_NCFGR_MAXFS |
+			GMAC_NCFGR_RFCS;
+	if (p_cfg->b_promiscuous) {
+		ul_ncfgr |= GMAC_NCFGR_CAF;
+	}
+	p_gmac->GMAC_NCFGR = ul_ncfgr;
+	gmac_set_mdc_clock(p_gmac, p_cfg->ul_mck_hz);
+	/* The bit selects MII when set, despite its name. */
+	p_gmac->GMAC_UR = p_cfg->b_rmii ? 0 : GMAC_UR_RMII;
+	p_gmac->GMAC_DCFGR = GMAC_DCFGR_FBLDO_INCR4 | GMAC_DCFGR_RXBMS_FULL |
+			GMAC_DCFGR_TXPBMS |
+			GMAC_DCFGR_DRBS(p_cfg->us_rx_buf_size / GMAC_RX_UNIT_SIZE);
+
+	p_gmac->GMAC_RBQB = (uint32_t)p_dev->p_rx;
+	p_gmac->GMAC_TBQB = (uint32_t)p_dev->p_tx;
+	for (i = 0; i < GMAC_PRIORITY_QUEUES; i++) {
+		p_gmac->GMAC_RBQBAPQ[i] = (uint32_t)&p_dummy[0];
+		p_gmac->GMAC_TBQBAPQ[i] = (uint32_t)&p_dummy[1];
+	}
+
+	/* Writing the bottom half disables the address until the top one. */
+	p_gmac->GMAC_SA[0].GMAC_SAB = p_cfg->uc_mac[0] |
+			(p_cfg->uc_mac[1] << 8) | (p_cfg->uc_mac[2] << 16) |
+			((uint32_t)p_cfg->uc_mac[3] << 24);
+	p_gmac->GMAC_SA[0].GMAC_SAT = p_cfg->uc_mac[4] |
+			(p_cfg->uc_mac[5] << 8);
+
+	p_gmac->GMAC_NCR = GMAC_NCR_MPE |
+			(p_cfg->b_loopback ? GMAC_NCR_LBL : 0);
+	gs_p_gmac_dev = p_dev;
+
+	return STATUS_OK;
+}
+
+/**
+ * \brief Set the callback run from the GMAC interrupt.
+ */
+void gmac_set_callback(gmac_dev_t *p_dev, gmac_callback_t callback,
+		void *p_ctx)
+{
+	irqflags_t flags = cpu_irq_save();
+
+	p_dev->callback = callback;
+	p_dev->p_ctx = p_ctx;
+	cpu_irq_restore(flags);
+}
+
+/**
+ * \brief Wait for the management logic to be idle.
+ */
+static bool gmac_phy_wait(Gmac *p_gmac)
+{
+	uint32_t ul_timeout = GMAC_TIMEOUT;
+
+	while (!(p_gmac->GMAC_NSR & GMAC_NSR_IDLE)) {
+		if (!--ul_timeout) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * \brief Read a PHY register through the management interface.
+ *
+ * \retval STATUS_OK on success.
+ * \retval ERR_TIMEOUT if the management frame did not complete.
+ */
+status_code_t gmac_phy_read(Gmac *p_gmac, uint8_t uc_phy, uint8_t uc_reg,
+		uint16_t *p_us_value)
+{
+	if (!gmac_phy_wait(p_gmac)) {
+		return ERR_TIMEOUT;
+	}
+	p_gmac->GMAC_MAN = GMAC_MAN_CLTTO | GMAC_MAN_OP(GMAC_MAN_READ) |
+			GMAC_MAN_WTN(2) | GMAC_MAN_PHYA(uc_phy) | GMAC_MAN_REGA(uc_reg);
+	if (!gmac_phy_wait(p_gmac)) {
+		return ERR_TIMEOUT;
+	}
+	*p_us_value = p_gmac->GMAC_MAN & GMAC_MAN_DATA_Msk;
+	return STATUS_OK;
+}
+
+/**
+ * \brief Write a PHY register through the management interface.
+ *
+ * \retval STATUS_OK on success.
+ * \retval ERR_TIMEOUT if the management frame did not complete.
+ */
+status_code_t gmac_phy_write(Gmac *p_gmac, uint8_t uc_phy, uint8_t uc_reg,
+		uint16_t us_value)
+{
+	if (!gmac_phy_wait(p_gmac)) {
+		return ERR_TIMEOUT;
+	}
+	p_gmac->GMAC_MAN = GMAC_MAN_CLTTO | GMAC_MAN_OP(GMAC_MAN_WRITE) |
+			GMAC_MAN_WTN(2) | GMAC_MAN_PHYA(uc_phy) | GMAC_MAN_REGA(uc_reg) |
+			GMAC_MAN_DATA(us_value);
+	return gmac_phy_wait(p_gmac) ? STATUS_OK : ERR_TIMEOUT;
+}
+
+/**
+ * \brief Set the speed and duplex negotiated by the PHY.
+ */
+void gmac_set_link(Gmac *p_gmac, bool b_100m, bool b_full_duplex)
+{
+	uint32_t ul_ncfgr = p_gmac->GMAC_NCFGR & ~(GMAC_NCFGR_SPD | GMAC_NCFGR_FD);
+
+	if (b_100m) {
+		ul_ncfgr |= GMAC_NCFGR_SPD;
+	}
+	if (b_full_duplex) {
+		ul_ncfgr |= GMAC_NCFGR_FD;
+	}
+	p_gmac->GMAC_NCFGR = ul_ncfgr;
+}
+
+/**
+ * \brief Enable or disable the receiver and the transmitter.
+ *
+ * Disabling them drops the frames in progress. The receive ring is kept,
+ * the transmitter restarts at the base of its ring: disable it with no
+ * frame posted.
+ */
+void gmac_enable(gmac_dev_t *p_dev, bool b_enable)
+{
+	if (b_enable) {
+		p_dev->p_gmac->GMAC_NCR |= GMAC_NCR_RXEN | GMAC_NCR_TXEN;
+	} else {
+		p_dev->p_gmac->GMAC_NCR &= ~(GMAC_NCR_RXEN | GMAC_NCR_TXEN);
+	}
+}
+
+/**
+ * \brief Give an empty buffer to the next free receive slot.
+ *
+ * \param p_buf Buffer of gmac_config_t::us_rx_buf_size bytes, 4 byte
+ * aligned.
+ *
+ * \return false if every slot already holds a buffer.
+ */
+bool gmac_rx_refill(gmac_dev_t *p_dev, void *p_buf)
+{
+	gmac_desc_t *p_desc;
+	uint32_t ul_slot = p_dev->us_rx_refill;
+
+	if (p_dev->us_rx_posted == p_dev->us_rx_count) {
+		return false;
+	}
+	p_desc = &p_dev->p_rx[ul_slot];
+	p_desc->ul_status = 0;
+	/* Clearing the ownership bit hands the slot to the GMAC. */
+	__DMB();
+	p_desc->ul_addr = ((uint32_t)p_buf & GMAC_RXD_ADDR_Msk) |
+			(p_desc->ul_addr & GMAC_RXD_WRAP);
+	p_dev->us_rx_refill = (ul_slot + 1) % p_dev->us_rx_count;
+	p_dev->us_rx_posted++;
+	return true;
+}
+
+/**
+ * \brief Take the buffer of the next received frame.
+ *
+ * The slot is left empty for gmac_rx_refill().
+ *
+ * \param p_ul_len Frame length, without FCS, or 0 if the frame was
+ * malformed: the buffer is returned all the same, to be reused.
+ *
+ * \return The buffer, or NULL if no frame is waiting.
+ */
+void *gmac_rx_take(gmac_dev_t *p_dev, uint32_t *p_ul_len)
+{
+	gmac_desc_t *p_desc;
+	uint32_t ul_slot = p_dev->us_rx_take;
+	uint32_t ul_addr, ul_status;
+
+	if (!gmac_rx_pending(p_dev)) {
+		return NULL;
+	}
+	p_desc = &p_dev->p_rx[ul_slot];
+	/* The status is valid once the ownership bit is set. */
+	__DMB();
+	ul_addr = p_desc->ul_addr;
+	ul_status = p_desc->ul_status;
+	p_desc->ul_addr = GMAC_RXD_OWNERSHIP | (ul_addr & GMAC_RXD_WRAP);
+	p_dev->us_rx_take = (ul_slot + 1) % p_dev->us_rx_count;
+	p_dev->us_rx_posted--;
+
+	if ((ul_status & (GMAC_RXD_SOF | GMAC_RXD_EOF)) !=
+			(GMAC_RXD_SOF | GMAC_RXD_EOF)) {
+		/* Spread over several buffers: not a frame this MAC accepts. */
+		p_dev->ul_rx_errors++;
+		*p_ul_len = 0;
+	} else {
+		p_dev->ul_rx_frames++;
+		*p_ul_len = ul_status & GMAC_RXD_LEN_Msk;
+	}
+	return (void *)(ul_addr & GMAC_RXD_ADDR_Msk);
+}
+
+/**
+ * \brief Queue a frame made of one or more buffers.
+ *
+ * The frame is handed to the GMAC in one step, once all its descriptors are
+ * written. It is sent after the next gmac_tx_start(), so several frames can
+ * be queued for one start. Frames shorter than the minimum are padded by
+ * the GMAC, which also appends the FCS.
+ *
+ * \return false if the ring does not have \a ul_count free descriptors, or
+ * the transmitter is being reset after a fault.
+ */
+bool gmac_tx_post(gmac_dev_t *p_dev, const gmac_seg_t *p_segs,
+		uint32_t ul_count)
+{
+	uint32_t ul_last = p_dev->us_tx_count - 1;
+	uint32_t i = ul_count;
+
+	if (!ul_count || ul_count > gmac_tx_free(p_dev) || p_dev->b_tx_fault) {
+		return false;
+	}
+	/* Back to front: the first descriptor releases the whole frame. */
+	while (i--) {
+		uint32_t ul_slot = (p_dev->us_tx_post + i) % p_dev->us_tx_count;
+		gmac_desc_t *p_desc = &p_dev->p_tx[ul_slot];
+		uint32_t ul_status = (p_segs[i].ul_len & GMAC_TXD_LEN_Msk) |
+				(ul_slot == ul_last ? GMAC_TXD_WRAP : 0) |
+				(i == ul_count - 1 ? GMAC_TXD_LAST : 0);
+
+		p_desc->ul_addr = (uint32_t)p_segs[i].p_data;
+		if (i == 0) {
+			__DMB();
+		}
+		p_desc->ul_status = ul_status;
+	}
+	p_dev->us_tx_post = (p_dev->us_tx_post + ul_count) % p_dev->us_tx_count;
+	p_dev->us_tx_posted += ul_count;
+	return true;
+}
+
+/**
+ * \brief Give back the frames still queued after a transmit fault, then
+ * restart the transmitter at the start of the ring.
+ *
+ * A fault stops the transmitter and moves its queue pointer back to the
+ * ring base. Disabling it drops what it was doing.
+ */
+static void gmac_tx_flush(gmac_dev_t *p_dev)
+{
+	uint32_t ul_slot = p_dev->us_tx_reclaim;
+	uint32_t i;
+
+	p_dev->p_gmac->GMAC_NCR &= ~GMAC_NCR_TXEN;
+	for (i = 0; i < p_dev->us_tx_posted; i++) {
+		gmac_desc_t *p_desc = &p_dev->p_tx[ul_slot];
+
+		/* Frames not sent yet end as failed. */
+		if (!(p_desc->ul_status & GMAC_TXD_USED)) {
+			p_desc->ul_status |= GMAC_TXD_USED | GMAC_TXD_TFC;
+		}
+		ul_slot = (ul_slot + 1) % p_dev->us_tx_count;
+	}
+}
+
+/**
+ * \brief Take back the first buffer of the next frame sent.
+ *
+ * Frames come back in the order they were posted, once the GMAC is done
+ * with them, successful or not (see gmac_dev_t::ul_tx_errors). The other
+ * buffers of the frame are released at the same time.
+ *
+ * If a fault stopped the transmitter, the frames still queued are returned
+ * as failed, and the transmitter restarts once they all are.
+ *
+ * \return The buffer of the first gmac_seg_t of the frame, or NULL if no
+ * frame is done.
+ */
+void *gmac_tx_reclaim(gmac_dev_t *p_dev)
+{
+	gmac_desc_t *p_desc;
+	uint32_t ul_slot = p_dev->us_tx_reclaim;
+	uint32_t ul_status, ul_seg_status, ul_count = 0;
+	void *p_buf;
+
+	if (p_dev->b_tx_fault && (p_dev->p_gmac->GMAC_NCR & GMAC_NCR_TXEN)) {
+		gmac_tx_flush(p_dev);
+	}
+	if (!p_dev->us_tx_posted) {
+		if (p_dev->b_tx_fault) {
+			p_dev->us_tx_reclaim = p_dev->us_tx_post = 0;
+			p_dev->p_gmac->GMAC_TBQB = (uint32_t)p_dev->p_tx;
+			p_dev->b_tx_fault = false;
+			p_dev->p_gmac->GMAC_NCR |= GMAC_NCR_TXEN;
+		}
+		return NULL;
+	}
+
+	p_desc = &p_dev->p_tx[ul_slot];
+	ul_status = p_desc->ul_status;
+	if (!(ul_status & GMAC_TXD_USED)) {
+		return NULL;
+	}
+	/* Only the first descriptor is written back by the GMAC. */
+	__DMB();
+	p_buf = (void *)p_desc->ul_addr;
+	do {
+		p_desc = &p_dev->p_tx[ul_slot];
+		ul_seg_status = p_desc->ul_status;
+		p_desc->ul_status = GMAC_TXD_USED | (ul_seg_status & GMAC_TXD_WRAP);
+		ul_slot = (ul_slot + 1) % p_dev->us_tx_count;
+		ul_count++;
+	} while (!(ul_seg_status & GMAC_TXD_LAST) &&
+			ul_count < p_dev->us_tx_posted);
+	p_dev->us_tx_reclaim = ul_slot;
+	p_dev->us_tx_posted -= ul_count;
+
+	if (ul_status & GMAC_TXD_ERRORS) {
+		p_dev->ul_tx_errors++;
+	} else {
+		p_dev->ul_tx_frames++;
+	}
+	return p_buf;
+}
+
+/**
+ * \brief GMAC interrupt handler.
+ */
+void GMAC_Handler(void)
+{
+	gmac_dev_t *p_dev = gs_p_gmac_dev;
+	Gmac *p_gmac;
+	uint32_t ul_isr;
+
+	if (p_dev == NULL) {
+		return;
+	}
+	p_gmac = p_dev->p_gmac;
+	/* Cleared on read. */
+	ul_isr = p_gmac->GMAC_ISR & ~p_gmac->GMAC_IMR;
+
+	if (ul_isr & GMAC_IER_TX_FAULTS) {
+		p_gmac->GMAC_TSR = GMAC_TSR_RLE | GMAC_TSR_TFC | GMAC_TSR_HRESP;
+		p_dev->b_tx_fault = true;
+	}
+	if (p_dev->callback) {
+		p_dev->callback(p_dev, ul_isr);
+	}
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
@@ -0,0 +1,235 @@
+/**
+ * \file
+ *
+ * \brief SAM Ethernet MAC (GMAC) driver.
+ *
+ */
+
+#ifndef GMAC_H_INCLUDED
+#define GMAC_H_INCLUDED
+
+#include "compiler.h"
+#include "status_codes.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \defgroup sam_drivers_gmac_group Ethernet MAC (GMAC)
+ *
+ * MAC setup, PHY management and frame transfers through receive and
+ * transmit descriptor rings of queue 0.
+ *
+ * The driver never copies frame data and never allocates: it moves buffer
+ * addresses in and out of the rings, and the caller owns the buffers the
+ * rest of the time.
+ * - Receive: gmac_rx_refill() gives an empty buffer to the next free ring
+ *   slot, gmac_rx_take() returns the buffer of the next received frame.
+ *   Each buffer holds a whole frame, so they are at least
+ *   GMAC_FRAME_SIZE_MAX bytes.
+ * - Transmit: gmac_tx_post() queues a frame made of one or more buffers
+ *   (scatter-gather), gmac_tx_start() starts the transmitter on everything
+ *   queued so far, and gmac_tx_reclaim() returns the first buffer of each
+ *   frame sent.
+ *
+ * The descriptors are touched by the CPU and the GMAC one word at a time,
+ * so they must not be cached (see \ref utils_dma_buf_group,
+ * DMA_BUF_NOCACHE). The frame buffers may be cached: their maintenance is
+ * the caller's, before gmac_rx_refill() and gmac_tx_post() and after
+ * gmac_rx_take().
+ *
+ * The priority queues are not used. They are pointed at an empty
+ * descriptor each, as the GMAC fetches them whatever their use.
+ *
+ * GMAC_Handler() is provided by the driver. It reads and clears the
+ * interrupt status and passes the enabled flags to the callback.
+ *
+ * @{
+ */
+
+/** Largest frame, without the FCS which is removed on receive. */
+#define GMAC_FRAME_SIZE_MAX       1536
+
+/** Receive buffer size granularity. */
+#define GMAC_RX_UNIT_SIZE         64
+
+/** Receive descriptor, address word. */
+#define GMAC_RXD_OWNERSHIP        (1u << 0)
+#define GMAC_RXD_WRAP             (1u << 1)
+#define GMAC_RXD_ADDR_Msk         0xFFFFFFFCu
+/** Receive descriptor, status word. */
+#define GMAC_RXD_SOF              (1u << 14)
+#define GMAC_RXD_EOF              (1u << 15)
+#define GMAC_RXD_LEN_Msk          0x1FFFu
+
+/** Transmit descriptor, status word. */
+#define GMAC_TXD_USED             (1u << 31)
+#define GMAC_TXD_WRAP             (1u << 30)
+#define GMAC_TXD_RLE              (1u << 29)
+#define GMAC_TXD_TFC              (1u << 27)
+#define GMAC_TXD_LCO              (1u << 26)
+#define GMAC_TXD_LAST             (1u << 15)
+#define GMAC_TXD_LEN_Msk          0x3FFFu
+#define GMAC_TXD_ERRORS           (GMAC_TXD_RLE | GMAC_TXD_TFC | GMAC_TXD_LCO)
+
+/** Interrupts after which the transmitter must be reset, see
+ * gmac_tx_reclaim(). */
+#define GMAC_IER_TX_FAULTS \
+	(GMAC_IER_TUR | GMAC_IER_RLEX | GMAC_IER_TFC | GMAC_IER_HRESP)
+
+/** Buffer descriptor. */
+typedef struct gmac_desc {
+	volatile uint32_t ul_addr;
+	volatile uint32_t ul_status;
+} gmac_desc_t;
+
+/** One buffer of a frame to send. */
+typedef struct gmac_seg {
+	const void *p_data;
+	uint32_t ul_len;
+} gmac_seg_t;
+
+/** MAC configuration. */
+typedef struct gmac_config {
+	/** Descriptors, 8 byte aligned, of gmac_desc_size() bytes. */
+	gmac_desc_t *p_desc;
+	/** Ring sizes. */
+	uint16_t us_rx_count;
+	uint16_t us_tx_count;
+	/**
+	 * Receive buffer size, a multiple of GMAC_RX_UNIT_SIZE of at least
+	 * GMAC_FRAME_SIZE_MAX.
+	 */
+	uint16_t us_rx_buf_size;
+	/** MCK, for the management clock. */
+	uint32_t ul_mck_hz;
+	/** Station address. */
+	uint8_t uc_mac[6];
+	/** RMII rather than MII. */
+	bool b_rmii;
+	/** Receive all frames, whatever their destination. */
+	bool b_promiscuous;
+	/** Internal loopback: frames sent are received, the PHY is ignored. */
+	bool b_loopback;
+} gmac_config_t;
+
+struct gmac_dev;
+
+/**
+ * Interrupt callback, run from the GMAC interrupt with the GMAC_IER_* flags
+ * that were raised and enabled.
+ */
+typedef void (*gmac_callback_t)(struct gmac_dev *p_dev, uint32_t ul_isr);
+
+/** Driver state. */
+typedef struct gmac_dev {
+	Gmac *p_gmac;
+	gmac_desc_t *p_rx;
+	gmac_desc_t *p_tx;
+	uint16_t us_rx_count;
+	uint16_t us_tx_count;
+	/** Next receive slot to take, next to refill, slots holding a buffer. */
+	uint16_t us_rx_take;
+	uint16_t us_rx_refill;
+	uint16_t us_rx_posted;
+	/** Next transmit slot to reclaim, next to post, slots in use. */
+	uint16_t us_tx_reclaim;
+	uint16_t us_tx_post;
+	uint16_t us_tx_posted;
+	/** The transmitter stopped on an error, set by the interrupt. */
+	volatile bool b_tx_fault;
+	gmac_callback_t callback;
+	void *p_ctx;
+	/** Frames received, dropped as malformed, sent, failed. */
+	uint32_t ul_rx_frames;
+	uint32_t ul_rx_errors;
+	uint32_t ul_tx_frames;
+	uint32_t ul_tx_errors;
+} gmac_dev_t;
+
+uint32_t gmac_desc_size(const gmac_config_t *p_cfg);
+status_code_t gmac_init(gmac_dev_t *p_dev, Gmac *p_gmac,
+		const gmac_config_t *p_cfg);
+void gmac_set_callback(gmac_dev_t *p_dev, gmac_callback_t callback,
+		void *p_ctx);
+void gmac_set_mdc_clock(Gmac *p_gmac, uint32_t ul_mck_hz);
+status_code_t gmac_phy_read(Gmac *p_gmac, uint8_t uc_phy, uint8_t uc_reg,
+		uint16_t *p_us_value);
+status_code_t gmac_phy_write(Gmac *p_gmac, uint8_t uc_phy, uint8_t uc_reg,
+		uint16_t us_value);
+void gmac_set_link(Gmac *p_gmac, bool b_100m, bool b_full_duplex);
+void gmac_enable(gmac_dev_t *p_dev, bool b_enable);
+bool gmac_rx_refill(gmac_dev_t *p_dev, void *p_buf);
+void *gmac_rx_take(gmac_dev_t *p_dev, uint32_t *p_ul_len);
+bool gmac_tx_post(gmac_dev_t *p_dev, const gmac_seg_t *p_segs,
+		uint32_t ul_count);
+void *gmac_tx_reclaim(gmac_dev_t *p_dev);
+
+/**
+ * \brief Tell whether a received frame is waiting in the ring.
+ */
+static inline bool gmac_rx_pending(gmac_dev_t *p_dev)
+{
+	return p_dev->us_rx_posted &&
+			(p_dev->p_rx[p_dev->us_rx_take].ul_addr & GMAC_RXD_OWNERSHIP);
+}
+
+/**
+ * \brief Tell whether a sent frame is waiting for gmac_tx_reclaim().
+ */
+static inline bool gmac_tx_done_pending(gmac_dev_t *p_dev)
+{
+	return p_dev->us_tx_posted &&
+			(p_dev->p_tx[p_dev->us_tx_reclaim].ul_status & GMAC_TXD_USED);
+}
+
+/**
+ * \brief Number of free transmit descriptors.
+ */
+static inline uint32_t gmac_tx_free(gmac_dev_t *p_dev)
+{
+	return p_dev->us_tx_count - p_dev->us_tx_posted;
+}
+
+/**
+ * \brief Start sending the frames posted so far.
+ */
+static inline void gmac_tx_start(gmac_dev_t *p_dev)
+{
+	/* Descriptor writes before the start. */
+	__DMB();
+	p_dev->p_gmac->GMAC_NCR |= GMAC_NCR_TSTART;
+}
+
+/**
+ * \brief Enable interrupt sources (GMAC_IER_* bits).
+ */
+static inline void gmac_enable_interrupt(gmac_dev_t *p_dev, uint32_t ul_mask)
+{
+	p_dev->p_gmac->GMAC_IER = ul_mask;
+}
+
+/**
+ * \brief Disable interrupt sources (GMAC_IER_* bits).
+ */
+static inline void gmac_disable_interrupt(gmac_dev_t *p_dev, uint32_t ul_mask)
+{
+	p_dev->p_gmac->GMAC_IDR = ul_mask;
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+#endif /* GMAC_H_INCLUDED */
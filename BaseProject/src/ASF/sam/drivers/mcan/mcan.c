@@ -0,0 +1,664 @@
+/**
+ * \file
+ *
+ * \brief SAM Controller Area Network (MCAN) driver.
+ *
+ */
+
+#include <string.h>
+#include "mcan.h"
+#include "interrupt.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \addtogroup sam_drivers_mcan_group
+ *
+ * @{
+ */
+
+/** Longest wait, in loop iterations, for CCCR.INIT to change. */
+#define MCAN_TIMEOUT              10000
+
+/** Receive and transmit element header words. */
+#define MCAN_R0_ESI               (1u << 31)
+#define MCAN_R0_XTD               (1u << 30)
+#define MCAN_R0_RTR               (1u << 29)
+#define MCAN_R0_ID_Msk            0x1FFFFFFFu
+#define MCAN_R0_STDID_Pos         18
+#define MCAN_R1_ANMF              (1u << 31)
+#define MCAN_R1_FIDX_Pos          24
+#define MCAN_R1_FIDX_Msk          (0x7Fu << MCAN_R1_FIDX_Pos)
+#define MCAN_R1_EDL               (1u << 21)
+#define MCAN_R1_BRS               (1u << 20)
+#define MCAN_R1_DLC_Pos           16
+#define MCAN_R1_DLC_Msk           (0xFu << MCAN_R1_DLC_Pos)
+#define MCAN_R1_RXTS_Msk          0xFFFFu
+
+/** Filter element fields. */
+#define MCAN_SF_SFT_Pos           30
+#define MCAN_SF_SFEC_Pos          27
+#define MCAN_SF_SFID1_Pos         16
+#define MCAN_SF_ID_Msk            0x7FFu
+#define MCAN_EF_EFEC_Pos          29
+#define MCAN_EF_EFT_Pos           30
+#define MCAN_EF_ID_Msk            0x1FFFFFFFu
+
+/** Filter element configuration (SFEC and EFEC) for each action. */
+static const uint8_t gs_uc_filter_config[] = {
+	[MCAN_FILTER_DISABLE] = 0,
+	[MCAN_FILTER_TO_FIFO_0] = 1,
+	[MCAN_FILTER_TO_FIFO_1] = 2,
+	[MCAN_FILTER_REJECT] = 3,
+};
+
+/** Payload length of each CAN FD data length code. */
+static const uint8_t gs_uc_dlc_len[16] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64
+};
+
+/** Instances served by MCAN0_Handler() and MCAN1_Handler(). */
+static mcan_dev_t *gs_p_mcan_devs[2];
+
+/**
+ * \brief Element size code (F0DS, F1DS, RBDS, TBDS) of a payload size.
+ *
+ * \return The code, or -1 if \a ul_size is not an element size.
+ */
+static int32_t mcan_data_size_code(uint32_t ul_size)
+{
+	int32_t l_code;
+
+	for (l_code = 0; l_code < 8; l_code++) {
+		if (gs_uc_dlc_len[l_code + 8] == ul_size) {
+			return l_code;
+		}
+	}
+	return -1;
+}
+
+/**
+ * \brief Smallest data length code that holds a payload.
+ */
+static uint32_t mcan_len_to_dlc(uint32_t ul_len)
+{
+	uint32_t ul_dlc = 8;
+
+	if (ul_len <= 8) {
+		return ul_len;
+	}
+	while (ul_dlc < 15 && gs_uc_dlc_len[ul_dlc] < ul_len) {
+		ul_dlc++;
+	}
+	return ul_dlc;
+}
+
+/** Bit timing register field ranges, in time quanta. */
+typedef struct {
+	uint32_t ul_brp_max;
+	uint32_t ul_tseg1_max;
+	uint32_t ul_tseg2_max;
+	uint32_t ul_sjw_max;
+} mcan_timing_limits_t;
+
+/** Bit timing, in time quanta, before the -1 of the register fields. */
+typedef struct {
+	uint32_t ul_brp;
+	uint32_t ul_tseg1;
+	uint32_t ul_tseg2;
+	uint32_t ul_sjw;
+} mcan_timing_t;
+
+/**
+ * \brief Find an exact bit timing with the sample point near 80%.
+ *
+ * The number of time quanta per bit is taken as large as the limits allow,
+ * for the finest phase adjustment.
+ *
+ * \retval true if the bit rate can be reached exactly.
+ */
+static bool mcan_bit_timing(uint32_t ul_clock_hz, uint32_t ul_bitrate,
+		const mcan_timing_limits_t *p_limits, mcan_timing_t *p_timing)
+{
+	uint32_t ul_tq;
+
+	if (!ul_bitrate) {
+		return false;
+	}
+	for (ul_tq = 1 + p_limits->ul_tseg1_max + p_limits->ul_tseg2_max;
+			ul_tq >= 4; ul_tq--) {
+		uint32_t ul_brp;
+
+		if (ul_clock_hz % (ul_bitrate * ul_tq)) {
+			continue;
+		}
+		ul_brp = ul_clock_hz / (ul_bitrate * ul_tq);
+		if (ul_brp < 1 || ul_brp > p_limits->ul_brp_max) {
+			continue;
+		}
+		p_timing->ul_brp = ul_brp;
+		p_timing->ul_tseg1 = (ul_tq * 4 + 2) / 5 - 1;
+		if (p_timing->ul_tseg1 > p_limits->ul_tseg1_max) {
+			p_timing->ul_tseg1 = p_limits->ul_tseg1_max;
+		}
+		p_timing->ul_tseg2 = ul_tq - 1 - p_timing->ul_tseg1;
+		if (p_timing->ul_tseg2 > p_limits->ul_tseg2_max) {
+			continue;
+		}
+		p_timing->ul_sjw = Min(p_timing->ul_tseg2, p_limits->ul_sjw_max);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * \brief Message RAM needed by a configuration, in bytes.
+ */
+uint32_t mcan_ram_size(const mcan_config_t *p_cfg)
+{
+	uint32_t ul_elem_words = 2 + p_cfg->uc_data_size / 4;
+
+	return 4 * (p_cfg->uc_std_filters + 2 * p_cfg->uc_ext_filters +
+			ul_elem_words * (p_cfg->uc_rx0_size + p_cfg->uc_rx1_size +
+			p_cfg->uc_tx_size));
+}
+
+/**
+ * \brief Wait for CCCR.INIT to reach a value.
+ */
+static bool mcan_wait_init(Mcan *p_mcan, uint32_t ul_init)
+{
+	uint32_t ul_timeout = MCAN_TIMEOUT;
+
+	while ((p_mcan->MCAN_CCCR & MCAN_CCCR_INIT) != ul_init) {
+		if (!--ul_timeout) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * \brief Configure a controller and lay out its message RAM.
+ *
+ * The peripheral clock and the core clock (PCK5) must be running. The
+ * controller is left stopped, with all filters disabled and no interrupt
+ * source enabled, see mcan_start().
+ *
+ * \param p_dev Driver state, kept by the driver until the next init.
+ * \param p_mcan MCAN0 or MCAN1.
+ * \param p_ram Message RAM, word aligned, of mcan_ram_size() bytes.
+ * \param p_cfg Configuration.
+ *
+ * \retval STATUS_OK on success.
+ * \retval ERR_INVALID_ARG if the layout does not fit the controller or the
+ * message RAM window, or a bit rate cannot be reached.
+ * \retval ERR_TIMEOUT if the controller does not enter initialization.
+ */
+status_code_t mcan_init(mcan_dev_t *p_dev, Mcan *p_mcan, void *p_ram,
+		const mcan_config_t *p_cfg)
+{
+	static const mcan_timing_limits_t nominal_limits = {1024, 64, 16, 16};
+	static const mcan_timing_limits_t data_limits = {32, 16, 8, 4};
+	uint32_t ul_base = (uint32_t)p_ram;
+	uint32_t ul_size = mcan_ram_size(p_cfg);
+	uint32_t ul_offset, ul_tcp, ul_cccr;
+	int32_t l_code = mcan_data_size_code(p_cfg->uc_data_size);
+	mcan_timing_t nominal, data;
+
+	if (l_code < 0 || (ul_base & 3) ||
+			(ul_base >> 16) != ((ul_base + ul_size - 1) >> 16) ||
+			p_cfg->uc_std_filters > MCAN_STD_FILTERS_MAX ||
+			p_cfg->uc_ext_filters > MCAN_EXT_FILTERS_MAX ||
+			p_cfg->uc_rx0_size > MCAN_RX_FIFO_MAX ||
+			p_cfg->uc_rx1_size > MCAN_RX_FIFO_MAX ||
+			p_cfg->uc_rx0_watermark > p_cfg->uc_rx0_size ||
+			p_cfg->uc_rx1_watermark > p_cfg->uc_rx1_size ||
+			!p_cfg->uc_tx_size || p_cfg->uc_tx_size > MCAN_TX_FIFO_MAX) {
+		return ERR_INVALID_ARG;
+	}
+	if (!mcan_bit_timing(p_cfg->ul_clock_hz, p_cfg->ul_bitrate,
+			&nominal_limits, &nominal)) {
+		return ERR_INVALID_ARG;
+	}
+	if (p_cfg->mode == MCAN_MODE_FD_BRS && !mcan_bit_timing(
+			p_cfg->ul_clock_hz, p_cfg->ul_data_bitrate, &data_limits, &data)) {
+		return ERR_INVALID_ARG;
+	}
+
+	memset(p_dev, 0, sizeof(*p_dev));
+	p_dev->p_mcan = p_mcan;
+	p_dev->uc_std_filters = p_cfg->uc_std_filters;
+	p_dev->uc_ext_filters = p_cfg->uc_ext_filters;
+	p_dev->uc_rx_size[0] = p_cfg->uc_rx0_size;
+	p_dev->uc_rx_size[1] = p_cfg->uc_rx1_size;
+	p_dev->uc_tx_size = p_cfg->uc_tx_size;
+	p_dev->uc_data_size = p_cfg->uc_data_size;
+	p_dev->uc_elem_words = 2 + p_cfg->uc_data_size / 4;
+	p_dev->mode = p_cfg->mode;
+
+	p_mcan->MCAN_CCCR |= MCAN_CCCR_INIT;
+	if (!mcan_wait_init(p_mcan, MCAN_CCCR_INIT)) {
+		return ERR_TIMEOUT;
+	}
+	p_mcan->MCAN_CCCR |= MCAN_CCCR_CCE;
+	p_mcan->MCAN_IE = 0;
+	p_mcan->MCAN_IR = 0xFFFFFFFF;
+
+	/* High half of the message RAM addresses. */
+	if (p_mcan == MCAN0) {
+		MATRIX->CCFG_CAN0 = (MATRIX->CCFG_CAN0 & ~CCFG_CAN0_CAN0DMABA_Msk) |
+				(ul_base & CCFG_CAN0_CAN0DMABA_Msk);
+		gs_p_mcan_devs[0] = p_dev;
+	} else {
+		MATRIX->CCFG_SYSIO = (MATRIX->CCFG_SYSIO & ~CCFG_SYSIO_CAN1DMABA_Msk) |
+				(ul_base & CCFG_SYSIO_CAN1DMABA_Msk);
+		gs_p_mcan_devs[1] = p_dev;
+	}
+
+	p_mcan->MCAN_BTP = MCAN_BTP_BRP(nominal.ul_brp - 1) |
+			MCAN_BTP_TSEG1(nominal.ul_tseg1 - 1) |
+			MCAN_BTP_TSEG2(nominal.ul_tseg2 - 1) |
+			MCAN_BTP_SJW(nominal.ul_sjw - 1);
+	if (p_cfg->mode == MCAN_MODE_FD_BRS) {
+		/* Without bit rate switching the data phase keeps BTP. */
+		p_mcan->MCAN_FBTP = MCAN_FBTP_FBRP(data.ul_brp - 1) |
+				MCAN_FBTP_FTSEG1(data.ul_tseg1 - 1) |
+				MCAN_FBTP_FTSEG2(data.ul_tseg2 - 1) |
+				MCAN_FBTP_FSJW(data.ul_sjw - 1);
+		if (data.ul_brp * (1 + data.ul_tseg1) <=
+				(MCAN_FBTP_TDCO_Msk >> MCAN_FBTP_TDCO_Pos)) {
+			/* Compare the received bits at the sample point, past the
+			 * transceiver loop delay. */
+			p_mcan->MCAN_FBTP |= MCAN_FBTP_TDC_ENABLED |
+					MCAN_FBTP_TDCO(data.ul_brp * (1 + data.ul_tseg1));
+		}
+	}
+
+	ul_cccr = p_mcan->MCAN_CCCR & ~(MCAN_CCCR_CME_Msk | MCAN_CCCR_CMR_Msk |
+			MCAN_CCCR_TEST | MCAN_CCCR_MON | MCAN_CCCR_DAR);
+	if (p_cfg->mode == MCAN_MODE_FD) {
+		ul_cccr |= MCAN_CCCR_CME(1);
+	} else if (p_cfg->mode == MCAN_MODE_FD_BRS) {
+		ul_cccr |= MCAN_CCCR_CME(2);
+	}
+	if (p_cfg->b_loopback) {
+		ul_cccr |= MCAN_CCCR_TEST | MCAN_CCCR_MON;
+	}
+	p_mcan->MCAN_CCCR = ul_cccr;
+	p_mcan->MCAN_TEST = p_cfg->b_loopback ? MCAN_TEST_LBCK_ENABLED : 0;
+
+	/* Message RAM layout. */
+	ul_offset = ul_base & 0xFFFF;
+	p_dev->p_std_filters = (volatile uint32_t *)ul_base;
+	p_mcan->MCAN_SIDFC = MCAN_SIDFC_FLSSA(ul_offset >> 2) |
+			MCAN_SIDFC_LSS(p_cfg->uc_std_filters);
+	ul_offset += 4 * p_cfg->uc_std_filters;
+	p_dev->p_ext_filters = p_dev->p_std_filters + p_cfg->uc_std_filters;
+	p_mcan->MCAN_XIDFC = MCAN_XIDFC_FLESA(ul_offset >> 2) |
+			MCAN_XIDFC_LSE(p_cfg->uc_ext_filters);
+	p_mcan->MCAN_XIDAM = MCAN_XIDAM_EIDM_Msk;
+	ul_offset += 8 * p_cfg->uc_ext_filters;
+	p_dev->p_rx[0] = p_dev->p_ext_filters + 2 * p_cfg->uc_ext_filters;
+	p_mcan->MCAN_RXF0C = MCAN_RXF0C_F0SA(ul_offset >> 2) |
+			MCAN_RXF0C_F0S(p_cfg->uc_rx0_size) |
+			MCAN_RXF0C_F0WM(p_cfg->uc_rx0_watermark);
+	ul_offset += 4 * p_dev->uc_elem_words * p_cfg->uc_rx0_size;
+	p_dev->p_rx[1] = p_dev->p_rx[0] + p_dev->uc_elem_words * p_cfg->uc_rx0_size;
+	p_mcan->MCAN_RXF1C = MCAN_RXF1C_F1SA(ul_offset >> 2) |
+			MCAN_RXF1C_F1S(p_cfg->uc_rx1_size) |
+			MCAN_RXF1C_F1WM(p_cfg->uc_rx1_watermark);
+	ul_offset += 4 * p_dev->uc_elem_words * p_cfg->uc_rx1_size;
+	p_dev->p_tx = p_dev->p_rx[1] + p_dev->uc_elem_words * p_cfg->uc_rx1_size;
+	p_mcan->MCAN_RXBC = 0;
+	p_mcan->MCAN_RXESC = MCAN_RXESC_F0DS(l_code) | MCAN_RXESC_F1DS(l_code) |
+			MCAN_RXESC_RBDS(l_code);
+	p_mcan->MCAN_TXBC = MCAN_TXBC_TBSA(ul_offset >> 2) | MCAN_TXBC_NDTB(0) |
+			MCAN_TXBC_TFQS(p_cfg->uc_tx_size);
+	p_mcan->MCAN_TXESC = MCAN_TXESC_TBDS(l_code);
+	p_mcan->MCAN_TXEFC = 0;
+	memset((void *)p_ram, 0, ul_size);
+
+	p_mcan->MCAN_GFC = MCAN_GFC_ANFS(p_cfg->nonmatch == MCAN_FILTER_TO_FIFO_1 ?
+			1 : p_cfg->nonmatch == MCAN_FILTER_TO_FIFO_0 ? 0 : 2) |
+			MCAN_GFC_ANFE(p_cfg->nonmatch == MCAN_FILTER_TO_FIFO_1 ?
+			1 : p_cfg->nonmatch == MCAN_FILTER_TO_FIFO_0 ? 0 : 2);
+
+	/* Timestamp and receive timeout in ticks of 1 to 16 bit times. */
+	ul_tcp = p_cfg->ul_rx0_timeout / (MCAN_TOCC_TOP_Msk >> MCAN_TOCC_TOP_Pos);
+	if (ul_tcp > 15) {
+		ul_tcp = 15;
+	}
+	p_dev->uc_tick_bits = ul_tcp + 1;
+	p_mcan->MCAN_TSCC = MCAN_TSCC_TSS_TCP_INC | MCAN_TSCC_TCP(ul_tcp);
+	if (p_cfg->ul_rx0_timeout) {
+		p_mcan->MCAN_TOCC = MCAN_TOCC_ETOC_TOS_CONTROLLED |
+				MCAN_TOCC_TOS_RX0_EV_TIMEOUT |
+				MCAN_TOCC_TOP(Max(p_cfg->ul_rx0_timeout / (ul_tcp + 1), 1));
+	} else {
+		p_mcan->MCAN_TOCC = 0;
+	}
+
+	/* All sources on line 0, transmission completed for every element. */
+	p_mcan->MCAN_ILS = 0;
+	p_mcan->MCAN_ILE = MCAN_ILE_EINT0;
+	p_mcan->MCAN_TXBTIE = 0xFFFFFFFFu >> (32 - p_cfg->uc_tx_size);
+
+	return STATUS_OK;
+}
+
+/**
+ * \brief Set the callback run from the MCAN interrupt.
+ */
+void mcan_set_callback(mcan_dev_t *p_dev, mcan_callback_t callback,
+		void *p_ctx)
+{
+	irqflags_t flags = cpu_irq_save();
+
+	p_dev->callback = callback;
+	p_dev->p_ctx = p_ctx;
+	cpu_irq_restore(flags);
+}
+
+/**
+ * \brief Join the bus, and select the transmit frame format.
+ */
+void mcan_start(mcan_dev_t *p_dev)
+{
+	Mcan *p_mcan = p_dev->p_mcan;
+
+	p_mcan->MCAN_CCCR &= ~MCAN_CCCR_INIT;
+	mcan_wait_init(p_mcan, 0);
+	if (p_dev->mode == MCAN_MODE_FD) {
+		p_mcan->MCAN_CCCR = (p_mcan->MCAN_CCCR & ~MCAN_CCCR_CMR_Msk) |
+				MCAN_CCCR_CMR_FD;
+	} else if (p_dev->mode == MCAN_MODE_FD_BRS) {
+		p_mcan->MCAN_CCCR = (p_mcan->MCAN_CCCR & ~MCAN_CCCR_CMR_Msk) |
+				MCAN_CCCR_CMR_FD_BITRATE_SWITCH;
+	}
+}
+
+/**
+ * \brief Leave the bus once the frame in progress, if any, is done.
+ * Pending transmissions are kept.
+ */
+void mcan_stop(mcan_dev_t *p_dev)
+{
+	p_dev->p_mcan->MCAN_CCCR |= MCAN_CCCR_INIT;
+	mcan_wait_init(p_dev->p_mcan, MCAN_CCCR_INIT);
+}
+
+/**
+ * \brief Set a standard (11-bit) identifier filter.
+ *
+ * Filters are tried in index order and the first match decides. They can
+ * be changed while the controller runs.
+ *
+ * \retval STATUS_OK on success.
+ * \retval ERR_INVALID_ARG if \a ul_index is out of the filter list.
+ */
+status_code_t mcan_set_std_filter(mcan_dev_t *p_dev, uint32_t ul_index,
+		const mcan_filter_t *p_filter)
+{
+	if (ul_index >= p_dev->uc_std_filters) {
+		return ERR_INVALID_ARG;
+	}
+	p_dev->p_std_filters[ul_index] =
+			((uint32_t)p_filter->type << MCAN_SF_SFT_Pos) |
+			((uint32_t)gs_uc_filter_config[p_filter->action] <<
+			MCAN_SF_SFEC_Pos) |
+			((p_filter->ul_id1 & MCAN_SF_ID_Msk) << MCAN_SF_SFID1_Pos) |
+			(p_filter->ul_id2 & MCAN_SF_ID_Msk);
+	return STATUS_OK;
+}
+
+/**
+ * \brief Set an extended (29-bit) identifier filter.
+ *
+ * \retval STATUS_OK on success.
+ * \retval ERR_INVALID_ARG if \a ul_index is out of the filter list.
+ */
+status_code_t mcan_set_ext_filter(mcan_dev_t *p_dev, uint32_t ul_index,
+		const mcan_filter_t *p_filter)
+{
+	volatile uint32_t *p_elem;
+	uint32_t ul_eft = p_filter->type;
+
+	if (ul_index >= p_dev->uc_ext_filters) {
+		return ERR_INVALID_ARG;
+	}
+	/* Ranges ignore XIDAM, which is left all ones anyway. */
+	if (p_filter->type == MCAN_FILTER_RANGE) {
+		ul_eft = 3;
+	}
+	p_elem = p_dev->p_ext_filters + 2 * ul_index;
+	/* Disable the element while its second word changes. */
+	p_elem[0] = 0;
+	p_elem[1] = (ul_eft << MCAN_EF_EFT_Pos) |
+			(p_filter->ul_id2 & MCAN_EF_ID_Msk);
+	p_elem[0] = ((uint32_t)gs_uc_filter_config[p_filter->action] <<
+			MCAN_EF_EFEC_Pos) | (p_filter->ul_id1 & MCAN_EF_ID_Msk);
+	return STATUS_OK;
+}
+
+/**
+ * \brief Take the frames waiting in a receive FIFO.
+ *
+ * All the frames copied are released with one acknowledge. May be called
+ * from the interrupt callback; a FIFO must not be read from two contexts
+ * at once.
+ *
+ * \param ul_fifo MCAN_RX_FIFO_0 or MCAN_RX_FIFO_1.
+ * \param p_frames Array receiving the frames.
+ * \param ul_max Size of \a p_frames.
+ *
+ * \return Number of frames copied.
+ */
+uint32_t mcan_rx_fifo_read(mcan_dev_t *p_dev, uint32_t ul_fifo,
+		mcan_frame_t *p_frames, uint32_t ul_max)
+{
+	Mcan *p_mcan = p_dev->p_mcan;
+	uint32_t ul_status = ul_fifo ? p_mcan->MCAN_RXF1S : p_mcan->MCAN_RXF0S;
+	uint32_t ul_size = p_dev->uc_rx_size[ul_fifo];
+	uint32_t ul_get = (ul_status & MCAN_RXF0S_F0GI_Msk) >> MCAN_RXF0S_F0GI_Pos;
+	uint32_t ul_count = ul_status & MCAN_RXF0S_F0FL_Msk;
+	uint32_t i;
+
+	if (ul_count > ul_max) {
+		ul_count = ul_max;
+	}
+	if (!ul_count) {
+		return 0;
+	}
+	/* Read the elements only after the fill level. */
+	__DMB();
+	for (i = 0; i < ul_count; i++) {
+		const volatile uint32_t *p_elem = p_dev->p_rx[ul_fifo] +
+				((ul_get + i) % ul_size) * p_dev->uc_elem_words;
+		mcan_frame_t *p_frame = &p_frames[i];
+		uint32_t ul_r0 = p_elem[0];
+		uint32_t ul_r1 = p_elem[1];
+		uint32_t ul_dlc = (ul_r1 & MCAN_R1_DLC_Msk) >> MCAN_R1_DLC_Pos;
+		uint32_t ul_len;
+
+		p_frame->uc_flags = 0;
+		if (ul_r0 & MCAN_R0_XTD) {
+			p_frame->ul_id = ul_r0 & MCAN_R0_ID_Msk;
+			p_frame->uc_flags |= MCAN_FRAME_EXT;
+		} else {
+			p_frame->ul_id = (ul_r0 & MCAN_R0_ID_Msk) >> MCAN_R0_STDID_Pos;
+		}
+		if (ul_r0 & MCAN_R0_RTR) {
+			p_frame->uc_flags |= MCAN_FRAME_RTR;
+		}
+		if (ul_r0 & MCAN_R0_ESI) {
+			p_frame->uc_flags |= MCAN_FRAME_ESI;
+		}
+		if (ul_r1 & MCAN_R1_EDL) {
+			p_frame->uc_flags |= MCAN_FRAME_FD;
+			ul_len = gs_uc_dlc_len[ul_dlc];
+		} else {
+			ul_len = Min(ul_dlc, 8);
+		}
+		if (ul_r1 & MCAN_R1_BRS) {
+			p_frame->uc_flags |= MCAN_FRAME_BRS;
+		}
+		p_frame->us_timestamp = ul_r1 & MCAN_R1_RXTS_Msk;
+		p_frame->uc_filter = (ul_r1 & MCAN_R1_ANMF) ? MCAN_FILTER_NONE :
+				(ul_r1 & MCAN_R1_FIDX_Msk) >> MCAN_R1_FIDX_Pos;
+		if (ul_len > p_dev->uc_data_size) {
+			ul_len = p_dev->uc_data_size;
+		}
+		p_frame->uc_len = ul_len;
+		memcpy(p_frame->uc_data, (const void *)&p_elem[2], (ul_len + 3) & ~3u);
+	}
+	/* Release the elements only once they have been read. */
+	__DMB();
+	if (ul_fifo) {
+		p_mcan->MCAN_RXF1A = MCAN_RXF1A_F1AI((ul_get + ul_count - 1) % ul_size);
+	} else {
+		p_mcan->MCAN_RXF0A = MCAN_RXF0A_F0AI((ul_get + ul_count - 1) % ul_size);
+	}
+	p_dev->ul_rx_frames += ul_count;
+	return ul_count;
+}
+
+/**
+ * \brief Queue frames for transmission, as many as the transmit FIFO has
+ * room for.
+ *
+ * Frames are sent in the format of mcan_config_t::mode. A payload longer
+ * than 8 bytes is rounded up to the next CAN FD length, padded with the
+ * bytes that follow it in uc_data, and truncated to 8 bytes in
+ * MCAN_MODE_CLASSIC. The uc_filter and us_timestamp fields are ignored.
+ * The transmit FIFO must not be written from two contexts at once.
+ *
+ * \return Number of frames queued, from the start of \a p_frames.
+ */
+uint32_t mcan_tx_fifo_write(mcan_dev_t *p_dev, const mcan_frame_t *p_frames,
+		uint32_t ul_count)
+{
+	Mcan *p_mcan = p_dev->p_mcan;
+	uint32_t ul_status = p_mcan->MCAN_TXFQS;
+	uint32_t ul_free = (ul_status & MCAN_TXFQS_TFFL_Msk) >> MCAN_TXFQS_TFFL_Pos;
+	uint32_t ul_put = (ul_status & MCAN_TXFQS_TFQPI_Msk) >> MCAN_TXFQS_TFQPI_Pos;
+	uint32_t ul_max_len = p_dev->mode == MCAN_MODE_CLASSIC ? 8 :
+			p_dev->uc_data_size;
+	uint32_t ul_requests = 0;
+	uint32_t i;
+
+	if (ul_count > ul_free) {
+		ul_count = ul_free;
+	}
+	for (i = 0; i < ul_count; i++) {
+		const mcan_frame_t *p_frame = &p_frames[i];
+		uint32_t ul_index = (ul_put + i) % p_dev->uc_tx_size;
+		volatile uint32_t *p_elem = p_dev->p_tx +
+				ul_index * p_dev->uc_elem_words;
+		uint32_t ul_len = Min(p_frame->uc_len, ul_max_len);
+		uint32_t ul_dlc = mcan_len_to_dlc(ul_len);
+
+		ul_len = gs_uc_dlc_len[ul_dlc];
+		if (p_frame->uc_flags & MCAN_FRAME_EXT) {
+			p_elem[0] = (p_frame->ul_id & MCAN_R0_ID_Msk) | MCAN_R0_XTD |
+					((p_frame->uc_flags & MCAN_FRAME_RTR) ? MCAN_R0_RTR : 0);
+		} else {
+			p_elem[0] = ((p_frame->ul_id & MCAN_SF_ID_Msk) <<
+					MCAN_R0_STDID_Pos) |
+					((p_frame->uc_flags & MCAN_FRAME_RTR) ? MCAN_R0_RTR : 0);
+		}
+		p_elem[1] = ul_dlc << MCAN_R1_DLC_Pos;
+		memcpy((void *)&p_elem[2], p_frame->uc_data, (ul_len + 3) & ~3u);
+		ul_requests |= 1u << ul_index;
+	}
+	if (ul_requests) {
+		/* The elements must be in the message RAM before the request. */
+		__DMB();
+		p_mcan->MCAN_TXBAR = ul_requests;
+		p_dev->ul_tx_frames += ul_count;
+	}
+	return ul_count;
+}
+
+/**
+ * \brief Enable interrupt sources (MCAN_IE_* bits).
+ */
+void mcan_enable_interrupt(mcan_dev_t *p_dev, uint32_t ul_mask)
+{
+	irqflags_t flags = cpu_irq_save();
+
+	p_dev->p_mcan->MCAN_IE |= ul_mask;
+	cpu_irq_restore(flags);
+}
+
+/**
+ * \brief Disable interrupt sources (MCAN_IE_* bits).
+ */
+void mcan_disable_interrupt(mcan_dev_t *p_dev, uint32_t ul_mask)
+{
+	irqflags_t flags = cpu_irq_save();
+
+	p_dev->p_mcan->MCAN_IE &= ~ul_mask;
+	cpu_irq_restore(flags);
+}
+
+/**
+ * \brief Common interrupt handling of both controllers.
+ */
+static void mcan_handler(mcan_dev_t *p_dev)
+{
+	Mcan *p_mcan;
+	uint32_t ul_ir;
+
+	if (p_dev == NULL) {
+		return;
+	}
+	p_mcan = p_dev->p_mcan;
+	ul_ir = p_mcan->MCAN_IR & p_mcan->MCAN_IE;
+	p_mcan->MCAN_IR = ul_ir;
+
+	if (ul_ir & (MCAN_IR_RF0L | MCAN_IR_RF1L)) {
+		p_dev->ul_rx_overflows++;
+	}
+	if ((ul_ir & MCAN_IR_BO) && (p_mcan->MCAN_PSR & MCAN_PSR_BO)) {
+		/* The controller stopped itself. Leaving initialization starts
+		 * the recovery: 128 sequences of 11 recessive bits. */
+		p_dev->ul_bus_off++;
+		p_mcan->MCAN_CCCR &= ~MCAN_CCCR_INIT;
+	}
+	if (p_dev->callback) {
+		p_dev->callback(p_dev, ul_ir);
+	}
+}
+
+/**
+ * \brief MCAN0 interrupt line 0 handler.
+ */
+void MCAN0_Handler(void)
+{
+	mcan_handler(gs_p_mcan_devs[0]);
+}
+
+/**
+ * \brief MCAN1 interrupt line 0 handler.
+ */
+void MCAN1_Handler(void)
+{
+	mcan_handler(gs_p_mcan_devs[1]);
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
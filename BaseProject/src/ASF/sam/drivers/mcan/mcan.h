@@ -0,0 +1,278 @@
+/**
+ * \file
+ *
+ * \brief SAM Controller Area Network (MCAN) driver.
+ *
+ */
+
+#ifndef MCAN_H_INCLUDED
+#define MCAN_H_INCLUDED
+
+#include "compiler.h"
+#include "status_codes.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \defgroup sam_drivers_mcan_group Controller Area Network (MCAN)
+ *
+ * CAN 2.0 and CAN FD controller setup, acceptance filtering and frame
+ * transfers through the message RAM.
+ *
+ * The message RAM is ordinary SRAM that the controller reads and writes
+ * on its own. The caller provides it, sized with mcan_ram_size(), and it
+ * must not be cached (see \ref utils_dma_buf_group, DMA_BUF_NOCACHE) and
+ * must not cross a 64 Kbyte boundary: the controller only holds the low
+ * 16 bits of the element addresses, the high ones are set in the matrix
+ * CCFG_CAN0 or CCFG_SYSIO register. It holds, in this order, the standard
+ * and extended ID filters, receive FIFO 0 and FIFO 1, and the transmit
+ * FIFO.
+ *
+ * Frames are moved in batches. mcan_rx_fifo_read() copies out everything
+ * a receive FIFO holds, up to the caller's array, and releases all of it
+ * with a single acknowledge. mcan_tx_fifo_write() fills the free transmit
+ * elements from the put index on and requests them all with a single
+ * TXBAR write. The FIFO watermarks and the receive timeout counter let the
+ * interrupt fire once per batch instead of once per frame.
+ *
+ * The MCAN revision of the SAMV71 selects the transmit frame format (CAN
+ * 2.0, CAN FD, CAN FD with bit rate switching) for the whole controller,
+ * not per frame, so mcan_config_t::mode applies to every frame sent.
+ * Frames in any format are received.
+ *
+ * MCAN0_Handler() and MCAN1_Handler() are provided by the driver. They
+ * acknowledge the enabled interrupts, restart the controller after a bus
+ * off and pass the interrupt flags to the callback of the instance.
+ *
+ * @{
+ */
+
+/** Largest frame payload, in bytes. */
+#define MCAN_DATA_MAX             64
+
+/** Frame flag: 29-bit identifier. */
+#define MCAN_FRAME_EXT            (1u << 0)
+/** Remote frame. */
+#define MCAN_FRAME_RTR            (1u << 1)
+/** Received in CAN FD format. */
+#define MCAN_FRAME_FD             (1u << 2)
+/** Received with bit rate switching. */
+#define MCAN_FRAME_BRS            (1u << 3)
+/** Received from an error passive transmitter. */
+#define MCAN_FRAME_ESI            (1u << 4)
+
+/** mcan_frame_t::uc_filter of a frame that matched no filter. */
+#define MCAN_FILTER_NONE          0xFF
+
+/** Receive FIFOs. */
+#define MCAN_RX_FIFO_0            0
+#define MCAN_RX_FIFO_1            1
+
+/** Message RAM limits. */
+#define MCAN_STD_FILTERS_MAX      128
+#define MCAN_EXT_FILTERS_MAX      64
+#define MCAN_RX_FIFO_MAX          64
+#define MCAN_TX_FIFO_MAX          32
+
+/** One frame, received or to send. */
+typedef struct mcan_frame {
+	/** Identifier, 11 or 29 bits. */
+	uint32_t ul_id;
+	/** Receive timestamp, see mcan_config_t::ul_rx0_timeout. */
+	uint16_t us_timestamp;
+	/** Payload length in bytes, 0 to MCAN_DATA_MAX. */
+	uint8_t uc_len;
+	/** MCAN_FRAME_* flags. */
+	uint8_t uc_flags;
+	uint8_t uc_data[MCAN_DATA_MAX];
+	/** Index of the filter that accepted a received frame. */
+	uint8_t uc_filter;
+} mcan_frame_t;
+
+/** Transmit frame format. */
+typedef enum mcan_mode {
+	MCAN_MODE_CLASSIC,
+	MCAN_MODE_FD,
+	MCAN_MODE_FD_BRS,
+} mcan_mode_t;
+
+/** Filter types. */
+typedef enum mcan_filter_type {
+	/** Identifiers from ul_id1 to ul_id2. */
+	MCAN_FILTER_RANGE,
+	/** Identifier ul_id1 or ul_id2. */
+	MCAN_FILTER_DUAL,
+	/** Identifiers equal to ul_id1 on the bits set in ul_id2. */
+	MCAN_FILTER_MASK,
+} mcan_filter_type_t;
+
+/** What to do with the frames a filter matches, or that match none. */
+typedef enum mcan_filter_action {
+	MCAN_FILTER_DISABLE,
+	MCAN_FILTER_TO_FIFO_0,
+	MCAN_FILTER_TO_FIFO_1,
+	MCAN_FILTER_REJECT,
+} mcan_filter_action_t;
+
+/** One acceptance filter. */
+typedef struct mcan_filter {
+	mcan_filter_type_t type;
+	mcan_filter_action_t action;
+	uint32_t ul_id1;
+	uint32_t ul_id2;
+} mcan_filter_t;
+
+/** Controller configuration. */
+typedef struct mcan_config {
+	/** Core clock (PCK5), in Hz. It must not exceed MCK. */
+	uint32_t ul_clock_hz;
+	/** Nominal bit rate. */
+	uint32_t ul_bitrate;
+	/** Data phase bit rate, for MCAN_MODE_FD_BRS. */
+	uint32_t ul_data_bitrate;
+	mcan_mode_t mode;
+	/** Filter list sizes. */
+	uint8_t uc_std_filters;
+	uint8_t uc_ext_filters;
+	/**
+	 * Receive FIFO sizes, and the fill levels at which MCAN_IR_RF0W and
+	 * MCAN_IR_RF1W are raised (0 for none).
+	 */
+	uint8_t uc_rx0_size;
+	uint8_t uc_rx0_watermark;
+	uint8_t uc_rx1_size;
+	uint8_t uc_rx1_watermark;
+	/** Transmit FIFO size, 1 to MCAN_TX_FIFO_MAX. */
+	uint8_t uc_tx_size;
+	/**
+	 * Payload room of the receive and transmit elements: 8, 12, 16, 20,
+	 * 24, 32, 48 or 64 bytes. Longer frames are truncated.
+	 */
+	uint8_t uc_data_size;
+	/** Where the frames that match no filter go. */
+	mcan_filter_action_t nonmatch;
+	/**
+	 * Raise MCAN_IR_TOO once a frame has waited that many bit times in
+	 * receive FIFO 0, 0 for never. It bounds the latency of FIFO 0 when
+	 * its watermark is used. It also sets the timestamp unit, the number
+	 * of bit times per tick being mcan_dev_t::uc_tick_bits.
+	 */
+	uint32_t ul_rx0_timeout;
+	/** Internal loopback: frames sent are received, the bus is left alone. */
+	bool b_loopback;
+} mcan_config_t;
+
+struct mcan_dev;
+
+/**
+ * Interrupt callback, run from the MCAN interrupt with the MCAN_IR_* flags
+ * that were raised and enabled.
+ */
+typedef void (*mcan_callback_t)(struct mcan_dev *p_dev, uint32_t ul_ir);
+
+/** Driver state, one per controller. */
+typedef struct mcan_dev {
+	Mcan *p_mcan;
+	/** Message RAM areas. */
+	volatile uint32_t *p_std_filters;
+	volatile uint32_t *p_ext_filters;
+	volatile uint32_t *p_rx[2];
+	volatile uint32_t *p_tx;
+	uint8_t uc_std_filters;
+	uint8_t uc_ext_filters;
+	uint8_t uc_rx_size[2];
+	uint8_t uc_tx_size;
+	uint8_t uc_data_size;
+	/** Element size, in words. */
+	uint8_t uc_elem_words;
+	/** Bit times per timestamp tick. */
+	uint8_t uc_tick_bits;
+	mcan_mode_t mode;
+	mcan_callback_t callback;
+	void *p_ctx;
+	/** Frames read and queued. */
+	uint32_t ul_rx_frames;
+	uint32_t ul_tx_frames;
+	/** Receive FIFO overflows, one per MCAN_IR_RF0L or MCAN_IR_RF1L. */
+	uint32_t ul_rx_overflows;
+	/** Bus off events. */
+	uint32_t ul_bus_off;
+} mcan_dev_t;
+
+uint32_t mcan_ram_size(const mcan_config_t *p_cfg);
+status_code_t mcan_init(mcan_dev_t *p_dev, Mcan *p_mcan, void *p_ram,
+		const mcan_config_t *p_cfg);
+void mcan_set_callback(mcan_dev_t *p_dev, mcan_callback_t callback,
+		void *p_ctx);
+void mcan_start(mcan_dev_t *p_dev);
+void mcan_stop(mcan_dev_t *p_dev);
+status_code_t mcan_set_std_filter(mcan_dev_t *p_dev, uint32_t ul_index,
+		const mcan_filter_t *p_filter);
+status_code_t mcan_set_ext_filter(mcan_dev_t *p_dev, uint32_t ul_index,
+		const mcan_filter_t *p_filter);
+uint32_t mcan_rx_fifo_read(mcan_dev_t *p_dev, uint32_t ul_fifo,
+		mcan_frame_t *p_frames, uint32_t ul_max);
+uint32_t mcan_tx_fifo_write(mcan_dev_t *p_dev, const mcan_frame_t *p_frames,
+		uint32_t ul_count);
+void mcan_enable_interrupt(mcan_dev_t *p_dev, uint32_t ul_mask);
+void mcan_disable_interrupt(mcan_dev_t *p_dev, uint32_t ul_mask);
+
+/**
+ * \brief Number of frames waiting in a receive FIFO.
+ */
+static inline uint32_t mcan_rx_fifo_level(mcan_dev_t *p_dev, uint32_t ul_fifo)
+{
+	return (ul_fifo ? p_dev->p_mcan->MCAN_RXF1S : p_dev->p_mcan->MCAN_RXF0S) &
+			MCAN_RXF0S_F0FL_Msk;
+}
+
+/**
+ * \brief Number of free transmit FIFO elements.
+ */
+static inline uint32_t mcan_tx_fifo_free(mcan_dev_t *p_dev)
+{
+	return (p_dev->p_mcan->MCAN_TXFQS & MCAN_TXFQS_TFFL_Msk) >>
+			MCAN_TXFQS_TFFL_Pos;
+}
+
+/**
+ * \brief Tell whether every queued frame has been sent.
+ */
+static inline bool mcan_tx_is_idle(mcan_dev_t *p_dev)
+{
+	return p_dev->p_mcan->MCAN_TXBRP == 0;
+}
+
+/**
+ * \brief Clear pending interrupt flags (MCAN_IR_* bits).
+ */
+static inline void mcan_clear_interrupt(mcan_dev_t *p_dev, uint32_t ul_mask)
+{
+	p_dev->p_mcan->MCAN_IR = ul_mask;
+}
+
+/**
+ * \brief Transmit and receive error counters, MCAN_ECR.
+ */
+static inline uint32_t mcan_get_error_counters(mcan_dev_t *p_dev)
+{
+	return p_dev->p_mcan->MCAN_ECR;
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+#endif /* MCAN_H_INCLUDED */
@@ -46,78 +46,130 @@
 
 #include "pio.h"
 #include "pio_handler.h"
+#include "interrupt.h"
 
-/**
- * Maximum number of interrupt sources that can be defined. This
- * constant can be increased, but the current value is the smallest possible one
- * that will be compatible with all existing projects.
- */
-#define MAX_INTERRUPT_SOURCES       7
+/** Number of PIO controllers. */
+#if defined(ID_PIOF)
+#  define PIO_HANDLER_CONTROLLERS     6
+#elif defined(ID_PIOE)
+#  define PIO_HANDLER_CONTROLLERS     5
+#elif defined(ID_PIOD)
+#  define PIO_HANDLER_CONTROLLERS     4
+#elif defined(ID_PIOC)
+#  define PIO_HANDLER_CONTROLLERS     3
+#else
+#  define PIO_HANDLER_CONTROLLERS     2
+#endif
+
+/** Index of a PIO controller in the handler tables. */
+#define PIO_HANDLER_INDEX(p_pio) \
+	(((uint32_t)(p_pio) - (uint32_t)PIOA) / PIO_DELTA)
 
 /**
- * Describes a PIO interrupt source, including the PIO instance triggering the
- * interrupt and the associated interrupt handler.
+ * Handler of one pin. A handler registered with pio_handler_set() for
+ * several pins is stored on each of them, with the whole mask, and is
+ * called once per interrupt with those of its pins that are pending.
  */
 struct s_interrupt_source {
-	uint32_t id;
-	uint32_t mask;
-	uint32_t attr;
-
-	/* Interrupt handler. */
+	/* Interrupt handler, called with the PIO ID and its pending pins. */
 	void (*handler) (const uint32_t, const uint32_t);
+	/* Or context handler, called with the PIO ID and the pin mask. */
+	pio_handler_ctx_t ctx_handler;
+	void *p_ctx;
+	uint32_t mask;
 };
 
+/* Per controller, per pin interrupt sources. */
+static struct s_interrupt_source
+		gs_interrupt_sources[PIO_HANDLER_CONTROLLERS][32];
 
-/* List of interrupt sources. */
-static struct s_interrupt_source gs_interrupt_sources[MAX_INTERRUPT_SOURCES];
-
-/* Number of currently defined interrupt sources. */
-static uint32_t gs_ul_nb_sources = 0;
+/* Per controller, pins with a context handler, which takes the snapshot. */
+static uint32_t gs_ul_ctx_pins[PIO_HANDLER_CONTROLLERS];
 
-#if (SAM3S || SAM4S || SAM4E)
+#if (SAM3S || SAM4S || SAM4E || SAMV71 || SAMV70 || SAME70 || SAMS70)
 /* PIO Capture handler */
 static void (*pio_capture_handler)(Pio *) = NULL;
 extern uint32_t pio_capture_enable_flag;
 #endif
 
+/**
+ * \brief Pending pins of a handler registration.
+ *
+ * The pins of \a status in the registered mask of \a p_source that still
+ * hold that registration: a pin given to another handler since keeps its
+ * own entry and is left pending for it.
+ */
+static uint32_t pio_handler_pending(
+		const struct s_interrupt_source *p_sources,
+		const struct s_interrupt_source *p_source, uint32_t status)
+{
+	uint32_t ul_left = status & p_source->mask;
+	uint32_t pins = 0;
+
+	while (ul_left != 0) {
+		uint32_t pin = 31 - __CLZ(ul_left);
+		const struct s_interrupt_source *p_other = &p_sources[pin];
+
+		ul_left &= ~(1u << pin);
+		if (!p_other->ctx_handler && p_other->handler == p_source->handler
+				&& p_other->mask == p_source->mask) {
+			pins |= 1u << pin;
+		}
+	}
+	return pins;
+}
+
 /**
  * \brief Process an interrupt request on the given PIO controller.
  *
+ * Walks the pending and enabled pins from the highest one down, with one
+ * table lookup per pin. The context handlers all get the one snapshot taken
+ * on entry, whatever their place in the walk. The snapshot costs a read of
+ * DWT_CYCCNT and of PIO_PDSR, so it is only taken on a controller with a
+ * context handler.
+ *
  * \param p_pio PIO controller base address.
  * \param ul_id PIO controller ID.
  */
 void pio_handler_process(Pio *p_pio, uint32_t ul_id)
 {
+	uint32_t ul_index = PIO_HANDLER_INDEX(p_pio);
+	struct s_interrupt_source *p_sources;
+	pio_handler_snapshot_t snapshot;
 	uint32_t status;
-	uint32_t i;
 
 	/* Read PIO controller status */
-	status = pio_get_interrupt_status(p_pio);
+	if (gs_ul_ctx_pins[ul_index]) {
+		snapshot.ul_cycles = DWT->CYCCNT;
+		status = pio_get_interrupt_status(p_pio);
+		snapshot.ul_levels = p_pio->PIO_PDSR;
+	} else {
+		status = pio_get_interrupt_status(p_pio);
+	}
 	status &= pio_get_interrupt_mask(p_pio);
 
-	/* Check pending events */
-	if (status != 0) {
-		/* Find triggering source */
-		i = 0;
-		while (status != 0) {
-			/* Source is configured on the same controller */
-			if (gs_interrupt_sources[i].id == ul_id) {
-				/* Source has PIOs whose statuses have changed */
-				if ((status & gs_interrupt_sources[i].mask) != 0) {
-					gs_interrupt_sources[i].handler(gs_interrupt_sources[i].id,
-							gs_interrupt_sources[i].mask);
-					status &= ~(gs_interrupt_sources[i].mask);
-				}
-			}
-			i++;
-			if (i >= MAX_INTERRUPT_SOURCES) {
-				break;
-			}
+	p_sources = gs_interrupt_sources[ul_index];
+	while (status != 0) {
+		uint32_t pin = 31 - __CLZ(status);
+		struct s_interrupt_source *p_source = &p_sources[pin];
+
+		if (p_source->ctx_handler) {
+			status &= ~(1u << pin);
+			p_source->ctx_handler(ul_id, 1u << pin, &snapshot,
+					p_source->p_ctx);
+		} else if (p_source->handler) {
+			uint32_t pins = pio_handler_pending(p_sources, p_source,
+					status);
+
+			status &= ~pins;
+			p_source->handler(ul_id, pins);
+		} else {
+			status &= ~(1u << pin);
 		}
 	}
 
 	/* Check capture events */
-#if (SAM3S || SAM4S || SAM4E)
+#if (SAM3S || SAM4S || SAM4E || SAMV71 || SAMV70 || SAME70 || SAMS70)
 	if (pio_capture_enable_flag) {
 		if (pio_capture_handler) {
 			pio_capture_handler(p_pio);
@@ -126,10 +178,38 @@ void pio_handler_process(Pio *p_pio, uint32_t ul_id)
 #endif
 }
 
+/**
+ * \brief Store a handler on every pin of a mask.
+ */
+static void pio_handler_store(Pio *p_pio, uint32_t ul_mask,
+		const struct s_interrupt_source *p_source)
+{
+	uint32_t ul_index = PIO_HANDLER_INDEX(p_pio);
+	struct s_interrupt_source *p_sources;
+	irqflags_t flags;
+
+	p_sources = gs_interrupt_sources[ul_index];
+	flags = cpu_irq_save();
+	if (p_source->ctx_handler) {
+		gs_ul_ctx_pins[ul_index] |= ul_mask;
+	} else {
+		gs_ul_ctx_pins[ul_index] &= ~ul_mask;
+	}
+	while (ul_mask != 0) {
+		uint32_t pin = 31 - __CLZ(ul_mask);
+
+		ul_mask &= ~(1u << pin);
+		p_sources[pin] = *p_source;
+	}
+	cpu_irq_restore(flags);
+}
+
 /**
  * \brief Set an interrupt handler for the provided pins.
- * The provided handler will be called with the triggering pin as its parameter
- * as soon as an interrupt is detected.
+ * The provided handler will be called with the PIO ID and the pending pins
+ * of \a ul_mask as soon as an interrupt is detected on one of the pins.
+ *
+ * Any handler previously set on these pins is replaced.
  *
  * \param p_pio PIO controller base address.
  * \param ul_id PIO ID.
@@ -137,33 +217,52 @@ void pio_handler_process(Pio *p_pio, uint32_t ul_id)
  * \param ul_attr Pins attribute to configure.
  * \param p_handler Interrupt handler function pointer.
  *
- * \return 0 if successful, 1 if the maximum number of sources has been defined.
+ * \return 0 if successful.
  */
 uint32_t pio_handler_set(Pio *p_pio, uint32_t ul_id, uint32_t ul_mask,
 		uint32_t ul_attr, void (*p_handler) (uint32_t, uint32_t))
 {
-    uint8_t i;
-	struct s_interrupt_source *pSource;
+	struct s_interrupt_source source;
 
-	if (gs_ul_nb_sources >= MAX_INTERRUPT_SOURCES)
-		return 1;
+	UNUSED(ul_id);
 
-    /* Check interrupt for this pin, if already defined, redefine it. */
-	for (i = 0; i <= gs_ul_nb_sources; i++) {
-		pSource = &(gs_interrupt_sources[i]);
-		if (pSource->id == ul_id && pSource->mask == ul_mask) {
-			break;
-		}
-	}
+	source.handler = p_handler;
+	source.ctx_handler = NULL;
+	source.p_ctx = NULL;
+	source.mask = ul_mask;
+	pio_handler_store(p_pio, ul_mask, &source);
 
-	/* Define new source */
-	pSource->id = ul_id;
-	pSource->mask = ul_mask;
-	pSource->attr = ul_attr;
-	pSource->handler = p_handler;
-	if (i == gs_ul_nb_sources + 1) {
-		gs_ul_nb_sources++;
-	}
+	/* Configure interrupt mode */
+	pio_configure_interrupt(p_pio, ul_mask, ul_attr);
+
+	return 0;
+}
+
+/**
+ * \brief Set an interrupt handler with a context pointer for the provided
+ * pins. The handler is called once per pending pin, with the PIO ID, the
+ * mask of that pin, the snapshot of the controller and \a p_ctx.
+ *
+ * Any handler previously set on these pins is replaced.
+ *
+ * \param p_pio PIO controller base address.
+ * \param ul_mask Pins (bit mask) to configure.
+ * \param ul_attr Pins attribute to configure.
+ * \param p_handler Interrupt handler function pointer.
+ * \param p_ctx Passed back to \a p_handler.
+ *
+ * \return 0 if successful.
+ */
+uint32_t pio_handler_set_ctx(Pio *p_pio, uint32_t ul_mask, uint32_t ul_attr,
+		pio_handler_ctx_t p_handler, void *p_ctx)
+{
+	struct s_interrupt_source source;
+
+	source.handler = NULL;
+	source.ctx_handler = p_handler;
+	source.p_ctx = p_ctx;
+	source.mask = ul_mask;
+	pio_handler_store(p_pio, ul_mask, &source);
 
 	/* Configure interrupt mode */
 	pio_configure_interrupt(p_pio, ul_mask, ul_attr);
@@ -171,7 +270,27 @@ uint32_t pio_handler_set(Pio *p_pio, uint32_t ul_id, uint32_t ul_mask,
 	return 0;
 }
 
-#if (SAM3S || SAM4S || SAM4E)
+/**
+ * \brief Disable the interrupt of the provided pins and remove their
+ * handlers.
+ *
+ * \param p_pio PIO controller base address.
+ * \param ul_mask Pins (bit mask) to release.
+ */
+void pio_handler_unset(Pio *p_pio, uint32_t ul_mask)
+{
+	struct s_interrupt_source source;
+
+	pio_disable_interrupt(p_pio, ul_mask);
+
+	source.handler = NULL;
+	source.ctx_handler = NULL;
+	source.p_ctx = NULL;
+	source.mask = 0;
+	pio_handler_store(p_pio, ul_mask, &source);
+}
+
+#if (SAM3S || SAM4S || SAM4E || SAMV71 || SAMV70 || SAME70 || SAMS70)
 /**
  * \brief Set a capture interrupt handler for all PIO.
  *
@@ -197,7 +316,7 @@ void pio_capture_handler_set(void (*p_handler)(Pio *))
  * \param ul_flag Pin flag.
  * \param p_handler Interrupt handler function pointer.
  *
- * \return 0 if successful, 1 if the maximum number of sources has been defined.
+ * \return 0 if successful.
  */
 uint32_t pio_handler_set_pin(uint32_t ul_pin, uint32_t ul_flag,
 		void (*p_handler) (uint32_t, uint32_t))
@@ -209,6 +328,35 @@ uint32_t pio_handler_set_pin(uint32_t ul_pin, uint32_t ul_flag,
 	return pio_handler_set(p_pio, group_id, group_mask, ul_flag, p_handler);
 }
 
+/**
+ * \brief Set an interrupt handler with a context pointer for the specified
+ * pin, see pio_handler_set_ctx().
+ *
+ * \param ul_pin Pin index to configure.
+ * \param ul_flag Pin flag.
+ * \param p_handler Interrupt handler function pointer.
+ * \param p_ctx Passed back to \a p_handler.
+ *
+ * \return 0 if successful.
+ */
+uint32_t pio_handler_set_pin_ctx(uint32_t ul_pin, uint32_t ul_flag,
+		pio_handler_ctx_t p_handler, void *p_ctx)
+{
+	return pio_handler_set_ctx(pio_get_pin_group(ul_pin),
+			pio_get_pin_group_mask(ul_pin), ul_flag, p_handler, p_ctx);
+}
+
+/**
+ * \brief Disable the interrupt of the specified pin and remove its handler.
+ *
+ * \param ul_pin Pin index to release.
+ */
+void pio_handler_unset_pin(uint32_t ul_pin)
+{
+	pio_handler_unset(pio_get_pin_group(ul_pin),
+			pio_get_pin_group_mask(ul_pin));
+}
+
 /**
  * \brief Parallel IO Controller A interrupt handler.
  * Redefined PIOA interrupt handler for NVIC interrupt table.
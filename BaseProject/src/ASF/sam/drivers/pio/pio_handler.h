@@ -51,14 +51,39 @@
 extern "C" {
 #endif
 
+/**
+ * A PIO controller when its interrupt was taken, the same for all the
+ * handlers of that interrupt.
+ */
+typedef struct pio_handler_snapshot {
+	/** Core cycle counter (DWT_CYCCNT) when the dispatch started. */
+	uint32_t ul_cycles;
+	/** Pin levels (PIO_PDSR), read right after the interrupt status. */
+	uint32_t ul_levels;
+} pio_handler_snapshot_t;
+
+/**
+ * Interrupt handler with a context pointer, called with the PIO ID, the
+ * mask of the pin that triggered, the controller snapshot and the
+ * registered context.
+ */
+typedef void (*pio_handler_ctx_t)(uint32_t ul_id, uint32_t ul_mask,
+		const pio_handler_snapshot_t *p_snapshot, void *p_ctx);
+
 void pio_handler_process(Pio *p_pio, uint32_t ul_id);
 void pio_handler_set_priority(Pio *p_pio, IRQn_Type ul_irqn, uint32_t ul_priority);
 uint32_t pio_handler_set(Pio *p_pio, uint32_t ul_id, uint32_t ul_mask,
 		uint32_t ul_attr, void (*p_handler) (uint32_t, uint32_t));
 uint32_t pio_handler_set_pin(uint32_t ul_pin, uint32_t ul_flag,
 		void (*p_handler) (uint32_t, uint32_t));
+uint32_t pio_handler_set_ctx(Pio *p_pio, uint32_t ul_mask, uint32_t ul_attr,
+		pio_handler_ctx_t p_handler, void *p_ctx);
+uint32_t pio_handler_set_pin_ctx(uint32_t ul_pin, uint32_t ul_flag,
+		pio_handler_ctx_t p_handler, void *p_ctx);
+void pio_handler_unset(Pio *p_pio, uint32_t ul_mask);
+void pio_handler_unset_pin(uint32_t ul_pin);
 
-#if (SAM3S || SAM4S || SAM4E)
+#if (SAM3S || SAM4S || SAM4E || SAMV71 || SAMV70 || SAME70 || SAMS70)
 void pio_capture_handler_set(void (*p_handler)(Pio *));
 #endif
 
@@ -0,0 +1,162 @@
+/**
+ * \file
+ *
+ * \brief SAM Pulse Width Modulation (PWM) driver.
+ *
+ */
+
+#include "pwm.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \addtogroup sam_drivers_pwm_group
+ *
+ * @{
+ */
+
+/** Number of MCK prescaler settings of CLKA and CLKB (1 to 1024). */
+#define PWM_CLOCK_PRE_MAX    11
+
+/** Longest period and duty cycle. */
+#define PWM_PERIOD_MAX       0xFFFFFFu
+
+/**
+ * \brief Find the prescaler and divider of CLKA or CLKB.
+ *
+ * \param ul_frequency Clock frequency in Hz.
+ * \param ul_mck Peripheral clock in Hz.
+ *
+ * \return DIVx | (PREx << 8), or PWM_INVALID_ARGUMENT if the frequency cannot
+ * be reached.
+ */
+static uint32_t pwm_clocks_generate(uint32_t ul_frequency, uint32_t ul_mck)
+{
+	uint32_t ul_pre;
+	uint32_t ul_div;
+
+	for (ul_pre = 0; ul_pre < PWM_CLOCK_PRE_MAX; ul_pre++) {
+		ul_div = ((ul_mck >> ul_pre) + ul_frequency / 2) / ul_frequency;
+		if (ul_div <= 255) {
+			return ul_div ? ul_div | (ul_pre << 8) : PWM_INVALID_ARGUMENT;
+		}
+	}
+	return PWM_INVALID_ARGUMENT;
+}
+
+/**
+ * \brief Set the CLKA and CLKB frequencies of a PWM controller.
+ *
+ * \param p_pwm Pointer to a PWM instance.
+ * \param clock_config Clock frequencies.
+ *
+ * \retval 0 on success.
+ * \retval PWM_INVALID_ARGUMENT if a frequency cannot be reached.
+ */
+uint32_t pwm_init(Pwm *p_pwm, pwm_clock_t *clock_config)
+{
+	uint32_t ul_clka = 0;
+	uint32_t ul_clkb = 0;
+
+	if (clock_config->ul_clka) {
+		ul_clka = pwm_clocks_generate(clock_config->ul_clka,
+				clock_config->ul_mck);
+		if (ul_clka == PWM_INVALID_ARGUMENT) {
+			return PWM_INVALID_ARGUMENT;
+		}
+	}
+	if (clock_config->ul_clkb) {
+		ul_clkb = pwm_clocks_generate(clock_config->ul_clkb,
+				clock_config->ul_mck);
+		if (ul_clkb == PWM_INVALID_ARGUMENT) {
+			return PWM_INVALID_ARGUMENT;
+		}
+	}
+	p_pwm->PWM_CLK = ul_clka | (ul_clkb << 16);
+
+	return 0;
+}
+
+/**
+ * \brief Configure a disabled channel.
+ *
+ * \param p_pwm Pointer to a PWM instance.
+ * \param p_channel Channel configuration.
+ *
+ * \retval 0 on success.
+ * \retval PWM_INVALID_ARGUMENT if the duty cycle exceeds the period.
+ */
+uint32_t pwm_channel_init(Pwm *p_pwm, pwm_channel_t *p_channel)
+{
+	PwmCh_num *p_ch = &p_pwm->PWM_CH_NUM[p_channel->channel];
+
+	if (p_channel->ul_period > PWM_PERIOD_MAX ||
+			p_channel->ul_duty > p_channel->ul_period) {
+		return PWM_INVALID_ARGUMENT;
+	}
+
+	p_ch->PWM_CMR = (p_channel->ul_prescaler & PWM_CMR_CPRE_Msk) |
+			p_channel->alignment |
+			(p_channel->polarity == PWM_HIGH ? PWM_CMR_CPOL : 0);
+	p_ch->PWM_CDTY = p_channel->ul_duty;
+	p_ch->PWM_CPRD = p_channel->ul_period;
+	p_ch->PWM_DT = 0;
+
+	return 0;
+}
+
+/**
+ * \brief Change the period of a running channel, at the end of its current
+ * period.
+ *
+ * \retval 0 on success.
+ * \retval PWM_INVALID_ARGUMENT if the duty cycle would exceed the period.
+ */
+uint32_t pwm_channel_update_period(Pwm *p_pwm, pwm_channel_t *p_channel,
+		uint32_t ul_period)
+{
+	if (ul_period > PWM_PERIOD_MAX || p_channel->ul_duty > ul_period) {
+		return PWM_INVALID_ARGUMENT;
+	}
+
+	p_channel->ul_period = ul_period;
+	p_pwm->PWM_CH_NUM[p_channel->channel].PWM_CPRDUPD = ul_period;
+
+	return 0;
+}
+
+/**
+ * \brief Change the duty cycle of a running channel, at the end of its
+ * current period.
+ *
+ * \retval 0 on success.
+ * \retval PWM_INVALID_ARGUMENT if the duty cycle exceeds the period.
+ */
+uint32_t pwm_channel_update_duty(Pwm *p_pwm, pwm_channel_t *p_channel,
+		uint32_t ul_duty)
+{
+	if (ul_duty > p_channel->ul_period) {
+		return PWM_INVALID_ARGUMENT;
+	}
+
+	p_channel->ul_duty = ul_duty;
+	p_pwm->PWM_CH_NUM[p_channel->channel].PWM_CDTYUPD = ul_duty;
+
+	return 0;
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
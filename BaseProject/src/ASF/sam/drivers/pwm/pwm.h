@@ -0,0 +1,149 @@
+/**
+ * \file
+ *
+ * \brief SAM Pulse Width Modulation (PWM) driver.
+ *
+ */
+
+#ifndef PWM_H_INCLUDED
+#define PWM_H_INCLUDED
+
+#include "compiler.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \defgroup sam_drivers_pwm_group Pulse Width Modulation (PWM)
+ *
+ * Channel setup and duty cycle updates for the PWM controllers, with the
+ * function names and types of the ASF PWM driver. Only the features used in
+ * this project are provided: left or center aligned waveforms on the PWMH
+ * outputs, clocked by MCK divisions or by the CLKA/CLKB dividers, and the
+ * channel counter event interrupts.
+ *
+ * @{
+ */
+
+#define PWM_INVALID_ARGUMENT  0xFFFF
+
+/** Channel numbers. */
+typedef enum {
+	PWM_CHANNEL_0 = 0,
+	PWM_CHANNEL_1 = 1,
+	PWM_CHANNEL_2 = 2,
+	PWM_CHANNEL_3 = 3,
+} pwm_ch_t;
+
+/** Waveform alignment. */
+typedef enum {
+	PWM_ALIGN_LEFT = (0 << 8),
+	PWM_ALIGN_CENTER = (1 << 8),
+} pwm_align_t;
+
+/**
+ * Channel polarity, PWM_CMR.CPOL. The output spends CPRD - CDTY channel clock
+ * periods of each period at this level and CDTY at the other one.
+ */
+typedef enum {
+	PWM_LOW = LOW,
+	PWM_HIGH = HIGH,
+} pwm_level_t;
+
+/** CLKA and CLKB frequencies, 0 to turn a clock off. */
+typedef struct {
+	uint32_t ul_clka;
+	uint32_t ul_clkb;
+	/** Peripheral clock of the controller. */
+	uint32_t ul_mck;
+} pwm_clock_t;
+
+/** Channel configuration. */
+typedef struct {
+	uint32_t channel;
+	/** Channel clock, PWM_CMR_CPRE_* value. */
+	uint32_t ul_prescaler;
+	pwm_align_t alignment;
+	pwm_level_t polarity;
+	/** Duty cycle and period, in channel clock periods. */
+	uint32_t ul_duty;
+	uint32_t ul_period;
+} pwm_channel_t;
+
+uint32_t pwm_init(Pwm *p_pwm, pwm_clock_t *clock_config);
+uint32_t pwm_channel_init(Pwm *p_pwm, pwm_channel_t *p_channel);
+uint32_t pwm_channel_update_period(Pwm *p_pwm, pwm_channel_t *p_channel,
+		uint32_t ul_period);
+uint32_t pwm_channel_update_duty(Pwm *p_pwm, pwm_channel_t *p_channel,
+		uint32_t ul_duty);
+
+/**
+ * \brief Start a channel.
+ */
+static inline void pwm_channel_enable(Pwm *p_pwm, uint32_t ul_channel)
+{
+	p_pwm->PWM_ENA = 1u << ul_channel;
+}
+
+/**
+ * \brief Stop a channel. Its mode register can be written again.
+ */
+static inline void pwm_channel_disable(Pwm *p_pwm, uint32_t ul_channel)
+{
+	p_pwm->PWM_DIS = 1u << ul_channel;
+}
+
+/**
+ * \brief Enable the counter event interrupt of a channel (end of period, or
+ * middle and end of period in center aligned mode) and its fault interrupt.
+ *
+ * \param ul_event Channel whose counter event interrupts.
+ * \param ul_fault Fault input whose interrupt is enabled.
+ */
+static inline void pwm_channel_enable_interrupt(Pwm *p_pwm,
+		uint32_t ul_event, uint32_t ul_fault)
+{
+	p_pwm->PWM_IER1 = (1u << ul_event) | (1u << (ul_fault + 16));
+}
+
+/**
+ * \brief Disable the counter event and fault interrupts of a channel.
+ */
+static inline void pwm_channel_disable_interrupt(Pwm *p_pwm,
+		uint32_t ul_event, uint32_t ul_fault)
+{
+	p_pwm->PWM_IDR1 = (1u << ul_event) | (1u << (ul_fault + 16));
+}
+
+/**
+ * \brief Read and clear the counter event and fault interrupt status.
+ */
+static inline uint32_t pwm_channel_get_interrupt_status(Pwm *p_pwm)
+{
+	return p_pwm->PWM_ISR1;
+}
+
+/**
+ * \brief Counter event and fault interrupt mask.
+ */
+static inline uint32_t pwm_channel_get_interrupt_mask(Pwm *p_pwm)
+{
+	return p_pwm->PWM_IMR1;
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+#endif /* PWM_H_INCLUDED */
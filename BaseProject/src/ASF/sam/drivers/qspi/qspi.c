@@ -0,0 +1,151 @@
+/**
+ * \file
+ *
+ * \brief SAM Quad Serial Peripheral Interface (QSPI) driver.
+ *
+ */
+
+#include "qspi.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \addtogroup sam_drivers_qspi_group
+ *
+ * @{
+ */
+
+/** Status polls before a frame is given up. */
+#define QSPI_TIMEOUT    100000
+
+/**
+ * \brief Start the QSPI in serial memory mode, SPI mode 0.
+ *
+ * \param p_qspi QSPI instance, its peripheral clock enabled.
+ * \param ul_mck_hz Peripheral clock frequency.
+ * \param ul_hz Highest serial clock frequency.
+ */
+void qspi_init(Qspi *p_qspi, uint32_t ul_mck_hz, uint32_t ul_hz)
+{
+	p_qspi->QSPI_CR = QSPI_CR_SWRST;
+	p_qspi->QSPI_MR = QSPI_MR_SMM_MEMORY | QSPI_MR_CSMODE_LASTXFER;
+	qspi_set_clock(p_qspi, ul_mck_hz, ul_hz);
+	p_qspi->QSPI_CR = QSPI_CR_QSPIEN;
+	while (!(p_qspi->QSPI_SR & QSPI_SR_QSPIENS)) {
+	}
+}
+
+/**
+ * \brief Set the serial clock, as fast as possible up to \a ul_hz.
+ *
+ * \param p_qspi QSPI instance, idle.
+ * \param ul_mck_hz Peripheral clock frequency.
+ * \param ul_hz Highest serial clock frequency.
+ */
+void qspi_set_clock(Qspi *p_qspi, uint32_t ul_mck_hz, uint32_t ul_hz)
+{
+	/* QSCK = MCK / (SCBR + 1). */
+	uint32_t ul_scbr = (ul_mck_hz + ul_hz - 1) / ul_hz;
+
+	ul_scbr = ul_scbr ? ul_scbr - 1 : 0;
+	if (ul_scbr > 255) {
+		ul_scbr = 255;
+	}
+	p_qspi->QSPI_SCR = QSPI_SCR_SCBR(ul_scbr);
+}
+
+/**
+ * \brief Write the frame registers.
+ *
+ * Reading QSPI_IFR back makes sure the frame is set before the memory
+ * window is accessed: the registers and the window are on different
+ * buses.
+ */
+static void qspi_set_frame(Qspi *p_qspi, const qspi_cmd_t *p_cmd)
+{
+	if (p_cmd->ul_ifr & QSPI_IFR_ADDREN) {
+		p_qspi->QSPI_IAR = p_cmd->ul_addr;
+	}
+	p_qspi->QSPI_ICR = QSPI_ICR_INST(p_cmd->uc_inst) |
+			QSPI_ICR_OPT(p_cmd->uc_opt);
+	p_qspi->QSPI_IFR = p_cmd->ul_ifr;
+	(void)p_qspi->QSPI_IFR;
+}
+
+/**
+ * \brief Send an instruction frame and wait for its end.
+ *
+ * \param p_qspi QSPI instance.
+ * \param p_cmd Frame, with QSPI_IFR_TFRTYP_TRSFR_READ or
+ * QSPI_IFR_TFRTYP_TRSFR_WRITE. The address comes from \a p_cmd.
+ * \param p_rx Buffer of the data read, or NULL.
+ * \param p_tx Data written, or NULL.
+ * \param ul_len Data length, 0 if the frame has no data.
+ *
+ * \retval STATUS_OK The frame is sent.
+ * \retval ERR_TIMEOUT The frame did not end.
+ */
+status_code_t qspi_exec(Qspi *p_qspi, const qspi_cmd_t *p_cmd, void *p_rx,
+		const void *p_tx, uint32_t ul_len)
+{
+	volatile uint8_t *p_mem = (volatile uint8_t *)QSPIMEM_ADDR;
+	uint32_t ul_timeout = QSPI_TIMEOUT;
+	uint32_t i;
+
+	/* Clear a stale end of frame. */
+	(void)p_qspi->QSPI_SR;
+	qspi_set_frame(p_qspi, p_cmd);
+
+	if (p_cmd->ul_ifr & QSPI_IFR_DATAEN) {
+		/* The window is strongly ordered: bytes, in order. */
+		if (p_rx) {
+			for (i = 0; i < ul_len; i++) {
+				((uint8_t *)p_rx)[i] = p_mem[i];
+			}
+		} else if (p_tx) {
+			for (i = 0; i < ul_len; i++) {
+				p_mem[i] = ((const uint8_t *)p_tx)[i];
+			}
+		}
+		__DSB();
+		__ISB();
+		p_qspi->QSPI_CR = QSPI_CR_LASTXFER;
+	}
+
+	while (!(p_qspi->QSPI_SR & QSPI_SR_INSTRE)) {
+		if (!--ul_timeout) {
+			return ERR_TIMEOUT;
+		}
+	}
+	return STATUS_OK;
+}
+
+/**
+ * \brief Map the flash in the memory window.
+ *
+ * \param p_qspi QSPI instance.
+ * \param p_cmd Read frame, with QSPI_IFR_TFRTYP_TRSFR_READ_MEMORY and
+ * QSPI_IFR_ADDREN. The address comes from each read.
+ */
+void qspi_enable_memory_read(Qspi *p_qspi, const qspi_cmd_t *p_cmd)
+{
+	qspi_set_frame(p_qspi, p_cmd);
+	__DSB();
+	__ISB();
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
@@ -0,0 +1,73 @@
+/**
+ * \file
+ *
+ * \brief SAM Quad Serial Peripheral Interface (QSPI) driver.
+ *
+ */
+
+#ifndef QSPI_H_INCLUDED
+#define QSPI_H_INCLUDED
+
+#include "compiler.h"
+#include "status_codes.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \defgroup sam_drivers_qspi_group Quad Serial Peripheral Interface (QSPI)
+ *
+ * Serial memory mode of the QSPI: instruction frames to a serial flash, and
+ * reads of the flash mapped at QSPIMEM_ADDR.
+ *
+ * A frame is an instruction, an optional address, an optional option
+ * byte, dummy cycles and data, each on one, two or four lines as the
+ * QSPI_IFR width says. qspi_exec() sends one frame and moves its data
+ * through the memory window, where the board maps QSPIMEM_ADDR strongly
+ * ordered.
+ *
+ * After qspi_enable_memory_read(), any read in the window sends the given
+ * read frame with the offset as address, so the flash can be read like
+ * memory, through the cache and by the DMA, and code can run from it.
+ * The next qspi_exec() ends it: nothing may read the window meanwhile.
+ *
+ * @{
+ */
+
+/** Instruction frame. */
+typedef struct qspi_cmd {
+	/** Instruction code, sent if QSPI_IFR_INSTEN is set. */
+	uint8_t uc_inst;
+	/** Option code, sent if QSPI_IFR_OPTEN is set. */
+	uint8_t uc_opt;
+	/** Address, sent if QSPI_IFR_ADDREN is set. */
+	uint32_t ul_addr;
+	/**
+	 * QSPI_IFR value: widths, fields sent, option length, dummy cycles and
+	 * transfer type.
+	 */
+	uint32_t ul_ifr;
+} qspi_cmd_t;
+
+void qspi_init(Qspi *p_qspi, uint32_t ul_mck_hz, uint32_t ul_hz);
+void qspi_set_clock(Qspi *p_qspi, uint32_t ul_mck_hz, uint32_t ul_hz);
+status_code_t qspi_exec(Qspi *p_qspi, const qspi_cmd_t *p_cmd, void *p_rx,
+		const void *p_tx, uint32_t ul_len);
+void qspi_enable_memory_read(Qspi *p_qspi, const qspi_cmd_t *p_cmd);
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+#endif /* QSPI_H_INCLUDED */
@@ -0,0 +1,87 @@
+/**
+ * \file
+ *
+ * \brief SAM Timer Counter (TC) driver.
+ *
+ */
+
+#include "tc.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \addtogroup sam_drivers_tc_group
+ *
+ * @{
+ */
+
+/** MCK divisions of TIMER_CLOCK2 to TIMER_CLOCK4 (TIMER_CLOCK1 is PCK6). */
+static const uint32_t gs_ul_tc_divisors[] = { 8, 32, 128 };
+
+/**
+ * \brief Stop a channel and set its mode. The channel interrupts are
+ * disabled and its status is cleared.
+ *
+ * \param p_tc Pointer to a TC instance.
+ * \param ul_channel Channel, 0 to 2.
+ * \param ul_mode TC_CMR value.
+ */
+void tc_init(Tc *p_tc, uint32_t ul_channel, uint32_t ul_mode)
+{
+	TcChannel *p_ch = &p_tc->TC_CHANNEL[ul_channel];
+
+	p_ch->TC_CCR = TC_CCR_CLKDIS;
+	p_ch->TC_IDR = 0xFFFFFFFF;
+	(void)p_ch->TC_SR;
+	p_ch->TC_CMR = ul_mode;
+}
+
+/**
+ * \brief Find the fastest MCK based clock with which the counter can count
+ * one period of a frequency.
+ *
+ * \param ul_freq Period frequency in Hz.
+ * \param ul_mck Peripheral clock in Hz.
+ * \param p_div Set to the MCK division, may be NULL.
+ * \param p_tcclks Set to the TC_CMR_TCCLKS value, may be NULL.
+ *
+ * \return 1 on success, 0 if the frequency is too low or too high.
+ */
+uint32_t tc_find_mck_divisor(uint32_t ul_freq, uint32_t ul_mck,
+		uint32_t *p_div, uint32_t *p_tcclks)
+{
+	uint32_t i;
+
+	if (!ul_freq || ul_freq > ul_mck / gs_ul_tc_divisors[0] / 2) {
+		return 0;
+	}
+	for (i = 0; i < sizeof(gs_ul_tc_divisors) / sizeof(gs_ul_tc_divisors[0]);
+			i++) {
+		if (ul_mck / gs_ul_tc_divisors[i] / ul_freq <= TC_COUNTER_MAX + 1) {
+			if (p_div) {
+				*p_div = gs_ul_tc_divisors[i];
+			}
+			if (p_tcclks) {
+				*p_tcclks = TC_CMR_TCCLKS_TIMER_CLOCK2 + i;
+			}
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
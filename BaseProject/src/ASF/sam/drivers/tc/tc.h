@@ -0,0 +1,93 @@
+/**
+ * \file
+ *
+ * \brief SAM Timer Counter (TC) driver.
+ *
+ */
+
+#ifndef TC_H_INCLUDED
+#define TC_H_INCLUDED
+
+#include "compiler.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \defgroup sam_drivers_tc_group Timer Counter (TC)
+ *
+ * Channel setup and control for the TC blocks, with the function names of
+ * the ASF TC driver. Only what this project needs is provided: the
+ * waveform mode used to generate periodic TIOA events, e.g. to trigger the
+ * AFEC, and the internal clock selection.
+ *
+ * The counters are 16-bit wide.
+ *
+ * @{
+ */
+
+/** Largest RA, RB and RC value. */
+#define TC_COUNTER_MAX     0xFFFFu
+
+void tc_init(Tc *p_tc, uint32_t ul_channel, uint32_t ul_mode);
+uint32_t tc_find_mck_divisor(uint32_t ul_freq, uint32_t ul_mck,
+		uint32_t *p_div, uint32_t *p_tcclks);
+
+/**
+ * \brief Start a channel, resetting its counter.
+ */
+static inline void tc_start(Tc *p_tc, uint32_t ul_channel)
+{
+	p_tc->TC_CHANNEL[ul_channel].TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+}
+
+/**
+ * \brief Stop the clock of a channel.
+ */
+static inline void tc_stop(Tc *p_tc, uint32_t ul_channel)
+{
+	p_tc->TC_CHANNEL[ul_channel].TC_CCR = TC_CCR_CLKDIS;
+}
+
+/**
+ * \brief Write the RA compare value of a channel in waveform mode.
+ */
+static inline void tc_write_ra(Tc *p_tc, uint32_t ul_channel,
+		uint32_t ul_value)
+{
+	p_tc->TC_CHANNEL[ul_channel].TC_RA = ul_value;
+}
+
+/**
+ * \brief Write the RC compare value of a channel.
+ */
+static inline void tc_write_rc(Tc *p_tc, uint32_t ul_channel,
+		uint32_t ul_value)
+{
+	p_tc->TC_CHANNEL[ul_channel].TC_RC = ul_value;
+}
+
+/**
+ * \brief Read the counter of a channel.
+ */
+static inline uint32_t tc_read_cv(Tc *p_tc, uint32_t ul_channel)
+{
+	return p_tc->TC_CHANNEL[ul_channel].TC_CV;
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+#endif /* TC_H_INCLUDED */
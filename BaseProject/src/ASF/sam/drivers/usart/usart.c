@@ -101,14 +101,106 @@ extern "C" {
 #define ISO7816_T_0                   0
 #define ISO7816_T_1                   1
 
+/**
+ * \brief Compute the baud rate generator settings for one oversampling mode.
+ *
+ * \param baudrate Baud rate set point.
+ * \param ul_mck USART module input clock frequency.
+ * \param over Oversampling, 16 or 8.
+ * \param p_plan Pointer to the settings to fill.
+ *
+ * \retval 0 The settings are valid.
+ * \retval 1 The divider is out of range for this oversampling.
+ */
+static uint32_t usart_plan_async_over(uint32_t baudrate, uint32_t ul_mck,
+		uint32_t over, usart_baud_plan_t *p_plan)
+{
+	uint64_t ull_div = (uint64_t)over * baudrate;
+	uint64_t ull_cd_fp;
+	uint64_t ull_actual;
+
+	/*
+	 * Divider in 1/8 steps: of the two around the exact one, the one whose
+	 * rate comes closest. The rate goes as the inverse of the divider, so
+	 * this is not always the nearer divider.
+	 */
+	ull_cd_fp = ((uint64_t)8 * ul_mck) / ull_div;
+	if ((uint64_t)8 * ul_mck * (2 * ull_cd_fp + 1) >
+			2 * ull_div * ull_cd_fp * (ull_cd_fp + 1)) {
+		ull_cd_fp++;
+	}
+	if ((ull_cd_fp >> 3) < MIN_CD_VALUE || (ull_cd_fp >> 3) > MAX_CD_VALUE) {
+		return 1;
+	}
+
+	ull_actual = ((uint64_t)8 * ul_mck + (over * ull_cd_fp) / 2) /
+			(over * ull_cd_fp);
+
+	p_plan->over = over;
+	p_plan->cd = (uint32_t)(ull_cd_fp >> 3);
+	p_plan->fp = (uint32_t)(ull_cd_fp & 0x07);
+	p_plan->actual_baudrate = (uint32_t)ull_actual;
+	p_plan->error_ppm = (int32_t)((int64_t)(((uint64_t)8 * ul_mck * 1000000) /
+			(over * ull_cd_fp * baudrate)) - 1000000);
+
+	return 0;
+}
+
+/**
+ * \brief Find the baud rate generator settings of the USART asynchronous
+ * modes that come closest to a baud rate set point.
+ *
+ * \note Baud rate calculation: Baudrate = ul_mck/(Over * (CD + FP/8))
+ * (Over being 16 or 8). Both oversampling modes are evaluated and the one
+ * with the smallest error is kept; on a tie 16x is preferred for its better
+ * noise immunity. 8x oversampling extends the range up to ul_mck / 8.
+ *
+ * \param baudrate Baud rate set point.
+ * \param ul_mck USART module input clock frequency.
+ * \param p_plan Pointer to the settings to fill, including the achieved
+ * baud rate and its error.
+ *
+ * \retval 0 Settings found.
+ * \retval 1 Baud rate set point is out of range for the given input clock
+ * frequency.
+ */
+uint32_t usart_plan_async_baudrate(uint32_t baudrate, uint32_t ul_mck,
+		usart_baud_plan_t *p_plan)
+{
+	usart_baud_plan_t plan_high;
+	usart_baud_plan_t plan_low;
+	uint32_t ul_high_err;
+	uint32_t ul_low_err;
+
+	if (baudrate == 0) {
+		return 1;
+	}
+
+	if (usart_plan_async_over(baudrate, ul_mck, HIGH_FRQ_SAMPLE_DIV,
+			&plan_high)) {
+		return usart_plan_async_over(baudrate, ul_mck, LOW_FRQ_SAMPLE_DIV,
+				p_plan);
+	}
+	if (usart_plan_async_over(baudrate, ul_mck, LOW_FRQ_SAMPLE_DIV,
+			&plan_low)) {
+		*p_plan = plan_high;
+		return 0;
+	}
+
+	ul_high_err = (uint32_t)abs(plan_high.error_ppm);
+	ul_low_err = (uint32_t)abs(plan_low.error_ppm);
+	*p_plan = (ul_low_err < ul_high_err) ? plan_low : plan_high;
+
+	return 0;
+}
+
 /**
  * \brief Calculate a clock divider(CD) and a fractional part (FP) for the
  * USART asynchronous modes to generate a baudrate as close as possible to
  * the baudrate set point.
  *
- * \note Baud rate calculation: Baudrate = ul_mck/(Over * (CD + FP/8))
- * (Over being 16 or 8). The maximal oversampling is selected if it allows to
- * generate a baudrate close to the set point.
+ * \note The settings are chosen by usart_plan_async_baudrate(), which can
+ * be called beforehand to check the achievable rate and error.
  *
  * \param p_usart Pointer to a USART instance.
  * \param baudrate Baud rate set point.
@@ -121,33 +213,22 @@ extern "C" {
 uint32_t usart_set_async_baudrate(Usart *p_usart,
 		uint32_t baudrate, uint32_t ul_mck)
 {
-	uint32_t over;
-	uint32_t cd_fp;
-	uint32_t cd;
-	uint32_t fp;
-
-	/* Calculate the receiver sampling divide of baudrate clock. */
-	if (ul_mck >= HIGH_FRQ_SAMPLE_DIV * baudrate) {
-		over = HIGH_FRQ_SAMPLE_DIV;
-	} else {
-		over = LOW_FRQ_SAMPLE_DIV;
-	}
+	usart_baud_plan_t plan;
 
-	/* Calculate clock divider according to the fraction calculated formula. */
-	cd_fp = (8 * ul_mck + (over * baudrate) / 2) / (over * baudrate);
-	cd = cd_fp >> 3;
-	fp = cd_fp & 0x07;
-	if (cd < MIN_CD_VALUE || cd > MAX_CD_VALUE) {
+	if (usart_plan_async_baudrate(baudrate, ul_mck, &plan)) {
 		return 1;
 	}
 
 	/* Configure the OVER bit in MR register. */
-	if (over == 8) {
+	if (plan.over == LOW_FRQ_SAMPLE_DIV) {
 		p_usart->US_MR |= US_MR_OVER;
+	} else {
+		p_usart->US_MR &= ~US_MR_OVER;
 	}
 
 	/* Configure the baudrate generate register. */
-	p_usart->US_BRGR = (cd << US_BRGR_CD_Pos) | (fp << US_BRGR_FP_Pos);
+	p_usart->US_BRGR = (plan.cd << US_BRGR_CD_Pos) |
+			(plan.fp << US_BRGR_FP_Pos);
 
 	return 0;
 }
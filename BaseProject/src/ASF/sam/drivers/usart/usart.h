@@ -205,7 +205,27 @@ typedef struct {
 	uint32_t channel_mode;
 } usart_spi_opt_t;
 
+/* Baud rate generator settings computed for the asynchronous modes. */
+typedef struct {
+	/* Oversampling, 16 or 8. */
+	uint32_t over;
+
+	/* Clock divider, programmed in US_BRGR.CD. */
+	uint32_t cd;
+
+	/* Fractional part in 1/8 steps, programmed in US_BRGR.FP. */
+	uint32_t fp;
+
+	/* Baud rate actually generated with these settings. */
+	uint32_t actual_baudrate;
+
+	/* Deviation of the actual baud rate from the set point, in ppm. */
+	int32_t error_ppm;
+} usart_baud_plan_t;
+
 void usart_reset(Usart *p_usart);
+uint32_t usart_plan_async_baudrate(uint32_t baudrate, uint32_t ul_mck,
+		usart_baud_plan_t *p_plan);
 uint32_t usart_set_async_baudrate(Usart *p_usart,
 		uint32_t baudrate, uint32_t ul_mck);
 uint32_t usart_init_rs232(Usart *p_usart,
@@ -0,0 +1,351 @@
+/**
+ * \file
+ *
+ * \brief USART SPI master DMA transfer engine.
+ *
+ */
+
+#include <string.h>
+#include "usart_spi_dma.h"
+#include "dcache.h"
+#include "interrupt.h"
+#include "ioport.h"
+#include "usart.h"
+#include "xdmac.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \addtogroup sam_drivers_usart_spi_dma_group
+ *
+ * @{
+ */
+
+/** Channel errors that fail the transfer. */
+#define USART_SPI_DMA_ERRORS \
+	(XDMAC_CIE_RBIE | XDMAC_CIE_WBIE | XDMAC_CIE_ROIE)
+
+/** Divisor range of the SPI master mode. */
+#define USART_SPI_DMA_MIN_CD      4
+#define USART_SPI_DMA_MAX_CD      (US_BRGR_CD_Msk >> US_BRGR_CD_Pos)
+
+/**
+ * Source of the characters sent without a transmit buffer. In flash, so
+ * the DMA reads it whatever the cache holds.
+ */
+static const uint8_t gs_uc_tx_dummy = USART_SPI_DMA_DUMMY;
+
+/**
+ * Destination of the characters received without a receive buffer, for
+ * every engine. Never read; alone on its cache line, so that no
+ * maintenance of other data can write a stale copy over it.
+ */
+static uint8_t gs_uc_rx_sink[DCACHE_LINE_SIZE] DCACHE_ALIGNED;
+
+static void usart_spi_dma_cs_assert(usart_spi_dma_t *p_dev, uint32_t ul_cs)
+{
+	if (ul_cs == USART_SPI_DMA_CS_HW) {
+		usart_spi_force_chip_select(p_dev->p_usart);
+	} else if (ul_cs != USART_SPI_DMA_CS_NONE) {
+		ioport_set_pin_level(ul_cs, IOPORT_PIN_LEVEL_LOW);
+	}
+}
+
+static void usart_spi_dma_cs_release(usart_spi_dma_t *p_dev, uint32_t ul_cs)
+{
+	if (ul_cs == USART_SPI_DMA_CS_HW) {
+		usart_spi_release_chip_select(p_dev->p_usart);
+	} else if (ul_cs != USART_SPI_DMA_CS_NONE) {
+		ioport_set_pin_level(ul_cs, IOPORT_PIN_LEVEL_HIGH);
+	}
+}
+
+/**
+ * \brief Program both channels for the transfer at the head of the queue
+ * and start it. Called with interrupts masked.
+ */
+static void usart_spi_dma_start(usart_spi_dma_t *p_dev)
+{
+	struct usart_spi_xfer *p_xfer = p_dev->p_head;
+	Usart *p_usart = p_dev->p_usart;
+	xdmac_channel_config_t cfg;
+
+	if (p_dev->ul_cs_held != p_xfer->ul_cs) {
+		usart_spi_dma_cs_release(p_dev, p_dev->ul_cs_held);
+		usart_spi_dma_cs_assert(p_dev, p_xfer->ul_cs);
+	}
+	p_dev->ul_cs_held = USART_SPI_DMA_CS_NONE;
+
+	/* Drop a stale character and a previous overrun. */
+	(void)p_usart->US_RHR;
+	usart_reset_status(p_usart);
+
+	if (p_xfer->p_tx) {
+		dcache_clean(p_xfer->p_tx, p_xfer->ul_len);
+	}
+	if (p_xfer->p_rx) {
+		dcache_clean_invalidate(p_xfer->p_rx, p_xfer->ul_len);
+	}
+
+	cfg.mbr_ubc = p_xfer->ul_len;
+	cfg.mbr_bc = 0;
+	cfg.mbr_ds = 0;
+	cfg.mbr_sus = 0;
+	cfg.mbr_dus = 0;
+
+	/* Receive first, so that no character can be missed. */
+	cfg.mbr_sa = (uint32_t)&p_usart->US_RHR;
+	cfg.mbr_da = p_xfer->p_rx ? (uint32_t)p_xfer->p_rx :
+			(uint32_t)gs_uc_rx_sink;
+	cfg.mbr_cfg = XDMAC_CC_TYPE_PER_TRAN | XDMAC_CC_MBSIZE_SINGLE |
+			XDMAC_CC_DSYNC_PER2MEM | XDMAC_CC_CSIZE_CHK_1 |
+			XDMAC_CC_DWIDTH_BYTE | XDMAC_CC_SIF_AHB_IF1 |
+			XDMAC_CC_DIF_AHB_IF0 | XDMAC_CC_SAM_FIXED_AM |
+			(p_xfer->p_rx ? XDMAC_CC_DAM_INCREMENTED_AM :
+			XDMAC_CC_DAM_FIXED_AM) |
+			XDMAC_CC_PERID(p_dev->ul_rx_perid);
+	xdmac_configure_transfer(XDMAC, p_dev->ul_rx_ch, &cfg);
+
+	cfg.mbr_sa = p_xfer->p_tx ? (uint32_t)p_xfer->p_tx :
+			(uint32_t)&gs_uc_tx_dummy;
+	cfg.mbr_da = (uint32_t)&p_usart->US_THR;
+	cfg.mbr_cfg = XDMAC_CC_TYPE_PER_TRAN | XDMAC_CC_MBSIZE_SINGLE |
+			XDMAC_CC_DSYNC_MEM2PER | XDMAC_CC_CSIZE_CHK_1 |
+			XDMAC_CC_DWIDTH_BYTE | XDMAC_CC_SIF_AHB_IF0 |
+			XDMAC_CC_DIF_AHB_IF1 | XDMAC_CC_DAM_FIXED_AM |
+			(p_xfer->p_tx ? XDMAC_CC_SAM_INCREMENTED_AM :
+			XDMAC_CC_SAM_FIXED_AM) |
+			XDMAC_CC_PERID(p_dev->ul_tx_perid);
+	xdmac_configure_transfer(XDMAC, p_dev->ul_tx_ch, &cfg);
+
+	xdmac_channel_enable(XDMAC, p_dev->ul_rx_ch);
+	xdmac_channel_enable(XDMAC, p_dev->ul_tx_ch);
+}
+
+/**
+ * \brief Retire the transfer at the head of the queue, start the next one
+ * and run the callback. Called from the XDMAC interrupt.
+ */
+static void usart_spi_dma_complete(usart_spi_dma_t *p_dev, int32_t l_status)
+{
+	struct usart_spi_xfer *p_xfer = p_dev->p_head;
+
+	if (p_xfer->p_rx) {
+		dcache_invalidate(p_xfer->p_rx, p_xfer->ul_len);
+	}
+	if ((p_xfer->ul_flags & USART_SPI_DMA_CS_HOLD) && l_status == STATUS_OK) {
+		p_dev->ul_cs_held = p_xfer->ul_cs;
+	} else {
+		usart_spi_dma_cs_release(p_dev, p_xfer->ul_cs);
+	}
+	if (l_status == STATUS_OK) {
+		p_dev->ul_completed++;
+	} else {
+		p_dev->ul_errors++;
+	}
+
+	p_dev->p_head = p_xfer->p_next;
+	if (p_dev->p_head) {
+		usart_spi_dma_start(p_dev);
+	} else {
+		p_dev->p_tail = NULL;
+	}
+
+	p_xfer->p_next = NULL;
+	p_xfer->l_status = l_status;
+	if (p_xfer->callback) {
+		p_xfer->callback(p_xfer);
+	}
+}
+
+/**
+ * \brief XDMAC callback of both channels. The transfer is done when the
+ * receive channel has stored the last character.
+ */
+static void usart_spi_dma_handler(uint32_t ul_ch, uint32_t ul_status,
+		void *p_ctx)
+{
+	usart_spi_dma_t *p_dev = (usart_spi_dma_t *)p_ctx;
+
+	if (!p_dev->p_head) {
+		return;
+	}
+	if (ul_status & USART_SPI_DMA_ERRORS) {
+		xdmac_channel_abort(XDMAC, p_dev->ul_tx_ch);
+		xdmac_channel_abort(XDMAC, p_dev->ul_rx_ch);
+		usart_spi_dma_complete(p_dev, ERR_IO_ERROR);
+	} else if (ul_ch == p_dev->ul_rx_ch && (ul_status & XDMAC_CIS_BIS)) {
+		usart_spi_dma_complete(p_dev, STATUS_OK);
+	}
+}
+
+/**
+ * \brief Attach the engine to a USART already set up with
+ * usart_init_spi_master(), and enable its transmitter and receiver.
+ *
+ * \param p_dev Engine state.
+ * \param p_usart Pointer to a USART instance.
+ * \param ul_baudrate Baud rate given to usart_init_spi_master().
+ * \param ul_tx_perid XDMAC transmit interface of the USART (XDMAC_PERID_*).
+ * \param ul_rx_perid XDMAC receive interface of the USART (XDMAC_PERID_*).
+ *
+ * \retval STATUS_OK Success.
+ * \retval ERR_NO_MEMORY Not enough free XDMAC channels.
+ */
+status_code_t usart_spi_dma_init(usart_spi_dma_t *p_dev, Usart *p_usart,
+		uint32_t ul_baudrate, uint32_t ul_tx_perid, uint32_t ul_rx_perid)
+{
+	int32_t l_tx_ch, l_rx_ch;
+
+	memset(p_dev, 0, sizeof(*p_dev));
+	p_dev->p_usart = p_usart;
+	p_dev->ul_tx_perid = ul_tx_perid;
+	p_dev->ul_rx_perid = ul_rx_perid;
+	p_dev->ul_cs_held = USART_SPI_DMA_CS_NONE;
+	p_dev->ul_baudrate = ul_baudrate;
+
+	l_tx_ch = xdmac_channel_alloc(usart_spi_dma_handler, p_dev);
+	if (l_tx_ch < 0) {
+		return ERR_NO_MEMORY;
+	}
+	l_rx_ch = xdmac_channel_alloc(usart_spi_dma_handler, p_dev);
+	if (l_rx_ch < 0) {
+		xdmac_channel_free(l_tx_ch);
+		return ERR_NO_MEMORY;
+	}
+	p_dev->ul_tx_ch = l_tx_ch;
+	p_dev->ul_rx_ch = l_rx_ch;
+
+	xdmac_channel_enable_interrupt(XDMAC, p_dev->ul_tx_ch,
+			USART_SPI_DMA_ERRORS);
+	xdmac_channel_enable_interrupt(XDMAC, p_dev->ul_rx_ch,
+			XDMAC_CIE_BIE | USART_SPI_DMA_ERRORS);
+
+	usart_enable_tx(p_usart);
+	usart_enable_rx(p_usart);
+
+	return STATUS_OK;
+}
+
+/**
+ * \brief Abort the queue and give the XDMAC channels back.
+ */
+void usart_spi_dma_deinit(usart_spi_dma_t *p_dev)
+{
+	usart_spi_dma_abort(p_dev);
+	xdmac_channel_free(p_dev->ul_tx_ch);
+	xdmac_channel_free(p_dev->ul_rx_ch);
+}
+
+/**
+ * \brief Set the divisor for the engine baud rate at a new MCK, rounded as
+ * usart_init_spi_master() does.
+ *
+ * Meant for a clock_scale notifier, see \ref sam_drivers_usart_spi_dma_group.
+ * May be called while a transfer runs.
+ *
+ * \param p_dev Engine state.
+ * \param ul_mck_hz MCK frequency in Hz.
+ */
+void usart_spi_dma_set_clock(usart_spi_dma_t *p_dev, uint32_t ul_mck_hz)
+{
+	uint32_t ul_cd = (ul_mck_hz + p_dev->ul_baudrate / 2) /
+			p_dev->ul_baudrate;
+
+	if (ul_cd < USART_SPI_DMA_MIN_CD) {
+		ul_cd = USART_SPI_DMA_MIN_CD;
+	} else if (ul_cd > USART_SPI_DMA_MAX_CD) {
+		ul_cd = USART_SPI_DMA_MAX_CD;
+	}
+	p_dev->p_usart->US_BRGR = US_BRGR_CD(ul_cd);
+}
+
+/**
+ * \brief Queue a transfer, starting it at once if the engine is idle.
+ *
+ * May be called from a task, an interrupt or a completion callback.
+ *
+ * \param p_dev Engine state.
+ * \param p_xfer Transfer, owned by the engine until its callback runs.
+ *
+ * \retval STATUS_OK The transfer is queued.
+ * \retval ERR_INVALID_ARG Zero or too large length.
+ */
+status_code_t usart_spi_dma_submit(usart_spi_dma_t *p_dev,
+		struct usart_spi_xfer *p_xfer)
+{
+	irqflags_t flags;
+
+	if (p_xfer->ul_len == 0 || p_xfer->ul_len > XDMAC_UBLEN_MAX) {
+		return ERR_INVALID_ARG;
+	}
+	p_xfer->l_status = OPERATION_IN_PROGRESS;
+	p_xfer->p_next = NULL;
+
+	flags = cpu_irq_save();
+	if (p_dev->p_tail) {
+		p_dev->p_tail->p_next = p_xfer;
+		p_dev->p_tail = p_xfer;
+	} else {
+		p_dev->p_head = p_xfer;
+		p_dev->p_tail = p_xfer;
+		usart_spi_dma_start(p_dev);
+	}
+	cpu_irq_restore(flags);
+
+	return STATUS_OK;
+}
+
+/**
+ * \brief Stop the running transfer, release the chip select and fail every
+ * queued transfer with ERR_ABORTED. The callbacks run from the caller
+ * context.
+ */
+void usart_spi_dma_abort(usart_spi_dma_t *p_dev)
+{
+	struct usart_spi_xfer *p_xfer;
+	irqflags_t flags;
+
+	flags = cpu_irq_save();
+	xdmac_channel_abort(XDMAC, p_dev->ul_tx_ch);
+	xdmac_channel_abort(XDMAC, p_dev->ul_rx_ch);
+	(void)xdmac_channel_get_interrupt_status(XDMAC, p_dev->ul_tx_ch);
+	(void)xdmac_channel_get_interrupt_status(XDMAC, p_dev->ul_rx_ch);
+	p_xfer = p_dev->p_head;
+	if (p_xfer) {
+		usart_spi_dma_cs_release(p_dev, p_xfer->ul_cs);
+	}
+	usart_spi_dma_cs_release(p_dev, p_dev->ul_cs_held);
+	p_dev->ul_cs_held = USART_SPI_DMA_CS_NONE;
+	p_dev->p_head = NULL;
+	p_dev->p_tail = NULL;
+	cpu_irq_restore(flags);
+
+	while (p_xfer) {
+		struct usart_spi_xfer *p_next = p_xfer->p_next;
+
+		p_dev->ul_errors++;
+		p_xfer->p_next = NULL;
+		p_xfer->l_status = ERR_ABORTED;
+		if (p_xfer->callback) {
+			p_xfer->callback(p_xfer);
+		}
+		p_xfer = p_next;
+	}
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
@@ -0,0 +1,138 @@
+/**
+ * \file
+ *
+ * \brief USART SPI master DMA transfer engine.
+ *
+ */
+
+#ifndef USART_SPI_DMA_H_INCLUDED
+#define USART_SPI_DMA_H_INCLUDED
+
+#include "compiler.h"
+#include "status_codes.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \defgroup sam_drivers_usart_spi_dma_group USART SPI master DMA engine
+ *
+ * Full-duplex transfers on a USART configured with usart_init_spi_master()
+ * (8-bit characters), moved by a pair of XDMAC channels.
+ *
+ * Transfers are described by caller-owned struct usart_spi_xfer records and
+ * queued with usart_spi_dma_submit(); the engine starts the next one from
+ * the completion interrupt, so back-to-back transfers run without the CPU.
+ * Each transfer selects its own chip select, which is asserted before the
+ * first character and released after the last one has been received,
+ * unless USART_SPI_DMA_CS_HOLD asks to keep it for the next transfer.
+ *
+ * Buffers must stay valid until the completion callback. Receive buffers
+ * must be cache line aligned and span whole lines, see
+ * \ref utils_dcache_group.
+ *
+ * The engine does not follow MCK changes by itself. Across
+ * \ref clock_scale_group switches, the owner of the engine registers a
+ * notifier that calls usart_spi_dma_set_clock(): before the switch with the
+ * higher of both MCK frequencies, so that the bus is slow enough for both,
+ * and after it with the new one. A transfer may run meanwhile: the master
+ * clocks the bus, so only its pace changes.
+ *
+ * @{
+ */
+
+/** Chip select driven by the USART itself (RTS used as NSS). */
+#define USART_SPI_DMA_CS_HW       0xFFFFFFFFu
+/** No chip select handling. */
+#define USART_SPI_DMA_CS_NONE     0xFFFFFFFEu
+
+/** Keep the chip select asserted after the transfer. */
+#define USART_SPI_DMA_CS_HOLD     (1u << 0)
+
+/** Character sent when a transfer has no transmit buffer. */
+#define USART_SPI_DMA_DUMMY       0xFF
+
+struct usart_spi_xfer;
+
+/**
+ * Completion callback, run from the XDMAC interrupt once the transfer is
+ * finished or failed. It may submit further transfers.
+ */
+typedef void (*usart_spi_dma_callback_t)(struct usart_spi_xfer *p_xfer);
+
+/** One transfer. */
+struct usart_spi_xfer {
+	/** Data to send, or NULL to send USART_SPI_DMA_DUMMY. */
+	const void *p_tx;
+	/** Buffer for the received data, or NULL to discard it. */
+	void *p_rx;
+	/** Number of bytes to exchange, 1 to XDMAC_UBLEN_MAX. */
+	uint32_t ul_len;
+	/** IOPORT pin of the chip select (active low), or USART_SPI_DMA_CS_*. */
+	uint32_t ul_cs;
+	/** USART_SPI_DMA_CS_HOLD or 0. */
+	uint32_t ul_flags;
+	/** Called on completion, may be NULL. */
+	usart_spi_dma_callback_t callback;
+	/** Free for the caller. */
+	void *p_ctx;
+	/**
+	 * OPERATION_IN_PROGRESS while queued or running, then STATUS_OK,
+	 * ERR_IO_ERROR on a DMA bus error or ERR_ABORTED.
+	 */
+	volatile int32_t l_status;
+	/** Internal queue link. */
+	struct usart_spi_xfer *p_next;
+};
+
+/** Engine state, one per USART. */
+typedef struct usart_spi_dma {
+	Usart *p_usart;
+	uint32_t ul_tx_ch;
+	uint32_t ul_rx_ch;
+	uint32_t ul_tx_perid;
+	uint32_t ul_rx_perid;
+	/** Transfer in progress, followed by the queued ones. */
+	struct usart_spi_xfer *p_head;
+	struct usart_spi_xfer *p_tail;
+	/** Chip select held by the last transfer, or USART_SPI_DMA_CS_NONE. */
+	uint32_t ul_cs_held;
+	/** Baud rate, kept across usart_spi_dma_set_clock() calls. */
+	uint32_t ul_baudrate;
+	/** Number of transfers completed and failed. */
+	uint32_t ul_completed;
+	uint32_t ul_errors;
+} usart_spi_dma_t;
+
+status_code_t usart_spi_dma_init(usart_spi_dma_t *p_dev, Usart *p_usart,
+		uint32_t ul_baudrate, uint32_t ul_tx_perid, uint32_t ul_rx_perid);
+void usart_spi_dma_deinit(usart_spi_dma_t *p_dev);
+void usart_spi_dma_set_clock(usart_spi_dma_t *p_dev, uint32_t ul_mck_hz);
+status_code_t usart_spi_dma_submit(usart_spi_dma_t *p_dev,
+		struct usart_spi_xfer *p_xfer);
+void usart_spi_dma_abort(usart_spi_dma_t *p_dev);
+
+/**
+ * \brief Tell whether the engine has no transfer running or queued.
+ */
+static inline bool usart_spi_dma_is_idle(const usart_spi_dma_t *p_dev)
+{
+	return ((volatile const usart_spi_dma_t *)p_dev)->p_head == NULL;
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+#endif /* USART_SPI_DMA_H_INCLUDED */
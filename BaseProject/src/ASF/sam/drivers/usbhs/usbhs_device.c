@@ -0,0 +1,685 @@
+/**
+ * \file
+ *
+ * \brief SAM USB High-Speed interface (USBHS) device driver.
+ *
+ */
+
+#include <string.h>
+#include "usbhs_device.h"
+#include "interrupt.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \addtogroup sam_drivers_usbhs_group
+ *
+ * @{
+ */
+
+/** Longest wait, in loop iterations, for the UTMI clock. */
+#define USBHS_TIMEOUT             100000
+
+/** Endpoint FIFO window. */
+#define USBHS_EP_FIFO(ep) \
+	((volatile uint8_t *)USBHS_RAM_ADDR + 0x8000u * (ep))
+
+/** Byte count of the current bank. */
+#define USBHS_EP_BYCT(ul_isr) \
+	(((ul_isr) & USBHS_DEVEPTISR_BYCT_Msk) >> USBHS_DEVEPTISR_BYCT_Pos)
+
+/** Instance served by USBHS_Handler(). */
+static usbhs_dev_t *gs_p_usbhs_dev;
+
+/**
+ * \brief Set the USBHS up in device mode, detached.
+ *
+ * The USB clock (UPLL) and the USBHS peripheral clock must be running.
+ *
+ * \param p_dev Driver state to initialize.
+ * \param p_usbhs USBHS base address.
+ * \param p_cfg Configuration.
+ *
+ * \retval STATUS_OK Success.
+ * \retval ERR_INVALID_ARG A callback is missing.
+ * \retval ERR_TIMEOUT The UTMI clock did not start.
+ */
+status_code_t usbhs_dev_init(usbhs_dev_t *p_dev, Usbhs *p_usbhs,
+		const usbhs_dev_config_t *p_cfg)
+{
+	uint32_t ul_timeout = USBHS_TIMEOUT;
+
+	if (!p_cfg->setup || !p_cfg->callback) {
+		return ERR_INVALID_ARG;
+	}
+	memset(p_dev, 0, sizeof(*p_dev));
+	p_dev->p_usbhs = p_usbhs;
+	p_dev->setup = p_cfg->setup;
+	p_dev->callback = p_cfg->callback;
+	p_dev->p_ctx = p_cfg->p_ctx;
+
+	p_usbhs->USBHS_CTRL = USBHS_CTRL_UIMOD_DEVICE | USBHS_CTRL_USBE;
+	while (!(p_usbhs->USBHS_SR & USBHS_SR_CLKUSABLE)) {
+		if (!--ul_timeout) {
+			p_usbhs->USBHS_CTRL = USBHS_CTRL_FRZCLK;
+			return ERR_TIMEOUT;
+		}
+	}
+	p_usbhs->USBHS_DEVCTRL = USBHS_DEVCTRL_DETACH |
+			(p_cfg->b_high_speed ? USBHS_DEVCTRL_SPDCONF_NORMAL :
+			USBHS_DEVCTRL_SPDCONF_FORCED_FS);
+
+	p_usbhs->USBHS_DEVIDR = 0xFFFFFFFFu;
+	p_usbhs->USBHS_DEVICR = USBHS_DEVICR_SUSPC | USBHS_DEVICR_EORSTC |
+			USBHS_DEVICR_WAKEUPC;
+	p_usbhs->USBHS_DEVIER = USBHS_DEVIER_EORSTES | USBHS_DEVIER_SUSPES;
+
+	gs_p_usbhs_dev = p_dev;
+
+	return STATUS_OK;
+}
+
+/**
+ * \brief Connect the pull-up: the host sees the device.
+ */
+void usbhs_dev_attach(usbhs_dev_t *p_dev)
+{
+	p_dev->p_usbhs->USBHS_DEVCTRL &= ~USBHS_DEVCTRL_DETACH;
+}
+
+/**
+ * \brief Disconnect the pull-up: the host sees the device leave.
+ */
+void usbhs_dev_detach(usbhs_dev_t *p_dev)
+{
+	p_dev->p_usbhs->USBHS_DEVCTRL |= USBHS_DEVCTRL_DETACH;
+}
+
+/**
+ * \brief Tell whether the last bus reset ended at high speed.
+ */
+bool usbhs_dev_is_high_speed(usbhs_dev_t *p_dev)
+{
+	return p_dev->b_high_speed;
+}
+
+/**
+ * \brief Give the data stage buffer of the request being set up.
+ *
+ * Called from the setup callback. For an IN request \a p_buf holds the
+ * answer, which is cut to wLength; for an OUT request it receives the data
+ * and must hold wLength bytes. It is used until the request ends.
+ *
+ * \param p_dev Driver state.
+ * \param p_buf Data stage buffer.
+ * \param us_len Answer length (IN), or buffer size (OUT).
+ */
+void usbhs_dev_ctrl_data(usbhs_dev_t *p_dev, void *p_buf, uint16_t us_len)
+{
+	p_dev->p_ctrl_buf = (uint8_t *)p_buf;
+	p_dev->us_ctrl_len = us_len;
+}
+
+/**
+ * \brief Stop the DMA transfer of an endpoint.
+ *
+ * \return Bytes moved before it stopped.
+ */
+static uint32_t usbhs_dev_dma_stop(usbhs_dev_t *p_dev, uint8_t uc_ep)
+{
+	Usbhs *p_usbhs = p_dev->p_usbhs;
+	UsbhsDevdma *p_dma = &p_usbhs->USBHS_DEVDMA[uc_ep - 1];
+	uint32_t ul_status;
+
+	p_dma->USBHS_DEVDMACONTROL = 0;
+	p_usbhs->USBHS_DEVIDR = USBHS_DEVIDR_DMA_1 << (uc_ep - 1);
+	ul_status = p_dma->USBHS_DEVDMASTATUS;
+
+	return p_dev->ul_xfer_len[uc_ep] -
+			((ul_status & USBHS_DEVDMASTATUS_BUFF_COUNT_Msk) >>
+			USBHS_DEVDMASTATUS_BUFF_COUNT_Pos);
+}
+
+/**
+ * \brief Bus reset: back to the control endpoint alone, without address.
+ */
+static void usbhs_dev_bus_reset(usbhs_dev_t *p_dev)
+{
+	Usbhs *p_usbhs = p_dev->p_usbhs;
+	uint8_t uc_ep;
+
+	for (uc_ep = 1; uc_ep <= USBHS_DEV_EP_DMA_MAX; uc_ep++) {
+		p_usbhs->USBHS_DEVDMA[uc_ep - 1].USBHS_DEVDMACONTROL = 0;
+	}
+	p_usbhs->USBHS_DEVIDR = 0xFFFFF000u;
+	p_usbhs->USBHS_DEVEPT = 0;
+	/* Free the endpoint memory from the top, so that no allocation is
+	 * shifted over another. */
+	for (uc_ep = USBHS_DEV_EP_COUNT - 1; uc_ep > 0; uc_ep--) {
+		p_usbhs->USBHS_DEVEPTCFG[uc_ep] = 0;
+	}
+	memset(p_dev->us_ep_size, 0, sizeof(p_dev->us_ep_size));
+	p_dev->uc_busy = 0;
+	p_dev->uc_zlp = 0;
+	p_dev->uc_address = 0;
+	p_dev->ctrl_state = USBHS_CTRL_SETUP;
+	p_dev->b_high_speed = (p_usbhs->USBHS_SR & USBHS_SR_SPEED_Msk) ==
+			USBHS_SR_SPEED_HIGH_SPEED;
+
+	p_usbhs->USBHS_DEVEPTCFG[0] = USBHS_DEVEPTCFG_EPSIZE_64_BYTE |
+			USBHS_DEVEPTCFG_EPBK_1_BANK | USBHS_DEVEPTCFG_EPTYPE_CTRL |
+			USBHS_DEVEPTCFG_ALLOC;
+	p_usbhs->USBHS_DEVEPT = USBHS_DEVEPT_EPEN0;
+	p_dev->us_ep_size[0] = USBHS_DEV_EP0_SIZE;
+	p_usbhs->USBHS_DEVEPTIER[0] = USBHS_DEVEPTIER_RXSTPES;
+	p_usbhs->USBHS_DEVIER = USBHS_DEVIER_PEP_0;
+}
+
+/**
+ * \brief Set an endpoint up. Done by the class on SET_CONFIGURATION or
+ * SET_INTERFACE, in increasing endpoint number order as the endpoint
+ * memory is allocated in that order.
+ *
+ * \param p_dev Driver state.
+ * \param uc_ep_addr Endpoint address: number, and USB_EP_DIR_IN for IN.
+ * \param type Transfer type.
+ * \param us_size Packet size, a power of two from 8 to 1024.
+ * \param uc_banks Banks, 1 to 3.
+ *
+ * \retval STATUS_OK Success.
+ * \retval ERR_INVALID_ARG Bad endpoint, size or bank count.
+ * \retval ERR_NO_MEMORY Out of endpoint memory.
+ */
+status_code_t usbhs_dev_ep_configure(usbhs_dev_t *p_dev, uint8_t uc_ep_addr,
+		usbhs_ep_type_t type, uint16_t us_size, uint8_t uc_banks)
+{
+	Usbhs *p_usbhs = p_dev->p_usbhs;
+	uint8_t uc_ep = uc_ep_addr & 0x0F;
+	uint32_t ul_size_code = 0;
+	uint32_t ul_cfg;
+
+	if (uc_ep == 0 || uc_ep >= USBHS_DEV_EP_COUNT ||
+			uc_banks < 1 || uc_banks > 3) {
+		return ERR_INVALID_ARG;
+	}
+	while ((8u << ul_size_code) < us_size) {
+		ul_size_code++;
+	}
+	if ((8u << ul_size_code) != us_size || ul_size_code > 7) {
+		return ERR_INVALID_ARG;
+	}
+
+	ul_cfg = USBHS_DEVEPTCFG_EPSIZE(ul_size_code) |
+			USBHS_DEVEPTCFG_EPBK(uc_banks - 1) |
+			USBHS_DEVEPTCFG_EPTYPE(type) | USBHS_DEVEPTCFG_AUTOSW;
+	if (uc_ep_addr & USB_EP_DIR_IN) {
+		ul_cfg |= USBHS_DEVEPTCFG_EPDIR_IN;
+	}
+	p_usbhs->USBHS_DEVEPTCFG[uc_ep] = ul_cfg;
+	p_usbhs->USBHS_DEVEPT |= USBHS_DEVEPT_EPEN0 << uc_ep;
+	p_usbhs->USBHS_DEVEPTCFG[uc_ep] = ul_cfg | USBHS_DEVEPTCFG_ALLOC;
+	if (!(p_usbhs->USBHS_DEVEPTISR[uc_ep] & USBHS_DEVEPTISR_CFGOK)) {
+		p_usbhs->USBHS_DEVEPT &= ~(USBHS_DEVEPT_EPEN0 << uc_ep);
+		p_usbhs->USBHS_DEVEPTCFG[uc_ep] = 0;
+		return ERR_NO_MEMORY;
+	}
+	p_usbhs->USBHS_DEVEPTIER[uc_ep] = USBHS_DEVEPTIER_RSTDTS;
+	p_dev->us_ep_size[uc_ep] = us_size;
+
+	return STATUS_OK;
+}
+
+/**
+ * \brief Stop an endpoint and free its memory. A transfer in progress is
+ * aborted, without callback.
+ */
+void usbhs_dev_ep_unconfigure(usbhs_dev_t *p_dev, uint8_t uc_ep)
+{
+	Usbhs *p_usbhs = p_dev->p_usbhs;
+
+	uc_ep &= 0x0F;
+	if (uc_ep == 0 || uc_ep >= USBHS_DEV_EP_COUNT) {
+		return;
+	}
+	usbhs_dev_ep_abort(p_dev, uc_ep);
+	p_usbhs->USBHS_DEVEPT &= ~(USBHS_DEVEPT_EPEN0 << uc_ep);
+	p_usbhs->USBHS_DEVEPTCFG[uc_ep] &= ~USBHS_DEVEPTCFG_ALLOC;
+	p_dev->us_ep_size[uc_ep] = 0;
+}
+
+/**
+ * \brief Start a transfer on an endpoint.
+ *
+ * \param p_dev Driver state.
+ * \param uc_ep Endpoint number, 1 to USBHS_DEV_EP_DMA_MAX.
+ * \param p_buf Data (IN), or room for it (OUT). Untouched by the CPU until
+ * the transfer ends.
+ * \param ul_len Data length (IN, 0 for a zero length packet), or buffer size
+ * (OUT, a multiple of the packet size), up to USBHS_DEV_XFER_MAX.
+ * \param b_zlp IN only: end with a zero length packet if \a ul_len is a
+ * multiple of the packet size.
+ *
+ * \retval STATUS_OK Started, USBHS_DEV_EP_DONE follows.
+ * \retval ERR_INVALID_ARG Bad endpoint or length.
+ * \retval ERR_BUSY A transfer is in progress on the endpoint.
+ */
+status_code_t usbhs_dev_ep_start(usbhs_dev_t *p_dev, uint8_t uc_ep,
+		void *p_buf, uint32_t ul_len, bool b_zlp)
+{
+	Usbhs *p_usbhs = p_dev->p_usbhs;
+	uint8_t uc_bit = 1u << uc_ep;
+	uint32_t ul_ctrl;
+	irqflags_t flags;
+	bool b_in;
+
+	if (uc_ep == 0 || uc_ep > USBHS_DEV_EP_DMA_MAX ||
+			!p_dev->us_ep_size[uc_ep] || ul_len > USBHS_DEV_XFER_MAX) {
+		return ERR_INVALID_ARG;
+	}
+	b_in = (p_usbhs->USBHS_DEVEPTCFG[uc_ep] & USBHS_DEVEPTCFG_EPDIR) != 0;
+	if (!b_in && ul_len == 0) {
+		return ERR_INVALID_ARG;
+	}
+
+	flags = cpu_irq_save();
+	if (p_dev->uc_busy & uc_bit) {
+		cpu_irq_restore(flags);
+		return ERR_BUSY;
+	}
+	p_dev->uc_busy |= uc_bit;
+	p_dev->ul_xfer_len[uc_ep] = ul_len;
+	if (b_in && (b_zlp || ul_len == 0) &&
+			(ul_len % p_dev->us_ep_size[uc_ep]) == 0) {
+		p_dev->uc_zlp |= uc_bit;
+	}
+
+	if (ul_len == 0) {
+		/* Nothing for the DMA, the empty packet goes at the next free
+		 * bank. */
+		p_usbhs->USBHS_DEVEPTIER[uc_ep] = USBHS_DEVEPTIER_TXINES;
+		p_usbhs->USBHS_DEVIER = USBHS_DEVIER_PEP_0 << uc_ep;
+	} else {
+		UsbhsDevdma *p_dma = &p_usbhs->USBHS_DEVDMA[uc_ep - 1];
+
+		/* IN: the last bank goes even if partly filled. OUT: a short
+		 * packet ends the transfer. */
+		ul_ctrl = USBHS_DEVDMACONTROL_BUFF_LENGTH(ul_len) |
+				USBHS_DEVDMACONTROL_END_BUFFIT |
+				USBHS_DEVDMACONTROL_CHANN_ENB;
+		ul_ctrl |= b_in ? USBHS_DEVDMACONTROL_END_B_EN :
+				(USBHS_DEVDMACONTROL_END_TR_EN |
+				USBHS_DEVDMACONTROL_END_TR_IT);
+		p_dma->USBHS_DEVDMAADDRESS = (uint32_t)p_buf;
+		p_usbhs->USBHS_DEVIER = USBHS_DEVIER_DMA_1 << (uc_ep - 1);
+		p_dma->USBHS_DEVDMACONTROL = ul_ctrl;
+	}
+	cpu_irq_restore(flags);
+
+	return STATUS_OK;
+}
+
+/**
+ * \brief Abort the transfer of an endpoint, without callback. The data not
+ * sent yet, or not read yet, is flushed from the banks.
+ *
+ * \return Bytes moved by the DMA before the abort.
+ */
+uint32_t usbhs_dev_ep_abort(usbhs_dev_t *p_dev, uint8_t uc_ep)
+{
+	Usbhs *p_usbhs = p_dev->p_usbhs;
+	uint8_t uc_bit = 1u << uc_ep;
+	uint32_t ul_count = 0;
+	irqflags_t flags;
+
+	if (uc_ep == 0 || uc_ep > USBHS_DEV_EP_DMA_MAX) {
+		return 0;
+	}
+	flags = cpu_irq_save();
+	if (p_dev->uc_busy & uc_bit) {
+		if (p_usbhs->USBHS_DEVEPTIMR[uc_ep] & USBHS_DEVEPTIMR_TXINE) {
+			/* Only the empty packet was left. */
+			ul_count = p_dev->ul_xfer_len[uc_ep];
+		} else {
+			ul_count = usbhs_dev_dma_stop(p_dev, uc_ep);
+		}
+		p_usbhs->USBHS_DEVEPTIDR[uc_ep] = USBHS_DEVEPTIDR_TXINEC;
+		p_usbhs->USBHS_DEVIDR = USBHS_DEVIDR_PEP_0 << uc_ep;
+		p_usbhs->USBHS_DEVEPT |= USBHS_DEVEPT_EPRST0 << uc_ep;
+		p_usbhs->USBHS_DEVEPT &= ~(USBHS_DEVEPT_EPRST0 << uc_ep);
+		p_dev->uc_busy &= ~uc_bit;
+		p_dev->uc_zlp &= ~uc_bit;
+	}
+	cpu_irq_restore(flags);
+
+	return ul_count;
+}
+
+/**
+ * \brief Tell whether a transfer is in progress on an endpoint.
+ */
+bool usbhs_dev_ep_is_busy(usbhs_dev_t *p_dev, uint8_t uc_ep)
+{
+	return (p_dev->uc_busy & (1u << uc_ep)) != 0;
+}
+
+/**
+ * \brief Stall an endpoint, or end the stall (SET_FEATURE and CLEAR_FEATURE
+ * ENDPOINT_HALT). Ending it also resets the data toggle.
+ */
+void usbhs_dev_ep_set_halt(usbhs_dev_t *p_dev, uint8_t uc_ep, bool b_halt)
+{
+	Usbhs *p_usbhs = p_dev->p_usbhs;
+
+	uc_ep &= 0x0F;
+	if (uc_ep >= USBHS_DEV_EP_COUNT) {
+		return;
+	}
+	if (b_halt) {
+		p_usbhs->USBHS_DEVEPTIER[uc_ep] = USBHS_DEVEPTIER_STALLRQS;
+	} else {
+		p_usbhs->USBHS_DEVEPTIDR[uc_ep] = USBHS_DEVEPTIDR_STALLRQC;
+		p_usbhs->USBHS_DEVEPTIER[uc_ep] = USBHS_DEVEPTIER_RSTDTS;
+	}
+}
+
+/**
+ * \brief Tell whether an endpoint is stalled.
+ */
+bool usbhs_dev_ep_is_halted(usbhs_dev_t *p_dev, uint8_t uc_ep)
+{
+	uc_ep &= 0x0F;
+	if (uc_ep >= USBHS_DEV_EP_COUNT) {
+		return false;
+	}
+	return (p_dev->p_usbhs->USBHS_DEVEPTIMR[uc_ep] &
+			USBHS_DEVEPTIMR_STALLRQ) != 0;
+}
+
+/**
+ * \brief End a transfer and report it.
+ */
+static void usbhs_dev_ep_done(usbhs_dev_t *p_dev, uint8_t uc_ep,
+		uint32_t ul_count)
+{
+	p_dev->uc_busy &= ~(1u << uc_ep);
+	p_dev->callback(p_dev, USBHS_DEV_EP_DONE, uc_ep, ul_count);
+}
+
+/**
+ * \brief Stall the request on the control endpoint.
+ */
+static void usbhs_dev_ctrl_stall(usbhs_dev_t *p_dev)
+{
+	Usbhs *p_usbhs = p_dev->p_usbhs;
+
+	p_usbhs->USBHS_DEVEPTIDR[0] = USBHS_DEVEPTIDR_TXINEC |
+			USBHS_DEVEPTIDR_RXOUTEC;
+	p_usbhs->USBHS_DEVEPTIER[0] = USBHS_DEVEPTIER_STALLRQS;
+	p_dev->ctrl_state = USBHS_CTRL_SETUP;
+}
+
+/**
+ * \brief Send the empty IN packet of a status stage.
+ */
+static void usbhs_dev_ctrl_status_in(usbhs_dev_t *p_dev)
+{
+	Usbhs *p_usbhs = p_dev->p_usbhs;
+
+	p_dev->ctrl_state = USBHS_CTRL_STATUS_IN;
+	p_usbhs->USBHS_DEVEPTICR[0] = USBHS_DEVEPTICR_TXINIC;
+	p_usbhs->USBHS_DEVEPTIER[0] = USBHS_DEVEPTIER_TXINES;
+}
+
+/**
+ * \brief Take a setup packet and start the request.
+ */
+static void usbhs_dev_ctrl_setup(usbhs_dev_t *p_dev, uint32_t ul_isr)
+{
+	Usbhs *p_usbhs = p_dev->p_usbhs;
+	volatile uint8_t *p_fifo = USBHS_EP_FIFO(0);
+	uint8_t *p_req = (uint8_t *)&p_dev->ctrl_req;
+	const usb_setup_t *p_setup = &p_dev->ctrl_req;
+	uint32_t i;
+	bool b_ok;
+
+	/* A setup packet ends whatever request was in progress. */
+	p_usbhs->USBHS_DEVEPTIDR[0] = USBHS_DEVEPTIDR_TXINEC |
+			USBHS_DEVEPTIDR_RXOUTEC;
+	p_dev->uc_address = 0;
+	if (USBHS_EP_BYCT(ul_isr) != sizeof(usb_setup_t)) {
+		p_usbhs->USBHS_DEVEPTICR[0] = USBHS_DEVEPTICR_RXSTPIC;
+		usbhs_dev_ctrl_stall(p_dev);
+		return;
+	}
+	for (i = 0; i < sizeof(usb_setup_t); i++) {
+		p_req[i] = p_fifo[i];
+	}
+	p_usbhs->USBHS_DEVEPTICR[0] = USBHS_DEVEPTICR_RXSTPIC;
+
+	p_dev->p_ctrl_buf = NULL;
+	p_dev->us_ctrl_len = 0;
+	p_dev->us_ctrl_done = 0;
+	if (p_setup->bmRequestType == (USB_REQ_TYPE_STANDARD |
+			USB_REQ_RECIP_DEVICE) &&
+			p_setup->bRequest == USB_REQ_SET_ADDRESS) {
+		/* The address applies once the status stage is over. */
+		p_dev->uc_address = p_setup->wValue & 0x7F;
+		p_usbhs->USBHS_DEVCTRL = (p_usbhs->USBHS_DEVCTRL &
+				~(USBHS_DEVCTRL_UADD_Msk | USBHS_DEVCTRL_ADDEN)) |
+				USBHS_DEVCTRL_UADD(p_dev->uc_address);
+		b_ok = true;
+	} else {
+		b_ok = p_dev->setup(p_dev, p_setup);
+	}
+	if (!b_ok) {
+		usbhs_dev_ctrl_stall(p_dev);
+		return;
+	}
+
+	if (p_setup->wLength == 0) {
+		usbhs_dev_ctrl_status_in(p_dev);
+	} else if (p_setup->bmRequestType & USB_REQ_DIR_IN) {
+		if (p_dev->us_ctrl_len > p_setup->wLength) {
+			p_dev->us_ctrl_len = p_setup->wLength;
+		}
+		/* The bank is free: the interrupt sends the first packet. */
+		p_dev->ctrl_state = USBHS_CTRL_DATA_IN;
+		p_usbhs->USBHS_DEVEPTIER[0] = USBHS_DEVEPTIER_TXINES;
+	} else if (p_dev->p_ctrl_buf && p_dev->us_ctrl_len >= p_setup->wLength) {
+		p_dev->us_ctrl_len = p_setup->wLength;
+		p_dev->ctrl_state = USBHS_CTRL_DATA_OUT;
+		p_usbhs->USBHS_DEVEPTIER[0] = USBHS_DEVEPTIER_RXOUTES;
+	} else {
+		usbhs_dev_ctrl_stall(p_dev);
+	}
+}
+
+/**
+ * \brief Control endpoint interrupt.
+ */
+static void usbhs_dev_ctrl_handler(usbhs_dev_t *p_dev)
+{
+	Usbhs *p_usbhs = p_dev->p_usbhs;
+	volatile uint8_t *p_fifo = USBHS_EP_FIFO(0);
+	/* Interrupt flags if enabled, status fields as they are. */
+	uint32_t ul_isr = p_usbhs->USBHS_DEVEPTISR[0] &
+			(p_usbhs->USBHS_DEVEPTIMR[0] | ~0xFFu);
+	uint32_t ul_n, i;
+
+	if (ul_isr & USBHS_DEVEPTISR_RXSTPI) {
+		usbhs_dev_ctrl_setup(p_dev, ul_isr);
+		return;
+	}
+
+	if (ul_isr & USBHS_DEVEPTISR_RXOUTI) {
+		if (p_dev->ctrl_state == USBHS_CTRL_DATA_OUT) {
+			ul_n = USBHS_EP_BYCT(ul_isr);
+			if (ul_n > (uint32_t)(p_dev->us_ctrl_len -
+					p_dev->us_ctrl_done)) {
+				ul_n = p_dev->us_ctrl_len - p_dev->us_ctrl_done;
+			}
+			for (i = 0; i < ul_n; i++) {
+				p_dev->p_ctrl_buf[p_dev->us_ctrl_done + i] = p_fifo[i];
+			}
+			p_dev->us_ctrl_done += ul_n;
+			p_usbhs->USBHS_DEVEPTICR[0] = USBHS_DEVEPTICR_RXOUTIC;
+			if (ul_n < USBHS_DEV_EP0_SIZE ||
+					p_dev->us_ctrl_done >= p_dev->us_ctrl_len) {
+				p_usbhs->USBHS_DEVEPTIDR[0] = USBHS_DEVEPTIDR_RXOUTEC;
+				p_dev->callback(p_dev, USBHS_DEV_CTRL_OUT, 0,
+						p_dev->us_ctrl_done);
+				usbhs_dev_ctrl_status_in(p_dev);
+			}
+		} else {
+			/* Status stage of an IN request. */
+			p_usbhs->USBHS_DEVEPTICR[0] = USBHS_DEVEPTICR_RXOUTIC;
+			p_usbhs->USBHS_DEVEPTIDR[0] = USBHS_DEVEPTIDR_RXOUTEC;
+			p_dev->ctrl_state = USBHS_CTRL_SETUP;
+		}
+	}
+
+	if (ul_isr & USBHS_DEVEPTISR_TXINI) {
+		if (p_dev->ctrl_state == USBHS_CTRL_DATA_IN) {
+			ul_n = p_dev->us_ctrl_len - p_dev->us_ctrl_done;
+			if (ul_n > USBHS_DEV_EP0_SIZE) {
+				ul_n = USBHS_DEV_EP0_SIZE;
+			}
+			for (i = 0; i < ul_n; i++) {
+				p_fifo[i] = p_dev->p_ctrl_buf[p_dev->us_ctrl_done + i];
+			}
+			p_dev->us_ctrl_done += ul_n;
+			__DMB();
+			p_usbhs->USBHS_DEVEPTICR[0] = USBHS_DEVEPTICR_TXINIC;
+			/* A short packet ends the stage, or an empty one when the
+			 * answer is shorter than asked and a multiple of the
+			 * packet size. */
+			if (ul_n < USBHS_DEV_EP0_SIZE ||
+					p_dev->us_ctrl_done >= p_dev->ctrl_req.wLength) {
+				p_usbhs->USBHS_DEVEPTIDR[0] = USBHS_DEVEPTIDR_TXINEC;
+				p_dev->ctrl_state = USBHS_CTRL_STATUS_OUT;
+				p_usbhs->USBHS_DEVEPTIER[0] = USBHS_DEVEPTIER_RXOUTES;
+			}
+		} else {
+			/* End of the status stage of an OUT request. */
+			p_usbhs->USBHS_DEVEPTIDR[0] = USBHS_DEVEPTIDR_TXINEC;
+			if (p_dev->uc_address) {
+				p_usbhs->USBHS_DEVCTRL |= USBHS_DEVCTRL_ADDEN;
+				p_dev->uc_address = 0;
+			}
+			p_dev->ctrl_state = USBHS_CTRL_SETUP;
+		}
+	}
+}
+
+/**
+ * \brief Interrupt of endpoints 1 and up: the zero length packet ending an
+ * IN transfer.
+ */
+static void usbhs_dev_ep_handler(usbhs_dev_t *p_dev, uint8_t uc_ep)
+{
+	Usbhs *p_usbhs = p_dev->p_usbhs;
+
+	if ((p_usbhs->USBHS_DEVEPTISR[uc_ep] & USBHS_DEVEPTISR_TXINI) &&
+			(p_usbhs->USBHS_DEVEPTIMR[uc_ep] & USBHS_DEVEPTIMR_TXINE)) {
+		p_usbhs->USBHS_DEVEPTIDR[uc_ep] = USBHS_DEVEPTIDR_TXINEC;
+		p_usbhs->USBHS_DEVIDR = USBHS_DEVIDR_PEP_0 << uc_ep;
+		p_usbhs->USBHS_DEVEPTICR[uc_ep] = USBHS_DEVEPTICR_TXINIC;
+		p_usbhs->USBHS_DEVEPTIDR[uc_ep] = USBHS_DEVEPTIDR_FIFOCONC;
+		p_dev->uc_zlp &= ~(1u << uc_ep);
+		usbhs_dev_ep_done(p_dev, uc_ep, p_dev->ul_xfer_len[uc_ep]);
+	}
+}
+
+/**
+ * \brief DMA channel interrupt: end of a transfer.
+ */
+static void usbhs_dev_dma_handler(usbhs_dev_t *p_dev, uint8_t uc_ep)
+{
+	Usbhs *p_usbhs = p_dev->p_usbhs;
+	UsbhsDevdma *p_dma = &p_usbhs->USBHS_DEVDMA[uc_ep - 1];
+	uint32_t ul_status = p_dma->USBHS_DEVDMASTATUS;
+	uint32_t ul_count;
+
+	if (ul_status & USBHS_DEVDMASTATUS_CHANN_ENB) {
+		return;
+	}
+	p_usbhs->USBHS_DEVIDR = USBHS_DEVIDR_DMA_1 << (uc_ep - 1);
+	ul_count = p_dev->ul_xfer_len[uc_ep] -
+			((ul_status & USBHS_DEVDMASTATUS_BUFF_COUNT_Msk) >>
+			USBHS_DEVDMASTATUS_BUFF_COUNT_Pos);
+
+	if (p_dev->uc_zlp & (1u << uc_ep)) {
+		/* The empty packet goes at the next free bank. */
+		p_dev->ul_xfer_len[uc_ep] = ul_count;
+		p_usbhs->USBHS_DEVEPTIER[uc_ep] = USBHS_DEVEPTIER_TXINES;
+		p_usbhs->USBHS_DEVIER = USBHS_DEVIER_PEP_0 << uc_ep;
+		return;
+	}
+	usbhs_dev_ep_done(p_dev, uc_ep, ul_count);
+}
+
+/**
+ * \brief USBHS interrupt handler.
+ */
+void USBHS_Handler(void)
+{
+	usbhs_dev_t *p_dev = gs_p_usbhs_dev;
+	Usbhs *p_usbhs;
+	uint32_t ul_isr;
+	uint8_t uc_ep;
+
+	if (p_dev == NULL) {
+		return;
+	}
+	p_usbhs = p_dev->p_usbhs;
+	ul_isr = p_usbhs->USBHS_DEVISR & p_usbhs->USBHS_DEVIMR;
+
+	if (ul_isr & USBHS_DEVISR_EORST) {
+		p_usbhs->USBHS_DEVICR = USBHS_DEVICR_EORSTC;
+		usbhs_dev_bus_reset(p_dev);
+		p_dev->callback(p_dev, USBHS_DEV_RESET, 0, p_dev->b_high_speed);
+		return;
+	}
+	if (ul_isr & USBHS_DEVISR_SUSP) {
+		p_usbhs->USBHS_DEVICR = USBHS_DEVICR_SUSPC | USBHS_DEVICR_WAKEUPC;
+		p_usbhs->USBHS_DEVIDR = USBHS_DEVIDR_SUSPEC;
+		p_usbhs->USBHS_DEVIER = USBHS_DEVIER_WAKEUPES;
+		p_dev->callback(p_dev, USBHS_DEV_SUSPEND, 0, 0);
+	}
+	if (ul_isr & USBHS_DEVISR_WAKEUP) {
+		p_usbhs->USBHS_DEVICR = USBHS_DEVICR_WAKEUPC | USBHS_DEVICR_SUSPC;
+		p_usbhs->USBHS_DEVIDR = USBHS_DEVIDR_WAKEUPEC;
+		p_usbhs->USBHS_DEVIER = USBHS_DEVIER_SUSPES;
+		p_dev->callback(p_dev, USBHS_DEV_RESUME, 0, 0);
+	}
+
+	if (ul_isr & USBHS_DEVISR_PEP_0) {
+		usbhs_dev_ctrl_handler(p_dev);
+	}
+	for (uc_ep = 1; uc_ep < USBHS_DEV_EP_COUNT; uc_ep++) {
+		if (ul_isr & (USBHS_DEVISR_PEP_0 << uc_ep)) {
+			usbhs_dev_ep_handler(p_dev, uc_ep);
+		}
+	}
+	for (uc_ep = 1; uc_ep <= USBHS_DEV_EP_DMA_MAX; uc_ep++) {
+		if (ul_isr & (USBHS_DEVISR_DMA_1 << (uc_ep - 1))) {
+			usbhs_dev_dma_handler(p_dev, uc_ep);
+		}
+	}
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
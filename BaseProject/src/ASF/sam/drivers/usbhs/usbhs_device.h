@@ -0,0 +1,211 @@
+/**
+ * \file
+ *
+ * \brief SAM USB High-Speed interface (USBHS) device driver.
+ *
+ */
+
+#ifndef USBHS_DEVICE_H_INCLUDED
+#define USBHS_DEVICE_H_INCLUDED
+
+#include "compiler.h"
+#include "status_codes.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \defgroup sam_drivers_usbhs_group USB High-Speed interface (USBHS), device
+ *
+ * Device mode of the USBHS: attachment, bus events, the control endpoint
+ * and DMA transfers on the other endpoints.
+ *
+ * The control endpoint protocol runs in the driver, which handles
+ * SET_ADDRESS itself and passes every other setup request to the setup
+ * callback. The callback answers with usbhs_dev_ctrl_data() for a data
+ * stage, or just returns true for a status only request, or false to stall
+ * it.
+ *
+ * Endpoints 1 to 7 move their data through their DMA channel, straight
+ * between memory and the endpoint banks. They are meant to be double or
+ * triple banked with automatic bank switching, so that the DMA fills (or
+ * drains) a bank while the other is on the bus: a transfer of several
+ * packets then runs without the CPU. usbhs_dev_ep_start() starts a
+ * transfer and the callback gets USBHS_DEV_EP_DONE when it ends:
+ * - IN: once the data is in the banks, the last bank being sent even if it
+ *   is partly filled. A zero length packet can follow a transfer that ends
+ *   on a packet boundary, to end it on the host side.
+ * - OUT: once the buffer is full or a short packet was received.
+ *
+ * The buffers are read and written by the DMA: their cache maintenance is
+ * the caller's (see \ref utils_dma_buf_group).
+ *
+ * USBHS_Handler() is provided by the driver. The callbacks run from it.
+ *
+ * @{
+ */
+
+/** Endpoints, the control endpoint included. */
+#define USBHS_DEV_EP_COUNT        10
+
+/** Endpoints with a DMA channel: 1 to USBHS_DEV_EP_DMA_MAX. */
+#define USBHS_DEV_EP_DMA_MAX      7
+
+/** Control endpoint size. */
+#define USBHS_DEV_EP0_SIZE        64
+
+/** Longest transfer of usbhs_dev_ep_start(). */
+#define USBHS_DEV_XFER_MAX        32768
+
+/** Endpoint address direction bit. */
+#define USB_EP_DIR_IN             0x80
+
+/** bmRequestType fields. */
+#define USB_REQ_DIR_IN            0x80
+#define USB_REQ_TYPE_Msk          0x60
+#define USB_REQ_TYPE_STANDARD     0x00
+#define USB_REQ_TYPE_CLASS        0x20
+#define USB_REQ_RECIP_Msk         0x1F
+#define USB_REQ_RECIP_DEVICE      0x00
+#define USB_REQ_RECIP_INTERFACE   0x01
+#define USB_REQ_RECIP_ENDPOINT    0x02
+
+/** Standard requests. */
+#define USB_REQ_GET_STATUS        0
+#define USB_REQ_CLEAR_FEATURE     1
+#define USB_REQ_SET_FEATURE       3
+#define USB_REQ_SET_ADDRESS       5
+#define USB_REQ_GET_DESCRIPTOR    6
+#define USB_REQ_GET_CONFIGURATION 8
+#define USB_REQ_SET_CONFIGURATION 9
+#define USB_REQ_GET_INTERFACE     10
+#define USB_REQ_SET_INTERFACE     11
+
+/** Endpoint halt feature selector. */
+#define USB_EP_FEATURE_HALT       0
+
+/** Setup request. */
+typedef struct usb_setup {
+	uint8_t bmRequestType;
+	uint8_t bRequest;
+	uint16_t wValue;
+	uint16_t wIndex;
+	uint16_t wLength;
+} usb_setup_t;
+
+/** Endpoint types. */
+typedef enum usbhs_ep_type {
+	USBHS_EP_ISO = 1,
+	USBHS_EP_BULK = 2,
+	USBHS_EP_INTERRUPT = 3,
+} usbhs_ep_type_t;
+
+/** Events passed to the callback. */
+typedef enum usbhs_dev_event {
+	/**
+	 * End of a bus reset: the device has no address and only the control
+	 * endpoint is left. The argument is true at high speed.
+	 */
+	USBHS_DEV_RESET,
+	/** The bus went idle. */
+	USBHS_DEV_SUSPEND,
+	/** Bus activity after a suspend. */
+	USBHS_DEV_RESUME,
+	/**
+	 * The data stage of a control OUT request ended, the argument is the
+	 * byte count received in the usbhs_dev_ctrl_data() buffer. The status
+	 * stage follows.
+	 */
+	USBHS_DEV_CTRL_OUT,
+	/** A transfer ended on an endpoint, the argument is its byte count. */
+	USBHS_DEV_EP_DONE,
+} usbhs_dev_event_t;
+
+struct usbhs_dev;
+
+/**
+ * Setup callback, with every request but SET_ADDRESS.
+ *
+ * \return true to accept the request, false to stall it.
+ */
+typedef bool (*usbhs_dev_setup_t)(struct usbhs_dev *p_dev,
+		const usb_setup_t *p_req);
+
+/** Event callback, \a uc_ep is the endpoint number of USBHS_DEV_EP_DONE. */
+typedef void (*usbhs_dev_callback_t)(struct usbhs_dev *p_dev,
+		usbhs_dev_event_t event, uint8_t uc_ep, uint32_t ul_arg);
+
+/** Device configuration. */
+typedef struct usbhs_dev_config {
+	/** Go high speed if the host can, else stay full speed. */
+	bool b_high_speed;
+	usbhs_dev_setup_t setup;
+	usbhs_dev_callback_t callback;
+	void *p_ctx;
+} usbhs_dev_config_t;
+
+/** Control endpoint stages. */
+typedef enum usbhs_ctrl_state {
+	USBHS_CTRL_SETUP,
+	USBHS_CTRL_DATA_IN,
+	USBHS_CTRL_DATA_OUT,
+	USBHS_CTRL_STATUS_IN,
+	USBHS_CTRL_STATUS_OUT,
+} usbhs_ctrl_state_t;
+
+/** Driver state. */
+typedef struct usbhs_dev {
+	Usbhs *p_usbhs;
+	usbhs_dev_setup_t setup;
+	usbhs_dev_callback_t callback;
+	void *p_ctx;
+	bool b_high_speed;
+	/** Control endpoint. */
+	usbhs_ctrl_state_t ctrl_state;
+	usb_setup_t ctrl_req;
+	uint8_t *p_ctrl_buf;
+	uint16_t us_ctrl_len;
+	uint16_t us_ctrl_done;
+	/** Address to enable once SET_ADDRESS completes, 0 if none. */
+	uint8_t uc_address;
+	/** Packet sizes, 0 for an endpoint not configured. */
+	uint16_t us_ep_size[USBHS_DEV_EP_COUNT];
+	/** Transfer lengths, and endpoint bit masks of the transfers in
+	 * progress and of those to end with a zero length packet. */
+	uint32_t ul_xfer_len[USBHS_DEV_EP_DMA_MAX + 1];
+	uint8_t uc_busy;
+	uint8_t uc_zlp;
+} usbhs_dev_t;
+
+status_code_t usbhs_dev_init(usbhs_dev_t *p_dev, Usbhs *p_usbhs,
+		const usbhs_dev_config_t *p_cfg);
+void usbhs_dev_attach(usbhs_dev_t *p_dev);
+void usbhs_dev_detach(usbhs_dev_t *p_dev);
+bool usbhs_dev_is_high_speed(usbhs_dev_t *p_dev);
+void usbhs_dev_ctrl_data(usbhs_dev_t *p_dev, void *p_buf, uint16_t us_len);
+status_code_t usbhs_dev_ep_configure(usbhs_dev_t *p_dev, uint8_t uc_ep_addr,
+		usbhs_ep_type_t type, uint16_t us_size, uint8_t uc_banks);
+void usbhs_dev_ep_unconfigure(usbhs_dev_t *p_dev, uint8_t uc_ep);
+status_code_t usbhs_dev_ep_start(usbhs_dev_t *p_dev, uint8_t uc_ep,
+		void *p_buf, uint32_t ul_len, bool b_zlp);
+uint32_t usbhs_dev_ep_abort(usbhs_dev_t *p_dev, uint8_t uc_ep);
+bool usbhs_dev_ep_is_busy(usbhs_dev_t *p_dev, uint8_t uc_ep);
+void usbhs_dev_ep_set_halt(usbhs_dev_t *p_dev, uint8_t uc_ep, bool b_halt);
+bool usbhs_dev_ep_is_halted(usbhs_dev_t *p_dev, uint8_t uc_ep);
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+#endif /* USBHS_DEVICE_H_INCLUDED */
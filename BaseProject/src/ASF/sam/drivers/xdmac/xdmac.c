@@ -0,0 +1,167 @@
+/**
+ * \file
+ *
+ * \brief SAM Extensible DMA Controller (XDMAC) driver.
+ *
+ */
+
+#include "xdmac.h"
+#include "conf_xdmac.h"
+#include "interrupt.h"
+#include "pmc.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \addtogroup sam_drivers_xdmac_group
+ *
+ * @{
+ */
+
+/** Channel owner callbacks, NULL for a free channel. */
+static struct {
+	xdmac_callback_t callback;
+	void *p_ctx;
+} gs_xdmac_channels[XDMACCHID_NUMBER];
+
+/** Bit mask of the allocated channels. */
+static uint32_t gs_ul_xdmac_allocated;
+
+/**
+ * \brief Load the registers of a channel for its next transfer and clear its
+ * pending interrupt status. The descriptor control register is left alone.
+ *
+ * \param p_xdmac Pointer to the XDMAC instance.
+ * \param ul_ch Channel number.
+ * \param p_cfg Channel configuration.
+ */
+void xdmac_configure_transfer(Xdmac *p_xdmac, uint32_t ul_ch,
+		const xdmac_channel_config_t *p_cfg)
+{
+	XdmacChid *p_chid = &p_xdmac->XDMAC_CHID[ul_ch];
+
+	(void)p_chid->XDMAC_CIS;
+	p_chid->XDMAC_CSA = p_cfg->mbr_sa;
+	p_chid->XDMAC_CDA = p_cfg->mbr_da;
+	p_chid->XDMAC_CUBC = XDMAC_CUBC_UBLEN(p_cfg->mbr_ubc);
+	p_chid->XDMAC_CC = p_cfg->mbr_cfg;
+	p_chid->XDMAC_CBC = p_cfg->mbr_bc;
+	p_chid->XDMAC_CDS_MSP = p_cfg->mbr_ds;
+	p_chid->XDMAC_CSUS = p_cfg->mbr_sus;
+	p_chid->XDMAC_CDUS = p_cfg->mbr_dus;
+}
+
+/**
+ * \brief Reserve a free channel.
+ *
+ * The first call enables the XDMAC clock and interrupt. The channel is
+ * returned disabled, with no interrupt source enabled and no descriptor.
+ *
+ * \param callback Run from XDMAC_Handler() when the channel interrupts.
+ * \param p_ctx Passed back to \a callback.
+ *
+ * \return Channel number, or -1 if all channels are in use.
+ */
+int32_t xdmac_channel_alloc(xdmac_callback_t callback, void *p_ctx)
+{
+	irqflags_t flags;
+	uint32_t ul_ch;
+
+	flags = cpu_irq_save();
+	for (ul_ch = 0; ul_ch < XDMACCHID_NUMBER; ul_ch++) {
+		if (!(gs_ul_xdmac_allocated & (1u << ul_ch))) {
+			break;
+		}
+	}
+	if (ul_ch == XDMACCHID_NUMBER) {
+		cpu_irq_restore(flags);
+		return -1;
+	}
+	if (!gs_ul_xdmac_allocated) {
+		pmc_enable_periph_clk(ID_XDMAC);
+		NVIC_ClearPendingIRQ(XDMAC_IRQn);
+		NVIC_SetPriority(XDMAC_IRQn, CONF_XDMAC_IRQ_PRIORITY);
+		NVIC_EnableIRQ(XDMAC_IRQn);
+	}
+	gs_ul_xdmac_allocated |= 1u << ul_ch;
+	gs_xdmac_channels[ul_ch].callback = callback;
+	gs_xdmac_channels[ul_ch].p_ctx = p_ctx;
+	cpu_irq_restore(flags);
+
+	xdmac_channel_abort(XDMAC, ul_ch);
+	XDMAC->XDMAC_CHID[ul_ch].XDMAC_CID = 0xFFFFFFFF;
+	XDMAC->XDMAC_CHID[ul_ch].XDMAC_CNDC = 0;
+	(void)XDMAC->XDMAC_CHID[ul_ch].XDMAC_CIS;
+	xdmac_enable_interrupt(XDMAC, ul_ch);
+
+	return (int32_t)ul_ch;
+}
+
+/**
+ * \brief Stop a channel and give it back.
+ *
+ * \param ul_ch Channel number returned by xdmac_channel_alloc().
+ */
+void xdmac_channel_free(uint32_t ul_ch)
+{
+	irqflags_t flags;
+
+	xdmac_disable_interrupt(XDMAC, ul_ch);
+	xdmac_channel_abort(XDMAC, ul_ch);
+
+	flags = cpu_irq_save();
+	gs_xdmac_channels[ul_ch].callback = NULL;
+	gs_xdmac_channels[ul_ch].p_ctx = NULL;
+	gs_ul_xdmac_allocated &= ~(1u << ul_ch);
+	cpu_irq_restore(flags);
+}
+
+/**
+ * \brief Disable a channel and wait until it has stopped.
+ *
+ * \param p_xdmac Pointer to the XDMAC instance.
+ * \param ul_ch Channel number.
+ */
+void xdmac_channel_abort(Xdmac *p_xdmac, uint32_t ul_ch)
+{
+	xdmac_channel_disable(p_xdmac, ul_ch);
+	while (xdmac_channel_is_enabled(p_xdmac, ul_ch)) {
+	}
+}
+
+/**
+ * \brief XDMAC interrupt handler, dispatches to the channel callbacks.
+ */
+void XDMAC_Handler(void)
+{
+	uint32_t ul_pending = XDMAC->XDMAC_GIS & XDMAC->XDMAC_GIM;
+
+	while (ul_pending) {
+		uint32_t ul_ch = __CLZ(__RBIT(ul_pending));
+		uint32_t ul_status;
+
+		ul_pending &= ~(1u << ul_ch);
+		ul_status = XDMAC->XDMAC_CHID[ul_ch].XDMAC_CIS &
+				XDMAC->XDMAC_CHID[ul_ch].XDMAC_CIM;
+		if (gs_xdmac_channels[ul_ch].callback) {
+			gs_xdmac_channels[ul_ch].callback(ul_ch, ul_status,
+					gs_xdmac_channels[ul_ch].p_ctx);
+		}
+	}
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
@@ -0,0 +1,239 @@
+/**
+ * \file
+ *
+ * \brief SAM Extensible DMA Controller (XDMAC) driver.
+ *
+ */
+
+#ifndef XDMAC_H_INCLUDED
+#define XDMAC_H_INCLUDED
+
+#include "compiler.h"
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+/**
+ * \defgroup sam_drivers_xdmac_group Extensible DMA Controller (XDMAC)
+ *
+ * Register level access to the XDMAC channels, plus a small channel
+ * allocator so that several drivers can share the controller and its single
+ * interrupt line. A channel is reserved with xdmac_channel_alloc(), which
+ * also registers the callback that XDMAC_Handler() runs for the channel.
+ *
+ * @{
+ */
+
+/** XDMAC hardware interface numbers (XDMAC_CC.PERID) used in this project. */
+#define XDMAC_PERID_SPI0_TX       1
+#define XDMAC_PERID_SPI0_RX       2
+#define XDMAC_PERID_QSPI_TX       5
+#define XDMAC_PERID_QSPI_RX       6
+#define XDMAC_PERID_USART0_TX     7
+#define XDMAC_PERID_USART0_RX     8
+#define XDMAC_PERID_USART1_TX     9
+#define XDMAC_PERID_USART1_RX     10
+#define XDMAC_PERID_USART2_TX     11
+#define XDMAC_PERID_USART2_RX     12
+#define XDMAC_PERID_PIOA          34
+#define XDMAC_PERID_AFEC0         35
+#define XDMAC_PERID_AFEC1         36
+
+/** Longest microblock, in data units. */
+#define XDMAC_UBLEN_MAX           0xFFFFFFu
+
+/** Microblock control word of a linked list descriptor (mbr_ubc). */
+#define XDMAC_UBC_UBLEN_Pos       0
+#define XDMAC_UBC_UBLEN_Msk       (0xffffffu << XDMAC_UBC_UBLEN_Pos)
+#define XDMAC_UBC_UBLEN(value)    ((XDMAC_UBC_UBLEN_Msk & ((value) << XDMAC_UBC_UBLEN_Pos)))
+#define XDMAC_UBC_NDE             (0x1u << 24)
+#define   XDMAC_UBC_NDE_FETCH_DIS (0x0u << 24)
+#define   XDMAC_UBC_NDE_FETCH_EN  (0x1u << 24)
+#define XDMAC_UBC_NSEN            (0x1u << 25)
+#define   XDMAC_UBC_NSEN_UNCHANGED (0x0u << 25)
+#define   XDMAC_UBC_NSEN_UPDATED  (0x1u << 25)
+#define XDMAC_UBC_NDEN            (0x1u << 26)
+#define   XDMAC_UBC_NDEN_UNCHANGED (0x0u << 26)
+#define   XDMAC_UBC_NDEN_UPDATED  (0x1u << 26)
+#define XDMAC_UBC_NVIEW_Pos       27
+#define XDMAC_UBC_NVIEW_Msk       (0x3u << XDMAC_UBC_NVIEW_Pos)
+#define   XDMAC_UBC_NVIEW_NDV0    (0x0u << XDMAC_UBC_NVIEW_Pos)
+#define   XDMAC_UBC_NVIEW_NDV1    (0x1u << XDMAC_UBC_NVIEW_Pos)
+#define   XDMAC_UBC_NVIEW_NDV2    (0x2u << XDMAC_UBC_NVIEW_Pos)
+#define   XDMAC_UBC_NVIEW_NDV3    (0x3u << XDMAC_UBC_NVIEW_Pos)
+
+/** Channel configuration, one field per channel register. */
+typedef struct {
+	/** Microblock control (XDMAC_CUBC). */
+	uint32_t mbr_ubc;
+	/** Source address (XDMAC_CSA). */
+	uint32_t mbr_sa;
+	/** Destination address (XDMAC_CDA). */
+	uint32_t mbr_da;
+	/** Configuration (XDMAC_CC). */
+	uint32_t mbr_cfg;
+	/** Block control (XDMAC_CBC). */
+	uint32_t mbr_bc;
+	/** Data stride (XDMAC_CDS_MSP). */
+	uint32_t mbr_ds;
+	/** Source microblock stride (XDMAC_CSUS). */
+	uint32_t mbr_sus;
+	/** Destination microblock stride (XDMAC_CDUS). */
+	uint32_t mbr_dus;
+} xdmac_channel_config_t;
+
+/** Linked list descriptor, view 0: transfer address only. */
+typedef struct {
+	uint32_t mbr_nda;
+	uint32_t mbr_ubc;
+	uint32_t mbr_ta;
+} lld_view0;
+
+/** Linked list descriptor, view 1: source and destination addresses. */
+typedef struct {
+	uint32_t mbr_nda;
+	uint32_t mbr_ubc;
+	uint32_t mbr_sa;
+	uint32_t mbr_da;
+} lld_view1;
+
+/**
+ * Channel interrupt callback, run from XDMAC_Handler() with the channel
+ * number and the XDMAC_CIS bits that were pending.
+ */
+typedef void (*xdmac_callback_t)(uint32_t ul_ch, uint32_t ul_status,
+		void *p_ctx);
+
+void xdmac_configure_transfer(Xdmac *p_xdmac, uint32_t ul_ch,
+		const xdmac_channel_config_t *p_cfg);
+int32_t xdmac_channel_alloc(xdmac_callback_t callback, void *p_ctx);
+void xdmac_channel_free(uint32_t ul_ch);
+void xdmac_channel_abort(Xdmac *p_xdmac, uint32_t ul_ch);
+
+/**
+ * \brief Enable a channel, starting the transfer it is configured for.
+ */
+static inline void xdmac_channel_enable(Xdmac *p_xdmac, uint32_t ul_ch)
+{
+	/* Make the configuration and the buffers visible to the DMA. */
+	__DSB();
+	p_xdmac->XDMAC_GE = XDMAC_GE_EN0 << ul_ch;
+}
+
+/**
+ * \brief Disable a channel. The channel may still be finishing its current
+ * chunk, see xdmac_channel_abort().
+ */
+static inline void xdmac_channel_disable(Xdmac *p_xdmac, uint32_t ul_ch)
+{
+	p_xdmac->XDMAC_GD = XDMAC_GD_DI0 << ul_ch;
+}
+
+/**
+ * \brief Tell whether a channel is enabled.
+ */
+static inline bool xdmac_channel_is_enabled(Xdmac *p_xdmac, uint32_t ul_ch)
+{
+	return (p_xdmac->XDMAC_GS & (XDMAC_GS_ST0 << ul_ch)) != 0;
+}
+
+/**
+ * \brief Enable channel interrupt sources (XDMAC_CIE_* bits).
+ */
+static inline void xdmac_channel_enable_interrupt(Xdmac *p_xdmac,
+		uint32_t ul_ch, uint32_t ul_mask)
+{
+	p_xdmac->XDMAC_CHID[ul_ch].XDMAC_CIE = ul_mask;
+}
+
+/**
+ * \brief Disable channel interrupt sources (XDMAC_CID_* bits).
+ */
+static inline void xdmac_channel_disable_interrupt(Xdmac *p_xdmac,
+		uint32_t ul_ch, uint32_t ul_mask)
+{
+	p_xdmac->XDMAC_CHID[ul_ch].XDMAC_CID = ul_mask;
+}
+
+/**
+ * \brief Read and clear the channel interrupt status.
+ */
+static inline uint32_t xdmac_channel_get_interrupt_status(Xdmac *p_xdmac,
+		uint32_t ul_ch)
+{
+	return p_xdmac->XDMAC_CHID[ul_ch].XDMAC_CIS;
+}
+
+/**
+ * \brief Route the channel interrupt to the XDMAC interrupt line.
+ */
+static inline void xdmac_enable_interrupt(Xdmac *p_xdmac, uint32_t ul_ch)
+{
+	p_xdmac->XDMAC_GIE = XDMAC_GIE_IE0 << ul_ch;
+}
+
+/**
+ * \brief Stop routing the channel interrupt to the XDMAC interrupt line.
+ */
+static inline void xdmac_disable_interrupt(Xdmac *p_xdmac, uint32_t ul_ch)
+{
+	p_xdmac->XDMAC_GID = XDMAC_GID_ID0 << ul_ch;
+}
+
+/**
+ * \brief Set the first descriptor of a linked list transfer.
+ *
+ * \param ul_desc Address of the descriptor, 4-byte aligned.
+ * \param ul_ndaif Interface the descriptor is fetched through (0 or 1).
+ */
+static inline void xdmac_channel_set_descriptor_addr(Xdmac *p_xdmac,
+		uint32_t ul_ch, uint32_t ul_desc, uint32_t ul_ndaif)
+{
+	p_xdmac->XDMAC_CHID[ul_ch].XDMAC_CNDA = (ul_desc & 0xFFFFFFFC) |
+			(ul_ndaif ? XDMAC_CNDA_NDAIF : 0);
+}
+
+/**
+ * \brief Set the descriptor control (XDMAC_CNDC_* bits) of a linked list
+ * transfer, 0 for a single microblock.
+ */
+static inline void xdmac_channel_set_descriptor_control(Xdmac *p_xdmac,
+		uint32_t ul_ch, uint32_t ul_cndc)
+{
+	p_xdmac->XDMAC_CHID[ul_ch].XDMAC_CNDC = ul_cndc;
+}
+
+/**
+ * \brief Current destination address of a channel.
+ */
+static inline uint32_t xdmac_channel_get_destination_addr(Xdmac *p_xdmac,
+		uint32_t ul_ch)
+{
+	return p_xdmac->XDMAC_CHID[ul_ch].XDMAC_CDA;
+}
+
+/**
+ * \brief Data units left in the current microblock.
+ */
+static inline uint32_t xdmac_channel_get_residual(Xdmac *p_xdmac,
+		uint32_t ul_ch)
+{
+	return p_xdmac->XDMAC_CHID[ul_ch].XDMAC_CUBC & XDMAC_CUBC_UBLEN_Msk;
+}
+
+/** @} */
+
+/// @cond 0
+/**INDENT-OFF**/
+#ifdef __cplusplus
+}
+#endif
+/**INDENT-ON**/
+/// @endcond
+
+#endif /* XDMAC_H_INCLUDED */
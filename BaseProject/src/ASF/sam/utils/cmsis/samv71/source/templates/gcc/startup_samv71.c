@@ -43,6 +43,7 @@
  */
 
 #include "samv71.h"
+#include "boot.h"
 
 #if __FPU_USED /* CMSIS defined value to indicate usage of FPU */
 #include "fpu.h"
@@ -295,6 +296,58 @@ const DeviceVectors exception_table = {
         .pfnRSWDT_Handler  = (void*) RSWDT_Handler   /* 63 Reinforced Secure Watchdog Timer */
 };
 
+#if CONF_BOOT_FAST
+/**
+ * \brief Copy words from p_src to [p_dest, p_end), four per LDM/STM pair.
+ */
+static inline void boot_copy_words(uint32_t *p_dest, uint32_t *p_end,
+		uint32_t *p_src)
+{
+	uint32_t ul_blocks = (uint32_t)(p_end - p_dest) / 4;
+
+	if (ul_blocks) {
+		__asm__ volatile (
+			"1:\n\t"
+			"ldmia	%0!, {r2-r5}\n\t"
+			"stmia	%1!, {r2-r5}\n\t"
+			"subs	%2, %2, #1\n\t"
+			"bne	1b"
+			: "+r" (p_src), "+r" (p_dest), "+r" (ul_blocks)
+			:
+			: "r2", "r3", "r4", "r5", "cc", "memory");
+	}
+	while (p_dest < p_end) {
+		*p_dest++ = *p_src++;
+	}
+}
+
+/**
+ * \brief Clear [p_dest, p_end), four words per STM.
+ */
+static inline void boot_zero_words(uint32_t *p_dest, uint32_t *p_end)
+{
+	uint32_t ul_blocks = (uint32_t)(p_end - p_dest) / 4;
+
+	if (ul_blocks) {
+		__asm__ volatile (
+			"movs	r2, #0\n\t"
+			"movs	r3, #0\n\t"
+			"movs	r4, #0\n\t"
+			"movs	r5, #0\n"
+			"1:\n\t"
+			"stmia	%0!, {r2-r5}\n\t"
+			"subs	%1, %1, #1\n\t"
+			"bne	1b"
+			: "+r" (p_dest), "+r" (ul_blocks)
+			:
+			: "r2", "r3", "r4", "r5", "cc", "memory");
+	}
+	while (p_dest < p_end) {
+		*p_dest++ = 0;
+	}
+}
+#endif
+
 /**
  * \brief This is the code that gets called on processor reset.
  * To initialize the device, and call the main() routine.
@@ -302,21 +355,46 @@ const DeviceVectors exception_table = {
 void Reset_Handler(void)
 {
         uint32_t *pSrc, *pDest;
+#if CONF_BOOT_PROFILE
+        uint32_t ul_relocate_end, ul_zero_end;
+
+        boot_cycles_start();
+#endif
+#if CONF_BOOT_FAST
+        /* Let the crystal start up while the sections are initialized */
+        boot_xtal_start();
+#endif
 
         /* Initialize the relocate segment */
         pSrc = &_etext;
         pDest = &_srelocate;
 
         if (pSrc != pDest) {
+#if CONF_BOOT_FAST
+                boot_copy_words(pDest, &_erelocate, pSrc);
+#else
                 for (; pDest < &_erelocate;) {
                         *pDest++ = *pSrc++;
                 }
+#endif
         }
+#if CONF_BOOT_PROFILE
+        ul_relocate_end = boot_cycles();
+#endif
 
         /* Clear the zero segment */
+#if CONF_BOOT_FAST
+        boot_zero_words(&_szero, &_ezero);
+#else
         for (pDest = &_szero; pDest < &_ezero;) {
                 *pDest++ = 0;
         }
+#endif
+#if CONF_BOOT_PROFILE
+        ul_zero_end = boot_cycles();
+        boot_stamp_at(BOOT_PHASE_RELOCATE, ul_relocate_end);
+        boot_stamp_at(BOOT_PHASE_ZERO, ul_zero_end);
+#endif
 
         /* Set the vector table base address */
         pSrc = (uint32_t *) & _sfixed;
@@ -328,6 +406,7 @@ void Reset_Handler(void)
 
         /* Initialize the C library */
         __libc_init_array();
+        boot_stamp(BOOT_PHASE_LIBC);
 
         /* Branch to main function */
         main();
@@ -233,6 +233,22 @@
 #   define RAMFUNC __attribute__ ((section(".ramfunc")))
 #endif
 
+/*
+ * Define ITCM_FUNC, DTCM_DATA and DTCM_BSS attributes: code run from the
+ * ITCM, and initialized or zeroed data in the DTCM. See the .itcm, .dtcm
+ * and .dtcm_bss sections of the linker script; they are loaded by
+ * board_init() when CONF_BOARD_ENABLE_TCM_AT_INIT is defined.
+ */
+#if defined   ( __CC_ARM   ) || defined (  __GNUC__  )
+#   define ITCM_FUNC __attribute__ ((section(".itcm"), noinline))
+#   define DTCM_DATA __attribute__ ((section(".dtcm")))
+#   define DTCM_BSS  __attribute__ ((section(".dtcm_bss")))
+#elif defined ( __ICCARM__ )
+#   define ITCM_FUNC _Pragma("location=\".itcm\"") __no_inline
+#   define DTCM_DATA _Pragma("location=\".dtcm\"")
+#   define DTCM_BSS  _Pragma("location=\".dtcm_bss\"")
+#endif
+
 /* Define OPTIMIZE_HIGH attribute */
 #if defined   ( __CC_ARM   ) /* Keil µVision 4 */
 #   define OPTIMIZE_HIGH _Pragma("O3") 
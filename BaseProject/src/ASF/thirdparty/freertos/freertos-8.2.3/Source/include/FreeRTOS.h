@@ -743,6 +743,16 @@ extern "C" {
 	#define configUSE_TRACE_FACILITY 0
 #endif
 
+/* Placement of the context switch, tick, queue and list fast paths, and of
+the port data they use, for ports with tightly coupled memories. */
+#ifndef configFAST_FUNCTION
+	#define configFAST_FUNCTION
+#endif
+
+#ifndef configFAST_DATA
+	#define configFAST_DATA
+#endif
+
 #ifndef mtCOVERAGE_TEST_MARKER
 	#define mtCOVERAGE_TEST_MARKER()
 #endif
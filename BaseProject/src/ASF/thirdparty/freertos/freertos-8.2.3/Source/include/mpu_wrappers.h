@@ -166,8 +166,13 @@ only for ports that are using the MPU. */
 
 #else /* portUSING_MPU_WRAPPERS */
 
-	#define PRIVILEGED_FUNCTION
-	#define PRIVILEGED_DATA
+	/* Left to FreeRTOSConfig.h when it places the kernel code or data. */
+	#ifndef PRIVILEGED_FUNCTION
+		#define PRIVILEGED_FUNCTION
+	#endif
+	#ifndef PRIVILEGED_DATA
+		#define PRIVILEGED_DATA
+	#endif
 	#define portUSING_MPU_WRAPPERS 0
 
 #endif /* portUSING_MPU_WRAPPERS */
@@ -0,0 +1,328 @@
+/**
+ * \file
+ *
+ * \brief Timer triggered AFEC acquisition through XDMAC.
+ *
+ */
+
+#include <asf.h>
+#include "conf_adc_stream.h"
+#include "clock_scale.h"
+#include "dcache.h"
+#include "dma_ring.h"
+#include "adc_stream.h"
+
+/**
+ * \addtogroup adc_stream_group
+ *
+ * @{
+ */
+
+#if (CONF_ADC_STREAM_BLOCKS < 2)
+#  error "CONF_ADC_STREAM_BLOCKS must be at least 2"
+#endif
+#if ((CONF_ADC_STREAM_BLOCK_SIZE * 4) % DCACHE_LINE_SIZE)
+#  error "CONF_ADC_STREAM_BLOCK_SIZE must be a multiple of 8"
+#endif
+
+#define ADC_STREAM_AFEC     AFEC0
+#define ADC_STREAM_TC       TC0
+
+static uint32_t gs_ul_blocks[CONF_ADC_STREAM_BLOCKS][CONF_ADC_STREAM_BLOCK_SIZE]
+		DCACHE_ALIGNED;
+static lld_view1 gs_desc[CONF_ADC_STREAM_BLOCKS] DCACHE_ALIGNED;
+static uint32_t gs_ul_seq[CONF_ADC_STREAM_BLOCKS];
+static dma_ring_t gs_ring;
+
+static int32_t gs_l_channel = -1;
+
+/** Requested and actual sequence rates. */
+static uint32_t gs_ul_rate;
+static uint32_t gs_ul_actual_rate;
+
+static adc_stream_stats_t gs_stats;
+
+/** Block being converted by adc_stream_dsp_fill(), and its read position. */
+static adc_stream_block_t gs_fill_block;
+static uint32_t gs_ul_fill_pos;
+
+/**
+ * \brief Program the sequence timer for gs_ul_rate.
+ *
+ * \return true on success, false if the rate cannot be reached.
+ */
+static bool adc_stream_set_timer(uint32_t ul_mck)
+{
+	uint32_t ul_div, ul_tcclks, ul_rc;
+
+	if (!tc_find_mck_divisor(gs_ul_rate, ul_mck, &ul_div, &ul_tcclks)) {
+		return false;
+	}
+	ul_rc = (ul_mck / ul_div + gs_ul_rate / 2) / gs_ul_rate;
+	if (ul_rc < 2 || ul_rc > TC_COUNTER_MAX) {
+		return false;
+	}
+
+	/* A rising edge of TIOA on RA starts each sequence. */
+	tc_init(ADC_STREAM_TC, CONF_ADC_STREAM_TC_CHANNEL, ul_tcclks |
+			TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC | TC_CMR_ACPA_SET |
+			TC_CMR_ACPC_CLEAR);
+	tc_write_ra(ADC_STREAM_TC, CONF_ADC_STREAM_TC_CHANNEL, ul_rc / 2);
+	tc_write_rc(ADC_STREAM_TC, CONF_ADC_STREAM_TC_CHANNEL, ul_rc);
+	gs_ul_actual_rate = ul_mck / ul_div / ul_rc;
+
+	return true;
+}
+
+/**
+ * \brief XDMAC callback.
+ */
+static void adc_stream_dma_handler(uint32_t ul_ch, uint32_t ul_status,
+		void *p_ctx)
+{
+	BaseType_t x_woken = pdFALSE;
+
+	UNUSED(p_ctx);
+
+	if (afec_get_interrupt_status(ADC_STREAM_AFEC) & AFEC_ISR_GOVRE) {
+		gs_stats.ul_overruns++;
+	}
+	if (ul_status & DMA_RING_ERRORS) {
+		gs_stats.ul_errors++;
+	}
+	dma_ring_isr(&gs_ring, ul_ch, ul_status, &x_woken);
+	portEND_SWITCHING_ISR(x_woken);
+}
+
+/**
+ * \brief Hold the sequences over a clock switch and bring them back at the
+ * same rate afterwards.
+ */
+static void adc_stream_clock_changed(enum clock_scale_event event,
+		const clock_scale_freq_t *p_freq, void *p_ctx)
+{
+	UNUSED(p_ctx);
+
+	if (gs_l_channel < 0) {
+		return;
+	}
+	if (event == CLOCK_SCALE_PRE_CHANGE) {
+		tc_stop(ADC_STREAM_TC, CONF_ADC_STREAM_TC_CHANNEL);
+		return;
+	}
+	afec_set_clock(ADC_STREAM_AFEC, p_freq->ul_mck_hz,
+			CONF_ADC_STREAM_AFEC_CLOCK);
+	if (adc_stream_set_timer(p_freq->ul_mck_hz)) {
+		tc_start(ADC_STREAM_TC, CONF_ADC_STREAM_TC_CHANNEL);
+	}
+}
+
+static struct clock_scale_notifier gs_clock_notifier = {
+	.callback = adc_stream_clock_changed,
+};
+
+/**
+ * \brief Start the acquisition.
+ *
+ * \param ul_channels AFEC0 channels to convert, one bit per channel.
+ * \param ul_rate Sequence rate in Hz; each channel is sampled at this rate.
+ *
+ * \return true on success, false if already started, out of resources, or
+ * if the rate cannot be reached for this number of channels.
+ */
+bool adc_stream_start(uint32_t ul_channels, uint32_t ul_rate)
+{
+	afec_config_t afec_cfg;
+	uint32_t ul_mck = clock_scale_get_peripheral_hz();
+	uint32_t ul_count = 0;
+	uint32_t i;
+
+	if (gs_l_channel >= 0 || !ul_channels ||
+			ul_channels >= (1u << AFEC_CHANNEL_NUM) || !ul_rate) {
+		return false;
+	}
+	for (i = 0; i < AFEC_CHANNEL_NUM; i++) {
+		ul_count += (ul_channels >> i) & 1;
+	}
+
+	pmc_enable_periph_clk(ID_AFEC0);
+	pmc_enable_periph_clk(ID_TC0 + CONF_ADC_STREAM_TC_CHANNEL);
+	afec_cfg.ul_mck = ul_mck;
+	afec_cfg.ul_afec_clock = CONF_ADC_STREAM_AFEC_CLOCK;
+	afec_cfg.b_tag = true;
+	if (afec_init(ADC_STREAM_AFEC, &afec_cfg) != STATUS_OK ||
+			ul_rate * ul_count > afec_get_clock(ADC_STREAM_AFEC, ul_mck) /
+			AFEC_CONVERSION_CLOCKS) {
+		return false;
+	}
+	gs_ul_rate = ul_rate;
+	if (!adc_stream_set_timer(ul_mck)) {
+		return false;
+	}
+
+	if (!gs_ring.p_blocks) {
+		if (!dma_ring_init(&gs_ring, gs_ul_blocks, sizeof(gs_ul_blocks[0]),
+				CONF_ADC_STREAM_BLOCKS, gs_desc, gs_ul_seq)) {
+			return false;
+		}
+		clock_scale_register(&gs_clock_notifier);
+	}
+	gs_l_channel = xdmac_channel_alloc(adc_stream_dma_handler, NULL);
+	if (gs_l_channel < 0) {
+		return false;
+	}
+
+	gs_fill_block.p_samples = NULL;
+
+	for (i = 0; i < AFEC_CHANNEL_NUM; i++) {
+		if (ul_channels & (1u << i)) {
+			afec_channel_set_analog_offset(ADC_STREAM_AFEC, i,
+					AFEC_OFFSET_MID);
+			afec_channel_enable(ADC_STREAM_AFEC, i);
+		}
+	}
+
+	dma_ring_start(&gs_ring, gs_l_channel,
+			(uint32_t)&ADC_STREAM_AFEC->AFEC_LCDR, CONF_ADC_STREAM_BLOCK_SIZE,
+			XDMAC_CC_TYPE_PER_TRAN | XDMAC_CC_MBSIZE_SINGLE |
+			XDMAC_CC_DSYNC_PER2MEM | XDMAC_CC_CSIZE_CHK_1 |
+			XDMAC_CC_DWIDTH_WORD | XDMAC_CC_SIF_AHB_IF1 |
+			XDMAC_CC_DIF_AHB_IF0 | XDMAC_CC_SAM_FIXED_AM |
+			XDMAC_CC_DAM_INCREMENTED_AM |
+			XDMAC_CC_PERID(XDMAC_PERID_AFEC0));
+
+	/* Drop a stale result and status, then go. */
+	(void)afec_get_latest_value(ADC_STREAM_AFEC);
+	(void)afec_get_interrupt_status(ADC_STREAM_AFEC);
+	xdmac_channel_enable(XDMAC, gs_l_channel);
+	afec_set_trigger(ADC_STREAM_AFEC, (enum afec_trigger)
+			(AFEC_TRIG_TIO_CH_0 + (CONF_ADC_STREAM_TC_CHANNEL << 1)));
+	tc_start(ADC_STREAM_TC, CONF_ADC_STREAM_TC_CHANNEL);
+
+	return true;
+}
+
+/**
+ * \brief Stop the acquisition. Blocks not read yet are discarded.
+ */
+void adc_stream_stop(void)
+{
+	if (gs_l_channel < 0) {
+		return;
+	}
+	tc_stop(ADC_STREAM_TC, CONF_ADC_STREAM_TC_CHANNEL);
+	afec_set_trigger(ADC_STREAM_AFEC, AFEC_TRIG_SW);
+	xdmac_channel_free(gs_l_channel);
+	gs_l_channel = -1;
+
+	dma_ring_reset(&gs_ring);
+	gs_fill_block.p_samples = NULL;
+}
+
+/**
+ * \brief Actual sequence rate in Hz, the requested one rounded to the
+ * timer clock.
+ */
+uint32_t adc_stream_get_rate(void)
+{
+	return gs_ul_actual_rate;
+}
+
+/**
+ * \brief Take the oldest filled block, waiting for one if needed.
+ *
+ * Only one block can be held at a time; give it back with
+ * adc_stream_release_block() before taking the next one.
+ *
+ * \param p_block Filled with the block description.
+ * \param x_timeout Maximum time to wait, in ticks.
+ *
+ * \return true if a block was taken, false on timeout or if a block is
+ * already held.
+ */
+bool adc_stream_get_block(adc_stream_block_t *p_block, TickType_t x_timeout)
+{
+	uint32_t *p_samples = dma_ring_get(&gs_ring, &p_block->ul_seq, x_timeout);
+
+	if (!p_samples) {
+		return false;
+	}
+	p_block->p_samples = p_samples;
+	p_block->ul_count = CONF_ADC_STREAM_BLOCK_SIZE;
+
+	return true;
+}
+
+/**
+ * \brief Give back the block taken with adc_stream_get_block().
+ *
+ * \return true if the block content was intact for the whole time it was
+ * held, false if the DMA has started overwriting it.
+ */
+bool adc_stream_release_block(void)
+{
+	return dma_ring_release(&gs_ring);
+}
+
+/**
+ * \brief Get a snapshot of the acquisition statistics.
+ */
+void adc_stream_get_stats(adc_stream_stats_t *p_stats)
+{
+	taskENTER_CRITICAL();
+	*p_stats = gs_stats;
+	p_stats->ul_blocks = gs_ring.ul_total;
+	p_stats->ul_dropped = gs_ring.ul_dropped;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * \brief DSP source callback: fill a DSP block with the samples of one
+ * channel, scaled to [-1, 1).
+ *
+ * Sample blocks are taken and released as they are used up, so DSP and
+ * sample blocks need not be the same size. A single source may use this
+ * callback, and nothing else may take blocks while it does.
+ *
+ * \param p_block DSP block to fill.
+ * \param p_ctx Channel number, cast to a pointer.
+ *
+ * \return true if the block is full, false if samples were lost or
+ * overwritten while filling it.
+ */
+bool adc_stream_dsp_fill(dsp_block_t *p_block, void *p_ctx)
+{
+	uint32_t ul_channel = (uint32_t)p_ctx;
+	float32_t *p_out = p_block->p_data;
+	uint32_t ul_len = 0;
+	bool b_intact = true;
+
+	while (ul_len < CONF_DSP_BLOCK_SIZE) {
+		if (!gs_fill_block.p_samples) {
+			if (!adc_stream_get_block(&gs_fill_block, portMAX_DELAY)) {
+				gs_fill_block.p_samples = NULL;
+				return false;
+			}
+			gs_ul_fill_pos = 0;
+		}
+		while (gs_ul_fill_pos < gs_fill_block.ul_count &&
+				ul_len < CONF_DSP_BLOCK_SIZE) {
+			uint32_t ul_sample = gs_fill_block.p_samples[gs_ul_fill_pos++];
+
+			if (ADC_STREAM_CHANNEL(ul_sample) == ul_channel) {
+				p_out[ul_len++] = ((int32_t)ADC_STREAM_DATA(ul_sample) -
+						2048) * (1.0f / 2048);
+			}
+		}
+		if (gs_ul_fill_pos == gs_fill_block.ul_count) {
+			gs_fill_block.p_samples = NULL;
+			b_intact &= adc_stream_release_block();
+		}
+	}
+	p_block->ul_len = ul_len;
+	p_block->ul_tag = ul_channel;
+
+	return b_intact;
+}
+
+/** @} */
@@ -0,0 +1,91 @@
+/**
+ * \file
+ *
+ * \brief Timer triggered AFEC acquisition through XDMAC.
+ *
+ */
+
+#ifndef ADC_STREAM_H_INCLUDED
+#define ADC_STREAM_H_INCLUDED
+
+#include "compiler.h"
+#include "FreeRTOS.h"
+#include "dsp_pipe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup adc_stream_group AFEC acquisition
+ *
+ * Converts a set of AFEC0 channels at a fixed rate and streams the results
+ * into a ring of CONF_ADC_STREAM_BLOCKS blocks through a circular XDMAC
+ * linked list. A TC0 channel in waveform mode raises TIOA at the sequence
+ * rate, each rising edge converts every enabled channel in channel order,
+ * and the XDMAC moves each result as it is ready: there is no CPU work per
+ * sample, only one interrupt per block. The analog pins must be set up
+ * beforehand.
+ *
+ * Each sample is a 32-bit AFEC_LCDR word: the 12-bit result in
+ * ADC_STREAM_DATA() and the channel number in ADC_STREAM_CHANNEL().
+ *
+ * A task takes the oldest filled block with adc_stream_get_block() and
+ * hands it back with adc_stream_release_block(), as with
+ * \ref parcap_group, with the same behaviour when it falls behind: the
+ * oldest block is dropped. With two blocks the reader has one block
+ * period to finish with a block.
+ *
+ * adc_stream_dsp_fill() is a \ref dsp_stages_group source callback that
+ * feeds one channel into a DSP pipeline.
+ *
+ * The sequence rate is kept across clock_scale_set() switches, with the
+ * precision the new clock allows.
+ *
+ * @{
+ */
+
+/** 12-bit result of a sample. */
+#define ADC_STREAM_DATA(ul_sample)      ((ul_sample) & 0xFFFu)
+
+/** Channel of a sample. */
+#define ADC_STREAM_CHANNEL(ul_sample) \
+	(((ul_sample) & AFEC_LCDR_CHNB_Msk) >> AFEC_LCDR_CHNB_Pos)
+
+/** A filled sample block. */
+typedef struct adc_stream_block {
+	/** Samples, in conversion order. */
+	const uint32_t *p_samples;
+	/** Number of samples. */
+	uint32_t ul_count;
+	/** Sequence number, incremented for every block filled. */
+	uint32_t ul_seq;
+} adc_stream_block_t;
+
+/** Acquisition statistics. */
+typedef struct adc_stream_stats {
+	/** Blocks filled by the DMA. */
+	uint32_t ul_blocks;
+	/** Blocks dropped because the reader fell behind. */
+	uint32_t ul_dropped;
+	/** Conversions lost because the DMA did not keep up. */
+	uint32_t ul_overruns;
+	/** DMA bus errors. */
+	uint32_t ul_errors;
+} adc_stream_stats_t;
+
+bool adc_stream_start(uint32_t ul_channels, uint32_t ul_rate);
+void adc_stream_stop(void);
+uint32_t adc_stream_get_rate(void);
+bool adc_stream_get_block(adc_stream_block_t *p_block, TickType_t x_timeout);
+bool adc_stream_release_block(void);
+void adc_stream_get_stats(adc_stream_stats_t *p_stats);
+bool adc_stream_dsp_fill(dsp_block_t *p_block, void *p_ctx);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ADC_STREAM_H_INCLUDED */
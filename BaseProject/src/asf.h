@@ -52,10 +52,16 @@
  * running the ASF driver selector tool. Any changes will be discarded.
  */
 
+// From module: AFEC - Analog Front End Controller
+#include <afec.h>
+
 // From module: Common SAM compiler driver
 #include <compiler.h>
 #include <status_codes.h>
 
+// From module: EFC - Enhanced Embedded Flash Controller
+#include <efc.h>
+
 // From module: FreeRTOS - kernel 8.2.3
 #include <FreeRTOS.h>
 #include <StackMacros.h>
@@ -71,6 +77,9 @@
 #include <task.h>
 #include <timers.h>
 
+// From module: GMAC - Ethernet MAC
+#include <gmac.h>
+
 // From module: GPIO - General purpose Input/Output
 #include <gpio.h>
 
@@ -83,6 +92,9 @@
 // From module: Interrupt management - SAM implementation
 #include <interrupt.h>
 
+// From module: MCAN - Controller Area Network
+#include <mcan.h>
+
 // From module: MPU - Memory Protect Unit
 #include <mpu.h>
 
@@ -93,9 +105,15 @@
 #include <pmc.h>
 #include <sleep.h>
 
+// From module: PWM - Pulse Width Modulation
+#include <pwm.h>
+
 // From module: Part identification macros
 #include <parts.h>
 
+// From module: QSPI - Quad Serial Peripheral Interface
+#include <qspi.h>
+
 // From module: SAM FPU driver
 #include <fpu.h>
 
@@ -108,6 +126,9 @@
 // From module: System Clock Control - SAMV71 implementation
 #include <sysclk.h>
 
+// From module: TC - Timer Counter
+#include <tc.h>
+
 // From module: UART - Univ. Async Rec/Trans
 #include <uart.h>
 
@@ -117,6 +138,12 @@
 // From module: USART - Univ. Syn Async Rec/Trans
 #include <usart.h>
 
+// From module: USBHS - USB High-Speed device
+#include <usbhs_device.h>
+
+// From module: XDMAC - XDMA Controller
+#include <xdmac.h>
+
 // From module: pio_handler support enabled
 #include <pio_handler.h>
 
@@ -0,0 +1,358 @@
+/**
+ * \file
+ *
+ * \brief Build profile benchmark.
+ *
+ */
+
+#include <asf.h>
+#include <string.h>
+#include "arm_math.h"
+#include "queue.h"
+#include "conf_stack_guard.h"
+#include "conf_tcm.h"
+#include "conf_console.h"
+#include "console.h"
+#include "clock_scale.h"
+#include "cycles.h"
+#include "fmt.h"
+#include "bench.h"
+
+/**
+ * \addtogroup bench_group
+ *
+ * @{
+ */
+
+#ifdef NDEBUG
+#  define BENCH_CONFIG    "release"
+#else
+#  define BENCH_CONFIG    "debug"
+#endif
+
+#if CONF_STACK_GUARD
+#  define BENCH_STACK_CHECK "mpu guard"
+#else
+#  define BENCH_STACK_CHECK "fill pattern"
+#endif
+
+#if CONF_TCM
+#  define BENCH_KERNEL    "tcm"
+#else
+#  define BENCH_KERNEL    "flash"
+#endif
+
+#if CONF_BENCH_CONSOLE_BYTES > CONF_CONSOLE_TX_BUFFER_SIZE
+#  error CONF_BENCH_CONSOLE_BYTES must fit in the console transmit ring
+#endif
+
+#ifdef __ARM_PCS_VFP
+#  define BENCH_FLOAT_ABI "hard"
+#else
+#  define BENCH_FLOAT_ABI "softfp"
+#endif
+
+/** Workload run once per round, returning the operations it did. */
+typedef uint32_t (*bench_fn_t)(void);
+
+typedef struct {
+	const char *p_group;
+	const char *p_name;
+	/** Operation counted, for the report. */
+	const char *p_unit;
+	/** Called before each round, outside the timing, may be NULL. */
+	void (*prepare)(void);
+	bench_fn_t run;
+} bench_t;
+
+static TaskHandle_t gs_x_caller;
+static TaskHandle_t gs_x_echo;
+static QueueHandle_t gs_x_queue;
+
+static float32_t gs_f_in[CONF_BENCH_FFT_LEN];
+static float32_t gs_f_out[CONF_BENCH_FFT_LEN];
+static float32_t gs_f_fir_coeffs[CONF_BENCH_FIR_TAPS];
+static float32_t gs_f_fir_state[CONF_BENCH_BLOCK_SIZE + CONF_BENCH_FIR_TAPS - 1];
+static float32_t gs_f_biquad_coeffs[5 * CONF_BENCH_BIQUAD_STAGES];
+static float32_t gs_f_biquad_state[2 * CONF_BENCH_BIQUAD_STAGES];
+static arm_fir_instance_f32 gs_fir;
+static arm_biquad_cascade_df2T_instance_f32 gs_biquad;
+static arm_rfft_fast_instance_f32 gs_rfft;
+static volatile float32_t gs_f_sink;
+
+/**
+ * Bytes written to the console: spaces and a carriage return, which the
+ * next line of the report overwrites on the terminal.
+ */
+static uint8_t gs_uc_console[CONF_BENCH_CONSOLE_BYTES];
+
+/**
+ * \brief Answer each notification of the benchmark task with one of its own.
+ */
+static void bench_echo_task(void *p_arg)
+{
+	uint32_t ul_count = (uint32_t)p_arg;
+
+	while (ul_count--) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		xTaskNotifyGive(gs_x_caller);
+	}
+	gs_x_echo = NULL;
+	vTaskDelete(NULL);
+}
+
+static uint32_t bench_switch(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < CONF_BENCH_KERNEL_OPS; i++) {
+		xTaskNotifyGive(gs_x_echo);
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+	}
+	return CONF_BENCH_KERNEL_OPS;
+}
+
+static uint32_t bench_queue(void)
+{
+	uint32_t i, ul_item;
+
+	for (i = 0; i < CONF_BENCH_KERNEL_OPS; i++) {
+		xQueueSend(gs_x_queue, &i, 0);
+		xQueueReceive(gs_x_queue, &ul_item, 0);
+	}
+	return CONF_BENCH_KERNEL_OPS;
+}
+
+/**
+ * \brief Out of line multiply-accumulate: the arguments and the result
+ * travel in S registers with the hard float ABI and in core registers with
+ * softfp.
+ */
+__attribute__((noinline, noclone))
+static float32_t bench_mac(float32_t f_acc, float32_t f_a, float32_t f_b)
+{
+	return f_acc + f_a * f_b;
+}
+
+static uint32_t bench_call(void)
+{
+	float32_t f_acc = 0.0f;
+	uint32_t i;
+
+	for (i = 0; i < CONF_BENCH_BLOCK_SIZE; i++) {
+		f_acc = bench_mac(f_acc, gs_f_in[i], gs_f_fir_coeffs[i %
+				CONF_BENCH_FIR_TAPS]);
+	}
+	gs_f_sink = f_acc;
+	return CONF_BENCH_BLOCK_SIZE;
+}
+
+static uint32_t bench_fir(void)
+{
+	arm_fir_f32(&gs_fir, gs_f_in, gs_f_out, CONF_BENCH_BLOCK_SIZE);
+	return CONF_BENCH_BLOCK_SIZE;
+}
+
+static uint32_t bench_biquad(void)
+{
+	arm_biquad_cascade_df2T_f32(&gs_biquad, gs_f_in, gs_f_out,
+			CONF_BENCH_BLOCK_SIZE);
+	return CONF_BENCH_BLOCK_SIZE;
+}
+
+/**
+ * \brief Restore the FFT input, which the transform overwrites.
+ */
+static void bench_rfft_prepare(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < CONF_BENCH_FFT_LEN; i++) {
+		gs_f_out[i] = gs_f_in[i];
+	}
+}
+
+static uint32_t bench_rfft(void)
+{
+	static float32_t f_spectrum[CONF_BENCH_FFT_LEN];
+
+	arm_rfft_fast_f32(&gs_rfft, gs_f_out, f_spectrum, 0);
+	return 1;
+}
+
+static uint32_t bench_fmt(void)
+{
+	char c_line[80];
+	uint32_t i;
+
+	for (i = 0; i < CONF_BENCH_FMT_LINES; i++) {
+		fmt_snprintf(c_line, sizeof(c_line),
+				"  %-12s %10lu calls %8lu avg %8lu max %6lu drop\r\n",
+				"fir", (unsigned long)i * 1021, (unsigned long)i * 17,
+				(unsigned long)i * 31, (unsigned long)i);
+	}
+	return CONF_BENCH_FMT_LINES;
+}
+
+/**
+ * \brief Hold the console transmit ring and send what it has, so that each
+ * round writes into an empty ring.
+ */
+static void bench_console_fill_prepare(void)
+{
+	console_tx_hold(true);
+	while (console_tx_free() < CONF_CONSOLE_TX_BUFFER_SIZE) {
+		console_tx_poll();
+	}
+}
+
+static uint32_t bench_console_fill(void)
+{
+	return console_write(gs_uc_console, sizeof(gs_uc_console));
+}
+
+/**
+ * \brief Wait until the USART takes a byte, with bytes left in the held
+ * ring.
+ */
+static void bench_console_drain_prepare(void)
+{
+	Usart *p_usart = (Usart *)CONF_UART;
+
+	console_tx_hold(true);
+	if (console_tx_free() == CONF_CONSOLE_TX_BUFFER_SIZE) {
+		console_write(gs_uc_console, sizeof(gs_uc_console));
+	}
+	while (!usart_is_tx_ready(p_usart)) {
+	}
+}
+
+static uint32_t bench_console_drain(void)
+{
+	return console_tx_poll();
+}
+
+static const bench_t gs_benches[] = {
+	{"kernel", "switch", "round trip", NULL, bench_switch},
+	{"kernel", "queue", "send+recv", NULL, bench_queue},
+	{"dsp", "f32 call", "call", NULL, bench_call},
+	{"dsp", "fir f32", "sample", NULL, bench_fir},
+	{"dsp", "biquad f32", "sample", NULL, bench_biquad},
+	{"dsp", "rfft f32", "transform", bench_rfft_prepare, bench_rfft},
+	{"fmt", "snprintf", "line", NULL, bench_fmt},
+	{"console", "ring fill", "byte", bench_console_fill_prepare,
+			bench_console_fill},
+	{"console", "tx drain", "byte", bench_console_drain_prepare,
+			bench_console_drain},
+};
+
+/**
+ * \brief Set up the kernel objects and the DSP instances and data.
+ *
+ * \retval true on success.
+ */
+static bool bench_setup(void)
+{
+	uint32_t i, ul_seed = 1;
+
+	memset(gs_uc_console, ' ', sizeof(gs_uc_console));
+	gs_uc_console[sizeof(gs_uc_console) - 1] = '\r';
+	for (i = 0; i < CONF_BENCH_FFT_LEN; i++) {
+		/* Uniform noise in [-1, 1). */
+		ul_seed = ul_seed * 1664525 + 1013904223;
+		gs_f_in[i] = (float32_t)(int32_t)ul_seed / 2147483648.0f;
+	}
+	for (i = 0; i < CONF_BENCH_FIR_TAPS; i++) {
+		gs_f_fir_coeffs[i] = 1.0f / CONF_BENCH_FIR_TAPS;
+	}
+	for (i = 0; i < CONF_BENCH_BIQUAD_STAGES; i++) {
+		/* Butterworth low-pass at fs / 8: b0, b1, b2, a1, a2. */
+		gs_f_biquad_coeffs[5 * i + 0] = 0.0976f;
+		gs_f_biquad_coeffs[5 * i + 1] = 0.1953f;
+		gs_f_biquad_coeffs[5 * i + 2] = 0.0976f;
+		gs_f_biquad_coeffs[5 * i + 3] = 0.9428f;
+		gs_f_biquad_coeffs[5 * i + 4] = -0.3333f;
+	}
+	arm_fir_init_f32(&gs_fir, CONF_BENCH_FIR_TAPS, gs_f_fir_coeffs,
+			gs_f_fir_state, CONF_BENCH_BLOCK_SIZE);
+	arm_biquad_cascade_df2T_init_f32(&gs_biquad, CONF_BENCH_BIQUAD_STAGES,
+			gs_f_biquad_coeffs, gs_f_biquad_state);
+	if (arm_rfft_fast_init_f32(&gs_rfft, CONF_BENCH_FFT_LEN) != ARM_MATH_SUCCESS) {
+		return false;
+	}
+
+	if (gs_x_queue == NULL) {
+		gs_x_queue = xQueueCreate(1, sizeof(uint32_t));
+		if (gs_x_queue == NULL) {
+			return false;
+		}
+	}
+
+	/* The echo task preempts the caller as soon as it is notified. */
+	gs_x_caller = xTaskGetCurrentTaskHandle();
+	ulTaskNotifyTake(pdTRUE, 0);
+	if (xTaskCreate(bench_echo_task, "Bench",
+			configMINIMAL_STACK_SIZE, (void *)(CONF_BENCH_ROUNDS *
+			CONF_BENCH_KERNEL_OPS), uxTaskPriorityGet(NULL) + 1,
+			&gs_x_echo) != pdPASS) {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * \brief Run the benchmarks and print the fastest round of each.
+ *
+ * Runs in the calling task, which is blocked for the duration.
+ */
+void bench_run(void)
+{
+	uint32_t ul_hz = clock_scale_get_cpu_hz();
+	uint32_t i, j;
+
+	printf("-- Bench: %s, %s float ABI, %s stack check, %s kernel, "
+			"%lu Hz --\r\n", BENCH_CONFIG, BENCH_FLOAT_ABI,
+			BENCH_STACK_CHECK, BENCH_KERNEL, (unsigned long)ul_hz);
+	if (!bench_setup()) {
+		printf("setup failed\r\n");
+		return;
+	}
+	cycle_counter_enable();
+
+	printf("  %-8s %-11s %12s %12s\r\n", "group", "name", "cycles/op",
+			"op/s");
+	for (i = 0; i < sizeof(gs_benches) / sizeof(gs_benches[0]); i++) {
+		const bench_t *p_bench = &gs_benches[i];
+		uint32_t ul_best = UINT32_MAX;
+		uint32_t ul_ops = 1;
+
+		for (j = 0; j < CONF_BENCH_ROUNDS; j++) {
+			uint32_t ul_start;
+
+			if (p_bench->prepare) {
+				p_bench->prepare();
+			}
+			ul_start = DWT->CYCCNT;
+			ul_ops = p_bench->run();
+			ul_start = DWT->CYCCNT - ul_start;
+			if (ul_start < ul_best) {
+				ul_best = ul_start;
+			}
+		}
+
+		/* Cycles per operation with one decimal, none if the workload
+		 * could not run, as the console drain on USB. */
+		ul_best = ul_ops ? (uint32_t)(((uint64_t)ul_best * 10 +
+				ul_ops / 2) / ul_ops) : 0;
+		printf("  %-8s %-11s %10lu.%lu %12lu %s\r\n", p_bench->p_group,
+				p_bench->p_name, (unsigned long)(ul_best / 10),
+				(unsigned long)(ul_best % 10),
+				(unsigned long)(ul_best ?
+				(uint64_t)ul_hz * 10 / ul_best : 0),
+				p_bench->p_unit);
+	}
+	/* The console items leave the transmit ring held. */
+	console_tx_hold(false);
+}
+
+/** @} */
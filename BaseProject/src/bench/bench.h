@@ -0,0 +1,57 @@
+/**
+ * \file
+ *
+ * \brief Build profile benchmark.
+ *
+ */
+
+#ifndef BENCH_H_INCLUDED
+#define BENCH_H_INCLUDED
+
+#include "compiler.h"
+#include "conf_bench.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup bench_group Build profile benchmark
+ *
+ * A fixed set of timed workloads for comparing the build configurations of
+ * the project (optimization level, floating point ABI, LTO) on the same
+ * board. Each workload runs CONF_BENCH_ROUNDS times in the calling task and
+ * the fastest round, in core cycles, is reported, which keeps interrupts
+ * and other tasks mostly out of the figures.
+ *
+ * - kernel: task notification round trip between two tasks (two context
+ *   switches) and a queue send and receive without blocking. The switch
+ *   includes the stack overflow check of CONF_STACK_GUARD, and both run
+ *   from the TCMs with CONF_TCM.
+ * - dsp: an out of line float multiply-accumulate call, which shows the
+ *   argument passing cost of the ABI, then the CMSIS-DSP FIR, biquad and
+ *   real FFT kernels used by the DSP pipeline.
+ * - fmt: formatting a shell style line into memory with fmt_snprintf().
+ * - console: console_write() of CONF_BENCH_CONSOLE_BYTES into the empty
+ *   transmit ring, and the drain of the ring into the USART, per byte. The
+ *   ring is held (see console_tx_hold()) so that the interrupt stays out of
+ *   both, and each drain round starts once the USART takes a byte: the
+ *   figure is the processor time per byte sent, not the baud rate. There
+ *   is no drain figure while USB has the console.
+ *
+ * The report starts with the profile the image was built with, its stack
+ * overflow check and kernel placement, so results from several builds can
+ * be lined up.
+ *
+ * @{
+ */
+
+void bench_run(void);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BENCH_H_INCLUDED */
@@ -0,0 +1,91 @@
+/**
+ * \file
+ *
+ * \brief Boot phase profiler.
+ *
+ */
+
+#include <asf.h>
+#include "boot.h"
+
+/**
+ * \addtogroup boot_group
+ *
+ * @{
+ */
+
+#if CONF_BOOT_PROFILE
+
+/** Processor clock out of reset. */
+#define BOOT_RESET_HZ    CHIP_FREQ_MAINCK_RC_12MHZ
+
+static const char *const gs_phase_names[BOOT_PHASE_NUM] = {
+	[BOOT_PHASE_RELOCATE] = "relocate",
+	[BOOT_PHASE_ZERO] = "zero",
+	[BOOT_PHASE_LIBC] = "libc",
+	[BOOT_PHASE_SYSCLK] = "sysclk",
+	[BOOT_PHASE_BOARD] = "board",
+	[BOOT_PHASE_DRIVERS] = "drivers",
+	[BOOT_PHASE_TASKS] = "tasks",
+	[BOOT_PHASE_SCHEDULER] = "scheduler",
+};
+
+/** Stamps, in the order the phases ended. */
+static struct {
+	uint8_t uc_phase;
+	uint32_t ul_cycles;
+} gs_stamps[CONF_BOOT_MAX_STAMPS];
+static uint32_t gs_ul_stamp_count;
+
+/**
+ * \brief Record the end of a boot phase at a given cycle count, for the
+ * phases that end before .bss is cleared.
+ */
+void boot_stamp_at(enum boot_phase phase, uint32_t ul_cycles)
+{
+	if (gs_ul_stamp_count < CONF_BOOT_MAX_STAMPS) {
+		gs_stamps[gs_ul_stamp_count].uc_phase = phase;
+		gs_stamps[gs_ul_stamp_count].ul_cycles = ul_cycles;
+		gs_ul_stamp_count++;
+	}
+}
+
+/**
+ * \brief Print the boot phases with their cycle counts and durations.
+ *
+ * The first call also stamps BOOT_PHASE_SCHEDULER, so it is meant to be
+ * made by the first task that runs.
+ */
+void boot_report(void)
+{
+	uint32_t ul_hz = BOOT_RESET_HZ;
+	uint32_t ul_prev = 0;
+	uint64_t ull_total_ns = 0;
+	uint32_t i;
+
+	if (gs_ul_stamp_count &&
+			gs_stamps[gs_ul_stamp_count - 1].uc_phase != BOOT_PHASE_SCHEDULER) {
+		boot_stamp(BOOT_PHASE_SCHEDULER);
+	}
+
+	printf("-- Boot phases: cycles, us --\r\n");
+	for (i = 0; i < gs_ul_stamp_count; i++) {
+		uint32_t ul_cycles = gs_stamps[i].ul_cycles - ul_prev;
+		uint64_t ull_ns = (uint64_t)ul_cycles * 1000000000 / ul_hz;
+
+		printf("  %-10s %10lu %8lu\r\n",
+				gs_phase_names[gs_stamps[i].uc_phase],
+				(unsigned long)ul_cycles, (unsigned long)(ull_ns / 1000));
+		ull_total_ns += ull_ns;
+		ul_prev = gs_stamps[i].ul_cycles;
+		if (gs_stamps[i].uc_phase == BOOT_PHASE_SYSCLK) {
+			ul_hz = sysclk_get_cpu_hz();
+		}
+	}
+	printf("  %-10s %10lu %8lu\r\n", "total", (unsigned long)ul_prev,
+			(unsigned long)(ull_total_ns / 1000));
+}
+
+#endif /* CONF_BOOT_PROFILE */
+
+/** @} */
@@ -0,0 +1,121 @@
+/**
+ * \file
+ *
+ * \brief Boot phase profiler and fast boot helpers.
+ *
+ */
+
+#ifndef BOOT_H_INCLUDED
+#define BOOT_H_INCLUDED
+
+#include "compiler.h"
+#include "osc.h"
+#include "conf_boot.h"
+#include "cycles.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup boot_group Boot profiler
+ *
+ * Reset_Handler() restarts the core cycle counter (DWT_CYCCNT) and each boot
+ * phase records the counter when it ends. The stamps are printed by
+ * boot_report() once the scheduler runs, with the time spent in each phase.
+ *
+ * The counter runs at the processor clock, which is the 12 MHz RC
+ * oscillator until sysclk_init() returns. Phase durations are converted
+ * with the clock in use when the phase started, so the sysclk phase, which
+ * mostly waits for the crystal and PLLA, is counted at 12 MHz.
+ *
+ * @{
+ */
+
+/** Boot phases, named after the step that ends them. */
+enum boot_phase {
+	/** .relocate copied to RAM. */
+	BOOT_PHASE_RELOCATE,
+	/** .bss cleared. */
+	BOOT_PHASE_ZERO,
+	/** C library and constructors initialized. */
+	BOOT_PHASE_LIBC,
+	/** sysclk_init() done. */
+	BOOT_PHASE_SYSCLK,
+	/** board_init() done. */
+	BOOT_PHASE_BOARD,
+	/** Console and application drivers started. */
+	BOOT_PHASE_DRIVERS,
+	/** Tasks created, vTaskStartScheduler() called. */
+	BOOT_PHASE_TASKS,
+	/** First task running. */
+	BOOT_PHASE_SCHEDULER,
+	BOOT_PHASE_NUM
+};
+
+/**
+ * \brief Enable the core cycle counter and restart it from 0.
+ */
+static inline void boot_cycles_start(void)
+{
+	cycle_counter_enable();
+	DWT->CYCCNT = 0;
+}
+
+/**
+ * \brief Core cycles since Reset_Handler().
+ */
+static inline uint32_t boot_cycles(void)
+{
+	return DWT->CYCCNT;
+}
+
+/**
+ * \brief Start the main crystal without waiting for it, nor selecting it.
+ * osc_enable(OSC_MAINCK_XTAL) in sysclk_init() then finds it running.
+ *
+ * Touches no RAM, so it may run before the sections are initialized.
+ */
+static inline void boot_xtal_start(void)
+{
+	PMC->CKGR_MOR = (PMC->CKGR_MOR & ~CKGR_MOR_MOSCXTBY) |
+			CKGR_MOR_KEY_PASSWD | CKGR_MOR_MOSCXTEN |
+			CKGR_MOR_MOSCXTST(pmc_us_to_moscxtst(BOARD_OSC_STARTUP_US,
+			OSC_SLCK_32K_RC_HZ));
+}
+
+#if CONF_BOOT_PROFILE
+void boot_stamp_at(enum boot_phase phase, uint32_t ul_cycles);
+void boot_report(void);
+
+/**
+ * \brief Record the end of a boot phase. Only once .bss is cleared.
+ */
+static inline void boot_stamp(enum boot_phase phase)
+{
+	boot_stamp_at(phase, boot_cycles());
+}
+#else
+static inline void boot_stamp_at(enum boot_phase phase, uint32_t ul_cycles)
+{
+	UNUSED(phase);
+	UNUSED(ul_cycles);
+}
+
+static inline void boot_report(void)
+{
+}
+
+static inline void boot_stamp(enum boot_phase phase)
+{
+	UNUSED(phase);
+}
+#endif
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BOOT_H_INCLUDED */
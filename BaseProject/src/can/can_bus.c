@@ -0,0 +1,235 @@
+/**
+ * \file
+ *
+ * \brief CAN bus access for tasks.
+ *
+ */
+
+#include <asf.h>
+#include "conf_can_bus.h"
+#include "dma_buf.h"
+#include "semphr.h"
+#include "can_bus.h"
+
+/**
+ * \addtogroup can_bus_group
+ *
+ * @{
+ */
+
+/** Sources that wake the reader. */
+#define CAN_BUS_RX_EVENTS   (MCAN_IE_RF0WE | MCAN_IE_TOOE | MCAN_IE_RF1NE)
+
+/** Sources only counted, by the driver. */
+#define CAN_BUS_ERROR_EVENTS \
+	(MCAN_IE_RF0LE | MCAN_IE_RF1LE | MCAN_IE_BOE)
+
+static mcan_dev_t gs_can;
+static bool gs_b_ready;
+static SemaphoreHandle_t gs_x_rx;
+static SemaphoreHandle_t gs_x_tx;
+static SemaphoreHandle_t gs_x_tx_lock;
+
+/**
+ * \brief MCAN0 callback: wake the reader, or a sender waiting for room.
+ */
+static void can_bus_handler(mcan_dev_t *p_dev, uint32_t ul_ir)
+{
+	BaseType_t x_woken = pdFALSE;
+
+	if (ul_ir & (MCAN_IR_RF0W | MCAN_IR_TOO | MCAN_IR_RF1N)) {
+		xSemaphoreGiveFromISR(gs_x_rx, &x_woken);
+	}
+	if (ul_ir & MCAN_IR_TC) {
+		/* Level triggered: off until a sender is short of room again. */
+		p_dev->p_mcan->MCAN_IE &= ~MCAN_IE_TCE;
+		xSemaphoreGiveFromISR(gs_x_tx, &x_woken);
+	}
+	portEND_SWITCHING_ISR(x_woken);
+}
+
+/**
+ * \brief Start MCAN0 on the bus with the settings of conf_can_bus.h.
+ *
+ * All filters are disabled: every frame goes to receive FIFO 0 until
+ * can_bus_set_filter() says otherwise.
+ *
+ * \return true on success, false if already started, out of memory or if
+ * the bit rates cannot be reached.
+ */
+bool can_bus_init(void)
+{
+	mcan_config_t cfg;
+	void *p_ram;
+
+	if (gs_b_ready) {
+		return false;
+	}
+
+	cfg.ul_clock_hz = BOARD_FREQ_MAINCK_XTAL / (CONF_CAN_BUS_PCK_PRES + 1);
+	cfg.ul_bitrate = CONF_CAN_BUS_BITRATE;
+	cfg.ul_data_bitrate = CONF_CAN_BUS_DATA_BITRATE;
+	cfg.mode = CONF_CAN_BUS_MODE;
+	cfg.uc_std_filters = CONF_CAN_BUS_STD_FILTERS;
+	cfg.uc_ext_filters = CONF_CAN_BUS_EXT_FILTERS;
+	cfg.uc_rx0_size = CONF_CAN_BUS_RX0_SIZE;
+	cfg.uc_rx0_watermark = CONF_CAN_BUS_RX0_WATERMARK;
+	cfg.uc_rx1_size = CONF_CAN_BUS_RX1_SIZE;
+	cfg.uc_rx1_watermark = 0;
+	cfg.uc_tx_size = CONF_CAN_BUS_TX_SIZE;
+	cfg.uc_data_size = CONF_CAN_BUS_DATA_SIZE;
+	cfg.nonmatch = MCAN_FILTER_TO_FIFO_0;
+	cfg.ul_rx0_timeout = CONF_CAN_BUS_RX0_TIMEOUT;
+	cfg.b_loopback = false;
+
+	if (!gs_x_rx) {
+		gs_x_rx = xSemaphoreCreateBinary();
+		gs_x_tx = xSemaphoreCreateBinary();
+		gs_x_tx_lock = xSemaphoreCreateMutex();
+		if (!gs_x_rx || !gs_x_tx || !gs_x_tx_lock) {
+			return false;
+		}
+	}
+	p_ram = dma_buf_alloc(mcan_ram_size(&cfg), DMA_BUF_NOCACHE);
+	if (!p_ram) {
+		return false;
+	}
+
+	pmc_enable_periph_clk(ID_MCAN0);
+	pmc_disable_pck(PMC_PCK_5);
+	pmc_switch_pck_to_mainck(PMC_PCK_5, PMC_PCK_PRES(CONF_CAN_BUS_PCK_PRES));
+	pmc_enable_pck(PMC_PCK_5);
+
+	if (mcan_init(&gs_can, MCAN0, p_ram, &cfg) != STATUS_OK) {
+		dma_buf_free(p_ram);
+		return false;
+	}
+	mcan_set_callback(&gs_can, can_bus_handler, NULL);
+
+	NVIC_ClearPendingIRQ(MCAN0_IRQn);
+	NVIC_SetPriority(MCAN0_IRQn, CONF_CAN_BUS_IRQ_PRIORITY);
+	NVIC_EnableIRQ(MCAN0_IRQn);
+	mcan_enable_interrupt(&gs_can, CAN_BUS_RX_EVENTS | CAN_BUS_ERROR_EVENTS);
+	mcan_start(&gs_can);
+	gs_b_ready = true;
+
+	return true;
+}
+
+/**
+ * \brief Set a standard or extended identifier filter.
+ *
+ * \return true on success, false if \a ul_index is out of the filter list.
+ */
+bool can_bus_set_filter(bool b_ext, uint32_t ul_index,
+		const mcan_filter_t *p_filter)
+{
+	if (!gs_b_ready) {
+		return false;
+	}
+	if (b_ext) {
+		return mcan_set_ext_filter(&gs_can, ul_index, p_filter) == STATUS_OK;
+	}
+	return mcan_set_std_filter(&gs_can, ul_index, p_filter) == STATUS_OK;
+}
+
+/**
+ * \brief Take the received frames, waiting for some if there are none.
+ *
+ * Frames from receive FIFO 1 come first. A single task may receive.
+ *
+ * \param p_frames Array receiving the frames.
+ * \param ul_max Size of \a p_frames.
+ * \param x_timeout Maximum time to wait, in ticks.
+ *
+ * \return Number of frames taken, 0 on timeout.
+ */
+uint32_t can_bus_receive(mcan_frame_t *p_frames, uint32_t ul_max,
+		TickType_t x_timeout)
+{
+	uint32_t ul_count;
+
+	if (!gs_b_ready) {
+		return 0;
+	}
+	for (;;) {
+		ul_count = mcan_rx_fifo_read(&gs_can, MCAN_RX_FIFO_1, p_frames,
+				ul_max);
+		ul_count += mcan_rx_fifo_read(&gs_can, MCAN_RX_FIFO_0,
+				p_frames + ul_count, ul_max - ul_count);
+		if (ul_count || !ul_max) {
+			return ul_count;
+		}
+		if (xSemaphoreTake(gs_x_rx, x_timeout) != pdTRUE) {
+			return 0;
+		}
+	}
+}
+
+/**
+ * \brief Send frames, waiting for room in the transmit FIFO as needed.
+ *
+ * Returns once the frames are queued, not sent. Tasks may send
+ * concurrently, each call's frames stay together and in order.
+ *
+ * \param p_frames Frames to send, see mcan_tx_fifo_write().
+ * \param ul_count Number of frames.
+ * \param x_timeout Maximum time to wait for room, in ticks.
+ *
+ * \return Number of frames queued, less than \a ul_count on timeout.
+ */
+uint32_t can_bus_send(const mcan_frame_t *p_frames, uint32_t ul_count,
+		TickType_t x_timeout)
+{
+	uint32_t ul_sent = 0;
+
+	if (!gs_b_ready ||
+			xSemaphoreTake(gs_x_tx_lock, x_timeout) != pdTRUE) {
+		return 0;
+	}
+	for (;;) {
+		/* A completion from now on means room for the rest. */
+		mcan_clear_interrupt(&gs_can, MCAN_IR_TC);
+		xSemaphoreTake(gs_x_tx, 0);
+		ul_sent += mcan_tx_fifo_write(&gs_can, p_frames + ul_sent,
+				ul_count - ul_sent);
+		if (ul_sent == ul_count) {
+			break;
+		}
+		mcan_enable_interrupt(&gs_can, MCAN_IE_TCE);
+		if (xSemaphoreTake(gs_x_tx, x_timeout) != pdTRUE) {
+			mcan_disable_interrupt(&gs_can, MCAN_IE_TCE);
+			break;
+		}
+	}
+	xSemaphoreGive(gs_x_tx_lock);
+
+	return ul_sent;
+}
+
+/**
+ * \brief Get a snapshot of the bus statistics.
+ *
+ * \return false if the bus is not started.
+ */
+bool can_bus_get_stats(can_bus_stats_t *p_stats)
+{
+	uint32_t ul_ecr;
+
+	if (!gs_b_ready) {
+		return false;
+	}
+	taskENTER_CRITICAL();
+	p_stats->ul_rx_frames = gs_can.ul_rx_frames;
+	p_stats->ul_tx_frames = gs_can.ul_tx_frames;
+	p_stats->ul_rx_overflows = gs_can.ul_rx_overflows;
+	p_stats->ul_bus_off = gs_can.ul_bus_off;
+	taskEXIT_CRITICAL();
+	ul_ecr = mcan_get_error_counters(&gs_can);
+	p_stats->uc_tx_errors = (ul_ecr & MCAN_ECR_TEC_Msk) >> MCAN_ECR_TEC_Pos;
+	p_stats->uc_rx_errors = (ul_ecr & MCAN_ECR_REC_Msk) >> MCAN_ECR_REC_Pos;
+
+	return true;
+}
+
+/** @} */
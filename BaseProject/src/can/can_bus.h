@@ -0,0 +1,69 @@
+/**
+ * \file
+ *
+ * \brief CAN bus access for tasks.
+ *
+ */
+
+#ifndef CAN_BUS_H_INCLUDED
+#define CAN_BUS_H_INCLUDED
+
+#include "compiler.h"
+#include "FreeRTOS.h"
+#include "mcan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup can_bus_group CAN bus
+ *
+ * Runs MCAN0 with the settings of conf_can_bus.h and moves frames between
+ * tasks and the controller in batches.
+ *
+ * Receive FIFO 0 takes the bulk of the traffic. The reader is woken when
+ * it holds CONF_CAN_BUS_RX0_WATERMARK frames, or when a frame has waited
+ * CONF_CAN_BUS_RX0_TIMEOUT bit times, so a busy bus costs one interrupt
+ * and one task switch per batch rather than per frame. Filters sending to
+ * FIFO 1 mark urgent frames: every frame arriving there wakes the reader,
+ * and can_bus_receive() hands them out first. Frames that match no filter
+ * go to FIFO 0.
+ *
+ * can_bus_send() queues as many frames as the transmit FIFO takes with one
+ * request, and blocks for the rest.
+ *
+ * The core clock is PCK5 from MAINCK, so the bit timing does not depend on
+ * the clock_scale operating point. The CAN0 pins (CONF_BOARD_CAN0 in
+ * conf_board.h) and a transceiver are needed on the board.
+ *
+ * @{
+ */
+
+/** Bus statistics. */
+typedef struct can_bus_stats {
+	uint32_t ul_rx_frames;
+	uint32_t ul_tx_frames;
+	uint32_t ul_rx_overflows;
+	uint32_t ul_bus_off;
+	/** Transmit and receive error counters. */
+	uint8_t uc_tx_errors;
+	uint8_t uc_rx_errors;
+} can_bus_stats_t;
+
+bool can_bus_init(void);
+bool can_bus_set_filter(bool b_ext, uint32_t ul_index,
+		const mcan_filter_t *p_filter);
+uint32_t can_bus_receive(mcan_frame_t *p_frames, uint32_t ul_max,
+		TickType_t x_timeout);
+uint32_t can_bus_send(const mcan_frame_t *p_frames, uint32_t ul_count,
+		TickType_t x_timeout);
+bool can_bus_get_stats(can_bus_stats_t *p_stats);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAN_BUS_H_INCLUDED */
@@ -0,0 +1,280 @@
+/**
+ * \file
+ *
+ * \brief Runtime clock scaling.
+ *
+ */
+
+#include <asf.h>
+#include "conf_uart_serial.h"
+#include "clock_scale.h"
+
+/**
+ * \addtogroup clock_scale_group
+ *
+ * @{
+ */
+
+/** An operating point. */
+struct clock_scale_point_cfg {
+	const char *p_name;
+	uint32_t ul_source;
+	uint32_t ul_pres;
+	uint32_t ul_mdiv;
+};
+
+static const struct clock_scale_point_cfg gs_points[CLOCK_SCALE_NUM] = {
+#define CLOCK_SCALE_POINT(name, source, pres, mdiv) \
+	{ #name, (source), (pres), (mdiv) },
+	CONF_CLOCK_SCALE_POINTS(CLOCK_SCALE_POINT)
+#undef CLOCK_SCALE_POINT
+};
+
+/** Serializes the switches and the notifier list. */
+static SemaphoreHandle_t gs_x_mutex;
+static struct clock_scale_notifier *gs_p_notifiers;
+
+/* Current point, and its frequencies. */
+static volatile enum clock_scale_point gs_point;
+static volatile uint32_t gs_ul_cpu_hz;
+static volatile uint32_t gs_ul_mck_hz;
+
+/**
+ * \brief Compute the clock frequencies of an operating point.
+ *
+ * \param point Operating point.
+ * \param p_freq Filled with the processor clock and MCK frequencies.
+ */
+void clock_scale_get_freq(enum clock_scale_point point,
+		clock_scale_freq_t *p_freq)
+{
+	const struct clock_scale_point_cfg *p_cfg = &gs_points[point];
+	uint32_t ul_hz;
+
+	if (p_cfg->ul_source == CLOCK_SCALE_SRC_PLLA) {
+		ul_hz = pll_get_default_rate(0);
+	} else {
+		ul_hz = OSC_MAINCK_XTAL_HZ;
+	}
+	if (p_cfg->ul_pres == SYSCLK_PRES_3) {
+		ul_hz /= 3;
+	} else {
+		ul_hz >>= p_cfg->ul_pres >> PMC_MCKR_PRES_Pos;
+	}
+	p_freq->ul_cpu_hz = ul_hz;
+	p_freq->ul_mck_hz = ul_hz / p_cfg->ul_mdiv;
+}
+
+/**
+ * \brief Record the clock the chip was left in by sysclk_init(), the first
+ * operating point.
+ *
+ * \return false if the mutex cannot be created.
+ */
+bool clock_scale_init(void)
+{
+	clock_scale_freq_t freq;
+
+	gs_x_mutex = xSemaphoreCreateMutex();
+	if (!gs_x_mutex) {
+		return false;
+	}
+	clock_scale_get_freq((enum clock_scale_point)0, &freq);
+	gs_point = (enum clock_scale_point)0;
+	gs_ul_cpu_hz = freq.ul_cpu_hz;
+	gs_ul_mck_hz = freq.ul_mck_hz;
+	return true;
+}
+
+/**
+ * \brief Call every notifier.
+ */
+static void clock_scale_notify(enum clock_scale_event event,
+		const clock_scale_freq_t *p_freq)
+{
+	struct clock_scale_notifier *p_notifier;
+
+	for (p_notifier = gs_p_notifiers; p_notifier;
+			p_notifier = p_notifier->p_next) {
+		p_notifier->callback(event, p_freq, p_notifier->p_ctx);
+	}
+}
+
+/**
+ * \brief Move MCK from one operating point to another. PLLA must already be
+ * locked if the new point uses it.
+ *
+ * MDIV is raised before the source or the prescaler change and lowered
+ * after, so that MCK never goes above both its old and its new frequency.
+ *
+ * \retval 0 Success.
+ * \retval 1 Timeout error.
+ */
+static uint32_t clock_scale_switch(const struct clock_scale_point_cfg *p_from,
+		const struct clock_scale_point_cfg *p_to)
+{
+	uint32_t ul_err;
+
+	if (p_to->ul_mdiv > p_from->ul_mdiv) {
+		pmc_mck_set_division(p_to->ul_mdiv);
+	}
+	if (p_to->ul_source == CLOCK_SCALE_SRC_PLLA) {
+		ul_err = pmc_switch_mck_to_pllack(p_to->ul_pres);
+	} else {
+		ul_err = pmc_switch_mck_to_mainck(p_to->ul_pres);
+	}
+	if (p_to->ul_mdiv <= p_from->ul_mdiv) {
+		pmc_mck_set_division(p_to->ul_mdiv);
+	}
+	return ul_err;
+}
+
+/**
+ * \brief Switch to an operating point.
+ *
+ * Must be called from a task. The notifiers run in the calling task, before
+ * and after the switch; the switch itself runs in a critical section.
+ *
+ * \param point Operating point.
+ *
+ * \retval STATUS_OK Switched, or already there.
+ * \retval ERR_INVALID_ARG Unknown operating point.
+ * \retval ERR_TIMEOUT PLLA did not lock or MCK did not settle.
+ */
+status_code_t clock_scale_set(enum clock_scale_point point)
+{
+	const struct clock_scale_point_cfg *p_from;
+	const struct clock_scale_point_cfg *p_to;
+	clock_scale_freq_t freq;
+	status_code_t status = STATUS_OK;
+	uint32_t ul_timeout;
+
+	if (point >= CLOCK_SCALE_NUM) {
+		return ERR_INVALID_ARG;
+	}
+
+	xSemaphoreTake(gs_x_mutex, portMAX_DELAY);
+	if (point == gs_point) {
+		xSemaphoreGive(gs_x_mutex);
+		return STATUS_OK;
+	}
+	p_from = &gs_points[gs_point];
+	p_to = &gs_points[point];
+	clock_scale_get_freq(point, &freq);
+
+	/* Lock PLLA outside the critical section, it takes a while. */
+	if (p_to->ul_source == CLOCK_SCALE_SRC_PLLA && !pll_is_locked(0)) {
+		struct pll_config pllcfg;
+
+		pll_config_defaults(&pllcfg, 0);
+		pll_enable(&pllcfg, 0);
+		if (pll_wait_for_lock(0)) {
+			xSemaphoreGive(gs_x_mutex);
+			return ERR_TIMEOUT;
+		}
+	}
+
+	clock_scale_notify(CLOCK_SCALE_PRE_CHANGE, &freq);
+
+	taskENTER_CRITICAL();
+
+	/* Let the console finish the character it is sending. */
+	for (ul_timeout = CONF_CLOCK_SCALE_TX_TIMEOUT; ul_timeout &&
+			!(usart_get_status((Usart *)CONF_UART) & US_CSR_TXEMPTY);
+			ul_timeout--) {
+	}
+
+	/* Enough wait states for the faster of the two clocks. */
+	if (freq.ul_cpu_hz > gs_ul_cpu_hz) {
+		system_init_flash(freq.ul_cpu_hz);
+	}
+	if (clock_scale_switch(p_from, p_to)) {
+		status = ERR_TIMEOUT;
+	}
+	system_init_flash(freq.ul_cpu_hz);
+	SystemCoreClockUpdate();
+
+	/* Keep the kernel tick rate. */
+	SysTick->LOAD = freq.ul_cpu_hz / configTICK_RATE_HZ - 1;
+	SysTick->VAL = 0;
+
+	usart_set_async_baudrate((Usart *)CONF_UART, CONF_UART_BAUDRATE, freq.ul_mck_hz);
+
+	gs_point = point;
+	gs_ul_cpu_hz = freq.ul_cpu_hz;
+	gs_ul_mck_hz = freq.ul_mck_hz;
+
+	taskEXIT_CRITICAL();
+
+	if (p_to->ul_source != CLOCK_SCALE_SRC_PLLA) {
+		pll_disable(0);
+	}
+
+	clock_scale_notify(CLOCK_SCALE_POST_CHANGE, &freq);
+	xSemaphoreGive(gs_x_mutex);
+
+	return status;
+}
+
+/**
+ * \brief Current operating point.
+ */
+enum clock_scale_point clock_scale_get(void)
+{
+	return gs_point;
+}
+
+/**
+ * \brief Name of an operating point, as given in conf_clock_scale.h.
+ */
+const char *clock_scale_get_name(enum clock_scale_point point)
+{
+	return point < CLOCK_SCALE_NUM ? gs_points[point].p_name : NULL;
+}
+
+/**
+ * \brief Current processor clock frequency, in Hz.
+ */
+uint32_t clock_scale_get_cpu_hz(void)
+{
+	return gs_ul_cpu_hz;
+}
+
+/**
+ * \brief Current MCK frequency, in Hz.
+ */
+uint32_t clock_scale_get_peripheral_hz(void)
+{
+	return gs_ul_mck_hz;
+}
+
+/**
+ * \brief Add a notifier. It must stay valid until unregistered.
+ */
+void clock_scale_register(struct clock_scale_notifier *p_notifier)
+{
+	xSemaphoreTake(gs_x_mutex, portMAX_DELAY);
+	p_notifier->p_next = gs_p_notifiers;
+	gs_p_notifiers = p_notifier;
+	xSemaphoreGive(gs_x_mutex);
+}
+
+/**
+ * \brief Remove a notifier.
+ */
+void clock_scale_unregister(struct clock_scale_notifier *p_notifier)
+{
+	struct clock_scale_notifier **pp_link;
+
+	xSemaphoreTake(gs_x_mutex, portMAX_DELAY);
+	for (pp_link = &gs_p_notifiers; *pp_link;
+			pp_link = &(*pp_link)->p_next) {
+		if (*pp_link == p_notifier) {
+			*pp_link = p_notifier->p_next;
+			break;
+		}
+	}
+	xSemaphoreGive(gs_x_mutex);
+}
+
+/** @} */
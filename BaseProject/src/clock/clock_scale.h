@@ -0,0 +1,97 @@
+/**
+ * \file
+ *
+ * \brief Runtime clock scaling.
+ *
+ */
+
+#ifndef CLOCK_SCALE_H_INCLUDED
+#define CLOCK_SCALE_H_INCLUDED
+
+#include "compiler.h"
+#include "status_codes.h"
+#include "conf_clock_scale.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup clock_scale_group Runtime clock scaling
+ *
+ * Moves the processor clock and MCK between the operating points listed in
+ * conf_clock_scale.h, so that the application can drop to a low clock when
+ * idle and boost it for processing bursts.
+ *
+ * A switch raises the flash wait states before the clocks go up and lowers
+ * them once they are down, starts PLLA when it is needed and stops it when
+ * it is not. It also reloads SysTick so that the kernel tick keeps its rate,
+ * and reprograms the console baud rate. Other drivers whose timing depends
+ * on MCK register a struct clock_scale_notifier. They are called from the
+ * switching task before the clocks change and again after.
+ *
+ * sysclk_get_cpu_hz() and sysclk_get_peripheral_hz() keep returning the
+ * boot point frequencies, use clock_scale_get_cpu_hz() and
+ * clock_scale_get_peripheral_hz() instead.
+ *
+ * @{
+ */
+
+/** Operating point sources. */
+#define CLOCK_SCALE_SRC_MAINCK  PMC_MCKR_CSS_MAIN_CLK
+#define CLOCK_SCALE_SRC_PLLA    PMC_MCKR_CSS_PLLA_CLK
+
+/** Operating points, CLOCK_SCALE_<name> from conf_clock_scale.h. */
+enum clock_scale_point {
+#define CLOCK_SCALE_POINT(name, source, pres, mdiv) CLOCK_SCALE_##name,
+	CONF_CLOCK_SCALE_POINTS(CLOCK_SCALE_POINT)
+#undef CLOCK_SCALE_POINT
+	CLOCK_SCALE_NUM
+};
+
+/** Notification stages. */
+enum clock_scale_event {
+	/** The clocks are about to change. */
+	CLOCK_SCALE_PRE_CHANGE,
+	/** The clocks have changed. */
+	CLOCK_SCALE_POST_CHANGE,
+};
+
+/** Clock frequencies of an operating point. */
+typedef struct clock_scale_freq {
+	uint32_t ul_cpu_hz;
+	uint32_t ul_mck_hz;
+} clock_scale_freq_t;
+
+/**
+ * Notifier callback, given the frequencies of the point being switched to.
+ */
+typedef void (*clock_scale_callback_t)(enum clock_scale_event event,
+		const clock_scale_freq_t *p_freq, void *p_ctx);
+
+/** Caller-owned notifier record. */
+struct clock_scale_notifier {
+	clock_scale_callback_t callback;
+	void *p_ctx;
+	/** Internal list link. */
+	struct clock_scale_notifier *p_next;
+};
+
+bool clock_scale_init(void);
+status_code_t clock_scale_set(enum clock_scale_point point);
+enum clock_scale_point clock_scale_get(void);
+const char *clock_scale_get_name(enum clock_scale_point point);
+void clock_scale_get_freq(enum clock_scale_point point,
+		clock_scale_freq_t *p_freq);
+uint32_t clock_scale_get_cpu_hz(void);
+uint32_t clock_scale_get_peripheral_hz(void);
+void clock_scale_register(struct clock_scale_notifier *p_notifier);
+void clock_scale_unregister(struct clock_scale_notifier *p_notifier);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CLOCK_SCALE_H_INCLUDED */
@@ -88,6 +88,24 @@
 	/* Prevent chip.h being included when this file is included from the IAR
 	port layer assembly file. */
 	#include "board.h"
+
+	/* Stack overflow detection, see conf_stack_guard.h. */
+	#include "conf_stack_guard.h"
+	#if CONF_STACK_GUARD
+		#include "stack_guard.h"
+	#endif
+
+	/* Kernel fast paths in the ITCM and kernel state in the DTCM, see
+	conf_tcm.h and flash.ld. They are placed by section attribute rather
+	than by object file, which the linker no longer sees with -flto. Every
+	PRIVILEGED_DATA object is zero-initialised, as .dtcm_bss requires. */
+	#include "conf_tcm.h"
+	#if CONF_TCM
+		#include "compiler.h"
+		#define configFAST_FUNCTION					ITCM_FUNC
+		#define configFAST_DATA						DTCM_DATA
+		#define PRIVILEGED_DATA						DTCM_BSS
+	#endif
 #endif
 
 #define configUSE_PREEMPTION					1
@@ -106,7 +124,13 @@
 #define configIDLE_SHOULD_YIELD					1
 #define configUSE_MUTEXES						1
 #define configQUEUE_REGISTRY_SIZE				8
-#define configCHECK_FOR_STACK_OVERFLOW			2
+#if CONF_STACK_GUARD
+	/* The MPU guard band follows the incoming task instead. */
+	#define configCHECK_FOR_STACK_OVERFLOW		0
+	#define traceTASK_SWITCHED_IN()				stack_guard_switch_in( pxCurrentTCB->pxStack )
+#else
+	#define configCHECK_FOR_STACK_OVERFLOW		2
+#endif
 #define configUSE_RECURSIVE_MUTEXES				1
 #define configUSE_MALLOC_FAILED_HOOK			1
 #define configUSE_APPLICATION_TASK_TAG			0
@@ -147,6 +171,8 @@ to exclude the API function. */
 #define INCLUDE_vTaskDelay				1
 #define INCLUDE_eTaskGetState			1
 #define INCLUDE_xTimerPendFunctionCall	1
+#define INCLUDE_pcTaskGetTaskName		1
+#define INCLUDE_xTaskGetCurrentTaskHandle	1
 
 /* Cortex-M specific definitions. */
 #ifdef __NVIC_PRIO_BITS
@@ -0,0 +1,31 @@
+/**
+ * \file
+ *
+ * \brief AFEC streaming configuration.
+ *
+ */
+
+#ifndef CONF_ADC_STREAM_H_INCLUDED
+#define CONF_ADC_STREAM_H_INCLUDED
+
+/**
+ * Number of sample blocks in the ring, 2 for ping-pong buffering. The host
+ * tests take more, to fill several between two interrupts.
+ */
+#ifndef CONF_ADC_STREAM_BLOCKS
+#  define CONF_ADC_STREAM_BLOCKS        2
+#endif
+
+/**
+ * Samples per block, all channels together, a multiple of 8 so that
+ * blocks are whole cache lines.
+ */
+#define CONF_ADC_STREAM_BLOCK_SIZE      512
+
+/** AFE clock, at most AFEC_CLOCK_MAX. */
+#define CONF_ADC_STREAM_AFEC_CLOCK      40000000UL
+
+/** TC0 channel whose TIOA triggers the sequences. */
+#define CONF_ADC_STREAM_TC_CHANNEL      0
+
+#endif /* CONF_ADC_STREAM_H_INCLUDED */
@@ -0,0 +1,35 @@
+/**
+ * \file
+ *
+ * \brief Benchmark configuration.
+ *
+ */
+
+#ifndef CONF_BENCH_H_INCLUDED
+#define CONF_BENCH_H_INCLUDED
+
+/** Timed rounds of each benchmark, the fastest one is reported. */
+#define CONF_BENCH_ROUNDS        8
+
+/** Operations per round of the kernel benchmarks. */
+#define CONF_BENCH_KERNEL_OPS    100
+
+/** Samples per round of the filter benchmarks. */
+#define CONF_BENCH_BLOCK_SIZE    256
+
+/** FIR taps. */
+#define CONF_BENCH_FIR_TAPS      32
+
+/** Biquad sections. */
+#define CONF_BENCH_BIQUAD_STAGES 4
+
+/** Real FFT length, 32 to 4096. */
+#define CONF_BENCH_FFT_LEN       1024
+
+/** Lines per round of the formatter benchmark. */
+#define CONF_BENCH_FMT_LINES     32
+
+/** Bytes per round of the console ring fill, at most the transmit ring. */
+#define CONF_BENCH_CONSOLE_BYTES 256
+
+#endif /* CONF_BENCH_H_INCLUDED */
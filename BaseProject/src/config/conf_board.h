@@ -50,7 +50,20 @@
 /* Enable ICache and DCache */
 #define CONF_BOARD_ENABLE_CACHE_AT_INIT
 
+/* Enable 32 Kbytes of ITCM and DTCM, loaded from the linker script TCM sections */
+#define CONF_BOARD_ENABLE_TCM_AT_INIT
+
+/* Write all the PIO properties of the pin map, also those at their reset
+ * value, when a bootloader may have configured the pins */
+/* #define CONF_BOARD_PIO_WRITE_ALL */
+
 /* Configure UART pins */
 #define CONF_BOARD_UART_CONSOLE
 
+/* Drive LED0 from the PWM */
+#define CONF_BOARD_PWM_LED0
+
+/* Configure QSPI pins, for the serial flash */
+#define CONF_BOARD_QSPI
+
 #endif /* CONF_BOARD_H_INCLUDED */
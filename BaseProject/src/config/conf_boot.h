@@ -0,0 +1,25 @@
+/**
+ * \file
+ *
+ * \brief Boot profiler and fast boot configuration.
+ *
+ */
+
+#ifndef CONF_BOOT_H_INCLUDED
+#define CONF_BOOT_H_INCLUDED
+
+/** Record a cycle counter stamp at the end of each boot phase. */
+#define CONF_BOOT_PROFILE       1
+
+/**
+ * Fast boot: start the main crystal first thing in Reset_Handler, copy and
+ * clear the RAM sections four words at a time, and run board_init() while
+ * the crystal settles, before sysclk_init(). Needs a clock tree fed by the
+ * main crystal.
+ */
+#define CONF_BOOT_FAST          1
+
+/** Most phase stamps recorded. */
+#define CONF_BOOT_MAX_STAMPS    12
+
+#endif /* CONF_BOOT_H_INCLUDED */
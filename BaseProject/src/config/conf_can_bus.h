@@ -0,0 +1,44 @@
+/**
+ * \file
+ *
+ * \brief CAN bus configuration.
+ *
+ */
+
+#ifndef CONF_CAN_BUS_H_INCLUDED
+#define CONF_CAN_BUS_H_INCLUDED
+
+/** Nominal bit rate, and data phase bit rate in CAN FD with BRS. */
+#define CONF_CAN_BUS_BITRATE            500000UL
+#define CONF_CAN_BUS_DATA_BITRATE       2000000UL
+
+/** Transmit format, an mcan_mode_t. */
+#define CONF_CAN_BUS_MODE               MCAN_MODE_FD_BRS
+
+/** Payload room of the message RAM elements, 8 to 64 bytes. */
+#define CONF_CAN_BUS_DATA_SIZE          64
+
+/** Filter list sizes. */
+#define CONF_CAN_BUS_STD_FILTERS        8
+#define CONF_CAN_BUS_EXT_FILTERS        4
+
+/**
+ * Receive FIFO 0, for the bulk traffic: its size, the fill level that wakes
+ * the reader, and the longest a frame waits below that level, in bit times.
+ */
+#define CONF_CAN_BUS_RX0_SIZE           16
+#define CONF_CAN_BUS_RX0_WATERMARK      8
+#define CONF_CAN_BUS_RX0_TIMEOUT        2000
+
+/** Receive FIFO 1, for urgent frames, which wake the reader one by one. */
+#define CONF_CAN_BUS_RX1_SIZE           4
+
+/** Transmit FIFO size. */
+#define CONF_CAN_BUS_TX_SIZE            8
+
+/** Core clock (PCK5) prescaler from MAINCK, which runs at 12 MHz. */
+#define CONF_CAN_BUS_PCK_PRES           0
+
+#define CONF_CAN_BUS_IRQ_PRIORITY       5
+
+#endif /* CONF_CAN_BUS_H_INCLUDED */
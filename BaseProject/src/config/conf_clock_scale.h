@@ -0,0 +1,37 @@
+/**
+ * \file
+ *
+ * \brief Runtime clock scaling configuration.
+ *
+ */
+
+#ifndef CONF_CLOCK_SCALE_H_INCLUDED
+#define CONF_CLOCK_SCALE_H_INCLUDED
+
+/**
+ * Operating points: CLOCK_SCALE_POINT(name, source, prescaler, mck_div).
+ *
+ * - source is CLOCK_SCALE_SRC_PLLA (PLLA as set up by conf_clock.h) or
+ *   CLOCK_SCALE_SRC_MAINCK (the main crystal);
+ * - prescaler is a SYSCLK_PRES_* value, giving the processor clock;
+ * - mck_div (1 to 4) divides the processor clock into MCK, which must not
+ *   exceed 150 MHz.
+ *
+ * The first point must match conf_clock.h: it is the one sysclk_init()
+ * leaves the chip in.
+ */
+#define CONF_CLOCK_SCALE_POINTS(CLOCK_SCALE_POINT) \
+	/* 300 MHz core, 150 MHz MCK */ \
+	CLOCK_SCALE_POINT(boost, CLOCK_SCALE_SRC_PLLA, SYSCLK_PRES_1, 2) \
+	/* 150 MHz core, 75 MHz MCK */ \
+	CLOCK_SCALE_POINT(normal, CLOCK_SCALE_SRC_PLLA, SYSCLK_PRES_2, 2) \
+	/* 12 MHz core and MCK, PLLA off */ \
+	CLOCK_SCALE_POINT(low, CLOCK_SCALE_SRC_MAINCK, SYSCLK_PRES_1, 1)
+
+/**
+ * Longest wait, in loop iterations, for the console USART to finish the
+ * character it is sending before its clock changes.
+ */
+#define CONF_CLOCK_SCALE_TX_TIMEOUT     100000
+
+#endif /* CONF_CLOCK_SCALE_H_INCLUDED */
@@ -0,0 +1,47 @@
+/**
+ * \file
+ *
+ * \brief Interrupt-driven console configuration.
+ *
+ */
+
+#ifndef CONF_CONSOLE_H_INCLUDED
+#define CONF_CONSOLE_H_INCLUDED
+
+/** Interrupt line and handler of the console USART (CONF_UART). */
+#define CONF_CONSOLE_IRQn               USART1_IRQn
+#define CONF_CONSOLE_Handler            USART1_Handler
+
+/**
+ * Console interrupt priority. It must not be more urgent (numerically
+ * lower) than configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY.
+ */
+#define CONF_CONSOLE_IRQ_PRIORITY       6
+
+/**
+ * Also serve the console on the USB serial port (\ref usb_cdc_group),
+ * which takes the output over from the USART while the host has it open.
+ * The host tests run the USART alone.
+ */
+#ifndef CONF_CONSOLE_USB
+#  define CONF_CONSOLE_USB              1
+#endif
+
+/**
+ * Transmit ring size in bytes, power of two. The host tests use a smaller
+ * one, to fill it quickly.
+ */
+#ifndef CONF_CONSOLE_TX_BUFFER_SIZE
+#  define CONF_CONSOLE_TX_BUFFER_SIZE   2048
+#endif
+
+/** Receive ring size in bytes, power of two. */
+#define CONF_CONSOLE_RX_BUFFER_SIZE     128
+
+/**
+ * Stack buffer used by console_printf(). Output is handed to the transmit
+ * ring each time it fills up.
+ */
+#define CONF_CONSOLE_PRINTF_CHUNK       64
+
+#endif /* CONF_CONSOLE_H_INCLUDED */
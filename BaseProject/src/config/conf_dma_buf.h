@@ -0,0 +1,20 @@
+/**
+ * \file
+ *
+ * \brief DMA buffer allocator configuration.
+ *
+ */
+
+#ifndef CONF_DMA_BUF_H_INCLUDED
+#define CONF_DMA_BUF_H_INCLUDED
+
+/**
+ * Size of the non-cacheable pool in bytes. A power of two from 256 up, as
+ * the pool is covered by a single MPU region.
+ */
+#define CONF_DMA_BUF_NOCACHE_SIZE     0x2000
+
+/** MPU region of the pool, the board MPU_NOCACHE_SRAM_REGION slot. */
+#define CONF_DMA_BUF_MPU_REGION       11
+
+#endif /* CONF_DMA_BUF_H_INCLUDED */
@@ -0,0 +1,30 @@
+/**
+ * \file
+ *
+ * \brief DSP pipeline configuration.
+ *
+ */
+
+#ifndef CONF_DSP_H_INCLUDED
+#define CONF_DSP_H_INCLUDED
+
+/** Capacity of a block in samples. */
+#define CONF_DSP_BLOCK_SIZE             256
+
+/** Blocks in the pool shared by all the pipelines. */
+#define CONF_DSP_POOL_BLOCKS            8
+
+/** Most pipelines listed by dsp_pipe_get() and the shell. */
+#define CONF_DSP_MAX_PIPES              4
+
+/**
+ * Build the portable C kernels of dsp_ref.c instead of linking the
+ * CMSIS-DSP library, for a build on a development host. Leave to 0 on the
+ * target, where they would clash with the library; the host tests set it
+ * on their command line.
+ */
+#ifndef CONF_DSP_REF_KERNELS
+#  define CONF_DSP_REF_KERNELS          0
+#endif
+
+#endif /* CONF_DSP_H_INCLUDED */
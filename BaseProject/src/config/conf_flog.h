@@ -0,0 +1,42 @@
+/**
+ * \file
+ *
+ * \brief Flash log store configuration.
+ *
+ */
+
+#ifndef CONF_FLOG_H_INCLUDED
+#define CONF_FLOG_H_INCLUDED
+
+/**
+ * Internal flash area of the store, aligned on its size, a power of two:
+ * the MPU maps it writable. The linker script keeps the code out of it.
+ * The host tests move it to their flash emulator.
+ */
+#ifndef CONF_FLOG_ADDR
+#  define CONF_FLOG_ADDR                0x005E0000
+#endif
+#define CONF_FLOG_SIZE                  0x20000
+
+/** MPU region of the store area, apart from the stack guard one. */
+#define CONF_FLOG_MPU_REGION            13
+
+/** Erase block in pages: 16 or 32 (8 or 16 Kbytes). */
+#define CONF_FLOG_BLOCK_PAGES           16
+
+/** Keys, 1 to CONF_FLOG_KEYS - 1. The RAM index has one word per key. */
+#define CONF_FLOG_KEYS                  64
+
+/**
+ * The background task compacts the oldest block while fewer blocks than
+ * this are free. The oldest events go with it.
+ */
+#define CONF_FLOG_GC_FREE               4
+
+/** Longest time records wait in RAM for their page to be written, in ms. */
+#define CONF_FLOG_SYNC_MS               1000
+
+#define CONF_FLOG_TASK_PRIORITY         (tskIDLE_PRIORITY + 1)
+#define CONF_FLOG_TASK_STACK_SIZE       (512/sizeof(portSTACK_TYPE))
+
+#endif /* CONF_FLOG_H_INCLUDED */
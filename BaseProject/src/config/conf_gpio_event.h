@@ -0,0 +1,29 @@
+/**
+ * \file
+ *
+ * \brief GPIO event pipeline configuration.
+ *
+ */
+
+#ifndef CONF_GPIO_EVENT_H_INCLUDED
+#define CONF_GPIO_EVENT_H_INCLUDED
+
+/** Maximum number of pins registered at the same time. */
+#define CONF_GPIO_EVENT_MAX_PINS        8
+
+/** Event ring size in events, power of two. */
+#define CONF_GPIO_EVENT_RING_SIZE       256
+
+/**
+ * Interrupt priority given to every PIO controller with a registered pin.
+ * All PIO interrupts must share it, as the ring has a single producer, and
+ * it must not be more urgent (numerically lower) than
+ * configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY.
+ */
+#define CONF_GPIO_EVENT_IRQ_PRIORITY    5
+
+/** Consumer task stack size and priority. */
+#define CONF_GPIO_EVENT_STACK_SIZE      (1024/sizeof(portSTACK_TYPE))
+#define CONF_GPIO_EVENT_TASK_PRIORITY   (tskIDLE_PRIORITY + 2)
+
+#endif /* CONF_GPIO_EVENT_H_INCLUDED */
@@ -0,0 +1,41 @@
+/**
+ * \file
+ *
+ * \brief LED pattern engine configuration.
+ *
+ */
+
+#ifndef CONF_LED_PATTERN_H_INCLUDED
+#define CONF_LED_PATTERN_H_INCLUDED
+
+/** PWM controller driving the CONF_BOARD_PWM_LEDx pins. */
+#define CONF_LED_PATTERN_PWM            PWM0
+#define CONF_LED_PATTERN_PWM_ID         ID_PWM0
+#define CONF_LED_PATTERN_PWM_IRQn       PWM0_IRQn
+#define CONF_LED_PATTERN_PWM_Handler    PWM0_Handler
+
+/**
+ * PWM interrupt priority. The handler only writes PWM registers, so the
+ * least urgent level is enough.
+ */
+#define CONF_LED_PATTERN_IRQ_PRIORITY   7
+
+/**
+ * Channel polarity: the LEDs of the board light when their pin is low, so
+ * the duty cycle part of the period has to be the low one.
+ */
+#define CONF_LED_PATTERN_POLARITY       PWM_HIGH
+
+/** Dimming carrier frequency, in Hz. */
+#define CONF_LED_PATTERN_PWM_HZ         1000
+
+/**
+ * Rate at which step programs advance, in Hz. Must divide
+ * CONF_LED_PATTERN_PWM_HZ.
+ */
+#define CONF_LED_PATTERN_STEP_HZ        100
+
+/** Longest blink code. */
+#define CONF_LED_PATTERN_CODE_MAX       8
+
+#endif /* CONF_LED_PATTERN_H_INCLUDED */
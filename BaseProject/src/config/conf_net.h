@@ -0,0 +1,43 @@
+/**
+ * \file
+ *
+ * \brief Ethernet interface configuration.
+ *
+ */
+
+#ifndef CONF_NET_H_INCLUDED
+#define CONF_NET_H_INCLUDED
+
+/**
+ * Frame buffers in the pool. The receive ring holds CONF_NET_RX_DESC of
+ * them at all times, the rest are for the stack and the transmit ring.
+ */
+#define CONF_NET_BUF_COUNT              32
+
+/** Descriptor ring sizes. */
+#define CONF_NET_RX_DESC                16
+#define CONF_NET_TX_DESC                16
+
+/** Most buffers in one transmitted frame. */
+#define CONF_NET_TX_SEGS_MAX            4
+
+/**
+ * Most frames handled per receive poll before the task lets others of its
+ * priority run. The receive interrupt stays off while frames keep coming.
+ */
+#define CONF_NET_RX_BUDGET              8
+
+/** Station address. */
+#define CONF_NET_MAC_ADDR               {0x02, 0x00, 0x00, 0x71, 0x00, 0x01}
+
+/** Period of the link state check, in ms. */
+#define CONF_NET_LINK_POLL_MS           500
+
+/** Internal MAC loopback, for testing without a cable. */
+#define CONF_NET_LOOPBACK               0
+
+#define CONF_NET_TASK_PRIORITY          (tskIDLE_PRIORITY + 3)
+#define CONF_NET_TASK_STACK_SIZE        (1024/sizeof(portSTACK_TYPE))
+#define CONF_NET_IRQ_PRIORITY           5
+
+#endif /* CONF_NET_H_INCLUDED */
@@ -0,0 +1,17 @@
+/**
+ * \file
+ *
+ * \brief PIO parallel capture configuration.
+ *
+ */
+
+#ifndef CONF_PARCAP_H_INCLUDED
+#define CONF_PARCAP_H_INCLUDED
+
+/** Number of capture blocks in the ring, at least 3. */
+#define CONF_PARCAP_BLOCKS              4
+
+/** Size of a capture block in bytes, a multiple of the cache line size. */
+#define CONF_PARCAP_BLOCK_SIZE          4096
+
+#endif /* CONF_PARCAP_H_INCLUDED */
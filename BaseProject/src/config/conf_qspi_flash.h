@@ -0,0 +1,35 @@
+/**
+ * \file
+ *
+ * \brief QSPI serial flash configuration.
+ *
+ */
+
+#ifndef CONF_QSPI_FLASH_H_INCLUDED
+#define CONF_QSPI_FLASH_H_INCLUDED
+
+/** Flash size in bytes, a power of two: 2 Mbytes, the board S25FL116K. */
+#define CONF_QSPI_FLASH_SIZE            0x200000
+
+/** Highest serial clock frequency, the QSPI one at any operating point. */
+#define CONF_QSPI_FLASH_HZ              66000000
+
+/**
+ * MPU region of the cached mapping of the flash, over the board strongly
+ * ordered QSPI region. Above the stack guard and flash log ones.
+ */
+#define CONF_QSPI_FLASH_MPU_REGION      14
+
+/** Map the flash cached at start (1), or leave the board mapping (0). */
+#define CONF_QSPI_FLASH_CACHED          1
+
+/** Let code run from the cached mapping (1), or make it execute-never (0). */
+#define CONF_QSPI_FLASH_XIP             0
+
+/** Shortest read done by the DMA, shorter ones are copied by the CPU. */
+#define CONF_QSPI_FLASH_DMA_MIN         256
+
+/** Longest wait for a DMA read, in ms. */
+#define CONF_QSPI_FLASH_DMA_TIMEOUT_MS  100
+
+#endif /* CONF_QSPI_FLASH_H_INCLUDED */
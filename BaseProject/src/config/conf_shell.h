@@ -0,0 +1,26 @@
+/**
+ * \file
+ *
+ * \brief Console shell configuration.
+ *
+ */
+
+#ifndef CONF_SHELL_H_INCLUDED
+#define CONF_SHELL_H_INCLUDED
+
+/** Longest command line, terminating NUL excluded. */
+#define CONF_SHELL_LINE_SIZE       80
+
+/** Most arguments passed to a command, its name included. */
+#define CONF_SHELL_MAX_ARGS        8
+
+/** Prompt printed before each command line. */
+#define CONF_SHELL_PROMPT          "> "
+
+/** Buffer for the task list of the "tasks" command (about 40 bytes/task). */
+#define CONF_SHELL_TASKS_BUF_SIZE  512
+
+/** Flash bytes read in each mode by "qspi bench", from address 0. */
+#define CONF_SHELL_QSPI_BENCH_SIZE 16384
+
+#endif /* CONF_SHELL_H_INCLUDED */
@@ -0,0 +1,32 @@
+/**
+ * \file
+ *
+ * \brief Task stack guard configuration.
+ *
+ */
+
+#ifndef CONF_STACK_GUARD_H_INCLUDED
+#define CONF_STACK_GUARD_H_INCLUDED
+
+/**
+ * Detect task stack overflows with an MPU guard band below the running
+ * task's stack (1), or with the fill pattern the kernel checks on every
+ * context switch, configCHECK_FOR_STACK_OVERFLOW 2 (0).
+ */
+#define CONF_STACK_GUARD                1
+
+/**
+ * Guard band size in bytes, a power of two from 32. A function whose frame
+ * is larger than the band moves the stack pointer past it and writes below
+ * it without faulting, so size the band from the largest frame of the
+ * tasks (-fstack-usage). Every task stack must be larger than twice the
+ * band.
+ */
+#ifndef CONF_STACK_GUARD_SIZE
+#  define CONF_STACK_GUARD_SIZE         32
+#endif
+
+/** MPU region of the guard band. */
+#define CONF_STACK_GUARD_MPU_REGION     12
+
+#endif /* CONF_STACK_GUARD_H_INCLUDED */
@@ -0,0 +1,19 @@
+/**
+ * \file
+ *
+ * \brief Kernel TCM placement configuration.
+ *
+ */
+
+#ifndef CONF_TCM_H_INCLUDED
+#define CONF_TCM_H_INCLUDED
+
+/**
+ * Run the kernel fast paths from the ITCM and keep the kernel state in the
+ * DTCM (1), or leave them in flash and SRAM (0), to compare both with the
+ * kernel items of the benchmark. The TCMs must be enabled at init,
+ * CONF_BOARD_ENABLE_TCM_AT_INIT.
+ */
+#define CONF_TCM                        1
+
+#endif /* CONF_TCM_H_INCLUDED */
@@ -0,0 +1,20 @@
+/**
+ * \file
+ *
+ * \brief Binary telemetry configuration.
+ *
+ */
+
+#ifndef CONF_TELEMETRY_H_INCLUDED
+#define CONF_TELEMETRY_H_INCLUDED
+
+/** Largest record payload in bytes. Frames are built on the caller stack. */
+#define CONF_TLM_MAX_PAYLOAD          128
+
+/**
+ * Payload size from which frames are protected by CRC-32 instead of
+ * CRC-16. Set it above CONF_TLM_MAX_PAYLOAD to always use CRC-16.
+ */
+#define CONF_TLM_CRC32_THRESHOLD      64
+
+#endif /* CONF_TELEMETRY_H_INCLUDED */
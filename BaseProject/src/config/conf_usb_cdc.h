@@ -0,0 +1,39 @@
+/**
+ * \file
+ *
+ * \brief USB CDC serial port configuration.
+ *
+ */
+
+#ifndef CONF_USB_CDC_H_INCLUDED
+#define CONF_USB_CDC_H_INCLUDED
+
+/** Device identification. */
+#define CONF_USB_CDC_VID                0x03EB
+#define CONF_USB_CDC_PID                0x2404
+#define CONF_USB_CDC_MANUFACTURER       "Atmel"
+#define CONF_USB_CDC_PRODUCT            "SAMV71 console"
+#define CONF_USB_CDC_SERIAL             "0001"
+
+/** Run at high speed (480 Mbit/s) when the host can, else full speed. */
+#define CONF_USB_CDC_HIGH_SPEED         1
+
+/**
+ * Banks of the data endpoints, 2 or 3: the DMA fills one while the others
+ * are on the bus.
+ */
+#define CONF_USB_CDC_BANKS              2
+
+/**
+ * Receive buffer, a multiple of the high speed packet size. The host is
+ * held off (NAK) while it is full.
+ */
+#define CONF_USB_CDC_RX_SIZE            512
+
+/**
+ * USBHS interrupt priority. It must not be more urgent (numerically lower)
+ * than configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY.
+ */
+#define CONF_USB_CDC_IRQ_PRIORITY       6
+
+#endif /* CONF_USB_CDC_H_INCLUDED */
@@ -0,0 +1,18 @@
+/**
+ * \file
+ *
+ * \brief XDMAC driver configuration.
+ *
+ */
+
+#ifndef CONF_XDMAC_H_INCLUDED
+#define CONF_XDMAC_H_INCLUDED
+
+/**
+ * XDMAC interrupt priority, shared by every channel. Channel callbacks may
+ * use the FreeRTOS FromISR API, so it must not be more urgent (numerically
+ * lower) than configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY.
+ */
+#define CONF_XDMAC_IRQ_PRIORITY         5
+
+#endif /* CONF_XDMAC_H_INCLUDED */
@@ -0,0 +1,669 @@
+/**
+ * \file
+ *
+ * \brief Interrupt-driven console USART backend.
+ *
+ */
+
+#include <asf.h>
+#include <string.h>
+#include "conf_console.h"
+#include "console.h"
+#include "fmt.h"
+#if CONF_CONSOLE_USB
+#  include "usb_cdc.h"
+#endif
+
+/**
+ * \addtogroup console_group
+ *
+ * @{
+ */
+
+#if (CONF_CONSOLE_TX_BUFFER_SIZE & (CONF_CONSOLE_TX_BUFFER_SIZE - 1))
+#  error CONF_CONSOLE_TX_BUFFER_SIZE must be a power of two
+#endif
+#if (CONF_CONSOLE_RX_BUFFER_SIZE & (CONF_CONSOLE_RX_BUFFER_SIZE - 1))
+#  error CONF_CONSOLE_RX_BUFFER_SIZE must be a power of two
+#endif
+
+#define TX_MASK    (CONF_CONSOLE_TX_BUFFER_SIZE - 1)
+#define RX_MASK    (CONF_CONSOLE_RX_BUFFER_SIZE - 1)
+
+/* Transmit ring. Head is advanced by writers, tail by the drain side. */
+static uint8_t gs_tx_buf[CONF_CONSOLE_TX_BUFFER_SIZE];
+static volatile uint32_t gs_ul_tx_head;
+static volatile uint32_t gs_ul_tx_tail;
+
+/* Receive ring. Head is advanced by the interrupt, tail by the reader. */
+static uint8_t gs_rx_buf[CONF_CONSOLE_RX_BUFFER_SIZE];
+static volatile uint32_t gs_ul_rx_head;
+static volatile uint32_t gs_ul_rx_tail;
+
+static console_stats_t gs_stats;
+
+/* Task notified when bytes are received, if any. */
+static TaskHandle_t gs_x_rx_task;
+
+/* Writers waiting for room in the transmit ring, given room by the drain. */
+static SemaphoreHandle_t gs_x_tx_room;
+static volatile uint32_t gs_ul_tx_waiters;
+
+/* The USART interrupt leaves the transmit ring to console_tx_poll(). */
+static volatile bool gs_b_tx_hold;
+
+#if CONF_CONSOLE_USB
+/* The USB port is open and drains the transmit ring instead of the USART. */
+static volatile bool gs_b_usb;
+/* Bytes at the ring tail being sent over USB, 0 if none. */
+static uint32_t gs_ul_usb_tx_len;
+/* Received USB bytes that did not fit in the receive ring yet. */
+static const uint8_t *gs_p_usb_rx;
+static uint32_t gs_ul_usb_rx_len;
+#endif
+
+/**
+ * \brief Wake a writer waiting for room once half the transmit ring is
+ * free, so that it refills the ring in large copies.
+ *
+ * \note Must run with the console interrupt masked or from an interrupt.
+ */
+static void console_tx_wake(BaseType_t *p_woken)
+{
+	if (gs_ul_tx_waiters &&
+			console_tx_free() >= CONF_CONSOLE_TX_BUFFER_SIZE / 2) {
+		xSemaphoreGiveFromISR(gs_x_tx_room, p_woken);
+	}
+}
+
+/**
+ * \brief Move bytes from the transmit ring to the USART while it can accept
+ * them, and stop the TXRDY interrupt once the ring is empty.
+ *
+ * \param p_woken Set to pdTRUE if a waiting writer was woken.
+ *
+ * \note Must run with the console interrupt masked or from the handler.
+ */
+static void console_tx_drain(BaseType_t *p_woken)
+{
+	Usart *p_usart = (Usart *)CONF_UART;
+	uint32_t ul_tail = gs_ul_tx_tail;
+
+#if CONF_CONSOLE_USB
+	if (gs_b_usb) {
+		/* The tail belongs to USB. */
+		return;
+	}
+#endif
+	while (ul_tail != gs_ul_tx_head && (p_usart->US_CSR & US_CSR_TXRDY)) {
+		p_usart->US_THR = US_THR_TXCHR(gs_tx_buf[ul_tail & TX_MASK]);
+		ul_tail++;
+		gs_stats.ul_tx_bytes++;
+	}
+	gs_ul_tx_tail = ul_tail;
+	console_tx_wake(p_woken);
+
+	if (ul_tail == gs_ul_tx_head) {
+		usart_disable_interrupt(p_usart, US_IDR_TXRDY);
+	}
+}
+
+#if CONF_CONSOLE_USB
+/**
+ * \brief Send the bytes at the ring tail over USB, as much as is contiguous,
+ * unless a write is in progress.
+ *
+ * \note Must run with the console interrupt masked or from the USB
+ * interrupt.
+ */
+static void console_usb_tx_start(void)
+{
+	uint32_t ul_tail = gs_ul_tx_tail;
+	uint32_t ul_len = gs_ul_tx_head - ul_tail;
+	uint32_t ul_first = CONF_CONSOLE_TX_BUFFER_SIZE - (ul_tail & TX_MASK);
+
+	if (!gs_b_usb || gs_ul_usb_tx_len || !ul_len) {
+		return;
+	}
+	if (ul_len > ul_first) {
+		ul_len = ul_first;
+	}
+	/* The bytes stay in the ring, the tail moves once they are sent. */
+	if (usb_cdc_write(&gs_tx_buf[ul_tail & TX_MASK], ul_len)) {
+		gs_ul_usb_tx_len = ul_len;
+	}
+}
+
+/**
+ * \brief Move pending USB bytes to the receive ring, and give the USB
+ * receive buffer back once they all are.
+ *
+ * \note Must run with the console interrupt masked or from the USB
+ * interrupt.
+ */
+static void console_usb_rx_push(void)
+{
+	uint32_t ul_head = gs_ul_rx_head;
+
+	while (gs_ul_usb_rx_len &&
+			ul_head - gs_ul_rx_tail < CONF_CONSOLE_RX_BUFFER_SIZE) {
+		gs_rx_buf[ul_head & RX_MASK] = *gs_p_usb_rx++;
+		ul_head++;
+		gs_ul_usb_rx_len--;
+		gs_stats.ul_rx_bytes++;
+	}
+	gs_ul_rx_head = ul_head;
+	if (gs_p_usb_rx && !gs_ul_usb_rx_len) {
+		gs_p_usb_rx = NULL;
+		usb_cdc_rx_release();
+	}
+}
+
+/**
+ * \brief USB serial port events, from the USB interrupt.
+ */
+static void console_usb_event(usb_cdc_event_t event, const uint8_t *p_data,
+		uint32_t ul_len, void *p_ctx)
+{
+	BaseType_t x_woken = pdFALSE;
+
+	UNUSED(p_ctx);
+
+	switch (event) {
+	case USB_CDC_OPEN:
+		/* The USART finishes its byte, USB takes the rest. */
+		usart_disable_interrupt((Usart *)CONF_UART, US_IDR_TXRDY);
+		gs_b_usb = true;
+		console_usb_tx_start();
+		break;
+	case USB_CDC_CLOSE:
+		gs_b_usb = false;
+		gs_ul_tx_tail += gs_ul_usb_tx_len;
+		gs_stats.ul_tx_dropped += gs_ul_usb_tx_len;
+		gs_ul_usb_tx_len = 0;
+		gs_p_usb_rx = NULL;
+		gs_ul_usb_rx_len = 0;
+		console_tx_wake(&x_woken);
+		if (gs_ul_tx_tail != gs_ul_tx_head && !gs_b_tx_hold) {
+			usart_enable_interrupt((Usart *)CONF_UART, US_IER_TXRDY);
+		}
+		break;
+	case USB_CDC_TX_DONE:
+		gs_ul_tx_tail += gs_ul_usb_tx_len;
+		gs_stats.ul_tx_bytes += ul_len;
+		gs_ul_usb_tx_len = 0;
+		console_tx_wake(&x_woken);
+		console_usb_tx_start();
+		break;
+	case USB_CDC_RX:
+		gs_p_usb_rx = p_data;
+		gs_ul_usb_rx_len = ul_len;
+		console_usb_rx_push();
+		if (gs_x_rx_task) {
+			vTaskNotifyGiveFromISR(gs_x_rx_task, &x_woken);
+		}
+		break;
+	}
+
+	portEND_SWITCHING_ISR(x_woken);
+}
+#endif
+
+/**
+ * \brief Copy up to \a ul_len bytes into the transmit ring.
+ *
+ * \param p_data Bytes to queue.
+ * \param ul_len Number of bytes.
+ * \param b_all_or_nothing Queue nothing unless every byte fits.
+ *
+ * \return Number of bytes queued.
+ */
+static size_t console_tx_enqueue(const uint8_t *p_data, size_t ul_len,
+		bool b_all_or_nothing)
+{
+	UBaseType_t ux_mask;
+	uint32_t ul_head;
+	size_t ul_free;
+	size_t ul_first;
+
+	ux_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+
+	ul_head = gs_ul_tx_head;
+	ul_free = CONF_CONSOLE_TX_BUFFER_SIZE - (ul_head - gs_ul_tx_tail);
+	if (ul_len > ul_free) {
+		if (b_all_or_nothing) {
+			portCLEAR_INTERRUPT_MASK_FROM_ISR(ux_mask);
+			return 0;
+		}
+		ul_len = ul_free;
+	}
+
+	ul_first = CONF_CONSOLE_TX_BUFFER_SIZE - (ul_head & TX_MASK);
+	if (ul_first > ul_len) {
+		ul_first = ul_len;
+	}
+	memcpy(&gs_tx_buf[ul_head & TX_MASK], p_data, ul_first);
+	memcpy(gs_tx_buf, p_data + ul_first, ul_len - ul_first);
+	gs_ul_tx_head = ul_head + ul_len;
+
+	if (ul_len) {
+#if CONF_CONSOLE_USB
+		if (gs_b_usb) {
+			console_usb_tx_start();
+		} else if (!gs_b_tx_hold) {
+			usart_enable_interrupt((Usart *)CONF_UART, US_IER_TXRDY);
+		}
+#else
+		if (!gs_b_tx_hold) {
+			usart_enable_interrupt((Usart *)CONF_UART, US_IER_TXRDY);
+		}
+#endif
+	}
+
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(ux_mask);
+
+	return ul_len;
+}
+
+/**
+ * \brief Sleep until the transmit ring is half free, and pass the wake-up
+ * on to the next waiting writer if there is still room for it.
+ */
+static void console_tx_wait(void)
+{
+	UBaseType_t ux_mask;
+	bool b_wait;
+	bool b_next;
+
+	ux_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	b_wait = console_tx_free() < CONF_CONSOLE_TX_BUFFER_SIZE / 2;
+	if (b_wait) {
+		gs_ul_tx_waiters++;
+	}
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(ux_mask);
+	if (!b_wait) {
+		return;
+	}
+
+	xSemaphoreTake(gs_x_tx_room, portMAX_DELAY);
+
+	ux_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	gs_ul_tx_waiters--;
+	b_next = gs_ul_tx_waiters &&
+			console_tx_free() >= CONF_CONSOLE_TX_BUFFER_SIZE / 2;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(ux_mask);
+	if (b_next) {
+		xSemaphoreGive(gs_x_tx_room);
+	}
+}
+
+/**
+ * \brief Queue bytes for transmission, waiting for room if needed.
+ *
+ * From a task the call returns once every byte is queued. While the
+ * scheduler runs, the task sleeps until the USART or USB interrupt has
+ * drained half of the ring. Before, or while the ring is held (see
+ * console_tx_hold()), it feeds the USART itself, so that it cannot stall
+ * with the console interrupt masked. From interrupt context,
+ * or on USB before the scheduler runs, the bytes that do not fit are
+ * dropped.
+ *
+ * \param p_buf Bytes to send.
+ * \param ul_len Number of bytes.
+ *
+ * \return Number of bytes queued.
+ */
+size_t console_write(const void *p_buf, size_t ul_len)
+{
+	const uint8_t *p_data = (const uint8_t *)p_buf;
+	size_t ul_done = 0;
+	UBaseType_t ux_mask;
+	bool b_wait;
+
+	for (;;) {
+		ul_done += console_tx_enqueue(p_data + ul_done, ul_len - ul_done,
+				false);
+		if (ul_done == ul_len) {
+			break;
+		}
+		b_wait = __get_IPSR() == 0;
+		if (b_wait && gs_x_tx_room && !gs_b_tx_hold &&
+				xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+			console_tx_wait();
+			continue;
+		}
+#if CONF_CONSOLE_USB
+		if (gs_b_usb) {
+			b_wait = false;
+		}
+#endif
+		if (!b_wait) {
+			ux_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+			gs_stats.ul_tx_dropped += ul_len - ul_done;
+			portCLEAR_INTERRUPT_MASK_FROM_ISR(ux_mask);
+			break;
+		}
+		ux_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+		console_tx_drain(NULL);
+		portCLEAR_INTERRUPT_MASK_FROM_ISR(ux_mask);
+	}
+
+	return ul_done;
+}
+
+/**
+ * \brief Queue a block only if it fits entirely, never waiting.
+ *
+ * Used for framed binary data where a partial block is useless.
+ *
+ * \param p_buf Bytes to send.
+ * \param ul_len Number of bytes.
+ *
+ * \return true if the block was queued, false if it was dropped.
+ */
+bool console_try_write(const void *p_buf, size_t ul_len)
+{
+	UBaseType_t ux_mask;
+
+	if (console_tx_enqueue((const uint8_t *)p_buf, ul_len, true) == ul_len) {
+		return true;
+	}
+
+	ux_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	gs_stats.ul_tx_dropped += ul_len;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(ux_mask);
+
+	return false;
+}
+
+/**
+ * \brief Get the number of free bytes in the transmit ring.
+ */
+size_t console_tx_free(void)
+{
+	return CONF_CONSOLE_TX_BUFFER_SIZE - (gs_ul_tx_head - gs_ul_tx_tail);
+}
+
+/**
+ * \brief Hold the transmit ring, or release it.
+ *
+ * While held, the USART interrupt no longer drains the ring and
+ * console_tx_poll() does, so that filling and draining the ring can be
+ * timed apart. Writers keep queueing, and a task finding the ring full
+ * feeds the USART itself. USB, when open, drains the ring as usual.
+ *
+ * \param b_hold true to hold the ring, false to give it back to the
+ * interrupt.
+ */
+void console_tx_hold(bool b_hold)
+{
+	Usart *p_usart = (Usart *)CONF_UART;
+	UBaseType_t ux_mask;
+	bool b_usart = true;
+
+	ux_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	gs_b_tx_hold = b_hold;
+#if CONF_CONSOLE_USB
+	b_usart = !gs_b_usb;
+#endif
+	if (b_hold) {
+		usart_disable_interrupt(p_usart, US_IDR_TXRDY);
+	} else if (b_usart && gs_ul_tx_tail != gs_ul_tx_head) {
+		usart_enable_interrupt(p_usart, US_IER_TXRDY);
+	}
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(ux_mask);
+}
+
+/**
+ * \brief Move what the USART accepts from the transmit ring, as its
+ * interrupt does, never waiting.
+ *
+ * \return Number of bytes moved, 0 on USB.
+ */
+size_t console_tx_poll(void)
+{
+	UBaseType_t ux_mask;
+	uint32_t ul_tail;
+
+	ux_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	ul_tail = gs_ul_tx_tail;
+	console_tx_drain(NULL);
+	ul_tail = gs_ul_tx_tail - ul_tail;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(ux_mask);
+
+	return ul_tail;
+}
+
+/**
+ * \brief Read one received byte without waiting.
+ *
+ * \param p_c Pointer to the byte to fill.
+ *
+ * \return true if a byte was read, false if the receive ring is empty.
+ */
+bool console_getc(uint8_t *p_c)
+{
+	uint32_t ul_tail = gs_ul_rx_tail;
+
+	if (ul_tail == gs_ul_rx_head) {
+#if CONF_CONSOLE_USB
+		UBaseType_t ux_mask;
+
+		if (!gs_ul_usb_rx_len) {
+			return false;
+		}
+		ux_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+		console_usb_rx_push();
+		portCLEAR_INTERRUPT_MASK_FROM_ISR(ux_mask);
+		if (ul_tail == gs_ul_rx_head) {
+			return false;
+		}
+#else
+		return false;
+#endif
+	}
+	*p_c = gs_rx_buf[ul_tail & RX_MASK];
+	gs_ul_rx_tail = ul_tail + 1;
+
+	return true;
+}
+
+/**
+ * \brief Select the task to notify when bytes are received.
+ *
+ * The task is given a notification (see ulTaskNotifyTake()) for every
+ * received byte, so it can sleep until input is available and then drain
+ * the receive ring with console_getc().
+ *
+ * \param x_task Task to notify, or NULL to stop notifications.
+ */
+void console_set_rx_task(TaskHandle_t x_task)
+{
+	gs_x_rx_task = x_task;
+}
+
+/**
+ * \brief Get a snapshot of the console statistics.
+ *
+ * \param p_stats Pointer to the structure to fill.
+ */
+void console_get_stats(console_stats_t *p_stats)
+{
+	UBaseType_t ux_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+
+	*p_stats = gs_stats;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(ux_mask);
+}
+
+/** Chunk buffer of console_vprintf(). */
+struct console_chunk {
+	size_t ul_len;
+	char buf[CONF_CONSOLE_PRINTF_CHUNK];
+};
+
+static void console_chunk_sink(void *p_ctx, const char *p_data, size_t ul_len)
+{
+	struct console_chunk *p_chunk = (struct console_chunk *)p_ctx;
+
+	while (ul_len) {
+		size_t ul_n = sizeof(p_chunk->buf) - p_chunk->ul_len;
+
+		if (ul_n > ul_len) {
+			ul_n = ul_len;
+		}
+		memcpy(&p_chunk->buf[p_chunk->ul_len], p_data, ul_n);
+		p_chunk->ul_len += ul_n;
+		p_data += ul_n;
+		ul_len -= ul_n;
+		if (p_chunk->ul_len == sizeof(p_chunk->buf)) {
+			console_write(p_chunk->buf, p_chunk->ul_len);
+			p_chunk->ul_len = 0;
+		}
+	}
+}
+
+/**
+ * \brief Formatted output to the console.
+ *
+ * \param p_fmt Format string, see \ref utils_fmt_group.
+ * \param ap Arguments.
+ *
+ * \return Number of characters produced.
+ */
+int console_vprintf(const char *p_fmt, va_list ap)
+{
+	struct console_chunk chunk;
+	int n;
+
+	chunk.ul_len = 0;
+	n = fmt_vformat(console_chunk_sink, &chunk, p_fmt, ap);
+	if (chunk.ul_len) {
+		console_write(chunk.buf, chunk.ul_len);
+	}
+
+	return n;
+}
+
+/**
+ * \brief Formatted output to the console.
+ *
+ * \see console_vprintf()
+ */
+int console_printf(const char *p_fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start(ap, p_fmt);
+	n = console_vprintf(p_fmt, ap);
+	va_end(ap);
+
+	return n;
+}
+
+/**
+ * \brief Newlib low level write, replacing the weak per-character version
+ * of stdio/write.c so that whole buffers reach the transmit ring at once.
+ */
+int _write(int file, const char *ptr, int len);
+int _write(int file, const char *ptr, int len)
+{
+	if ((file != 1) && (file != 2) && (file != 3)) {
+		return -1;
+	}
+
+	return (int)console_write(ptr, (size_t)len);
+}
+
+/**
+ * \brief stdio low level write hook (see ptr_put).
+ */
+static int console_stdio_putchar(void volatile *p_usart, char c)
+{
+	UNUSED(p_usart);
+
+	return (int)console_write(&c, 1);
+}
+
+/**
+ * \brief stdio low level read hook (see ptr_get), waits for a byte.
+ */
+static void console_stdio_getchar(void volatile *p_usart, char *p_c)
+{
+	UNUSED(p_usart);
+
+	while (!console_getc((uint8_t *)p_c)) {
+	}
+}
+
+/**
+ * \brief Console USART interrupt handler.
+ */
+void CONF_CONSOLE_Handler(void)
+{
+	Usart *p_usart = (Usart *)CONF_UART;
+	uint32_t ul_status = usart_get_status(p_usart);
+	BaseType_t x_woken = pdFALSE;
+
+	if (ul_status & US_CSR_OVRE) {
+		usart_reset_status(p_usart);
+		gs_stats.ul_rx_overruns++;
+	}
+
+	if (ul_status & US_CSR_RXRDY) {
+		uint32_t ul_head = gs_ul_rx_head;
+		uint8_t uc_c = (uint8_t)p_usart->US_RHR;
+
+		if (ul_head - gs_ul_rx_tail < CONF_CONSOLE_RX_BUFFER_SIZE) {
+			gs_rx_buf[ul_head & RX_MASK] = uc_c;
+			gs_ul_rx_head = ul_head + 1;
+			gs_stats.ul_rx_bytes++;
+			if (gs_x_rx_task) {
+				vTaskNotifyGiveFromISR(gs_x_rx_task, &x_woken);
+			}
+		} else {
+			gs_stats.ul_rx_overruns++;
+		}
+	}
+
+	if ((ul_status & US_CSR_TXRDY) &&
+			(usart_get_interrupt_mask(p_usart) & US_IMR_TXRDY)) {
+		console_tx_drain(&x_woken);
+	}
+
+	portEND_SWITCHING_ISR(x_woken);
+}
+
+/**
+ * \brief Switch the stdio console to the interrupt-driven backend, and
+ * start the USB serial port if CONF_CONSOLE_USB is set.
+ *
+ * \note The console USART must already be configured, e.g. with
+ * stdio_serial_init().
+ */
+void console_init(void)
+{
+	Usart *p_usart = (Usart *)CONF_UART;
+
+	gs_ul_tx_head = gs_ul_tx_tail = 0;
+	gs_ul_rx_head = gs_ul_rx_tail = 0;
+	if (!gs_x_tx_room) {
+		/* Without it, writers feed the USART themselves. */
+		gs_x_tx_room = xSemaphoreCreateBinary();
+	}
+
+	usart_disable_interrupt(p_usart, 0xFFFFFFFF);
+	NVIC_ClearPendingIRQ(CONF_CONSOLE_IRQn);
+	NVIC_SetPriority(CONF_CONSOLE_IRQn, CONF_CONSOLE_IRQ_PRIORITY);
+	NVIC_EnableIRQ(CONF_CONSOLE_IRQn);
+	usart_enable_interrupt(p_usart, US_IER_RXRDY);
+
+	ptr_put = console_stdio_putchar;
+	ptr_get = console_stdio_getchar;
+
+#if CONF_CONSOLE_USB
+	usb_cdc_init(console_usb_event, NULL);
+#endif
+}
+
+/** @} */
@@ -0,0 +1,78 @@
+/**
+ * \file
+ *
+ * \brief Interrupt-driven console USART backend.
+ *
+ */
+
+#ifndef CONSOLE_H_INCLUDED
+#define CONSOLE_H_INCLUDED
+
+#include <stdarg.h>
+#include "compiler.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup console_group Interrupt-driven console
+ *
+ * Replaces the polled stdio backend of the console USART with transmit and
+ * receive rings serviced by the USART interrupt. Writers only copy into the
+ * transmit ring, so printf() and binary telemetry share the link without
+ * spinning on TXRDY for every character.
+ *
+ * console_printf() formats with the reentrant formatter of fmt.h into a
+ * small stack buffer and hands whole chunks to the transmit ring. The build
+ * maps printf to it (printf=console_printf), replacing newlib iprintf.
+ *
+ * With CONF_CONSOLE_USB the console is also a USB serial port. While the
+ * host has it open the transmit ring drains to USB, by DMA straight from
+ * the ring, instead of the USART; input comes from both.
+ *
+ * Writes may come from tasks and from interrupts running at or below
+ * configMAX_SYSCALL_INTERRUPT_PRIORITY. A task that finds the ring full
+ * sleeps until the interrupt has drained half of it; an interrupt drops
+ * what does not fit.
+ *
+ * @{
+ */
+
+/** Console statistics. */
+typedef struct console_stats {
+	/** Bytes sent on the USART or USB. */
+	uint32_t ul_tx_bytes;
+	/**
+	 * Bytes dropped because the transmit ring was full, or the USB port
+	 * closed while sending them.
+	 */
+	uint32_t ul_tx_dropped;
+	/** Bytes received. */
+	uint32_t ul_rx_bytes;
+	/** Bytes lost to receive ring or USART overruns. */
+	uint32_t ul_rx_overruns;
+} console_stats_t;
+
+void console_init(void);
+size_t console_write(const void *p_buf, size_t ul_len);
+bool console_try_write(const void *p_buf, size_t ul_len);
+bool console_getc(uint8_t *p_c);
+void console_set_rx_task(TaskHandle_t x_task);
+size_t console_tx_free(void);
+void console_tx_hold(bool b_hold);
+size_t console_tx_poll(void);
+void console_get_stats(console_stats_t *p_stats);
+int console_vprintf(const char *p_fmt, va_list ap);
+int console_printf(const char *p_fmt, ...)
+		__attribute__((format(__printf__, 1, 2)));
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONSOLE_H_INCLUDED */
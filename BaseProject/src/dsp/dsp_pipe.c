@@ -0,0 +1,308 @@
+/**
+ * \file
+ *
+ * \brief Block streaming DSP pipelines.
+ *
+ */
+
+#include <string.h>
+#include <asf.h>
+#include "dcache.h"
+#include "dsp_pipe.h"
+
+/**
+ * \addtogroup dsp_pipe_group
+ *
+ * @{
+ */
+
+/**
+ * Cycle counter read around each stage, and its start. A build without the
+ * core cycle counter, such as the host tests, defines both.
+ */
+#ifndef DSP_CYCLES
+#  include "cycles.h"
+#  define DSP_CYCLES()          (DWT->CYCCNT)
+#  define DSP_CYCLES_START()    cycle_counter_enable()
+#endif
+
+/* Block storage, aligned so that blocks can be filled or drained by DMA. */
+static float32_t gs_pool_data[CONF_DSP_POOL_BLOCKS][CONF_DSP_BLOCK_SIZE]
+		DCACHE_ALIGNED;
+static dsp_block_t gs_pool[CONF_DSP_POOL_BLOCKS];
+/** Blocks given back. */
+static dsp_block_t *gs_p_free;
+/** Blocks never taken yet, at the end of gs_pool. */
+static uint32_t gs_ul_fresh;
+/** Blocks taken, now and at most. */
+static uint32_t gs_ul_used;
+static uint32_t gs_ul_max_used;
+
+static dsp_pipe_t *gs_pipes[CONF_DSP_MAX_PIPES];
+
+/**
+ * \brief Take a block from the pool. May be called from an interrupt, and
+ * before any pipeline is set up: the pool needs no initialization, blocks
+ * are taken from the end of gs_pool once none has been given back.
+ *
+ * \return The block, with no valid sample, or NULL if the pool is empty.
+ */
+dsp_block_t *dsp_block_alloc(void)
+{
+	dsp_block_t *p_block;
+	UBaseType_t ux_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+
+	p_block = gs_p_free;
+	if (p_block) {
+		gs_p_free = p_block->p_next;
+	} else if (gs_ul_fresh < CONF_DSP_POOL_BLOCKS) {
+		p_block = &gs_pool[gs_ul_fresh];
+		p_block->p_data = gs_pool_data[gs_ul_fresh++];
+	}
+	if (p_block) {
+		p_block->p_next = NULL;
+		p_block->ul_len = 0;
+		p_block->uc_format = DSP_FORMAT_F32;
+		p_block->c_exp = 0;
+		p_block->ul_tag = 0;
+		if (++gs_ul_used > gs_ul_max_used) {
+			gs_ul_max_used = gs_ul_used;
+		}
+	}
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(ux_mask);
+	return p_block;
+}
+
+/**
+ * \brief Give a block back to the pool. May be called from an interrupt.
+ */
+void dsp_block_free(dsp_block_t *p_block)
+{
+	UBaseType_t ux_mask;
+
+	if (!p_block) {
+		return;
+	}
+	ux_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	p_block->p_next = gs_p_free;
+	gs_p_free = p_block;
+	gs_ul_used--;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(ux_mask);
+}
+
+/**
+ * \brief Number of blocks left in the pool.
+ */
+uint32_t dsp_pool_get_free(void)
+{
+	return CONF_DSP_POOL_BLOCKS - gs_ul_used;
+}
+
+/**
+ * \brief Lowest number of blocks left in the pool since start up.
+ */
+uint32_t dsp_pool_get_min_free(void)
+{
+	return CONF_DSP_POOL_BLOCKS - gs_ul_max_used;
+}
+
+/**
+ * \brief Run the stages of a pipeline on one block.
+ *
+ * \param p_block Input of the first stage, NULL for a pulling first stage.
+ */
+static void dsp_pipe_run(dsp_pipe_t *p_pipe, dsp_block_t *p_block)
+{
+	dsp_stage_t *p_stage;
+	uint32_t ul_start;
+	uint32_t ul_cycles;
+
+	for (p_stage = p_pipe->p_first; p_stage; p_stage = p_stage->p_next) {
+		ul_start = DSP_CYCLES();
+		p_block = p_stage->process(p_stage, p_block);
+		ul_cycles = DSP_CYCLES() - ul_start;
+
+		p_stage->stats.ul_calls++;
+		p_stage->stats.ul_cycles_last = ul_cycles;
+		p_stage->stats.ull_cycles_total += ul_cycles;
+		if (ul_cycles > p_stage->stats.ul_cycles_max) {
+			p_stage->stats.ul_cycles_max = ul_cycles;
+		}
+		if (!p_block) {
+			return;
+		}
+	}
+	/* Nothing consumed the output of the last stage. */
+	dsp_block_free(p_block);
+}
+
+/**
+ * \brief Pipeline task.
+ */
+static void dsp_pipe_task(void *pvParameters)
+{
+	dsp_pipe_t *p_pipe = pvParameters;
+	dsp_block_t *p_block;
+
+	for (;;) {
+		if (p_pipe->x_queue) {
+			xQueueReceive(p_pipe->x_queue, &p_block, portMAX_DELAY);
+		} else {
+			/* The first stage blocks until it has data. */
+			p_block = NULL;
+		}
+		dsp_pipe_run(p_pipe, p_block);
+	}
+}
+
+/**
+ * \brief Initialize a pipeline with no stage.
+ *
+ * \param p_name Name, also used for the task.
+ * \param ul_queue_len Depth of the input queue, or 0 for a pipeline whose
+ * first stage produces the blocks: it is then called with NULL, in a loop,
+ * and must block until it has data.
+ *
+ * \return true on success, false if the queue could not be created.
+ */
+bool dsp_pipe_init(dsp_pipe_t *p_pipe, const char *p_name,
+		uint32_t ul_queue_len)
+{
+	memset(p_pipe, 0, sizeof(*p_pipe));
+	p_pipe->p_name = p_name;
+	if (ul_queue_len) {
+		p_pipe->x_queue = xQueueCreate(ul_queue_len, sizeof(dsp_block_t *));
+		if (!p_pipe->x_queue) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * \brief Initialize a custom stage.
+ *
+ * \param process Processing function.
+ * \param p_ctx Context for the processing function.
+ */
+void dsp_stage_init(dsp_stage_t *p_stage, const char *p_name,
+		dsp_stage_fn_t process, void *p_ctx)
+{
+	memset(p_stage, 0, sizeof(*p_stage));
+	p_stage->p_name = p_name;
+	p_stage->process = process;
+	p_stage->p_ctx = p_ctx;
+}
+
+/**
+ * \brief Append a stage to a pipeline. Call before dsp_pipe_start().
+ */
+void dsp_pipe_add(dsp_pipe_t *p_pipe, dsp_stage_t *p_stage)
+{
+	p_stage->p_next = NULL;
+	if (p_pipe->p_last) {
+		p_pipe->p_last->p_next = p_stage;
+	} else {
+		p_pipe->p_first = p_stage;
+	}
+	p_pipe->p_last = p_stage;
+}
+
+/**
+ * \brief Start the task of a pipeline and the cycle counter used to profile
+ * the stages.
+ *
+ * \param ux_priority Task priority.
+ * \param us_stack_size Task stack size, in words.
+ *
+ * \return true on success, false if the pipeline has no stage or the task
+ * could not be created.
+ */
+bool dsp_pipe_start(dsp_pipe_t *p_pipe, UBaseType_t ux_priority,
+		uint16_t us_stack_size)
+{
+	uint32_t i;
+
+	if (!p_pipe->p_first) {
+		return false;
+	}
+
+	DSP_CYCLES_START();
+
+	if (xTaskCreate(dsp_pipe_task, p_pipe->p_name, us_stack_size, p_pipe,
+			ux_priority, &p_pipe->x_task) != pdPASS) {
+		return false;
+	}
+
+	taskENTER_CRITICAL();
+	for (i = 0; i < CONF_DSP_MAX_PIPES; i++) {
+		if (!gs_pipes[i]) {
+			gs_pipes[i] = p_pipe;
+			break;
+		}
+	}
+	taskEXIT_CRITICAL();
+	return true;
+}
+
+/**
+ * \brief Hand a block to a pipeline created with an input queue. The
+ * pipeline owns the block from then on, it is freed if the queue is full.
+ *
+ * \return true if the block was queued.
+ */
+bool dsp_pipe_push(dsp_pipe_t *p_pipe, dsp_block_t *p_block)
+{
+	if (xQueueSend(p_pipe->x_queue, &p_block, 0) != pdPASS) {
+		p_pipe->ul_dropped++;
+		dsp_block_free(p_block);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * \brief dsp_pipe_push() for interrupt handlers.
+ *
+ * \param p_woken Set to pdTRUE if a context switch is needed on exit.
+ */
+bool dsp_pipe_push_from_isr(dsp_pipe_t *p_pipe, dsp_block_t *p_block,
+		BaseType_t *p_woken)
+{
+	if (xQueueSendFromISR(p_pipe->x_queue, &p_block, p_woken) != pdPASS) {
+		p_pipe->ul_dropped++;
+		dsp_block_free(p_block);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * \brief Started pipeline by index, for listings.
+ *
+ * \return The pipeline, or NULL past the last one.
+ */
+dsp_pipe_t *dsp_pipe_get(uint32_t ul_index)
+{
+	if (ul_index >= CONF_DSP_MAX_PIPES) {
+		return NULL;
+	}
+	return gs_pipes[ul_index];
+}
+
+/**
+ * \brief Clear the profile of the stages of a pipeline.
+ */
+void dsp_pipe_reset_stats(dsp_pipe_t *p_pipe)
+{
+	dsp_stage_t *p_stage;
+
+	taskENTER_CRITICAL();
+	p_pipe->ul_dropped = 0;
+	for (p_stage = p_pipe->p_first; p_stage; p_stage = p_stage->p_next) {
+		memset(&p_stage->stats, 0, sizeof(p_stage->stats));
+	}
+	taskEXIT_CRITICAL();
+}
+
+/** @} */
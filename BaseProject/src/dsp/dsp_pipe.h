@@ -0,0 +1,141 @@
+/**
+ * \file
+ *
+ * \brief Block streaming DSP pipelines.
+ *
+ */
+
+#ifndef DSP_PIPE_H_INCLUDED
+#define DSP_PIPE_H_INCLUDED
+
+#include "compiler.h"
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "task.h"
+#include "arm_math.h"
+#include "conf_dsp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup dsp_pipe_group DSP pipelines
+ *
+ * A pipeline is a chain of stages run one after the other by its own task,
+ * each stage taking a block of float32_t samples and handing a block to
+ * the next one. Blocks come from a pool shared by all the pipelines and are
+ * passed by pointer: a stage works in place and passes its input on, or
+ * takes a new block for its output and frees its input. No samples are
+ * copied between stages. The pool needs no set up, a producer may take
+ * blocks before the first dsp_pipe_init().
+ *
+ * Blocks enter a pipeline in one of two ways:
+ * - pushed by a producer (task, interrupt or DMA callback) with
+ *   dsp_pipe_push() or dsp_pipe_push_from_isr(), when the pipeline is
+ *   created with an input queue;
+ * - pulled by the first stage, called with no input block, otherwise.
+ *
+ * A stage returns NULL when it has nothing for the next stages, having
+ * freed or kept its input; the last stage is normally a sink that consumes
+ * and frees its block. The cycles spent in each stage are counted with the
+ * core cycle counter, see dsp_stage_stats_t.
+ *
+ * The common stages, on top of CMSIS-DSP, are in \ref dsp_stages_group.
+ *
+ * @{
+ */
+
+/** Sample formats of a block. */
+enum dsp_format {
+	/** float32_t samples. */
+	DSP_FORMAT_F32,
+	/** q15_t samples, scaled by 2^c_exp, see \ref dsp_q15_group. */
+	DSP_FORMAT_Q15,
+};
+
+/** A block of samples. */
+typedef struct dsp_block {
+	/**
+	 * CONF_DSP_BLOCK_SIZE float32_t samples, cache line aligned. Q15
+	 * blocks use the same storage, cast to q15_t.
+	 */
+	float32_t *p_data;
+	/** Number of valid samples. */
+	uint32_t ul_len;
+	/** enum dsp_format of the samples. */
+	uint8_t uc_format;
+	/** Exponent of Q15 samples: a sample q stands for q / 32768 * 2^c_exp. */
+	int8_t c_exp;
+	/** Free for the stages, e.g. a sequence number or a channel. */
+	uint32_t ul_tag;
+	/** Pool free list link. */
+	struct dsp_block *p_next;
+} dsp_block_t;
+
+struct dsp_stage;
+
+/**
+ * Stage processing. Returns the block for the next stage (p_in, or a new
+ * one once p_in is freed), or NULL.
+ */
+typedef dsp_block_t *(*dsp_stage_fn_t)(struct dsp_stage *p_stage,
+		dsp_block_t *p_in);
+
+/** Stage profile. */
+typedef struct dsp_stage_stats {
+	uint32_t ul_calls;
+	uint32_t ul_cycles_last;
+	uint32_t ul_cycles_max;
+	uint64_t ull_cycles_total;
+	/** Blocks dropped, for lack of pool blocks or a bad length. */
+	uint32_t ul_dropped;
+} dsp_stage_stats_t;
+
+/** A stage. The stages of \ref dsp_stages_group embed it first. */
+typedef struct dsp_stage {
+	const char *p_name;
+	dsp_stage_fn_t process;
+	/** Free for custom stages. */
+	void *p_ctx;
+	dsp_stage_stats_t stats;
+	struct dsp_stage *p_next;
+} dsp_stage_t;
+
+/** A pipeline. */
+typedef struct dsp_pipe {
+	const char *p_name;
+	dsp_stage_t *p_first;
+	dsp_stage_t *p_last;
+	/** Input queue of block pointers, or NULL for a pulling first stage. */
+	QueueHandle_t x_queue;
+	TaskHandle_t x_task;
+	/** Blocks refused because the input queue was full. */
+	uint32_t ul_dropped;
+} dsp_pipe_t;
+
+dsp_block_t *dsp_block_alloc(void);
+void dsp_block_free(dsp_block_t *p_block);
+uint32_t dsp_pool_get_free(void);
+uint32_t dsp_pool_get_min_free(void);
+
+bool dsp_pipe_init(dsp_pipe_t *p_pipe, const char *p_name,
+		uint32_t ul_queue_len);
+void dsp_stage_init(dsp_stage_t *p_stage, const char *p_name,
+		dsp_stage_fn_t process, void *p_ctx);
+void dsp_pipe_add(dsp_pipe_t *p_pipe, dsp_stage_t *p_stage);
+bool dsp_pipe_start(dsp_pipe_t *p_pipe, UBaseType_t ux_priority,
+		uint16_t us_stack_size);
+bool dsp_pipe_push(dsp_pipe_t *p_pipe, dsp_block_t *p_block);
+bool dsp_pipe_push_from_isr(dsp_pipe_t *p_pipe, dsp_block_t *p_block,
+		BaseType_t *p_woken);
+dsp_pipe_t *dsp_pipe_get(uint32_t ul_index);
+void dsp_pipe_reset_stats(dsp_pipe_t *p_pipe);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DSP_PIPE_H_INCLUDED */
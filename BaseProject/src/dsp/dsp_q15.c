@@ -0,0 +1,394 @@
+/**
+ * \file
+ *
+ * \brief Q15 DSP pipeline stages.
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+#include <asf.h>
+#include "dsp_simd.h"
+#include "dsp_q15.h"
+
+/**
+ * \addtogroup dsp_q15_group
+ *
+ * @{
+ */
+
+/**
+ * \brief Drop the input of a stage.
+ */
+static dsp_block_t *dsp_q15_drop(dsp_stage_t *p_stage, dsp_block_t *p_in)
+{
+	p_stage->stats.ul_dropped++;
+	dsp_block_free(p_in);
+	return NULL;
+}
+
+/**
+ * \brief Smallest exponent e such that every sample is within
+ * [-2^e, 2^e), i.e. fits Q15 once scaled by 2^-e. 0 for a silent block.
+ */
+int8_t dsp_f32_exponent(const float32_t *p_src, uint32_t ul_len)
+{
+	float32_t f_peak = 0.0f;
+	int l_exp;
+	uint32_t i;
+
+	for (i = 0; i < ul_len; i++) {
+		float32_t f_abs = fabsf(p_src[i]);
+
+		if (f_abs > f_peak) {
+			f_peak = f_abs;
+		}
+	}
+	if (f_peak == 0.0f) {
+		return 0;
+	}
+	/* f_peak = m * 2^l_exp with 0.5 <= m < 1. */
+	frexpf(f_peak, &l_exp);
+	if (l_exp > 64) {
+		l_exp = 64;
+	} else if (l_exp < -64) {
+		l_exp = -64;
+	}
+	return (int8_t)l_exp;
+}
+
+/**
+ * \brief Convert float samples to Q15 scaled by 2^-c_exp, rounding and
+ * saturating. May work in place (p_dst == p_src).
+ */
+void dsp_f32_to_q15(const float32_t *p_src, q15_t *p_dst, uint32_t ul_len,
+		int8_t c_exp)
+{
+	float32_t f_scale = ldexpf(32768.0f, -c_exp);
+	uint32_t i;
+
+	/* Sample i is read before q15 i, half its size, is written. */
+	for (i = 0; i < ul_len; i++) {
+		float32_t f_value = p_src[i] * f_scale;
+
+		if (f_value >= 32767.0f) {
+			p_dst[i] = 32767;
+		} else if (f_value <= -32768.0f) {
+			p_dst[i] = -32768;
+		} else {
+			p_dst[i] = (q15_t)(int32_t)(f_value +
+					(f_value < 0.0f ? -0.5f : 0.5f));
+		}
+	}
+}
+
+/**
+ * \brief Convert Q15 samples scaled by 2^-c_exp to float. May work in place
+ * (p_dst == p_src).
+ */
+void dsp_q15_to_f32(const q15_t *p_src, float32_t *p_dst, uint32_t ul_len,
+		int8_t c_exp)
+{
+	float32_t f_scale = ldexpf(1.0f / 32768.0f, c_exp);
+	uint32_t i;
+
+	/* Backwards, float i is written once q15 i and below are read. */
+	for (i = ul_len; i--;) {
+		p_dst[i] = p_src[i] * f_scale;
+	}
+}
+
+/**
+ * \brief Number of bits every sample can be shifted left by without
+ * saturating, 15 for a silent block.
+ */
+uint32_t dsp_q15_headroom(const q15_t *p_src, uint32_t ul_len)
+{
+	uint32_t ul_peak = 0;
+	uint32_t ul_bits = 0;
+	uint32_t i;
+
+	for (i = 0; i < ul_len; i++) {
+		uint32_t ul_abs = p_src[i] < 0 ? -(int32_t)p_src[i] : p_src[i];
+
+		if (ul_abs > ul_peak) {
+			ul_peak = ul_abs;
+		}
+	}
+	while (ul_bits < 15 && (ul_peak << (ul_bits + 1)) <= 32767) {
+		ul_bits++;
+	}
+	return ul_bits;
+}
+
+static dsp_block_t *dsp_to_q15_process(dsp_stage_t *p_stage,
+		dsp_block_t *p_in)
+{
+	dsp_to_q15_t *p_conv = (dsp_to_q15_t *)p_stage;
+	int8_t c_exp = p_conv->c_exp;
+
+	if (p_in->uc_format != DSP_FORMAT_F32) {
+		return dsp_q15_drop(p_stage, p_in);
+	}
+	if (c_exp == DSP_Q15_EXP_AUTO) {
+		c_exp = dsp_f32_exponent(p_in->p_data, p_in->ul_len);
+	}
+	dsp_f32_to_q15(p_in->p_data, (q15_t *)p_in->p_data, p_in->ul_len, c_exp);
+	p_in->uc_format = DSP_FORMAT_Q15;
+	p_in->c_exp = c_exp;
+	return p_in;
+}
+
+static dsp_block_t *dsp_to_f32_process(dsp_stage_t *p_stage,
+		dsp_block_t *p_in)
+{
+	if (p_in->uc_format != DSP_FORMAT_Q15) {
+		return dsp_q15_drop(p_stage, p_in);
+	}
+	dsp_q15_to_f32((const q15_t *)p_in->p_data, p_in->p_data, p_in->ul_len,
+			p_in->c_exp);
+	p_in->uc_format = DSP_FORMAT_F32;
+	p_in->c_exp = 0;
+	return p_in;
+}
+
+/**
+ * \brief FIR kernel: two outputs per pass share each coefficient pair
+ * load, two taps per multiply-accumulate.
+ */
+static void dsp_fir_q15_kernel(const q15_t *p_x, const q15_t *p_coeffs,
+		uint32_t ul_taps, uint32_t ul_shift, q15_t *p_y, uint32_t ul_len)
+{
+	uint32_t i, k;
+
+	for (i = 0; i + 1 < ul_len; i += 2) {
+		int64_t ll_acc0 = 0;
+		int64_t ll_acc1 = 0;
+
+		for (k = 0; k < ul_taps; k += 2) {
+			uint32_t ul_c = dsp_q15x2_read(&p_coeffs[k]);
+
+			ll_acc0 = dsp_smlald(ul_c, dsp_q15x2_read(&p_x[i + k]), ll_acc0);
+			ll_acc1 = dsp_smlald(ul_c, dsp_q15x2_read(&p_x[i + k + 1]),
+					ll_acc1);
+		}
+		p_y[i] = dsp_sat_q15((int32_t)(ll_acc0 >> ul_shift));
+		p_y[i + 1] = dsp_sat_q15((int32_t)(ll_acc1 >> ul_shift));
+	}
+	if (i < ul_len) {
+		int64_t ll_acc = 0;
+
+		for (k = 0; k < ul_taps; k += 2) {
+			ll_acc = dsp_smlald(dsp_q15x2_read(&p_coeffs[k]),
+					dsp_q15x2_read(&p_x[i + k]), ll_acc);
+		}
+		p_y[i] = dsp_sat_q15((int32_t)(ll_acc >> ul_shift));
+	}
+}
+
+static dsp_block_t *dsp_fir_q15_process(dsp_stage_t *p_stage,
+		dsp_block_t *p_in)
+{
+	dsp_fir_q15_t *p_fir = (dsp_fir_q15_t *)p_stage;
+	uint32_t ul_hist = p_fir->us_taps - 1;
+	dsp_block_t *p_out;
+
+	if (p_in->uc_format != DSP_FORMAT_Q15) {
+		return dsp_q15_drop(p_stage, p_in);
+	}
+	p_out = dsp_block_alloc();
+	if (!p_out) {
+		return dsp_q15_drop(p_stage, p_in);
+	}
+
+	memcpy(p_fir->p_state + ul_hist, p_in->p_data,
+			p_in->ul_len * sizeof(q15_t));
+	dsp_fir_q15_kernel(p_fir->p_state, p_fir->p_coeffs, p_fir->us_taps,
+			15 - p_fir->uc_post_shift, (q15_t *)p_out->p_data, p_in->ul_len);
+	memmove(p_fir->p_state, p_fir->p_state + p_in->ul_len,
+			ul_hist * sizeof(q15_t));
+
+	p_out->ul_len = p_in->ul_len;
+	p_out->uc_format = DSP_FORMAT_Q15;
+	p_out->c_exp = p_in->c_exp;
+	p_out->ul_tag = p_in->ul_tag;
+	dsp_block_free(p_in);
+	return p_out;
+}
+
+static dsp_block_t *dsp_biquad_q15_process(dsp_stage_t *p_stage,
+		dsp_block_t *p_in)
+{
+	dsp_biquad_q15_t *p_bq = (dsp_biquad_q15_t *)p_stage;
+	const q15_t *p_c = p_bq->p_coeffs;
+	q15_t *p_s = p_bq->p_state;
+	q15_t *p_data = (q15_t *)p_in->p_data;
+	uint32_t ul_shift = 15 - p_bq->uc_post_shift;
+	uint32_t ul_section, i;
+
+	if (p_in->uc_format != DSP_FORMAT_Q15) {
+		return dsp_q15_drop(p_stage, p_in);
+	}
+
+	for (ul_section = 0; ul_section < p_bq->uc_sections; ul_section++) {
+		int32_t l_b0 = p_c[0];
+		uint32_t ul_b12 = dsp_q15x2_read(&p_c[1]);
+		uint32_t ul_a12 = dsp_q15x2_read(&p_c[3]);
+		/* x[n-1] and x[n-2], y[n-1] and y[n-2], packed. */
+		uint32_t ul_x = dsp_q15x2_read(&p_s[0]);
+		uint32_t ul_y = dsp_q15x2_read(&p_s[2]);
+
+		for (i = 0; i < p_in->ul_len; i++) {
+			q15_t x0 = p_data[i];
+			int64_t ll_acc = (int64_t)l_b0 * x0;
+			q15_t y0;
+
+			ll_acc = dsp_smlald(ul_b12, ul_x, ll_acc);
+			ll_acc = dsp_smlald(ul_a12, ul_y, ll_acc);
+			y0 = dsp_sat_q15((int32_t)(ll_acc >> ul_shift));
+			ul_x = dsp_pack((uint16_t)x0, ul_x);
+			ul_y = dsp_pack((uint16_t)y0, ul_y);
+			p_data[i] = y0;
+		}
+		p_s[0] = (q15_t)ul_x;
+		p_s[1] = (q15_t)(ul_x >> 16);
+		p_s[2] = (q15_t)ul_y;
+		p_s[3] = (q15_t)(ul_y >> 16);
+		p_c += 5;
+		p_s += 4;
+	}
+	return p_in;
+}
+
+static dsp_block_t *dsp_power_q15_process(dsp_stage_t *p_stage,
+		dsp_block_t *p_in)
+{
+	dsp_power_q15_t *p_pow = (dsp_power_q15_t *)p_stage;
+	uint32_t ul_len = p_pow->rfft.fftLenReal;
+	const q15_t *p_spec;
+	float32_t f_scale;
+	dsp_block_t *p_out;
+	uint32_t k;
+
+	if (p_in->uc_format != DSP_FORMAT_Q15 || p_in->ul_len != ul_len) {
+		return dsp_q15_drop(p_stage, p_in);
+	}
+	p_out = dsp_block_alloc();
+	if (!p_out) {
+		return dsp_q15_drop(p_stage, p_in);
+	}
+
+	/* Complex spectrum of N bins, 2N q15 in the N floats of the output. */
+	arm_rfft_q15(&p_pow->rfft, (q15_t *)p_in->p_data,
+			(q15_t *)p_out->p_data);
+	p_spec = (const q15_t *)p_out->p_data;
+
+	/* re^2 + im^2 is Q30, to be scaled up by the FFT and block exponents. */
+	f_scale = ldexpf(1.0f, 2 * (p_pow->uc_fft_shift + p_in->c_exp) - 30);
+	for (k = 0; k < ul_len / 2; k++) {
+		/* Bin k is read from the same word float k is written to. */
+		uint32_t ul_bin = dsp_q15x2_read(&p_spec[2 * k]);
+
+		p_out->p_data[k] = dsp_smuad(ul_bin, ul_bin) * f_scale;
+	}
+
+	p_out->ul_len = ul_len / 2;
+	p_out->ul_tag = p_in->ul_tag;
+	dsp_block_free(p_in);
+	return p_out;
+}
+
+/**
+ * \brief Initialize a float to Q15 conversion stage.
+ *
+ * \param c_exp Exponent of the Q15 samples, or DSP_Q15_EXP_AUTO to take
+ * the smallest one holding each block, see dsp_f32_exponent().
+ */
+void dsp_to_q15_init(dsp_to_q15_t *p_conv, const char *p_name, int8_t c_exp)
+{
+	dsp_stage_init(&p_conv->stage, p_name, dsp_to_q15_process, NULL);
+	p_conv->c_exp = c_exp;
+}
+
+/**
+ * \brief Initialize a Q15 to float conversion stage.
+ */
+void dsp_to_f32_init(dsp_to_f32_t *p_conv, const char *p_name)
+{
+	dsp_stage_init(&p_conv->stage, p_name, dsp_to_f32_process, NULL);
+}
+
+/**
+ * \brief Initialize a Q15 FIR stage.
+ *
+ * \param p_coeffs us_taps coefficients, in time reversed order, scaled by
+ * 2^-uc_post_shift. Pad with a zero to an even number of taps.
+ * \param us_taps Number of taps, even.
+ * \param uc_post_shift Coefficient scaling, 0 to 15.
+ * \param p_state DSP_FIR_Q15_STATE_LEN(us_taps) samples.
+ *
+ * \return true on success, false if us_taps is odd or uc_post_shift too
+ * large.
+ */
+bool dsp_fir_q15_init(dsp_fir_q15_t *p_fir, const char *p_name,
+		const q15_t *p_coeffs, uint16_t us_taps, uint8_t uc_post_shift,
+		q15_t *p_state)
+{
+	dsp_stage_init(&p_fir->stage, p_name, dsp_fir_q15_process, NULL);
+	if (!us_taps || (us_taps & 1) || uc_post_shift > 15) {
+		return false;
+	}
+	p_fir->p_coeffs = p_coeffs;
+	p_fir->p_state = p_state;
+	p_fir->us_taps = us_taps;
+	p_fir->uc_post_shift = uc_post_shift;
+	memset(p_state, 0, DSP_FIR_Q15_STATE_LEN(us_taps) * sizeof(q15_t));
+	return true;
+}
+
+/**
+ * \brief Initialize a Q15 biquad cascade stage.
+ *
+ * \param p_coeffs b0, b1, b2, a1, a2 of each section, with a1 and a2
+ * negated as for dsp_biquad_init(), scaled by 2^-uc_post_shift.
+ * \param uc_post_shift Coefficient scaling, 0 to 15; 1 is enough for
+ * most sections, whose a1 lies in (-2, 2).
+ * \param p_state 4 * uc_sections samples.
+ */
+void dsp_biquad_q15_init(dsp_biquad_q15_t *p_bq, const char *p_name,
+		const q15_t *p_coeffs, uint8_t uc_sections, uint8_t uc_post_shift,
+		q15_t *p_state)
+{
+	dsp_stage_init(&p_bq->stage, p_name, dsp_biquad_q15_process, NULL);
+	p_bq->p_coeffs = p_coeffs;
+	p_bq->p_state = p_state;
+	p_bq->uc_sections = uc_sections;
+	p_bq->uc_post_shift = Min(uc_post_shift, 15);
+	memset(p_state, 0, 4 * uc_sections * sizeof(q15_t));
+}
+
+/**
+ * \brief Initialize a Q15 power spectrum stage.
+ *
+ * \param us_len FFT length, a power of two from 32 to CONF_DSP_BLOCK_SIZE.
+ *
+ * \return true on success, false if us_len is not supported.
+ */
+bool dsp_power_q15_init(dsp_power_q15_t *p_pow, const char *p_name,
+		uint16_t us_len)
+{
+	uint8_t uc_log2 = 0;
+
+	dsp_stage_init(&p_pow->stage, p_name, dsp_power_q15_process, NULL);
+	if (us_len < 32 || us_len > CONF_DSP_BLOCK_SIZE ||
+			(us_len & (us_len - 1))) {
+		return false;
+	}
+	while ((1u << uc_log2) < us_len) {
+		uc_log2++;
+	}
+	p_pow->uc_fft_shift = uc_log2 - 1;
+	return arm_rfft_init_q15(&p_pow->rfft, us_len, 0, 1) == ARM_MATH_SUCCESS;
+}
+
+/** @} */
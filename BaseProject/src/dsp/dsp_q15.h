@@ -0,0 +1,112 @@
+/**
+ * \file
+ *
+ * \brief Q15 DSP pipeline stages.
+ *
+ */
+
+#ifndef DSP_Q15_H_INCLUDED
+#define DSP_Q15_H_INCLUDED
+
+#include "dsp_pipe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup dsp_q15_group Q15 DSP pipeline stages
+ *
+ * Fixed-point counterparts of the FIR, biquad and spectrum stages of
+ * \ref dsp_stages_group, on Q15 blocks (DSP_FORMAT_Q15). Their inner loops
+ * use the dual 16-bit multiply-accumulate instructions, see
+ * \ref dsp_simd_group, and avoid the float library calls of a softfp build.
+ *
+ * A Q15 block carries an exponent: sample q stands for q / 32768 * 2^c_exp.
+ * dsp_to_q15_t converts float blocks, either with a fixed exponent or with
+ * the smallest exponent that holds the block peak. The automatic mode gives
+ * the best resolution but changes the scale from one block to the next;
+ * use it only in front of stages without state, such as dsp_power_q15_t.
+ * dsp_to_f32_t converts back.
+ *
+ * The filters keep the exponent of their input. Their coefficients are
+ * Q15, scaled down by 2^post_shift when they reach 1 or more; the
+ * accumulation is 64-bit and the output saturates, so the gain of a
+ * filter must leave enough headroom above its input peak.
+ *
+ * @{
+ */
+
+/** dsp_to_q15_init() exponent for per block scaling. */
+#define DSP_Q15_EXP_AUTO                INT8_MIN
+
+/** Q15 samples of state of a FIR stage of ul_taps taps. */
+#define DSP_FIR_Q15_STATE_LEN(ul_taps)  ((ul_taps) + CONF_DSP_BLOCK_SIZE - 1)
+
+/** Float to Q15 conversion, in place. */
+typedef struct {
+	dsp_stage_t stage;
+	int8_t c_exp;
+} dsp_to_q15_t;
+
+/** Q15 to float conversion, in place. */
+typedef struct {
+	dsp_stage_t stage;
+} dsp_to_f32_t;
+
+/** Q15 FIR filter, output in a new block. */
+typedef struct {
+	dsp_stage_t stage;
+	const q15_t *p_coeffs;
+	q15_t *p_state;
+	uint16_t us_taps;
+	uint8_t uc_post_shift;
+} dsp_fir_q15_t;
+
+/** Q15 cascade of biquad sections (direct form I), in place. */
+typedef struct {
+	dsp_stage_t stage;
+	const q15_t *p_coeffs;
+	/** x[n-1], x[n-2], y[n-1], y[n-2] of each section. */
+	q15_t *p_state;
+	uint8_t uc_sections;
+	uint8_t uc_post_shift;
+} dsp_biquad_q15_t;
+
+/**
+ * Q15 real FFT and power of bins 0 to N/2 - 1, output as float in a new
+ * block, in the squared units of the input. The input block is used as
+ * scratch.
+ */
+typedef struct {
+	dsp_stage_t stage;
+	arm_rfft_instance_q15 rfft;
+	/** Up-scaling of the FFT output, log2(N) - 1. */
+	uint8_t uc_fft_shift;
+} dsp_power_q15_t;
+
+int8_t dsp_f32_exponent(const float32_t *p_src, uint32_t ul_len);
+void dsp_f32_to_q15(const float32_t *p_src, q15_t *p_dst, uint32_t ul_len,
+		int8_t c_exp);
+void dsp_q15_to_f32(const q15_t *p_src, float32_t *p_dst, uint32_t ul_len,
+		int8_t c_exp);
+uint32_t dsp_q15_headroom(const q15_t *p_src, uint32_t ul_len);
+
+void dsp_to_q15_init(dsp_to_q15_t *p_conv, const char *p_name, int8_t c_exp);
+void dsp_to_f32_init(dsp_to_f32_t *p_conv, const char *p_name);
+bool dsp_fir_q15_init(dsp_fir_q15_t *p_fir, const char *p_name,
+		const q15_t *p_coeffs, uint16_t us_taps, uint8_t uc_post_shift,
+		q15_t *p_state);
+void dsp_biquad_q15_init(dsp_biquad_q15_t *p_bq, const char *p_name,
+		const q15_t *p_coeffs, uint8_t uc_sections, uint8_t uc_post_shift,
+		q15_t *p_state);
+bool dsp_power_q15_init(dsp_power_q15_t *p_pow, const char *p_name,
+		uint16_t us_len);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DSP_Q15_H_INCLUDED */
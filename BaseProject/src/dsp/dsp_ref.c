@@ -0,0 +1,516 @@
+/**
+ * \file
+ *
+ * \brief Portable C versions of the CMSIS-DSP kernels used in this project.
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+#include "arm_math.h"
+#include "arm_const_structs.h"
+#include "conf_dsp.h"
+
+/**
+ * \defgroup dsp_ref_group DSP reference kernels
+ *
+ * Plain C implementations of the CMSIS-DSP entry points used by
+ * \ref dsp_stages_group, \ref dsp_q15_group and the application, built
+ * instead of the prebuilt Cortex-M library when CONF_DSP_REF_KERNELS is
+ * set, e.g. for a build on a development host. They take the same instance
+ * structures, buffer layouts and scalings as the library, so the results
+ * agree to rounding: the library sums in a different order and is not bit
+ * exact with them. The host test test/host/test_dsp_ref.c checks them
+ * against direct double precision computations and times them.
+ *
+ * The inner loops have no dependency from one iteration to the next and
+ * work on restrict qualified pointers, so that a host compiler can
+ * vectorize them without reassociating the float arithmetic: the FIR
+ * filters accumulate one tap at a time over the whole block, the matrix
+ * product one row of B at a time over a row of the result.
+ *
+ * The FFTs ignore the twiddle and bit reversal tables of their instances
+ * and compute their factors, arm_cfft_sR_f32_len* only carry the length.
+ * The Q15 real FFT is the float one, rounded to the library output format,
+ * and does forward transforms only.
+ *
+ * @{
+ */
+
+#if CONF_DSP_REF_KERNELS
+
+#ifndef M_PI
+#  define M_PI                3.14159265358979323846
+#endif
+
+/** Largest complex FFT, as in the library. */
+#define DSP_REF_CFFT_MAX      4096
+
+/** Longest Q15 real FFT. */
+#define DSP_REF_RFFT_Q15_MAX  2048
+
+/** Scratch accumulators of the FIR filters. */
+static float32_t gs_acc[CONF_DSP_BLOCK_SIZE];
+
+#define DSP_REF_CFFT(len) \
+	const arm_cfft_instance_f32 arm_cfft_sR_f32_len##len = { len, NULL, NULL, 0 };
+DSP_REF_CFFT(16)
+DSP_REF_CFFT(32)
+DSP_REF_CFFT(64)
+DSP_REF_CFFT(128)
+DSP_REF_CFFT(256)
+DSP_REF_CFFT(512)
+DSP_REF_CFFT(1024)
+DSP_REF_CFFT(2048)
+DSP_REF_CFFT(4096)
+#undef DSP_REF_CFFT
+
+/**
+ * \brief Round and saturate to Q15.
+ */
+static q15_t dsp_ref_q15(float32_t f_value)
+{
+	if (f_value >= 32767.0f) {
+		return 32767;
+	}
+	if (f_value <= -32768.0f) {
+		return -32768;
+	}
+	return (q15_t)(int32_t)(f_value + (f_value < 0.0f ? -0.5f : 0.5f));
+}
+
+/**
+ * \brief y[i] = sum of p_coeffs[k] * p_x[i * ul_step + k], one tap at a
+ * time over the whole output.
+ */
+static void dsp_ref_fir_block(const float32_t *restrict p_x,
+		const float32_t *restrict p_coeffs, uint32_t ul_taps,
+		uint32_t ul_step, float32_t *restrict p_y, uint32_t ul_len)
+{
+	uint32_t i, k;
+
+	for (i = 0; i < ul_len; i++) {
+		p_y[i] = 0.0f;
+	}
+	for (k = 0; k < ul_taps; k++) {
+		const float32_t f_c = p_coeffs[k];
+		const float32_t *restrict p_xk = p_x + k;
+
+		for (i = 0; i < ul_len; i++) {
+			p_y[i] += f_c * p_xk[i * ul_step];
+		}
+	}
+}
+
+void arm_fir_init_f32(arm_fir_instance_f32 *S, uint16_t numTaps,
+		float32_t *pCoeffs, float32_t *pState, uint32_t blockSize)
+{
+	S->numTaps = numTaps;
+	S->pCoeffs = pCoeffs;
+	S->pState = pState;
+	memset(pState, 0, (numTaps + blockSize - 1) * sizeof(float32_t));
+}
+
+void arm_fir_f32(const arm_fir_instance_f32 *S, float32_t *pSrc,
+		float32_t *pDst, uint32_t blockSize)
+{
+	float32_t *p_state = S->pState;
+	uint32_t ul_hist = S->numTaps - 1;
+	uint32_t ul_done, ul_len;
+
+	/* Blocks longer than the scratch are run in pieces. */
+	for (ul_done = 0; ul_done < blockSize; ul_done += ul_len) {
+		ul_len = blockSize - ul_done;
+		if (ul_len > CONF_DSP_BLOCK_SIZE) {
+			ul_len = CONF_DSP_BLOCK_SIZE;
+		}
+		memcpy(p_state + ul_hist, pSrc + ul_done,
+				ul_len * sizeof(float32_t));
+		dsp_ref_fir_block(p_state, S->pCoeffs, S->numTaps, 1, gs_acc,
+				ul_len);
+		memmove(p_state, p_state + ul_len, ul_hist * sizeof(float32_t));
+		memcpy(pDst + ul_done, gs_acc, ul_len * sizeof(float32_t));
+	}
+}
+
+arm_status arm_fir_decimate_init_f32(arm_fir_decimate_instance_f32 *S,
+		uint16_t numTaps, uint8_t M, float32_t *pCoeffs, float32_t *pState,
+		uint32_t blockSize)
+{
+	if (blockSize % M) {
+		return ARM_MATH_LENGTH_ERROR;
+	}
+	S->M = M;
+	S->numTaps = numTaps;
+	S->pCoeffs = pCoeffs;
+	S->pState = pState;
+	memset(pState, 0, (numTaps + blockSize - 1) * sizeof(float32_t));
+	return ARM_MATH_SUCCESS;
+}
+
+void arm_fir_decimate_f32(const arm_fir_decimate_instance_f32 *S,
+		float32_t *pSrc, float32_t *pDst, uint32_t blockSize)
+{
+	float32_t *p_state = S->pState;
+	uint32_t ul_hist = S->numTaps - 1;
+	uint32_t ul_done, ul_len;
+	/* Pieces of whole output samples. */
+	uint32_t ul_max = CONF_DSP_BLOCK_SIZE - CONF_DSP_BLOCK_SIZE % S->M;
+
+	for (ul_done = 0; ul_done < blockSize; ul_done += ul_len) {
+		ul_len = blockSize - ul_done;
+		if (ul_len > ul_max) {
+			ul_len = ul_max;
+		}
+		memcpy(p_state + ul_hist, pSrc + ul_done,
+				ul_len * sizeof(float32_t));
+		dsp_ref_fir_block(p_state, S->pCoeffs, S->numTaps,
+				S->M, gs_acc, ul_len / S->M);
+		memmove(p_state, p_state + ul_len, ul_hist * sizeof(float32_t));
+		memcpy(pDst + ul_done / S->M, gs_acc,
+				ul_len / S->M * sizeof(float32_t));
+	}
+}
+
+void arm_biquad_cascade_df1_init_f32(arm_biquad_casd_df1_inst_f32 *S,
+		uint8_t numStages, float32_t *pCoeffs, float32_t *pState)
+{
+	S->numStages = numStages;
+	S->pCoeffs = pCoeffs;
+	S->pState = pState;
+	memset(pState, 0, 4 * numStages * sizeof(float32_t));
+}
+
+void arm_biquad_cascade_df1_f32(const arm_biquad_casd_df1_inst_f32 *S,
+		float32_t *pSrc, float32_t *pDst, uint32_t blockSize)
+{
+	const float32_t *p_c = S->pCoeffs;
+	float32_t *p_s = S->pState;
+	float32_t *p_in = pSrc;
+	uint32_t ul_stage, i;
+
+	for (ul_stage = 0; ul_stage < S->numStages; ul_stage++) {
+		float32_t b0 = p_c[0], b1 = p_c[1], b2 = p_c[2];
+		float32_t a1 = p_c[3], a2 = p_c[4];
+		float32_t x1 = p_s[0], x2 = p_s[1], y1 = p_s[2], y2 = p_s[3];
+
+		for (i = 0; i < blockSize; i++) {
+			float32_t x0 = p_in[i];
+			float32_t y0 = b0 * x0 + b1 * x1 + b2 * x2 + a1 * y1 + a2 * y2;
+
+			x2 = x1;
+			x1 = x0;
+			y2 = y1;
+			y1 = y0;
+			pDst[i] = y0;
+		}
+		p_s[0] = x1;
+		p_s[1] = x2;
+		p_s[2] = y1;
+		p_s[3] = y2;
+		p_c += 5;
+		p_s += 4;
+		/* The next sections filter the output in place. */
+		p_in = pDst;
+	}
+}
+
+void arm_biquad_cascade_df2T_init_f32(
+		arm_biquad_cascade_df2T_instance_f32 *S, uint8_t numStages,
+		float32_t *pCoeffs, float32_t *pState)
+{
+	S->numStages = numStages;
+	S->pCoeffs = pCoeffs;
+	S->pState = pState;
+	memset(pState, 0, 2 * numStages * sizeof(float32_t));
+}
+
+void arm_biquad_cascade_df2T_f32(
+		const arm_biquad_cascade_df2T_instance_f32 *S, float32_t *pSrc,
+		float32_t *pDst, uint32_t blockSize)
+{
+	const float32_t *p_c = S->pCoeffs;
+	float32_t *p_s = S->pState;
+	float32_t *p_in = pSrc;
+	uint32_t ul_stage, i;
+
+	for (ul_stage = 0; ul_stage < S->numStages; ul_stage++) {
+		float32_t b0 = p_c[0], b1 = p_c[1], b2 = p_c[2];
+		float32_t a1 = p_c[3], a2 = p_c[4];
+		float32_t d1 = p_s[0], d2 = p_s[1];
+
+		for (i = 0; i < blockSize; i++) {
+			float32_t x0 = p_in[i];
+			float32_t y0 = b0 * x0 + d1;
+
+			d1 = b1 * x0 + a1 * y0 + d2;
+			d2 = b2 * x0 + a2 * y0;
+			pDst[i] = y0;
+		}
+		p_s[0] = d1;
+		p_s[1] = d2;
+		p_c += 5;
+		p_s += 2;
+		p_in = pDst;
+	}
+}
+
+/**
+ * \brief Radix-2 decimation in frequency butterflies: natural order in,
+ * bit reversed order out.
+ *
+ * \param f_sign -1 for the forward transform, +1 for the inverse.
+ */
+static void dsp_ref_cfft_dif(float32_t *p, uint32_t ul_len, double f_sign)
+{
+	uint32_t ul_half, ul_group, j;
+
+	for (ul_half = ul_len / 2; ul_half; ul_half /= 2) {
+		for (j = 0; j < ul_half; j++) {
+			double f_angle = f_sign * M_PI * j / ul_half;
+			float32_t f_wr = (float32_t)cos(f_angle);
+			float32_t f_wi = (float32_t)sin(f_angle);
+
+			for (ul_group = 0; ul_group < ul_len; ul_group += 2 * ul_half) {
+				float32_t *p_a = p + 2 * (ul_group + j);
+				float32_t *p_b = p_a + 2 * ul_half;
+				float32_t f_dr = p_a[0] - p_b[0];
+				float32_t f_di = p_a[1] - p_b[1];
+
+				p_a[0] += p_b[0];
+				p_a[1] += p_b[1];
+				p_b[0] = f_dr * f_wr - f_di * f_wi;
+				p_b[1] = f_dr * f_wi + f_di * f_wr;
+			}
+		}
+	}
+}
+
+/**
+ * \brief Reorder ul_len complex values from bit reversed to natural order.
+ */
+static void dsp_ref_bit_reverse(float32_t *p, uint32_t ul_len)
+{
+	uint32_t i, j = 0, ul_bit;
+	float32_t f_tmp;
+
+	for (i = 1; i < ul_len; i++) {
+		for (ul_bit = ul_len >> 1; j & ul_bit; ul_bit >>= 1) {
+			j ^= ul_bit;
+		}
+		j |= ul_bit;
+		if (i < j) {
+			f_tmp = p[2 * i];
+			p[2 * i] = p[2 * j];
+			p[2 * j] = f_tmp;
+			f_tmp = p[2 * i + 1];
+			p[2 * i + 1] = p[2 * j + 1];
+			p[2 * j + 1] = f_tmp;
+		}
+	}
+}
+
+void arm_cfft_f32(const arm_cfft_instance_f32 *S, float32_t *p1,
+		uint8_t ifftFlag, uint8_t bitReverseFlag)
+{
+	uint32_t ul_len = S->fftLen;
+	float32_t f_scale;
+	uint32_t i;
+
+	dsp_ref_cfft_dif(p1, ul_len, ifftFlag ? 1.0 : -1.0);
+	if (bitReverseFlag) {
+		dsp_ref_bit_reverse(p1, ul_len);
+	}
+	if (ifftFlag) {
+		f_scale = 1.0f / ul_len;
+		for (i = 0; i < 2 * ul_len; i++) {
+			p1[i] *= f_scale;
+		}
+	}
+}
+
+arm_status arm_rfft_fast_init_f32(arm_rfft_fast_instance_f32 *S,
+		uint16_t fftLen)
+{
+	if (fftLen < 32 || fftLen > 2 * DSP_REF_CFFT_MAX ||
+			(fftLen & (fftLen - 1))) {
+		return ARM_MATH_ARGUMENT_ERROR;
+	}
+	S->fftLenRFFT = fftLen;
+	S->Sint.fftLen = fftLen / 2;
+	S->Sint.pTwiddle = NULL;
+	S->Sint.pBitRevTable = NULL;
+	S->Sint.bitRevLength = 0;
+	S->pTwiddleRFFT = NULL;
+	return ARM_MATH_SUCCESS;
+}
+
+void arm_rfft_fast_f32(arm_rfft_fast_instance_f32 *S, float32_t *p,
+		float32_t *pOut, uint8_t ifftFlag)
+{
+	uint32_t ul_n = S->fftLenRFFT;
+	uint32_t ul_m = ul_n / 2;
+	const float32_t *p_in;
+	float32_t *p_z;
+	uint32_t k;
+
+	if (!ifftFlag) {
+		/* Even samples as real parts, odd ones as imaginary parts. */
+		arm_cfft_f32(&S->Sint, p, 0, 1);
+		p_in = p;
+		p_z = pOut;
+		p_z[0] = p_in[0] + p_in[1];
+		p_z[1] = p_in[0] - p_in[1];
+	} else {
+		p_in = p;
+		p_z = pOut;
+		p_z[0] = 0.5f * (p_in[0] + p_in[1]);
+		p_z[1] = 0.5f * (p_in[0] - p_in[1]);
+	}
+
+	/*
+	 * Forward: X[k] = E[k] + W^k O[k] from the spectrum Z of the packed
+	 * sequence, with E[k] = (Z[k] + Z*[M-k]) / 2 and
+	 * O[k] = -j (Z[k] - Z*[M-k]) / 2.
+	 * Inverse: Z[k] = E[k] + j O[k], with E[k] = (X[k] + X*[M-k]) / 2 and
+	 * O[k] = W^-k (X[k] - X*[M-k]) / 2.
+	 */
+	for (k = 1; k < ul_m; k++) {
+		double f_angle = -2.0 * M_PI * k / ul_n;
+		float32_t f_wr = (float32_t)cos(f_angle);
+		float32_t f_wi = (float32_t)sin(f_angle);
+		float32_t f_ar = p_in[2 * k], f_ai = p_in[2 * k + 1];
+		float32_t f_br = p_in[2 * (ul_m - k)];
+		float32_t f_bi = -p_in[2 * (ul_m - k) + 1];
+		float32_t f_er = 0.5f * (f_ar + f_br);
+		float32_t f_ei = 0.5f * (f_ai + f_bi);
+		float32_t f_dr = 0.5f * (f_ar - f_br);
+		float32_t f_di = 0.5f * (f_ai - f_bi);
+		float32_t f_or, f_oi;
+
+		if (!ifftFlag) {
+			/* O = -j D, then W O. */
+			f_or = f_di * f_wr + f_dr * f_wi;
+			f_oi = f_di * f_wi - f_dr * f_wr;
+			p_z[2 * k] = f_er + f_or;
+			p_z[2 * k + 1] = f_ei + f_oi;
+		} else {
+			/* O = W* D, then E + j O. */
+			f_or = f_dr * f_wr + f_di * f_wi;
+			f_oi = f_di * f_wr - f_dr * f_wi;
+			p_z[2 * k] = f_er - f_oi;
+			p_z[2 * k + 1] = f_ei + f_or;
+		}
+	}
+
+	if (ifftFlag) {
+		arm_cfft_f32(&S->Sint, pOut, 1, 1);
+	}
+}
+
+arm_status arm_rfft_init_q15(arm_rfft_instance_q15 *S, uint32_t fftLenReal,
+		uint32_t ifftFlagR, uint32_t bitReverseFlag)
+{
+	/* Forward transforms with ordered output only. */
+	if (fftLenReal < 32 || fftLenReal > DSP_REF_RFFT_Q15_MAX ||
+			(fftLenReal & (fftLenReal - 1)) || ifftFlagR ||
+			!bitReverseFlag) {
+		return ARM_MATH_ARGUMENT_ERROR;
+	}
+	memset(S, 0, sizeof(*S));
+	S->fftLenReal = fftLenReal;
+	S->bitReverseFlagR = 1;
+	return ARM_MATH_SUCCESS;
+}
+
+void arm_rfft_q15(const arm_rfft_instance_q15 *S, q15_t *pSrc, q15_t *pDst)
+{
+	static float32_t s_in[DSP_REF_RFFT_Q15_MAX];
+	static float32_t s_out[DSP_REF_RFFT_Q15_MAX];
+	arm_rfft_fast_instance_f32 rfft;
+	uint32_t ul_n = S->fftLenReal;
+	float32_t f_scale;
+	uint32_t k;
+
+	for (k = 0; k < ul_n; k++) {
+		s_in[k] = pSrc[k];
+	}
+	arm_rfft_fast_init_f32(&rfft, ul_n);
+	arm_rfft_fast_f32(&rfft, s_in, s_out, 0);
+
+	/* The library output is scaled down by N / 2. */
+	f_scale = 2.0f / ul_n;
+	pDst[0] = dsp_ref_q15(s_out[0] * f_scale);
+	pDst[1] = 0;
+	pDst[ul_n] = dsp_ref_q15(s_out[1] * f_scale);
+	pDst[ul_n + 1] = 0;
+	for (k = 1; k < ul_n / 2; k++) {
+		q15_t re = dsp_ref_q15(s_out[2 * k] * f_scale);
+		q15_t im = dsp_ref_q15(s_out[2 * k + 1] * f_scale);
+
+		/* The upper half is the conjugate of the lower one. */
+		pDst[2 * k] = re;
+		pDst[2 * k + 1] = im;
+		pDst[2 * (ul_n - k)] = re;
+		pDst[2 * (ul_n - k) + 1] = -im;
+	}
+}
+
+void arm_cmplx_mag_f32(float32_t *pSrc, float32_t *pDst,
+		uint32_t numSamples)
+{
+	uint32_t i;
+
+	/* In place is fine, sample i is read before its output is written. */
+	for (i = 0; i < numSamples; i++) {
+		float32_t f_re = pSrc[2 * i];
+		float32_t f_im = pSrc[2 * i + 1];
+
+		pDst[i] = sqrtf(f_re * f_re + f_im * f_im);
+	}
+}
+
+void arm_mat_init_f32(arm_matrix_instance_f32 *S, uint16_t nRows,
+		uint16_t nColumns, float32_t *pData)
+{
+	S->numRows = nRows;
+	S->numCols = nColumns;
+	S->pData = pData;
+}
+
+arm_status arm_mat_mult_f32(const arm_matrix_instance_f32 *pSrcA,
+		const arm_matrix_instance_f32 *pSrcB, arm_matrix_instance_f32 *pDst)
+{
+	uint32_t ul_rows = pSrcA->numRows;
+	uint32_t ul_inner = pSrcA->numCols;
+	uint32_t ul_cols = pSrcB->numCols;
+	uint32_t i, j, k;
+
+#ifdef ARM_MATH_MATRIX_CHECK
+	if (ul_inner != pSrcB->numRows || ul_rows != pDst->numRows ||
+			ul_cols != pDst->numCols) {
+		return ARM_MATH_SIZE_MISMATCH;
+	}
+#endif
+
+	for (i = 0; i < ul_rows; i++) {
+		float32_t *restrict p_c = pDst->pData + i * ul_cols;
+
+		for (j = 0; j < ul_cols; j++) {
+			p_c[j] = 0.0f;
+		}
+		for (k = 0; k < ul_inner; k++) {
+			const float32_t f_a = pSrcA->pData[i * ul_inner + k];
+			const float32_t *restrict p_b = pSrcB->pData + k * ul_cols;
+
+			for (j = 0; j < ul_cols; j++) {
+				p_c[j] += f_a * p_b[j];
+			}
+		}
+	}
+	return ARM_MATH_SUCCESS;
+}
+
+#endif /* CONF_DSP_REF_KERNELS */
+
+/** @} */
@@ -0,0 +1,122 @@
+/**
+ * \file
+ *
+ * \brief Packed 16-bit multiply-accumulate helpers for the Q15 kernels.
+ *
+ */
+
+#ifndef DSP_SIMD_H_INCLUDED
+#define DSP_SIMD_H_INCLUDED
+
+#include <string.h>
+#include "arm_math.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup dsp_simd_group Packed 16-bit arithmetic
+ *
+ * The dual 16-bit multiply-accumulate instructions of the Cortex-M7 DSP
+ * extension, as used by \ref dsp_q15_group: two Q15 values are packed in a
+ * 32-bit word, the lower address in the low half, and one instruction
+ * multiplies both pairs and adds the products.
+ *
+ * With the DSP extension, these map to the core_cmSimd.h intrinsics. Other
+ * compilers, e.g. a development host building the \ref dsp_ref_group
+ * kernels, get C versions with the same results, saturation included.
+ *
+ * @{
+ */
+
+/**
+ * \brief Load two adjacent Q15 values. Unaligned addresses are fine, the
+ * Cortex-M7 handles unaligned word loads from normal memory.
+ */
+static inline uint32_t dsp_q15x2_read(const q15_t *p)
+{
+	uint32_t ul_pair;
+
+	memcpy(&ul_pair, p, sizeof(ul_pair));
+	return ul_pair;
+}
+
+#if defined(__ARM_FEATURE_DSP)
+
+/** acc + lo(x) * lo(y) + hi(x) * hi(y), 64-bit accumulator. */
+static inline int64_t dsp_smlald(uint32_t x, uint32_t y, int64_t acc)
+{
+	return (int64_t)__SMLALD(x, y, (uint64_t)acc);
+}
+
+/** acc + lo(x) * lo(y) + hi(x) * hi(y), 32-bit accumulator. */
+static inline int32_t dsp_smlad(uint32_t x, uint32_t y, int32_t acc)
+{
+	return (int32_t)__SMLAD(x, y, (uint32_t)acc);
+}
+
+/** lo(x) * lo(y) + hi(x) * hi(y), as unsigned: exact for x == y. */
+static inline uint32_t dsp_smuad(uint32_t x, uint32_t y)
+{
+	return __SMUAD(x, y);
+}
+
+/** Pack lo(x) in the low half and lo(y) in the high half. */
+static inline uint32_t dsp_pack(uint32_t x, uint32_t y)
+{
+	return __PKHBT(x, y, 16);
+}
+
+/** Saturate to Q15. */
+static inline q15_t dsp_sat_q15(int32_t l_value)
+{
+	return (q15_t)__SSAT(l_value, 16);
+}
+
+#else
+
+static inline int64_t dsp_smlald(uint32_t x, uint32_t y, int64_t acc)
+{
+	return acc + (int64_t)((int16_t)x * (int16_t)y) +
+			(int64_t)((int16_t)(x >> 16) * (int16_t)(y >> 16));
+}
+
+static inline int32_t dsp_smlad(uint32_t x, uint32_t y, int32_t acc)
+{
+	/* Wraps on overflow like the instruction, which only sets Q. */
+	return (int32_t)((uint32_t)acc + (uint32_t)((int16_t)x * (int16_t)y) +
+			(uint32_t)((int16_t)(x >> 16) * (int16_t)(y >> 16)));
+}
+
+static inline uint32_t dsp_smuad(uint32_t x, uint32_t y)
+{
+	return (uint32_t)((int16_t)x * (int16_t)y) +
+			(uint32_t)((int16_t)(x >> 16) * (int16_t)(y >> 16));
+}
+
+static inline uint32_t dsp_pack(uint32_t x, uint32_t y)
+{
+	return (x & 0xFFFFu) | (y << 16);
+}
+
+static inline q15_t dsp_sat_q15(int32_t l_value)
+{
+	if (l_value > 32767) {
+		return 32767;
+	}
+	if (l_value < -32768) {
+		return -32768;
+	}
+	return (q15_t)l_value;
+}
+
+#endif
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DSP_SIMD_H_INCLUDED */
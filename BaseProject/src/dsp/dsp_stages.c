@@ -0,0 +1,262 @@
+/**
+ * \file
+ *
+ * \brief Common DSP pipeline stages on top of CMSIS-DSP.
+ *
+ */
+
+#include <string.h>
+#include <asf.h>
+#include "dsp_stages.h"
+
+/**
+ * \addtogroup dsp_stages_group
+ *
+ * @{
+ */
+
+/**
+ * \brief Drop the input of a stage.
+ */
+static dsp_block_t *dsp_stage_drop(dsp_stage_t *p_stage, dsp_block_t *p_in)
+{
+	p_stage->stats.ul_dropped++;
+	dsp_block_free(p_in);
+	return NULL;
+}
+
+/**
+ * \brief Check that the input of a float stage is in float.
+ */
+static bool dsp_stage_is_f32(dsp_stage_t *p_stage, dsp_block_t *p_in)
+{
+	if (p_in->uc_format != DSP_FORMAT_F32) {
+		dsp_stage_drop(p_stage, p_in);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * \brief Take the output block of a stage, dropping its input if the pool
+ * is empty.
+ */
+static dsp_block_t *dsp_stage_output(dsp_stage_t *p_stage, dsp_block_t *p_in)
+{
+	dsp_block_t *p_out = dsp_block_alloc();
+
+	if (!p_out) {
+		dsp_stage_drop(p_stage, p_in);
+		return NULL;
+	}
+	p_out->ul_tag = p_in->ul_tag;
+	return p_out;
+}
+
+static dsp_block_t *dsp_source_process(dsp_stage_t *p_stage,
+		dsp_block_t *p_in)
+{
+	dsp_source_t *p_src = (dsp_source_t *)p_stage;
+	dsp_block_t *p_out;
+
+	UNUSED(p_in);
+	p_out = dsp_block_alloc();
+	if (!p_out) {
+		/* Let the next stages give blocks back. */
+		p_stage->stats.ul_dropped++;
+		vTaskDelay(1);
+		return NULL;
+	}
+	if (!p_src->fill(p_out, p_src->p_ctx) || !p_out->ul_len ||
+			p_out->ul_len > CONF_DSP_BLOCK_SIZE) {
+		return dsp_stage_drop(p_stage, p_out);
+	}
+	return p_out;
+}
+
+static dsp_block_t *dsp_fir_process(dsp_stage_t *p_stage, dsp_block_t *p_in)
+{
+	dsp_fir_t *p_fir = (dsp_fir_t *)p_stage;
+	dsp_block_t *p_out;
+
+	if (!dsp_stage_is_f32(p_stage, p_in)) {
+		return NULL;
+	}
+	p_out = dsp_stage_output(p_stage, p_in);
+	if (!p_out) {
+		return NULL;
+	}
+	arm_fir_f32(&p_fir->fir, p_in->p_data, p_out->p_data, p_in->ul_len);
+	p_out->ul_len = p_in->ul_len;
+	dsp_block_free(p_in);
+	return p_out;
+}
+
+static dsp_block_t *dsp_biquad_process(dsp_stage_t *p_stage,
+		dsp_block_t *p_in)
+{
+	dsp_biquad_t *p_bq = (dsp_biquad_t *)p_stage;
+
+	if (!dsp_stage_is_f32(p_stage, p_in)) {
+		return NULL;
+	}
+	arm_biquad_cascade_df2T_f32(&p_bq->biquad, p_in->p_data, p_in->p_data,
+			p_in->ul_len);
+	return p_in;
+}
+
+static dsp_block_t *dsp_decim_process(dsp_stage_t *p_stage,
+		dsp_block_t *p_in)
+{
+	dsp_decim_t *p_dec = (dsp_decim_t *)p_stage;
+	dsp_block_t *p_out;
+
+	if (!dsp_stage_is_f32(p_stage, p_in)) {
+		return NULL;
+	}
+	if (p_in->ul_len % p_dec->decim.M) {
+		return dsp_stage_drop(p_stage, p_in);
+	}
+	p_out = dsp_stage_output(p_stage, p_in);
+	if (!p_out) {
+		return NULL;
+	}
+	arm_fir_decimate_f32(&p_dec->decim, p_in->p_data, p_out->p_data,
+			p_in->ul_len);
+	p_out->ul_len = p_in->ul_len / p_dec->decim.M;
+	dsp_block_free(p_in);
+	return p_out;
+}
+
+static dsp_block_t *dsp_fft_process(dsp_stage_t *p_stage, dsp_block_t *p_in)
+{
+	dsp_fft_t *p_fft = (dsp_fft_t *)p_stage;
+	uint32_t ul_len = p_fft->rfft.fftLenRFFT;
+	dsp_block_t *p_out;
+
+	if (!dsp_stage_is_f32(p_stage, p_in)) {
+		return NULL;
+	}
+	if (p_in->ul_len != ul_len) {
+		return dsp_stage_drop(p_stage, p_in);
+	}
+	p_out = dsp_stage_output(p_stage, p_in);
+	if (!p_out) {
+		return NULL;
+	}
+	arm_rfft_fast_f32(&p_fft->rfft, p_in->p_data, p_out->p_data, 0);
+	dsp_block_free(p_in);
+	if (p_fft->b_magnitude) {
+		/* Bin 0 holds the DC and Nyquist real parts, keep DC only. */
+		p_out->p_data[1] = 0.0f;
+		arm_cmplx_mag_f32(p_out->p_data, p_out->p_data, ul_len / 2);
+		ul_len /= 2;
+	}
+	p_out->ul_len = ul_len;
+	return p_out;
+}
+
+static dsp_block_t *dsp_sink_process(dsp_stage_t *p_stage, dsp_block_t *p_in)
+{
+	dsp_sink_t *p_sink = (dsp_sink_t *)p_stage;
+
+	p_sink->consume(p_in, p_sink->p_ctx);
+	dsp_block_free(p_in);
+	return NULL;
+}
+
+/**
+ * \brief Initialize a source stage.
+ *
+ * \param fill Called with an empty block each time the pipeline runs.
+ */
+void dsp_source_init(dsp_source_t *p_src, const char *p_name,
+		dsp_source_fn_t fill, void *p_ctx)
+{
+	dsp_stage_init(&p_src->stage, p_name, dsp_source_process, NULL);
+	p_src->fill = fill;
+	p_src->p_ctx = p_ctx;
+}
+
+/**
+ * \brief Initialize a FIR stage.
+ *
+ * \param p_coeffs us_taps coefficients, in time reversed order.
+ * \param p_state DSP_FIR_STATE_LEN(us_taps) samples.
+ */
+void dsp_fir_init(dsp_fir_t *p_fir, const char *p_name,
+		const float32_t *p_coeffs, uint16_t us_taps, float32_t *p_state)
+{
+	dsp_stage_init(&p_fir->stage, p_name, dsp_fir_process, NULL);
+	arm_fir_init_f32(&p_fir->fir, us_taps, (float32_t *)p_coeffs, p_state,
+			CONF_DSP_BLOCK_SIZE);
+}
+
+/**
+ * \brief Initialize a biquad cascade stage.
+ *
+ * \param p_coeffs b0, b1, b2, a1, a2 of each section, with a1 and a2
+ * negated as CMSIS-DSP expects.
+ * \param p_state DSP_BIQUAD_STATE_LEN(uc_sections) samples.
+ */
+void dsp_biquad_init(dsp_biquad_t *p_bq, const char *p_name,
+		const float32_t *p_coeffs, uint8_t uc_sections, float32_t *p_state)
+{
+	dsp_stage_init(&p_bq->stage, p_name, dsp_biquad_process, NULL);
+	arm_biquad_cascade_df2T_init_f32(&p_bq->biquad, uc_sections,
+			(float32_t *)p_coeffs, p_state);
+}
+
+/**
+ * \brief Initialize a decimating FIR stage. Its input blocks must hold a
+ * multiple of uc_factor samples.
+ *
+ * \param p_coeffs us_taps coefficients, in time reversed order.
+ * \param uc_factor Decimation factor, a divisor of CONF_DSP_BLOCK_SIZE.
+ * \param p_state DSP_FIR_STATE_LEN(us_taps) samples.
+ *
+ * \return true on success, false if uc_factor is invalid.
+ */
+bool dsp_decim_init(dsp_decim_t *p_dec, const char *p_name,
+		const float32_t *p_coeffs, uint16_t us_taps, uint8_t uc_factor,
+		float32_t *p_state)
+{
+	dsp_stage_init(&p_dec->stage, p_name, dsp_decim_process, NULL);
+	return uc_factor && arm_fir_decimate_init_f32(&p_dec->decim, us_taps,
+			uc_factor, (float32_t *)p_coeffs, p_state,
+			CONF_DSP_BLOCK_SIZE) == ARM_MATH_SUCCESS;
+}
+
+/**
+ * \brief Initialize a real FFT stage.
+ *
+ * \param us_len FFT length, a power of two from 32 to CONF_DSP_BLOCK_SIZE.
+ * \param b_magnitude Output the bin magnitudes rather than the spectrum.
+ *
+ * \return true on success, false if us_len is not supported.
+ */
+bool dsp_fft_init(dsp_fft_t *p_fft, const char *p_name, uint16_t us_len,
+		bool b_magnitude)
+{
+	dsp_stage_init(&p_fft->stage, p_name, dsp_fft_process, NULL);
+	p_fft->b_magnitude = b_magnitude;
+	if (us_len > CONF_DSP_BLOCK_SIZE) {
+		return false;
+	}
+	return arm_rfft_fast_init_f32(&p_fft->rfft, us_len) == ARM_MATH_SUCCESS;
+}
+
+/**
+ * \brief Initialize a sink stage.
+ *
+ * \param consume Called with each block reaching the end of the pipeline.
+ */
+void dsp_sink_init(dsp_sink_t *p_sink, const char *p_name,
+		dsp_sink_fn_t consume, void *p_ctx)
+{
+	dsp_stage_init(&p_sink->stage, p_name, dsp_sink_process, NULL);
+	p_sink->consume = consume;
+	p_sink->p_ctx = p_ctx;
+}
+
+/** @} */
@@ -0,0 +1,114 @@
+/**
+ * \file
+ *
+ * \brief Common DSP pipeline stages on top of CMSIS-DSP.
+ *
+ */
+
+#ifndef DSP_STAGES_H_INCLUDED
+#define DSP_STAGES_H_INCLUDED
+
+#include "dsp_pipe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup dsp_stages_group DSP pipeline stages
+ *
+ * Sources, filters, transforms and sinks for \ref dsp_pipe_group. Each stage
+ * embeds its dsp_stage_t first, so &p_fir->stage is what dsp_pipe_add()
+ * takes. The stages and the buffers given to their init functions belong
+ * to the caller and must outlive the pipeline.
+ *
+ * Filter states carry samples from one block to the next: a stage instance
+ * is used by one pipeline only. The coefficient tables are read in place,
+ * they may live in flash.
+ *
+ * These stages work in float and drop Q15 blocks, the fixed-point ones are
+ * in \ref dsp_q15_group.
+ *
+ * @{
+ */
+
+/** Samples of state of a FIR or decimating FIR stage of ul_taps taps. */
+#define DSP_FIR_STATE_LEN(ul_taps)     ((ul_taps) + CONF_DSP_BLOCK_SIZE - 1)
+
+/** Samples of state of a biquad stage of ul_sections sections. */
+#define DSP_BIQUAD_STATE_LEN(ul_sections)   (2 * (ul_sections))
+
+/**
+ * Source callback. Blocks until it has filled p_block (p_data and ul_len),
+ * returns false to drop it.
+ */
+typedef bool (*dsp_source_fn_t)(dsp_block_t *p_block, void *p_ctx);
+
+/** Sink callback. The block is freed when it returns. */
+typedef void (*dsp_sink_fn_t)(const dsp_block_t *p_block, void *p_ctx);
+
+/** Pulling source, first stage of a pipeline with no input queue. */
+typedef struct {
+	dsp_stage_t stage;
+	dsp_source_fn_t fill;
+	void *p_ctx;
+} dsp_source_t;
+
+/** FIR filter, output in a new block. */
+typedef struct {
+	dsp_stage_t stage;
+	arm_fir_instance_f32 fir;
+} dsp_fir_t;
+
+/** Cascade of biquad sections (direct form II transposed), in place. */
+typedef struct {
+	dsp_stage_t stage;
+	arm_biquad_cascade_df2T_instance_f32 biquad;
+} dsp_biquad_t;
+
+/** Decimating FIR filter, output of ul_len / M samples in a new block. */
+typedef struct {
+	dsp_stage_t stage;
+	arm_fir_decimate_instance_f32 decim;
+} dsp_decim_t;
+
+/**
+ * Real FFT of blocks of exactly the FFT length, output in a new block:
+ * either the packed complex spectrum (FFT length samples, the real parts
+ * of bins 0 and N/2 in the first two), or the magnitudes of bins 0 to
+ * N/2 - 1 (N/2 samples). The input block is used as scratch.
+ */
+typedef struct {
+	dsp_stage_t stage;
+	arm_rfft_fast_instance_f32 rfft;
+	bool b_magnitude;
+} dsp_fft_t;
+
+/** Sink, last stage of a pipeline. */
+typedef struct {
+	dsp_stage_t stage;
+	dsp_sink_fn_t consume;
+	void *p_ctx;
+} dsp_sink_t;
+
+void dsp_source_init(dsp_source_t *p_src, const char *p_name,
+		dsp_source_fn_t fill, void *p_ctx);
+void dsp_fir_init(dsp_fir_t *p_fir, const char *p_name,
+		const float32_t *p_coeffs, uint16_t us_taps, float32_t *p_state);
+void dsp_biquad_init(dsp_biquad_t *p_bq, const char *p_name,
+		const float32_t *p_coeffs, uint8_t uc_sections, float32_t *p_state);
+bool dsp_decim_init(dsp_decim_t *p_dec, const char *p_name,
+		const float32_t *p_coeffs, uint16_t us_taps, uint8_t uc_factor,
+		float32_t *p_state);
+bool dsp_fft_init(dsp_fft_t *p_fft, const char *p_name, uint16_t us_len,
+		bool b_magnitude);
+void dsp_sink_init(dsp_sink_t *p_sink, const char *p_name,
+		dsp_sink_fn_t consume, void *p_ctx);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DSP_STAGES_H_INCLUDED */
@@ -0,0 +1,878 @@
+/**
+ * \file
+ *
+ * \brief Log-structured store in the internal flash.
+ *
+ */
+
+#include <asf.h>
+#include <string.h>
+#include "conf_flog.h"
+#include "crc.h"
+#include "dcache.h"
+#include "semphr.h"
+#include "flog.h"
+
+/**
+ * \addtogroup flog_group
+ *
+ * @{
+ */
+
+#define FLOG_PAGE_SIZE          EFC_PAGE_SIZE
+#define FLOG_BLOCK_SIZE         (CONF_FLOG_BLOCK_PAGES * FLOG_PAGE_SIZE)
+#define FLOG_BLOCKS             (CONF_FLOG_SIZE / FLOG_BLOCK_SIZE)
+
+/**
+ * Flash commands, see \ref sam_drivers_efc_group. A build on another
+ * flash, such as the emulator of the host tests, defines both.
+ */
+#ifndef FLOG_WRITE_PAGE
+#  define FLOG_WRITE_PAGE(ul_addr, p_data) \
+	efc_write_page(EFC, (ul_addr), (p_data))
+#  define FLOG_ERASE_PAGES(ul_addr, ul_pages) \
+	efc_erase_pages(EFC, (ul_addr), (ul_pages))
+#endif
+/**
+ * Blocks only the compaction may take: the latest values of a block can
+ * need up to two once packed again at the head.
+ */
+#define FLOG_RESERVE            2
+
+/** Block header magic, "FLOG". */
+#define FLOG_MAGIC              0x474F4C46
+
+/** Key read in erased flash: no more records in the page. */
+#define FLOG_KEY_NONE           0xFFFF
+
+/** Record size for a data length, records are word aligned. */
+#define FLOG_REC_SIZE(len)      (sizeof(flog_rec_t) + (((len) + 3) & ~3u))
+
+#if (CONF_FLOG_SIZE & (CONF_FLOG_SIZE - 1)) || (CONF_FLOG_ADDR % CONF_FLOG_SIZE)
+#  error "CONF_FLOG_SIZE must be a power of two, CONF_FLOG_ADDR aligned on it"
+#endif
+#if (FLOG_BLOCKS <= CONF_FLOG_GC_FREE) || (CONF_FLOG_GC_FREE <= FLOG_RESERVE)
+#  error "CONF_FLOG_GC_FREE must leave blocks to the log and exceed the reserve"
+#endif
+#if (CONF_FLOG_KEYS > FLOG_KEY_NONE)
+#  error "CONF_FLOG_KEYS is too large"
+#endif
+
+/** Block header, at the start of its first page. */
+typedef struct flog_block_hdr {
+	uint32_t ul_magic;
+	/** One more than the previous block of the log. */
+	uint32_t ul_seq;
+	/** CRC-32 of the fields above. */
+	uint32_t ul_crc;
+} flog_block_hdr_t;
+
+/** Record header, followed by the data and padding. */
+typedef struct flog_rec {
+	uint16_t us_key;
+	/** Data length, 0 for a deleted key. */
+	uint16_t us_len;
+	/** CRC-32 of the key, the length and the data. */
+	uint32_t ul_crc;
+} flog_rec_t;
+
+/** Block states. */
+enum flog_block_state {
+	/** Free, to erase before use. */
+	FLOG_BLOCK_DIRTY,
+	/** Free and erased. */
+	FLOG_BLOCK_ERASED,
+	/** In the log. */
+	FLOG_BLOCK_USED,
+};
+
+/** Record visitor of flog_walk(), \a ul_addr is the record address. */
+typedef void (*flog_visit_t)(uint32_t ul_addr, const flog_rec_t *p_rec,
+		void *p_ctx);
+
+static uint8_t gs_uc_state[FLOG_BLOCKS];
+
+/** The log: gs_ul_used blocks up to gs_ul_head, whose sequence is gs_ul_seq. */
+static uint32_t gs_ul_head;
+static uint32_t gs_ul_used;
+static uint32_t gs_ul_seq;
+
+/** Next page to write in the head block. */
+static uint32_t gs_ul_next_page;
+
+/**
+ * Page being filled, which is the next page, at gs_ul_page_addr (0 if
+ * none). Records from gs_ul_page_start to gs_ul_page_fill are not written
+ * yet, the first one was added at gs_x_page_tick.
+ */
+static uint32_t gs_ul_page[FLOG_PAGE_SIZE / 4];
+static uint32_t gs_ul_page_addr;
+static uint32_t gs_ul_page_start;
+static uint32_t gs_ul_page_fill;
+static TickType_t gs_x_page_tick;
+
+/** Address of the latest record of each key, 0 if the key has no value. */
+static uint32_t gs_ul_index[CONF_FLOG_KEYS];
+static uint32_t gs_ul_events;
+
+static SemaphoreHandle_t gs_x_lock;
+static TaskHandle_t gs_x_task;
+static flog_stats_t gs_stats;
+
+static status_code_t flog_compact(void);
+
+/**
+ * \brief Address of a block.
+ */
+static inline uint32_t flog_block_addr(uint32_t ul_block)
+{
+	return CONF_FLOG_ADDR + ul_block * FLOG_BLOCK_SIZE;
+}
+
+/**
+ * \brief Free blocks.
+ */
+static inline uint32_t flog_free(void)
+{
+	return FLOG_BLOCKS - gs_ul_used;
+}
+
+/**
+ * \brief Map the store area.
+ *
+ * It is read as non-cacheable memory, so that reads see the commands, and
+ * only writable, as strongly ordered memory, while the latch buffer of a
+ * page is filled.
+ *
+ * \param b_write Map it for the write.
+ */
+static void flog_map(bool b_write)
+{
+	__DMB();
+	mpu_set_region(CONF_FLOG_ADDR | MPU_REGION_VALID | CONF_FLOG_MPU_REGION,
+			(b_write ? MPU_AP_FULL_ACCESS | STRONGLY_ORDERED_SHAREABLE_TYPE :
+			MPU_AP_READONLY | INNER_OUTER_NORMAL_NOCACHE_TYPE(SHAREABLE)) |
+			MPU_REGION_EXECUTE_NEVER |
+			mpu_cal_mpu_region_size(CONF_FLOG_SIZE) |
+			MPU_REGION_ENABLE);
+	__DSB();
+	__ISB();
+}
+
+/**
+ * \brief Where to read a record: in the page being filled, or in the flash.
+ */
+static const uint8_t *flog_ptr(uint32_t ul_addr)
+{
+	if (gs_ul_page_addr && ul_addr - gs_ul_page_addr < FLOG_PAGE_SIZE) {
+		return (const uint8_t *)gs_ul_page + (ul_addr - gs_ul_page_addr);
+	}
+	return (const uint8_t *)ul_addr;
+}
+
+static uint32_t flog_rec_crc(const flog_rec_t *p_rec)
+{
+	uint32_t ul_crc = crc32_update(0, p_rec, 4);
+
+	return crc32_update(ul_crc, p_rec + 1, p_rec->us_len);
+}
+
+/**
+ * \brief Tell whether a flash range is erased.
+ */
+static bool flog_is_erased(uint32_t ul_addr, uint32_t ul_len)
+{
+	const uint32_t *p_word = (const uint32_t *)ul_addr;
+	uint32_t i;
+
+	for (i = 0; i < ul_len / 4; i++) {
+		if (p_word[i] != 0xFFFFFFFF) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * \brief Visit the records of a block of the log, in order.
+ *
+ * A page is read up to its end of records or its first bad record.
+ *
+ * \return The number of pages cut short by a bad record.
+ */
+static uint32_t flog_walk(uint32_t ul_block, flog_visit_t visit, void *p_ctx)
+{
+	uint32_t ul_pages = CONF_FLOG_BLOCK_PAGES;
+	uint32_t ul_bad = 0;
+	uint32_t ul_page;
+
+	if (ul_block == gs_ul_head) {
+		ul_pages = gs_ul_next_page + (gs_ul_page_addr ? 1 : 0);
+	}
+	for (ul_page = 0; ul_page < ul_pages; ul_page++) {
+		uint32_t ul_addr = flog_block_addr(ul_block) +
+				ul_page * FLOG_PAGE_SIZE;
+		uint32_t ul_off = ul_page ? 0 : sizeof(flog_block_hdr_t);
+		uint32_t ul_end = FLOG_PAGE_SIZE;
+
+		if (ul_addr == gs_ul_page_addr) {
+			ul_end = gs_ul_page_fill;
+		}
+		while (ul_off + sizeof(flog_rec_t) <= ul_end) {
+			const flog_rec_t *p_rec =
+					(const flog_rec_t *)flog_ptr(ul_addr + ul_off);
+
+			if (p_rec->us_key == FLOG_KEY_NONE) {
+				break;
+			}
+			if (p_rec->us_len > FLOG_DATA_MAX ||
+					ul_off + FLOG_REC_SIZE(p_rec->us_len) > ul_end ||
+					p_rec->ul_crc != flog_rec_crc(p_rec)) {
+				ul_bad++;
+				break;
+			}
+			visit(ul_addr + ul_off, p_rec, p_ctx);
+			ul_off += FLOG_REC_SIZE(p_rec->us_len);
+		}
+	}
+
+	return ul_bad;
+}
+
+static void flog_index_visit(uint32_t ul_addr, const flog_rec_t *p_rec,
+		void *p_ctx)
+{
+	UNUSED(p_ctx);
+
+	if (p_rec->us_key == FLOG_KEY_EVENT) {
+		gs_ul_events++;
+	} else if (p_rec->us_key < CONF_FLOG_KEYS) {
+		gs_ul_index[p_rec->us_key] = p_rec->us_len ? ul_addr : 0;
+	}
+}
+
+/**
+ * \brief Build the index from the log.
+ *
+ * \return The number of pages cut short by a bad record.
+ */
+static uint32_t flog_reindex(void)
+{
+	uint32_t ul_block = (gs_ul_head + FLOG_BLOCKS + 1 - gs_ul_used) %
+			FLOG_BLOCKS;
+	uint32_t ul_bad = 0;
+	uint32_t i;
+
+	memset(gs_ul_index, 0, sizeof(gs_ul_index));
+	gs_ul_events = 0;
+	for (i = 0; i < gs_ul_used; i++) {
+		ul_bad += flog_walk(ul_block, flog_index_visit, NULL);
+		ul_block = (ul_block + 1) % FLOG_BLOCKS;
+	}
+
+	return ul_bad;
+}
+
+/**
+ * \brief Find the log in the flash, and build the index.
+ */
+static void flog_mount(void)
+{
+	const flog_block_hdr_t *p_hdr;
+	uint32_t ul_seq[FLOG_BLOCKS];
+	bool b_valid[FLOG_BLOCKS];
+	uint32_t ul_block;
+	uint32_t i;
+
+	/* The head is the valid block of highest sequence. */
+	gs_ul_head = FLOG_BLOCKS - 1;
+	gs_ul_used = 0;
+	gs_ul_seq = 0;
+	for (i = 0; i < FLOG_BLOCKS; i++) {
+		p_hdr = (const flog_block_hdr_t *)flog_block_addr(i);
+		ul_seq[i] = p_hdr->ul_seq;
+		b_valid[i] = p_hdr->ul_magic == FLOG_MAGIC &&
+				p_hdr->ul_crc == crc32_update(0, p_hdr, 8);
+		if (b_valid[i] && (!gs_ul_used ||
+				(int32_t)(ul_seq[i] - gs_ul_seq) > 0)) {
+			gs_ul_head = i;
+			gs_ul_seq = ul_seq[i];
+			gs_ul_used = 1;
+		}
+	}
+
+	/* The tail is where the sequence stops going back by one. */
+	ul_block = gs_ul_head;
+	while (gs_ul_used && gs_ul_used < FLOG_BLOCKS) {
+		ul_block = (ul_block + FLOG_BLOCKS - 1) % FLOG_BLOCKS;
+		if (!b_valid[ul_block] || ul_seq[ul_block] != gs_ul_seq - gs_ul_used) {
+			break;
+		}
+		gs_ul_used++;
+	}
+
+	for (i = 0; i < FLOG_BLOCKS; i++) {
+		if ((gs_ul_head + FLOG_BLOCKS - i) % FLOG_BLOCKS < gs_ul_used) {
+			gs_uc_state[i] = FLOG_BLOCK_USED;
+		} else if (flog_is_erased(flog_block_addr(i), FLOG_BLOCK_SIZE)) {
+			gs_uc_state[i] = FLOG_BLOCK_ERASED;
+		} else {
+			gs_uc_state[i] = FLOG_BLOCK_DIRTY;
+		}
+	}
+
+	/* Write after the last page that is not erased, even partly written. */
+	gs_ul_next_page = CONF_FLOG_BLOCK_PAGES;
+	if (gs_ul_used) {
+		while (gs_ul_next_page > 1 &&
+				flog_is_erased(flog_block_addr(gs_ul_head) +
+				(gs_ul_next_page - 1) * FLOG_PAGE_SIZE, FLOG_PAGE_SIZE)) {
+			gs_ul_next_page--;
+		}
+	}
+	gs_ul_page_addr = 0;
+
+	gs_stats.ul_bad_pages = flog_reindex();
+}
+
+/**
+ * \brief Erase a free block.
+ */
+static status_code_t flog_erase(uint32_t ul_block)
+{
+	status_code_t status;
+
+	status = FLOG_ERASE_PAGES(flog_block_addr(ul_block),
+			CONF_FLOG_BLOCK_PAGES);
+	gs_stats.ul_erases++;
+	if (status != STATUS_OK) {
+		gs_stats.ul_errors++;
+		gs_uc_state[ul_block] = FLOG_BLOCK_DIRTY;
+		return status;
+	}
+	gs_uc_state[ul_block] = FLOG_BLOCK_ERASED;
+
+	return STATUS_OK;
+}
+
+/**
+ * \brief Start a page in a new head block, after its header.
+ *
+ * \param b_reserve Whether the reserved blocks may be taken.
+ */
+static status_code_t flog_open_block(bool b_reserve)
+{
+	uint32_t ul_block = (gs_ul_head + 1) % FLOG_BLOCKS;
+	flog_block_hdr_t *p_hdr = (flog_block_hdr_t *)gs_ul_page;
+	status_code_t status;
+
+	if (flog_free() <= (b_reserve ? 0 : FLOG_RESERVE)) {
+		return ERR_NO_MEMORY;
+	}
+	if (gs_uc_state[ul_block] != FLOG_BLOCK_ERASED) {
+		status = flog_erase(ul_block);
+		if (status != STATUS_OK) {
+			return status;
+		}
+	}
+	gs_uc_state[ul_block] = FLOG_BLOCK_USED;
+	gs_ul_head = ul_block;
+	gs_ul_used++;
+	gs_ul_seq++;
+	gs_ul_next_page = 0;
+
+	memset(gs_ul_page, 0xFF, sizeof(gs_ul_page));
+	p_hdr->ul_magic = FLOG_MAGIC;
+	p_hdr->ul_seq = gs_ul_seq;
+	p_hdr->ul_crc = crc32_update(0, p_hdr, 8);
+	gs_ul_page_addr = flog_block_addr(ul_block);
+	gs_ul_page_start = gs_ul_page_fill = sizeof(*p_hdr);
+
+	if (flog_free() < CONF_FLOG_GC_FREE && gs_x_task) {
+		xTaskNotifyGive(gs_x_task);
+	}
+
+	return STATUS_OK;
+}
+
+/**
+ * \brief Start the next page.
+ */
+static status_code_t flog_open_page(bool b_reserve)
+{
+	if (!gs_ul_used || gs_ul_next_page == CONF_FLOG_BLOCK_PAGES) {
+		return flog_open_block(b_reserve);
+	}
+	memset(gs_ul_page, 0xFF, sizeof(gs_ul_page));
+	gs_ul_page_addr = flog_block_addr(gs_ul_head) +
+			gs_ul_next_page * FLOG_PAGE_SIZE;
+	gs_ul_page_start = gs_ul_page_fill = 0;
+
+	return STATUS_OK;
+}
+
+/**
+ * \brief Write the page being filled, if it has records, and close it.
+ */
+static status_code_t flog_flush(void)
+{
+	status_code_t status;
+
+	if (!gs_ul_page_addr || gs_ul_page_fill == gs_ul_page_start) {
+		return STATUS_OK;
+	}
+	flog_map(true);
+	status = FLOG_WRITE_PAGE(gs_ul_page_addr, gs_ul_page);
+	flog_map(false);
+	gs_stats.ul_pages++;
+	gs_ul_page_addr = 0;
+	gs_ul_next_page++;
+	if (status != STATUS_OK) {
+		gs_stats.ul_errors++;
+		if (gs_ul_next_page == 1) {
+			/*
+			 * The block has no header, the next start would end the log
+			 * before it: give it up, it is erased and opened again.
+			 */
+			gs_uc_state[gs_ul_head] = FLOG_BLOCK_DIRTY;
+			gs_ul_head = (gs_ul_head + FLOG_BLOCKS - 1) % FLOG_BLOCKS;
+			gs_ul_used--;
+			gs_ul_seq--;
+			gs_ul_next_page = CONF_FLOG_BLOCK_PAGES;
+		}
+		/* The records of the page are lost, drop them from the index. */
+		flog_reindex();
+	}
+
+	return status;
+}
+
+/**
+ * \brief Tell whether a record needs a new block.
+ */
+static bool flog_needs_block(uint32_t ul_size)
+{
+	if (gs_ul_page_addr && gs_ul_page_fill + ul_size <= FLOG_PAGE_SIZE) {
+		return false;
+	}
+	return !gs_ul_used || gs_ul_next_page + (gs_ul_page_addr ? 1 : 0) >=
+			CONF_FLOG_BLOCK_PAGES;
+}
+
+/**
+ * \brief Append a record at the head.
+ *
+ * \param b_reserve Whether the reserved blocks may be taken.
+ */
+static status_code_t flog_append(uint16_t us_key, const void *p_data,
+		uint16_t us_len, bool b_reserve)
+{
+	uint32_t ul_size = FLOG_REC_SIZE(us_len);
+	flog_rec_t *p_rec;
+	status_code_t status;
+
+	if (gs_ul_page_addr && gs_ul_page_fill + ul_size > FLOG_PAGE_SIZE) {
+		status = flog_flush();
+		if (status != STATUS_OK) {
+			return status;
+		}
+	}
+	if (!gs_ul_page_addr) {
+		status = flog_open_page(b_reserve);
+		if (status != STATUS_OK) {
+			return status;
+		}
+	}
+
+	p_rec = (flog_rec_t *)((uint8_t *)gs_ul_page + gs_ul_page_fill);
+	p_rec->us_key = us_key;
+	p_rec->us_len = us_len;
+	if (us_len) {
+		memcpy(p_rec + 1, p_data, us_len);
+	}
+	p_rec->ul_crc = flog_rec_crc(p_rec);
+
+	if (us_key == FLOG_KEY_EVENT) {
+		gs_ul_events++;
+	} else {
+		gs_ul_index[us_key] = us_len ? gs_ul_page_addr + gs_ul_page_fill : 0;
+	}
+	if (gs_ul_page_fill == gs_ul_page_start) {
+		/* Let the task time the write. */
+		gs_x_page_tick = xTaskGetTickCount();
+		if (gs_x_task) {
+			xTaskNotifyGive(gs_x_task);
+		}
+	}
+	gs_ul_page_fill += ul_size;
+
+	return STATUS_OK;
+}
+
+/**
+ * \brief Append a record for the application, compacting first if the
+ * log runs into the reserve.
+ */
+static status_code_t flog_write(uint16_t us_key, const void *p_data,
+		uint16_t us_len)
+{
+	uint32_t ul_size = FLOG_REC_SIZE(us_len);
+	uint32_t ul_free;
+	status_code_t status;
+
+	while (flog_needs_block(ul_size) && flog_free() <= FLOG_RESERVE) {
+		ul_free = flog_free();
+		status = flog_compact();
+		if (status != STATUS_OK) {
+			return status;
+		}
+		if (flog_free() <= ul_free) {
+			/* Every value of the block is the latest: full. */
+			return ERR_NO_MEMORY;
+		}
+	}
+	status = flog_append(us_key, p_data, us_len, false);
+	if (status == STATUS_OK) {
+		gs_stats.ul_append_bytes += ul_size;
+	}
+
+	return status;
+}
+
+/** Compaction state. */
+struct flog_copy {
+	status_code_t status;
+	uint32_t ul_events;
+};
+
+static void flog_copy_visit(uint32_t ul_addr, const flog_rec_t *p_rec,
+		void *p_ctx)
+{
+	struct flog_copy *p_copy = (struct flog_copy *)p_ctx;
+
+	if (p_copy->status != STATUS_OK) {
+		return;
+	}
+	if (p_rec->us_key == FLOG_KEY_EVENT) {
+		p_copy->ul_events++;
+		return;
+	}
+	if (p_rec->us_key >= CONF_FLOG_KEYS ||
+			gs_ul_index[p_rec->us_key] != ul_addr) {
+		return;
+	}
+	p_copy->status = flog_append(p_rec->us_key, p_rec + 1, p_rec->us_len,
+			true);
+	if (p_copy->status == STATUS_OK) {
+		gs_stats.ul_copy_bytes += FLOG_REC_SIZE(p_rec->us_len);
+	}
+}
+
+/**
+ * \brief Copy the latest values of the oldest block to the head, and
+ * erase it.
+ */
+static status_code_t flog_compact(void)
+{
+	struct flog_copy copy;
+	uint32_t ul_tail;
+	status_code_t status;
+
+	if (gs_ul_used < 2) {
+		return ERR_NO_MEMORY;
+	}
+	ul_tail = (gs_ul_head + FLOG_BLOCKS + 1 - gs_ul_used) % FLOG_BLOCKS;
+	copy.status = STATUS_OK;
+	copy.ul_events = 0;
+	flog_walk(ul_tail, flog_copy_visit, &copy);
+	if (copy.status != STATUS_OK) {
+		return copy.status;
+	}
+
+	/* The copies must be in the flash before the originals go. */
+	status = flog_flush();
+	if (status != STATUS_OK) {
+		return status;
+	}
+	status = flog_erase(ul_tail);
+	if (status != STATUS_OK) {
+		/*
+		 * Its header still follows on the next block, the next start
+		 * would find it in the log: keep it there, and its events, for
+		 * the next compaction to erase.
+		 */
+		gs_uc_state[ul_tail] = FLOG_BLOCK_USED;
+		return status;
+	}
+	gs_ul_used--;
+	gs_ul_events -= copy.ul_events;
+	gs_stats.ul_compactions++;
+
+	return STATUS_OK;
+}
+
+/**
+ * \brief Background task: writes the pending records once due and keeps
+ * CONF_FLOG_GC_FREE blocks free.
+ */
+static void flog_task(void *p_param)
+{
+	TickType_t x_wait = portMAX_DELAY;
+	TickType_t x_age;
+	uint32_t ul_free;
+
+	UNUSED(p_param);
+
+	for (;;) {
+		ulTaskNotifyTake(pdTRUE, x_wait);
+		x_wait = portMAX_DELAY;
+
+		xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+		if (gs_ul_page_addr && gs_ul_page_fill != gs_ul_page_start) {
+			x_age = xTaskGetTickCount() - gs_x_page_tick;
+			if (x_age >= pdMS_TO_TICKS(CONF_FLOG_SYNC_MS)) {
+				flog_flush();
+			} else {
+				x_wait = pdMS_TO_TICKS(CONF_FLOG_SYNC_MS) - x_age;
+			}
+		}
+		/* One block at a time, the store stays usable meanwhile. */
+		ul_free = flog_free();
+		if (ul_free < CONF_FLOG_GC_FREE &&
+				flog_compact() == STATUS_OK && flog_free() > ul_free &&
+				flog_free() < CONF_FLOG_GC_FREE) {
+			x_wait = 0;
+		}
+		xSemaphoreGive(gs_x_lock);
+	}
+}
+
+/**
+ * \brief Map the store area, find the log and start the background task.
+ *
+ * \return true on success, false if already started or out of memory.
+ */
+bool flog_init(void)
+{
+	if (gs_x_lock) {
+		return false;
+	}
+	gs_x_lock = xSemaphoreCreateMutex();
+	if (!gs_x_lock) {
+		return false;
+	}
+
+	flog_map(false);
+	/* Lines read through the default mapping. */
+	dcache_invalidate((const void *)CONF_FLOG_ADDR, CONF_FLOG_SIZE);
+
+	gs_stats.ul_blocks = FLOG_BLOCKS;
+	flog_mount();
+
+	if (xTaskCreate(flog_task, "Flog", CONF_FLOG_TASK_STACK_SIZE, NULL,
+			CONF_FLOG_TASK_PRIORITY, &gs_x_task) != pdPASS) {
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * \brief Set the value of a key.
+ *
+ * \param us_key 1 to CONF_FLOG_KEYS - 1.
+ * \param p_data Value.
+ * \param us_len Value length, 1 to FLOG_DATA_MAX.
+ *
+ * \retval STATUS_OK The value is set, and written within CONF_FLOG_SYNC_MS
+ * or by flog_sync().
+ * \retval ERR_INVALID_ARG Bad key or length.
+ * \retval ERR_NO_MEMORY The store is full of latest values.
+ * \retval ERR_IO_ERROR A flash command failed.
+ */
+status_code_t flog_set(uint16_t us_key, const void *p_data, uint16_t us_len)
+{
+	status_code_t status;
+
+	if (us_key == FLOG_KEY_EVENT || us_key >= CONF_FLOG_KEYS || !us_len ||
+			us_len > FLOG_DATA_MAX) {
+		return ERR_INVALID_ARG;
+	}
+	xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+	status = flog_write(us_key, p_data, us_len);
+	xSemaphoreGive(gs_x_lock);
+
+	return status;
+}
+
+/**
+ * \brief Get the value of a key.
+ *
+ * \param us_key Key.
+ * \param p_buf Buffer.
+ * \param p_us_len Buffer size on entry, value length on return. The value
+ * is cut to the buffer size.
+ *
+ * \return true if the key has a value.
+ */
+bool flog_get(uint16_t us_key, void *p_buf, uint16_t *p_us_len)
+{
+	const flog_rec_t *p_rec;
+	uint16_t us_len;
+	bool b_found = false;
+
+	if (us_key == FLOG_KEY_EVENT || us_key >= CONF_FLOG_KEYS) {
+		return false;
+	}
+	xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+	if (gs_ul_index[us_key]) {
+		p_rec = (const flog_rec_t *)flog_ptr(gs_ul_index[us_key]);
+		us_len = Min(p_rec->us_len, *p_us_len);
+		memcpy(p_buf, p_rec + 1, us_len);
+		*p_us_len = p_rec->us_len;
+		b_found = true;
+	}
+	xSemaphoreGive(gs_x_lock);
+
+	return b_found;
+}
+
+/**
+ * \brief Remove the value of a key.
+ *
+ * \retval STATUS_OK The key has no value.
+ * \retval ERR_INVALID_ARG Bad key.
+ * \retval ERR_NO_MEMORY The store is full of latest values.
+ * \retval ERR_IO_ERROR A flash command failed.
+ */
+status_code_t flog_delete(uint16_t us_key)
+{
+	status_code_t status = STATUS_OK;
+
+	if (us_key == FLOG_KEY_EVENT || us_key >= CONF_FLOG_KEYS) {
+		return ERR_INVALID_ARG;
+	}
+	xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+	if (gs_ul_index[us_key]) {
+		status = flog_write(us_key, NULL, 0);
+	}
+	xSemaphoreGive(gs_x_lock);
+
+	return status;
+}
+
+/**
+ * \brief Add an event.
+ *
+ * \param p_data Event data.
+ * \param us_len Data length, 1 to FLOG_DATA_MAX.
+ *
+ * \return See flog_set().
+ */
+status_code_t flog_event(const void *p_data, uint16_t us_len)
+{
+	status_code_t status;
+
+	if (!us_len || us_len > FLOG_DATA_MAX) {
+		return ERR_INVALID_ARG;
+	}
+	xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+	status = flog_write(FLOG_KEY_EVENT, p_data, us_len);
+	xSemaphoreGive(gs_x_lock);
+
+	return status;
+}
+
+/** Event reading state. */
+struct flog_reader {
+	flog_event_reader_t reader;
+	void *p_ctx;
+	uint32_t ul_count;
+};
+
+static void flog_event_visit(uint32_t ul_addr, const flog_rec_t *p_rec,
+		void *p_ctx)
+{
+	struct flog_reader *p_reader = (struct flog_reader *)p_ctx;
+
+	UNUSED(ul_addr);
+
+	if (p_rec->us_key == FLOG_KEY_EVENT) {
+		p_reader->reader(p_rec + 1, p_rec->us_len, p_reader->p_ctx);
+		p_reader->ul_count++;
+	}
+}
+
+/**
+ * \brief Pass the events to a callback, oldest first.
+ *
+ * The store is locked meanwhile: the callback must not call it.
+ *
+ * \return The number of events.
+ */
+uint32_t flog_read_events(flog_event_reader_t reader, void *p_ctx)
+{
+	struct flog_reader rd;
+	uint32_t ul_block;
+	uint32_t i;
+
+	rd.reader = reader;
+	rd.p_ctx = p_ctx;
+	rd.ul_count = 0;
+
+	xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+	ul_block = (gs_ul_head + FLOG_BLOCKS + 1 - gs_ul_used) % FLOG_BLOCKS;
+	for (i = 0; i < gs_ul_used; i++) {
+		flog_walk(ul_block, flog_event_visit, &rd);
+		ul_block = (ul_block + 1) % FLOG_BLOCKS;
+	}
+	xSemaphoreGive(gs_x_lock);
+
+	return rd.ul_count;
+}
+
+/**
+ * \brief Write the pending records now.
+ *
+ * \retval STATUS_OK Every record is in the flash.
+ * \retval ERR_IO_ERROR The page could not be written, its records are lost.
+ */
+status_code_t flog_sync(void)
+{
+	status_code_t status;
+
+	xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+	status = flog_flush();
+	xSemaphoreGive(gs_x_lock);
+
+	return status;
+}
+
+/**
+ * \brief Get a snapshot of the store statistics.
+ *
+ * \return false if the store is not started.
+ */
+bool flog_get_stats(flog_stats_t *p_stats)
+{
+	uint32_t i;
+
+	if (!gs_x_lock) {
+		return false;
+	}
+	xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+	*p_stats = gs_stats;
+	p_stats->ul_used_blocks = gs_ul_used;
+	p_stats->ul_events = gs_ul_events;
+	p_stats->ul_keys = 0;
+	for (i = 0; i < CONF_FLOG_KEYS; i++) {
+		if (gs_ul_index[i]) {
+			p_stats->ul_keys++;
+		}
+	}
+	xSemaphoreGive(gs_x_lock);
+
+	return true;
+}
+
+/** @} */
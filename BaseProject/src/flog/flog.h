@@ -0,0 +1,101 @@
+/**
+ * \file
+ *
+ * \brief Log-structured store in the internal flash.
+ *
+ */
+
+#ifndef FLOG_H_INCLUDED
+#define FLOG_H_INCLUDED
+
+#include "compiler.h"
+#include "status_codes.h"
+#include "efc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup flog_group Flash log store
+ *
+ * Values and events kept across resets in a ring of erase blocks of the
+ * internal flash, without a file system.
+ *
+ * Every change is a record appended at the head of the log: a key, a
+ * length, the data and a CRC-32. A key's latest record is its value, a RAM
+ * index gives its address at once, and the records it replaced are left
+ * behind. Events are records of key FLOG_KEY_EVENT, all kept and read back
+ * oldest first.
+ *
+ * Records gather in a RAM page, written when it is full, by flog_sync(),
+ * or by the background task CONF_FLOG_SYNC_MS after the first one. A page
+ * is programmed only once: a page written before it is full leaves the
+ * rest unused. The background task also compacts the log while fewer than
+ * CONF_FLOG_GC_FREE blocks are free: the latest values of the oldest block
+ * are copied to the head, written, and then the block is erased. Events
+ * are not copied, the oldest ones are lost this way. As the blocks are
+ * used in turn, they wear evenly.
+ *
+ * At power loss, the records not written yet are lost, the others stay:
+ * - A block is only used once its header, with a sequence number and a
+ *   CRC, is written along with its first page. The log is the longest run
+ *   of consecutive sequence numbers ending at the highest.
+ * - A page cut short is read up to its first bad record, and the next
+ *   page is written after it.
+ * - The copies of a compaction are written before the erase, and win over
+ *   their original as they come later in the log.
+ *
+ * The functions are for tasks. Flash commands mask the interrupts, see
+ * \ref sam_drivers_efc_group.
+ *
+ * @{
+ */
+
+/** Key of the events. */
+#define FLOG_KEY_EVENT          0
+
+/** Longest value or event, in bytes. */
+#define FLOG_DATA_MAX           (EFC_PAGE_SIZE - 12 - 8)
+
+/** Event reader callback, \a p_data is valid during the call only. */
+typedef void (*flog_event_reader_t)(const void *p_data, uint16_t us_len,
+		void *p_ctx);
+
+/** Store statistics. */
+typedef struct flog_stats {
+	/** Blocks, and blocks holding the log. */
+	uint32_t ul_blocks;
+	uint32_t ul_used_blocks;
+	/** Keys with a value, and events kept. */
+	uint32_t ul_keys;
+	uint32_t ul_events;
+	/** Record bytes appended, and copied by the compaction. */
+	uint32_t ul_append_bytes;
+	uint32_t ul_copy_bytes;
+	/** Pages written, blocks erased and compactions since the start. */
+	uint32_t ul_pages;
+	uint32_t ul_erases;
+	uint32_t ul_compactions;
+	/** Pages found cut short by a bad record at start. */
+	uint32_t ul_bad_pages;
+	/** Flash command failures. */
+	uint32_t ul_errors;
+} flog_stats_t;
+
+bool flog_init(void);
+status_code_t flog_set(uint16_t us_key, const void *p_data, uint16_t us_len);
+bool flog_get(uint16_t us_key, void *p_buf, uint16_t *p_us_len);
+status_code_t flog_delete(uint16_t us_key);
+status_code_t flog_event(const void *p_data, uint16_t us_len);
+uint32_t flog_read_events(flog_event_reader_t reader, void *p_ctx);
+status_code_t flog_sync(void);
+bool flog_get_stats(flog_stats_t *p_stats);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FLOG_H_INCLUDED */
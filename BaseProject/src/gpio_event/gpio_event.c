@@ -0,0 +1,245 @@
+/**
+ * \file
+ *
+ * \brief Deferred, timestamped GPIO events.
+ *
+ */
+
+#include <asf.h>
+#include "conf_gpio_event.h"
+#include "cycles.h"
+#include "gpio_event.h"
+
+/**
+ * \addtogroup gpio_event_group
+ *
+ * @{
+ */
+
+#if (CONF_GPIO_EVENT_RING_SIZE & (CONF_GPIO_EVENT_RING_SIZE - 1))
+#  error "CONF_GPIO_EVENT_RING_SIZE must be a power of two"
+#endif
+
+/** A registered pin. */
+struct gpio_event_slot {
+	gpio_event_callback_t callback;
+	void *p_ctx;
+	Pio *p_pio;
+	uint32_t ul_mask;
+	uint32_t ul_pin;
+};
+
+/** Ring entry, kept to 8 bytes. */
+struct gpio_event_entry {
+	uint32_t ul_stamp;
+	uint8_t uc_slot;
+	uint8_t uc_pin;
+	uint8_t uc_level;
+};
+
+static struct gpio_event_slot gs_slots[CONF_GPIO_EVENT_MAX_PINS] DTCM_BSS;
+
+/* Written by the PIO interrupts only (head) and the consumer only (tail). */
+static struct gpio_event_entry gs_ring[CONF_GPIO_EVENT_RING_SIZE] DTCM_BSS;
+static volatile uint32_t gs_ul_head;
+static volatile uint32_t gs_ul_tail;
+
+/** Set once the consumer has been notified, cleared when it starts draining. */
+static volatile bool gs_b_wake_pending;
+
+static TaskHandle_t gs_x_task;
+static StackType_t gs_stack[CONF_GPIO_EVENT_STACK_SIZE] DTCM_BSS;
+static gpio_event_stats_t gs_stats;
+
+/**
+ * \brief PIO interrupt callback of every registered pin.
+ */
+ITCM_FUNC static void gpio_event_isr(uint32_t ul_id, uint32_t ul_mask,
+		const pio_handler_snapshot_t *p_snapshot, void *p_ctx)
+{
+	uint32_t ul_slot = (uint32_t)p_ctx;
+	struct gpio_event_slot *p_slot = &gs_slots[ul_slot];
+	uint32_t ul_head = gs_ul_head;
+	BaseType_t x_woken = pdFALSE;
+
+	UNUSED(ul_id);
+
+	if (ul_head - gs_ul_tail >= CONF_GPIO_EVENT_RING_SIZE) {
+		gs_stats.ul_overruns++;
+	} else {
+		struct gpio_event_entry *p_entry =
+				&gs_ring[ul_head & (CONF_GPIO_EVENT_RING_SIZE - 1)];
+
+		p_entry->ul_stamp = p_snapshot->ul_cycles;
+		p_entry->uc_slot = (uint8_t)ul_slot;
+		p_entry->uc_pin = (uint8_t)p_slot->ul_pin;
+		p_entry->uc_level = (p_snapshot->ul_levels & ul_mask) != 0;
+		/* Publish the entry after its content. */
+		__DMB();
+		gs_ul_head = ul_head + 1;
+		gs_stats.ul_events++;
+	}
+
+	if (!gs_b_wake_pending) {
+		gs_b_wake_pending = true;
+		vTaskNotifyGiveFromISR(gs_x_task, &x_woken);
+		portEND_SWITCHING_ISR(x_woken);
+	}
+}
+
+/**
+ * \brief Consumer task, runs the callbacks of a whole batch of events per
+ * notification.
+ */
+static void gpio_event_task(void *pvParameters)
+{
+	UNUSED(pvParameters);
+
+	for (;;) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		gs_stats.ul_wakeups++;
+		gs_b_wake_pending = false;
+		__DMB();
+
+		while (gs_ul_tail != gs_ul_head) {
+			uint32_t ul_tail = gs_ul_tail;
+			struct gpio_event_entry *p_entry =
+					&gs_ring[ul_tail & (CONF_GPIO_EVENT_RING_SIZE - 1)];
+			struct gpio_event_slot *p_slot = &gs_slots[p_entry->uc_slot];
+			gpio_event_callback_t callback = p_slot->callback;
+			gpio_event_t event;
+
+			event.ul_stamp = p_entry->ul_stamp;
+			event.ul_pin = p_entry->uc_pin;
+			event.b_level = p_entry->uc_level;
+			/* Free the entry before running the callback. */
+			__DMB();
+			gs_ul_tail = ul_tail + 1;
+
+			/* Skip events of a pin unregistered in the meantime. */
+			if (callback && p_slot->ul_pin == event.ul_pin) {
+				callback(&event, p_slot->p_ctx);
+			}
+		}
+	}
+}
+
+/**
+ * \brief Start the consumer task and the cycle counter used for
+ * timestamps. Call once before gpio_event_register().
+ *
+ * \return true on success, false if the task could not be created.
+ */
+bool gpio_event_init(void)
+{
+	cycle_counter_enable();
+
+	return xTaskGenericCreate(gpio_event_task, "GPIO Evt",
+			CONF_GPIO_EVENT_STACK_SIZE, NULL,
+			CONF_GPIO_EVENT_TASK_PRIORITY, &gs_x_task, gs_stack,
+			NULL) == pdPASS;
+}
+
+/**
+ * \brief Record the edges of a pin and run a callback for each of them
+ * from the consumer task.
+ *
+ * The pin must already be configured as an input. Its PIO controller
+ * interrupt is enabled with CONF_GPIO_EVENT_IRQ_PRIORITY.
+ *
+ * \param ul_pin Pin index (PIO_Pxy_IDX).
+ * \param ul_attr Interrupt mode: PIO_IT_EDGE for both edges, or one of
+ * PIO_IT_RISE_EDGE, PIO_IT_FALL_EDGE, PIO_IT_HIGH_LEVEL, PIO_IT_LOW_LEVEL.
+ * \param filter Input filter.
+ * \param ul_debounce_hz Debounce cut-off frequency, for GPIO_EVENT_DEBOUNCE.
+ * \param callback Event callback.
+ * \param p_ctx Passed back to \a callback.
+ *
+ * \return true on success, false if all slots are in use.
+ */
+bool gpio_event_register(uint32_t ul_pin, uint32_t ul_attr,
+		enum gpio_event_filter filter, uint32_t ul_debounce_hz,
+		gpio_event_callback_t callback, void *p_ctx)
+{
+	Pio *p_pio = pio_get_pin_group(ul_pin);
+	uint32_t ul_mask = pio_get_pin_group_mask(ul_pin);
+	uint32_t ul_id = pio_get_pin_group_id(ul_pin);
+	uint32_t ul_slot;
+
+	taskENTER_CRITICAL();
+	for (ul_slot = 0; ul_slot < CONF_GPIO_EVENT_MAX_PINS; ul_slot++) {
+		if (!gs_slots[ul_slot].callback) {
+			break;
+		}
+	}
+	if (ul_slot == CONF_GPIO_EVENT_MAX_PINS) {
+		taskEXIT_CRITICAL();
+		return false;
+	}
+	gs_slots[ul_slot].p_ctx = p_ctx;
+	gs_slots[ul_slot].p_pio = p_pio;
+	gs_slots[ul_slot].ul_mask = ul_mask;
+	gs_slots[ul_slot].ul_pin = ul_pin;
+	gs_slots[ul_slot].callback = callback;
+	taskEXIT_CRITICAL();
+
+	switch (filter) {
+	case GPIO_EVENT_GLITCH:
+		p_pio->PIO_IFSCDR = ul_mask;
+		p_pio->PIO_IFER = ul_mask;
+		break;
+
+	case GPIO_EVENT_DEBOUNCE:
+		pio_set_debounce_filter(p_pio, ul_mask, ul_debounce_hz);
+		p_pio->PIO_IFER = ul_mask;
+		break;
+
+	default:
+		p_pio->PIO_IFDR = ul_mask;
+		break;
+	}
+
+	pmc_enable_periph_clk(ul_id);
+	pio_handler_set_pin_ctx(ul_pin, ul_attr, gpio_event_isr,
+			(void *)ul_slot);
+	/* PIO peripheral IDs are also their interrupt numbers. */
+	pio_handler_set_priority(p_pio, (IRQn_Type)ul_id,
+			CONF_GPIO_EVENT_IRQ_PRIORITY);
+	pio_enable_interrupt(p_pio, ul_mask);
+
+	return true;
+}
+
+/**
+ * \brief Stop recording the edges of a pin. Events of the pin still in the
+ * ring are discarded.
+ *
+ * \param ul_pin Pin index given to gpio_event_register().
+ */
+void gpio_event_unregister(uint32_t ul_pin)
+{
+	uint32_t ul_slot;
+
+	pio_handler_unset_pin(ul_pin);
+
+	taskENTER_CRITICAL();
+	for (ul_slot = 0; ul_slot < CONF_GPIO_EVENT_MAX_PINS; ul_slot++) {
+		if (gs_slots[ul_slot].callback &&
+				gs_slots[ul_slot].ul_pin == ul_pin) {
+			gs_slots[ul_slot].callback = NULL;
+		}
+	}
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * \brief Get a snapshot of the event statistics.
+ */
+void gpio_event_get_stats(gpio_event_stats_t *p_stats)
+{
+	taskENTER_CRITICAL();
+	*p_stats = gs_stats;
+	taskEXIT_CRITICAL();
+}
+
+/** @} */
@@ -0,0 +1,92 @@
+/**
+ * \file
+ *
+ * \brief Deferred, timestamped GPIO events.
+ *
+ */
+
+#ifndef GPIO_EVENT_H_INCLUDED
+#define GPIO_EVENT_H_INCLUDED
+
+#include "compiler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup gpio_event_group GPIO events
+ *
+ * The PIO interrupt only records each edge as a (pin, level, timestamp)
+ * event into a lock-free ring; a single consumer task then runs the pin
+ * callbacks. The task is notified once per batch, when the first event
+ * lands in a ring it has already drained, so a burst of edges costs one
+ * task switch.
+ *
+ * The timestamp is the core cycle counter (DWT_CYCCNT) read at the start
+ * of the PIO interrupt and the level is the pin level read at the same
+ * time, once for all the pins pending in that interrupt, see
+ * pio_handler_snapshot_t. If the ring is full, events are dropped and
+ * counted.
+ *
+ * The ring, the pin table and the consumer task stack are kept in the DTCM,
+ * and the interrupt callback runs from the ITCM.
+ *
+ * Input filtering is done in hardware by the PIO:
+ * - GPIO_EVENT_GLITCH rejects pulses shorter than half a peripheral clock
+ *   period;
+ * - GPIO_EVENT_DEBOUNCE rejects pulses shorter than half a period of the
+ *   divided slow clock. The divider is shared by all the pins of a PIO
+ *   controller, so the last cut-off frequency set on a controller applies
+ *   to all its debounced pins.
+ *
+ * @{
+ */
+
+/** Input filters. */
+enum gpio_event_filter {
+	GPIO_EVENT_NO_FILTER,
+	GPIO_EVENT_GLITCH,
+	GPIO_EVENT_DEBOUNCE,
+};
+
+/** One recorded edge. */
+typedef struct gpio_event {
+	/** Core cycle count at interrupt time. */
+	uint32_t ul_stamp;
+	/** Pin index (PIO_Pxy_IDX). */
+	uint32_t ul_pin;
+	/** Pin level at interrupt time. */
+	bool b_level;
+} gpio_event_t;
+
+/**
+ * Event callback, run by the consumer task.
+ */
+typedef void (*gpio_event_callback_t)(const gpio_event_t *p_event,
+		void *p_ctx);
+
+/** Event statistics. */
+typedef struct gpio_event_stats {
+	/** Events recorded. */
+	uint32_t ul_events;
+	/** Events dropped because the ring was full. */
+	uint32_t ul_overruns;
+	/** Consumer task wake-ups. */
+	uint32_t ul_wakeups;
+} gpio_event_stats_t;
+
+bool gpio_event_init(void);
+bool gpio_event_register(uint32_t ul_pin, uint32_t ul_attr,
+		enum gpio_event_filter filter, uint32_t ul_debounce_hz,
+		gpio_event_callback_t callback, void *p_ctx);
+void gpio_event_unregister(uint32_t ul_pin);
+void gpio_event_get_stats(gpio_event_stats_t *p_stats);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GPIO_EVENT_H_INCLUDED */
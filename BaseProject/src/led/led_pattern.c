@@ -0,0 +1,455 @@
+/**
+ * \file
+ *
+ * \brief PWM driven LED patterns.
+ *
+ */
+
+#include <asf.h>
+#include "conf_led_pattern.h"
+#include "clock_scale.h"
+#include "led_pattern.h"
+
+/**
+ * \addtogroup led_pattern_group
+ *
+ * @{
+ */
+
+#if (CONF_LED_PATTERN_PWM_HZ % CONF_LED_PATTERN_STEP_HZ)
+#  error "CONF_LED_PATTERN_STEP_HZ must divide CONF_LED_PATTERN_PWM_HZ"
+#endif
+
+/** Dimming carrier period, one clock per level. */
+#define LED_PATTERN_LEVELS      255
+/** CLKB frequency: blink periods are counted in ms. */
+#define LED_PATTERN_BLINK_HZ    1000
+/** Longest blink period, in ms. */
+#define LED_PATTERN_BLINK_MAX   0xFFFF
+/** Carrier periods per program step. */
+#define LED_PATTERN_DIV \
+	(CONF_LED_PATTERN_PWM_HZ / CONF_LED_PATTERN_STEP_HZ)
+
+/** Blink code timing, in ms. */
+#define LED_PATTERN_CODE_ON     200
+#define LED_PATTERN_CODE_OFF    300
+#define LED_PATTERN_CODE_PAUSE  1500
+
+/** Room for the generated programs: a blink code, or a breath. */
+#define LED_PATTERN_STEPS_MAX   (2 * CONF_LED_PATTERN_CODE_MAX)
+
+static const led_step_t gs_heartbeat[] = {
+	LED_STEP(255, 80),
+	LED_STEP(0, 120),
+	LED_STEP(255, 80),
+	LED_STEP(0, 720),
+};
+
+#if defined(CONF_BOARD_PWM_LED0) || defined(CONF_BOARD_PWM_LED1)
+
+/** Engine state of one LED. */
+struct led_pattern_state {
+	pwm_channel_t channel;
+	/** Program being played, NULL when the channel runs on its own. */
+	const led_step_t *volatile p_steps;
+	uint32_t ul_count;
+	uint32_t ul_index;
+	/** Carrier periods left before the next step tick. */
+	uint32_t ul_div;
+	/** Ticks left in, and length of, the current step. */
+	uint32_t ul_ticks;
+	uint32_t ul_total;
+	/** Ramp start level, target level and current level. */
+	uint8_t uc_from;
+	uint8_t uc_to;
+	uint8_t uc_level;
+	bool b_ramp;
+	/** Generated program, for blink codes and breathing. */
+	led_step_t steps[LED_PATTERN_STEPS_MAX];
+};
+
+static struct led_pattern_state gs_leds[LED_PATTERN_NUM] = {
+#ifdef CONF_BOARD_PWM_LED0
+	{ .channel = { .channel = PIN_PWM_LED0_CHANNEL } },
+#endif
+#ifdef CONF_BOARD_PWM_LED1
+	{ .channel = { .channel = PIN_PWM_LED1_CHANNEL } },
+#endif
+};
+
+/**
+ * \brief Duty cycle of a perceived brightness level.
+ */
+static inline uint32_t led_pattern_duty(uint32_t ul_level)
+{
+	return (ul_level * ul_level + LED_PATTERN_LEVELS - 1) /
+			LED_PATTERN_LEVELS;
+}
+
+/**
+ * \brief Stop the program of a LED and the interrupt feeding it.
+ */
+static void led_pattern_stop(struct led_pattern_state *p_led)
+{
+	pwm_channel_disable_interrupt(CONF_LED_PATTERN_PWM,
+			p_led->channel.channel, 0);
+	p_led->p_steps = NULL;
+}
+
+/**
+ * \brief Restart a stopped channel with a new clock, period and duty cycle.
+ */
+static void led_pattern_setup(struct led_pattern_state *p_led,
+		uint32_t ul_prescaler, uint32_t ul_period, uint32_t ul_duty)
+{
+	pwm_channel_disable(CONF_LED_PATTERN_PWM, p_led->channel.channel);
+	p_led->channel.ul_prescaler = ul_prescaler;
+	p_led->channel.ul_period = ul_period;
+	p_led->channel.ul_duty = ul_duty;
+	pwm_channel_init(CONF_LED_PATTERN_PWM, &p_led->channel);
+	pwm_channel_enable(CONF_LED_PATTERN_PWM, p_led->channel.channel);
+}
+
+/**
+ * \brief Move a program one tick forward and update the duty cycle.
+ */
+static void led_pattern_step(struct led_pattern_state *p_led)
+{
+	uint32_t ul_level;
+
+	if (!p_led->ul_ticks) {
+		const led_step_t *p_step = &p_led->p_steps[p_led->ul_index];
+
+		if (++p_led->ul_index == p_led->ul_count) {
+			p_led->ul_index = 0;
+		}
+		p_led->uc_from = p_led->uc_level;
+		p_led->uc_to = p_step->uc_level;
+		p_led->b_ramp = p_step->uc_ramp != 0;
+		p_led->ul_total = (uint32_t)p_step->us_ms *
+				CONF_LED_PATTERN_STEP_HZ / 1000;
+		if (!p_led->ul_total) {
+			p_led->ul_total = 1;
+		}
+		p_led->ul_ticks = p_led->ul_total;
+	}
+	p_led->ul_ticks--;
+
+	ul_level = p_led->uc_to;
+	if (p_led->b_ramp) {
+		int32_t l_delta = (int32_t)p_led->uc_from - (int32_t)p_led->uc_to;
+
+		ul_level += l_delta * (int32_t)p_led->ul_ticks /
+				(int32_t)p_led->ul_total;
+	}
+	p_led->uc_level = (uint8_t)ul_level;
+	CONF_LED_PATTERN_PWM->PWM_CH_NUM[p_led->channel.channel].PWM_CDTYUPD =
+			led_pattern_duty(ul_level);
+}
+
+/**
+ * \brief PWM interrupt handler: end of a carrier period on a channel playing
+ * a program.
+ */
+void CONF_LED_PATTERN_PWM_Handler(void)
+{
+	uint32_t ul_status = pwm_channel_get_interrupt_status(
+			CONF_LED_PATTERN_PWM) &
+			pwm_channel_get_interrupt_mask(CONF_LED_PATTERN_PWM);
+	uint32_t i;
+
+	for (i = 0; i < LED_PATTERN_NUM; i++) {
+		struct led_pattern_state *p_led = &gs_leds[i];
+
+		if (!(ul_status & (1u << p_led->channel.channel)) ||
+				!p_led->p_steps) {
+			continue;
+		}
+		if (--p_led->ul_div) {
+			continue;
+		}
+		p_led->ul_div = LED_PATTERN_DIV;
+		led_pattern_step(p_led);
+	}
+}
+
+/**
+ * \brief Regenerate CLKA and CLKB once MCK has moved.
+ */
+static void led_pattern_clock_changed(enum clock_scale_event event,
+		const clock_scale_freq_t *p_freq, void *p_ctx)
+{
+	pwm_clock_t clock = {
+		.ul_clka = CONF_LED_PATTERN_PWM_HZ * LED_PATTERN_LEVELS,
+		.ul_clkb = LED_PATTERN_BLINK_HZ,
+		.ul_mck = p_freq->ul_mck_hz,
+	};
+
+	UNUSED(p_ctx);
+
+	if (event == CLOCK_SCALE_POST_CHANGE) {
+		pwm_init(CONF_LED_PATTERN_PWM, &clock);
+	}
+}
+
+static struct clock_scale_notifier gs_clock_notifier = {
+	.callback = led_pattern_clock_changed,
+};
+
+/**
+ * \brief Set up the PWM clocks and start the LEDs off.
+ *
+ * \return true on success, false if the PWM clocks cannot be reached from
+ * the peripheral clock.
+ */
+bool led_pattern_init(void)
+{
+	pwm_clock_t clock = {
+		.ul_clka = CONF_LED_PATTERN_PWM_HZ * LED_PATTERN_LEVELS,
+		.ul_clkb = LED_PATTERN_BLINK_HZ,
+		.ul_mck = clock_scale_get_peripheral_hz(),
+	};
+	uint32_t i;
+
+	pmc_enable_periph_clk(CONF_LED_PATTERN_PWM_ID);
+	for (i = 0; i < LED_PATTERN_NUM; i++) {
+		pwm_channel_disable(CONF_LED_PATTERN_PWM, gs_leds[i].channel.channel);
+	}
+	if (pwm_init(CONF_LED_PATTERN_PWM, &clock)) {
+		return false;
+	}
+
+	for (i = 0; i < LED_PATTERN_NUM; i++) {
+		struct led_pattern_state *p_led = &gs_leds[i];
+
+		p_led->channel.alignment = PWM_ALIGN_LEFT;
+		p_led->channel.polarity = CONF_LED_PATTERN_POLARITY;
+		led_pattern_stop(p_led);
+		led_pattern_setup(p_led, PWM_CMR_CPRE_CLKA, LED_PATTERN_LEVELS, 0);
+	}
+	(void)pwm_channel_get_interrupt_status(CONF_LED_PATTERN_PWM);
+
+	NVIC_ClearPendingIRQ(CONF_LED_PATTERN_PWM_IRQn);
+	NVIC_SetPriority(CONF_LED_PATTERN_PWM_IRQn, CONF_LED_PATTERN_IRQ_PRIORITY);
+	NVIC_EnableIRQ(CONF_LED_PATTERN_PWM_IRQn);
+
+	clock_scale_register(&gs_clock_notifier);
+
+	return true;
+}
+
+/**
+ * \brief Light a LED at a steady level.
+ *
+ * \param ul_led LED (enum led_pattern_led).
+ * \param uc_level Brightness, 0 for off.
+ *
+ * \return false if \a ul_led is not a PWM LED.
+ */
+bool led_pattern_set(uint32_t ul_led, uint8_t uc_level)
+{
+	struct led_pattern_state *p_led;
+
+	if (ul_led >= LED_PATTERN_NUM) {
+		return false;
+	}
+	p_led = &gs_leds[ul_led];
+	led_pattern_stop(p_led);
+	p_led->uc_level = uc_level;
+	if (p_led->channel.ul_prescaler == PWM_CMR_CPRE_CLKA) {
+		pwm_channel_update_duty(CONF_LED_PATTERN_PWM, &p_led->channel,
+				led_pattern_duty(uc_level));
+	} else {
+		led_pattern_setup(p_led, PWM_CMR_CPRE_CLKA, LED_PATTERN_LEVELS,
+				led_pattern_duty(uc_level));
+	}
+	return true;
+}
+
+/**
+ * \brief Blink a LED at full brightness, in hardware.
+ *
+ * \param ul_led LED (enum led_pattern_led).
+ * \param ul_on_ms Time on.
+ * \param ul_off_ms Time off.
+ *
+ * \return false if \a ul_led is not a PWM LED or the period is zero or longer
+ * than 65535 ms.
+ */
+bool led_pattern_blink(uint32_t ul_led, uint32_t ul_on_ms,
+		uint32_t ul_off_ms)
+{
+	struct led_pattern_state *p_led;
+	uint32_t ul_period = ul_on_ms + ul_off_ms;
+
+	if (ul_led >= LED_PATTERN_NUM || !ul_period ||
+			ul_period > LED_PATTERN_BLINK_MAX ||
+			ul_on_ms > LED_PATTERN_BLINK_MAX) {
+		return false;
+	}
+	p_led = &gs_leds[ul_led];
+	led_pattern_stop(p_led);
+	p_led->uc_level = 0;
+	led_pattern_setup(p_led, PWM_CMR_CPRE_CLKB, ul_period, ul_on_ms);
+	return true;
+}
+
+/**
+ * \brief Play a program on a LED, looping over its steps.
+ *
+ * \param ul_led LED (enum led_pattern_led).
+ * \param p_steps Steps, which must stay valid while they are played.
+ * \param ul_count Number of steps.
+ *
+ * \return false if \a ul_led is not a PWM LED or the program is empty.
+ */
+bool led_pattern_play(uint32_t ul_led, const led_step_t *p_steps,
+		uint32_t ul_count)
+{
+	struct led_pattern_state *p_led;
+
+	if (ul_led >= LED_PATTERN_NUM || !p_steps || !ul_count) {
+		return false;
+	}
+	p_led = &gs_leds[ul_led];
+	led_pattern_stop(p_led);
+	if (p_led->channel.ul_prescaler != PWM_CMR_CPRE_CLKA) {
+		led_pattern_setup(p_led, PWM_CMR_CPRE_CLKA, LED_PATTERN_LEVELS, 0);
+		p_led->uc_level = 0;
+	}
+
+	p_led->ul_count = ul_count;
+	p_led->ul_index = 0;
+	p_led->ul_ticks = 0;
+	p_led->ul_div = LED_PATTERN_DIV;
+	p_led->p_steps = p_steps;
+	led_pattern_step(p_led);
+
+	pwm_channel_enable_interrupt(CONF_LED_PATTERN_PWM,
+			p_led->channel.channel, 0);
+	return true;
+}
+
+/**
+ * \brief Fade a LED in and out.
+ *
+ * \param ul_led LED (enum led_pattern_led).
+ * \param ul_period_ms Length of one breath, 2 ms to 131070 ms.
+ *
+ * \return false if \a ul_led is not a PWM LED or the period is out of range.
+ */
+bool led_pattern_breathe(uint32_t ul_led, uint32_t ul_period_ms)
+{
+	led_step_t *p_steps;
+
+	if (ul_led >= LED_PATTERN_NUM || ul_period_ms < 2 ||
+			ul_period_ms > 2 * 0xFFFF) {
+		return false;
+	}
+	p_steps = gs_leds[ul_led].steps;
+	led_pattern_stop(&gs_leds[ul_led]);
+	p_steps[0] = (led_step_t)LED_RAMP(255, ul_period_ms / 2);
+	p_steps[1] = (led_step_t)LED_RAMP(0, ul_period_ms - ul_period_ms / 2);
+	return led_pattern_play(ul_led, p_steps, 2);
+}
+
+/**
+ * \brief Repeat a blink code: \a ul_count short flashes, then a pause.
+ *
+ * \param ul_led LED (enum led_pattern_led).
+ * \param ul_count Number of flashes, 1 to CONF_LED_PATTERN_CODE_MAX.
+ *
+ * \return false if \a ul_led is not a PWM LED or the count is out of range.
+ */
+bool led_pattern_code(uint32_t ul_led, uint32_t ul_count)
+{
+	led_step_t *p_steps;
+	uint32_t i;
+
+	if (ul_led >= LED_PATTERN_NUM || !ul_count ||
+			ul_count > CONF_LED_PATTERN_CODE_MAX) {
+		return false;
+	}
+	p_steps = gs_leds[ul_led].steps;
+	led_pattern_stop(&gs_leds[ul_led]);
+	for (i = 0; i < ul_count; i++) {
+		p_steps[2 * i] = (led_step_t)LED_STEP(255, LED_PATTERN_CODE_ON);
+		p_steps[2 * i + 1] = (led_step_t)LED_STEP(0, LED_PATTERN_CODE_OFF);
+	}
+	p_steps[2 * ul_count - 1].us_ms += LED_PATTERN_CODE_PAUSE;
+	return led_pattern_play(ul_led, p_steps, 2 * ul_count);
+}
+
+#else /* no PWM LED */
+
+bool led_pattern_init(void)
+{
+	return true;
+}
+
+bool led_pattern_set(uint32_t ul_led, uint8_t uc_level)
+{
+	UNUSED(ul_led);
+	UNUSED(uc_level);
+	return false;
+}
+
+bool led_pattern_blink(uint32_t ul_led, uint32_t ul_on_ms,
+		uint32_t ul_off_ms)
+{
+	UNUSED(ul_led);
+	UNUSED(ul_on_ms);
+	UNUSED(ul_off_ms);
+	return false;
+}
+
+bool led_pattern_play(uint32_t ul_led, const led_step_t *p_steps,
+		uint32_t ul_count)
+{
+	UNUSED(ul_led);
+	UNUSED(p_steps);
+	UNUSED(ul_count);
+	return false;
+}
+
+bool led_pattern_breathe(uint32_t ul_led, uint32_t ul_period_ms)
+{
+	UNUSED(ul_led);
+	UNUSED(ul_period_ms);
+	return false;
+}
+
+bool led_pattern_code(uint32_t ul_led, uint32_t ul_count)
+{
+	UNUSED(ul_led);
+	UNUSED(ul_count);
+	return false;
+}
+
+#endif
+
+/**
+ * \brief Show a preset pattern on a LED.
+ *
+ * \param ul_led LED (enum led_pattern_led).
+ * \param status Pattern.
+ *
+ * \return false if \a ul_led is not a PWM LED.
+ */
+bool led_pattern_status(uint32_t ul_led, enum led_status status)
+{
+	switch (status) {
+	case LED_STATUS_HEARTBEAT:
+		return led_pattern_play(ul_led, gs_heartbeat,
+				sizeof(gs_heartbeat) / sizeof(gs_heartbeat[0]));
+	case LED_STATUS_IDLE:
+		return led_pattern_breathe(ul_led, 4000);
+	case LED_STATUS_BUSY:
+		return led_pattern_blink(ul_led, 50, 50);
+	case LED_STATUS_FAULT:
+	default:
+		return led_pattern_set(ul_led, 255);
+	}
+}
+
+/** @} */
@@ -0,0 +1,90 @@
+/**
+ * \file
+ *
+ * \brief PWM driven LED patterns.
+ *
+ */
+
+#ifndef LED_PATTERN_H_INCLUDED
+#define LED_PATTERN_H_INCLUDED
+
+#include "compiler.h"
+#include "conf_board.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup led_pattern_group LED patterns
+ *
+ * Brightness patterns on the LEDs wired to PWM outputs (CONF_BOARD_PWM_LED0
+ * and CONF_BOARD_PWM_LED1), without a task:
+ * - steady levels and plain blinking are left to the PWM channel alone: a
+ *   blink is one PWM period of up to 65 seconds, clocked at 1 kHz by CLKB;
+ * - step programs (breathing, blink codes, status patterns) run on a
+ *   CONF_LED_PATTERN_PWM_HZ dimming carrier clocked by CLKA, whose duty
+ *   cycle is rewritten by the PWM period interrupt every
+ *   1 / CONF_LED_PATTERN_STEP_HZ second.
+ *
+ * Levels are perceived brightness, 0 to 255, and go through a square law
+ * before becoming a duty cycle.
+ *
+ * @{
+ */
+
+/** LEDs driven by the engine. */
+enum led_pattern_led {
+#ifdef CONF_BOARD_PWM_LED0
+	LED_PATTERN_LED0,
+#endif
+#ifdef CONF_BOARD_PWM_LED1
+	LED_PATTERN_LED1,
+#endif
+	LED_PATTERN_NUM
+};
+
+/** One step of a program. */
+typedef struct led_step {
+	/** Level reached by the step. */
+	uint8_t uc_level;
+	/** Non-zero to ramp from the previous level, else jump to it. */
+	uint8_t uc_ramp;
+	/** Step duration, in ms. */
+	uint16_t us_ms;
+} led_step_t;
+
+/** Step that jumps to \a level and holds it for \a ms. */
+#define LED_STEP(level, ms)     { (level), 0, (ms) }
+/** Step that ramps to \a level over \a ms. */
+#define LED_RAMP(level, ms)     { (level), 1, (ms) }
+
+/** Preset patterns. */
+enum led_status {
+	/** Double pulse every second: running. */
+	LED_STATUS_HEARTBEAT,
+	/** Slow breathing: idle. */
+	LED_STATUS_IDLE,
+	/** Fast blink, 10 Hz: busy. */
+	LED_STATUS_BUSY,
+	/** Steady on: fault. */
+	LED_STATUS_FAULT,
+};
+
+bool led_pattern_init(void);
+bool led_pattern_set(uint32_t ul_led, uint8_t uc_level);
+bool led_pattern_blink(uint32_t ul_led, uint32_t ul_on_ms,
+		uint32_t ul_off_ms);
+bool led_pattern_play(uint32_t ul_led, const led_step_t *p_steps,
+		uint32_t ul_count);
+bool led_pattern_breathe(uint32_t ul_led, uint32_t ul_period_ms);
+bool led_pattern_code(uint32_t ul_led, uint32_t ul_count);
+bool led_pattern_status(uint32_t ul_led, enum led_status status);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LED_PATTERN_H_INCLUDED */
@@ -56,8 +56,8 @@
  *
  * \section Description
  *
- * The demonstration program create two task, one is make LED on the board
- * blink at a fixed rate, and another is monitor status of task.
+ * The demonstration program shows a heartbeat on the board LED, driven by
+ * the PWM, and creates a task that monitors the status of the tasks.
  *
  * \section Usage
  *
@@ -91,11 +91,22 @@
 
 #include <asf.h>
 #include "conf_board.h"
+#include "conf_shell.h"
+#include "boot.h"
+#include "clock_scale.h"
+#include "console.h"
+#include "dma_buf.h"
+#include "flog.h"
+#include "led_pattern.h"
+#include "qspi_flash.h"
+#include "shell.h"
+#include "stack_guard.h"
+#include "telemetry.h"
 
 #define TASK_MONITOR_STACK_SIZE            (2048/sizeof(portSTACK_TYPE))
 #define TASK_MONITOR_STACK_PRIORITY        (tskIDLE_PRIORITY)
-#define TASK_LED_STACK_SIZE                (1024/sizeof(portSTACK_TYPE))
-#define TASK_LED_STACK_PRIORITY            (tskIDLE_PRIORITY)
+#define TASK_SHELL_STACK_SIZE              (2048/sizeof(portSTACK_TYPE))
+#define TASK_SHELL_STACK_PRIORITY          (tskIDLE_PRIORITY + 1)
 
 extern void vApplicationStackOverflowHook(xTaskHandle *pxTask,
 		signed char *pcTaskName);
@@ -120,7 +131,7 @@ void SysTick_Handler(void)
 extern void vApplicationStackOverflowHook(xTaskHandle *pxTask,
 		signed char *pcTaskName)
 {
-	printf("stack overflow %x %s\r\n", pxTask, (portCHAR *)pcTaskName);
+	printf("stack overflow %p %s\r\n", pxTask, (portCHAR *)pcTaskName);
 	/* If the parameters have been corrupted then inspect pxCurrentTCB to
 	 * identify which task has overflowed its stack.
 	 */
@@ -160,33 +171,20 @@ extern void vApplicationMallocFailedHook(void)
  */
 static void task_monitor(void *pvParameters)
 {
-	static portCHAR szList[256];
+	/* vTaskList() has no bound: size it as the shell "tasks" buffer. */
+	static portCHAR szList[CONF_SHELL_TASKS_BUF_SIZE];
 	UNUSED(pvParameters);
 
+	boot_report();
+
 	for (;;) {
 		printf("--- Number of tasks ## %u\n\r", (unsigned int)uxTaskGetNumberOfTasks());
 		vTaskList((signed portCHAR *)szList);
-		printf(szList);
+		printf("%s", szList);
 		vTaskDelay(1000);
 	}
 }
 
-/**
- * \brief This task, when activated, make LED blink at a fixed rate
- */
-static void task_led(void *pvParameters)
-{
-	UNUSED(pvParameters);
-	for (;;) {
-	#if SAM4CM
-		LED_Toggle(LED4);
-	#else
-		LED_Toggle(LED0);
-	#endif
-		vTaskDelay(100);
-	}
-}
-
 /**
  * \brief Configure the console UART.
  */
@@ -224,11 +222,54 @@ static void configure_console(void)
 int main(void)
 {
 	/* Initialize the SAM system */
+#if CONF_BOOT_FAST
+	/* The crystal started in Reset_Handler, set the board up meanwhile */
+	board_init();
+	boot_stamp(BOOT_PHASE_BOARD);
 	sysclk_init();
+	boot_stamp(BOOT_PHASE_SYSCLK);
+#else
+	sysclk_init();
+	boot_stamp(BOOT_PHASE_SYSCLK);
 	board_init();
+	boot_stamp(BOOT_PHASE_BOARD);
+#endif
+
+	/* Map the non-cacheable DMA buffer pool */
+	dma_buf_init();
+
+#if CONF_STACK_GUARD
+	/* Fault as soon as a task writes past the end of its stack */
+	stack_guard_init();
+#endif
 
 	/* Initialize the console uart */
 	configure_console();
+	console_init();
+	tlm_init();
+
+	/* Runtime clock scaling, starting at the sysclk_init() clocks */
+	if (!clock_scale_init()) {
+		printf("Failed to start clock scaling\r\n");
+	}
+
+	/* Values and events kept across resets */
+	if (!flog_init()) {
+		printf("Failed to start the flash log\r\n");
+	}
+
+	/* Serial flash, mapped for cached reads */
+	if (!qspi_flash_init()) {
+		printf("Failed to start the QSPI flash\r\n");
+	}
+
+	/* Show the heartbeat on LED0, driven by the PWM */
+	if (!led_pattern_init() ||
+			!led_pattern_status(LED_PATTERN_LED0, LED_STATUS_HEARTBEAT)) {
+		printf("Failed to start LED heartbeat\r\n");
+	}
+
+	boot_stamp(BOOT_PHASE_DRIVERS);
 
 	/* Output demo information. */
 	printf("-- Freertos Base Project v1 --\n\r");
@@ -242,13 +283,14 @@ int main(void)
 		printf("Failed to create Monitor task\r\n");
 	}
 
-	/* Create task to make led blink */
-	if (xTaskCreate(task_led, "Led 0", TASK_LED_STACK_SIZE, NULL,
-			TASK_LED_STACK_PRIORITY, NULL) != pdPASS) {
-		printf("Failed to create test led task\r\n");
+	/* Create the console shell task */
+	if (xTaskCreate(shell_task, "Shell", TASK_SHELL_STACK_SIZE, NULL,
+			TASK_SHELL_STACK_PRIORITY, NULL) != pdPASS) {
+		printf("Failed to create shell task\r\n");
 	}
 
 	/* Start the scheduler. */
+	boot_stamp(BOOT_PHASE_TASKS);
 	vTaskStartScheduler();
 
 	/* Will only get here if there was insufficient memory to create the idle task. */
@@ -0,0 +1,134 @@
+/**
+ * \file
+ *
+ * \brief Ethernet frame buffers.
+ *
+ */
+
+#include <asf.h>
+#include "conf_net.h"
+#include "dcache.h"
+#include "net_buf.h"
+
+/**
+ * \addtogroup net_buf_group
+ *
+ * @{
+ */
+
+#if (NET_BUF_SIZE % DCACHE_LINE_SIZE)
+#  error "NET_BUF_SIZE must be a multiple of the cache line size"
+#endif
+
+/* Data apart from the headers, so that cache maintenance on a buffer never
+ * touches a header. */
+static uint8_t gs_uc_data[CONF_NET_BUF_COUNT][NET_BUF_SIZE] DCACHE_ALIGNED;
+static net_buf_t gs_bufs[CONF_NET_BUF_COUNT];
+static net_buf_t *gs_p_free;
+static uint32_t gs_ul_free;
+static uint32_t gs_ul_min_free;
+static bool gs_b_ready;
+
+/**
+ * \brief Set up the pool. Called by the first allocation.
+ */
+static void net_buf_init(void)
+{
+	uint32_t i;
+
+	gs_p_free = NULL;
+	for (i = 0; i < CONF_NET_BUF_COUNT; i++) {
+		gs_bufs[i].p_next = gs_p_free;
+		gs_p_free = &gs_bufs[i];
+	}
+	gs_ul_free = CONF_NET_BUF_COUNT;
+	gs_ul_min_free = CONF_NET_BUF_COUNT;
+	gs_b_ready = true;
+}
+
+/**
+ * \brief Take a buffer from the pool.
+ *
+ * \return The buffer, empty and with its data at the start, or NULL if the
+ * pool is empty.
+ */
+net_buf_t *net_buf_alloc(void)
+{
+	net_buf_t *p_buf;
+
+	taskENTER_CRITICAL();
+	if (!gs_b_ready) {
+		net_buf_init();
+	}
+	p_buf = gs_p_free;
+	if (p_buf) {
+		gs_p_free = p_buf->p_next;
+		p_buf->p_next = NULL;
+		p_buf->p_data = gs_uc_data[p_buf - gs_bufs];
+		p_buf->us_len = 0;
+		if (--gs_ul_free < gs_ul_min_free) {
+			gs_ul_min_free = gs_ul_free;
+		}
+	}
+	taskEXIT_CRITICAL();
+	return p_buf;
+}
+
+/**
+ * \brief Give a frame back to the pool: the buffer and the ones linked to
+ * it. NULL is ignored.
+ */
+void net_buf_free(net_buf_t *p_buf)
+{
+	net_buf_t *p_next;
+
+	taskENTER_CRITICAL();
+	for (; p_buf; p_buf = p_next) {
+		p_next = p_buf->p_next;
+		p_buf->p_next = gs_p_free;
+		gs_p_free = p_buf;
+		gs_ul_free++;
+	}
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * \brief Buffer holding an address, e.g. one given back by the GMAC driver.
+ *
+ * \return The buffer, or NULL if the address is not in the pool.
+ */
+net_buf_t *net_buf_from_data(const void *p_data)
+{
+	uint32_t ul_offset = (const uint8_t *)p_data - gs_uc_data[0];
+
+	if (ul_offset >= sizeof(gs_uc_data)) {
+		return NULL;
+	}
+	return &gs_bufs[ul_offset / NET_BUF_SIZE];
+}
+
+/**
+ * \brief Start of the storage of a buffer, NET_BUF_SIZE bytes.
+ */
+uint8_t *net_buf_start(const net_buf_t *p_buf)
+{
+	return gs_uc_data[p_buf - gs_bufs];
+}
+
+/**
+ * \brief Number of buffers left in the pool.
+ */
+uint32_t net_buf_get_free(void)
+{
+	return gs_ul_free;
+}
+
+/**
+ * \brief Lowest number of buffers left in the pool since start up.
+ */
+uint32_t net_buf_get_min_free(void)
+{
+	return gs_ul_min_free;
+}
+
+/** @} */
@@ -0,0 +1,61 @@
+/**
+ * \file
+ *
+ * \brief Ethernet frame buffers.
+ *
+ */
+
+#ifndef NET_BUF_H_INCLUDED
+#define NET_BUF_H_INCLUDED
+
+#include "compiler.h"
+#include "gmac.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup net_buf_group Frame buffers
+ *
+ * A fixed pool of CONF_NET_BUF_COUNT buffers of NET_BUF_SIZE bytes, each
+ * big enough for a whole frame, cache line aligned so that the GMAC can
+ * fill and drain them in place. A received frame is handed to the stack in
+ * the buffer the GMAC wrote it to, and a frame to send is transmitted from
+ * the buffers the stack built it in: no frame is copied.
+ *
+ * A frame is one buffer, or several linked by p_next that are sent back to
+ * back (scatter-gather), e.g. a header buffer in front of a payload buffer.
+ * Whoever holds a frame owns all of its buffers and gives them back with
+ * net_buf_free().
+ *
+ * @{
+ */
+
+/** Buffer size. */
+#define NET_BUF_SIZE            GMAC_FRAME_SIZE_MAX
+
+/** A frame buffer. */
+typedef struct net_buf {
+	/** Next buffer of the same frame, or NULL. */
+	struct net_buf *p_next;
+	/** Start of the data, within the buffer. */
+	uint8_t *p_data;
+	/** Data length, in bytes. */
+	uint16_t us_len;
+} net_buf_t;
+
+net_buf_t *net_buf_alloc(void);
+void net_buf_free(net_buf_t *p_buf);
+net_buf_t *net_buf_from_data(const void *p_data);
+uint8_t *net_buf_start(const net_buf_t *p_buf);
+uint32_t net_buf_get_free(void);
+uint32_t net_buf_get_min_free(void);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_BUF_H_INCLUDED */
@@ -0,0 +1,405 @@
+/**
+ * \file
+ *
+ * \brief Ethernet interface.
+ *
+ */
+
+#include <asf.h>
+#include <string.h>
+#include "conf_net.h"
+#include "clock_scale.h"
+#include "dma_buf.h"
+#include "semphr.h"
+#include "netif.h"
+
+/**
+ * \addtogroup netif_group
+ *
+ * @{
+ */
+
+#if (CONF_NET_BUF_COUNT <= CONF_NET_RX_DESC)
+#  error "CONF_NET_BUF_COUNT must leave buffers beside the receive ring"
+#endif
+
+/** PHY registers and bits (IEEE 802.3 clause 22). */
+#define NETIF_PHY_BMCR          0
+#define NETIF_PHY_BMSR          1
+#define NETIF_PHY_ANAR          4
+#define NETIF_PHY_ANLPAR        5
+#define NETIF_BMCR_ANENABLE     (1u << 12)
+#define NETIF_BMCR_ANRESTART    (1u << 9)
+#define NETIF_BMSR_LSTATUS      (1u << 2)
+#define NETIF_AN_100FULL        (1u << 8)
+#define NETIF_AN_100HALF        (1u << 7)
+#define NETIF_AN_10FULL         (1u << 6)
+
+/** PHY reset to management access delay, in ms. */
+#define NETIF_PHY_RESET_MS      10
+
+static gmac_dev_t gs_gmac;
+static TaskHandle_t gs_x_task;
+/** Given when the transmit ring may have room again. */
+static SemaphoreHandle_t gs_x_tx;
+/** Serializes the transmit ring between senders and the task. */
+static SemaphoreHandle_t gs_x_tx_lock;
+static netif_input_t gs_input;
+static void *gs_p_input_ctx;
+static netif_stats_t gs_stats;
+
+/**
+ * \brief GMAC callback: hand the receive work to the task, wake a sender
+ * waiting for room.
+ */
+static void netif_handler(gmac_dev_t *p_dev, uint32_t ul_isr)
+{
+	BaseType_t x_woken = pdFALSE;
+
+	if (ul_isr & GMAC_IER_RCOMP) {
+		/* Back on once the task has emptied the ring. */
+		gmac_disable_interrupt(p_dev, GMAC_IER_RCOMP);
+		gs_stats.ul_rx_irqs++;
+		vTaskNotifyGiveFromISR(gs_x_task, &x_woken);
+	}
+	if (ul_isr & (GMAC_IER_TCOMP | GMAC_IER_TX_FAULTS)) {
+		gmac_disable_interrupt(p_dev, GMAC_IER_TCOMP);
+		xSemaphoreGiveFromISR(gs_x_tx, &x_woken);
+	}
+	portEND_SWITCHING_ISR(x_woken);
+}
+
+/**
+ * \brief Keep the management clock in range across clock_scale switches.
+ */
+static void netif_clock_changed(enum clock_scale_event event,
+		const clock_scale_freq_t *p_freq, void *p_ctx)
+{
+	UNUSED(p_ctx);
+
+	if (event == CLOCK_SCALE_PRE_CHANGE) {
+		/* Slow enough for both clocks during the switch. */
+		gmac_set_mdc_clock(GMAC, Max(p_freq->ul_mck_hz,
+				clock_scale_get_peripheral_hz()));
+	} else {
+		gmac_set_mdc_clock(GMAC, p_freq->ul_mck_hz);
+	}
+}
+
+static struct clock_scale_notifier gs_clock_notifier = {
+	.callback = netif_clock_changed,
+};
+
+/**
+ * \brief Give an empty buffer to the receive ring.
+ */
+static void netif_rx_give(net_buf_t *p_buf)
+{
+	uint8_t *p_start = net_buf_start(p_buf);
+
+	/* No dirty line may be written back over the frame. */
+	dma_buf_sync_for_device(p_start, NET_BUF_SIZE, DMA_BUF_FROM_DEVICE);
+	gmac_rx_refill(&gs_gmac, p_start);
+}
+
+/**
+ * \brief Pass the received frames to the stack, CONF_NET_RX_BUDGET at a
+ * time, until the ring is empty, then let the receive interrupt back on.
+ */
+static void netif_rx_poll(void)
+{
+	for (;;) {
+		uint32_t ul_done;
+
+		for (ul_done = 0; ul_done < CONF_NET_RX_BUDGET; ul_done++) {
+			net_buf_t *p_buf, *p_new;
+			uint32_t ul_len;
+			void *p_data = gmac_rx_take(&gs_gmac, &ul_len);
+
+			if (!p_data) {
+				break;
+			}
+			p_buf = net_buf_from_data(p_data);
+			p_new = ul_len ? net_buf_alloc() : NULL;
+			if (!p_new) {
+				/* Drop the frame, keep the ring full. */
+				if (ul_len) {
+					gs_stats.ul_rx_dropped++;
+				}
+				netif_rx_give(p_buf);
+				continue;
+			}
+			netif_rx_give(p_new);
+
+			dma_buf_sync_for_cpu(p_data, ul_len, DMA_BUF_FROM_DEVICE);
+			p_buf->p_next = NULL;
+			p_buf->p_data = p_data;
+			p_buf->us_len = ul_len;
+			gs_input(p_buf, gs_p_input_ctx);
+		}
+		gs_stats.ul_rx_polls++;
+
+		if (ul_done == CONF_NET_RX_BUDGET) {
+			/* More to come: stay in polling, after the tasks of the
+			 * same priority. */
+			taskYIELD();
+			continue;
+		}
+		gmac_enable_interrupt(&gs_gmac, GMAC_IER_RCOMP);
+		/* A frame completed before the interrupt was back on would not
+		 * raise it. */
+		if (!gmac_rx_pending(&gs_gmac)) {
+			break;
+		}
+		gmac_disable_interrupt(&gs_gmac, GMAC_IER_RCOMP);
+	}
+}
+
+/**
+ * \brief Give the sent frames back to the pool. The caller holds
+ * gs_x_tx_lock.
+ */
+static void netif_tx_reclaim(void)
+{
+	void *p_data;
+
+	while ((p_data = gmac_tx_reclaim(&gs_gmac)) != NULL) {
+		net_buf_free(net_buf_from_data(p_data));
+	}
+}
+
+/**
+ * \brief Read the link state from the PHY and follow its changes.
+ */
+static void netif_link_poll(void)
+{
+#if CONF_NET_LOOPBACK
+	gs_stats.b_link = true;
+	gs_stats.b_100m = true;
+	gs_stats.b_full_duplex = true;
+#else
+	uint16_t us_bmsr, us_anar, us_anlpar, us_common;
+
+	/* The link bit latches a loss: the second read is the current state. */
+	if (gmac_phy_read(GMAC, BOARD_GMAC_PHY_ADDR, NETIF_PHY_BMSR,
+			&us_bmsr) != STATUS_OK ||
+			gmac_phy_read(GMAC, BOARD_GMAC_PHY_ADDR, NETIF_PHY_BMSR,
+			&us_bmsr) != STATUS_OK) {
+		return;
+	}
+	if (!(us_bmsr & NETIF_BMSR_LSTATUS)) {
+		gs_stats.b_link = false;
+		return;
+	}
+	if (gs_stats.b_link ||
+			gmac_phy_read(GMAC, BOARD_GMAC_PHY_ADDR, NETIF_PHY_ANAR,
+			&us_anar) != STATUS_OK ||
+			gmac_phy_read(GMAC, BOARD_GMAC_PHY_ADDR, NETIF_PHY_ANLPAR,
+			&us_anlpar) != STATUS_OK) {
+		return;
+	}
+
+	/* Best mode both ends advertise. */
+	us_common = us_anar & us_anlpar;
+	gs_stats.b_100m = (us_common & (NETIF_AN_100FULL | NETIF_AN_100HALF)) != 0;
+	gs_stats.b_full_duplex = gs_stats.b_100m ?
+			(us_common & NETIF_AN_100FULL) != 0 :
+			(us_common & NETIF_AN_10FULL) != 0;
+	gmac_set_link(GMAC, gs_stats.b_100m, gs_stats.b_full_duplex);
+	gs_stats.b_link = true;
+#endif
+}
+
+/**
+ * \brief Interface task: receive polls, transmit reclaim and link state.
+ */
+static void netif_task(void *p_arg)
+{
+	TickType_t x_link_poll = xTaskGetTickCount();
+
+	UNUSED(p_arg);
+
+#if !CONF_NET_LOOPBACK
+	vTaskDelay(pdMS_TO_TICKS(NETIF_PHY_RESET_MS));
+	gmac_phy_write(GMAC, BOARD_GMAC_PHY_ADDR, NETIF_PHY_BMCR,
+			NETIF_BMCR_ANENABLE | NETIF_BMCR_ANRESTART);
+#endif
+	netif_link_poll();
+
+	for (;;) {
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONF_NET_LINK_POLL_MS));
+		netif_rx_poll();
+
+		/* Senders reclaim as they go, this is for an idle transmitter. */
+		if (xSemaphoreTake(gs_x_tx_lock, 0) == pdTRUE) {
+			netif_tx_reclaim();
+			xSemaphoreGive(gs_x_tx_lock);
+		}
+
+		if (xTaskGetTickCount() - x_link_poll >=
+				pdMS_TO_TICKS(CONF_NET_LINK_POLL_MS)) {
+			x_link_poll = xTaskGetTickCount();
+			netif_link_poll();
+		}
+	}
+}
+
+/**
+ * \brief Bring the interface up and start its task.
+ *
+ * \param input Stack input, see netif_input_t.
+ * \param p_ctx Passed to \a input.
+ *
+ * \return true on success, false if already started or out of memory.
+ */
+bool netif_init(netif_input_t input, void *p_ctx)
+{
+	static const uint8_t uc_mac[] = CONF_NET_MAC_ADDR;
+	gmac_config_t cfg;
+	uint32_t i;
+
+	if (gs_x_task || !input) {
+		return false;
+	}
+	gs_input = input;
+	gs_p_input_ctx = p_ctx;
+
+	cfg.us_rx_count = CONF_NET_RX_DESC;
+	cfg.us_tx_count = CONF_NET_TX_DESC;
+	cfg.us_rx_buf_size = NET_BUF_SIZE;
+	cfg.ul_mck_hz = clock_scale_get_peripheral_hz();
+	memcpy(cfg.uc_mac, uc_mac, sizeof(cfg.uc_mac));
+	cfg.b_rmii = true;
+	cfg.b_promiscuous = false;
+	cfg.b_loopback = CONF_NET_LOOPBACK;
+	cfg.p_desc = dma_buf_alloc(gmac_desc_size(&cfg), DMA_BUF_NOCACHE);
+	if (!cfg.p_desc) {
+		return false;
+	}
+	if (!gs_x_tx) {
+		gs_x_tx = xSemaphoreCreateBinary();
+		gs_x_tx_lock = xSemaphoreCreateMutex();
+		if (!gs_x_tx || !gs_x_tx_lock) {
+			return false;
+		}
+	}
+
+	/* RMII pins, and the PHY out of reset. */
+	pio_configure(PIN_GMAC_PIO, PIN_GMAC_PERIPH, PIN_GMAC_MASK, PIO_DEFAULT);
+	pio_configure(PIN_GMAC_RESET_PIO, PIO_OUTPUT_1, PIN_GMAC_RESET_MASK,
+			PIO_DEFAULT);
+	pmc_enable_periph_clk(ID_GMAC);
+
+	if (gmac_init(&gs_gmac, GMAC, &cfg) != STATUS_OK) {
+		return false;
+	}
+	for (i = 0; i < CONF_NET_RX_DESC; i++) {
+		net_buf_t *p_buf = net_buf_alloc();
+
+		if (!p_buf) {
+			return false;
+		}
+		netif_rx_give(p_buf);
+	}
+	gmac_set_callback(&gs_gmac, netif_handler, NULL);
+	clock_scale_register(&gs_clock_notifier);
+
+	if (xTaskCreate(netif_task, "Net", CONF_NET_TASK_STACK_SIZE, NULL,
+			CONF_NET_TASK_PRIORITY, &gs_x_task) != pdPASS) {
+		return false;
+	}
+
+	NVIC_ClearPendingIRQ(GMAC_IRQn);
+	NVIC_SetPriority(GMAC_IRQn, CONF_NET_IRQ_PRIORITY);
+	NVIC_EnableIRQ(GMAC_IRQn);
+	gmac_enable_interrupt(&gs_gmac, GMAC_IER_RCOMP | GMAC_IER_TX_FAULTS);
+	gmac_enable(&gs_gmac, true);
+
+	return true;
+}
+
+/**
+ * \brief Send a frame.
+ *
+ * The interface owns the frame from the call on: its buffers go back to
+ * the pool once sent, or right away if it cannot be queued. The buffers
+ * must not be touched meanwhile. Any task may send.
+ *
+ * \param p_frame One buffer, or up to CONF_NET_TX_SEGS_MAX linked ones.
+ * \param x_timeout Maximum time to wait for room in the transmit ring, in
+ * ticks.
+ *
+ * \return true if the frame is queued, false if it was dropped.
+ */
+bool netif_output(net_buf_t *p_frame, TickType_t x_timeout)
+{
+	gmac_seg_t segs[CONF_NET_TX_SEGS_MAX];
+	net_buf_t *p_buf;
+	uint32_t ul_count = 0;
+	bool b_queued = false;
+
+	for (p_buf = p_frame; p_buf && ul_count < CONF_NET_TX_SEGS_MAX;
+			p_buf = p_buf->p_next) {
+		segs[ul_count].p_data = p_buf->p_data;
+		segs[ul_count].ul_len = p_buf->us_len;
+		dma_buf_sync_for_device(p_buf->p_data, p_buf->us_len,
+				DMA_BUF_TO_DEVICE);
+		ul_count++;
+	}
+
+	if (gs_x_task && ul_count && !p_buf &&
+			xSemaphoreTake(gs_x_tx_lock, x_timeout) == pdTRUE) {
+		for (;;) {
+			netif_tx_reclaim();
+			xSemaphoreTake(gs_x_tx, 0);
+			if (gmac_tx_post(&gs_gmac, segs, ul_count)) {
+				gmac_tx_start(&gs_gmac);
+				b_queued = true;
+				break;
+			}
+			gmac_enable_interrupt(&gs_gmac, GMAC_IER_TCOMP);
+			/* The completion flag may have gone with an earlier
+			 * interrupt: look at the ring itself too. */
+			if (gmac_tx_done_pending(&gs_gmac)) {
+				gmac_disable_interrupt(&gs_gmac, GMAC_IER_TCOMP);
+				continue;
+			}
+			if (xSemaphoreTake(gs_x_tx, x_timeout) != pdTRUE) {
+				gmac_disable_interrupt(&gs_gmac, GMAC_IER_TCOMP);
+				break;
+			}
+		}
+		xSemaphoreGive(gs_x_tx_lock);
+	}
+
+	if (!b_queued) {
+		net_buf_free(p_frame);
+		taskENTER_CRITICAL();
+		gs_stats.ul_tx_dropped++;
+		taskEXIT_CRITICAL();
+	}
+	return b_queued;
+}
+
+/**
+ * \brief Get a snapshot of the interface statistics.
+ *
+ * \return false if the interface is not started.
+ */
+bool netif_get_stats(netif_stats_t *p_stats)
+{
+	if (!gs_x_task) {
+		return false;
+	}
+	taskENTER_CRITICAL();
+	*p_stats = gs_stats;
+	p_stats->ul_rx_frames = gs_gmac.ul_rx_frames;
+	p_stats->ul_rx_errors = gs_gmac.ul_rx_errors;
+	p_stats->ul_tx_frames = gs_gmac.ul_tx_frames;
+	p_stats->ul_tx_errors = gs_gmac.ul_tx_errors;
+	taskEXIT_CRITICAL();
+
+	return true;
+}
+
+/** @} */
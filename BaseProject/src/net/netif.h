@@ -0,0 +1,79 @@
+/**
+ * \file
+ *
+ * \brief Ethernet interface.
+ *
+ */
+
+#ifndef NETIF_H_INCLUDED
+#define NETIF_H_INCLUDED
+
+#include "compiler.h"
+#include "FreeRTOS.h"
+#include "net_buf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup netif_group Ethernet interface
+ *
+ * Runs the GMAC with the PHY of the board and passes frames between it and
+ * a network stack, in \ref net_buf_group buffers, without copying them.
+ *
+ * A task owns the receive ring. The receive interrupt only wakes it and
+ * turns itself off; the task then takes up to CONF_NET_RX_BUDGET frames at
+ * a time, refilling the ring with fresh buffers as it goes, and turns the
+ * interrupt back on once the ring is empty. Under load the interrupt stays
+ * off and frames are picked up in batches, one interrupt per burst rather
+ * than per frame. A frame is dropped, and its buffer put straight back in
+ * the ring, when the pool has no buffer to replace it.
+ *
+ * netif_output() sends a frame, possibly made of several buffers, and
+ * takes ownership of it in all cases. Sent buffers are given back to the
+ * pool as transmit descriptors are needed and by the task, so there is no
+ * transmit interrupt except while a sender waits for a full ring.
+ *
+ * The task also follows the PHY link state and sets the MAC speed and
+ * duplex from the autonegotiation result. With CONF_NET_LOOPBACK the MAC
+ * loops frames back internally and the link is always up.
+ *
+ * @{
+ */
+
+/**
+ * Stack input, run by the interface task with each frame received. The
+ * callee owns the frame and frees it with net_buf_free().
+ */
+typedef void (*netif_input_t)(net_buf_t *p_frame, void *p_ctx);
+
+/** Interface statistics. */
+typedef struct netif_stats {
+	uint32_t ul_rx_frames;
+	/** Malformed frames, and frames dropped for lack of buffers. */
+	uint32_t ul_rx_errors;
+	uint32_t ul_rx_dropped;
+	/** Receive interrupts taken and receive polls run. */
+	uint32_t ul_rx_irqs;
+	uint32_t ul_rx_polls;
+	uint32_t ul_tx_frames;
+	/** Frames failed by the MAC, and dropped before reaching it. */
+	uint32_t ul_tx_errors;
+	uint32_t ul_tx_dropped;
+	bool b_link;
+	bool b_100m;
+	bool b_full_duplex;
+} netif_stats_t;
+
+bool netif_init(netif_input_t input, void *p_ctx);
+bool netif_output(net_buf_t *p_frame, TickType_t x_timeout);
+bool netif_get_stats(netif_stats_t *p_stats);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NETIF_H_INCLUDED */
@@ -0,0 +1,167 @@
+/**
+ * \file
+ *
+ * \brief PIO parallel capture through XDMAC.
+ *
+ */
+
+#include <asf.h>
+#include "conf_parcap.h"
+#include "dcache.h"
+#include "dma_ring.h"
+#include "parcap.h"
+
+/**
+ * \addtogroup parcap_group
+ *
+ * @{
+ */
+
+#if (CONF_PARCAP_BLOCKS < 3)
+#  error "CONF_PARCAP_BLOCKS must be at least 3"
+#endif
+#if (CONF_PARCAP_BLOCK_SIZE % DCACHE_LINE_SIZE)
+#  error "CONF_PARCAP_BLOCK_SIZE must be a multiple of DCACHE_LINE_SIZE"
+#endif
+
+static uint8_t gs_uc_blocks[CONF_PARCAP_BLOCKS][CONF_PARCAP_BLOCK_SIZE]
+		DCACHE_ALIGNED;
+static lld_view1 gs_desc[CONF_PARCAP_BLOCKS] DCACHE_ALIGNED;
+static uint32_t gs_ul_seq[CONF_PARCAP_BLOCKS];
+static dma_ring_t gs_ring;
+
+static int32_t gs_l_channel = -1;
+
+static parcap_stats_t gs_stats;
+
+/**
+ * \brief XDMAC callback.
+ */
+static void parcap_dma_handler(uint32_t ul_ch, uint32_t ul_status,
+		void *p_ctx)
+{
+	BaseType_t x_woken = pdFALSE;
+
+	UNUSED(p_ctx);
+
+	if (PIOA->PIO_PCISR & PIO_PCISR_OVRE) {
+		gs_stats.ul_overruns++;
+	}
+	if (ul_status & DMA_RING_ERRORS) {
+		gs_stats.ul_errors++;
+	}
+	dma_ring_isr(&gs_ring, ul_ch, ul_status, &x_woken);
+	portEND_SWITCHING_ISR(x_woken);
+}
+
+/**
+ * \brief Start capturing.
+ *
+ * \param ul_dsize Sample packing, PIO_PCMR_DSIZE_BYTE, PIO_PCMR_DSIZE_HALFWORD
+ * or PIO_PCMR_DSIZE_WORD.
+ * \param ul_mode Any of PIO_PCMR_ALWYS, PIO_PCMR_HALFS and PIO_PCMR_FRSTS.
+ *
+ * \return true on success, false if already started or out of resources.
+ */
+bool parcap_start(uint32_t ul_dsize, uint32_t ul_mode)
+{
+	uint32_t ul_shift = (ul_dsize & PIO_PCMR_DSIZE_Msk) >> PIO_PCMR_DSIZE_Pos;
+
+	if (gs_l_channel >= 0 || ul_shift > 2) {
+		return false;
+	}
+	if (!gs_ring.p_blocks && !dma_ring_init(&gs_ring, gs_uc_blocks,
+			CONF_PARCAP_BLOCK_SIZE, CONF_PARCAP_BLOCKS, gs_desc, gs_ul_seq)) {
+		return false;
+	}
+	gs_l_channel = xdmac_channel_alloc(parcap_dma_handler, NULL);
+	if (gs_l_channel < 0) {
+		return false;
+	}
+
+	pmc_enable_periph_clk(ID_PIOA);
+	pio_capture_set_mode(PIOA, ul_dsize | (ul_mode &
+			(PIO_PCMR_ALWYS | PIO_PCMR_HALFS | PIO_PCMR_FRSTS)));
+
+	dma_ring_start(&gs_ring, gs_l_channel, (uint32_t)&PIOA->PIO_PCRHR,
+			CONF_PARCAP_BLOCK_SIZE >> ul_shift,
+			XDMAC_CC_TYPE_PER_TRAN | XDMAC_CC_MBSIZE_SINGLE |
+			XDMAC_CC_DSYNC_PER2MEM | XDMAC_CC_CSIZE_CHK_1 |
+			XDMAC_CC_DWIDTH(ul_shift) | XDMAC_CC_SIF_AHB_IF1 |
+			XDMAC_CC_DIF_AHB_IF0 | XDMAC_CC_SAM_FIXED_AM |
+			XDMAC_CC_DAM_INCREMENTED_AM |
+			XDMAC_CC_PERID(XDMAC_PERID_PIOA));
+
+	/* Drop stale data and status, then go. */
+	(void)PIOA->PIO_PCISR;
+	(void)PIOA->PIO_PCRHR;
+	xdmac_channel_enable(XDMAC, gs_l_channel);
+	pio_capture_enable(PIOA);
+
+	return true;
+}
+
+/**
+ * \brief Stop capturing. Blocks not read yet are discarded.
+ */
+void parcap_stop(void)
+{
+	if (gs_l_channel < 0) {
+		return;
+	}
+	pio_capture_disable(PIOA);
+	xdmac_channel_free(gs_l_channel);
+	gs_l_channel = -1;
+
+	dma_ring_reset(&gs_ring);
+}
+
+/**
+ * \brief Take the oldest filled block, waiting for one if needed.
+ *
+ * Only one block can be held at a time; give it back with
+ * parcap_release_block() before taking the next one.
+ *
+ * \param p_block Filled with the block description.
+ * \param x_timeout Maximum time to wait, in ticks.
+ *
+ * \return true if a block was taken, false on timeout or if a block is
+ * already held.
+ */
+bool parcap_get_block(parcap_block_t *p_block, TickType_t x_timeout)
+{
+	uint8_t *p_data = dma_ring_get(&gs_ring, &p_block->ul_seq, x_timeout);
+
+	if (!p_data) {
+		return false;
+	}
+	p_block->p_data = p_data;
+	p_block->ul_size = CONF_PARCAP_BLOCK_SIZE;
+
+	return true;
+}
+
+/**
+ * \brief Give back the block taken with parcap_get_block().
+ *
+ * \return true if the block content was intact for the whole time it was
+ * held, false if the DMA has started overwriting it.
+ */
+bool parcap_release_block(void)
+{
+	return dma_ring_release(&gs_ring);
+}
+
+/**
+ * \brief Get a snapshot of the capture statistics.
+ */
+void parcap_get_stats(parcap_stats_t *p_stats)
+{
+	taskENTER_CRITICAL();
+	*p_stats = gs_stats;
+	p_stats->ul_blocks = gs_ring.ul_total;
+	p_stats->ul_dropped = gs_ring.ul_dropped;
+	taskEXIT_CRITICAL();
+}
+
+/** @} */
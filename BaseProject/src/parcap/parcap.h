@@ -0,0 +1,72 @@
+/**
+ * \file
+ *
+ * \brief PIO parallel capture through XDMAC.
+ *
+ */
+
+#ifndef PARCAP_H_INCLUDED
+#define PARCAP_H_INCLUDED
+
+#include "compiler.h"
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup parcap_group Parallel capture
+ *
+ * Streams the PIOA parallel capture (PIODC0-7 sampled on PIODCCLK, with
+ * the PIODCEN1/2 enables) into a ring of CONF_PARCAP_BLOCKS blocks through
+ * a circular XDMAC linked list, without CPU involvement between blocks.
+ * The capture pins must be configured as PIO inputs beforehand.
+ *
+ * A task takes the oldest filled block with parcap_get_block() and hands
+ * it back with parcap_release_block(). Blocks are read-only.
+ *
+ * When the reader falls behind, the DMA keeps running and the oldest
+ * block is dropped, so the reader always gets the most recent data in
+ * order; the gap shows as a jump in the block sequence numbers. If the
+ * dropped block was held by the reader at the time, its content has been
+ * overwritten and parcap_release_block() returns false.
+ *
+ * @{
+ */
+
+/** A filled capture block. */
+typedef struct parcap_block {
+	/** Captured data. */
+	const void *p_data;
+	/** Size in bytes. */
+	uint32_t ul_size;
+	/** Sequence number, incremented for every block filled. */
+	uint32_t ul_seq;
+} parcap_block_t;
+
+/** Capture statistics. */
+typedef struct parcap_stats {
+	/** Blocks filled by the DMA. */
+	uint32_t ul_blocks;
+	/** Blocks dropped because the reader fell behind. */
+	uint32_t ul_dropped;
+	/** Samples lost by the PIO because the DMA did not keep up. */
+	uint32_t ul_overruns;
+	/** DMA bus errors. */
+	uint32_t ul_errors;
+} parcap_stats_t;
+
+bool parcap_start(uint32_t ul_dsize, uint32_t ul_mode);
+void parcap_stop(void);
+bool parcap_get_block(parcap_block_t *p_block, TickType_t x_timeout);
+bool parcap_release_block(void);
+void parcap_get_stats(parcap_stats_t *p_stats);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PARCAP_H_INCLUDED */
@@ -0,0 +1,635 @@
+/**
+ * \file
+ *
+ * \brief Serial flash on the QSPI.
+ *
+ */
+
+#include <asf.h>
+#include <string.h>
+#include "conf_qspi_flash.h"
+#include "clock_scale.h"
+#include "cycles.h"
+#include "dcache.h"
+#include "dma_buf.h"
+#include "semphr.h"
+#include "qspi_flash.h"
+
+/**
+ * \addtogroup qspi_flash_group
+ *
+ * @{
+ */
+
+#if (CONF_QSPI_FLASH_SIZE & (CONF_QSPI_FLASH_SIZE - 1)) || \
+		(CONF_QSPI_FLASH_SIZE < 32)
+#  error "CONF_QSPI_FLASH_SIZE must be a power of two"
+#endif
+
+/**
+ * Frames and memory mode of the QSPI, see \ref sam_drivers_qspi_group. A
+ * build on another serial flash, such as the model of the host tests,
+ * defines both.
+ */
+#ifndef QSPI_FLASH_EXEC
+#  define QSPI_FLASH_EXEC(p_cmd, p_rx, p_tx, ul_len) \
+	qspi_exec(QSPI, (p_cmd), (p_rx), (p_tx), (ul_len))
+#  define QSPI_FLASH_MEMORY_READ(p_cmd) \
+	qspi_enable_memory_read(QSPI, (p_cmd))
+#endif
+
+/** Instructions, S25FL1-K set. */
+#define QSPI_FLASH_WRSR         0x01
+#define QSPI_FLASH_RDSR1        0x05
+#define QSPI_FLASH_WREN         0x06
+#define QSPI_FLASH_SE           0x20
+#define QSPI_FLASH_QPP          0x32
+#define QSPI_FLASH_RDSR2        0x35
+#define QSPI_FLASH_RDID         0x9F
+#define QSPI_FLASH_QIOR         0xEB
+
+/** Status register 1: write in progress. */
+#define QSPI_FLASH_SR1_WIP      (1u << 0)
+/** Status register 2: quad enable. */
+#define QSPI_FLASH_SR2_QE       (1u << 1)
+
+/** Longest page program, sector erase and status write, in ms. */
+#define QSPI_FLASH_PP_TIMEOUT_MS        5
+#define QSPI_FLASH_SE_TIMEOUT_MS        500
+#define QSPI_FLASH_WRSR_TIMEOUT_MS      200
+
+/** Channel errors. */
+#define QSPI_FLASH_DMA_ERRORS \
+	(XDMAC_CIE_RBIE | XDMAC_CIE_WBIE | XDMAC_CIE_ROIE)
+
+/** Frame of a single line instruction, without address. */
+#define QSPI_FLASH_IFR_READ \
+	(QSPI_IFR_WIDTH_SINGLE_BIT_SPI | QSPI_IFR_INSTEN | QSPI_IFR_DATAEN | \
+	QSPI_IFR_TFRTYP_TRSFR_READ)
+#define QSPI_FLASH_IFR_WRITE \
+	(QSPI_IFR_WIDTH_SINGLE_BIT_SPI | QSPI_IFR_INSTEN | \
+	QSPI_IFR_TFRTYP_TRSFR_WRITE)
+
+/**
+ * Quad I/O read: address and mode byte on four lines, 4 dummy cycles, data
+ * on four lines. The mode byte 0x00 keeps the continuous read off.
+ */
+static const qspi_cmd_t gs_read_cmd = {
+	.uc_inst = QSPI_FLASH_QIOR,
+	.uc_opt = 0x00,
+	.ul_ifr = QSPI_IFR_WIDTH_QUAD_IO | QSPI_IFR_INSTEN | QSPI_IFR_ADDREN |
+			QSPI_IFR_OPTEN | QSPI_IFR_OPTL_OPTION_8BIT | QSPI_IFR_DATAEN |
+			QSPI_IFR_ADDRL_24_BIT | QSPI_IFR_NBDUM(4) |
+			QSPI_IFR_TFRTYP_TRSFR_READ_MEMORY,
+};
+
+static SemaphoreHandle_t gs_x_lock;
+static SemaphoreHandle_t gs_x_dma_done;
+static int32_t gs_l_channel = -1;
+static volatile uint32_t gs_ul_dma_status;
+static qspi_flash_stats_t gs_stats;
+
+/**
+ * \brief Set the window mapping, with the cached one over the board region.
+ */
+static void qspi_flash_mpu(qspi_flash_map_t map)
+{
+	__DMB();
+	if (map == QSPI_FLASH_MAP_CACHED) {
+		/* Shareable lines would not be cached by the Cortex-M7. */
+		mpu_set_region(QSPIMEM_ADDR | MPU_REGION_VALID |
+				CONF_QSPI_FLASH_MPU_REGION,
+				MPU_AP_READONLY |
+				INNER_NORMAL_WB_RWA_TYPE(NON_SHAREABLE) |
+#if !CONF_QSPI_FLASH_XIP
+				MPU_REGION_EXECUTE_NEVER |
+#endif
+				mpu_cal_mpu_region_size(CONF_QSPI_FLASH_SIZE) |
+				MPU_REGION_ENABLE);
+	} else {
+		mpu_set_region(QSPIMEM_ADDR | MPU_REGION_VALID |
+				CONF_QSPI_FLASH_MPU_REGION, MPU_REGION_DISABLE);
+	}
+	__DSB();
+	__ISB();
+}
+
+/**
+ * \brief Send a frame, the memory mode left.
+ */
+static status_code_t qspi_flash_cmd(uint8_t uc_inst, uint32_t ul_ifr,
+		uint32_t ul_addr, void *p_rx, const void *p_tx, uint32_t ul_len)
+{
+	qspi_cmd_t cmd;
+
+	cmd.uc_inst = uc_inst;
+	cmd.uc_opt = 0;
+	cmd.ul_addr = ul_addr;
+	cmd.ul_ifr = ul_ifr;
+	return QSPI_FLASH_EXEC(&cmd, p_rx, p_tx, ul_len);
+}
+
+/**
+ * \brief Wait for the end of a program or erase.
+ *
+ * Timed with the cycle counter, as the tick does not run before the
+ * scheduler.
+ *
+ * \param ul_timeout_ms Longest wait.
+ * \param b_sleep Sleep between polls once the scheduler runs, for the long
+ * ones.
+ */
+static status_code_t qspi_flash_wait(uint32_t ul_timeout_ms, bool b_sleep)
+{
+	uint32_t ul_cycles = clock_scale_get_cpu_hz() / 1000 * ul_timeout_ms;
+	uint32_t ul_start = DWT->CYCCNT;
+	status_code_t status;
+	uint8_t uc_sr;
+
+	for (;;) {
+		status = qspi_flash_cmd(QSPI_FLASH_RDSR1, QSPI_FLASH_IFR_READ, 0,
+				&uc_sr, NULL, 1);
+		if (status != STATUS_OK || !(uc_sr & QSPI_FLASH_SR1_WIP)) {
+			return status;
+		}
+		if (DWT->CYCCNT - ul_start > ul_cycles) {
+			return ERR_TIMEOUT;
+		}
+		if (b_sleep &&
+				xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+			vTaskDelay(1);
+		}
+	}
+}
+
+/**
+ * \brief Leave the memory mode for command frames.
+ *
+ * The window goes back to the strongly ordered mapping: reads ahead in a
+ * cached one would start frames of their own.
+ */
+static void qspi_flash_begin(void)
+{
+	if (gs_stats.map == QSPI_FLASH_MAP_CACHED) {
+		qspi_flash_mpu(QSPI_FLASH_MAP_UNCACHED);
+	}
+}
+
+/**
+ * \brief Go back to the memory mode, after changing a range of the flash.
+ */
+static void qspi_flash_end(uint32_t ul_addr, uint32_t ul_len)
+{
+	QSPI_FLASH_MEMORY_READ(&gs_read_cmd);
+	if (gs_stats.map == QSPI_FLASH_MAP_CACHED) {
+		dcache_invalidate((const void *)(QSPIMEM_ADDR + ul_addr), ul_len);
+#if CONF_QSPI_FLASH_XIP
+		SCB_InvalidateICache();
+#endif
+		qspi_flash_mpu(QSPI_FLASH_MAP_CACHED);
+	}
+}
+
+/**
+ * \brief Enable the quad lines in the flash, a non-volatile bit.
+ */
+static status_code_t qspi_flash_quad_enable(void)
+{
+	uint8_t uc_sr[2];
+	status_code_t status;
+
+	status = qspi_flash_cmd(QSPI_FLASH_RDSR2, QSPI_FLASH_IFR_READ, 0,
+			&uc_sr[1], NULL, 1);
+	if (status != STATUS_OK || (uc_sr[1] & QSPI_FLASH_SR2_QE)) {
+		return status;
+	}
+	status = qspi_flash_cmd(QSPI_FLASH_RDSR1, QSPI_FLASH_IFR_READ, 0,
+			&uc_sr[0], NULL, 1);
+	if (status != STATUS_OK) {
+		return status;
+	}
+	uc_sr[1] |= QSPI_FLASH_SR2_QE;
+	qspi_flash_cmd(QSPI_FLASH_WREN, QSPI_FLASH_IFR_WRITE, 0, NULL, NULL, 0);
+	status = qspi_flash_cmd(QSPI_FLASH_WRSR,
+			QSPI_FLASH_IFR_WRITE | QSPI_IFR_DATAEN, 0, NULL, uc_sr, 2);
+	if (status != STATUS_OK) {
+		return status;
+	}
+	return qspi_flash_wait(QSPI_FLASH_WRSR_TIMEOUT_MS, true);
+}
+
+/**
+ * \brief XDMAC callback.
+ */
+static void qspi_flash_dma_handler(uint32_t ul_ch, uint32_t ul_status,
+		void *p_ctx)
+{
+	BaseType_t x_woken = pdFALSE;
+
+	UNUSED(ul_ch);
+	UNUSED(p_ctx);
+
+	gs_ul_dma_status = ul_status;
+	xSemaphoreGiveFromISR(gs_x_dma_done, &x_woken);
+	portEND_SWITCHING_ISR(x_woken);
+}
+
+/**
+ * \brief Copy by the CPU from the window, in words when aligned. Accesses
+ * stay aligned for the strongly ordered mapping.
+ */
+static void qspi_flash_cpu_read(uint32_t ul_addr, void *p_buf,
+		uint32_t ul_len)
+{
+	uint32_t ul_src = QSPIMEM_ADDR + ul_addr;
+	uint32_t i;
+
+	if (!((ul_src | (uint32_t)p_buf | ul_len) & 3)) {
+		const volatile uint32_t *p_src = (const volatile uint32_t *)ul_src;
+
+		for (i = 0; i < ul_len / 4; i++) {
+			((uint32_t *)p_buf)[i] = p_src[i];
+		}
+	} else {
+		const volatile uint8_t *p_src = (const volatile uint8_t *)ul_src;
+
+		for (i = 0; i < ul_len; i++) {
+			((uint8_t *)p_buf)[i] = p_src[i];
+		}
+	}
+}
+
+/**
+ * \brief Copy by the XDMAC from the window, in bursts of 16 beats.
+ */
+static status_code_t qspi_flash_dma_read(uint32_t ul_addr, void *p_buf,
+		uint32_t ul_len)
+{
+	xdmac_channel_config_t cfg;
+	uint32_t ul_shift;
+
+	ul_shift = ((ul_addr | (uint32_t)p_buf | ul_len) & 3) ? 0 : 2;
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.mbr_ubc = XDMAC_UBC_UBLEN(ul_len >> ul_shift);
+	cfg.mbr_sa = QSPIMEM_ADDR + ul_addr;
+	cfg.mbr_da = (uint32_t)p_buf;
+	cfg.mbr_cfg = XDMAC_CC_TYPE_MEM_TRAN | XDMAC_CC_MBSIZE_SIXTEEN |
+			XDMAC_CC_CSIZE_CHK_1 | XDMAC_CC_DWIDTH(ul_shift) |
+			XDMAC_CC_SIF_AHB_IF1 | XDMAC_CC_DIF_AHB_IF0 |
+			XDMAC_CC_SAM_INCREMENTED_AM | XDMAC_CC_DAM_INCREMENTED_AM;
+
+	dma_buf_sync_for_device(p_buf, ul_len, DMA_BUF_FROM_DEVICE);
+	xSemaphoreTake(gs_x_dma_done, 0);
+	xdmac_configure_transfer(XDMAC, gs_l_channel, &cfg);
+	xdmac_channel_enable_interrupt(XDMAC, gs_l_channel,
+			XDMAC_CIE_BIE | QSPI_FLASH_DMA_ERRORS);
+	xdmac_channel_enable(XDMAC, gs_l_channel);
+
+	if (xSemaphoreTake(gs_x_dma_done,
+			pdMS_TO_TICKS(CONF_QSPI_FLASH_DMA_TIMEOUT_MS)) != pdTRUE) {
+		xdmac_channel_abort(XDMAC, gs_l_channel);
+		dma_buf_sync_for_cpu(p_buf, ul_len, DMA_BUF_FROM_DEVICE);
+		return ERR_TIMEOUT;
+	}
+	dma_buf_sync_for_cpu(p_buf, ul_len, DMA_BUF_FROM_DEVICE);
+
+	return (gs_ul_dma_status & QSPI_FLASH_DMA_ERRORS) ? ERR_IO_ERROR :
+			STATUS_OK;
+}
+
+/**
+ * \brief Set the serial clock for a peripheral clock frequency.
+ */
+static void qspi_flash_set_clock(uint32_t ul_mck_hz)
+{
+	qspi_set_clock(QSPI, ul_mck_hz, CONF_QSPI_FLASH_HZ);
+	gs_stats.ul_hz = ul_mck_hz / (((QSPI->QSPI_SCR & QSPI_SCR_SCBR_Msk) >>
+			QSPI_SCR_SCBR_Pos) + 1);
+}
+
+/**
+ * \brief Keep the serial clock in range across clock_scale switches.
+ *
+ * The lock is held over the switch, so that no frame runs meanwhile.
+ */
+static void qspi_flash_clock_changed(enum clock_scale_event event,
+		const clock_scale_freq_t *p_freq, void *p_ctx)
+{
+	UNUSED(p_ctx);
+
+	if (event == CLOCK_SCALE_PRE_CHANGE) {
+		xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+		/* Slow enough for both clocks during the switch. */
+		qspi_set_clock(QSPI, Max(p_freq->ul_mck_hz,
+				clock_scale_get_peripheral_hz()), CONF_QSPI_FLASH_HZ);
+	} else {
+		qspi_flash_set_clock(p_freq->ul_mck_hz);
+		xSemaphoreGive(gs_x_lock);
+	}
+}
+
+static struct clock_scale_notifier gs_clock_notifier = {
+	.callback = qspi_flash_clock_changed,
+};
+
+/**
+ * \brief Start the QSPI, check the flash, enable its quad lines and map
+ * it.
+ *
+ * \return true on success, false if already started, out of resources or
+ * without a flash of CONF_QSPI_FLASH_SIZE at least.
+ */
+bool qspi_flash_init(void)
+{
+	if (gs_x_lock) {
+		return false;
+	}
+
+	/* Cycle counter, for the timeouts and qspi_flash_bench(). */
+	cycle_counter_enable();
+
+	pmc_enable_periph_clk(ID_QSPI);
+	qspi_init(QSPI, clock_scale_get_peripheral_hz(), CONF_QSPI_FLASH_HZ);
+	qspi_flash_set_clock(clock_scale_get_peripheral_hz());
+
+	/* The capacity byte is the log2 of the size. */
+	if (qspi_flash_cmd(QSPI_FLASH_RDID, QSPI_FLASH_IFR_READ, 0,
+			gs_stats.uc_id, NULL, sizeof(gs_stats.uc_id)) != STATUS_OK ||
+			gs_stats.uc_id[0] == 0x00 || gs_stats.uc_id[0] == 0xFF ||
+			gs_stats.uc_id[2] >= 32 ||
+			(1u << gs_stats.uc_id[2]) < CONF_QSPI_FLASH_SIZE) {
+		return false;
+	}
+	if (qspi_flash_quad_enable() != STATUS_OK) {
+		return false;
+	}
+
+	if (!gs_x_dma_done) {
+		gs_x_dma_done = xSemaphoreCreateBinary();
+		if (!gs_x_dma_done) {
+			return false;
+		}
+	}
+	if (gs_l_channel < 0) {
+		gs_l_channel = xdmac_channel_alloc(qspi_flash_dma_handler, NULL);
+		if (gs_l_channel < 0) {
+			return false;
+		}
+	}
+	gs_x_lock = xSemaphoreCreateMutex();
+	if (!gs_x_lock) {
+		return false;
+	}
+
+	QSPI_FLASH_MEMORY_READ(&gs_read_cmd);
+	gs_stats.map = CONF_QSPI_FLASH_CACHED ? QSPI_FLASH_MAP_CACHED :
+			QSPI_FLASH_MAP_UNCACHED;
+	qspi_flash_mpu(gs_stats.map);
+
+	clock_scale_register(&gs_clock_notifier);
+
+	return true;
+}
+
+/**
+ * \brief Read from the flash.
+ *
+ * \param ul_addr Flash address.
+ * \param p_buf Buffer. From CONF_QSPI_FLASH_DMA_MIN bytes up, the DMA
+ * writes it: either from dma_buf_alloc(), or cache line aligned and a
+ * multiple of lines long.
+ * \param ul_len Length.
+ *
+ * \retval STATUS_OK The data is read.
+ * \retval ERR_INVALID_ARG Out of the flash.
+ * \retval ERR_TIMEOUT, ERR_IO_ERROR The DMA failed.
+ */
+status_code_t qspi_flash_read(uint32_t ul_addr, void *p_buf,
+		uint32_t ul_len)
+{
+	status_code_t status = STATUS_OK;
+
+	if (ul_addr > CONF_QSPI_FLASH_SIZE ||
+			ul_len > CONF_QSPI_FLASH_SIZE - ul_addr) {
+		return ERR_INVALID_ARG;
+	}
+
+	xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+	if (ul_len >= CONF_QSPI_FLASH_DMA_MIN) {
+		status = qspi_flash_dma_read(ul_addr, p_buf, ul_len);
+		gs_stats.ul_dma_reads++;
+	} else {
+		qspi_flash_cpu_read(ul_addr, p_buf, ul_len);
+		gs_stats.ul_cpu_reads++;
+	}
+	if (status == STATUS_OK) {
+		gs_stats.ul_read_bytes += ul_len;
+	} else {
+		gs_stats.ul_errors++;
+	}
+	xSemaphoreGive(gs_x_lock);
+
+	return status;
+}
+
+/**
+ * \brief Program the flash, by quad page programs.
+ *
+ * \param ul_addr Flash address.
+ * \param p_data Data, anywhere but in the flash.
+ * \param ul_len Length. The range must be erased: programming only clears
+ * bits.
+ *
+ * \retval STATUS_OK The data is written.
+ * \retval ERR_INVALID_ARG Out of the flash.
+ * \retval ERR_TIMEOUT A page program did not end.
+ */
+status_code_t qspi_flash_write(uint32_t ul_addr, const void *p_data,
+		uint32_t ul_len)
+{
+	const uint8_t *p_src = (const uint8_t *)p_data;
+	status_code_t status = STATUS_OK;
+	uint32_t ul_pos = ul_addr;
+	uint32_t ul_end = ul_addr + ul_len;
+	uint32_t ul_count;
+
+	if (ul_addr > CONF_QSPI_FLASH_SIZE ||
+			ul_len > CONF_QSPI_FLASH_SIZE - ul_addr) {
+		return ERR_INVALID_ARG;
+	}
+
+	xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+	qspi_flash_begin();
+	/* A page program wraps within its page. */
+	while (ul_pos < ul_end && status == STATUS_OK) {
+		ul_count = Min(ul_end - ul_pos, QSPI_FLASH_PAGE_SIZE -
+				(ul_pos % QSPI_FLASH_PAGE_SIZE));
+		qspi_flash_cmd(QSPI_FLASH_WREN, QSPI_FLASH_IFR_WRITE, 0, NULL,
+				NULL, 0);
+		status = qspi_flash_cmd(QSPI_FLASH_QPP, QSPI_IFR_WIDTH_QUAD_OUTPUT |
+				QSPI_IFR_INSTEN | QSPI_IFR_ADDREN | QSPI_IFR_DATAEN |
+				QSPI_IFR_ADDRL_24_BIT | QSPI_IFR_TFRTYP_TRSFR_WRITE, ul_pos,
+				NULL, p_src, ul_count);
+		if (status == STATUS_OK) {
+			status = qspi_flash_wait(QSPI_FLASH_PP_TIMEOUT_MS, false);
+		}
+		gs_stats.ul_pages++;
+		ul_pos += ul_count;
+		p_src += ul_count;
+	}
+	qspi_flash_end(ul_addr, ul_len);
+	if (status != STATUS_OK) {
+		gs_stats.ul_errors++;
+	}
+	xSemaphoreGive(gs_x_lock);
+
+	return status;
+}
+
+/**
+ * \brief Erase sectors of the flash, to all ones.
+ *
+ * \param ul_addr Flash address, aligned on QSPI_FLASH_SECTOR_SIZE.
+ * \param ul_len Length, a multiple of QSPI_FLASH_SECTOR_SIZE.
+ *
+ * \retval STATUS_OK The sectors are erased.
+ * \retval ERR_INVALID_ARG Out of the flash or not aligned.
+ * \retval ERR_TIMEOUT An erase did not end.
+ */
+status_code_t qspi_flash_erase(uint32_t ul_addr, uint32_t ul_len)
+{
+	status_code_t status = STATUS_OK;
+	uint32_t ul_pos;
+
+	if (ul_addr > CONF_QSPI_FLASH_SIZE ||
+			ul_len > CONF_QSPI_FLASH_SIZE - ul_addr ||
+			((ul_addr | ul_len) % QSPI_FLASH_SECTOR_SIZE)) {
+		return ERR_INVALID_ARG;
+	}
+
+	xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+	qspi_flash_begin();
+	for (ul_pos = ul_addr; ul_pos < ul_addr + ul_len &&
+			status == STATUS_OK; ul_pos += QSPI_FLASH_SECTOR_SIZE) {
+		qspi_flash_cmd(QSPI_FLASH_WREN, QSPI_FLASH_IFR_WRITE, 0, NULL,
+				NULL, 0);
+		status = qspi_flash_cmd(QSPI_FLASH_SE, QSPI_FLASH_IFR_WRITE |
+				QSPI_IFR_ADDREN | QSPI_IFR_ADDRL_24_BIT, ul_pos, NULL,
+				NULL, 0);
+		if (status == STATUS_OK) {
+			status = qspi_flash_wait(QSPI_FLASH_SE_TIMEOUT_MS, true);
+		}
+		gs_stats.ul_erases++;
+	}
+	qspi_flash_end(ul_addr, ul_len);
+	if (status != STATUS_OK) {
+		gs_stats.ul_errors++;
+	}
+	xSemaphoreGive(gs_x_lock);
+
+	return status;
+}
+
+/**
+ * \brief Address of flash data in the window, to use it in place.
+ *
+ * \return The address, NULL if out of the flash.
+ */
+const void *qspi_flash_map(uint32_t ul_addr)
+{
+	if (ul_addr >= CONF_QSPI_FLASH_SIZE) {
+		return NULL;
+	}
+	return (const void *)(QSPIMEM_ADDR + ul_addr);
+}
+
+/**
+ * \brief Change the window mapping.
+ *
+ * Going back to the cached mapping drops the lines read before: the flash
+ * may have changed since.
+ */
+void qspi_flash_set_map(qspi_flash_map_t map)
+{
+	xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+	if (map == QSPI_FLASH_MAP_CACHED && gs_stats.map != map) {
+		dcache_invalidate((const void *)QSPIMEM_ADDR, CONF_QSPI_FLASH_SIZE);
+	}
+	gs_stats.map = map;
+	qspi_flash_mpu(map);
+	xSemaphoreGive(gs_x_lock);
+}
+
+/**
+ * \brief Time reads of the flash in each mode.
+ *
+ * \param ul_addr Flash address.
+ * \param p_buf Buffer, as for a DMA read by qspi_flash_read().
+ * \param ul_len Length.
+ * \param p_res Times, in CPU cycles.
+ *
+ * \retval STATUS_OK The reads are timed.
+ * \retval ERR_INVALID_ARG Out of the flash.
+ * \retval ERR_TIMEOUT, ERR_IO_ERROR The DMA failed.
+ */
+status_code_t qspi_flash_bench(uint32_t ul_addr, void *p_buf,
+		uint32_t ul_len, qspi_flash_bench_t *p_res)
+{
+	const void *p_src = (const void *)(QSPIMEM_ADDR + ul_addr);
+	status_code_t status;
+	uint32_t ul_start;
+
+	if (ul_addr > CONF_QSPI_FLASH_SIZE ||
+			ul_len > CONF_QSPI_FLASH_SIZE - ul_addr) {
+		return ERR_INVALID_ARG;
+	}
+
+	xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+
+	qspi_flash_mpu(QSPI_FLASH_MAP_UNCACHED);
+	ul_start = DWT->CYCCNT;
+	qspi_flash_cpu_read(ul_addr, p_buf, ul_len);
+	p_res->ul_uncached = DWT->CYCCNT - ul_start;
+
+	dcache_invalidate(p_src, ul_len);
+	qspi_flash_mpu(QSPI_FLASH_MAP_CACHED);
+	ul_start = DWT->CYCCNT;
+	qspi_flash_cpu_read(ul_addr, p_buf, ul_len);
+	p_res->ul_cached_cold = DWT->CYCCNT - ul_start;
+	ul_start = DWT->CYCCNT;
+	qspi_flash_cpu_read(ul_addr, p_buf, ul_len);
+	p_res->ul_cached_warm = DWT->CYCCNT - ul_start;
+	if (gs_stats.map != QSPI_FLASH_MAP_CACHED) {
+		/* Leave no lines that the mapping would not drop. */
+		dcache_invalidate(p_src, ul_len);
+	}
+	qspi_flash_mpu(gs_stats.map);
+
+	ul_start = DWT->CYCCNT;
+	status = qspi_flash_dma_read(ul_addr, p_buf, ul_len);
+	p_res->ul_dma = DWT->CYCCNT - ul_start;
+
+	xSemaphoreGive(gs_x_lock);
+
+	return status;
+}
+
+/**
+ * \brief Get the flash statistics.
+ *
+ * \return false if not started.
+ */
+bool qspi_flash_get_stats(qspi_flash_stats_t *p_stats)
+{
+	if (!gs_x_lock) {
+		return false;
+	}
+	xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+	*p_stats = gs_stats;
+	xSemaphoreGive(gs_x_lock);
+
+	return true;
+}
+
+/** @} */
@@ -0,0 +1,107 @@
+/**
+ * \file
+ *
+ * \brief Serial flash on the QSPI.
+ *
+ */
+
+#ifndef QSPI_FLASH_H_INCLUDED
+#define QSPI_FLASH_H_INCLUDED
+
+#include "compiler.h"
+#include "status_codes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup qspi_flash_group QSPI serial flash
+ *
+ * The board serial flash, read like memory at QSPIMEM_ADDR and programmed
+ * through quad instruction frames, see \ref sam_drivers_qspi_group.
+ *
+ * At start the flash gets its quad enable bit, then stays mapped in the
+ * memory window with the quad I/O read: a CPU or DMA read of the window
+ * reads the flash at that offset. Two mappings are kept for the window:
+ * - QSPI_FLASH_MAP_UNCACHED: the board strongly ordered region. Every read
+ *   is a flash frame, without bursts.
+ * - QSPI_FLASH_MAP_CACHED: read-only, write-back cached and not shareable,
+ *   so that the Cortex-M7 does cache it. Lines are filled by bursts and read
+ *   again from the cache, for assets and tables used in place through
+ *   qspi_flash_map(). Execute-never unless CONF_QSPI_FLASH_XIP.
+ *
+ * qspi_flash_read() copies to RAM: by the XDMAC from CONF_QSPI_FLASH_DMA_MIN
+ * bytes up, which reads the flash whatever the mapping, by the CPU below.
+ *
+ * qspi_flash_write() and qspi_flash_erase() leave the memory mode and
+ * map the window strongly ordered for their frames, so the CPU cannot
+ * read ahead in it, then drop the cached lines of what they changed.
+ * Code running from the flash and data read through qspi_flash_map() must
+ * not be used meanwhile: the functions are for tasks, one at a time.
+ *
+ * @{
+ */
+
+/** Sector size, the erase unit. */
+#define QSPI_FLASH_SECTOR_SIZE  4096
+
+/** Page size, the program unit. */
+#define QSPI_FLASH_PAGE_SIZE    256
+
+/** Window mappings. */
+typedef enum qspi_flash_map {
+	/** Strongly ordered, the board mapping. */
+	QSPI_FLASH_MAP_UNCACHED,
+	/** Read-only and cached. */
+	QSPI_FLASH_MAP_CACHED,
+} qspi_flash_map_t;
+
+/** Flash statistics. */
+typedef struct qspi_flash_stats {
+	/** JEDEC manufacturer, memory type and capacity. */
+	uint8_t uc_id[3];
+	qspi_flash_map_t map;
+	/** Serial clock frequency. */
+	uint32_t ul_hz;
+	/** Reads by the CPU and by the DMA, and bytes read. */
+	uint32_t ul_cpu_reads;
+	uint32_t ul_dma_reads;
+	uint32_t ul_read_bytes;
+	/** Pages programmed and sectors erased. */
+	uint32_t ul_pages;
+	uint32_t ul_erases;
+	/** Failed commands and DMA reads. */
+	uint32_t ul_errors;
+} qspi_flash_stats_t;
+
+/** Read times of qspi_flash_bench(), in CPU cycles. */
+typedef struct qspi_flash_bench {
+	/** CPU copy through the strongly ordered mapping. */
+	uint32_t ul_uncached;
+	/** CPU copy through the cached mapping, lines missing then present. */
+	uint32_t ul_cached_cold;
+	uint32_t ul_cached_warm;
+	/** XDMAC copy. */
+	uint32_t ul_dma;
+} qspi_flash_bench_t;
+
+bool qspi_flash_init(void);
+status_code_t qspi_flash_read(uint32_t ul_addr, void *p_buf,
+		uint32_t ul_len);
+status_code_t qspi_flash_write(uint32_t ul_addr, const void *p_data,
+		uint32_t ul_len);
+status_code_t qspi_flash_erase(uint32_t ul_addr, uint32_t ul_len);
+const void *qspi_flash_map(uint32_t ul_addr);
+void qspi_flash_set_map(qspi_flash_map_t map);
+status_code_t qspi_flash_bench(uint32_t ul_addr, void *p_buf,
+		uint32_t ul_len, qspi_flash_bench_t *p_res);
+bool qspi_flash_get_stats(qspi_flash_stats_t *p_stats);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QSPI_FLASH_H_INCLUDED */
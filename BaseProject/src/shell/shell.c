@@ -0,0 +1,584 @@
+/**
+ * \file
+ *
+ * \brief Interactive console shell.
+ *
+ */
+
+#include <asf.h>
+#include <malloc.h>
+#include <string.h>
+#include "conf_shell.h"
+#include "bench.h"
+#include "boot.h"
+#include "can_bus.h"
+#include "clock_scale.h"
+#include "console.h"
+#include "dma_buf.h"
+#include "dsp_pipe.h"
+#include "flog.h"
+#include "fmt.h"
+#include "netif.h"
+#include "qspi_flash.h"
+#include "telemetry.h"
+#include "usb_cdc.h"
+#include "shell.h"
+#include "shell_cmd_table.h"
+
+/**
+ * \addtogroup shell_group
+ *
+ * @{
+ */
+
+/* Control characters handled by the line editor. */
+#define KEY_CTRL_C     0x03
+#define KEY_BS         0x08
+#define KEY_LF         0x0A
+#define KEY_CR         0x0D
+#define KEY_CTRL_U     0x15
+#define KEY_ESC        0x1B
+#define KEY_DEL        0x7F
+
+/** A command as listed in shell_cmds.def. */
+struct shell_cmd {
+	const char *p_name;
+	const char *p_help;
+	void (*handler)(int argc, char *argv[]);
+};
+
+#define SHELL_CMD(name, help) \
+	static void shell_cmd_##name(int argc, char *argv[]);
+#include "shell_cmds.def"
+#undef SHELL_CMD
+
+static const struct shell_cmd gs_shell_cmds[SHELL_CMD_COUNT] = {
+#define SHELL_CMD(name, help) { #name, help, shell_cmd_##name },
+#include "shell_cmds.def"
+#undef SHELL_CMD
+};
+
+/** Line editor state. */
+enum shell_esc {
+	SHELL_ESC_NONE,
+	SHELL_ESC_START,
+	SHELL_ESC_CSI,
+};
+
+static char gs_line[CONF_SHELL_LINE_SIZE + 1];
+static char gs_history[CONF_SHELL_LINE_SIZE + 1];
+static size_t gs_ul_line_len;
+static enum shell_esc gs_esc;
+/** The last character was a CR, so an LF right after it is not a line. */
+static bool gs_b_cr;
+
+static void shell_puts(const char *p_str)
+{
+	console_write(p_str, strlen(p_str));
+}
+
+/**
+ * \brief Formatted output from shell commands.
+ *
+ * Same as console_printf(): console_write() sleeps while the transmit ring
+ * is full, so a long listing never spins the shell task.
+ *
+ * \param p_fmt Format string, see \ref utils_fmt_group.
+ *
+ * \return Number of characters produced.
+ */
+int shell_printf(const char *p_fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start(ap, p_fmt);
+	n = console_vprintf(p_fmt, ap);
+	va_end(ap);
+
+	return n;
+}
+
+/**
+ * \brief Seeded FNV-1a hash of a command name.
+ *
+ * \note Must match shell_hash() in tools/gen_shell_table.py.
+ */
+static uint32_t shell_hash(const char *p_name)
+{
+	uint32_t ul_hash = SHELL_HASH_SEED;
+
+	while (*p_name) {
+		ul_hash ^= (uint8_t)*p_name++;
+		ul_hash *= 16777619u;
+	}
+
+	return ul_hash ^ (ul_hash >> 16);
+}
+
+/**
+ * \brief Look a command up.
+ *
+ * \return Pointer to the command, or NULL if \a p_name is unknown.
+ */
+static const struct shell_cmd *shell_find(const char *p_name)
+{
+	int8_t slot = gs_shell_slots[shell_hash(p_name) & (SHELL_HASH_SIZE - 1)];
+
+	if (slot < 0 || strcmp(gs_shell_cmds[slot].p_name, p_name) != 0) {
+		return NULL;
+	}
+
+	return &gs_shell_cmds[slot];
+}
+
+/**
+ * \brief Split the line into arguments and run the command.
+ */
+static void shell_execute(char *p_line)
+{
+	char *argv[CONF_SHELL_MAX_ARGS];
+	const struct shell_cmd *p_cmd;
+	int argc = 0;
+
+	while (*p_line && argc < CONF_SHELL_MAX_ARGS) {
+		while (*p_line == ' ') {
+			*p_line++ = '\0';
+		}
+		if (!*p_line) {
+			break;
+		}
+		argv[argc++] = p_line;
+		while (*p_line && *p_line != ' ') {
+			p_line++;
+		}
+	}
+	if (argc == 0) {
+		return;
+	}
+
+	p_cmd = shell_find(argv[0]);
+	if (!p_cmd) {
+		shell_printf("%s: unknown command, try help\r\n", argv[0]);
+		return;
+	}
+	p_cmd->handler(argc, argv);
+}
+
+/**
+ * \brief Replace the line being edited with \a p_str.
+ */
+static void shell_set_line(const char *p_str)
+{
+	while (gs_ul_line_len) {
+		console_write("\b \b", 3);
+		gs_ul_line_len--;
+	}
+	gs_ul_line_len = strlen(p_str);
+	memcpy(gs_line, p_str, gs_ul_line_len);
+	console_write(gs_line, gs_ul_line_len);
+}
+
+/**
+ * \brief Feed one received character to the line editor.
+ */
+static void shell_input(uint8_t uc_c)
+{
+	if (gs_b_cr) {
+		gs_b_cr = false;
+		if (uc_c == KEY_LF) {
+			return;
+		}
+	}
+	if (gs_esc == SHELL_ESC_START) {
+		gs_esc = (uc_c == '[') ? SHELL_ESC_CSI : SHELL_ESC_NONE;
+		return;
+	}
+	if (gs_esc == SHELL_ESC_CSI) {
+		/* Parameters and intermediates run until the final byte. */
+		if (uc_c >= 0x40 && uc_c <= 0x7E) {
+			gs_esc = SHELL_ESC_NONE;
+			if (uc_c == 'A') {
+				shell_set_line(gs_history);
+			}
+		}
+		return;
+	}
+
+	switch (uc_c) {
+	case KEY_CR:
+		gs_b_cr = true;
+		/* Fall through. */
+	case KEY_LF:
+		shell_puts("\r\n");
+		gs_line[gs_ul_line_len] = '\0';
+		if (gs_ul_line_len) {
+			memcpy(gs_history, gs_line, gs_ul_line_len + 1);
+		}
+		gs_ul_line_len = 0;
+		shell_execute(gs_line);
+		shell_puts(CONF_SHELL_PROMPT);
+		break;
+
+	case KEY_BS:
+	case KEY_DEL:
+		if (gs_ul_line_len) {
+			gs_ul_line_len--;
+			console_write("\b \b", 3);
+		}
+		break;
+
+	case KEY_CTRL_U:
+		shell_set_line("");
+		break;
+
+	case KEY_CTRL_C:
+		gs_ul_line_len = 0;
+		shell_puts("^C\r\n" CONF_SHELL_PROMPT);
+		break;
+
+	case KEY_ESC:
+		gs_esc = SHELL_ESC_START;
+		break;
+
+	default:
+		if (uc_c >= ' ' && uc_c < KEY_DEL &&
+				gs_ul_line_len < CONF_SHELL_LINE_SIZE) {
+			gs_line[gs_ul_line_len++] = (char)uc_c;
+			console_write((const char *)&uc_c, 1);
+		}
+		break;
+	}
+}
+
+/**
+ * \brief Shell task. Create it with a low priority once the console is
+ * initialized (see console_init()).
+ */
+void shell_task(void *pvParameters)
+{
+	uint8_t uc_c;
+
+	UNUSED(pvParameters);
+
+	gs_ul_line_len = 0;
+	gs_esc = SHELL_ESC_NONE;
+	gs_b_cr = false;
+	console_set_rx_task(xTaskGetCurrentTaskHandle());
+	shell_puts("\r\n" CONF_SHELL_PROMPT);
+
+	for (;;) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		while (console_getc(&uc_c)) {
+			shell_input(uc_c);
+		}
+	}
+}
+
+static void shell_cmd_help(int argc, char *argv[])
+{
+	uint32_t i;
+
+	UNUSED(argc);
+	UNUSED(argv);
+
+	for (i = 0; i < SHELL_CMD_COUNT; i++) {
+		shell_printf("  %-8s %s\r\n", gs_shell_cmds[i].p_name,
+				gs_shell_cmds[i].p_help);
+	}
+}
+
+static void shell_cmd_tasks(int argc, char *argv[])
+{
+	static char s_list[CONF_SHELL_TASKS_BUF_SIZE];
+
+	UNUSED(argc);
+	UNUSED(argv);
+
+	shell_printf("%u tasks\r\nName\t\tState\tPrio\tStack\tNum\r\n",
+			(unsigned int)uxTaskGetNumberOfTasks());
+	vTaskList(s_list);
+	shell_puts(s_list);
+}
+
+static void shell_cmd_heap(int argc, char *argv[])
+{
+	struct mallinfo mi = mallinfo();
+
+	UNUSED(argc);
+	UNUSED(argv);
+
+	shell_printf("arena %d used %d free %d\r\n", mi.arena, mi.uordblks,
+			mi.fordblks);
+}
+
+static void shell_cmd_trace(int argc, char *argv[])
+{
+	console_stats_t console;
+	tlm_stats_t tlm;
+
+	UNUSED(argc);
+	UNUSED(argv);
+
+	console_get_stats(&console);
+	tlm_get_stats(&tlm);
+	shell_printf("console tx %lu dropped %lu rx %lu overruns %lu\r\n",
+			(unsigned long)console.ul_tx_bytes,
+			(unsigned long)console.ul_tx_dropped,
+			(unsigned long)console.ul_rx_bytes,
+			(unsigned long)console.ul_rx_overruns);
+	shell_printf("telemetry frames %lu dropped %lu bytes %lu\r\n",
+			(unsigned long)tlm.ul_sent, (unsigned long)tlm.ul_dropped,
+			(unsigned long)tlm.ul_bytes);
+}
+
+static void shell_cmd_uptime(int argc, char *argv[])
+{
+	TickType_t x_ticks = xTaskGetTickCount();
+
+	UNUSED(argc);
+	UNUSED(argv);
+
+	shell_printf("%lu.%03lu s\r\n",
+			(unsigned long)(x_ticks / configTICK_RATE_HZ),
+			(unsigned long)((x_ticks % configTICK_RATE_HZ) * 1000 /
+			configTICK_RATE_HZ));
+}
+
+static void shell_cmd_clock(int argc, char *argv[])
+{
+	uint32_t i;
+
+	if (argc > 1) {
+		for (i = 0; i < CLOCK_SCALE_NUM; i++) {
+			if (!strcmp(argv[1], clock_scale_get_name(
+					(enum clock_scale_point)i))) {
+				break;
+			}
+		}
+		if (i == CLOCK_SCALE_NUM) {
+			shell_printf("unknown point %s\r\n", argv[1]);
+			return;
+		}
+		if (clock_scale_set((enum clock_scale_point)i) != STATUS_OK) {
+			shell_puts("switch failed\r\n");
+		}
+	}
+
+	shell_printf("%s: cpu %lu Hz mck %lu Hz\r\n",
+			clock_scale_get_name(clock_scale_get()),
+			(unsigned long)clock_scale_get_cpu_hz(),
+			(unsigned long)clock_scale_get_peripheral_hz());
+}
+
+static void shell_cmd_boot(int argc, char *argv[])
+{
+	UNUSED(argc);
+	UNUSED(argv);
+
+	boot_report();
+}
+
+static void shell_cmd_dsp(int argc, char *argv[])
+{
+	dsp_pipe_t *p_pipe;
+	dsp_stage_t *p_stage;
+	uint32_t i;
+	bool b_reset = argc > 1 && !strcmp(argv[1], "reset");
+
+	shell_printf("pool: %lu free, %lu min, %u blocks of %u\r\n",
+			(unsigned long)dsp_pool_get_free(),
+			(unsigned long)dsp_pool_get_min_free(),
+			CONF_DSP_POOL_BLOCKS, CONF_DSP_BLOCK_SIZE);
+	for (i = 0; (p_pipe = dsp_pipe_get(i)) != NULL; i++) {
+		shell_printf("%s: %lu dropped\r\n", p_pipe->p_name,
+				(unsigned long)p_pipe->ul_dropped);
+		for (p_stage = p_pipe->p_first; p_stage; p_stage = p_stage->p_next) {
+			dsp_stage_stats_t stats = p_stage->stats;
+
+			shell_printf("  %-12s %10lu calls %8lu avg %8lu max %6lu drop\r\n",
+					p_stage->p_name, (unsigned long)stats.ul_calls,
+					(unsigned long)(stats.ul_calls ?
+					stats.ull_cycles_total / stats.ul_calls : 0),
+					(unsigned long)stats.ul_cycles_max,
+					(unsigned long)stats.ul_dropped);
+		}
+		if (b_reset) {
+			dsp_pipe_reset_stats(p_pipe);
+		}
+	}
+}
+
+static void shell_cmd_bench(int argc, char *argv[])
+{
+	UNUSED(argc);
+	UNUSED(argv);
+
+	bench_run();
+}
+
+static void shell_cmd_can(int argc, char *argv[])
+{
+	can_bus_stats_t stats;
+
+	UNUSED(argc);
+	UNUSED(argv);
+
+	if (!can_bus_get_stats(&stats)) {
+		shell_puts("not started\r\n");
+		return;
+	}
+	shell_printf("rx %lu tx %lu overflows %lu bus off %lu\r\n",
+			(unsigned long)stats.ul_rx_frames,
+			(unsigned long)stats.ul_tx_frames,
+			(unsigned long)stats.ul_rx_overflows,
+			(unsigned long)stats.ul_bus_off);
+	shell_printf("errors: tx %u rx %u\r\n", stats.uc_tx_errors,
+			stats.uc_rx_errors);
+}
+
+static void shell_cmd_net(int argc, char *argv[])
+{
+	netif_stats_t stats;
+
+	UNUSED(argc);
+	UNUSED(argv);
+
+	if (!netif_get_stats(&stats)) {
+		shell_puts("not started\r\n");
+		return;
+	}
+	if (stats.b_link) {
+		shell_printf("link up %s %s duplex\r\n",
+				stats.b_100m ? "100M" : "10M",
+				stats.b_full_duplex ? "full" : "half");
+	} else {
+		shell_puts("link down\r\n");
+	}
+	shell_printf("rx %lu errors %lu dropped %lu irqs %lu polls %lu\r\n",
+			(unsigned long)stats.ul_rx_frames,
+			(unsigned long)stats.ul_rx_errors,
+			(unsigned long)stats.ul_rx_dropped,
+			(unsigned long)stats.ul_rx_irqs,
+			(unsigned long)stats.ul_rx_polls);
+	shell_printf("tx %lu errors %lu dropped %lu\r\n",
+			(unsigned long)stats.ul_tx_frames,
+			(unsigned long)stats.ul_tx_errors,
+			(unsigned long)stats.ul_tx_dropped);
+	shell_printf("buffers free %lu min %lu\r\n",
+			(unsigned long)net_buf_get_free(),
+			(unsigned long)net_buf_get_min_free());
+}
+
+static void shell_cmd_usb(int argc, char *argv[])
+{
+	usb_cdc_stats_t stats;
+
+	UNUSED(argc);
+	UNUSED(argv);
+
+	if (!usb_cdc_get_stats(&stats)) {
+		shell_puts("not started\r\n");
+		return;
+	}
+	shell_printf("%s %s, port %s\r\n",
+			stats.b_configured ? "configured" : "not configured",
+			stats.b_high_speed ? "high speed" : "full speed",
+			stats.b_open ? "open" : "closed");
+	shell_printf("tx %lu rx %lu baud %lu\r\n",
+			(unsigned long)stats.ul_tx_bytes,
+			(unsigned long)stats.ul_rx_bytes,
+			(unsigned long)stats.ul_baudrate);
+	shell_printf("resets %lu suspends %lu\r\n",
+			(unsigned long)stats.ul_resets,
+			(unsigned long)stats.ul_suspends);
+}
+
+static void shell_cmd_flog(int argc, char *argv[])
+{
+	flog_stats_t stats;
+	uint32_t ul_wa;
+
+	UNUSED(argc);
+	UNUSED(argv);
+
+	if (!flog_get_stats(&stats)) {
+		shell_puts("not started\r\n");
+		return;
+	}
+	shell_printf("blocks %lu/%lu keys %lu events %lu\r\n",
+			(unsigned long)stats.ul_used_blocks,
+			(unsigned long)stats.ul_blocks,
+			(unsigned long)stats.ul_keys,
+			(unsigned long)stats.ul_events);
+	shell_printf("appended %lu copied %lu bytes\r\n",
+			(unsigned long)stats.ul_append_bytes,
+			(unsigned long)stats.ul_copy_bytes);
+	/* Write amplification: flash bytes written per byte appended. */
+	ul_wa = stats.ul_append_bytes ? (uint32_t)((uint64_t)stats.ul_pages *
+			EFC_PAGE_SIZE * 100 / stats.ul_append_bytes) : 0;
+	shell_printf("pages %lu erases %lu compactions %lu wa %lu.%02lu\r\n",
+			(unsigned long)stats.ul_pages,
+			(unsigned long)stats.ul_erases,
+			(unsigned long)stats.ul_compactions,
+			(unsigned long)(ul_wa / 100), (unsigned long)(ul_wa % 100));
+	shell_printf("bad pages %lu errors %lu\r\n",
+			(unsigned long)stats.ul_bad_pages,
+			(unsigned long)stats.ul_errors);
+}
+
+static void shell_cmd_qspi(int argc, char *argv[])
+{
+	static const char *const p_maps[] = {"uncached", "cached"};
+	static const char *const p_modes[] = {"uncached", "cached cold",
+			"cached warm", "dma"};
+	qspi_flash_stats_t stats;
+	qspi_flash_bench_t res;
+	uint32_t ul_cycles[4];
+	uint64_t ull_rate;
+	void *p_buf;
+	uint32_t i;
+
+	if (!qspi_flash_get_stats(&stats)) {
+		shell_puts("not started\r\n");
+		return;
+	}
+	shell_printf("id %02x %02x %02x %lu Hz map %s\r\n", stats.uc_id[0],
+			stats.uc_id[1], stats.uc_id[2], (unsigned long)stats.ul_hz,
+			p_maps[stats.map]);
+	shell_printf("reads cpu %lu dma %lu bytes %lu\r\n",
+			(unsigned long)stats.ul_cpu_reads,
+			(unsigned long)stats.ul_dma_reads,
+			(unsigned long)stats.ul_read_bytes);
+	shell_printf("pages %lu erases %lu errors %lu\r\n",
+			(unsigned long)stats.ul_pages, (unsigned long)stats.ul_erases,
+			(unsigned long)stats.ul_errors);
+
+	if (argc < 2 || strcmp(argv[1], "bench")) {
+		return;
+	}
+	p_buf = dma_buf_alloc(CONF_SHELL_QSPI_BENCH_SIZE, DMA_BUF_CACHED);
+	if (!p_buf) {
+		shell_puts("out of memory\r\n");
+		return;
+	}
+	if (qspi_flash_bench(0, p_buf, CONF_SHELL_QSPI_BENCH_SIZE, &res) !=
+			STATUS_OK) {
+		shell_puts("read failed\r\n");
+	} else {
+		ul_cycles[0] = res.ul_uncached;
+		ul_cycles[1] = res.ul_cached_cold;
+		ul_cycles[2] = res.ul_cached_warm;
+		ul_cycles[3] = res.ul_dma;
+		for (i = 0; i < 4; i++) {
+			/* Kbytes/s at the current CPU clock. */
+			ull_rate = ul_cycles[i] ? (uint64_t)CONF_SHELL_QSPI_BENCH_SIZE *
+					clock_scale_get_cpu_hz() / 1024 / ul_cycles[i] : 0;
+			shell_printf("  %-12s %10lu cycles %8lu KB/s\r\n", p_modes[i],
+					(unsigned long)ul_cycles[i], (unsigned long)ull_rate);
+		}
+	}
+	dma_buf_free(p_buf);
+}
+
+/** @} */
@@ -0,0 +1,45 @@
+/**
+ * \file
+ *
+ * \brief Interactive console shell.
+ *
+ */
+
+#ifndef SHELL_H_INCLUDED
+#define SHELL_H_INCLUDED
+
+#include "compiler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup shell_group Console shell
+ *
+ * A command line on the console USART for field debugging. The shell task
+ * sleeps until the console receive interrupt notifies it, then edits the
+ * line in place: backspace/delete erase a character, Ctrl-U erases the
+ * line, Ctrl-C cancels it and the up arrow recalls the previous command.
+ *
+ * Commands are listed in shell_cmds.def and looked up through a perfect
+ * hash table generated by tools/gen_shell_table.py, i.e. one hash and one
+ * string comparison per command line.
+ *
+ * Command output waits for room in the console transmit ring by sleeping,
+ * so the shell can run at a low priority and never delays other tasks.
+ *
+ * @{
+ */
+
+void shell_task(void *pvParameters);
+int shell_printf(const char *p_fmt, ...)
+		__attribute__((format(__printf__, 1, 2)));
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHELL_H_INCLUDED */
@@ -0,0 +1,30 @@
+/**
+ * \file
+ *
+ * \brief Perfect hash table of the console shell commands.
+ *
+ * Generated by tools/gen_shell_table.py from shell_cmds.def, do not edit.
+ *
+ */
+
+#ifndef SHELL_CMD_TABLE_H_INCLUDED
+#define SHELL_CMD_TABLE_H_INCLUDED
+
+/** Seed of the command name hash. */
+#define SHELL_HASH_SEED    0x811C9DC8u
+
+/** Number of hash slots, power of two. */
+#define SHELL_HASH_SIZE    32
+
+/** Number of commands in shell_cmds.def. */
+#define SHELL_CMD_COUNT    14
+
+/** Index in shell_cmds.def of the command hashed to each slot, or -1. */
+static const int8_t gs_shell_slots[SHELL_HASH_SIZE] = {
+	-1, 13, -1, 2, -1, 3, -1, -1,
+	-1, 4, -1, 12, -1, 10, -1, 6,
+	11, 8, -1, 1, -1, 9, 7, -1,
+	-1, 5, 0, -1, -1, -1, -1, -1
+};
+
+#endif /* SHELL_CMD_TABLE_H_INCLUDED */
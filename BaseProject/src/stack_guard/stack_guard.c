@@ -0,0 +1,67 @@
+/**
+ * \file
+ *
+ * \brief MPU task stack guard.
+ *
+ */
+
+#include <asf.h>
+#include "conf_uart_serial.h"
+#include "fmt.h"
+#include "stack_guard.h"
+
+/**
+ * \addtogroup stack_guard_group
+ *
+ * @{
+ */
+
+/**
+ * \brief Set up the guard region and enable the MemManage fault. Call
+ * before starting the scheduler.
+ */
+void stack_guard_init(void)
+{
+	__DMB();
+	/* Parked over the flash vector table until the first switch. */
+	mpu_set_region(IFLASH_START_ADDRESS | MPU_REGION_VALID |
+			CONF_STACK_GUARD_MPU_REGION,
+			MPU_AP_PRIVILEGED_READONLY | MPU_REGION_EXECUTE_NEVER |
+			INNER_NORMAL_WB_NWA_TYPE(NON_SHAREABLE) |
+			mpu_cal_mpu_region_size(STACK_GUARD_SIZE) |
+			MPU_REGION_ENABLE);
+	mpu_enable(MPU_ENABLE | MPU_PRIVDEFENA);
+	SCB->SHCSR |= SCB_SHCSR_MEMFAULTENA_Msk;
+	__DSB();
+	__ISB();
+}
+
+/**
+ * \brief Write a string to the console USART by polling. The interrupt
+ * driven console cannot run from the fault handler.
+ */
+static void stack_guard_puts(const char *p_str)
+{
+	while (*p_str) {
+		usart_putchar((Usart *)CONF_UART, *p_str++);
+	}
+}
+
+/**
+ * \brief MemManage fault: a task wrote into its guard band, or another MPU
+ * violation.
+ */
+void MemManage_Handler(void)
+{
+	char c_msg[80];
+
+	fmt_snprintf(c_msg, sizeof(c_msg),
+			"\r\nmemory fault in task %s, CFSR 0x%08lx MMFAR 0x%08lx\r\n",
+			pcTaskGetTaskName(NULL), (unsigned long)SCB->CFSR,
+			(unsigned long)SCB->MMFAR);
+	stack_guard_puts(c_msg);
+	for (;;) {
+	}
+}
+
+/** @} */
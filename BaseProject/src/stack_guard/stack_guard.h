@@ -0,0 +1,76 @@
+/**
+ * \file
+ *
+ * \brief MPU task stack guard.
+ *
+ */
+
+#ifndef STACK_GUARD_H_INCLUDED
+#define STACK_GUARD_H_INCLUDED
+
+#include "compiler.h"
+#include "conf_stack_guard.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup stack_guard_group Task stack guard
+ *
+ * One MPU region is kept over the lowest STACK_GUARD_SIZE bytes, aligned,
+ * of the running task's stack. The region is read-only, so the kernel and
+ * uxTaskGetStackHighWaterMark() can still read the fill pattern there, but
+ * the first push past the end of the stack raises a MemManage fault, which
+ * names the task on the console and stops.
+ *
+ * The kernel moves the region to the incoming task on each context switch,
+ * through traceTASK_SWITCHED_IN() (see FreeRTOSConfig.h): a single RBAR
+ * write, replacing the fill pattern comparison of
+ * configCHECK_FOR_STACK_OVERFLOW 2. The first task runs unguarded until the
+ * first switch.
+ *
+ * Up to 2 * STACK_GUARD_SIZE - 1 bytes of each stack, depending on its
+ * alignment, are lost to the guard.
+ *
+ * Only a write into the band faults. A function whose stack frame is
+ * larger than the band can skip it entirely and corrupt the memory below
+ * without a fault; CONF_STACK_GUARD_SIZE is sized from the largest frame
+ * for that reason.
+ *
+ * The bench "kernel switch" item gives the context switch cost with either
+ * overflow check, built with CONF_STACK_GUARD 1 and 0.
+ *
+ * @{
+ */
+
+/** Guard band size, an MPU region size. */
+#define STACK_GUARD_SIZE     CONF_STACK_GUARD_SIZE
+
+#if (STACK_GUARD_SIZE < 32) || (STACK_GUARD_SIZE & (STACK_GUARD_SIZE - 1))
+#  error "CONF_STACK_GUARD_SIZE must be a power of two from 32"
+#endif
+
+void stack_guard_init(void);
+
+/**
+ * \brief Move the guard band to the bottom of a stack.
+ *
+ * \param p_stack Lowest address of the stack, TCB pxStack.
+ */
+static inline void stack_guard_switch_in(const void *p_stack)
+{
+	MPU->RBAR = (((uint32_t)p_stack + STACK_GUARD_SIZE - 1) &
+			~(uint32_t)(STACK_GUARD_SIZE - 1)) | MPU_RBAR_VALID_Msk |
+			CONF_STACK_GUARD_MPU_REGION;
+	/* The exception return completes the context synchronization. */
+	__DSB();
+}
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STACK_GUARD_H_INCLUDED */
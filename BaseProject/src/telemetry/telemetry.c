@@ -0,0 +1,237 @@
+/**
+ * \file
+ *
+ * \brief Binary telemetry channel over the console USART.
+ *
+ */
+
+#include <asf.h>
+#include <string.h>
+#include "conf_telemetry.h"
+#include "console.h"
+#include "cobs.h"
+#include "crc.h"
+#include "cycles.h"
+#include "telemetry.h"
+
+/**
+ * \addtogroup telemetry_group
+ *
+ * @{
+ */
+
+/* Largest frame before encoding: header, payload and CRC-32. */
+#define TLM_MAX_FRAME_SIZE    (TLM_HEADER_SIZE + CONF_TLM_MAX_PAYLOAD + 4)
+
+/* Largest frame on the wire: COBS overhead and both delimiters. */
+#define TLM_MAX_WIRE_SIZE     (COBS_MAX_ENCODED_LEN(TLM_MAX_FRAME_SIZE) + 2)
+
+static uint16_t gs_us_seq;
+static tlm_stats_t gs_stats;
+
+static inline void tlm_put_le16(uint8_t *p, uint16_t us_value)
+{
+	p[0] = (uint8_t)us_value;
+	p[1] = (uint8_t)(us_value >> 8);
+}
+
+static inline void tlm_put_le32(uint8_t *p, uint32_t ul_value)
+{
+	p[0] = (uint8_t)ul_value;
+	p[1] = (uint8_t)(ul_value >> 8);
+	p[2] = (uint8_t)(ul_value >> 16);
+	p[3] = (uint8_t)(ul_value >> 24);
+}
+
+/**
+ * \brief Initialize the telemetry channel.
+ *
+ * \note console_init() must have been called; the frames share its
+ * transmit ring with stdio. The core cycle counter is enabled to
+ * timestamp records.
+ */
+void tlm_init(void)
+{
+	cycle_counter_enable();
+
+	gs_us_seq = 0;
+	memset(&gs_stats, 0, sizeof(gs_stats));
+}
+
+/**
+ * \brief Send one record.
+ *
+ * The frame is encoded and queued as a whole, or dropped if the transmit
+ * ring cannot take it; the call never waits for the link. It may be used
+ * from tasks and from interrupts running at or below
+ * configMAX_SYSCALL_INTERRUPT_PRIORITY.
+ *
+ * \param uc_type Record type (\ref tlm_type).
+ * \param p_payload Pointer to the payload.
+ * \param ul_len Payload size, at most CONF_TLM_MAX_PAYLOAD.
+ *
+ * \return true if the frame was queued, false if it was dropped.
+ */
+bool tlm_send(uint8_t uc_type, const void *p_payload, size_t ul_len)
+{
+	uint8_t uc_frame[TLM_MAX_FRAME_SIZE];
+	uint8_t uc_wire[TLM_MAX_WIRE_SIZE];
+	UBaseType_t ux_mask;
+	size_t ul_body_len;
+	size_t ul_frame_len;
+	size_t ul_wire_len;
+	uint16_t us_seq;
+	bool b_sent;
+
+	if (ul_len > CONF_TLM_MAX_PAYLOAD) {
+		return false;
+	}
+
+	uc_frame[0] = uc_type;
+	uc_frame[1] = (ul_len >= CONF_TLM_CRC32_THRESHOLD) ? TLM_FLAG_CRC32 : 0;
+	memcpy(&uc_frame[TLM_HEADER_SIZE], p_payload, ul_len);
+	ul_body_len = TLM_HEADER_SIZE + ul_len;
+
+	/*
+	 * The frame is stamped and encoded with the console interrupt unmasked,
+	 * then queued under the mask only if no other sender took its sequence
+	 * number meanwhile; otherwise it is encoded again with the next one.
+	 * Frames thus reach the wire in sequence order.
+	 */
+	for (;;) {
+		us_seq = gs_us_seq;
+		tlm_put_le16(&uc_frame[2], us_seq);
+		tlm_put_le32(&uc_frame[4], DWT->CYCCNT);
+		ul_frame_len = ul_body_len;
+		if (uc_frame[1] & TLM_FLAG_CRC32) {
+			tlm_put_le32(&uc_frame[ul_frame_len],
+					crc32_update(0, uc_frame, ul_frame_len));
+			ul_frame_len += 4;
+		} else {
+			tlm_put_le16(&uc_frame[ul_frame_len],
+					crc16_update(0, uc_frame, ul_frame_len));
+			ul_frame_len += 2;
+		}
+		uc_wire[0] = COBS_DELIMITER;
+		ul_wire_len = 1 + cobs_encode(uc_frame, ul_frame_len, &uc_wire[1]);
+		uc_wire[ul_wire_len++] = COBS_DELIMITER;
+
+		ux_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+		if (us_seq == gs_us_seq) {
+			break;
+		}
+		portCLEAR_INTERRUPT_MASK_FROM_ISR(ux_mask);
+	}
+	gs_us_seq++;
+
+	b_sent = console_try_write(uc_wire, ul_wire_len);
+	if (b_sent) {
+		gs_stats.ul_sent++;
+		gs_stats.ul_bytes += ul_wire_len;
+	} else {
+		gs_stats.ul_dropped++;
+	}
+
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(ux_mask);
+
+	return b_sent;
+}
+
+/**
+ * \brief Send a block of samples prefixed by the channel header.
+ */
+static bool tlm_send_samples(uint8_t uc_type, uint8_t uc_channel,
+		const void *p_samples, size_t ul_size)
+{
+	uint8_t uc_payload[CONF_TLM_MAX_PAYLOAD];
+
+	if (ul_size + 2 > CONF_TLM_MAX_PAYLOAD) {
+		return false;
+	}
+	uc_payload[0] = uc_channel;
+	uc_payload[1] = 0;
+	memcpy(&uc_payload[2], p_samples, ul_size);
+
+	return tlm_send(uc_type, uc_payload, ul_size + 2);
+}
+
+/**
+ * \brief Send 16-bit samples of one channel.
+ *
+ * \param uc_channel Channel identifier.
+ * \param p_samples Pointer to the samples.
+ * \param ul_count Number of samples, at most (CONF_TLM_MAX_PAYLOAD - 2) / 2.
+ *
+ * \return true if the frame was queued, false otherwise.
+ */
+bool tlm_send_samples_i16(uint8_t uc_channel, const int16_t *p_samples,
+		size_t ul_count)
+{
+	return tlm_send_samples(TLM_TYPE_SAMPLES_I16, uc_channel, p_samples,
+			ul_count * sizeof(int16_t));
+}
+
+/**
+ * \brief Send 32-bit samples of one channel.
+ *
+ * \param uc_channel Channel identifier.
+ * \param p_samples Pointer to the samples.
+ * \param ul_count Number of samples, at most (CONF_TLM_MAX_PAYLOAD - 2) / 4.
+ *
+ * \return true if the frame was queued, false otherwise.
+ */
+bool tlm_send_samples_i32(uint8_t uc_channel, const int32_t *p_samples,
+		size_t ul_count)
+{
+	return tlm_send_samples(TLM_TYPE_SAMPLES_I32, uc_channel, p_samples,
+			ul_count * sizeof(int32_t));
+}
+
+/**
+ * \brief Send single precision samples of one channel.
+ *
+ * \param uc_channel Channel identifier.
+ * \param p_samples Pointer to the samples.
+ * \param ul_count Number of samples, at most (CONF_TLM_MAX_PAYLOAD - 2) / 4.
+ *
+ * \return true if the frame was queued, false otherwise.
+ */
+bool tlm_send_samples_f32(uint8_t uc_channel, const float *p_samples,
+		size_t ul_count)
+{
+	return tlm_send_samples(TLM_TYPE_SAMPLES_F32, uc_channel, p_samples,
+			ul_count * sizeof(float));
+}
+
+/**
+ * \brief Send a counter value.
+ *
+ * \param us_id Counter identifier.
+ * \param ul_value Counter value.
+ *
+ * \return true if the frame was queued, false otherwise.
+ */
+bool tlm_send_counter(uint16_t us_id, uint32_t ul_value)
+{
+	uint8_t uc_payload[6];
+
+	tlm_put_le16(&uc_payload[0], us_id);
+	tlm_put_le32(&uc_payload[2], ul_value);
+
+	return tlm_send(TLM_TYPE_COUNTER, uc_payload, sizeof(uc_payload));
+}
+
+/**
+ * \brief Get a snapshot of the telemetry statistics.
+ *
+ * \param p_stats Pointer to the structure to fill.
+ */
+void tlm_get_stats(tlm_stats_t *p_stats)
+{
+	UBaseType_t ux_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+
+	*p_stats = gs_stats;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(ux_mask);
+}
+
+/** @} */
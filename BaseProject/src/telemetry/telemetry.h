@@ -0,0 +1,92 @@
+/**
+ * \file
+ *
+ * \brief Binary telemetry channel over the console USART.
+ *
+ */
+
+#ifndef TELEMETRY_H_INCLUDED
+#define TELEMETRY_H_INCLUDED
+
+#include "compiler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup telemetry_group Binary telemetry
+ *
+ * Typed records are sent as COBS frames enclosed in 0x00 delimiters on the
+ * console link, interleaved with regular text output which never contains
+ * 0x00. The leading delimiter separates a frame from any text before it.
+ * Before COBS encoding a frame is laid out as (little endian):
+ *
+ * | Offset | Size | Field                                             |
+ * |--------|------|---------------------------------------------------|
+ * | 0      | 1    | Record type (\ref tlm_type)                       |
+ * | 1      | 1    | Flags (\ref TLM_FLAG_CRC32)                       |
+ * | 2      | 2    | Sequence number                                   |
+ * | 4      | 4    | Timestamp, core cycle counter                     |
+ * | 8      | n    | Payload                                           |
+ * | 8 + n  | 2/4  | CRC-16/X-25, or CRC-32 if TLM_FLAG_CRC32 is set   |
+ *
+ * The sequence number is incremented for every record, including those
+ * dropped because the transmit ring was full, so the host sees every loss
+ * as a gap. tools/tlm_decode.py decodes the stream on the host.
+ *
+ * @{
+ */
+
+/** Frame header size before the payload. */
+#define TLM_HEADER_SIZE        8
+
+/** The frame is protected by CRC-32 instead of CRC-16. */
+#define TLM_FLAG_CRC32         (1u << 0)
+
+/** Record types. Types from TLM_TYPE_USER up are application defined. */
+enum tlm_type {
+	/** Free-form bytes. */
+	TLM_TYPE_RAW = 0x00,
+	/** uint8_t channel, uint8_t reserved, int16_t samples[]. */
+	TLM_TYPE_SAMPLES_I16 = 0x01,
+	/** uint8_t channel, uint8_t reserved, int32_t samples[]. */
+	TLM_TYPE_SAMPLES_I32 = 0x02,
+	/** uint8_t channel, uint8_t reserved, float samples[]. */
+	TLM_TYPE_SAMPLES_F32 = 0x03,
+	/** uint16_t id, uint32_t value. */
+	TLM_TYPE_COUNTER = 0x04,
+	/** uint16_t id, uint32_t bytes used, uint32_t bytes free. */
+	TLM_TYPE_HEAP = 0x05,
+	/** First application defined type. */
+	TLM_TYPE_USER = 0x80,
+};
+
+/** Telemetry statistics. */
+typedef struct tlm_stats {
+	/** Frames queued for transmission. */
+	uint32_t ul_sent;
+	/** Frames dropped because the transmit ring was full. */
+	uint32_t ul_dropped;
+	/** Encoded bytes queued, delimiters included. */
+	uint32_t ul_bytes;
+} tlm_stats_t;
+
+void tlm_init(void);
+bool tlm_send(uint8_t uc_type, const void *p_payload, size_t ul_len);
+bool tlm_send_samples_i16(uint8_t uc_channel, const int16_t *p_samples,
+		size_t ul_count);
+bool tlm_send_samples_i32(uint8_t uc_channel, const int32_t *p_samples,
+		size_t ul_count);
+bool tlm_send_samples_f32(uint8_t uc_channel, const float *p_samples,
+		size_t ul_count);
+bool tlm_send_counter(uint16_t us_id, uint32_t ul_value);
+void tlm_get_stats(tlm_stats_t *p_stats);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TELEMETRY_H_INCLUDED */
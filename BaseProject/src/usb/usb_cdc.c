@@ -0,0 +1,547 @@
+/**
+ * \file
+ *
+ * \brief USB CDC serial port.
+ *
+ */
+
+#include <asf.h>
+#include <string.h>
+#include "conf_usb_cdc.h"
+#include "dma_buf.h"
+#include "usb_cdc.h"
+
+/**
+ * \addtogroup usb_cdc_group
+ *
+ * @{
+ */
+
+#if (CONF_USB_CDC_RX_SIZE % 512)
+#  error "CONF_USB_CDC_RX_SIZE must be a multiple of 512"
+#endif
+
+/** Endpoints. */
+#define USB_CDC_EP_DATA_IN        (1 | USB_EP_DIR_IN)
+#define USB_CDC_EP_DATA_OUT       2
+#define USB_CDC_EP_NOTIFY         (3 | USB_EP_DIR_IN)
+#define USB_CDC_NOTIFY_SIZE       16
+
+/** Descriptor types. */
+#define USB_DT_DEVICE             1
+#define USB_DT_CONFIGURATION      2
+#define USB_DT_STRING             3
+#define USB_DT_DEVICE_QUALIFIER   6
+#define USB_DT_OTHER_SPEED        7
+
+/** CDC class requests. */
+#define USB_CDC_SET_LINE_CODING         0x20
+#define USB_CDC_GET_LINE_CODING         0x21
+#define USB_CDC_SET_CONTROL_LINE_STATE  0x22
+#define USB_CDC_SEND_BREAK              0x23
+#define USB_CDC_DTR                     (1u << 0)
+
+/** Line coding size. */
+#define USB_CDC_LINE_CODING_SIZE  7
+
+/** Fields of the configuration descriptor that depend on the speed. */
+#define USB_CDC_CONF_NOTIFY_INTERVAL  43
+#define USB_CDC_CONF_IN_SIZE          57
+#define USB_CDC_CONF_OUT_SIZE         64
+
+static const uint8_t gs_uc_device_desc[] = {
+	18, USB_DT_DEVICE,
+	0x00, 0x02,                     /* USB 2.0 */
+	0x02, 0x00, 0x00,               /* CDC, at device level */
+	USBHS_DEV_EP0_SIZE,
+	CONF_USB_CDC_VID & 0xFF, CONF_USB_CDC_VID >> 8,
+	CONF_USB_CDC_PID & 0xFF, CONF_USB_CDC_PID >> 8,
+	0x00, 0x01,                     /* Release 1.00 */
+	1, 2, 3,                        /* Strings */
+	1,                              /* Configurations */
+};
+
+static const uint8_t gs_uc_qualifier_desc[] = {
+	10, USB_DT_DEVICE_QUALIFIER,
+	0x00, 0x02,
+	0x02, 0x00, 0x00,
+	USBHS_DEV_EP0_SIZE,
+	1,
+	0,
+};
+
+/** Configuration descriptor, completed for the speed by usb_cdc_conf(). */
+static const uint8_t gs_uc_conf_desc[] = {
+	9, USB_DT_CONFIGURATION,
+	67, 0,                          /* Total length */
+	2,                              /* Interfaces */
+	1,                              /* Configuration value */
+	0,
+	0x80, 50,                       /* Bus powered, 100 mA */
+
+	/* Communication interface: ACM */
+	9, 4, 0, 0, 1, 0x02, 0x02, 0x01, 0,
+	5, 0x24, 0x00, 0x10, 0x01,      /* Header, CDC 1.10 */
+	5, 0x24, 0x01, 0x00, 1,         /* Call management, data interface */
+	4, 0x24, 0x02, 0x02,            /* ACM: line coding, line state */
+	5, 0x24, 0x06, 0, 1,            /* Union: control 0, data 1 */
+	7, 5, USB_CDC_EP_NOTIFY, 0x03, USB_CDC_NOTIFY_SIZE, 0, 0,
+
+	/* Data interface */
+	9, 4, 1, 0, 2, 0x0A, 0x00, 0x00, 0,
+	7, 5, USB_CDC_EP_DATA_IN, 0x02, 0, 0, 0,
+	7, 5, USB_CDC_EP_DATA_OUT, 0x02, 0, 0, 0,
+};
+
+static const char *const gs_p_strings[] = {
+	CONF_USB_CDC_MANUFACTURER,
+	CONF_USB_CDC_PRODUCT,
+	CONF_USB_CDC_SERIAL,
+};
+
+static usbhs_dev_t gs_usbhs;
+static usb_cdc_callback_t gs_callback;
+static void *gs_p_ctx;
+
+/** Control transfer answers and data. */
+static uint8_t gs_uc_ctrl[sizeof(gs_uc_conf_desc) + 13];
+static uint8_t gs_uc_line_coding[USB_CDC_LINE_CODING_SIZE] = {
+	0x00, 0xC2, 0x01, 0x00,         /* 115200 */
+	0, 0, 8,                        /* 1 stop bit, no parity, 8 bits */
+};
+static uint8_t gs_uc_config;
+static bool gs_b_dtr;
+static bool gs_b_suspended;
+static volatile bool gs_b_open;
+
+/** Write in progress. */
+static const uint8_t *gs_p_tx;
+
+/** Receive buffer, and whether the class holds it. */
+static uint8_t *gs_p_rx_buf;
+static volatile bool gs_b_rx_held;
+
+static usb_cdc_stats_t gs_stats;
+
+/**
+ * \brief Configuration descriptor for a speed, in gs_uc_ctrl.
+ *
+ * \param b_high_speed Speed to describe.
+ * \param uc_type USB_DT_CONFIGURATION, or USB_DT_OTHER_SPEED.
+ */
+static void usb_cdc_conf(bool b_high_speed, uint8_t uc_type)
+{
+	uint16_t us_size = b_high_speed ? 512 : 64;
+
+	memcpy(gs_uc_ctrl, gs_uc_conf_desc, sizeof(gs_uc_conf_desc));
+	gs_uc_ctrl[1] = uc_type;
+	/* 16 ms: 2^(8 - 1) micro frames, or 16 frames. */
+	gs_uc_ctrl[USB_CDC_CONF_NOTIFY_INTERVAL] = b_high_speed ? 8 : 16;
+	gs_uc_ctrl[USB_CDC_CONF_IN_SIZE] = us_size & 0xFF;
+	gs_uc_ctrl[USB_CDC_CONF_IN_SIZE + 1] = us_size >> 8;
+	gs_uc_ctrl[USB_CDC_CONF_OUT_SIZE] = us_size & 0xFF;
+	gs_uc_ctrl[USB_CDC_CONF_OUT_SIZE + 1] = us_size >> 8;
+}
+
+/**
+ * \brief String descriptor, in gs_uc_ctrl.
+ *
+ * \return Descriptor length, or 0 if there is no such string.
+ */
+static uint16_t usb_cdc_string(uint8_t uc_index)
+{
+	const char *p_str;
+	uint32_t i;
+
+	if (uc_index == 0) {
+		/* Languages: US English. */
+		gs_uc_ctrl[0] = 4;
+		gs_uc_ctrl[1] = USB_DT_STRING;
+		gs_uc_ctrl[2] = 0x09;
+		gs_uc_ctrl[3] = 0x04;
+		return 4;
+	}
+	if (uc_index > sizeof(gs_p_strings) / sizeof(gs_p_strings[0])) {
+		return 0;
+	}
+	p_str = gs_p_strings[uc_index - 1];
+	for (i = 0; p_str[i] && 2 + 2 * (i + 1) <= sizeof(gs_uc_ctrl); i++) {
+		gs_uc_ctrl[2 + 2 * i] = p_str[i];
+		gs_uc_ctrl[3 + 2 * i] = 0;
+	}
+	gs_uc_ctrl[0] = 2 + 2 * i;
+	gs_uc_ctrl[1] = USB_DT_STRING;
+
+	return gs_uc_ctrl[0];
+}
+
+/**
+ * \brief Answer GET_DESCRIPTOR.
+ */
+static bool usb_cdc_get_descriptor(usbhs_dev_t *p_dev, uint16_t us_value)
+{
+	bool b_hs = usbhs_dev_is_high_speed(p_dev);
+	uint16_t us_len;
+
+	switch (us_value >> 8) {
+	case USB_DT_DEVICE:
+		usbhs_dev_ctrl_data(p_dev, (void *)gs_uc_device_desc,
+				sizeof(gs_uc_device_desc));
+		return true;
+	case USB_DT_CONFIGURATION:
+		usb_cdc_conf(b_hs, USB_DT_CONFIGURATION);
+		usbhs_dev_ctrl_data(p_dev, gs_uc_ctrl, sizeof(gs_uc_conf_desc));
+		return true;
+#if CONF_USB_CDC_HIGH_SPEED
+	case USB_DT_OTHER_SPEED:
+		usb_cdc_conf(!b_hs, USB_DT_OTHER_SPEED);
+		usbhs_dev_ctrl_data(p_dev, gs_uc_ctrl, sizeof(gs_uc_conf_desc));
+		return true;
+	case USB_DT_DEVICE_QUALIFIER:
+		usbhs_dev_ctrl_data(p_dev, (void *)gs_uc_qualifier_desc,
+				sizeof(gs_uc_qualifier_desc));
+		return true;
+#endif
+	case USB_DT_STRING:
+		us_len = usb_cdc_string(us_value & 0xFF);
+		if (!us_len) {
+			return false;
+		}
+		usbhs_dev_ctrl_data(p_dev, gs_uc_ctrl, us_len);
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * \brief Open the port if the host wants it and can have it, close it
+ * otherwise.
+ */
+static void usb_cdc_update(void)
+{
+	bool b_open = gs_uc_config && gs_b_dtr && !gs_b_suspended;
+
+	if (b_open == gs_b_open) {
+		return;
+	}
+	gs_b_open = b_open;
+	gs_stats.b_open = b_open;
+	if (b_open) {
+		gs_b_rx_held = false;
+		usbhs_dev_ep_start(&gs_usbhs, USB_CDC_EP_DATA_OUT, gs_p_rx_buf,
+				CONF_USB_CDC_RX_SIZE, false);
+		gs_callback(USB_CDC_OPEN, NULL, 0, gs_p_ctx);
+	} else {
+		usbhs_dev_ep_abort(&gs_usbhs, USB_CDC_EP_DATA_IN & 0x0F);
+		usbhs_dev_ep_abort(&gs_usbhs, USB_CDC_EP_DATA_OUT);
+		gs_p_tx = NULL;
+		gs_callback(USB_CDC_CLOSE, NULL, 0, gs_p_ctx);
+	}
+}
+
+/**
+ * \brief SET_CONFIGURATION: set the endpoints up, or remove them.
+ */
+static bool usb_cdc_set_config(usbhs_dev_t *p_dev, uint8_t uc_config)
+{
+	uint16_t us_size = usbhs_dev_is_high_speed(p_dev) ? 512 : 64;
+
+	if (uc_config > 1) {
+		return false;
+	}
+	if (gs_uc_config) {
+		gs_uc_config = 0;
+		usb_cdc_update();
+		usbhs_dev_ep_unconfigure(p_dev, USB_CDC_EP_NOTIFY);
+		usbhs_dev_ep_unconfigure(p_dev, USB_CDC_EP_DATA_OUT);
+		usbhs_dev_ep_unconfigure(p_dev, USB_CDC_EP_DATA_IN);
+	}
+	if (uc_config) {
+		if (usbhs_dev_ep_configure(p_dev, USB_CDC_EP_DATA_IN,
+				USBHS_EP_BULK, us_size, CONF_USB_CDC_BANKS) != STATUS_OK ||
+				usbhs_dev_ep_configure(p_dev, USB_CDC_EP_DATA_OUT,
+				USBHS_EP_BULK, us_size, CONF_USB_CDC_BANKS) != STATUS_OK ||
+				usbhs_dev_ep_configure(p_dev, USB_CDC_EP_NOTIFY,
+				USBHS_EP_INTERRUPT, USB_CDC_NOTIFY_SIZE, 1) != STATUS_OK) {
+			return false;
+		}
+		gs_uc_config = uc_config;
+		usb_cdc_update();
+	}
+	gs_stats.b_configured = gs_uc_config != 0;
+
+	return true;
+}
+
+/**
+ * \brief Standard requests.
+ */
+static bool usb_cdc_standard(usbhs_dev_t *p_dev, const usb_setup_t *p_req)
+{
+	uint8_t uc_recip = p_req->bmRequestType & USB_REQ_RECIP_Msk;
+
+	switch (p_req->bRequest) {
+	case USB_REQ_GET_DESCRIPTOR:
+		return usb_cdc_get_descriptor(p_dev, p_req->wValue);
+	case USB_REQ_GET_CONFIGURATION:
+		usbhs_dev_ctrl_data(p_dev, &gs_uc_config, 1);
+		return true;
+	case USB_REQ_SET_CONFIGURATION:
+		return usb_cdc_set_config(p_dev, p_req->wValue & 0xFF);
+	case USB_REQ_GET_STATUS:
+		gs_uc_ctrl[0] = 0;
+		gs_uc_ctrl[1] = 0;
+		if (uc_recip == USB_REQ_RECIP_ENDPOINT &&
+				usbhs_dev_ep_is_halted(p_dev, p_req->wIndex & 0xFF)) {
+			gs_uc_ctrl[0] = 1;
+		}
+		usbhs_dev_ctrl_data(p_dev, gs_uc_ctrl, 2);
+		return true;
+	case USB_REQ_CLEAR_FEATURE:
+	case USB_REQ_SET_FEATURE:
+		if (uc_recip != USB_REQ_RECIP_ENDPOINT ||
+				p_req->wValue != USB_EP_FEATURE_HALT || !gs_uc_config) {
+			return false;
+		}
+		usbhs_dev_ep_set_halt(p_dev, p_req->wIndex & 0xFF,
+				p_req->bRequest == USB_REQ_SET_FEATURE);
+		return true;
+	case USB_REQ_GET_INTERFACE:
+		gs_uc_ctrl[0] = 0;
+		usbhs_dev_ctrl_data(p_dev, gs_uc_ctrl, 1);
+		return gs_uc_config && p_req->wIndex < 2;
+	case USB_REQ_SET_INTERFACE:
+		return gs_uc_config && p_req->wIndex < 2 && p_req->wValue == 0;
+	default:
+		return false;
+	}
+}
+
+/**
+ * \brief Setup callback.
+ */
+static bool usb_cdc_setup(usbhs_dev_t *p_dev, const usb_setup_t *p_req)
+{
+	switch (p_req->bmRequestType & USB_REQ_TYPE_Msk) {
+	case USB_REQ_TYPE_STANDARD:
+		return usb_cdc_standard(p_dev, p_req);
+	case USB_REQ_TYPE_CLASS:
+		break;
+	default:
+		return false;
+	}
+
+	if ((p_req->bmRequestType & USB_REQ_RECIP_Msk) !=
+			USB_REQ_RECIP_INTERFACE || p_req->wIndex != 0) {
+		return false;
+	}
+	switch (p_req->bRequest) {
+	case USB_CDC_SET_LINE_CODING:
+		/* Kept on USBHS_DEV_CTRL_OUT. */
+		usbhs_dev_ctrl_data(p_dev, gs_uc_ctrl, USB_CDC_LINE_CODING_SIZE);
+		return true;
+	case USB_CDC_GET_LINE_CODING:
+		usbhs_dev_ctrl_data(p_dev, gs_uc_line_coding,
+				USB_CDC_LINE_CODING_SIZE);
+		return true;
+	case USB_CDC_SET_CONTROL_LINE_STATE:
+		gs_b_dtr = (p_req->wValue & USB_CDC_DTR) != 0;
+		usb_cdc_update();
+		return true;
+	case USB_CDC_SEND_BREAK:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * \brief Device event callback.
+ */
+static void usb_cdc_event(usbhs_dev_t *p_dev, usbhs_dev_event_t event,
+		uint8_t uc_ep, uint32_t ul_arg)
+{
+	const uint8_t *p_tx;
+
+	UNUSED(p_dev);
+
+	switch (event) {
+	case USBHS_DEV_RESET:
+		/* The endpoints are gone already. */
+		gs_uc_config = 0;
+		gs_b_dtr = false;
+		gs_b_suspended = false;
+		usb_cdc_update();
+		gs_stats.ul_resets++;
+		gs_stats.b_high_speed = ul_arg != 0;
+		gs_stats.b_configured = false;
+		break;
+	case USBHS_DEV_SUSPEND:
+		gs_b_suspended = true;
+		usb_cdc_update();
+		gs_stats.ul_suspends++;
+		break;
+	case USBHS_DEV_RESUME:
+		gs_b_suspended = false;
+		usb_cdc_update();
+		break;
+	case USBHS_DEV_CTRL_OUT:
+		if (gs_usbhs.ctrl_req.bRequest == USB_CDC_SET_LINE_CODING &&
+				ul_arg == USB_CDC_LINE_CODING_SIZE) {
+			memcpy(gs_uc_line_coding, gs_uc_ctrl,
+					USB_CDC_LINE_CODING_SIZE);
+			gs_stats.ul_baudrate = gs_uc_line_coding[0] |
+					(gs_uc_line_coding[1] << 8) |
+					(gs_uc_line_coding[2] << 16) |
+					((uint32_t)gs_uc_line_coding[3] << 24);
+		}
+		break;
+	case USBHS_DEV_EP_DONE:
+		if (uc_ep == (USB_CDC_EP_DATA_IN & 0x0F)) {
+			p_tx = gs_p_tx;
+			gs_p_tx = NULL;
+			gs_stats.ul_tx_bytes += ul_arg;
+			gs_callback(USB_CDC_TX_DONE, p_tx, ul_arg, gs_p_ctx);
+		} else if (uc_ep == USB_CDC_EP_DATA_OUT) {
+			if (ul_arg == 0) {
+				usbhs_dev_ep_start(&gs_usbhs, USB_CDC_EP_DATA_OUT,
+						gs_p_rx_buf, CONF_USB_CDC_RX_SIZE, false);
+				break;
+			}
+			dma_buf_sync_for_cpu(gs_p_rx_buf, ul_arg, DMA_BUF_FROM_DEVICE);
+			gs_b_rx_held = true;
+			gs_stats.ul_rx_bytes += ul_arg;
+			gs_callback(USB_CDC_RX, gs_p_rx_buf, ul_arg, gs_p_ctx);
+		}
+		break;
+	}
+}
+
+/**
+ * \brief Start the USB device and attach it to the bus.
+ *
+ * \param callback Event callback.
+ * \param p_ctx Passed to \a callback.
+ *
+ * \return true on success, false if already started, out of memory or if
+ * the USBHS did not start.
+ */
+bool usb_cdc_init(usb_cdc_callback_t callback, void *p_ctx)
+{
+	usbhs_dev_config_t cfg;
+
+	if (gs_callback || !callback) {
+		return false;
+	}
+	gs_p_rx_buf = dma_buf_alloc(CONF_USB_CDC_RX_SIZE, DMA_BUF_NOCACHE);
+	if (!gs_p_rx_buf) {
+		return false;
+	}
+
+	/* UTMI clock from the UPLL, see CONFIG_USBCLK_SOURCE. */
+	sysclk_enable_usb();
+	pmc_enable_periph_clk(ID_USBHS);
+
+	cfg.b_high_speed = CONF_USB_CDC_HIGH_SPEED;
+	cfg.setup = usb_cdc_setup;
+	cfg.callback = usb_cdc_event;
+	cfg.p_ctx = NULL;
+	if (usbhs_dev_init(&gs_usbhs, USBHS, &cfg) != STATUS_OK) {
+		dma_buf_free(gs_p_rx_buf);
+		return false;
+	}
+	gs_callback = callback;
+	gs_p_ctx = p_ctx;
+	gs_stats.ul_baudrate = 115200;
+
+	NVIC_ClearPendingIRQ(USBHS_IRQn);
+	NVIC_SetPriority(USBHS_IRQn, CONF_USB_CDC_IRQ_PRIORITY);
+	NVIC_EnableIRQ(USBHS_IRQn);
+	usbhs_dev_attach(&gs_usbhs);
+
+	return true;
+}
+
+/**
+ * \brief Tell whether the host has the port open.
+ */
+bool usb_cdc_is_open(void)
+{
+	return gs_b_open;
+}
+
+/**
+ * \brief Send a buffer.
+ *
+ * The DMA reads the buffer until USB_CDC_TX_DONE, or USB_CDC_CLOSE. It is
+ * cleaned from the data cache here.
+ *
+ * \param p_buf Data.
+ * \param ul_len Data length, up to USBHS_DEV_XFER_MAX bytes.
+ *
+ * \return true if the write started, false if the port is not open, a
+ * write is in progress, or \a ul_len is out of range.
+ */
+bool usb_cdc_write(const void *p_buf, uint32_t ul_len)
+{
+	irqflags_t flags;
+	bool b_started = false;
+
+	if (ul_len == 0 || ul_len > USBHS_DEV_XFER_MAX) {
+		return false;
+	}
+	dma_buf_sync_for_device(p_buf, ul_len, DMA_BUF_TO_DEVICE);
+
+	flags = cpu_irq_save();
+	if (gs_b_open && !gs_p_tx) {
+		gs_p_tx = (const uint8_t *)p_buf;
+		b_started = usbhs_dev_ep_start(&gs_usbhs,
+				USB_CDC_EP_DATA_IN & 0x0F, (void *)p_buf, ul_len,
+				true) == STATUS_OK;
+		if (!b_started) {
+			gs_p_tx = NULL;
+		}
+	}
+	cpu_irq_restore(flags);
+
+	return b_started;
+}
+
+/**
+ * \brief Give the receive buffer back after USB_CDC_RX, to receive more.
+ */
+void usb_cdc_rx_release(void)
+{
+	irqflags_t flags = cpu_irq_save();
+
+	if (gs_b_rx_held) {
+		gs_b_rx_held = false;
+		if (gs_b_open) {
+			usbhs_dev_ep_start(&gs_usbhs, USB_CDC_EP_DATA_OUT,
+					gs_p_rx_buf, CONF_USB_CDC_RX_SIZE, false);
+		}
+	}
+	cpu_irq_restore(flags);
+}
+
+/**
+ * \brief Get a snapshot of the port state and statistics.
+ *
+ * \return false if the device is not started.
+ */
+bool usb_cdc_get_stats(usb_cdc_stats_t *p_stats)
+{
+	irqflags_t flags;
+
+	if (!gs_callback) {
+		return false;
+	}
+	flags = cpu_irq_save();
+	*p_stats = gs_stats;
+	cpu_irq_restore(flags);
+
+	return true;
+}
+
+/** @} */
@@ -0,0 +1,86 @@
+/**
+ * \file
+ *
+ * \brief USB CDC serial port.
+ *
+ */
+
+#ifndef USB_CDC_H_INCLUDED
+#define USB_CDC_H_INCLUDED
+
+#include "compiler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup usb_cdc_group USB CDC serial port
+ *
+ * A USB device with one CDC-ACM function, the virtual serial port hosts
+ * support without a driver, on the USBHS at high speed. It also answers
+ * the standard requests, so this is the whole device.
+ *
+ * Data moves by DMA between memory and double banked bulk endpoints of 512
+ * bytes (64 at full speed). usb_cdc_write() sends a whole buffer in one
+ * transfer, ended by a short or empty packet so that the host read returns
+ * at once. Received data is passed to the callback in the receive buffer,
+ * and the host is held off until usb_cdc_rx_release() gives the buffer
+ * back, which makes the flow control.
+ *
+ * The port opens when the host sets DTR, which terminal programs do on
+ * open, and closes when it clears it, resets the bus or stops it (suspend,
+ * which is also what unplugging looks like). The line coding is accepted
+ * and ignored: the data goes at the bus speed whatever the baud rate.
+ *
+ * The callback runs from the USBHS interrupt.
+ *
+ * @{
+ */
+
+/** Events passed to the callback. */
+typedef enum usb_cdc_event {
+	/** The host opened the port. */
+	USB_CDC_OPEN,
+	/** The port closed. A write in progress was dropped. */
+	USB_CDC_CLOSE,
+	/** The write of usb_cdc_write() ended: \a ul_len bytes of \a p_data. */
+	USB_CDC_TX_DONE,
+	/**
+	 * \a ul_len bytes were received in \a p_data, readable until
+	 * usb_cdc_rx_release().
+	 */
+	USB_CDC_RX,
+} usb_cdc_event_t;
+
+/** Event callback. */
+typedef void (*usb_cdc_callback_t)(usb_cdc_event_t event,
+		const uint8_t *p_data, uint32_t ul_len, void *p_ctx);
+
+/** Port state and statistics. */
+typedef struct usb_cdc_stats {
+	uint32_t ul_tx_bytes;
+	uint32_t ul_rx_bytes;
+	/** Bus resets and suspends seen. */
+	uint32_t ul_resets;
+	uint32_t ul_suspends;
+	/** Baud rate set by the host, for information. */
+	uint32_t ul_baudrate;
+	bool b_high_speed;
+	bool b_configured;
+	bool b_open;
+} usb_cdc_stats_t;
+
+bool usb_cdc_init(usb_cdc_callback_t callback, void *p_ctx);
+bool usb_cdc_is_open(void);
+bool usb_cdc_write(const void *p_buf, uint32_t ul_len);
+void usb_cdc_rx_release(void);
+bool usb_cdc_get_stats(usb_cdc_stats_t *p_stats);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* USB_CDC_H_INCLUDED */
@@ -0,0 +1,94 @@
+/**
+ * \file
+ *
+ * \brief Consistent Overhead Byte Stuffing (COBS) encoder and decoder.
+ *
+ */
+
+#include "cobs.h"
+
+/**
+ * \addtogroup utils_cobs_group
+ *
+ * @{
+ */
+
+/**
+ * \brief Encode a buffer with COBS.
+ *
+ * \note The delimiter is not appended. \a p_dst must hold at least
+ * COBS_MAX_ENCODED_LEN(ul_len) bytes and must not overlap \a p_src.
+ *
+ * \param p_src Pointer to the data to encode.
+ * \param ul_len Number of bytes to encode.
+ * \param p_dst Pointer to the output buffer.
+ *
+ * \return Number of encoded bytes written to \a p_dst.
+ */
+size_t cobs_encode(const uint8_t *p_src, size_t ul_len, uint8_t *p_dst)
+{
+	const uint8_t *p_end = p_src + ul_len;
+	uint8_t *p_code = p_dst;
+	uint8_t *p_out = p_dst + 1;
+	uint8_t code = 1;
+
+	while (p_src < p_end) {
+		if (*p_src == 0) {
+			*p_code = code;
+			p_code = p_out++;
+			code = 1;
+		} else {
+			*p_out++ = *p_src;
+			if (++code == 0xFF) {
+				*p_code = code;
+				p_code = p_out++;
+				code = 1;
+			}
+		}
+		p_src++;
+	}
+	*p_code = code;
+
+	return (size_t)(p_out - p_dst);
+}
+
+/**
+ * \brief Decode a COBS block.
+ *
+ * \note \a p_src must not contain the delimiter. The decoded data is never
+ * longer than the encoded data, so \a p_dst may alias \a p_src for in-place
+ * decoding.
+ *
+ * \param p_src Pointer to the encoded block.
+ * \param ul_len Number of encoded bytes.
+ * \param p_dst Pointer to the output buffer (at least \a ul_len bytes).
+ *
+ * \return Number of decoded bytes, or 0 if the block is malformed.
+ */
+size_t cobs_decode(const uint8_t *p_src, size_t ul_len, uint8_t *p_dst)
+{
+	const uint8_t *p_end = p_src + ul_len;
+	uint8_t *p_out = p_dst;
+
+	while (p_src < p_end) {
+		uint8_t code = *p_src++;
+		uint8_t i;
+
+		if (code == 0 || (size_t)(p_end - p_src) < (size_t)(code - 1)) {
+			return 0;
+		}
+		for (i = 1; i < code; i++) {
+			if (*p_src == 0) {
+				return 0;
+			}
+			*p_out++ = *p_src++;
+		}
+		if (code != 0xFF && p_src < p_end) {
+			*p_out++ = 0;
+		}
+	}
+
+	return (size_t)(p_out - p_dst);
+}
+
+/** @} */
@@ -0,0 +1,43 @@
+/**
+ * \file
+ *
+ * \brief Consistent Overhead Byte Stuffing (COBS) encoder and decoder.
+ *
+ */
+
+#ifndef COBS_H_INCLUDED
+#define COBS_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup utils_cobs_group COBS framing
+ *
+ * COBS removes every zero byte from a buffer at a cost of at most one byte
+ * per 254 bytes of input, so that 0x00 can be used as an unambiguous frame
+ * delimiter on a byte stream.
+ *
+ * @{
+ */
+
+/** Worst-case encoded size of \a len input bytes (delimiter excluded). */
+#define COBS_MAX_ENCODED_LEN(len)    ((len) + ((len) / 254) + 1)
+
+/** Frame delimiter emitted after each encoded block. */
+#define COBS_DELIMITER               0x00
+
+size_t cobs_encode(const uint8_t *p_src, size_t ul_len, uint8_t *p_dst);
+size_t cobs_decode(const uint8_t *p_src, size_t ul_len, uint8_t *p_dst);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COBS_H_INCLUDED */
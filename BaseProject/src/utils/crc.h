@@ -0,0 +1,43 @@
+/**
+ * \file
+ *
+ * \brief Table-driven CRC-16 and CRC-32 (slice-by-4).
+ *
+ */
+
+#ifndef CRC_H_INCLUDED
+#define CRC_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup utils_crc_group CRC computation
+ *
+ * Both checksums use reflected polynomials so that four input bytes can be
+ * folded per iteration through four 256-entry tables:
+ * - CRC-16/X-25: polynomial 0x1021 (reflected 0x8408), init and final XOR
+ *   0xFFFF, check value 0x906E for "123456789".
+ * - CRC-32 (IEEE 802.3): polynomial 0x04C11DB7 (reflected 0xEDB88320), init
+ *   and final XOR 0xFFFFFFFF, check value 0xCBF43926 for "123456789".
+ *
+ * The functions can be chained: pass 0 as \a crc for the first block and
+ * the previous result for the following ones.
+ *
+ * @{
+ */
+
+uint16_t crc16_update(uint16_t crc, const void *p_data, size_t ul_len);
+uint32_t crc32_update(uint32_t crc, const void *p_data, size_t ul_len);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRC_H_INCLUDED */
@@ -0,0 +1,51 @@
+/**
+ * \file
+ *
+ * \brief Core cycle counter.
+ *
+ */
+
+#ifndef CYCLES_H_INCLUDED
+#define CYCLES_H_INCLUDED
+
+#include <stdint.h>
+#include "compiler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup utils_cycles_group Core cycle counter
+ *
+ * The DWT cycle counter (DWT_CYCCNT) counts processor clock cycles and wraps
+ * around every 2^32 of them, so differences of two reads are right across
+ * a wrap.
+ *
+ * It stops at reset and runs only once the trace block is enabled and the
+ * DWT unlocked. Every module that times with it calls
+ * cycle_counter_enable() when it starts; the call leaves a running counter
+ * as it is.
+ *
+ * @{
+ */
+
+/**
+ * \brief Start the cycle counter if it is not running yet.
+ *
+ * Touches no RAM, so it may run before the sections are initialized.
+ */
+static inline void cycle_counter_enable(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->LAR = 0xC5ACCE55;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CYCLES_H_INCLUDED */
@@ -0,0 +1,116 @@
+/**
+ * \file
+ *
+ * \brief Data cache maintenance by address range.
+ *
+ */
+
+#ifndef DCACHE_H_INCLUDED
+#define DCACHE_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include "compiler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup utils_dcache_group Data cache maintenance
+ *
+ * The Cortex-M7 data cache is enabled by board_init() in write-back mode,
+ * so memory shared with a DMA master has to be maintained by hand:
+ * - clean a buffer before the DMA reads it;
+ * - clean and invalidate a buffer before the DMA writes it, so that no dirty
+ *   line gets evicted on top of the new data, and invalidate it again once
+ *   the DMA is done, before the CPU reads it.
+ *
+ * The operations work on whole cache lines. A buffer that the DMA writes
+ * must therefore start on a line boundary and span whole lines, see
+ * DCACHE_ALIGNED and DCACHE_ROUNDUP().
+ *
+ * The CMSIS version shipped with ASF has no SCB_*DCache_by_Addr() helpers,
+ * these write the by-address maintenance registers directly.
+ *
+ * @{
+ */
+
+/** Data cache line size in bytes. */
+#define DCACHE_LINE_SIZE    32
+
+/** Round a buffer size up to whole cache lines. */
+#define DCACHE_ROUNDUP(size) \
+	(((size) + DCACHE_LINE_SIZE - 1) & ~(DCACHE_LINE_SIZE - 1))
+
+/** Align a buffer on a cache line. */
+#define DCACHE_ALIGNED      __attribute__((aligned(DCACHE_LINE_SIZE)))
+
+/**
+ * \brief Write the lines covering a range back to memory.
+ */
+static inline void dcache_clean(const volatile void *p_addr, size_t ul_len)
+{
+	uint32_t ul_line = (uint32_t)p_addr & ~(DCACHE_LINE_SIZE - 1);
+	uint32_t ul_end = (uint32_t)p_addr + ul_len;
+
+	if (!ul_len) {
+		return;
+	}
+	__DSB();
+	for (; ul_line < ul_end; ul_line += DCACHE_LINE_SIZE) {
+		SCB->DCCMVAC = ul_line;
+	}
+	__DSB();
+	__ISB();
+}
+
+/**
+ * \brief Discard the lines covering a range. Data of other objects sharing
+ * the first or last line is lost if it was dirty.
+ */
+static inline void dcache_invalidate(const volatile void *p_addr,
+		size_t ul_len)
+{
+	uint32_t ul_line = (uint32_t)p_addr & ~(DCACHE_LINE_SIZE - 1);
+	uint32_t ul_end = (uint32_t)p_addr + ul_len;
+
+	if (!ul_len) {
+		return;
+	}
+	__DSB();
+	for (; ul_line < ul_end; ul_line += DCACHE_LINE_SIZE) {
+		/* Invalidate by MVA to PoC, named DCIMVAU in this CMSIS. */
+		SCB->DCIMVAU = ul_line;
+	}
+	__DSB();
+	__ISB();
+}
+
+/**
+ * \brief Write back, then discard, the lines covering a range.
+ */
+static inline void dcache_clean_invalidate(const volatile void *p_addr,
+		size_t ul_len)
+{
+	uint32_t ul_line = (uint32_t)p_addr & ~(DCACHE_LINE_SIZE - 1);
+	uint32_t ul_end = (uint32_t)p_addr + ul_len;
+
+	if (!ul_len) {
+		return;
+	}
+	__DSB();
+	for (; ul_line < ul_end; ul_line += DCACHE_LINE_SIZE) {
+		SCB->DCCIMVAC = ul_line;
+	}
+	__DSB();
+	__ISB();
+}
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DCACHE_H_INCLUDED */
@@ -0,0 +1,180 @@
+/**
+ * \file
+ *
+ * \brief DMA buffer allocation and cache maintenance.
+ *
+ */
+
+#include <asf.h>
+#include <malloc.h>
+#include "conf_dma_buf.h"
+#include "dma_buf.h"
+
+/**
+ * \addtogroup utils_dma_buf_group
+ *
+ * @{
+ */
+
+#if (CONF_DMA_BUF_NOCACHE_SIZE & (CONF_DMA_BUF_NOCACHE_SIZE - 1)) || \
+		(CONF_DMA_BUF_NOCACHE_SIZE < 256)
+#  error "CONF_DMA_BUF_NOCACHE_SIZE must be a power of two, 256 or more"
+#endif
+
+/** Pool allocation unit: one cache line. */
+#define DMA_BUF_LINES    (CONF_DMA_BUF_NOCACHE_SIZE / DCACHE_LINE_SIZE)
+
+/**
+ * Non-cacheable pool. The MPU wants a region aligned on its size; .nocache
+ * is placed first in RAM, where the alignment costs nothing.
+ */
+static uint8_t gs_pool[CONF_DMA_BUF_NOCACHE_SIZE]
+		__attribute__((section(".nocache"), aligned(CONF_DMA_BUF_NOCACHE_SIZE)));
+
+/** Pool lines in use, one bit per line. */
+static uint32_t gs_ul_used[DMA_BUF_LINES / 32];
+/** Length in lines of the block starting at each line, 0 elsewhere. */
+static uint16_t gs_us_len[DMA_BUF_LINES];
+
+/**
+ * \brief Map the pool non-cacheable. Call once, before the first
+ * DMA_BUF_NOCACHE allocation.
+ */
+void dma_buf_init(void)
+{
+	__DMB();
+	mpu_set_region((uint32_t)gs_pool | MPU_REGION_VALID |
+			CONF_DMA_BUF_MPU_REGION,
+			MPU_AP_FULL_ACCESS | MPU_REGION_EXECUTE_NEVER |
+			INNER_OUTER_NORMAL_NOCACHE_TYPE(SHAREABLE) |
+			mpu_cal_mpu_region_size(CONF_DMA_BUF_NOCACHE_SIZE) |
+			MPU_REGION_ENABLE);
+	/* Default memory map everywhere else. */
+	mpu_enable(MPU_ENABLE | MPU_PRIVDEFENA);
+	__DSB();
+	__ISB();
+
+	/* Lines of the pool may still be in the cache from before. */
+	dcache_clean_invalidate(gs_pool, sizeof(gs_pool));
+}
+
+/**
+ * \brief Tell whether a pool line is in use.
+ */
+static inline bool dma_buf_line_used(uint32_t ul_line)
+{
+	return (gs_ul_used[ul_line / 32] >> (ul_line % 32)) & 1;
+}
+
+/**
+ * \brief Mark pool lines used or free.
+ */
+static void dma_buf_mark(uint32_t ul_first, uint32_t ul_lines, bool b_used)
+{
+	uint32_t ul_line;
+
+	for (ul_line = ul_first; ul_line < ul_first + ul_lines; ul_line++) {
+		if (b_used) {
+			gs_ul_used[ul_line / 32] |= 1u << (ul_line % 32);
+		} else {
+			gs_ul_used[ul_line / 32] &= ~(1u << (ul_line % 32));
+		}
+	}
+}
+
+/**
+ * \brief First fit allocation of pool lines.
+ */
+static void *dma_buf_pool_alloc(uint32_t ul_lines)
+{
+	uint32_t ul_first = 0;
+	uint32_t ul_line;
+	void *p_buf = NULL;
+
+	taskENTER_CRITICAL();
+	for (ul_line = 0; ul_line < DMA_BUF_LINES; ul_line++) {
+		if (dma_buf_line_used(ul_line)) {
+			ul_first = ul_line + 1;
+		} else if (ul_line + 1 - ul_first == ul_lines) {
+			dma_buf_mark(ul_first, ul_lines, true);
+			gs_us_len[ul_first] = ul_lines;
+			p_buf = &gs_pool[ul_first * DCACHE_LINE_SIZE];
+			break;
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	return p_buf;
+}
+
+/**
+ * \brief Allocate a DMA buffer, cache line aligned and padded to whole
+ * lines.
+ *
+ * \param ul_size Size in bytes.
+ * \param ul_flags DMA_BUF_NOCACHE or DMA_BUF_CACHED.
+ *
+ * \return The buffer, or NULL if there is no room. The content is undefined.
+ */
+void *dma_buf_alloc(size_t ul_size, uint32_t ul_flags)
+{
+	void *p_buf;
+
+	if (!ul_size) {
+		return NULL;
+	}
+	if (ul_flags & DMA_BUF_NOCACHE) {
+		if (ul_size > CONF_DMA_BUF_NOCACHE_SIZE) {
+			return NULL;
+		}
+		return dma_buf_pool_alloc(DCACHE_ROUNDUP(ul_size) /
+				DCACHE_LINE_SIZE);
+	}
+
+	vTaskSuspendAll();
+	p_buf = memalign(DCACHE_LINE_SIZE, DCACHE_ROUNDUP(ul_size));
+	xTaskResumeAll();
+
+	return p_buf;
+}
+
+/**
+ * \brief Free a buffer from dma_buf_alloc(). NULL is ignored.
+ */
+void dma_buf_free(void *p_buf)
+{
+	uint32_t ul_first;
+
+	if (!p_buf) {
+		return;
+	}
+	if ((uint8_t *)p_buf < gs_pool ||
+			(uint8_t *)p_buf >= gs_pool + sizeof(gs_pool)) {
+		vTaskSuspendAll();
+		free(p_buf);
+		xTaskResumeAll();
+		return;
+	}
+
+	ul_first = ((uint8_t *)p_buf - gs_pool) / DCACHE_LINE_SIZE;
+	taskENTER_CRITICAL();
+	dma_buf_mark(ul_first, gs_us_len[ul_first], false);
+	gs_us_len[ul_first] = 0;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * \brief Tell whether the CPU and the DMA see a buffer the same way without
+ * cache maintenance: it is in the non-cacheable pool or in the DTCM, or the
+ * data cache is off.
+ */
+bool dma_buf_is_coherent(const volatile void *p_buf)
+{
+	uint32_t ul_addr = (uint32_t)p_buf;
+
+	return (ul_addr - (uint32_t)gs_pool < sizeof(gs_pool)) ||
+			(ul_addr >= DTCM_START_ADDRESS && ul_addr <= DTCM_END_ADDRESS) ||
+			!(SCB->CCR & SCB_CCR_DC_Msk);
+}
+
+/** @} */
@@ -0,0 +1,95 @@
+/**
+ * \file
+ *
+ * \brief DMA buffer allocation and cache maintenance.
+ *
+ */
+
+#ifndef DMA_BUF_H_INCLUDED
+#define DMA_BUF_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include "compiler.h"
+#include "dcache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup utils_dma_buf_group DMA buffers
+ *
+ * Buffers shared with a DMA master, cache line aligned and padded to whole
+ * cache lines so that maintenance never touches a neighbour. They come from
+ * one of two places:
+ * - DMA_BUF_NOCACHE: a pool mapped non-cacheable by an MPU region. The CPU
+ *   and the DMA always see the same data, at the price of uncached CPU
+ *   accesses. Meant for descriptors and small, often touched buffers.
+ * - DMA_BUF_CACHED: the heap. CPU accesses are cached, and the owner
+ *   brackets each transfer with dma_buf_sync_for_device() and
+ *   dma_buf_sync_for_cpu(), which do the \ref utils_dcache_group maintenance
+ *   the direction needs.
+ *
+ * The sync calls do nothing but order the memory accesses on a
+ * non-cacheable buffer, so drivers can call them whatever the buffer
+ * origin. They also accept statically allocated buffers that follow the
+ * same alignment rules (DCACHE_ALIGNED, DCACHE_ROUNDUP()).
+ *
+ * @{
+ */
+
+/** Allocation flags. */
+#define DMA_BUF_CACHED      0
+#define DMA_BUF_NOCACHE     (1u << 0)
+
+/** Transfer direction, seen from memory. */
+enum dma_buf_dir {
+	/** The DMA reads the buffer. */
+	DMA_BUF_TO_DEVICE,
+	/** The DMA writes the buffer. */
+	DMA_BUF_FROM_DEVICE,
+	/** The DMA reads and writes the buffer. */
+	DMA_BUF_BIDIRECTIONAL,
+};
+
+void dma_buf_init(void);
+void *dma_buf_alloc(size_t ul_size, uint32_t ul_flags);
+void dma_buf_free(void *p_buf);
+bool dma_buf_is_coherent(const volatile void *p_buf);
+
+/**
+ * \brief Hand a buffer over to the DMA, before the transfer starts.
+ */
+static inline void dma_buf_sync_for_device(const volatile void *p_buf,
+		size_t ul_len, enum dma_buf_dir dir)
+{
+	if (dma_buf_is_coherent(p_buf)) {
+		__DMB();
+	} else if (dir == DMA_BUF_TO_DEVICE) {
+		dcache_clean(p_buf, ul_len);
+	} else {
+		dcache_clean_invalidate(p_buf, ul_len);
+	}
+}
+
+/**
+ * \brief Take a buffer back from the DMA, once the transfer is done.
+ */
+static inline void dma_buf_sync_for_cpu(const volatile void *p_buf,
+		size_t ul_len, enum dma_buf_dir dir)
+{
+	if (dma_buf_is_coherent(p_buf)) {
+		__DMB();
+	} else if (dir != DMA_BUF_TO_DEVICE) {
+		dcache_invalidate(p_buf, ul_len);
+	}
+}
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_BUF_H_INCLUDED */
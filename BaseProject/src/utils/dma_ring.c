@@ -0,0 +1,226 @@
+/**
+ * \file
+ *
+ * \brief Ring of blocks filled by a looping XDMAC descriptor list.
+ *
+ */
+
+#include <asf.h>
+#include <string.h>
+#include "dcache.h"
+#include "dma_ring.h"
+
+/**
+ * \addtogroup utils_dma_ring_group
+ *
+ * @{
+ */
+
+/**
+ * \brief Set a ring up over its blocks. Call once, before the first
+ * dma_ring_start().
+ *
+ * \param p_blocks \a ul_blocks blocks of \a ul_block_size bytes, one after
+ * the other, cache line aligned.
+ * \param p_desc One descriptor per block, cache line aligned.
+ * \param p_seq One sequence number per block.
+ *
+ * \return true on success, false out of memory.
+ */
+bool dma_ring_init(dma_ring_t *p_ring, void *p_blocks,
+		uint32_t ul_block_size, uint32_t ul_blocks, lld_view1 *p_desc,
+		uint32_t *p_seq)
+{
+	if (!p_ring->x_ready) {
+		p_ring->x_ready = xSemaphoreCreateBinary();
+		if (!p_ring->x_ready) {
+			return false;
+		}
+	}
+	p_ring->p_blocks = p_blocks;
+	p_ring->ul_block_size = ul_block_size;
+	p_ring->ul_blocks = ul_blocks;
+	p_ring->p_desc = p_desc;
+	p_ring->p_seq = p_seq;
+	dma_ring_reset(p_ring);
+
+	return true;
+}
+
+/**
+ * \brief Empty the ring and program a channel to fill it, from the first
+ * block. The channel is left disabled, for the owner to enable once its
+ * peripheral is ready.
+ *
+ * \param ul_ch Channel, disabled.
+ * \param ul_src Peripheral data register.
+ * \param ul_ubc Data units per block.
+ * \param ul_cc Channel configuration, XDMAC_CC_* bits.
+ */
+void dma_ring_start(dma_ring_t *p_ring, uint32_t ul_ch, uint32_t ul_src,
+		uint32_t ul_ubc, uint32_t ul_cc)
+{
+	xdmac_channel_config_t cfg;
+	uint32_t i;
+
+	dma_ring_reset(p_ring);
+
+	for (i = 0; i < p_ring->ul_blocks; i++) {
+		p_ring->p_desc[i].mbr_nda =
+				(uint32_t)&p_ring->p_desc[(i + 1) % p_ring->ul_blocks];
+		p_ring->p_desc[i].mbr_ubc = XDMAC_UBC_NVIEW_NDV1 |
+				XDMAC_UBC_NDE_FETCH_EN | XDMAC_UBC_NSEN_UPDATED |
+				XDMAC_UBC_NDEN_UPDATED | XDMAC_UBC_UBLEN(ul_ubc);
+		p_ring->p_desc[i].mbr_sa = ul_src;
+		p_ring->p_desc[i].mbr_da =
+				(uint32_t)&p_ring->p_blocks[i * p_ring->ul_block_size];
+	}
+	dcache_clean(p_ring->p_desc, p_ring->ul_blocks * sizeof(lld_view1));
+	dcache_clean_invalidate(p_ring->p_blocks,
+			p_ring->ul_blocks * p_ring->ul_block_size);
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.mbr_cfg = ul_cc;
+	xdmac_configure_transfer(XDMAC, ul_ch, &cfg);
+	xdmac_channel_set_descriptor_control(XDMAC, ul_ch,
+			XDMAC_CNDC_NDE_DSCR_FETCH_EN | XDMAC_CNDC_NDVIEW_NDV1 |
+			XDMAC_CNDC_NDSUP_SRC_PARAMS_UPDATED |
+			XDMAC_CNDC_NDDUP_DST_PARAMS_UPDATED);
+	xdmac_channel_set_descriptor_addr(XDMAC, ul_ch,
+			(uint32_t)&p_ring->p_desc[0], 0);
+	xdmac_channel_enable_interrupt(XDMAC, ul_ch,
+			XDMAC_CIE_BIE | DMA_RING_ERRORS);
+}
+
+/**
+ * \brief Empty the ring and drop the block held, once the channel is
+ * stopped.
+ */
+void dma_ring_reset(dma_ring_t *p_ring)
+{
+	taskENTER_CRITICAL();
+	p_ring->ul_dma_block = 0;
+	p_ring->ul_read = 0;
+	p_ring->ul_filled = 0;
+	p_ring->b_held = false;
+	p_ring->b_clobbered = false;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * \brief Account for one more filled block.
+ */
+static void dma_ring_block_filled(dma_ring_t *p_ring)
+{
+	p_ring->p_seq[p_ring->ul_dma_block] = p_ring->ul_next_seq++;
+	p_ring->ul_dma_block = (p_ring->ul_dma_block + 1) % p_ring->ul_blocks;
+	p_ring->ul_total++;
+
+	if (++p_ring->ul_filled == p_ring->ul_blocks) {
+		/* The DMA has moved on to the oldest unread block: drop it. */
+		if (p_ring->b_held) {
+			p_ring->b_clobbered = true;
+		}
+		p_ring->ul_read = (p_ring->ul_read + 1) % p_ring->ul_blocks;
+		p_ring->ul_filled--;
+		p_ring->ul_dropped++;
+	}
+}
+
+/**
+ * \brief Account for the blocks filled, from the XDMAC callback of the
+ * channel.
+ *
+ * The block end status is a single flag, so the number of blocks filled
+ * since the last interrupt is taken from the channel destination address.
+ *
+ * \param ul_status Channel status passed to the callback.
+ * \param p_woken Set to pdTRUE if the reader was woken.
+ */
+void dma_ring_isr(dma_ring_t *p_ring, uint32_t ul_ch, uint32_t ul_status,
+		BaseType_t *p_woken)
+{
+	uint32_t ul_pos;
+	uint32_t ul_count;
+
+	if (!(ul_status & XDMAC_CIS_BIS)) {
+		return;
+	}
+	ul_pos = (xdmac_channel_get_destination_addr(XDMAC, ul_ch) -
+			(uint32_t)p_ring->p_blocks) / p_ring->ul_block_size;
+	ul_count = (ul_pos + p_ring->ul_blocks - p_ring->ul_dma_block) %
+			p_ring->ul_blocks;
+	if (ul_count == 0) {
+		ul_count = 1;
+	}
+	while (ul_count--) {
+		dma_ring_block_filled(p_ring);
+	}
+	xSemaphoreGiveFromISR(p_ring->x_ready, p_woken);
+}
+
+/**
+ * \brief Take the oldest filled block, waiting for one if needed.
+ *
+ * Only one block can be held at a time; give it back with
+ * dma_ring_release() before taking the next one.
+ *
+ * \param p_seq Set to the sequence number of the block.
+ * \param x_timeout Maximum time to wait, in ticks.
+ *
+ * \return The block, invalidated in the cache, or NULL on timeout or if a
+ * block is already held.
+ */
+void *dma_ring_get(dma_ring_t *p_ring, uint32_t *p_seq,
+		TickType_t x_timeout)
+{
+	uint8_t *p_block;
+
+	for (;;) {
+		taskENTER_CRITICAL();
+		if (p_ring->b_held) {
+			taskEXIT_CRITICAL();
+			return NULL;
+		}
+		if (p_ring->ul_filled) {
+			break;
+		}
+		taskEXIT_CRITICAL();
+		if (xSemaphoreTake(p_ring->x_ready, x_timeout) != pdTRUE) {
+			return NULL;
+		}
+	}
+	p_block = &p_ring->p_blocks[p_ring->ul_read * p_ring->ul_block_size];
+	p_ring->b_held = true;
+	p_ring->b_clobbered = false;
+	*p_seq = p_ring->p_seq[p_ring->ul_read];
+	taskEXIT_CRITICAL();
+
+	dcache_invalidate(p_block, p_ring->ul_block_size);
+
+	return p_block;
+}
+
+/**
+ * \brief Give back the block taken with dma_ring_get().
+ *
+ * \return true if the block content was intact for the whole time it was
+ * held, false if the DMA has started overwriting it.
+ */
+bool dma_ring_release(dma_ring_t *p_ring)
+{
+	bool b_intact;
+
+	taskENTER_CRITICAL();
+	b_intact = !p_ring->b_clobbered;
+	if (p_ring->b_held && b_intact) {
+		p_ring->ul_read = (p_ring->ul_read + 1) % p_ring->ul_blocks;
+		p_ring->ul_filled--;
+	}
+	p_ring->b_held = false;
+	taskEXIT_CRITICAL();
+
+	return b_intact;
+}
+
+/** @} */
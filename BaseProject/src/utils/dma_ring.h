@@ -0,0 +1,90 @@
+/**
+ * \file
+ *
+ * \brief Ring of blocks filled by a looping XDMAC descriptor list.
+ *
+ */
+
+#ifndef DMA_RING_H_INCLUDED
+#define DMA_RING_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "xdmac.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup utils_dma_ring_group DMA block ring
+ *
+ * A peripheral to memory channel walks a circular list of descriptors, one
+ * per block, and raises its block end interrupt after each one. The ring
+ * hands the filled blocks to one reader task, oldest first, one at a time.
+ *
+ * The DMA never waits: when it comes back to the oldest unread block, that
+ * block is dropped. If the reader holds it, the reader learns when it gives
+ * it back that the content was overwritten meanwhile.
+ *
+ * The owner allocates the blocks (cache line aligned, whole cache lines),
+ * one descriptor and one sequence number per block, and its XDMAC channel.
+ * It calls dma_ring_isr() from the channel callback and keeps its own
+ * peripheral status.
+ *
+ * @{
+ */
+
+/** Channel errors, for the owner to enable and count. */
+#define DMA_RING_ERRORS \
+	(XDMAC_CIE_RBIE | XDMAC_CIE_WBIE | XDMAC_CIE_ROIE)
+
+/**
+ * Ring of blocks. The owner may read the counters, in a critical section;
+ * the other fields are private.
+ */
+typedef struct dma_ring {
+	uint8_t *p_blocks;
+	uint32_t ul_block_size;
+	uint32_t ul_blocks;
+	lld_view1 *p_desc;
+	uint32_t *p_seq;
+	SemaphoreHandle_t x_ready;
+
+	/* Shared with the XDMAC interrupt. */
+	/** Block the DMA is filling. */
+	uint32_t ul_dma_block;
+	/** Oldest filled block and number of filled blocks. */
+	uint32_t ul_read;
+	uint32_t ul_filled;
+	/** The reader holds ul_read. */
+	bool b_held;
+	/** The held block was dropped and is being overwritten. */
+	bool b_clobbered;
+	uint32_t ul_next_seq;
+	/** Blocks filled and blocks dropped since dma_ring_init(). */
+	uint32_t ul_total;
+	uint32_t ul_dropped;
+} dma_ring_t;
+
+bool dma_ring_init(dma_ring_t *p_ring, void *p_blocks,
+		uint32_t ul_block_size, uint32_t ul_blocks, lld_view1 *p_desc,
+		uint32_t *p_seq);
+void dma_ring_start(dma_ring_t *p_ring, uint32_t ul_ch, uint32_t ul_src,
+		uint32_t ul_ubc, uint32_t ul_cc);
+void dma_ring_reset(dma_ring_t *p_ring);
+void dma_ring_isr(dma_ring_t *p_ring, uint32_t ul_ch, uint32_t ul_status,
+		BaseType_t *p_woken);
+void *dma_ring_get(dma_ring_t *p_ring, uint32_t *p_seq,
+		TickType_t x_timeout);
+bool dma_ring_release(dma_ring_t *p_ring);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DMA_RING_H_INCLUDED */
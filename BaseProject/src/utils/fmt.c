@@ -0,0 +1,440 @@
+/**
+ * \file
+ *
+ * \brief Small reentrant printf-style formatter.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "fmt.h"
+
+/**
+ * \addtogroup utils_fmt_group
+ *
+ * @{
+ */
+
+/* Conversion flags. */
+#define FMT_LEFT       (1u << 0)
+#define FMT_ZERO       (1u << 1)
+#define FMT_PLUS       (1u << 2)
+#define FMT_SPACE      (1u << 3)
+#define FMT_UPPER      (1u << 4)
+#define FMT_PREC       (1u << 5)
+#define FMT_ALT        (1u << 6)
+
+/* Length modifiers. */
+enum fmt_len {
+	FMT_LEN_INT,
+	FMT_LEN_CHAR,
+	FMT_LEN_SHORT,
+	FMT_LEN_LONG,
+	FMT_LEN_LLONG,
+	FMT_LEN_SIZE,
+};
+
+/* Large enough for a 64-bit value in octal. */
+#define FMT_NUM_BUF    24
+
+static const char gs_pad_spaces[16] = "                ";
+static const char gs_pad_zeros[16] = "0000000000000000";
+
+/** Formatting state, lives on the stack of the caller. */
+struct fmt_state {
+	fmt_sink_t sink;
+	void *p_ctx;
+	int count;
+};
+
+static void fmt_out(struct fmt_state *p_st, const char *p_data, size_t ul_len)
+{
+	if (ul_len) {
+		p_st->sink(p_st->p_ctx, p_data, ul_len);
+		p_st->count += (int)ul_len;
+	}
+}
+
+static void fmt_pad(struct fmt_state *p_st, const char *p_pad, int n)
+{
+	while (n > 0) {
+		int chunk = (n > 16) ? 16 : n;
+
+		fmt_out(p_st, p_pad, (size_t)chunk);
+		n -= chunk;
+	}
+}
+
+/**
+ * \brief Emit a converted field with its sign/prefix, precision zeros and
+ * width padding.
+ */
+static void fmt_field(struct fmt_state *p_st, const char *p_prefix,
+		int prefix_len, const char *p_body, int body_len, int zeros,
+		int width, uint32_t ul_flags)
+{
+	int pad = width - prefix_len - zeros - body_len;
+
+	if (!(ul_flags & FMT_LEFT) && !(ul_flags & FMT_ZERO)) {
+		fmt_pad(p_st, gs_pad_spaces, pad);
+	}
+	fmt_out(p_st, p_prefix, (size_t)prefix_len);
+	if (!(ul_flags & FMT_LEFT) && (ul_flags & FMT_ZERO)) {
+		fmt_pad(p_st, gs_pad_zeros, pad);
+	}
+	fmt_pad(p_st, gs_pad_zeros, zeros);
+	fmt_out(p_st, p_body, (size_t)body_len);
+	if (ul_flags & FMT_LEFT) {
+		fmt_pad(p_st, gs_pad_spaces, pad);
+	}
+}
+
+/**
+ * \brief Convert an unsigned value, digits are written backwards from the
+ * end of \a p_end.
+ *
+ * \return Pointer to the first digit.
+ */
+static char *fmt_utoa(char *p_end, uint64_t ull_value, uint32_t ul_base,
+		bool b_upper)
+{
+	const char *p_digits = b_upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	char *p = p_end;
+
+	/* Stay in 32-bit arithmetic when possible, it is much cheaper. */
+	if (ull_value <= UINT32_MAX) {
+		uint32_t ul_value = (uint32_t)ull_value;
+
+		do {
+			*--p = p_digits[ul_value % ul_base];
+			ul_value /= ul_base;
+		} while (ul_value);
+	} else {
+		do {
+			*--p = p_digits[ull_value % ul_base];
+			ull_value /= ul_base;
+		} while (ull_value);
+	}
+
+	return p;
+}
+
+/**
+ * \brief Format into a sink.
+ *
+ * \param sink Output callback.
+ * \param p_ctx Opaque pointer passed to \a sink.
+ * \param p_fmt Format string.
+ * \param ap Arguments.
+ *
+ * \return Number of characters produced.
+ */
+int fmt_vformat(fmt_sink_t sink, void *p_ctx, const char *p_fmt, va_list ap)
+{
+	struct fmt_state st = { sink, p_ctx, 0 };
+	char num_buf[FMT_NUM_BUF];
+
+	while (*p_fmt) {
+		const char *p_lit = p_fmt;
+		uint32_t ul_flags = 0;
+		int width = 0;
+		int prec = 0;
+		enum fmt_len len = FMT_LEN_INT;
+		uint32_t ul_base = 10;
+		bool b_signed = false;
+		uint64_t ull_value;
+		char prefix[2];
+		int prefix_len = 0;
+		const char *p_body;
+		int body_len;
+		int zeros;
+
+		/* Copy the literal run in one call. */
+		while (*p_fmt && *p_fmt != '%') {
+			p_fmt++;
+		}
+		fmt_out(&st, p_lit, (size_t)(p_fmt - p_lit));
+		if (!*p_fmt) {
+			break;
+		}
+		p_lit = p_fmt++;
+
+		/* Flags. */
+		for (;; p_fmt++) {
+			if (*p_fmt == '-') {
+				ul_flags |= FMT_LEFT;
+			} else if (*p_fmt == '0') {
+				ul_flags |= FMT_ZERO;
+			} else if (*p_fmt == '+') {
+				ul_flags |= FMT_PLUS;
+			} else if (*p_fmt == ' ') {
+				ul_flags |= FMT_SPACE;
+			} else if (*p_fmt == '#') {
+				ul_flags |= FMT_ALT;
+			} else {
+				break;
+			}
+		}
+
+		/* Width. */
+		if (*p_fmt == '*') {
+			width = va_arg(ap, int);
+			if (width < 0) {
+				ul_flags |= FMT_LEFT;
+				width = -width;
+			}
+			p_fmt++;
+		} else {
+			while (*p_fmt >= '0' && *p_fmt <= '9') {
+				width = width * 10 + (*p_fmt++ - '0');
+			}
+		}
+
+		/* Precision. */
+		if (*p_fmt == '.') {
+			ul_flags |= FMT_PREC;
+			p_fmt++;
+			if (*p_fmt == '*') {
+				prec = va_arg(ap, int);
+				if (prec < 0) {
+					ul_flags &= ~FMT_PREC;
+					prec = 0;
+				}
+				p_fmt++;
+			} else {
+				while (*p_fmt >= '0' && *p_fmt <= '9') {
+					prec = prec * 10 + (*p_fmt++ - '0');
+				}
+			}
+		}
+
+		/* Length modifier. */
+		switch (*p_fmt) {
+		case 'h':
+			p_fmt++;
+			len = FMT_LEN_SHORT;
+			if (*p_fmt == 'h') {
+				p_fmt++;
+				len = FMT_LEN_CHAR;
+			}
+			break;
+		case 'l':
+			p_fmt++;
+			len = FMT_LEN_LONG;
+			if (*p_fmt == 'l') {
+				p_fmt++;
+				len = FMT_LEN_LLONG;
+			}
+			break;
+		case 'z':
+		case 't':
+			p_fmt++;
+			len = FMT_LEN_SIZE;
+			break;
+		default:
+			break;
+		}
+
+		switch (*p_fmt) {
+		case 'd':
+		case 'i':
+			b_signed = true;
+			break;
+		case 'u':
+			break;
+		case 'X':
+			ul_flags |= FMT_UPPER;
+			ul_base = 16;
+			break;
+		case 'x':
+			ul_base = 16;
+			break;
+		case 'o':
+			ul_base = 8;
+			break;
+		case 'p':
+			/* Pointers are printed as 0x followed by 8 hex digits. */
+			ull_value = (uintptr_t)va_arg(ap, void *);
+			p_body = fmt_utoa(&num_buf[FMT_NUM_BUF], ull_value, 16, false);
+			body_len = (int)(&num_buf[FMT_NUM_BUF] - p_body);
+			zeros = (int)(2 * sizeof(void *)) - body_len;
+			fmt_field(&st, "0x", 2, p_body, body_len, zeros, width,
+					ul_flags & FMT_LEFT);
+			p_fmt++;
+			continue;
+		case 'c':
+			num_buf[0] = (char)va_arg(ap, int);
+			fmt_field(&st, NULL, 0, num_buf, 1, 0, width,
+					ul_flags & FMT_LEFT);
+			p_fmt++;
+			continue;
+		case 's':
+			p_body = va_arg(ap, const char *);
+			if (!p_body) {
+				p_body = "(null)";
+			}
+			if (ul_flags & FMT_PREC) {
+				const char *p_nul = memchr(p_body, 0, (size_t)prec);
+
+				body_len = p_nul ? (int)(p_nul - p_body) : prec;
+			} else {
+				body_len = (int)strlen(p_body);
+			}
+			fmt_field(&st, NULL, 0, p_body, body_len, 0, width,
+					ul_flags & FMT_LEFT);
+			p_fmt++;
+			continue;
+		case '%':
+			fmt_out(&st, "%", 1);
+			p_fmt++;
+			continue;
+		default:
+			/* Unsupported conversion: print it verbatim. */
+			if (*p_fmt) {
+				p_fmt++;
+			}
+			fmt_out(&st, p_lit, (size_t)(p_fmt - p_lit));
+			continue;
+		}
+		p_fmt++;
+
+		/* Fetch the integer argument with its promoted type. */
+		if (b_signed) {
+			int64_t ll_value;
+
+			if (len == FMT_LEN_LLONG) {
+				ll_value = va_arg(ap, int64_t);
+			} else if (len == FMT_LEN_LONG) {
+				ll_value = va_arg(ap, long);
+			} else if (len == FMT_LEN_SIZE) {
+				ll_value = va_arg(ap, ptrdiff_t);
+			} else {
+				ll_value = va_arg(ap, int);
+				if (len == FMT_LEN_CHAR) {
+					ll_value = (signed char)ll_value;
+				} else if (len == FMT_LEN_SHORT) {
+					ll_value = (short)ll_value;
+				}
+			}
+			if (ll_value < 0) {
+				prefix[prefix_len++] = '-';
+				ull_value = (uint64_t)0 - (uint64_t)ll_value;
+			} else {
+				if (ul_flags & FMT_PLUS) {
+					prefix[prefix_len++] = '+';
+				} else if (ul_flags & FMT_SPACE) {
+					prefix[prefix_len++] = ' ';
+				}
+				ull_value = (uint64_t)ll_value;
+			}
+		} else {
+			if (len == FMT_LEN_LLONG) {
+				ull_value = va_arg(ap, uint64_t);
+			} else if (len == FMT_LEN_LONG) {
+				ull_value = va_arg(ap, unsigned long);
+			} else if (len == FMT_LEN_SIZE) {
+				ull_value = va_arg(ap, size_t);
+			} else {
+				ull_value = va_arg(ap, unsigned int);
+				if (len == FMT_LEN_CHAR) {
+					ull_value = (unsigned char)ull_value;
+				} else if (len == FMT_LEN_SHORT) {
+					ull_value = (unsigned short)ull_value;
+				}
+			}
+		}
+		if ((ul_flags & FMT_ALT) && ul_base == 16 && ull_value != 0) {
+			prefix[prefix_len++] = '0';
+			prefix[prefix_len++] = (ul_flags & FMT_UPPER) ? 'X' : 'x';
+		}
+
+		if ((ul_flags & FMT_PREC) && prec == 0 && ull_value == 0) {
+			/* "%.0d" of zero prints no digits. */
+			p_body = &num_buf[FMT_NUM_BUF];
+		} else {
+			p_body = fmt_utoa(&num_buf[FMT_NUM_BUF], ull_value, ul_base,
+					(ul_flags & FMT_UPPER) != 0);
+		}
+		body_len = (int)(&num_buf[FMT_NUM_BUF] - p_body);
+		zeros = 0;
+		if (ul_flags & FMT_PREC) {
+			/* An explicit precision disables zero padding. */
+			ul_flags &= ~FMT_ZERO;
+			if (prec > body_len) {
+				zeros = prec - body_len;
+			}
+		}
+		if ((ul_flags & FMT_ALT) && ul_base == 8 && zeros == 0 &&
+				(body_len == 0 || *p_body != '0')) {
+			/* "%#o" guarantees a leading zero. */
+			zeros = 1;
+		}
+		fmt_field(&st, prefix, prefix_len, p_body, body_len, zeros, width,
+				ul_flags);
+	}
+
+	return st.count;
+}
+
+/** Sink state of fmt_vsnprintf(). */
+struct fmt_buf {
+	char *p_buf;
+	size_t ul_size;
+	size_t ul_pos;
+};
+
+static void fmt_buf_sink(void *p_ctx, const char *p_data, size_t ul_len)
+{
+	struct fmt_buf *p_fb = (struct fmt_buf *)p_ctx;
+
+	if (p_fb->ul_pos + 1 < p_fb->ul_size) {
+		size_t ul_room = p_fb->ul_size - 1 - p_fb->ul_pos;
+
+		memcpy(&p_fb->p_buf[p_fb->ul_pos], p_data,
+				(ul_len < ul_room) ? ul_len : ul_room);
+	}
+	p_fb->ul_pos += ul_len;
+}
+
+/**
+ * \brief Format into a caller-supplied buffer.
+ *
+ * \param p_buf Output buffer, always NUL terminated if \a ul_size is not 0.
+ * \param ul_size Size of \a p_buf.
+ * \param p_fmt Format string.
+ * \param ap Arguments.
+ *
+ * \return Length of the complete output, which may exceed \a ul_size - 1 if
+ * it was truncated.
+ */
+int fmt_vsnprintf(char *p_buf, size_t ul_size, const char *p_fmt, va_list ap)
+{
+	struct fmt_buf fb = { p_buf, ul_size, 0 };
+	int n = fmt_vformat(fmt_buf_sink, &fb, p_fmt, ap);
+
+	if (ul_size) {
+		p_buf[(fb.ul_pos < ul_size) ? fb.ul_pos : ul_size - 1] = '\0';
+	}
+
+	return n;
+}
+
+/**
+ * \brief Format into a caller-supplied buffer.
+ *
+ * \see fmt_vsnprintf()
+ */
+int fmt_snprintf(char *p_buf, size_t ul_size, const char *p_fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start(ap, p_fmt);
+	n = fmt_vsnprintf(p_buf, ul_size, p_fmt, ap);
+	va_end(ap);
+
+	return n;
+}
+
+/** @} */
@@ -0,0 +1,49 @@
+/**
+ * \file
+ *
+ * \brief Small reentrant printf-style formatter.
+ *
+ */
+
+#ifndef FMT_H_INCLUDED
+#define FMT_H_INCLUDED
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \defgroup utils_fmt_group Formatter
+ *
+ * A printf subset that keeps all its state on the caller stack, never uses
+ * the heap and hands its output to a sink callback, so it can render into a
+ * caller-supplied buffer or stream in chunks.
+ *
+ * Supported conversions: \%d \%i \%u \%x \%X \%o \%c \%s \%p and \%\%,
+ * with the '-', '0', '+', ' ' and '#' flags, a width and a precision (both
+ * may be '*'), and the hh, h, l, ll, z and t length modifiers. Floating
+ * point is not supported; such conversions are printed verbatim.
+ *
+ * @{
+ */
+
+/**
+ * Output callback. Receives \a ul_len bytes that are not NUL terminated.
+ */
+typedef void (*fmt_sink_t)(void *p_ctx, const char *p_data, size_t ul_len);
+
+int fmt_vformat(fmt_sink_t sink, void *p_ctx, const char *p_fmt, va_list ap);
+int fmt_vsnprintf(char *p_buf, size_t ul_size, const char *p_fmt, va_list ap);
+int fmt_snprintf(char *p_buf, size_t ul_size, const char *p_fmt, ...)
+		__attribute__((format(__printf__, 3, 4)));
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FMT_H_INCLUDED */
@@ -0,0 +1,138 @@
+/**
+ * \file
+ *
+ * \brief Register blocks and core of the host build, see host.h.
+ *
+ */
+
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "host.h"
+
+/**
+ * \addtogroup test_host_group
+ *
+ * @{
+ */
+
+SCB_Type host_scb;
+SCnSCB_Type host_scnscb;
+SysTick_Type host_systick;
+DWT_Type host_dwt;
+CoreDebug_Type host_coredebug;
+MPU_Type host_mpu;
+FPU_Type host_fpu;
+Tc host_tc[4];
+Pwm host_pwm[2];
+Usart host_usart[3];
+Mcan host_mcan[2];
+Usbhs host_usbhs;
+Afec host_afec[2];
+Gmac host_gmac;
+Xdmac host_xdmac;
+Qspi host_qspi;
+Matrix host_matrix;
+Utmi host_utmi;
+Pmc host_pmc;
+Uart host_uart[5];
+Efc host_efc;
+Pio host_pio[5];
+Supc host_supc;
+Wdt host_wdt;
+
+host_nvic_t host_nvic;
+
+/* Kept by cpu_irq_enable() and cpu_irq_disable(). */
+volatile bool g_interrupt_enabled = true;
+
+/** PRIMASK of the thread. */
+static __thread uint32_t gs_ul_primask;
+/** Exception number of the thread, while it runs a handler. */
+static __thread uint32_t gs_ul_ipsr;
+
+uint32_t host_get_primask(void)
+{
+	return gs_ul_primask;
+}
+
+/**
+ * \brief Mask or unmask interrupts for the thread. Masked, it holds the lock
+ * of the kernel, which keeps the other threads out of their own critical
+ * sections and handlers.
+ */
+void host_set_primask(uint32_t ul_primask)
+{
+	ul_primask &= 1;
+	if (ul_primask == gs_ul_primask) {
+		return;
+	}
+	gs_ul_primask = ul_primask;
+	if (ul_primask) {
+		host_lock();
+	} else {
+		host_unlock();
+	}
+}
+
+uint32_t host_get_ipsr(void)
+{
+	return gs_ul_ipsr;
+}
+
+/**
+ * \brief Run an interrupt handler on the calling thread, as the core would:
+ * with the other handlers and the critical sections kept out.
+ *
+ * \param irq Interrupt of the handler, for __get_IPSR().
+ */
+void host_irq(IRQn_Type irq, void (*handler)(void))
+{
+	uint32_t ul_ipsr = gs_ul_ipsr;
+
+	host_lock();
+	gs_ul_ipsr = (uint32_t)irq + 16;
+	handler();
+	gs_ul_ipsr = ul_ipsr;
+	host_unlock();
+}
+
+void host_wait_for_interrupt(void)
+{
+	sched_yield();
+}
+
+uint32_t host_rbit(uint32_t ul_value)
+{
+	uint32_t ul_result = 0;
+	uint32_t i;
+
+	for (i = 0; i < 32; i++) {
+		ul_result = (ul_result << 1) | (ul_value & 1);
+		ul_value >>= 1;
+	}
+	return ul_result;
+}
+
+/**
+ * \brief Core cycles at HOST_CORE_HZ since an arbitrary origin, from the
+ * host clock.
+ */
+uint32_t host_cycles(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec) *
+			(HOST_CORE_HZ / 1000000u) / 1000u);
+}
+
+void vAssertCalled(const char *pcFile, unsigned long ulLine)
+{
+	fprintf(stderr, "%s:%lu: assertion failed\n", pcFile, ulLine);
+	abort();
+}
+
+/** @} */
@@ -0,0 +1,213 @@
+/**
+ * \file
+ *
+ * \brief Host build of the firmware sources.
+ *
+ * Included ahead of every firmware source of a test (-include), right
+ * after the device header. From then on:
+ * - the core and peripheral instances (SCB, DWT, PMC, XDMAC...) point to
+ *   register blocks in host memory, defined in host.c: a driver writes and
+ *   reads them as on the target, and a test or a model checks and sets
+ *   them;
+ * - the core intrinsics are C: barriers are compiler barriers, masking
+ *   interrupts takes the lock of host_rtos.c, so that code run by "interrupt"
+ *   threads of the models is kept out as on the target;
+ * - the NVIC calls are recorded in host_nvic.
+ *
+ * The executables are linked at fixed low addresses (-no-pie), so that
+ * static buffers survive the 32-bit addresses the drivers give the DMA.
+ * Buffers a DMA model reads must not live on a thread stack.
+ *
+ */
+
+#ifndef HOST_H_INCLUDED
+#define HOST_H_INCLUDED
+
+#include <parts.h>
+#include <io.h>
+
+/**
+ * \defgroup test_host_group Host build of the firmware
+ *
+ * @{
+ */
+
+/* Core intrinsics. */
+uint32_t host_get_primask(void);
+void host_set_primask(uint32_t ul_primask);
+uint32_t host_get_ipsr(void);
+
+#define __DSB()                 __sync_synchronize()
+#define __DMB()                 __sync_synchronize()
+#define __ISB()                 __sync_synchronize()
+#define __NOP()                 ((void)0)
+#define __WFI()                 host_wait_for_interrupt()
+#define __WFE()                 host_wait_for_interrupt()
+#define __SEV()                 ((void)0)
+#define __CLZ(x)                ((uint32_t)(x) ? \
+		(uint32_t)__builtin_clz((uint32_t)(x)) : 32u)
+#define __RBIT(x)               host_rbit(x)
+#define __REV(x)                __builtin_bswap32(x)
+#define __disable_irq()         host_set_primask(1)
+#define __enable_irq()          host_set_primask(0)
+#define __get_PRIMASK()         host_get_primask()
+#define __set_PRIMASK(x)        host_set_primask(x)
+#define __get_IPSR()            host_get_ipsr()
+
+void host_wait_for_interrupt(void);
+uint32_t host_rbit(uint32_t ul_value);
+
+/** Core clock the cycle counts are given at. */
+#define HOST_CORE_HZ            300000000u
+
+uint32_t host_cycles(void);
+void host_irq(IRQn_Type irq, void (*handler)(void));
+
+/* Lock of the kernel, see host_rtos.c. Taken again by the same thread, it
+ * nests. */
+void host_lock(void);
+void host_unlock(void);
+
+/* NVIC, cache and SysTick calls of core_cm7.h. */
+typedef struct host_nvic {
+	uint8_t uc_enabled[128];
+	uint8_t uc_pending[128];
+	uint8_t uc_priority[128];
+} host_nvic_t;
+
+extern host_nvic_t host_nvic;
+
+#define NVIC_EnableIRQ(irq)         (host_nvic.uc_enabled[(irq)] = 1)
+#define NVIC_DisableIRQ(irq)        (host_nvic.uc_enabled[(irq)] = 0)
+#define NVIC_SetPendingIRQ(irq)     (host_nvic.uc_pending[(irq)] = 1)
+#define NVIC_ClearPendingIRQ(irq)   (host_nvic.uc_pending[(irq)] = 0)
+#define NVIC_GetPendingIRQ(irq)     ((uint32_t)host_nvic.uc_pending[(irq)])
+#define NVIC_SetPriority(irq, prio) \
+	(host_nvic.uc_priority[(irq)] = (uint8_t)(prio))
+#define NVIC_GetPriority(irq)       ((uint32_t)host_nvic.uc_priority[(irq)])
+#define NVIC_SystemReset()          abort()
+#define SCB_EnableICache()          ((void)0)
+#define SCB_DisableICache()         ((void)0)
+#define SCB_InvalidateICache()      ((void)0)
+#define SCB_EnableDCache()          ((void)0)
+#define SCB_DisableDCache()         ((void)0)
+#define SCB_InvalidateDCache()      ((void)0)
+#define SCB_CleanDCache()           ((void)0)
+#define SCB_CleanInvalidateDCache() ((void)0)
+#define SysTick_Config(ticks)       (0u)
+
+/* Register blocks, see host.c. */
+extern SCB_Type host_scb;
+extern SCnSCB_Type host_scnscb;
+extern SysTick_Type host_systick;
+extern DWT_Type host_dwt;
+extern CoreDebug_Type host_coredebug;
+extern MPU_Type host_mpu;
+extern FPU_Type host_fpu;
+extern Tc host_tc[4];
+extern Pwm host_pwm[2];
+extern Usart host_usart[3];
+extern Mcan host_mcan[2];
+extern Usbhs host_usbhs;
+extern Afec host_afec[2];
+extern Gmac host_gmac;
+extern Xdmac host_xdmac;
+extern Qspi host_qspi;
+extern Matrix host_matrix;
+extern Utmi host_utmi;
+extern Pmc host_pmc;
+extern Uart host_uart[5];
+extern Efc host_efc;
+extern Pio host_pio[5];
+extern Supc host_supc;
+extern Wdt host_wdt;
+
+#undef SCB
+#undef SCnSCB
+#undef SysTick
+#undef DWT
+#undef CoreDebug
+#undef MPU
+#undef FPU
+#undef TC0
+#undef TC1
+#undef TC2
+#undef TC3
+#undef PWM0
+#undef PWM1
+#undef USART0
+#undef USART1
+#undef USART2
+#undef MCAN0
+#undef MCAN1
+#undef USBHS
+#undef AFEC0
+#undef AFEC1
+#undef GMAC
+#undef XDMAC
+#undef QSPI
+#undef MATRIX
+#undef UTMI
+#undef PMC
+#undef UART0
+#undef UART1
+#undef UART2
+#undef UART3
+#undef UART4
+#undef EFC
+#undef PIOA
+#undef PIOB
+#undef PIOC
+#undef PIOD
+#undef PIOE
+#undef SUPC
+#undef WDT
+
+#define SCB         (&host_scb)
+#define SCnSCB      (&host_scnscb)
+#define SysTick     (&host_systick)
+#define DWT         (&host_dwt)
+#define CoreDebug   (&host_coredebug)
+#define MPU         (&host_mpu)
+#define FPU         (&host_fpu)
+#define TC0         (&host_tc[0])
+#define TC1         (&host_tc[1])
+#define TC2         (&host_tc[2])
+#define TC3         (&host_tc[3])
+#define PWM0        (&host_pwm[0])
+#define PWM1        (&host_pwm[1])
+#define USART0      (&host_usart[0])
+#define USART1      (&host_usart[1])
+#define USART2      (&host_usart[2])
+#define MCAN0       (&host_mcan[0])
+#define MCAN1       (&host_mcan[1])
+#define USBHS       (&host_usbhs)
+#define AFEC0       (&host_afec[0])
+#define AFEC1       (&host_afec[1])
+#define GMAC        (&host_gmac)
+#define XDMAC       (&host_xdmac)
+#define QSPI        (&host_qspi)
+#define MATRIX      (&host_matrix)
+#define UTMI        (&host_utmi)
+#define PMC         (&host_pmc)
+#define UART0       (&host_uart[0])
+#define UART1       (&host_uart[1])
+#define UART2       (&host_uart[2])
+#define UART3       (&host_uart[3])
+#define UART4       (&host_uart[4])
+#define EFC         (&host_efc)
+#define PIOA        (&host_pio[0])
+#define PIOB        (&host_pio[1])
+#define PIOC        (&host_pio[2])
+#define PIOD        (&host_pio[3])
+#define PIOE        (&host_pio[4])
+#define SUPC        (&host_supc)
+#define WDT         (&host_wdt)
+
+/** A register the drivers only read, as a model sets it, e.g.
+ * HOST_REG(XDMAC->XDMAC_GIS) = 1. */
+#define HOST_REG(reg)   (*(volatile uint32_t *)&(reg))
+
+/** @} */
+
+#endif /* HOST_H_INCLUDED */
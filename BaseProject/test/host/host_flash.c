@@ -0,0 +1,210 @@
+/**
+ * \file
+ *
+ * \brief Emulator of the internal flash, see host_flash.h.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "host_flash.h"
+
+/**
+ * \addtogroup test_host_flash_group
+ *
+ * @{
+ */
+
+/** What is armed for a later command. */
+enum host_flash_arm {
+	HOST_FLASH_ARM_NONE,
+	HOST_FLASH_ARM_CUT,
+	HOST_FLASH_ARM_FAIL,
+};
+
+jmp_buf host_flash_power_loss;
+
+static uint32_t gs_ul_size;
+static uint32_t gs_ul_page_size;
+static uint32_t *gs_p_wear;
+
+static enum host_flash_arm gs_arm;
+static enum host_flash_cmd gs_arm_cmd;
+static uint32_t gs_ul_arm_commands;
+static uint32_t gs_ul_cut_done;
+static enum host_flash_erase_cut gs_erase_cut;
+
+static host_flash_stats_t gs_stats;
+
+/**
+ * \brief Map the flash, erased, at HOST_FLASH_ADDR.
+ */
+bool host_flash_init(uint32_t ul_size, uint32_t ul_page_size)
+{
+	void *p = mmap((void *)(uintptr_t)HOST_FLASH_ADDR, ul_size,
+			PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+	if (p != (void *)(uintptr_t)HOST_FLASH_ADDR) {
+		return false;
+	}
+	gs_ul_size = ul_size;
+	gs_ul_page_size = ul_page_size;
+	gs_p_wear = calloc(ul_size / ul_page_size, sizeof(uint32_t));
+	host_flash_erase_all();
+	return gs_p_wear != NULL;
+}
+
+/**
+ * \brief Erase the whole flash, clear the counters and disarm, as for a new
+ * part.
+ */
+void host_flash_erase_all(void)
+{
+	memset((void *)(uintptr_t)HOST_FLASH_ADDR, 0xFF, gs_ul_size);
+	memset(gs_p_wear, 0, gs_ul_size / gs_ul_page_size * sizeof(uint32_t));
+	memset(&gs_stats, 0, sizeof(gs_stats));
+	gs_arm = HOST_FLASH_ARM_NONE;
+}
+
+/**
+ * \brief Arm a power loss.
+ *
+ * \param cmd Commands counted, and cut short.
+ * \param ul_commands Commands to complete first.
+ * \param ul_done How far the next one gets: words programmed, or pages
+ * erased.
+ * \param cut Which pages an erase cut short has done.
+ */
+void host_flash_cut(enum host_flash_cmd cmd, uint32_t ul_commands,
+		uint32_t ul_done, enum host_flash_erase_cut cut)
+{
+	gs_arm = HOST_FLASH_ARM_CUT;
+	gs_arm_cmd = cmd;
+	gs_ul_arm_commands = ul_commands;
+	gs_ul_cut_done = ul_done;
+	gs_erase_cut = cut;
+}
+
+/**
+ * \brief Arm a command failure: after \a ul_commands commands of \a cmd,
+ * the next one leaves the flash as it is and returns ERR_IO_ERROR.
+ */
+void host_flash_fail(enum host_flash_cmd cmd, uint32_t ul_commands)
+{
+	gs_arm = HOST_FLASH_ARM_FAIL;
+	gs_arm_cmd = cmd;
+	gs_ul_arm_commands = ul_commands;
+}
+
+void host_flash_disarm(void)
+{
+	gs_arm = HOST_FLASH_ARM_NONE;
+}
+
+void host_flash_get_stats(host_flash_stats_t *p_stats)
+{
+	*p_stats = gs_stats;
+}
+
+/**
+ * \brief Count a command against what is armed.
+ *
+ * \return What happens to this command.
+ */
+static enum host_flash_arm host_flash_command(enum host_flash_cmd cmd)
+{
+	enum host_flash_arm arm = gs_arm;
+
+	if (arm == HOST_FLASH_ARM_NONE || !(cmd & gs_arm_cmd)) {
+		return HOST_FLASH_ARM_NONE;
+	}
+	if (gs_ul_arm_commands) {
+		gs_ul_arm_commands--;
+		return HOST_FLASH_ARM_NONE;
+	}
+	gs_arm = HOST_FLASH_ARM_NONE;
+	return arm;
+}
+
+static bool host_flash_in(uint32_t ul_addr, uint32_t ul_len)
+{
+	return ul_addr >= HOST_FLASH_ADDR && ul_len <= gs_ul_size &&
+			ul_addr - HOST_FLASH_ADDR <= gs_ul_size - ul_len &&
+			!(ul_addr % gs_ul_page_size);
+}
+
+/**
+ * \brief Program a page, as efc_write_page().
+ */
+status_code_t host_flash_write_page(uint32_t ul_addr,
+		const uint32_t *p_data)
+{
+	uint32_t *p_flash = (uint32_t *)(uintptr_t)ul_addr;
+	uint32_t ul_words = gs_ul_page_size / 4;
+	enum host_flash_arm arm;
+	uint32_t i;
+
+	if (!host_flash_in(ul_addr, gs_ul_page_size)) {
+		return ERR_INVALID_ARG;
+	}
+	arm = host_flash_command(HOST_FLASH_WRITE);
+	if (arm == HOST_FLASH_ARM_FAIL) {
+		return ERR_IO_ERROR;
+	}
+	if (arm == HOST_FLASH_ARM_CUT && gs_ul_cut_done < ul_words) {
+		ul_words = gs_ul_cut_done;
+	}
+	for (i = 0; i < ul_words; i++) {
+		p_flash[i] &= p_data[i];
+	}
+	gs_stats.ul_writes++;
+	if (arm == HOST_FLASH_ARM_CUT) {
+		longjmp(host_flash_power_loss, 1);
+	}
+	return STATUS_OK;
+}
+
+/**
+ * \brief Erase pages, as efc_erase_pages().
+ */
+status_code_t host_flash_erase_pages(uint32_t ul_addr, uint32_t ul_pages)
+{
+	uint32_t ul_first = 0;
+	uint32_t ul_count = ul_pages;
+	enum host_flash_arm arm;
+	uint32_t ul_page;
+	uint32_t i;
+
+	if (!ul_pages || !host_flash_in(ul_addr, ul_pages * gs_ul_page_size) ||
+			((ul_addr - HOST_FLASH_ADDR) % (ul_pages * gs_ul_page_size))) {
+		return ERR_INVALID_ARG;
+	}
+	arm = host_flash_command(HOST_FLASH_ERASE);
+	if (arm == HOST_FLASH_ARM_FAIL) {
+		return ERR_IO_ERROR;
+	}
+	if (arm == HOST_FLASH_ARM_CUT && gs_ul_cut_done < ul_pages) {
+		ul_count = gs_ul_cut_done;
+		if (gs_erase_cut == HOST_FLASH_ERASE_HIGH_FIRST) {
+			ul_first = ul_pages - ul_count;
+		}
+	}
+	memset((uint8_t *)(uintptr_t)ul_addr + ul_first * gs_ul_page_size, 0xFF,
+			ul_count * gs_ul_page_size);
+	ul_page = (ul_addr - HOST_FLASH_ADDR) / gs_ul_page_size;
+	for (i = ul_first; i < ul_first + ul_count; i++) {
+		if (++gs_p_wear[ul_page + i] > gs_stats.ul_max_wear) {
+			gs_stats.ul_max_wear = gs_p_wear[ul_page + i];
+		}
+	}
+	gs_stats.ul_erases++;
+	gs_stats.ul_erased_pages += ul_count;
+	if (arm == HOST_FLASH_ARM_CUT) {
+		longjmp(host_flash_power_loss, 1);
+	}
+	return STATUS_OK;
+}
+
+/** @} */
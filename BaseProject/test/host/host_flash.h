@@ -0,0 +1,75 @@
+/**
+ * \file
+ *
+ * \brief Emulator of the internal flash, with power loss and command
+ * failure injection.
+ *
+ */
+
+#ifndef HOST_FLASH_H_INCLUDED
+#define HOST_FLASH_H_INCLUDED
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "status_codes.h"
+
+/**
+ * \defgroup test_host_flash_group Internal flash emulator
+ *
+ * NOR flash at a fixed address, read in place as on the target. Programming
+ * only clears bits, erasing sets whole pages back to 0xFF. The commands
+ * take the place of efc_write_page() and efc_erase_pages().
+ *
+ * A power loss is armed for a later command: that command is cut short,
+ * then the emulator jumps to host_flash_power_loss, set by the test with
+ * setjmp(). What was cut short stays in the flash, and the software state
+ * is the test's to throw away, as a reset would.
+ *
+ * @{
+ */
+
+/** Emulated flash, aligned as the stores need it. */
+#define HOST_FLASH_ADDR         0x20000000u
+
+/** Commands a power loss or failure is armed for. */
+enum host_flash_cmd {
+	HOST_FLASH_WRITE = 1,
+	HOST_FLASH_ERASE = 2,
+	HOST_FLASH_ANY = HOST_FLASH_WRITE | HOST_FLASH_ERASE,
+};
+
+/** How a power loss cuts an erase short. */
+enum host_flash_erase_cut {
+	/** The first pages are erased, the others untouched. */
+	HOST_FLASH_ERASE_LOW_FIRST,
+	/** The last pages are erased, the first ones untouched. */
+	HOST_FLASH_ERASE_HIGH_FIRST,
+};
+
+/** Command counters. */
+typedef struct host_flash_stats {
+	uint32_t ul_writes;
+	uint32_t ul_erases;
+	/** Pages erased, and page erases of the most erased page. */
+	uint32_t ul_erased_pages;
+	uint32_t ul_max_wear;
+} host_flash_stats_t;
+
+extern jmp_buf host_flash_power_loss;
+
+bool host_flash_init(uint32_t ul_size, uint32_t ul_page_size);
+void host_flash_erase_all(void);
+void host_flash_cut(enum host_flash_cmd cmd, uint32_t ul_commands,
+		uint32_t ul_done, enum host_flash_erase_cut cut);
+void host_flash_fail(enum host_flash_cmd cmd, uint32_t ul_commands);
+void host_flash_disarm(void);
+void host_flash_get_stats(host_flash_stats_t *p_stats);
+
+status_code_t host_flash_write_page(uint32_t ul_addr,
+		const uint32_t *p_data);
+status_code_t host_flash_erase_pages(uint32_t ul_addr, uint32_t ul_pages);
+
+/** @} */
+
+#endif /* HOST_FLASH_H_INCLUDED */
@@ -0,0 +1,690 @@
+/**
+ * \file
+ *
+ * \brief FreeRTOS API of the host tests, on POSIX threads.
+ *
+ * Each task is a thread, started by xTaskCreate() with no scheduler to
+ * start: priorities are kept, not enforced. The whole kernel state is kept
+ * under one lock, the one that critical sections and masked interrupts take,
+ * and any change of it wakes every blocked task to check its own condition.
+ * Ticks are milliseconds of the host monotonic clock, configTICK_RATE_HZ
+ * being 1000.
+ *
+ * The FromISR calls never block, as on the target; neither do the task
+ * calls with no timeout.
+ *
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+/**
+ * \addtogroup test_host_group
+ *
+ * @{
+ */
+
+#if configTICK_RATE_HZ != 1000
+#  error "host ticks are milliseconds"
+#endif
+
+/** A task. */
+typedef struct host_task {
+	TaskFunction_t code;
+	void *pv_param;
+	char ac_name[configMAX_TASK_NAME_LEN];
+	UBaseType_t ux_priority;
+	pthread_t thread;
+	uint32_t ul_notify_value;
+	bool b_notified;
+} host_task_t;
+
+/** A queue, semaphore or mutex. */
+typedef struct host_queue {
+	uint8_t *p_storage;
+	UBaseType_t ux_length;
+	UBaseType_t ux_item_size;
+	UBaseType_t ux_count;
+	UBaseType_t ux_head;
+	uint8_t uc_type;
+	/** Mutexes: task holding it, and how many times. */
+	host_task_t *p_holder;
+	UBaseType_t ux_recursion;
+} host_queue_t;
+
+static pthread_mutex_t gs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gs_changed;
+static pthread_once_t gs_once = PTHREAD_ONCE_INIT;
+/** Nesting of host_lock() on the thread. */
+static __thread UBaseType_t gs_ux_lock_depth;
+/** Task of the thread, made up on first use for threads of the test. */
+static __thread host_task_t *gs_p_self;
+static struct timespec gs_start;
+
+static void rtos_init(void)
+{
+	pthread_condattr_t attr;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&gs_changed, &attr);
+	pthread_condattr_destroy(&attr);
+	clock_gettime(CLOCK_MONOTONIC, &gs_start);
+}
+
+void host_lock(void)
+{
+	pthread_once(&gs_once, rtos_init);
+	if (!gs_ux_lock_depth++) {
+		pthread_mutex_lock(&gs_lock);
+	}
+}
+
+void host_unlock(void)
+{
+	configASSERT(gs_ux_lock_depth);
+	if (!--gs_ux_lock_depth) {
+		pthread_mutex_unlock(&gs_lock);
+	}
+}
+
+/**
+ * \brief Wake the blocked tasks, after a change of state. Lock held.
+ */
+static void rtos_changed(void)
+{
+	pthread_cond_broadcast(&gs_changed);
+}
+
+/**
+ * \brief Absolute time, ticks from now.
+ */
+static struct timespec rtos_deadline(TickType_t x_ticks)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_sec += x_ticks / 1000;
+	ts.tv_nsec += (long)(x_ticks % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+	return ts;
+}
+
+/**
+ * \brief Wait for a change of state. Lock held once.
+ *
+ * \param p_deadline End of the wait, NULL for none.
+ *
+ * \return false once past the deadline.
+ */
+static bool rtos_wait(const struct timespec *p_deadline)
+{
+	configASSERT(gs_ux_lock_depth == 1);
+	if (!p_deadline) {
+		pthread_cond_wait(&gs_changed, &gs_lock);
+		return true;
+	}
+	return pthread_cond_timedwait(&gs_changed, &gs_lock, p_deadline) !=
+			ETIMEDOUT;
+}
+
+static host_task_t *rtos_self(void)
+{
+	if (!gs_p_self) {
+		gs_p_self = calloc(1, sizeof(*gs_p_self));
+		configASSERT(gs_p_self);
+		strcpy(gs_p_self->ac_name, "host");
+		gs_p_self->thread = pthread_self();
+	}
+	return gs_p_self;
+}
+
+/* Port. */
+
+void vPortYield(void)
+{
+	sched_yield();
+}
+
+void vPortEnterCritical(void)
+{
+	host_lock();
+}
+
+void vPortExitCritical(void)
+{
+	host_unlock();
+}
+
+UBaseType_t ulPortSetInterruptMask(void)
+{
+	host_lock();
+	return 0;
+}
+
+void vPortClearInterruptMask(UBaseType_t uxMask)
+{
+	host_unlock();
+}
+
+void *pvPortMalloc(size_t xWantedSize)
+{
+	return malloc(xWantedSize);
+}
+
+void vPortFree(void *pv)
+{
+	free(pv);
+}
+
+/* Tasks. */
+
+static void *rtos_task_main(void *pv)
+{
+	host_task_t *p_task = pv;
+
+	gs_p_self = p_task;
+	p_task->code(p_task->pv_param);
+	/* A task must not return. */
+	configASSERT(0);
+	return NULL;
+}
+
+BaseType_t xTaskGenericCreate(TaskFunction_t pxTaskCode,
+		const char * const pcName, const uint16_t usStackDepth,
+		void * const pvParameters, UBaseType_t uxPriority,
+		TaskHandle_t * const pxCreatedTask, StackType_t * const puxStackBuffer,
+		const MemoryRegion_t * const xRegions)
+{
+	host_task_t *p_task = calloc(1, sizeof(*p_task));
+
+	if (!p_task) {
+		return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+	}
+	p_task->code = pxTaskCode;
+	p_task->pv_param = pvParameters;
+	strncpy(p_task->ac_name, pcName, sizeof(p_task->ac_name) - 1);
+	p_task->ux_priority = uxPriority;
+	if (pxCreatedTask) {
+		*pxCreatedTask = p_task;
+	}
+	if (pthread_create(&p_task->thread, NULL, rtos_task_main, p_task)) {
+		free(p_task);
+		return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+	}
+	pthread_detach(p_task->thread);
+	return pdPASS;
+}
+
+/**
+ * \brief Only a task may delete itself here.
+ */
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+	configASSERT(!xTaskToDelete || xTaskToDelete == rtos_self());
+	configASSERT(!gs_ux_lock_depth);
+	pthread_exit(NULL);
+}
+
+void vTaskDelay(const TickType_t xTicksToDelay)
+{
+	struct timespec ts = rtos_deadline(xTicksToDelay);
+
+	configASSERT(!gs_ux_lock_depth);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+			EINTR) {
+	}
+}
+
+void vTaskDelayUntil(TickType_t * const pxPreviousWakeTime,
+		const TickType_t xTimeIncrement)
+{
+	TickType_t x_left;
+
+	*pxPreviousWakeTime += xTimeIncrement;
+	x_left = *pxPreviousWakeTime - xTaskGetTickCount();
+	/* Past the wake time already. */
+	if (x_left <= xTimeIncrement) {
+		vTaskDelay(x_left);
+	}
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	struct timespec ts;
+
+	pthread_once(&gs_once, rtos_init);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (TickType_t)((ts.tv_sec - gs_start.tv_sec) * 1000 +
+			(ts.tv_nsec - gs_start.tv_nsec) / 1000000);
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+	return xTaskGetTickCount();
+}
+
+void vTaskSuspendAll(void)
+{
+	host_lock();
+}
+
+BaseType_t xTaskResumeAll(void)
+{
+	host_unlock();
+	return pdFALSE;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	return rtos_self();
+}
+
+char *pcTaskGetTaskName(TaskHandle_t xTaskToQuery)
+{
+	host_task_t *p_task = xTaskToQuery ? xTaskToQuery : rtos_self();
+
+	return p_task->ac_name;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t xTask)
+{
+	host_task_t *p_task = xTask ? xTask : rtos_self();
+
+	return p_task->ux_priority;
+}
+
+void vTaskPrioritySet(TaskHandle_t xTask, UBaseType_t uxNewPriority)
+{
+	host_task_t *p_task = xTask ? xTask : rtos_self();
+
+	p_task->ux_priority = uxNewPriority;
+}
+
+BaseType_t xTaskGetSchedulerState(void)
+{
+	return taskSCHEDULER_RUNNING;
+}
+
+/* Task notifications. */
+
+BaseType_t xTaskGenericNotify(TaskHandle_t xTaskToNotify, uint32_t ulValue,
+		eNotifyAction eAction, uint32_t *pulPreviousNotificationValue)
+{
+	host_task_t *p_task = xTaskToNotify;
+	BaseType_t x_ret = pdPASS;
+
+	host_lock();
+	if (pulPreviousNotificationValue) {
+		*pulPreviousNotificationValue = p_task->ul_notify_value;
+	}
+	switch (eAction) {
+	case eSetBits:
+		p_task->ul_notify_value |= ulValue;
+		break;
+	case eIncrement:
+		p_task->ul_notify_value++;
+		break;
+	case eSetValueWithOverwrite:
+		p_task->ul_notify_value = ulValue;
+		break;
+	case eSetValueWithoutOverwrite:
+		if (p_task->b_notified) {
+			x_ret = pdFAIL;
+		} else {
+			p_task->ul_notify_value = ulValue;
+		}
+		break;
+	case eNoAction:
+	default:
+		break;
+	}
+	p_task->b_notified = true;
+	rtos_changed();
+	host_unlock();
+	return x_ret;
+}
+
+BaseType_t xTaskGenericNotifyFromISR(TaskHandle_t xTaskToNotify,
+		uint32_t ulValue, eNotifyAction eAction,
+		uint32_t *pulPreviousNotificationValue,
+		BaseType_t *pxHigherPriorityTaskWoken)
+{
+	if (pxHigherPriorityTaskWoken) {
+		*pxHigherPriorityTaskWoken = pdTRUE;
+	}
+	return xTaskGenericNotify(xTaskToNotify, ulValue, eAction,
+			pulPreviousNotificationValue);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify,
+		BaseType_t *pxHigherPriorityTaskWoken)
+{
+	xTaskGenericNotifyFromISR(xTaskToNotify, 0, eIncrement, NULL,
+			pxHigherPriorityTaskWoken);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit,
+		TickType_t xTicksToWait)
+{
+	host_task_t *p_self = rtos_self();
+	struct timespec ts = rtos_deadline(xTicksToWait);
+	uint32_t ul_value;
+
+	host_lock();
+	while (!p_self->ul_notify_value && xTicksToWait &&
+			rtos_wait(xTicksToWait == portMAX_DELAY ? NULL : &ts)) {
+	}
+	ul_value = p_self->ul_notify_value;
+	if (ul_value) {
+		p_self->ul_notify_value = xClearCountOnExit ? 0 : ul_value - 1;
+	}
+	p_self->b_notified = false;
+	host_unlock();
+	return ul_value;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t ulBitsToClearOnEntry,
+		uint32_t ulBitsToClearOnExit, uint32_t *pulNotificationValue,
+		TickType_t xTicksToWait)
+{
+	host_task_t *p_self = rtos_self();
+	struct timespec ts = rtos_deadline(xTicksToWait);
+	BaseType_t x_ret = pdFALSE;
+
+	host_lock();
+	if (!p_self->b_notified) {
+		p_self->ul_notify_value &= ~ulBitsToClearOnEntry;
+	}
+	while (!p_self->b_notified && xTicksToWait &&
+			rtos_wait(xTicksToWait == portMAX_DELAY ? NULL : &ts)) {
+	}
+	if (pulNotificationValue) {
+		*pulNotificationValue = p_self->ul_notify_value;
+	}
+	if (p_self->b_notified) {
+		p_self->ul_notify_value &= ~ulBitsToClearOnExit;
+		x_ret = pdTRUE;
+	}
+	p_self->b_notified = false;
+	host_unlock();
+	return x_ret;
+}
+
+BaseType_t xTaskNotifyStateClear(TaskHandle_t xTask)
+{
+	host_task_t *p_task = xTask ? xTask : rtos_self();
+	BaseType_t x_ret;
+
+	host_lock();
+	x_ret = p_task->b_notified ? pdPASS : pdFAIL;
+	p_task->b_notified = false;
+	host_unlock();
+	return x_ret;
+}
+
+/* Queues, semaphores and mutexes. */
+
+QueueHandle_t xQueueGenericCreate(const UBaseType_t uxQueueLength,
+		const UBaseType_t uxItemSize, const uint8_t ucQueueType)
+{
+	host_queue_t *p_queue = calloc(1, sizeof(*p_queue));
+
+	if (!p_queue) {
+		return NULL;
+	}
+	if (uxItemSize) {
+		p_queue->p_storage = malloc(uxQueueLength * uxItemSize);
+		if (!p_queue->p_storage) {
+			free(p_queue);
+			return NULL;
+		}
+	}
+	p_queue->ux_length = uxQueueLength;
+	p_queue->ux_item_size = uxItemSize;
+	p_queue->uc_type = ucQueueType;
+	return p_queue;
+}
+
+QueueHandle_t xQueueCreateCountingSemaphore(const UBaseType_t uxMaxCount,
+		const UBaseType_t uxInitialCount)
+{
+	host_queue_t *p_queue = xQueueGenericCreate(uxMaxCount, 0,
+			queueQUEUE_TYPE_COUNTING_SEMAPHORE);
+
+	if (p_queue) {
+		p_queue->ux_count = uxInitialCount;
+	}
+	return p_queue;
+}
+
+QueueHandle_t xQueueCreateMutex(const uint8_t ucQueueType)
+{
+	host_queue_t *p_queue = xQueueGenericCreate(1, 0, ucQueueType);
+
+	if (p_queue) {
+		p_queue->ux_count = 1;
+	}
+	return p_queue;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+	host_queue_t *p_queue = xQueue;
+
+	free(p_queue->p_storage);
+	free(p_queue);
+}
+
+/**
+ * \brief Put an item in a queue with room for it. Lock held.
+ */
+static void rtos_queue_put(host_queue_t *p_queue, const void *pv_item,
+		BaseType_t x_position)
+{
+	UBaseType_t ux_slot;
+
+	if (x_position == queueOVERWRITE && p_queue->ux_count) {
+		p_queue->ux_count = 0;
+	}
+	if (pv_item) {
+		if (x_position == queueSEND_TO_FRONT) {
+			p_queue->ux_head = (p_queue->ux_head + p_queue->ux_length - 1) %
+					p_queue->ux_length;
+			ux_slot = p_queue->ux_head;
+		} else {
+			ux_slot = (p_queue->ux_head + p_queue->ux_count) %
+					p_queue->ux_length;
+		}
+		memcpy(p_queue->p_storage + ux_slot * p_queue->ux_item_size,
+				pv_item, p_queue->ux_item_size);
+	}
+	p_queue->ux_count++;
+	p_queue->p_holder = NULL;
+	rtos_changed();
+}
+
+/**
+ * \brief Take the first item of a non-empty queue. Lock held.
+ */
+static void rtos_queue_get(host_queue_t *p_queue, void *pv_item,
+		bool b_peek)
+{
+	if (p_queue->ux_item_size) {
+		memcpy(pv_item, p_queue->p_storage +
+				p_queue->ux_head * p_queue->ux_item_size,
+				p_queue->ux_item_size);
+	}
+	if (b_peek) {
+		return;
+	}
+	p_queue->ux_head = (p_queue->ux_head + 1) % p_queue->ux_length;
+	p_queue->ux_count--;
+	if (p_queue->uc_type == queueQUEUE_TYPE_MUTEX ||
+			p_queue->uc_type == queueQUEUE_TYPE_RECURSIVE_MUTEX) {
+		p_queue->p_holder = rtos_self();
+	}
+	rtos_changed();
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t xQueue,
+		const void * const pvItemToQueue, TickType_t xTicksToWait,
+		const BaseType_t xCopyPosition)
+{
+	host_queue_t *p_queue = xQueue;
+	struct timespec ts = rtos_deadline(xTicksToWait);
+	BaseType_t x_ret = errQUEUE_FULL;
+
+	host_lock();
+	while (p_queue->ux_count >= p_queue->ux_length &&
+			xCopyPosition != queueOVERWRITE && xTicksToWait &&
+			rtos_wait(xTicksToWait == portMAX_DELAY ? NULL : &ts)) {
+	}
+	if (p_queue->ux_count < p_queue->ux_length ||
+			xCopyPosition == queueOVERWRITE) {
+		rtos_queue_put(p_queue, pvItemToQueue, xCopyPosition);
+		x_ret = pdPASS;
+	}
+	host_unlock();
+	return x_ret;
+}
+
+BaseType_t xQueueGenericSendFromISR(QueueHandle_t xQueue,
+		const void * const pvItemToQueue,
+		BaseType_t * const pxHigherPriorityTaskWoken,
+		const BaseType_t xCopyPosition)
+{
+	host_queue_t *p_queue = xQueue;
+	BaseType_t x_ret = errQUEUE_FULL;
+
+	host_lock();
+	if (p_queue->ux_count < p_queue->ux_length ||
+			xCopyPosition == queueOVERWRITE) {
+		rtos_queue_put(p_queue, pvItemToQueue, xCopyPosition);
+		if (pxHigherPriorityTaskWoken) {
+			*pxHigherPriorityTaskWoken = pdTRUE;
+		}
+		x_ret = pdPASS;
+	}
+	host_unlock();
+	return x_ret;
+}
+
+BaseType_t xQueueGiveFromISR(QueueHandle_t xQueue,
+		BaseType_t * const pxHigherPriorityTaskWoken)
+{
+	return xQueueGenericSendFromISR(xQueue, NULL, pxHigherPriorityTaskWoken,
+			queueSEND_TO_BACK);
+}
+
+BaseType_t xQueueGenericReceive(QueueHandle_t xQueue, void * const pvBuffer,
+		TickType_t xTicksToWait, const BaseType_t xJustPeek)
+{
+	host_queue_t *p_queue = xQueue;
+	struct timespec ts = rtos_deadline(xTicksToWait);
+	BaseType_t x_ret = errQUEUE_EMPTY;
+
+	host_lock();
+	while (!p_queue->ux_count && xTicksToWait &&
+			rtos_wait(xTicksToWait == portMAX_DELAY ? NULL : &ts)) {
+	}
+	if (p_queue->ux_count) {
+		rtos_queue_get(p_queue, pvBuffer, xJustPeek);
+		x_ret = pdPASS;
+	}
+	host_unlock();
+	return x_ret;
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t xQueue, void * const pvBuffer,
+		BaseType_t * const pxHigherPriorityTaskWoken)
+{
+	host_queue_t *p_queue = xQueue;
+	BaseType_t x_ret = pdFAIL;
+
+	host_lock();
+	if (p_queue->ux_count) {
+		rtos_queue_get(p_queue, pvBuffer, false);
+		if (pxHigherPriorityTaskWoken) {
+			*pxHigherPriorityTaskWoken = pdTRUE;
+		}
+		x_ret = pdPASS;
+	}
+	host_unlock();
+	return x_ret;
+}
+
+BaseType_t xQueueTakeMutexRecursive(QueueHandle_t xMutex,
+		TickType_t xTicksToWait)
+{
+	host_queue_t *p_queue = xMutex;
+	BaseType_t x_ret;
+
+	host_lock();
+	if (p_queue->p_holder == rtos_self()) {
+		p_queue->ux_recursion++;
+		host_unlock();
+		return pdPASS;
+	}
+	host_unlock();
+	x_ret = xQueueGenericReceive(xMutex, NULL, xTicksToWait, pdFALSE);
+	if (x_ret == pdPASS) {
+		p_queue->ux_recursion = 1;
+	}
+	return x_ret;
+}
+
+BaseType_t xQueueGiveMutexRecursive(QueueHandle_t xMutex)
+{
+	host_queue_t *p_queue = xMutex;
+
+	host_lock();
+	if (p_queue->p_holder != rtos_self()) {
+		host_unlock();
+		return pdFAIL;
+	}
+	if (!--p_queue->ux_recursion) {
+		rtos_queue_put(p_queue, NULL, queueSEND_TO_BACK);
+	}
+	host_unlock();
+	return pdPASS;
+}
+
+void *xQueueGetMutexHolder(QueueHandle_t xSemaphore)
+{
+	host_queue_t *p_queue = xSemaphore;
+
+	return p_queue->p_holder;
+}
+
+UBaseType_t uxQueueMessagesWaiting(const QueueHandle_t xQueue)
+{
+	const host_queue_t *p_queue = xQueue;
+
+	return p_queue->ux_count;
+}
+
+UBaseType_t uxQueueMessagesWaitingFromISR(const QueueHandle_t xQueue)
+{
+	return uxQueueMessagesWaiting(xQueue);
+}
+
+UBaseType_t uxQueueSpacesAvailable(const QueueHandle_t xQueue)
+{
+	const host_queue_t *p_queue = xQueue;
+
+	return p_queue->ux_length - p_queue->ux_count;
+}
+
+/** @} */
@@ -0,0 +1,71 @@
+/**
+ * \file
+ *
+ * \brief FreeRTOS port definitions of the host tests, see host_rtos.c.
+ *
+ * Found before the Cortex-M7 port by the include path of the firmware
+ * tests. The kernel itself is not built: host_rtos.c implements the API on
+ * threads.
+ *
+ */
+
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define portCHAR		char
+#define portFLOAT		float
+#define portDOUBLE		double
+#define portLONG		long
+#define portSHORT		short
+#define portSTACK_TYPE	uint32_t
+#define portBASE_TYPE	long
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define portMAX_DELAY				( TickType_t ) 0xffffffffUL
+#define portTICK_TYPE_IS_ATOMIC		1
+#define portSTACK_GROWTH			( -1 )
+#define portTICK_PERIOD_MS			( ( TickType_t ) 1000 / configTICK_RATE_HZ )
+#define portBYTE_ALIGNMENT			8
+
+void vPortYield( void );
+void vPortEnterCritical( void );
+void vPortExitCritical( void );
+UBaseType_t ulPortSetInterruptMask( void );
+void vPortClearInterruptMask( UBaseType_t uxMask );
+
+#define portYIELD()								vPortYield()
+#define portEND_SWITCHING_ISR( xSwitchRequired )	( void ) ( xSwitchRequired )
+#define portYIELD_FROM_ISR( x )					portEND_SWITCHING_ISR( x )
+
+#define portSET_INTERRUPT_MASK_FROM_ISR()		ulPortSetInterruptMask()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR( x )	vPortClearInterruptMask( x )
+#define portDISABLE_INTERRUPTS()				vPortEnterCritical()
+#define portENABLE_INTERRUPTS()					vPortExitCritical()
+#define portENTER_CRITICAL()					vPortEnterCritical()
+#define portEXIT_CRITICAL()						vPortExitCritical()
+
+#define portTASK_FUNCTION_PROTO( vFunction, pvParameters ) void vFunction( void *pvParameters )
+#define portTASK_FUNCTION( vFunction, pvParameters ) void vFunction( void *pvParameters )
+
+#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime )
+#define portASSERT_IF_INTERRUPT_PRIORITY_INVALID()
+#define portNOP()
+
+/* A failed assertion ends the test instead of spinning. */
+void vAssertCalled( const char *pcFile, unsigned long ulLine );
+#undef configASSERT
+#define configASSERT( x ) if( ( x ) == 0 ) { vAssertCalled( __FILE__, __LINE__ ); }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PORTMACRO_H */
@@ -0,0 +1,134 @@
+/**
+ * \file
+ *
+ * \brief Checks and timing for the host tests.
+ *
+ */
+
+#ifndef TEST_H_INCLUDED
+#define TEST_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * \defgroup test_group Host tests
+ *
+ * Each test is one program, built and run by the Makefile of this
+ * directory with the host compiler, against the firmware sources and
+ * models of the hardware they drive. A failed check prints where it failed
+ * and the program goes on, then returns non-zero from test_end().
+ *
+ * Benchmarks print their tables on stdout; their times are host times,
+ * for comparing variants with one another, not with the target.
+ *
+ * @{
+ */
+
+/** Checks failed so far. */
+static unsigned int gs_test_failures;
+
+/** Check a condition. */
+#define TEST_CHECK(cond) \
+	test_check((cond), #cond, __FILE__, __LINE__)
+
+/** Check that two integers are equal. */
+#define TEST_CHECK_EQ(a, b) \
+	test_check_eq((long long)(a), (long long)(b), #a, #b, __FILE__, \
+			__LINE__)
+
+/** Check that two values are within \a tol of each other. */
+#define TEST_CHECK_NEAR(a, b, tol) \
+	test_check_near((double)(a), (double)(b), (double)(tol), #a, #b, \
+			__FILE__, __LINE__)
+
+static inline bool test_check(bool b_ok, const char *p_what,
+		const char *p_file, int line)
+{
+	if (!b_ok) {
+		printf("%s:%d: check failed: %s\n", p_file, line, p_what);
+		gs_test_failures++;
+	}
+	return b_ok;
+}
+
+static inline bool test_check_eq(long long a, long long b,
+		const char *p_a, const char *p_b, const char *p_file, int line)
+{
+	if (a != b) {
+		printf("%s:%d: %s == %s failed: %lld != %lld\n", p_file, line,
+				p_a, p_b, a, b);
+		gs_test_failures++;
+		return false;
+	}
+	return true;
+}
+
+static inline bool test_check_near(double a, double b, double tol,
+		const char *p_a, const char *p_b, const char *p_file, int line)
+{
+	double d = a - b;
+
+	if (!(d <= tol && d >= -tol)) {
+		printf("%s:%d: %s ~ %s failed: %g and %g, %g apart, tolerance %g\n",
+				p_file, line, p_a, p_b, a, b, d < 0 ? -d : d, tol);
+		gs_test_failures++;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * \brief Print the outcome of a test program.
+ *
+ * \return The exit status of the program.
+ */
+static inline int test_end(const char *p_name)
+{
+	if (gs_test_failures) {
+		printf("%s: %u checks failed\n", p_name, gs_test_failures);
+		return 1;
+	}
+	printf("%s: ok\n", p_name);
+	return 0;
+}
+
+/**
+ * \brief Monotonic time in seconds.
+ */
+static inline double test_seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * \brief Reproducible pseudo-random numbers, the same on every host.
+ */
+static inline uint32_t test_rand(uint32_t *p_state)
+{
+	/* xorshift32. */
+	uint32_t x = *p_state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*p_state = x;
+	return x;
+}
+
+/**
+ * \brief Pseudo-random value in [-1, 1).
+ */
+static inline double test_rand_unit(uint32_t *p_state)
+{
+	return (double)(int32_t)test_rand(p_state) / 2147483648.0;
+}
+
+/** @} */
+
+#endif /* TEST_H_INCLUDED */
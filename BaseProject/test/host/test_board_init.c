@@ -0,0 +1,281 @@
+/**
+ * \file
+ *
+ * \brief Host test of the pin setup of board_init(), against a model of the
+ * PIO controllers out of reset, with the board phase of the boot profiler.
+ *
+ * board_init() runs once writing every property of the pin map, as with
+ * CONF_BOARD_PIO_WRITE_ALL, and once skipping those at their reset value.
+ * The test checks that both leave every controller in the state the pin
+ * map describes, and counts the PIO register accesses of each.
+ *
+ * The write only registers of the model start at a pattern, so a register
+ * that changed was written once. The ABCDSR read-modify-writes cannot be
+ * seen that way and are counted from the register images.
+ *
+ * The boot profiler stamps BOOT_PHASE_BOARD around board_init(), with the
+ * cycle counter following the host clock.
+ *
+ */
+
+#include <asf.h>
+
+/* The cycle counter follows the host clock. */
+static DWT_Type *test_dwt(void);
+#undef DWT
+#define DWT                 test_dwt()
+
+/* The pin setup of board_init() goes through the test. */
+static void test_configure_port(ioport_port_t port,
+		const struct ioport_port_config *cfg);
+#define ioport_configure_port_from_reset test_configure_port
+
+/* init.c and boot.c are built into the test, see above. */
+#include "init.c"
+#include "boot.c"
+#include "test.h"
+#include <string.h>
+
+/** Value of the write only registers out of reset, in the model. */
+#define TEST_UNWRITTEN      0xA5A5A5A5u
+
+/** board_init() calls timed per mode. */
+#define TEST_RUNS           100000
+
+/** PIO controllers of the board. */
+#define TEST_PORTS          5
+
+/** Properties of a pin, see gs_properties. */
+#define TEST_PROPERTIES     12
+
+/* No TCM section to load. */
+uint32_t _sitcm, _sdtcm, _szero_dtcm;
+extern uint32_t _itcm_lma __attribute__((alias("_sitcm")));
+extern uint32_t _eitcm __attribute__((alias("_sitcm")));
+extern uint32_t _dtcm_lma __attribute__((alias("_sdtcm")));
+extern uint32_t _edtcm __attribute__((alias("_sdtcm")));
+extern uint32_t _ezero_dtcm __attribute__((alias("_szero_dtcm")));
+
+static bool gs_b_write_all;
+static uint32_t gs_ul_cycles_base;
+
+/** Register images of the pin map, as applied by board_init(). */
+static const struct ioport_port_config gs_cfgs[TEST_PORTS] = {
+	IOPORT_MAP_PORT_CONFIG(board_pin_map, IOPORT_PIOA),
+	IOPORT_MAP_PORT_CONFIG(board_pin_map, IOPORT_PIOB),
+	IOPORT_MAP_PORT_CONFIG(board_pin_map, IOPORT_PIOC),
+	IOPORT_MAP_PORT_CONFIG(board_pin_map, IOPORT_PIOD),
+	IOPORT_MAP_PORT_CONFIG(board_pin_map, IOPORT_PIOE),
+};
+
+static DWT_Type *test_dwt(void)
+{
+	host_dwt.CYCCNT = host_cycles() - gs_ul_cycles_base;
+	return &host_dwt;
+}
+
+static void test_configure_port(ioport_port_t port,
+		const struct ioport_port_config *cfg)
+{
+	if (gs_b_write_all) {
+		arch_ioport_configure_port(port, cfg);
+	} else {
+		arch_ioport_configure_port_from_reset(port, cfg);
+	}
+}
+
+/** Enable and disable registers of a property, and its reset state. */
+struct test_property {
+	const char *p_name;
+	size_t set;
+	size_t clear;
+	uint32_t ul_reset;
+};
+
+#define TEST_PROPERTY(name, set, clear, reset) \
+	{ name, offsetof(Pio, set), offsetof(Pio, clear), reset }
+
+static const struct test_property gs_properties[TEST_PROPERTIES] = {
+	TEST_PROPERTY("pio", PIO_PER, PIO_PDR, 0xFFFFFFFF),
+	TEST_PROPERTY("output", PIO_OER, PIO_ODR, 0),
+	TEST_PROPERTY("filter", PIO_IFER, PIO_IFDR, 0),
+	TEST_PROPERTY("high", PIO_SODR, PIO_CODR, 0),
+	TEST_PROPERTY("open drain", PIO_MDER, PIO_MDDR, 0),
+	TEST_PROPERTY("pullup", PIO_PUER, PIO_PUDR, 0xFFFFFFFF),
+	TEST_PROPERTY("debounce", PIO_IFSCER, PIO_IFSCDR, 0),
+	TEST_PROPERTY("pulldown", PIO_PPDER, PIO_PPDDR, 0),
+	TEST_PROPERTY("sense", PIO_AIMER, PIO_AIMDR, 0),
+	TEST_PROPERTY("level", PIO_LSR, PIO_ESR, 0),
+	TEST_PROPERTY("rise high", PIO_REHLSR, PIO_FELLSR, 0),
+	TEST_PROPERTY("write", PIO_OWER, PIO_OWDR, 0),
+};
+
+/** State of the controllers after board_init(). */
+struct test_state {
+	uint32_t ul_properties[TEST_PORTS][TEST_PROPERTIES];
+	uint32_t ul_mux[TEST_PORTS][2];
+	uint32_t ul_accesses[TEST_PORTS];
+};
+
+static uint32_t *test_reg(Pio *p_pio, size_t offset)
+{
+	return (uint32_t *)((uint8_t *)p_pio + offset);
+}
+
+/** Put the PIO controllers back to their reset state. */
+static void test_reset(void)
+{
+	uint32_t i, j;
+
+	memset(host_pio, 0, sizeof(host_pio));
+	for (i = 0; i < TEST_PORTS; i++) {
+		for (j = 0; j < TEST_PROPERTIES; j++) {
+			*test_reg(&host_pio[i], gs_properties[j].set) = TEST_UNWRITTEN;
+			*test_reg(&host_pio[i], gs_properties[j].clear) = TEST_UNWRITTEN;
+		}
+	}
+}
+
+/** The state of the controllers, from the registers written. */
+static void test_collect(struct test_state *p_state)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < TEST_PORTS; i++) {
+		const struct ioport_port_config *p_cfg = &gs_cfgs[i];
+		uint32_t ul_accesses = 0;
+
+		for (j = 0; j < TEST_PROPERTIES; j++) {
+			uint32_t ul_set = *test_reg(&host_pio[i], gs_properties[j].set);
+			uint32_t ul_clear =
+					*test_reg(&host_pio[i], gs_properties[j].clear);
+
+			if (ul_set == TEST_UNWRITTEN) {
+				ul_set = 0;
+			} else {
+				ul_accesses++;
+			}
+			if (ul_clear == TEST_UNWRITTEN) {
+				ul_clear = 0;
+			} else {
+				ul_accesses++;
+			}
+			p_state->ul_properties[i][j] =
+					(gs_properties[j].ul_reset & ~ul_clear) | ul_set;
+		}
+		for (j = 0; j < 2; j++) {
+			uint32_t ul_mux = j ? p_cfg->mux1 : p_cfg->mux0;
+
+			p_state->ul_mux[i][j] = host_pio[i].PIO_ABCDSR[j];
+			/* A read and a write. */
+			if (gs_b_write_all ? p_cfg->pins != 0 : ul_mux != 0) {
+				ul_accesses += 2;
+			}
+		}
+		p_state->ul_accesses[i] = ul_accesses;
+	}
+}
+
+/** Expected state of the pins of the map. */
+static void test_check_map(const struct test_state *p_state)
+{
+	uint32_t i;
+
+	for (i = 0; i < TEST_PORTS; i++) {
+		const struct ioport_port_config *p_cfg = &gs_cfgs[i];
+		const uint32_t *p_props = p_state->ul_properties[i];
+		uint32_t ul_pins = p_cfg->pins;
+		uint32_t ul_outputs = p_cfg->output;
+
+		TEST_CHECK_EQ(p_props[0] & ul_pins, p_cfg->gpio);
+		TEST_CHECK_EQ(p_props[1] & ul_pins, ul_outputs);
+		TEST_CHECK_EQ(p_props[2] & ul_pins, p_cfg->filter);
+		TEST_CHECK_EQ(p_props[3] & ul_outputs, p_cfg->high);
+		TEST_CHECK_EQ(p_props[4] & ul_pins, p_cfg->open_drain);
+		TEST_CHECK_EQ(p_props[5] & ul_pins, p_cfg->pullup);
+		TEST_CHECK_EQ(p_props[6] & ul_pins, p_cfg->debounce);
+		TEST_CHECK_EQ(p_props[7] & ul_pins, p_cfg->pulldown);
+		TEST_CHECK_EQ(p_props[8] & ul_pins, p_cfg->sense);
+		TEST_CHECK_EQ(p_props[9] & p_cfg->sense, p_cfg->level);
+		TEST_CHECK_EQ(p_props[10] & p_cfg->sense, p_cfg->rise_high);
+		TEST_CHECK_EQ(p_props[11] & ul_pins, p_cfg->gpio);
+		TEST_CHECK_EQ(p_state->ul_mux[i][0] & ul_pins, p_cfg->mux0);
+		TEST_CHECK_EQ(p_state->ul_mux[i][1] & ul_pins, p_cfg->mux1);
+		/* The other pins are left at their reset state. */
+		TEST_CHECK_EQ(p_props[0] & ~ul_pins, ~ul_pins);
+		TEST_CHECK_EQ(p_props[5] & ~ul_pins, ~ul_pins);
+		TEST_CHECK_EQ(p_props[1] & ~ul_pins, 0);
+	}
+}
+
+/**
+ * \brief Run board_init() in a mode, check the state of the controllers
+ * and time it with the board phase of the boot profiler.
+ *
+ * \return Host cycles per board_init().
+ */
+static uint32_t test_board_init(bool b_write_all, struct test_state *p_state)
+{
+	uint32_t ul_start = 0, ul_end = 0;
+	uint32_t i;
+
+	gs_b_write_all = b_write_all;
+	test_reset();
+	board_init();
+	test_collect(p_state);
+	test_check_map(p_state);
+
+	gs_ul_stamp_count = 0;
+	gs_ul_cycles_base = host_cycles();
+	boot_stamp(BOOT_PHASE_SYSCLK);
+	for (i = 0; i < TEST_RUNS; i++) {
+		board_init();
+	}
+	boot_stamp(BOOT_PHASE_BOARD);
+	for (i = 0; i < gs_ul_stamp_count; i++) {
+		if (gs_stamps[i].uc_phase == BOOT_PHASE_SYSCLK) {
+			ul_start = gs_stamps[i].ul_cycles;
+		} else if (gs_stamps[i].uc_phase == BOOT_PHASE_BOARD) {
+			ul_end = gs_stamps[i].ul_cycles;
+		}
+	}
+	return (ul_end - ul_start) / TEST_RUNS;
+}
+
+int main(void)
+{
+	static struct test_state all, reset;
+	uint32_t ul_all_cycles, ul_reset_cycles;
+	uint32_t ul_all = 0, ul_reset = 0;
+	uint32_t i;
+
+	/* The GPNVM bits already select the TCM size, so board_init() does not
+	 * reset the chip. */
+	HOST_REG(EFC->EEFC_FSR) = EEFC_FSR_FRDY;
+	HOST_REG(EFC->EEFC_FRR) = BOARD_GPNVM_TCM_32K;
+
+	ul_all_cycles = test_board_init(true, &all);
+	ul_reset_cycles = test_board_init(false, &reset);
+
+	/* Same state, whichever writes are made. */
+	TEST_CHECK(memcmp(all.ul_properties, reset.ul_properties,
+			sizeof(all.ul_properties)) == 0);
+	TEST_CHECK(memcmp(all.ul_mux, reset.ul_mux, sizeof(all.ul_mux)) == 0);
+
+	printf("%-6s %10s %10s\n", "port", "write all", "from reset");
+	for (i = 0; i < TEST_PORTS; i++) {
+		printf("PIO%c   %10lu %10lu\n", 'A' + (char)i,
+				(unsigned long)all.ul_accesses[i],
+				(unsigned long)reset.ul_accesses[i]);
+		ul_all += all.ul_accesses[i];
+		ul_reset += reset.ul_accesses[i];
+		TEST_CHECK(reset.ul_accesses[i] <= all.ul_accesses[i]);
+	}
+	printf("%-6s %10lu %10lu\n", "total", (unsigned long)ul_all,
+			(unsigned long)ul_reset);
+	printf("%-6s %10lu %10lu host cycles of board_init()\n", "board",
+			(unsigned long)ul_all_cycles, (unsigned long)ul_reset_cycles);
+	TEST_CHECK(ul_reset < ul_all);
+
+	return test_end("board_init");
+}
@@ -0,0 +1,382 @@
+/**
+ * \file
+ *
+ * \brief Host test of the runtime clock scaling, against a model of the
+ * clock tree: PLLA, the master clock selection, the flash wait states and
+ * the clocks of the peripherals that follow it.
+ *
+ */
+
+/*
+ * The model runs at each access of the PMC driver and of the PLL service
+ * to the PMC: every write the switch does is followed by a status poll, so
+ * it sees every clock the chip goes through.
+ */
+static Pmc *test_pmc(void);
+#undef PMC
+#define PMC                 test_pmc()
+
+#include <asf.h>
+/* pmc.c and clock_scale.c are built into the test, on the model. */
+#include "pmc.c"
+#include "clock_scale.c"
+#include "usart_spi_dma.h"
+#include "test.h"
+
+/** MCK limit of the datasheet. */
+#define TEST_MCK_MAX        150000000u
+
+/** Accesses to the PMC before PLLA locks, more than a switch takes. */
+#define TEST_LOCK_POLLS     50
+
+/** Baud rate of the SPI master on USART0. */
+#define TEST_SPI_BAUD       10000000u
+
+/** Notifier calls recorded. */
+#define TEST_CALLS          8
+
+/** Clocks of the model, as the registers set them. */
+static uint32_t gs_ul_model_cpu_hz;
+static uint32_t gs_ul_model_mck_hz;
+/** Highest MCK since the test reset it. */
+static uint32_t gs_ul_model_mck_peak;
+/** PLLA setting the lock countdown is for. */
+static uint32_t gs_ul_pllar;
+static uint32_t gs_ul_lock_polls;
+/** Checks at each access, once the model is set up. */
+static bool gs_b_model;
+static usart_spi_dma_t gs_spi;
+static bool gs_b_spi;
+
+/** A notifier call, and the model MCK it ran at. */
+struct test_call {
+	uint32_t ul_notifier;
+	enum clock_scale_event event;
+	uint32_t ul_mck_hz;
+	uint32_t ul_model_mck_hz;
+};
+
+static struct test_call gs_calls[TEST_CALLS];
+static uint32_t gs_ul_calls;
+
+/**
+ * \brief Wait states the flash needs at a processor clock, as
+ * system_init_flash() gives them.
+ */
+static uint32_t test_fws(uint32_t ul_hz)
+{
+	static const uint32_t ul_max_hz[] = {
+		CHIP_FREQ_FWS_0, CHIP_FREQ_FWS_1, CHIP_FREQ_FWS_2, CHIP_FREQ_FWS_3,
+		CHIP_FREQ_FWS_4, CHIP_FREQ_FWS_5,
+	};
+	uint32_t i;
+
+	for (i = 0; i < sizeof(ul_max_hz) / sizeof(ul_max_hz[0]); i++) {
+		if (ul_hz < ul_max_hz[i]) {
+			return i;
+		}
+	}
+	return i;
+}
+
+/**
+ * \brief PMC model: work out the clocks from PLLAR and MCKR, lock PLLA a
+ * few polls after it is set up, and check the chip runs within its limits.
+ */
+static Pmc *test_pmc(void)
+{
+	Pmc *p_pmc = &host_pmc;
+	uint32_t ul_mckr = p_pmc->PMC_MCKR;
+	uint32_t ul_pllar = p_pmc->CKGR_PLLAR;
+	uint32_t ul_mula = (ul_pllar & CKGR_PLLAR_MULA_Msk) >>
+			CKGR_PLLAR_MULA_Pos;
+	uint32_t ul_diva = (ul_pllar & CKGR_PLLAR_DIVA_Msk) >>
+			CKGR_PLLAR_DIVA_Pos;
+	uint32_t ul_plla_hz = 0;
+	uint32_t ul_pres = (ul_mckr & PMC_MCKR_PRES_Msk) >> PMC_MCKR_PRES_Pos;
+	uint32_t ul_hz;
+	uint32_t ul_cd;
+
+	host_lock();
+	if (ul_pllar != gs_ul_pllar) {
+		gs_ul_pllar = ul_pllar;
+		gs_ul_lock_polls = TEST_LOCK_POLLS;
+	}
+	if (ul_mula && ul_diva) {
+		if (gs_ul_lock_polls) {
+			gs_ul_lock_polls--;
+			HOST_REG(p_pmc->PMC_SR) &= ~PMC_SR_LOCKA;
+		} else {
+			ul_plla_hz = BOARD_FREQ_MAINCK_XTAL / ul_diva * (ul_mula + 1);
+			HOST_REG(p_pmc->PMC_SR) |= PMC_SR_LOCKA;
+		}
+	} else {
+		HOST_REG(p_pmc->PMC_SR) &= ~PMC_SR_LOCKA;
+	}
+	HOST_REG(p_pmc->PMC_SR) |= PMC_SR_MCKRDY | PMC_SR_MOSCXTS |
+			PMC_SR_MOSCSELS;
+
+	switch (ul_mckr & PMC_MCKR_CSS_Msk) {
+	case PMC_MCKR_CSS_SLOW_CLK:
+		ul_hz = OSC_SLCK_32K_XTAL_HZ;
+		break;
+	case PMC_MCKR_CSS_MAIN_CLK:
+		ul_hz = BOARD_FREQ_MAINCK_XTAL;
+		break;
+	case PMC_MCKR_CSS_PLLA_CLK:
+		ul_hz = ul_plla_hz;
+		break;
+	default:
+		ul_hz = 0;
+		break;
+	}
+	gs_ul_model_cpu_hz = (ul_pres == 7) ? ul_hz / 3 : ul_hz >> ul_pres;
+	switch (ul_mckr & PMC_MCKR_MDIV_Msk) {
+	case PMC_MCKR_MDIV_PCK_DIV2:
+		gs_ul_model_mck_hz = gs_ul_model_cpu_hz / 2;
+		break;
+	case PMC_MCKR_MDIV_PCK_DIV3:
+		gs_ul_model_mck_hz = gs_ul_model_cpu_hz / 3;
+		break;
+	case PMC_MCKR_MDIV_PCK_DIV4:
+		gs_ul_model_mck_hz = gs_ul_model_cpu_hz / 4;
+		break;
+	default:
+		gs_ul_model_mck_hz = gs_ul_model_cpu_hz;
+		break;
+	}
+	gs_ul_model_mck_peak = Max(gs_ul_model_mck_peak, gs_ul_model_mck_hz);
+
+	if (gs_b_model) {
+		/* Never on a PLL that is not running. */
+		TEST_CHECK(gs_ul_model_cpu_hz != 0);
+		TEST_CHECK(gs_ul_model_cpu_hz <= CHIP_FREQ_CPU_MAX);
+		TEST_CHECK(gs_ul_model_mck_hz <= TEST_MCK_MAX);
+		/* Enough wait states at any time. */
+		TEST_CHECK((EFC->EEFC_FMR & EEFC_FMR_FWS_Msk) >> EEFC_FMR_FWS_Pos >=
+				test_fws(gs_ul_model_cpu_hz));
+		/* The SPI bus is never clocked above its rate, but for the
+		 * rounding of the divisor. */
+		ul_cd = (USART0->US_BRGR & US_BRGR_CD_Msk) >> US_BRGR_CD_Pos;
+		if (gs_b_spi && TEST_CHECK(ul_cd != 0)) {
+			TEST_CHECK(gs_ul_model_mck_hz / ul_cd <= TEST_SPI_BAUD / 7 * 8);
+		}
+	}
+	host_unlock();
+
+	return p_pmc;
+}
+
+/**
+ * \brief Baud rate of the console USART, from its registers at the model
+ * MCK.
+ */
+static double test_console_baud(void)
+{
+	Usart *p_usart = (Usart *)CONF_UART;
+	uint32_t ul_over = (p_usart->US_MR & US_MR_OVER) ? 8 : 16;
+	uint32_t ul_cd = (p_usart->US_BRGR & US_BRGR_CD_Msk) >> US_BRGR_CD_Pos;
+	uint32_t ul_fp = (p_usart->US_BRGR & US_BRGR_FP_Msk) >> US_BRGR_FP_Pos;
+
+	return 8.0 * gs_ul_model_mck_hz / (ul_over * (8 * ul_cd + ul_fp));
+}
+
+static void test_notify(enum clock_scale_event event,
+		const clock_scale_freq_t *p_freq, void *p_ctx)
+{
+	(void)test_pmc();
+	if (gs_ul_calls < TEST_CALLS) {
+		gs_calls[gs_ul_calls].ul_notifier = (uint32_t)(uintptr_t)p_ctx;
+		gs_calls[gs_ul_calls].event = event;
+		gs_calls[gs_ul_calls].ul_mck_hz = p_freq->ul_mck_hz;
+		gs_calls[gs_ul_calls].ul_model_mck_hz = gs_ul_model_mck_hz;
+	}
+	gs_ul_calls++;
+}
+
+static struct clock_scale_notifier gs_notifiers[2] = {
+	{ .callback = test_notify, .p_ctx = (void *)0 },
+	{ .callback = test_notify, .p_ctx = (void *)1 },
+};
+
+/**
+ * \brief The SPI bus owner keeps its baud rate, as the engine asks: slow
+ * enough for both clocks during the switch.
+ */
+static void test_spi_clock_changed(enum clock_scale_event event,
+		const clock_scale_freq_t *p_freq, void *p_ctx)
+{
+	if (event == CLOCK_SCALE_PRE_CHANGE) {
+		usart_spi_dma_set_clock(&gs_spi, Max(p_freq->ul_mck_hz,
+				clock_scale_get_peripheral_hz()));
+	} else {
+		usart_spi_dma_set_clock(&gs_spi, p_freq->ul_mck_hz);
+	}
+}
+
+static struct clock_scale_notifier gs_spi_notifier = {
+	.callback = test_spi_clock_changed,
+};
+
+/**
+ * \brief Put the chip in the state sysclk_init() leaves it in: PLLA as
+ * conf_clock.h sets it, MCK from it, and the wait states for it.
+ */
+static void test_boot(void)
+{
+	struct pll_config pllcfg;
+
+	pll_config_defaults(&pllcfg, 0);
+	pll_enable(&pllcfg, 0);
+	TEST_CHECK_EQ(pll_wait_for_lock(0), 0);
+	PMC->PMC_MCKR = PMC_MCKR_CSS_PLLA_CLK | CONFIG_SYSCLK_PRES |
+			PMC_MCKR_MDIV(CONFIG_SYSCLK_DIV - 1);
+	(void)test_pmc();
+	system_init_flash(gs_ul_model_cpu_hz);
+	HOST_REG(((Usart *)CONF_UART)->US_CSR) = US_CSR_TXEMPTY;
+	gs_b_model = true;
+}
+
+/**
+ * \brief After init: the first point, at the clocks the chip boots in.
+ */
+static void test_init(void)
+{
+	clock_scale_freq_t freq;
+	uint32_t i;
+
+	TEST_CHECK(clock_scale_init());
+	TEST_CHECK_EQ(clock_scale_get(), 0);
+	TEST_CHECK_EQ(clock_scale_get_cpu_hz(), gs_ul_model_cpu_hz);
+	TEST_CHECK_EQ(clock_scale_get_peripheral_hz(), gs_ul_model_mck_hz);
+	TEST_CHECK_EQ(gs_ul_model_cpu_hz, 300000000);
+	TEST_CHECK_EQ(gs_ul_model_mck_hz, 150000000);
+
+	for (i = 0; i < CLOCK_SCALE_NUM; i++) {
+		clock_scale_get_freq((enum clock_scale_point)i, &freq);
+		TEST_CHECK(freq.ul_cpu_hz <= CHIP_FREQ_CPU_MAX);
+		TEST_CHECK(freq.ul_mck_hz <= TEST_MCK_MAX);
+		TEST_CHECK(clock_scale_get_name((enum clock_scale_point)i) != NULL);
+	}
+	TEST_CHECK(clock_scale_get_name(CLOCK_SCALE_NUM) == NULL);
+
+	clock_scale_register(&gs_notifiers[0]);
+	clock_scale_register(&gs_notifiers[1]);
+
+	USART0->US_BRGR = US_BRGR_CD((gs_ul_model_mck_hz + TEST_SPI_BAUD / 2) /
+			TEST_SPI_BAUD);
+	TEST_CHECK_EQ(usart_spi_dma_init(&gs_spi, USART0, TEST_SPI_BAUD,
+			XDMAC_PERID_USART0_TX, XDMAC_PERID_USART0_RX), STATUS_OK);
+	clock_scale_register(&gs_spi_notifier);
+	gs_b_spi = true;
+}
+
+/**
+ * \brief Switch to a point and check everything that follows MCK.
+ */
+static void test_switch(enum clock_scale_point point, uint32_t ul_notifiers)
+{
+	clock_scale_freq_t freq;
+	uint32_t ul_from_mck = gs_ul_model_mck_hz;
+	uint32_t ul_cd;
+	uint32_t i;
+
+	clock_scale_get_freq(point, &freq);
+	gs_ul_model_mck_peak = gs_ul_model_mck_hz;
+	gs_ul_calls = 0;
+	if (!TEST_CHECK_EQ(clock_scale_set(point), STATUS_OK)) {
+		return;
+	}
+	(void)test_pmc();
+
+	/* The clocks of the point, never above both ends on the way. */
+	TEST_CHECK_EQ(clock_scale_get(), point);
+	TEST_CHECK_EQ(gs_ul_model_cpu_hz, freq.ul_cpu_hz);
+	TEST_CHECK_EQ(gs_ul_model_mck_hz, freq.ul_mck_hz);
+	TEST_CHECK_EQ(clock_scale_get_cpu_hz(), freq.ul_cpu_hz);
+	TEST_CHECK_EQ(clock_scale_get_peripheral_hz(), freq.ul_mck_hz);
+	TEST_CHECK(gs_ul_model_mck_peak <= Max(ul_from_mck, freq.ul_mck_hz));
+	/* No more wait states than the new clock needs. */
+	TEST_CHECK_EQ((EFC->EEFC_FMR & EEFC_FMR_FWS_Msk) >> EEFC_FMR_FWS_Pos,
+			test_fws(freq.ul_cpu_hz));
+	/* PLLA runs only for the points that use it. */
+	TEST_CHECK_EQ(!!(PMC->CKGR_PLLAR & CKGR_PLLAR_MULA_Msk),
+			(PMC->PMC_MCKR & PMC_MCKR_CSS_Msk) == PMC_MCKR_CSS_PLLA_CLK);
+
+	/* The kernel tick, the console and the SPI bus keep their rates. */
+	TEST_CHECK_EQ((SysTick->LOAD + 1) * configTICK_RATE_HZ, gs_ul_model_cpu_hz);
+	TEST_CHECK_EQ(SysTick->VAL, 0);
+	TEST_CHECK_NEAR(test_console_baud(), CONF_UART_BAUDRATE,
+			CONF_UART_BAUDRATE / 50);
+	ul_cd = (USART0->US_BRGR & US_BRGR_CD_Msk) >> US_BRGR_CD_Pos;
+	TEST_CHECK_EQ(ul_cd, Max((gs_ul_model_mck_hz + TEST_SPI_BAUD / 2) /
+			TEST_SPI_BAUD, 4));
+
+	/* Each notifier before, at the old clocks, then after, at the new. */
+	if (!TEST_CHECK_EQ(gs_ul_calls, 2 * ul_notifiers)) {
+		return;
+	}
+	for (i = 0; i < gs_ul_calls; i++) {
+		TEST_CHECK_EQ(gs_calls[i].ul_mck_hz, freq.ul_mck_hz);
+		if (i < ul_notifiers) {
+			TEST_CHECK_EQ(gs_calls[i].event, CLOCK_SCALE_PRE_CHANGE);
+			TEST_CHECK_EQ(gs_calls[i].ul_model_mck_hz, ul_from_mck);
+		} else {
+			TEST_CHECK_EQ(gs_calls[i].event, CLOCK_SCALE_POST_CHANGE);
+			TEST_CHECK_EQ(gs_calls[i].ul_model_mck_hz, freq.ul_mck_hz);
+			TEST_CHECK_EQ(gs_calls[i].ul_notifier,
+					gs_calls[i - ul_notifiers].ul_notifier);
+		}
+	}
+}
+
+/**
+ * \brief Every switch between two points, both ways.
+ */
+static void test_switches(void)
+{
+	static const enum clock_scale_point points[] = {
+		CLOCK_SCALE_normal, CLOCK_SCALE_low, CLOCK_SCALE_boost,
+		CLOCK_SCALE_low, CLOCK_SCALE_normal, CLOCK_SCALE_boost,
+	};
+	uint32_t i;
+
+	for (i = 0; i < sizeof(points) / sizeof(points[0]); i++) {
+		test_switch(points[i], 2);
+	}
+
+	/* Nothing to do. */
+	gs_ul_calls = 0;
+	TEST_CHECK_EQ(clock_scale_set(CLOCK_SCALE_boost), STATUS_OK);
+	TEST_CHECK_EQ(clock_scale_set(CLOCK_SCALE_NUM), ERR_INVALID_ARG);
+	TEST_CHECK_EQ(gs_ul_calls, 0);
+}
+
+/**
+ * \brief Unregistered notifiers are not called any more.
+ */
+static void test_unregister(void)
+{
+	clock_scale_unregister(&gs_notifiers[1]);
+	test_switch(CLOCK_SCALE_low, 1);
+	TEST_CHECK_EQ(gs_calls[0].ul_notifier, 0);
+
+	clock_scale_unregister(&gs_notifiers[0]);
+	clock_scale_unregister(&gs_spi_notifier);
+	usart_spi_dma_deinit(&gs_spi);
+	gs_b_spi = false;
+	USART0->US_BRGR = 0;
+	gs_ul_calls = 0;
+	TEST_CHECK_EQ(clock_scale_set(CLOCK_SCALE_boost), STATUS_OK);
+	TEST_CHECK_EQ(gs_ul_calls, 0);
+	TEST_CHECK_EQ(USART0->US_BRGR, 0);
+}
+
+int main(void)
+{
+	test_boot();
+	test_init();
+	test_switches();
+	test_unregister();
+	return test_end("clock_scale");
+}
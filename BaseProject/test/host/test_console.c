@@ -0,0 +1,249 @@
+/**
+ * \file
+ *
+ * \brief Host test of the console transmit ring and of the telemetry frames
+ * queued to it, against a model of the console USART.
+ *
+ */
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+/* console.c is built into the test, for the model to read its ring. */
+#include "console.c"
+#include "conf_telemetry.h"
+#include "cobs.h"
+#include "crc.h"
+#include "telemetry.h"
+#include "test.h"
+
+/** Bytes of the blocking write, more than the ring holds three times. */
+#define TEST_WRITE_LEN      (3 * CONF_CONSOLE_TX_BUFFER_SIZE + 100)
+
+/** Records sent by each of the telemetry tasks. */
+#define TEST_RECORDS        300
+
+/** Everything the USART sent. */
+static uint8_t gs_wire[64 * 1024];
+static uint32_t gs_ul_wire;
+
+static uint8_t gs_pattern[TEST_WRITE_LEN];
+static SemaphoreHandle_t gs_x_done;
+static volatile size_t gs_ul_written;
+
+/**
+ * \brief Model of the console USART: the line takes every byte in the ring
+ * at once, then TXRDY raises the interrupt if it is enabled. IMR follows
+ * the writes to IER and IDR.
+ *
+ * \return Number of bytes sent.
+ */
+static uint32_t test_usart_tx(void)
+{
+	Usart *p_usart = (Usart *)CONF_UART;
+	uint32_t ul_sent = 0;
+	uint32_t ul_tail;
+
+	host_lock();
+	HOST_REG(p_usart->US_IMR) |= p_usart->US_IER;
+	p_usart->US_IER = 0;
+	if (p_usart->US_IMR & US_IMR_TXRDY) {
+		for (ul_tail = gs_ul_tx_tail; ul_tail != gs_ul_tx_head; ul_tail++) {
+			if (gs_ul_wire < sizeof(gs_wire)) {
+				gs_wire[gs_ul_wire++] = gs_tx_buf[ul_tail & TX_MASK];
+			}
+		}
+		ul_sent = gs_ul_tx_head - gs_ul_tx_tail;
+		HOST_REG(p_usart->US_CSR) = US_CSR_TXRDY;
+		host_irq(CONF_CONSOLE_IRQn, CONF_CONSOLE_Handler);
+		HOST_REG(p_usart->US_CSR) = 0;
+	}
+	HOST_REG(p_usart->US_IMR) &= ~p_usart->US_IDR;
+	p_usart->US_IDR = 0;
+	host_unlock();
+
+	return ul_sent;
+}
+
+static void test_writer_task(void *pv_param)
+{
+	gs_ul_written = console_write(gs_pattern, sizeof(gs_pattern));
+	xSemaphoreGive(gs_x_done);
+	vTaskDelete(NULL);
+}
+
+/**
+ * \brief A task writing more than the ring holds sleeps until the
+ * interrupt drains it, instead of feeding the USART itself.
+ */
+static void test_write_wait(void)
+{
+	console_stats_t stats;
+	uint32_t ul_irqs = 0;
+	uint32_t i;
+
+	for (i = 0; i < sizeof(gs_pattern); i++) {
+		gs_pattern[i] = (uint8_t)(i * 7 + (i >> 8));
+	}
+	gs_ul_wire = 0;
+	xTaskCreate(test_writer_task, "writer", configMINIMAL_STACK_SIZE, NULL,
+			1, NULL);
+
+	vTaskDelay(20);
+	console_get_stats(&stats);
+	TEST_CHECK_EQ(stats.ul_tx_bytes, 0);
+	TEST_CHECK_EQ(console_tx_free(), 0);
+	TEST_CHECK_EQ(gs_ul_tx_waiters, 1);
+
+	while (xSemaphoreTake(gs_x_done, 1) != pdTRUE && ul_irqs < 1000) {
+		if (test_usart_tx()) {
+			ul_irqs++;
+		}
+	}
+	test_usart_tx();
+
+	TEST_CHECK_EQ(gs_ul_written, sizeof(gs_pattern));
+	TEST_CHECK_EQ(gs_ul_wire, sizeof(gs_pattern));
+	TEST_CHECK(memcmp(gs_wire, gs_pattern, sizeof(gs_pattern)) == 0);
+	/* One wake-up per interrupt at most, each refilling half the ring. */
+	TEST_CHECK(ul_irqs <= 2 * TEST_WRITE_LEN / CONF_CONSOLE_TX_BUFFER_SIZE);
+	TEST_CHECK_EQ(gs_ul_tx_waiters, 0);
+	console_get_stats(&stats);
+	TEST_CHECK_EQ(stats.ul_tx_dropped, 0);
+}
+
+/**
+ * \brief While the ring is held, writes leave the TXRDY interrupt off and
+ * console_tx_poll() moves what the USART accepts; the release gives the
+ * rest back to the interrupt.
+ */
+static void test_hold(void)
+{
+	Usart *p_usart = (Usart *)CONF_UART;
+
+	console_tx_hold(true);
+	TEST_CHECK_EQ(console_write(gs_pattern, 100), 100);
+	TEST_CHECK_EQ(test_usart_tx(), 0);
+	TEST_CHECK_EQ(p_usart->US_IMR & US_IMR_TXRDY, 0);
+
+	HOST_REG(p_usart->US_CSR) = 0;
+	TEST_CHECK_EQ(console_tx_poll(), 0);
+	/* The model takes every byte while TXRDY is set. */
+	HOST_REG(p_usart->US_CSR) = US_CSR_TXRDY;
+	TEST_CHECK_EQ(console_tx_poll(), 100);
+	TEST_CHECK_EQ(p_usart->US_THR, gs_pattern[99]);
+	TEST_CHECK_EQ(console_tx_free(), CONF_CONSOLE_TX_BUFFER_SIZE);
+
+	/* A task finding the ring full feeds the USART itself, the rest stays
+	 * queued. */
+	TEST_CHECK_EQ(console_write(gs_pattern, CONF_CONSOLE_TX_BUFFER_SIZE +
+			100), CONF_CONSOLE_TX_BUFFER_SIZE + 100);
+	HOST_REG(p_usart->US_CSR) = 0;
+	TEST_CHECK_EQ(gs_ul_tx_waiters, 0);
+	TEST_CHECK_EQ(console_tx_free(), CONF_CONSOLE_TX_BUFFER_SIZE - 100);
+	TEST_CHECK_EQ(test_usart_tx(), 0);
+
+	gs_ul_wire = 0;
+	console_tx_hold(false);
+	TEST_CHECK_EQ(test_usart_tx(), 100);
+	TEST_CHECK_EQ(console_tx_free(), CONF_CONSOLE_TX_BUFFER_SIZE);
+	TEST_CHECK(memcmp(gs_wire, &gs_pattern[CONF_CONSOLE_TX_BUFFER_SIZE],
+			100) == 0);
+}
+
+static void test_tlm_task(void *pv_param)
+{
+	uint8_t uc_payload[CONF_TLM_MAX_PAYLOAD];
+	uint32_t ul_state = (uint32_t)(uintptr_t)pv_param;
+	uint32_t i;
+
+	for (i = 0; i < TEST_RECORDS; i++) {
+		memset(uc_payload, (int)i, sizeof(uc_payload));
+		/* Both CRCs. */
+		tlm_send(TLM_TYPE_USER, uc_payload,
+				(i & 1) ? CONF_TLM_MAX_PAYLOAD : 8);
+		if ((test_rand(&ul_state) & 7) == 0) {
+			vTaskDelay(1);
+		}
+	}
+	xSemaphoreGive(gs_x_done);
+	vTaskDelete(NULL);
+}
+
+/**
+ * \brief Frames sent by concurrent tasks reach the wire whole and in
+ * sequence order, with a gap for each frame dropped.
+ */
+static void test_tlm_order(void)
+{
+	uint8_t uc_frame[TLM_HEADER_SIZE + CONF_TLM_MAX_PAYLOAD + 4];
+	tlm_stats_t stats;
+	uint32_t ul_done = 0;
+	uint32_t ul_frames = 0;
+	uint32_t ul_seq = 0;
+	uint32_t ul_start = 0;
+	uint32_t ul_len;
+	uint32_t i;
+	bool b_ok = true;
+
+	tlm_init();
+	gs_ul_wire = 0;
+	xTaskCreate(test_tlm_task, "tlm1", configMINIMAL_STACK_SIZE,
+			(void *)1, 1, NULL);
+	xTaskCreate(test_tlm_task, "tlm2", configMINIMAL_STACK_SIZE,
+			(void *)2, 2, NULL);
+	while (ul_done < 2) {
+		if (xSemaphoreTake(gs_x_done, 1) == pdTRUE) {
+			ul_done++;
+		}
+		test_usart_tx();
+	}
+	test_usart_tx();
+	TEST_CHECK(gs_ul_wire < sizeof(gs_wire));
+
+	for (i = 0; i < gs_ul_wire && b_ok; i++) {
+		if (gs_wire[i] != COBS_DELIMITER) {
+			continue;
+		}
+		if (i > ul_start) {
+			ul_len = cobs_decode(&gs_wire[ul_start], i - ul_start,
+					uc_frame);
+			b_ok = TEST_CHECK(ul_len > TLM_HEADER_SIZE);
+			if (b_ok && (uc_frame[1] & TLM_FLAG_CRC32)) {
+				b_ok = TEST_CHECK_EQ(crc32_update(0, uc_frame, ul_len - 4),
+						uc_frame[ul_len - 4] | uc_frame[ul_len - 3] << 8 |
+						uc_frame[ul_len - 2] << 16 |
+						(uint32_t)uc_frame[ul_len - 1] << 24);
+			} else if (b_ok) {
+				b_ok = TEST_CHECK_EQ(crc16_update(0, uc_frame, ul_len - 2),
+						uc_frame[ul_len - 2] | uc_frame[ul_len - 1] << 8);
+			}
+			if (b_ok) {
+				b_ok = TEST_CHECK(
+						(uint32_t)(uc_frame[2] | uc_frame[3] << 8) >= ul_seq);
+				ul_seq = (uc_frame[2] | uc_frame[3] << 8) + 1;
+				ul_frames++;
+			}
+		}
+		ul_start = i + 1;
+	}
+
+	tlm_get_stats(&stats);
+	TEST_CHECK_EQ(ul_frames, stats.ul_sent);
+	TEST_CHECK_EQ(stats.ul_sent + stats.ul_dropped, 2 * TEST_RECORDS);
+	TEST_CHECK(stats.ul_sent > 0);
+}
+
+int main(void)
+{
+	gs_x_done = xSemaphoreCreateCounting(2, 0);
+	console_init();
+	if (!TEST_CHECK(gs_x_done != NULL) || !TEST_CHECK(gs_x_tx_room != NULL)) {
+		return test_end("console");
+	}
+
+	test_write_wait();
+	test_hold();
+	test_tlm_order();
+	return test_end("console");
+}
@@ -0,0 +1,576 @@
+/**
+ * \file
+ *
+ * \brief Host test of the DMA buffers, against a model of the data cache
+ * that flags the transfers missing their cache maintenance.
+ *
+ */
+
+/*
+ * The model runs at each access to the SCB: the maintenance loops write
+ * one line address per access, and the model applies the previous write
+ * before the next one lands.
+ */
+static SCB_Type *test_scb(void);
+#undef SCB
+#define SCB                 test_scb()
+
+#include <asf.h>
+#include <malloc.h>
+#include <string.h>
+/* dma_buf.c is built into the test, for its maintenance to reach the model. */
+#include "dma_buf.c"
+#include "test.h"
+
+/** Lines the model caches at most. */
+#define TEST_LINES          512
+
+/** Maintenance register with no write pending. */
+#define TEST_NO_OP          0xFFFFFFFFu
+
+/** A line of the write-back, write-allocate data cache. */
+struct test_line {
+	uint32_t ul_addr;
+	bool b_dirty;
+	/** Memory was written by the DMA since the line was filled. */
+	bool b_stale;
+	uint8_t uc_data[DCACHE_LINE_SIZE];
+};
+
+static struct test_line gs_lines[TEST_LINES];
+static uint32_t gs_ul_lines;
+
+/** What the model flagged, and the maintenance it saw. */
+static struct {
+	/** The DMA read memory under a dirty line: a clean was missing. */
+	uint32_t ul_stale_dma_reads;
+	/** The DMA wrote memory under a dirty line, which will be evicted over
+	 * it: a clean and invalidate was missing. */
+	uint32_t ul_dirty_dma_writes;
+	/** The CPU read a line filled before the DMA wrote the memory: an
+	 * invalidate was missing. */
+	uint32_t ul_stale_cpu_reads;
+	/** A dirty line was discarded by an invalidate. */
+	uint32_t ul_lost_writes;
+	uint32_t ul_ops;
+} gs_model;
+
+/**
+ * \brief Find the line of an address in the cache.
+ */
+static struct test_line *test_line_find(uint32_t ul_addr)
+{
+	uint32_t i;
+
+	ul_addr &= ~(DCACHE_LINE_SIZE - 1);
+	for (i = 0; i < gs_ul_lines; i++) {
+		if (gs_lines[i].ul_addr == ul_addr) {
+			return &gs_lines[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * \brief Drop a line from the cache, writing it back first if asked.
+ */
+static void test_line_drop(struct test_line *p_line, bool b_write_back)
+{
+	if (p_line->b_dirty && b_write_back) {
+		memcpy((void *)(uintptr_t)p_line->ul_addr, p_line->uc_data,
+				DCACHE_LINE_SIZE);
+	} else if (p_line->b_dirty) {
+		gs_model.ul_lost_writes++;
+	}
+	*p_line = gs_lines[--gs_ul_lines];
+}
+
+/**
+ * \brief Apply the maintenance writes left in the SCB.
+ */
+static void test_cache_ops(void)
+{
+	SCB_Type *p_scb = &host_scb;
+	struct test_line *p_line;
+
+	if (p_scb->DCCMVAC != TEST_NO_OP) {
+		p_line = test_line_find(p_scb->DCCMVAC);
+		if (p_line && p_line->b_dirty) {
+			memcpy((void *)(uintptr_t)p_line->ul_addr, p_line->uc_data,
+					DCACHE_LINE_SIZE);
+			p_line->b_dirty = false;
+		}
+		p_scb->DCCMVAC = TEST_NO_OP;
+		gs_model.ul_ops++;
+	}
+	if (p_scb->DCIMVAU != TEST_NO_OP) {
+		p_line = test_line_find(p_scb->DCIMVAU);
+		if (p_line) {
+			test_line_drop(p_line, false);
+		}
+		p_scb->DCIMVAU = TEST_NO_OP;
+		gs_model.ul_ops++;
+	}
+	if (p_scb->DCCIMVAC != TEST_NO_OP) {
+		p_line = test_line_find(p_scb->DCCIMVAC);
+		if (p_line) {
+			test_line_drop(p_line, true);
+		}
+		p_scb->DCCIMVAC = TEST_NO_OP;
+		gs_model.ul_ops++;
+	}
+}
+
+static SCB_Type *test_scb(void)
+{
+	test_cache_ops();
+	return &host_scb;
+}
+
+/**
+ * \brief Tell whether the CPU accesses an address through the cache: the
+ * cache is on and no MPU region maps it non-cacheable.
+ */
+static bool test_cacheable(uint32_t ul_addr)
+{
+	uint32_t ul_rasr = MPU->RASR;
+	uint32_t ul_base = MPU->RBAR & MPU_RBAR_ADDR_Msk;
+	uint32_t ul_size = 2u << ((ul_rasr & MPU_RASR_SIZE_Msk) >>
+			MPU_RASR_SIZE_Pos);
+
+	if (!(host_scb.CCR & SCB_CCR_DC_Msk)) {
+		return false;
+	}
+	if ((MPU->CTRL & MPU_CTRL_ENABLE_Msk) && (ul_rasr & MPU_RASR_ENABLE_Msk) &&
+			ul_addr - ul_base < ul_size) {
+		/* Normal memory, TEX 1, C 0, B 0: not cached. */
+		return (ul_rasr & (MPU_RASR_TEX_Msk | MPU_RASR_C_Msk |
+				MPU_RASR_B_Msk)) != (1u << MPU_RASR_TEX_Pos);
+	}
+	return true;
+}
+
+/**
+ * \brief Bring a line into the cache.
+ */
+static struct test_line *test_line_fill(uint32_t ul_addr)
+{
+	struct test_line *p_line = test_line_find(ul_addr);
+
+	if (p_line) {
+		return p_line;
+	}
+	if (gs_ul_lines == TEST_LINES) {
+		test_line_drop(&gs_lines[0], true);
+	}
+	p_line = &gs_lines[gs_ul_lines++];
+	p_line->ul_addr = ul_addr & ~(DCACHE_LINE_SIZE - 1);
+	p_line->b_dirty = false;
+	p_line->b_stale = false;
+	memcpy(p_line->uc_data, (void *)(uintptr_t)p_line->ul_addr,
+			DCACHE_LINE_SIZE);
+	return p_line;
+}
+
+/**
+ * \brief CPU store, through the cache.
+ */
+static void test_cpu_write(volatile void *p_buf, const void *p_src,
+		size_t ul_len)
+{
+	uint32_t ul_addr = (uint32_t)(uintptr_t)p_buf;
+	struct test_line *p_line;
+	size_t i;
+
+	test_cache_ops();
+	for (i = 0; i < ul_len; i++) {
+		if (!test_cacheable(ul_addr + i)) {
+			((volatile uint8_t *)p_buf)[i] = ((const uint8_t *)p_src)[i];
+			continue;
+		}
+		p_line = test_line_fill(ul_addr + i);
+		p_line->uc_data[(ul_addr + i) % DCACHE_LINE_SIZE] =
+				((const uint8_t *)p_src)[i];
+		p_line->b_dirty = true;
+	}
+}
+
+/**
+ * \brief CPU load, through the cache.
+ */
+static void test_cpu_read(const volatile void *p_buf, void *p_dst,
+		size_t ul_len)
+{
+	uint32_t ul_addr = (uint32_t)(uintptr_t)p_buf;
+	struct test_line *p_line;
+	size_t i;
+
+	test_cache_ops();
+	for (i = 0; i < ul_len; i++) {
+		if (!test_cacheable(ul_addr + i)) {
+			((uint8_t *)p_dst)[i] = ((const volatile uint8_t *)p_buf)[i];
+			continue;
+		}
+		p_line = test_line_fill(ul_addr + i);
+		if (p_line->b_stale) {
+			gs_model.ul_stale_cpu_reads++;
+			p_line->b_stale = false;
+		}
+		((uint8_t *)p_dst)[i] =
+				p_line->uc_data[(ul_addr + i) % DCACHE_LINE_SIZE];
+	}
+}
+
+/**
+ * \brief DMA read of memory, past the cache.
+ */
+static void test_dma_read(const volatile void *p_buf, void *p_dst,
+		size_t ul_len)
+{
+	uint32_t ul_addr = (uint32_t)(uintptr_t)p_buf;
+	struct test_line *p_line;
+	size_t i;
+
+	test_cache_ops();
+	for (i = 0; i < ul_len; i++) {
+		p_line = test_line_find(ul_addr + i);
+		if (p_line && p_line->b_dirty) {
+			gs_model.ul_stale_dma_reads++;
+		}
+		((uint8_t *)p_dst)[i] = ((const volatile uint8_t *)p_buf)[i];
+	}
+}
+
+/**
+ * \brief DMA write of memory, past the cache.
+ */
+static void test_dma_write(volatile void *p_buf, const void *p_src,
+		size_t ul_len)
+{
+	uint32_t ul_addr = (uint32_t)(uintptr_t)p_buf;
+	struct test_line *p_line;
+	size_t i;
+
+	test_cache_ops();
+	for (i = 0; i < ul_len; i++) {
+		p_line = test_line_find(ul_addr + i);
+		if (p_line && p_line->b_dirty) {
+			gs_model.ul_dirty_dma_writes++;
+		}
+		if (p_line) {
+			p_line->b_stale = true;
+		}
+		((volatile uint8_t *)p_buf)[i] = ((const uint8_t *)p_src)[i];
+	}
+}
+
+/**
+ * \brief Lines the CPU may fetch on its own, speculatively, while the DMA
+ * owns a buffer.
+ */
+static void test_speculate(const volatile void *p_buf, size_t ul_len)
+{
+	uint32_t ul_addr = (uint32_t)(uintptr_t)p_buf;
+	size_t i;
+
+	test_cache_ops();
+	for (i = 0; i < ul_len; i += DCACHE_LINE_SIZE) {
+		if (test_cacheable(ul_addr + i)) {
+			test_line_fill(ul_addr + i);
+		}
+	}
+}
+
+/**
+ * \brief Evict every line, as the cache may at any time.
+ */
+static void test_evict_all(void)
+{
+	test_cache_ops();
+	while (gs_ul_lines) {
+		test_line_drop(&gs_lines[0], true);
+	}
+}
+
+/**
+ * \brief Start over with an empty cache and nothing flagged.
+ */
+static void test_model_reset(void)
+{
+	test_evict_all();
+	memset(&gs_model, 0, sizeof(gs_model));
+}
+
+/**
+ * \brief Whether the model flagged anything.
+ */
+static uint32_t test_model_flags(void)
+{
+	test_cache_ops();
+	return gs_model.ul_stale_dma_reads + gs_model.ul_dirty_dma_writes +
+			gs_model.ul_stale_cpu_reads + gs_model.ul_lost_writes;
+}
+
+static void test_fill(uint8_t *p_data, size_t ul_len, uint8_t uc_seed)
+{
+	size_t i;
+
+	for (i = 0; i < ul_len; i++) {
+		p_data[i] = (uint8_t)(uc_seed + i * 13);
+	}
+}
+
+/**
+ * \brief The pool is mapped non-cacheable by its own MPU region, the
+ * default map left everywhere else.
+ */
+static void test_init(void)
+{
+	uint32_t ul_rasr = MPU->RASR;
+
+	TEST_CHECK_EQ(MPU->RBAR & MPU_RBAR_ADDR_Msk, (uint32_t)gs_pool);
+	TEST_CHECK_EQ(2u << ((ul_rasr & MPU_RASR_SIZE_Msk) >> MPU_RASR_SIZE_Pos),
+			CONF_DMA_BUF_NOCACHE_SIZE);
+	TEST_CHECK(ul_rasr & MPU_RASR_ENABLE_Msk);
+	TEST_CHECK(ul_rasr & MPU_RASR_XN_Msk);
+	TEST_CHECK(MPU->CTRL & MPU_CTRL_ENABLE_Msk);
+	TEST_CHECK(MPU->CTRL & MPU_CTRL_PRIVDEFENA_Msk);
+	TEST_CHECK(!test_cacheable((uint32_t)gs_pool));
+	TEST_CHECK(!test_cacheable((uint32_t)gs_pool + sizeof(gs_pool) - 1));
+	TEST_CHECK(test_cacheable((uint32_t)gs_pool + sizeof(gs_pool)));
+}
+
+/**
+ * \brief Pool and heap allocations: line aligned, padded to whole lines,
+ * first fit in the pool, NULL when out of room.
+ */
+static void test_alloc(void)
+{
+	void *p_buf[DMA_BUF_LINES];
+	uint8_t *p_a;
+	uint8_t *p_b;
+	uint32_t i;
+
+	TEST_CHECK(dma_buf_alloc(0, DMA_BUF_NOCACHE) == NULL);
+	TEST_CHECK(dma_buf_alloc(CONF_DMA_BUF_NOCACHE_SIZE + 1,
+			DMA_BUF_NOCACHE) == NULL);
+
+	p_a = dma_buf_alloc(1, DMA_BUF_NOCACHE);
+	p_b = dma_buf_alloc(DCACHE_LINE_SIZE + 1, DMA_BUF_NOCACHE);
+	TEST_CHECK(p_a == gs_pool);
+	TEST_CHECK(p_b == gs_pool + DCACHE_LINE_SIZE);
+	TEST_CHECK(dma_buf_is_coherent(p_a) && dma_buf_is_coherent(p_b));
+	dma_buf_free(p_a);
+	/* The freed line goes to the next one that fits. */
+	p_a = dma_buf_alloc(DCACHE_LINE_SIZE, DMA_BUF_NOCACHE);
+	TEST_CHECK(p_a == gs_pool);
+	dma_buf_free(p_a);
+	dma_buf_free(p_b);
+
+	for (i = 0; i < DMA_BUF_LINES; i++) {
+		p_buf[i] = dma_buf_alloc(DCACHE_LINE_SIZE, DMA_BUF_NOCACHE);
+		TEST_CHECK(p_buf[i] == gs_pool + i * DCACHE_LINE_SIZE);
+	}
+	TEST_CHECK(dma_buf_alloc(1, DMA_BUF_NOCACHE) == NULL);
+	dma_buf_free(p_buf[3]);
+	dma_buf_free(p_buf[4]);
+	TEST_CHECK(dma_buf_alloc(2 * DCACHE_LINE_SIZE + 1, DMA_BUF_NOCACHE) ==
+			NULL);
+	TEST_CHECK(dma_buf_alloc(2 * DCACHE_LINE_SIZE, DMA_BUF_NOCACHE) ==
+			p_buf[3]);
+	for (i = 0; i < DMA_BUF_LINES; i++) {
+		dma_buf_free(p_buf[i]);
+	}
+	TEST_CHECK(dma_buf_alloc(CONF_DMA_BUF_NOCACHE_SIZE, DMA_BUF_NOCACHE) ==
+			gs_pool);
+	dma_buf_free(gs_pool);
+
+	for (i = 1; i < 200; i += 37) {
+		p_a = dma_buf_alloc(i, DMA_BUF_CACHED);
+		if (TEST_CHECK(p_a != NULL)) {
+			TEST_CHECK_EQ((uintptr_t)p_a % DCACHE_LINE_SIZE, 0);
+			TEST_CHECK(malloc_usable_size(p_a) >= DCACHE_ROUNDUP(i));
+			TEST_CHECK(!dma_buf_is_coherent(p_a));
+		}
+		dma_buf_free(p_a);
+	}
+	dma_buf_free(NULL);
+}
+
+/**
+ * \brief A transfer each way on a buffer: the CPU fills it for the DMA,
+ * then the DMA fills it for the CPU, with the sync calls of the
+ * directions, or some of them left out. The CPU fetches the lines of the
+ * buffer speculatively while the DMA writes it.
+ *
+ * \return Whether both transfers carried the data, on the model.
+ */
+static bool test_transfer(uint8_t *p_buf, size_t ul_len, bool b_to_device,
+		bool b_from_device, bool b_for_cpu)
+{
+	uint8_t uc_out[256] = { 0 };
+	uint8_t uc_in[256] = { 0 };
+	bool b_ok;
+
+	/* The CPU was using the buffer, and left dirty lines. */
+	test_fill(uc_out, ul_len, 0x11);
+	test_cpu_write(p_buf, uc_out, ul_len);
+
+	/* Out. */
+	test_fill(uc_out, ul_len, 0x5A);
+	test_cpu_write(p_buf, uc_out, ul_len);
+	if (b_to_device) {
+		dma_buf_sync_for_device(p_buf, ul_len, DMA_BUF_TO_DEVICE);
+	}
+	test_dma_read(p_buf, uc_in, ul_len);
+	b_ok = memcmp(uc_in, uc_out, ul_len) == 0;
+	dma_buf_sync_for_cpu(p_buf, ul_len, DMA_BUF_TO_DEVICE);
+
+	/* The CPU reads the buffer meanwhile, then touches it again. */
+	test_cpu_read(p_buf, uc_in, ul_len);
+	test_cpu_write(p_buf, uc_out, 1);
+
+	/* In. */
+	if (b_from_device) {
+		dma_buf_sync_for_device(p_buf, ul_len, DMA_BUF_FROM_DEVICE);
+	}
+	test_fill(uc_out, ul_len, 0xC3);
+	test_dma_write(p_buf, uc_out, ul_len / 2);
+	test_speculate(p_buf, ul_len);
+	test_dma_write(p_buf + ul_len / 2, uc_out + ul_len / 2,
+			ul_len - ul_len / 2);
+	if (b_for_cpu) {
+		dma_buf_sync_for_cpu(p_buf, ul_len, DMA_BUF_FROM_DEVICE);
+	}
+	test_cpu_read(p_buf, uc_in, ul_len);
+	b_ok = b_ok && memcmp(uc_in, uc_out, ul_len) == 0;
+
+	/* The lines left in the cache may go back any time. */
+	test_evict_all();
+	memcpy(uc_in, p_buf, ul_len);
+	return b_ok && memcmp(uc_in, uc_out, ul_len) == 0;
+}
+
+/**
+ * \brief Buffers from both places carry the data with the sync calls, and
+ * the pool needs no maintenance.
+ */
+static void test_coherency(void)
+{
+	static const size_t ul_lens[] = { 1, 31, 32, 33, 100, 256 };
+	uint8_t *p_buf;
+	uint32_t i;
+
+	for (i = 0; i < sizeof(ul_lens) / sizeof(ul_lens[0]); i++) {
+		p_buf = dma_buf_alloc(ul_lens[i], DMA_BUF_CACHED);
+		test_model_reset();
+		TEST_CHECK(test_transfer(p_buf, ul_lens[i], true, true, true));
+		TEST_CHECK_EQ(test_model_flags(), 0);
+		TEST_CHECK(gs_model.ul_ops > 0);
+		dma_buf_free(p_buf);
+
+		p_buf = dma_buf_alloc(ul_lens[i], DMA_BUF_NOCACHE);
+		test_model_reset();
+		TEST_CHECK(test_transfer(p_buf, ul_lens[i], false, false, false));
+		TEST_CHECK(test_transfer(p_buf, ul_lens[i], true, true, true));
+		TEST_CHECK_EQ(test_model_flags(), 0);
+		TEST_CHECK_EQ(gs_model.ul_ops, 0);
+		dma_buf_free(p_buf);
+	}
+}
+
+/**
+ * \brief The model flags each sync call left out on a cached buffer.
+ */
+static void test_missing(void)
+{
+	uint8_t *p_buf = dma_buf_alloc(64, DMA_BUF_CACHED);
+
+	test_model_reset();
+	TEST_CHECK(!test_transfer(p_buf, 64, false, true, true));
+	TEST_CHECK(gs_model.ul_stale_dma_reads > 0);
+
+	test_model_reset();
+	test_transfer(p_buf, 64, true, false, true);
+	TEST_CHECK(gs_model.ul_dirty_dma_writes > 0);
+
+	test_model_reset();
+	TEST_CHECK(!test_transfer(p_buf, 64, true, true, false));
+	TEST_CHECK(gs_model.ul_stale_cpu_reads > 0);
+
+	dma_buf_free(p_buf);
+}
+
+/**
+ * \brief The padding keeps the maintenance of a buffer off its neighbours:
+ * dirty data next to a pool-sized heap buffer survives its transfers,
+ * where a buffer sharing their line loses it.
+ */
+static void test_padding(void)
+{
+	static uint8_t uc_shared[2 * DCACHE_LINE_SIZE] DCACHE_ALIGNED;
+	uint8_t *p_buf = dma_buf_alloc(40, DMA_BUF_CACHED);
+	uint8_t uc_data[DCACHE_LINE_SIZE];
+	uint8_t uc_byte = 0x77;
+
+	test_fill(uc_data, sizeof(uc_data), 0x21);
+
+	/* A buffer of the service: no line shared. */
+	test_model_reset();
+	test_cpu_write(p_buf + DCACHE_ROUNDUP(40) - 1, &uc_byte, 1);
+	dma_buf_sync_for_device(p_buf, 40, DMA_BUF_FROM_DEVICE);
+	test_dma_write(p_buf, uc_data, sizeof(uc_data));
+	dma_buf_sync_for_cpu(p_buf, 40, DMA_BUF_FROM_DEVICE);
+	TEST_CHECK_EQ(test_model_flags(), 0);
+
+	/* Ten bytes of another object after a 22 byte buffer in one line: the
+	 * invalidate of the buffer drops them. */
+	test_model_reset();
+	dma_buf_sync_for_device(uc_shared, 22, DMA_BUF_FROM_DEVICE);
+	test_dma_write(uc_shared, uc_data, 22);
+	test_cpu_write(uc_shared + 25, &uc_byte, 1);
+	dma_buf_sync_for_cpu(uc_shared, 22, DMA_BUF_FROM_DEVICE);
+	TEST_CHECK_EQ(test_model_flags(), 1);
+	TEST_CHECK_EQ(gs_model.ul_lost_writes, 1);
+
+	dma_buf_free(p_buf);
+}
+
+/**
+ * \brief With the cache off, or in the DTCM, everything is coherent.
+ */
+static void test_uncached(void)
+{
+	uint8_t *p_buf = dma_buf_alloc(64, DMA_BUF_CACHED);
+
+	TEST_CHECK(dma_buf_is_coherent((void *)DTCM_START_ADDRESS));
+	TEST_CHECK(dma_buf_is_coherent((void *)DTCM_END_ADDRESS));
+	TEST_CHECK(!dma_buf_is_coherent((void *)(DTCM_END_ADDRESS + 1)));
+
+	host_scb.CCR &= ~SCB_CCR_DC_Msk;
+	TEST_CHECK(dma_buf_is_coherent(p_buf));
+	test_model_reset();
+	TEST_CHECK(test_transfer(p_buf, 64, true, true, true));
+	TEST_CHECK_EQ(test_model_flags(), 0);
+	TEST_CHECK_EQ(gs_model.ul_ops, 0);
+	host_scb.CCR |= SCB_CCR_DC_Msk;
+
+	dma_buf_free(p_buf);
+}
+
+int main(void)
+{
+	host_scb.DCCMVAC = TEST_NO_OP;
+	host_scb.DCIMVAU = TEST_NO_OP;
+	host_scb.DCCIMVAC = TEST_NO_OP;
+	host_scb.CCR |= SCB_CCR_DC_Msk;
+	dma_buf_init();
+
+	test_init();
+	test_alloc();
+	test_coherency();
+	test_missing();
+	test_padding();
+	test_uncached();
+	return test_end("dma_buf");
+}
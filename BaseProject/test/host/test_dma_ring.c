@@ -0,0 +1,476 @@
+/**
+ * \file
+ *
+ * \brief Host test of the DMA block ring through its two drivers,
+ * adc_stream and parcap, against models of the XDMAC, AFEC, TC and PIO
+ * capture registers.
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+#include "afec.h"
+#include "xdmac.h"
+#include "clock_scale.h"
+#include "conf_adc_stream.h"
+#include "conf_parcap.h"
+#include "adc_stream.h"
+#include "parcap.h"
+#include "test.h"
+
+#define TEST_MCK_HZ         150000000u
+#define TEST_RATE_HZ        100000u
+#define TEST_CHANNELS       ((1u << 0) | (1u << 5))
+#define TEST_TASK_BLOCKS    50
+
+/** Channels of TEST_CHANNELS, in conversion order. */
+static const uint32_t gs_ul_channels[] = { 0, 5 };
+
+/* Clock scaling, as clock_scale.c would do it for the drivers. */
+static uint32_t gs_ul_mck = TEST_MCK_HZ;
+static struct clock_scale_notifier *gs_p_notifier;
+
+uint32_t clock_scale_get_peripheral_hz(void)
+{
+	return gs_ul_mck;
+}
+
+void clock_scale_register(struct clock_scale_notifier *p_notifier)
+{
+	gs_p_notifier = p_notifier;
+}
+
+/**
+ * \brief Switch the peripheral clock, around the notifications.
+ */
+static void test_clock_switch(uint32_t ul_mck)
+{
+	clock_scale_freq_t freq = { 0 };
+
+	freq.ul_mck_hz = ul_mck;
+	gs_p_notifier->callback(CLOCK_SCALE_PRE_CHANGE, &freq,
+			gs_p_notifier->p_ctx);
+	gs_ul_mck = ul_mck;
+	gs_p_notifier->callback(CLOCK_SCALE_POST_CHANGE, &freq,
+			gs_p_notifier->p_ctx);
+}
+
+/** XDMAC model: one channel, following its descriptor list. */
+typedef struct test_dma {
+	uint32_t ul_ch;
+	const lld_view1 *p_desc;
+	/** Data units written so far, for the peripheral model. */
+	uint32_t ul_units;
+} test_dma_t;
+
+static test_dma_t gs_adc_dma;
+static test_dma_t gs_cap_dma;
+
+/**
+ * \brief Find the channel a driver has programmed for a peripheral, and
+ * start at its first descriptor.
+ *
+ * \return true if one channel was found, enabled, with a descriptor list.
+ */
+static bool test_dma_start(test_dma_t *p_dma, uint32_t ul_perid)
+{
+	uint32_t ul_ch;
+
+	for (ul_ch = 0; ul_ch < XDMACCHID_NUMBER; ul_ch++) {
+		XdmacChid *p_chid = &XDMAC->XDMAC_CHID[ul_ch];
+
+		if (p_chid->XDMAC_CNDC && ((p_chid->XDMAC_CC & XDMAC_CC_PERID_Msk) ==
+				XDMAC_CC_PERID(ul_perid))) {
+			p_dma->ul_ch = ul_ch;
+			p_dma->p_desc = (const lld_view1 *)(uintptr_t)
+					(p_chid->XDMAC_CNDA & ~3u);
+			return TEST_CHECK(XDMAC->XDMAC_GE & (XDMAC_GE_EN0 << ul_ch));
+		}
+	}
+	return TEST_CHECK(!"channel programmed");
+}
+
+/**
+ * \brief Fill blocks as the channel would, with the units of a peripheral
+ * model, and leave the destination address on the next block.
+ */
+static void test_dma_fill(test_dma_t *p_dma, uint32_t ul_blocks,
+		uint32_t (*unit)(uint32_t ul_index), uint32_t ul_width)
+{
+	while (ul_blocks--) {
+		uint8_t *p_da = (uint8_t *)(uintptr_t)p_dma->p_desc->mbr_da;
+		uint32_t ul_len = p_dma->p_desc->mbr_ubc & XDMAC_UBC_UBLEN_Msk;
+		uint32_t i;
+
+		for (i = 0; i < ul_len; i++) {
+			uint32_t ul_unit = unit(p_dma->ul_units++);
+
+			memcpy(p_da + i * ul_width, &ul_unit, ul_width);
+		}
+		p_dma->p_desc = (const lld_view1 *)(uintptr_t)p_dma->p_desc->mbr_nda;
+	}
+	XDMAC->XDMAC_CHID[p_dma->ul_ch].XDMAC_CDA = p_dma->p_desc->mbr_da;
+}
+
+/**
+ * \brief Raise the channel interrupt, with the sources the driver enabled.
+ */
+static void test_dma_irq(test_dma_t *p_dma, uint32_t ul_cis)
+{
+	XdmacChid *p_chid = &XDMAC->XDMAC_CHID[p_dma->ul_ch];
+
+	HOST_REG(XDMAC->XDMAC_GIM) = XDMAC_GIM_IM0 << p_dma->ul_ch;
+	HOST_REG(XDMAC->XDMAC_GIS) = XDMAC_GIS_IS0 << p_dma->ul_ch;
+	HOST_REG(p_chid->XDMAC_CIM) = p_chid->XDMAC_CIE;
+	HOST_REG(p_chid->XDMAC_CIS) = ul_cis;
+	host_irq(XDMAC_IRQn, XDMAC_Handler);
+	HOST_REG(p_chid->XDMAC_CIS) = 0;
+	HOST_REG(XDMAC->XDMAC_GIS) = 0;
+}
+
+/** Synthetic input of a channel, 12-bit: a sine on 0, a ramp on 5. */
+static uint32_t test_wave(uint32_t ul_channel, uint32_t ul_seq)
+{
+	if (ul_channel == 0) {
+		return (uint32_t)lrint(2048 + 2000 * sin(2 * M_PI * ul_seq / 64));
+	}
+	return (ul_seq * 7) & 0xFFF;
+}
+
+/**
+ * \brief AFEC model: tagged AFEC_LCDR of every conversion, the enabled
+ * channels converted in order at each trigger.
+ */
+static uint32_t test_afec_lcdr(uint32_t ul_index)
+{
+	uint32_t ul_count = sizeof(gs_ul_channels) / sizeof(gs_ul_channels[0]);
+	uint32_t ul_channel = gs_ul_channels[ul_index % ul_count];
+
+	return (ul_channel << AFEC_LCDR_CHNB_Pos) |
+			test_wave(ul_channel, ul_index / ul_count);
+}
+
+/** PIO capture model: one byte per sample. */
+static uint32_t test_pio_pcrhr(uint32_t ul_index)
+{
+	return (ul_index * 13 + (ul_index >> 8)) & 0xFF;
+}
+
+/**
+ * \brief Fill blocks of samples and raise one interrupt for them all.
+ */
+static void test_adc_blocks(uint32_t ul_blocks)
+{
+	test_dma_fill(&gs_adc_dma, ul_blocks, test_afec_lcdr, 4);
+	test_dma_irq(&gs_adc_dma, XDMAC_CIS_BIS);
+}
+
+/**
+ * \brief Check a block against the AFEC model.
+ */
+static bool test_adc_block_ok(const adc_stream_block_t *p_block)
+{
+	uint32_t i;
+
+	if (!TEST_CHECK_EQ(p_block->ul_count, CONF_ADC_STREAM_BLOCK_SIZE)) {
+		return false;
+	}
+	for (i = 0; i < p_block->ul_count; i++) {
+		if (!TEST_CHECK_EQ(p_block->p_samples[i], test_afec_lcdr(
+				p_block->ul_seq * CONF_ADC_STREAM_BLOCK_SIZE + i))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * \brief Check the rate reported against the timer registers, and the
+ * rate requested.
+ */
+static void test_adc_rate(uint32_t ul_mck)
+{
+	static const uint32_t ul_div[] = { 8, 32, 128 };
+	TcChannel *p_tc = &TC0->TC_CHANNEL[CONF_ADC_STREAM_TC_CHANNEL];
+	uint32_t ul_clks = (p_tc->TC_CMR & TC_CMR_TCCLKS_Msk) -
+			TC_CMR_TCCLKS_TIMER_CLOCK2;
+
+	if (!TEST_CHECK(ul_clks < sizeof(ul_div) / sizeof(ul_div[0]))) {
+		return;
+	}
+	TEST_CHECK_EQ(adc_stream_get_rate(), ul_mck / ul_div[ul_clks] /
+			p_tc->TC_RC);
+	TEST_CHECK_NEAR(adc_stream_get_rate(), TEST_RATE_HZ, TEST_RATE_HZ / 200);
+}
+
+/**
+ * \brief Registers programmed by adc_stream_start(), and the rate kept
+ * over a clock switch.
+ */
+static void test_adc_setup(void)
+{
+	TcChannel *p_tc = &TC0->TC_CHANNEL[CONF_ADC_STREAM_TC_CHANNEL];
+	const lld_view1 *p_desc;
+	uint32_t i;
+
+	TEST_CHECK(!adc_stream_start(0, TEST_RATE_HZ));
+	/* 2 channels above the conversion rate of the AFE clock. */
+	TEST_CHECK(!adc_stream_start(TEST_CHANNELS, CONF_ADC_STREAM_AFEC_CLOCK /
+			AFEC_CONVERSION_CLOCKS));
+	if (!TEST_CHECK(adc_stream_start(TEST_CHANNELS, TEST_RATE_HZ))) {
+		return;
+	}
+	TEST_CHECK(!adc_stream_start(TEST_CHANNELS, TEST_RATE_HZ));
+	if (!test_dma_start(&gs_adc_dma, XDMAC_PERID_AFEC0)) {
+		return;
+	}
+
+	/* TIOA rises on RA and falls on RC, which sets the rate. */
+	TEST_CHECK(p_tc->TC_CMR & TC_CMR_WAVE);
+	TEST_CHECK_EQ(p_tc->TC_CMR & TC_CMR_WAVSEL_Msk, TC_CMR_WAVSEL_UP_RC);
+	TEST_CHECK_EQ(p_tc->TC_RA, p_tc->TC_RC / 2);
+	test_adc_rate(TEST_MCK_HZ);
+	TEST_CHECK_EQ(AFEC0->AFEC_MR & AFEC_MR_TRGSEL_Msk,
+			AFEC_TRIG_TIO_CH_0 & AFEC_MR_TRGSEL_Msk);
+	TEST_CHECK(AFEC0->AFEC_EMR & AFEC_EMR_TAG);
+
+	/* One descriptor per block, in a loop, from AFEC_LCDR. */
+	p_desc = gs_adc_dma.p_desc;
+	for (i = 0; i < CONF_ADC_STREAM_BLOCKS; i++) {
+		TEST_CHECK_EQ(p_desc->mbr_sa, (uint32_t)&AFEC0->AFEC_LCDR);
+		TEST_CHECK_EQ(p_desc->mbr_ubc & XDMAC_UBC_UBLEN_Msk,
+				CONF_ADC_STREAM_BLOCK_SIZE);
+		TEST_CHECK(p_desc->mbr_ubc & XDMAC_UBC_NDE_FETCH_EN);
+		p_desc = (const lld_view1 *)(uintptr_t)p_desc->mbr_nda;
+	}
+	TEST_CHECK(p_desc == gs_adc_dma.p_desc);
+	TEST_CHECK_EQ(XDMAC->XDMAC_CHID[gs_adc_dma.ul_ch].XDMAC_CC &
+			XDMAC_CC_DWIDTH_Msk, XDMAC_CC_DWIDTH_WORD);
+
+	/* The timer is stopped over the switch, then set for the new clock. */
+	test_clock_switch(TEST_MCK_HZ / 2);
+	test_adc_rate(TEST_MCK_HZ / 2);
+	TEST_CHECK(p_tc->TC_CCR & TC_CCR_SWTRG);
+	test_clock_switch(TEST_MCK_HZ);
+}
+
+/**
+ * \brief Blocks in order, several per interrupt, dropped when the reader
+ * falls behind and reported when overwritten while held.
+ */
+static void test_adc_ring(void)
+{
+	adc_stream_stats_t stats;
+	adc_stream_stats_t start;
+	adc_stream_block_t block;
+	uint32_t ul_seq;
+
+	adc_stream_get_stats(&start);
+	TEST_CHECK(!adc_stream_get_block(&block, 0));
+
+	test_adc_blocks(1);
+	if (!TEST_CHECK(adc_stream_get_block(&block, 0))) {
+		return;
+	}
+	ul_seq = block.ul_seq;
+	test_adc_block_ok(&block);
+	TEST_CHECK(!adc_stream_get_block(&block, 0));
+	TEST_CHECK(adc_stream_release_block());
+
+	/* Three blocks between two interrupts: the address tells. */
+	test_adc_blocks(3);
+	while (adc_stream_get_block(&block, 0)) {
+		TEST_CHECK_EQ(block.ul_seq, ++ul_seq);
+		test_adc_block_ok(&block);
+		TEST_CHECK(adc_stream_release_block());
+	}
+	TEST_CHECK_EQ(ul_seq, start.ul_blocks + 3);
+
+	/* A full ring: the DMA writes one, the reader sees the others. */
+	test_adc_blocks(CONF_ADC_STREAM_BLOCKS - 1);
+	test_adc_blocks(2);
+	adc_stream_get_stats(&stats);
+	TEST_CHECK_EQ(stats.ul_dropped - start.ul_dropped, 2);
+	TEST_CHECK(adc_stream_get_block(&block, 0));
+	TEST_CHECK_EQ(block.ul_seq, ul_seq + 3);
+	test_adc_block_ok(&block);
+	TEST_CHECK(adc_stream_release_block());
+	ul_seq = stats.ul_blocks - 1;
+	while (adc_stream_get_block(&block, 0)) {
+		adc_stream_release_block();
+	}
+	TEST_CHECK_EQ(block.ul_seq, ul_seq);
+
+	/* The held block comes round to the DMA again. */
+	test_adc_blocks(1);
+	TEST_CHECK(adc_stream_get_block(&block, 0));
+	test_adc_blocks(CONF_ADC_STREAM_BLOCKS - 1);
+	TEST_CHECK(!adc_stream_release_block());
+	while (adc_stream_get_block(&block, 0)) {
+		TEST_CHECK(adc_stream_release_block());
+	}
+
+	/* Peripheral and DMA errors, no block. */
+	HOST_REG(AFEC0->AFEC_ISR) = AFEC_ISR_GOVRE;
+	test_dma_irq(&gs_adc_dma, XDMAC_CIE_RBIE);
+	HOST_REG(AFEC0->AFEC_ISR) = 0;
+	adc_stream_get_stats(&stats);
+	TEST_CHECK_EQ(stats.ul_overruns - start.ul_overruns, 1);
+	TEST_CHECK_EQ(stats.ul_errors - start.ul_errors, 1);
+	TEST_CHECK_EQ(stats.ul_blocks - start.ul_blocks,
+			9 + CONF_ADC_STREAM_BLOCKS);
+	TEST_CHECK(!adc_stream_get_block(&block, 0));
+}
+
+/**
+ * \brief One channel of the blocks, scaled, into DSP blocks.
+ */
+static void test_adc_dsp_fill(void)
+{
+	static float32_t f_data[CONF_DSP_BLOCK_SIZE];
+	uint32_t ul_per_block = CONF_ADC_STREAM_BLOCK_SIZE /
+			(sizeof(gs_ul_channels) / sizeof(gs_ul_channels[0]));
+	dsp_block_t block = { .p_data = f_data };
+	uint32_t ul_seq = gs_adc_dma.ul_units / CONF_ADC_STREAM_BLOCK_SIZE *
+			ul_per_block;
+	uint32_t ul_blocks;
+	uint32_t i;
+	uint32_t n;
+
+	ul_blocks = (3 * CONF_DSP_BLOCK_SIZE + ul_per_block - 1) / ul_per_block;
+	if (!TEST_CHECK(ul_blocks < CONF_ADC_STREAM_BLOCKS)) {
+		return;
+	}
+	test_adc_blocks(ul_blocks);
+	for (n = 0; n < 3; n++) {
+		if (!TEST_CHECK(adc_stream_dsp_fill(&block, (void *)5))) {
+			return;
+		}
+		TEST_CHECK_EQ(block.ul_len, CONF_DSP_BLOCK_SIZE);
+		TEST_CHECK_EQ(block.ul_tag, 5);
+		for (i = 0; i < block.ul_len; i++) {
+			if (!TEST_CHECK_NEAR(f_data[i],
+					((int32_t)test_wave(5, ul_seq++) - 2048) / 2048.0,
+					1e-6)) {
+				return;
+			}
+		}
+	}
+	adc_stream_stop();
+}
+
+static SemaphoreHandle_t gs_x_done;
+static uint32_t gs_ul_task_blocks;
+
+/** Reader task, woken by the interrupt. */
+static void test_reader_task(void *p_arg)
+{
+	adc_stream_block_t block;
+
+	while (gs_ul_task_blocks < TEST_TASK_BLOCKS) {
+		if (!adc_stream_get_block(&block, portMAX_DELAY)) {
+			break;
+		}
+		test_adc_block_ok(&block);
+		TEST_CHECK(adc_stream_release_block());
+		gs_ul_task_blocks++;
+	}
+	xSemaphoreGive(gs_x_done);
+	vTaskDelete(NULL);
+}
+
+/**
+ * \brief A task waits for the blocks, as the interrupts come, after a
+ * restart.
+ */
+static void test_adc_task(void)
+{
+	adc_stream_stats_t start;
+	adc_stream_stats_t stats;
+	uint32_t n;
+
+	if (!TEST_CHECK(adc_stream_start(TEST_CHANNELS, TEST_RATE_HZ)) ||
+			!test_dma_start(&gs_adc_dma, XDMAC_PERID_AFEC0)) {
+		return;
+	}
+	adc_stream_get_stats(&start);
+
+	gs_x_done = xSemaphoreCreateBinary();
+	xTaskCreate(test_reader_task, "reader", configMINIMAL_STACK_SIZE, NULL,
+			1, NULL);
+	for (n = 0; n < TEST_TASK_BLOCKS; n++) {
+		test_adc_blocks(1);
+		vTaskDelay(1);
+	}
+	TEST_CHECK(xSemaphoreTake(gs_x_done, 1000) == pdTRUE);
+	adc_stream_get_stats(&stats);
+	TEST_CHECK_EQ(gs_ul_task_blocks, TEST_TASK_BLOCKS);
+	TEST_CHECK_EQ(stats.ul_dropped, start.ul_dropped);
+	adc_stream_stop();
+}
+
+/**
+ * \brief The ring behind parcap: half-word units, a block per interrupt or
+ * two.
+ */
+static void test_parcap(void)
+{
+	parcap_block_t block;
+	parcap_stats_t stats;
+	uint32_t ul_seq;
+	uint32_t i;
+
+	if (!TEST_CHECK(parcap_start(PIO_PCMR_DSIZE_HALFWORD, PIO_PCMR_ALWYS)) ||
+			!test_dma_start(&gs_cap_dma, XDMAC_PERID_PIOA)) {
+		return;
+	}
+	TEST_CHECK_EQ(gs_cap_dma.p_desc->mbr_sa, (uint32_t)&PIOA->PIO_PCRHR);
+	TEST_CHECK_EQ(gs_cap_dma.p_desc->mbr_ubc & XDMAC_UBC_UBLEN_Msk,
+			CONF_PARCAP_BLOCK_SIZE / 2);
+	TEST_CHECK_EQ(XDMAC->XDMAC_CHID[gs_cap_dma.ul_ch].XDMAC_CC &
+			XDMAC_CC_DWIDTH_Msk, XDMAC_CC_DWIDTH_HALFWORD);
+	TEST_CHECK(PIOA->PIO_PCMR & PIO_PCMR_PCEN);
+
+	for (ul_seq = 0; ul_seq < 6; ul_seq++) {
+		if (ul_seq % 2 == 0) {
+			test_dma_fill(&gs_cap_dma, ul_seq ? 2 : 1, test_pio_pcrhr, 2);
+			test_dma_irq(&gs_cap_dma, XDMAC_CIS_BIS);
+		}
+		if (ul_seq == 1) {
+			continue;
+		}
+		if (!TEST_CHECK(parcap_get_block(&block, 0))) {
+			return;
+		}
+		TEST_CHECK_EQ(block.ul_seq, ul_seq ? ul_seq - 1 : 0);
+		TEST_CHECK_EQ(block.ul_size, CONF_PARCAP_BLOCK_SIZE);
+		for (i = 0; i < block.ul_size / 2; i++) {
+			uint16_t us_unit;
+
+			memcpy(&us_unit, block.p_data + 2 * i, 2);
+			if (!TEST_CHECK_EQ(us_unit, test_pio_pcrhr(block.ul_seq *
+					CONF_PARCAP_BLOCK_SIZE / 2 + i))) {
+				break;
+			}
+		}
+		TEST_CHECK(parcap_release_block());
+	}
+	parcap_get_stats(&stats);
+	TEST_CHECK_EQ(stats.ul_blocks, 5);
+	TEST_CHECK_EQ(stats.ul_dropped, 0);
+	parcap_stop();
+	TEST_CHECK(!(PIOA->PIO_PCMR & PIO_PCMR_PCEN));
+}
+
+int main(void)
+{
+	test_adc_setup();
+	test_adc_ring();
+	test_adc_dsp_fill();
+	test_adc_task();
+	test_parcap();
+	return test_end("dma_ring");
+}
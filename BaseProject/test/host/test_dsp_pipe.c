@@ -0,0 +1,246 @@
+/**
+ * \file
+ *
+ * \brief Host test of the DSP pipelines: block pool, queues, stage tasks
+ * and their profile, with the reference kernels of dsp_ref.c.
+ *
+ */
+
+#include <string.h>
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "dsp_pipe.h"
+#include "dsp_stages.h"
+#include "test.h"
+
+#define TEST_TAPS       5
+#define TEST_BLOCKS     40
+#define TEST_QUEUE_LEN  2
+
+static const float32_t gs_f_taps[TEST_TAPS] = {
+	0.1f, 0.2f, 0.4f, 0.2f, 0.1f
+};
+static float32_t gs_f_fir_state[DSP_FIR_STATE_LEN(TEST_TAPS)];
+
+/** Input of the FIR pipeline, and what its sink received. */
+static float32_t gs_f_in[TEST_BLOCKS * CONF_DSP_BLOCK_SIZE];
+static float32_t gs_f_out[TEST_BLOCKS * CONF_DSP_BLOCK_SIZE];
+static uint32_t gs_ul_out_len;
+
+static SemaphoreHandle_t gs_x_done;
+
+static dsp_pipe_t gs_fir_pipe;
+static dsp_fir_t gs_fir;
+static dsp_sink_t gs_fir_sink;
+
+static dsp_pipe_t gs_isr_pipe;
+static dsp_sink_t gs_isr_sink;
+static dsp_block_t *gs_p_isr_block;
+static uint32_t gs_ul_isr_tags;
+
+static void test_fir_consume(const dsp_block_t *p_block, void *p_ctx)
+{
+	memcpy(&gs_f_out[gs_ul_out_len], p_block->p_data,
+			p_block->ul_len * sizeof(float32_t));
+	gs_ul_out_len += p_block->ul_len;
+	xSemaphoreGive(gs_x_done);
+}
+
+static void test_isr_consume(const dsp_block_t *p_block, void *p_ctx)
+{
+	gs_ul_isr_tags += p_block->ul_tag;
+	xSemaphoreGive(gs_x_done);
+}
+
+/** Stands for a DMA completion interrupt handing its block over. */
+static void test_isr(void)
+{
+	BaseType_t x_woken = pdFALSE;
+
+	dsp_pipe_push_from_isr(&gs_isr_pipe, gs_p_isr_block, &x_woken);
+}
+
+/**
+ * \brief Wait for the pool to get all its blocks back, the sinks freeing
+ * theirs after the callback.
+ */
+static bool test_pool_settled(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < 1000; i++) {
+		if (dsp_pool_get_free() == CONF_DSP_POOL_BLOCKS) {
+			return true;
+		}
+		vTaskDelay(1);
+	}
+	return false;
+}
+
+/**
+ * \brief The pool needs no set up, and counts its low water mark.
+ */
+static void test_pool(void)
+{
+	dsp_block_t *ap_blocks[CONF_DSP_POOL_BLOCKS];
+	uint32_t i;
+
+	TEST_CHECK_EQ(dsp_pool_get_free(), CONF_DSP_POOL_BLOCKS);
+	for (i = 0; i < CONF_DSP_POOL_BLOCKS; i++) {
+		ap_blocks[i] = dsp_block_alloc();
+		if (!TEST_CHECK(ap_blocks[i] != NULL)) {
+			return;
+		}
+		TEST_CHECK_EQ(((uintptr_t)ap_blocks[i]->p_data) % 32, 0);
+		TEST_CHECK_EQ(ap_blocks[i]->ul_len, 0);
+		TEST_CHECK_EQ(ap_blocks[i]->uc_format, DSP_FORMAT_F32);
+		ap_blocks[i]->ul_tag = i + 1;
+	}
+	TEST_CHECK(dsp_block_alloc() == NULL);
+	TEST_CHECK_EQ(dsp_pool_get_free(), 0);
+	for (i = 0; i < CONF_DSP_POOL_BLOCKS; i++) {
+		dsp_block_free(ap_blocks[i]);
+	}
+	dsp_block_free(NULL);
+	TEST_CHECK_EQ(dsp_pool_get_free(), CONF_DSP_POOL_BLOCKS);
+	TEST_CHECK_EQ(dsp_pool_get_min_free(), 0);
+
+	/* Blocks given back come out reset, with their own storage. */
+	ap_blocks[0] = dsp_block_alloc();
+	ap_blocks[1] = dsp_block_alloc();
+	TEST_CHECK(ap_blocks[0] != ap_blocks[1]);
+	TEST_CHECK(ap_blocks[0]->p_data != ap_blocks[1]->p_data);
+	TEST_CHECK_EQ(ap_blocks[0]->ul_tag, 0);
+	dsp_block_free(ap_blocks[0]);
+	dsp_block_free(ap_blocks[1]);
+}
+
+/**
+ * \brief A FIR pipeline fed block by block gives the filter of the whole
+ * signal, and profiles its stages.
+ */
+static void test_fir_pipe(void)
+{
+	uint32_t ul_state = 1;
+	dsp_block_t *p_block;
+	double d_err = 0;
+	double d_ref;
+	uint32_t i;
+	uint32_t j;
+
+	for (i = 0; i < TEST_BLOCKS * CONF_DSP_BLOCK_SIZE; i++) {
+		gs_f_in[i] = (float32_t)test_rand_unit(&ul_state);
+	}
+
+	TEST_CHECK(dsp_pipe_init(&gs_fir_pipe, "fir", TEST_QUEUE_LEN));
+	/* No stage, no task. */
+	TEST_CHECK(!dsp_pipe_start(&gs_fir_pipe, 1, 256));
+	dsp_fir_init(&gs_fir, "fir", gs_f_taps, TEST_TAPS, gs_f_fir_state);
+	dsp_sink_init(&gs_fir_sink, "out", test_fir_consume, NULL);
+	dsp_pipe_add(&gs_fir_pipe, &gs_fir.stage);
+	dsp_pipe_add(&gs_fir_pipe, &gs_fir_sink.stage);
+	TEST_CHECK(dsp_pipe_start(&gs_fir_pipe, 1, 256));
+	TEST_CHECK(dsp_pipe_get(0) == &gs_fir_pipe);
+
+	for (i = 0; i < TEST_BLOCKS; i++) {
+		p_block = dsp_block_alloc();
+		if (!TEST_CHECK(p_block != NULL)) {
+			return;
+		}
+		memcpy(p_block->p_data, &gs_f_in[i * CONF_DSP_BLOCK_SIZE],
+				sizeof(float32_t) * CONF_DSP_BLOCK_SIZE);
+		p_block->ul_len = CONF_DSP_BLOCK_SIZE;
+		/* Never more blocks in flight than the queue holds. */
+		TEST_CHECK(dsp_pipe_push(&gs_fir_pipe, p_block));
+		TEST_CHECK(xSemaphoreTake(gs_x_done, 1000) == pdPASS);
+	}
+	TEST_CHECK(test_pool_settled());
+	TEST_CHECK_EQ(gs_ul_out_len, TEST_BLOCKS * CONF_DSP_BLOCK_SIZE);
+	TEST_CHECK_EQ(gs_fir_pipe.ul_dropped, 0);
+
+	for (i = 0; i < gs_ul_out_len; i++) {
+		d_ref = 0;
+		for (j = 0; j < TEST_TAPS && j <= i; j++) {
+			d_ref += gs_f_taps[j] * gs_f_in[i - j];
+		}
+		if (d_ref - gs_f_out[i] > d_err) {
+			d_err = d_ref - gs_f_out[i];
+		} else if (gs_f_out[i] - d_ref > d_err) {
+			d_err = gs_f_out[i] - d_ref;
+		}
+	}
+	TEST_CHECK_NEAR(d_err, 0, 1e-6);
+
+	TEST_CHECK_EQ(gs_fir.stage.stats.ul_calls, TEST_BLOCKS);
+	TEST_CHECK_EQ(gs_fir_sink.stage.stats.ul_calls, TEST_BLOCKS);
+	TEST_CHECK_EQ(gs_fir.stage.stats.ul_dropped, 0);
+	TEST_CHECK(gs_fir.stage.stats.ul_cycles_max >=
+			gs_fir.stage.stats.ul_cycles_last);
+	TEST_CHECK(gs_fir.stage.stats.ull_cycles_total >=
+			gs_fir.stage.stats.ul_cycles_max);
+
+	dsp_pipe_reset_stats(&gs_fir_pipe);
+	TEST_CHECK_EQ(gs_fir.stage.stats.ul_calls, 0);
+	TEST_CHECK_EQ(gs_fir.stage.stats.ull_cycles_total, 0);
+	TEST_CHECK_EQ(gs_fir_sink.stage.stats.ul_calls, 0);
+}
+
+/**
+ * \brief Blocks pushed past a full queue are dropped and go back to the
+ * pool; blocks pushed from an interrupt get through.
+ */
+static void test_isr_pipe(void)
+{
+	dsp_block_t *p_block;
+	uint32_t i;
+
+	TEST_CHECK(dsp_pipe_init(&gs_isr_pipe, "isr", TEST_QUEUE_LEN));
+	dsp_sink_init(&gs_isr_sink, "tags", test_isr_consume, NULL);
+	dsp_pipe_add(&gs_isr_pipe, &gs_isr_sink.stage);
+
+	/* Not started yet: the queue fills up. */
+	for (i = 0; i < TEST_QUEUE_LEN + 1; i++) {
+		gs_p_isr_block = dsp_block_alloc();
+		if (!TEST_CHECK(gs_p_isr_block != NULL)) {
+			return;
+		}
+		gs_p_isr_block->ul_tag = 1u << i;
+		host_irq(XDMAC_IRQn, test_isr);
+	}
+	TEST_CHECK_EQ(gs_isr_pipe.ul_dropped, 1);
+	TEST_CHECK_EQ(dsp_pool_get_free(),
+			CONF_DSP_POOL_BLOCKS - TEST_QUEUE_LEN);
+
+	TEST_CHECK(dsp_pipe_start(&gs_isr_pipe, 1, 256));
+	TEST_CHECK(dsp_pipe_get(1) == &gs_isr_pipe);
+	TEST_CHECK(dsp_pipe_get(CONF_DSP_MAX_PIPES) == NULL);
+	for (i = 0; i < TEST_QUEUE_LEN; i++) {
+		TEST_CHECK(xSemaphoreTake(gs_x_done, 1000) == pdPASS);
+	}
+	TEST_CHECK(test_pool_settled());
+	/* The first blocks, not the dropped one. */
+	TEST_CHECK_EQ(gs_ul_isr_tags, (1u << TEST_QUEUE_LEN) - 1);
+
+	/* The pool low water mark still shows the first test. */
+	TEST_CHECK_EQ(dsp_pool_get_min_free(), 0);
+
+	p_block = dsp_block_alloc();
+	p_block->ul_tag = 0x100;
+	TEST_CHECK(dsp_pipe_push(&gs_isr_pipe, p_block));
+	TEST_CHECK(xSemaphoreTake(gs_x_done, 1000) == pdPASS);
+	TEST_CHECK_EQ(gs_ul_isr_tags, 0x100 + (1u << TEST_QUEUE_LEN) - 1);
+	TEST_CHECK(test_pool_settled());
+}
+
+int main(void)
+{
+	gs_x_done = xSemaphoreCreateCounting(TEST_BLOCKS, 0);
+	if (!TEST_CHECK(gs_x_done != NULL)) {
+		return test_end("dsp_pipe");
+	}
+
+	test_pool();
+	test_fir_pipe();
+	test_isr_pipe();
+	return test_end("dsp_pipe");
+}
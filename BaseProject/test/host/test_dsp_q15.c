@@ -0,0 +1,497 @@
+/**
+ * \file
+ *
+ * \brief Host test of the Q15 pipeline stages against the float ones.
+ *
+ * The packed arithmetic of dsp_simd.h is checked against plain 64-bit
+ * arithmetic, then each Q15 stage is fed the same signal as its float
+ * counterpart and the signal to noise ratio of its output, taking the
+ * float output as the signal, is checked and printed with the throughput
+ * of both. The host builds the C versions of dsp_simd.h and the reference
+ * kernels of dsp_ref.c, whose arm_rfft_q15() computes in float: the power
+ * stage SNR covers the Q15 input and output, not the fixed-point FFT of
+ * CMSIS-DSP.
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+#include "dsp_pipe.h"
+#include "dsp_stages.h"
+#include "dsp_q15.h"
+#include "dsp_simd.h"
+#include "test.h"
+
+#define TEST_FIR_TAPS   32
+#define TEST_BLOCKS     8
+#define TEST_FFT_LEN    CONF_DSP_BLOCK_SIZE
+#define TEST_LEN        (TEST_BLOCKS * CONF_DSP_BLOCK_SIZE)
+
+static float32_t gs_f_taps[TEST_FIR_TAPS];
+static q15_t gs_s_taps[TEST_FIR_TAPS];
+static float32_t gs_f_fir_state[DSP_FIR_STATE_LEN(TEST_FIR_TAPS)];
+static q15_t gs_s_fir_state[DSP_FIR_Q15_STATE_LEN(TEST_FIR_TAPS)];
+
+/** Low-pass at fs / 10, Q 0.707, a1 and a2 negated. */
+static float32_t gs_f_biquad[5];
+static q15_t gs_s_biquad[5];
+static float32_t gs_f_bq_state[DSP_BIQUAD_STATE_LEN(1)];
+static q15_t gs_s_bq_state[4];
+
+static float32_t gs_f_in[TEST_LEN];
+static float32_t gs_f_ref[TEST_LEN];
+static float32_t gs_f_out[TEST_LEN];
+
+static dsp_to_q15_t gs_to_q15;
+static dsp_to_q15_t gs_to_q15_auto;
+static dsp_to_f32_t gs_to_f32;
+static dsp_fir_t gs_fir;
+static dsp_fir_q15_t gs_fir_q15;
+static dsp_biquad_t gs_biquad;
+static dsp_biquad_q15_t gs_biquad_q15;
+static dsp_fft_t gs_fft;
+static dsp_power_q15_t gs_power_q15;
+
+/** SNR of each Q15 stage, for the table. */
+static double gs_d_snr_fir;
+static double gs_d_snr_biquad;
+static double gs_d_snr_power;
+
+/**
+ * \brief Run a stage on a block holding a copy of samples.
+ *
+ * \return The output block, NULL if the stage dropped its input.
+ */
+static dsp_block_t *test_run(dsp_stage_t *p_stage, const float32_t *p_src,
+		uint32_t ul_len)
+{
+	dsp_block_t *p_block = dsp_block_alloc();
+
+	if (!TEST_CHECK(p_block != NULL)) {
+		return NULL;
+	}
+	memcpy(p_block->p_data, p_src, ul_len * sizeof(float32_t));
+	p_block->ul_len = ul_len;
+	return p_stage->process(p_stage, p_block);
+}
+
+/**
+ * \brief Run stages one after the other on a block.
+ */
+static dsp_block_t *test_chain(dsp_block_t *p_block, dsp_stage_t *const *pp,
+		uint32_t ul_stages)
+{
+	uint32_t i;
+
+	for (i = 0; i < ul_stages && p_block; i++) {
+		p_block = pp[i]->process(pp[i], p_block);
+	}
+	return p_block;
+}
+
+/**
+ * \brief Signal to noise ratio of an output, in dB, the reference taken as
+ * the signal and the difference as the noise.
+ */
+static double test_snr(const float32_t *p_ref, const float32_t *p_out,
+		uint32_t ul_len)
+{
+	double d_signal = 0.0;
+	double d_noise = 0.0;
+	uint32_t i;
+
+	for (i = 0; i < ul_len; i++) {
+		d_signal += (double)p_ref[i] * p_ref[i];
+		d_noise += ((double)p_out[i] - p_ref[i]) *
+				((double)p_out[i] - p_ref[i]);
+	}
+	if (d_noise == 0.0) {
+		return 200.0;
+	}
+	return 10.0 * log10(d_signal / d_noise);
+}
+
+/**
+ * \brief Two tones and some noise, within [-0.5, 0.5].
+ */
+static void test_signal(float32_t *p, uint32_t ul_len, uint32_t ul_seed)
+{
+	uint32_t i;
+
+	for (i = 0; i < ul_len; i++) {
+		p[i] = (float32_t)(0.3 * sin(2 * M_PI * 0.0173 * i) +
+				0.15 * sin(2 * M_PI * 0.31 * i + 1.0) +
+				0.05 * test_rand_unit(&ul_seed));
+	}
+}
+
+/**
+ * \brief The C versions of the packed instructions give the results of
+ * the instructions, extreme values included.
+ */
+static void test_simd(void)
+{
+	static const int16_t s_edges[] = { 0, 1, -1, 32767, -32768, 12345 };
+	uint32_t ul_state = 7;
+	uint32_t i;
+
+	for (i = 0; i < 10000; i++) {
+		uint32_t x = test_rand(&ul_state);
+		uint32_t y = test_rand(&ul_state);
+		int64_t ll_acc = (int64_t)test_rand(&ul_state) << 20;
+		int64_t ll_prod;
+
+		if (i < 36) {
+			x = dsp_pack((uint16_t)s_edges[i % 6], (uint16_t)s_edges[i / 6]);
+			y = dsp_pack((uint16_t)s_edges[i / 6], (uint16_t)s_edges[i % 6]);
+		}
+		ll_prod = (int64_t)(int16_t)x * (int16_t)y +
+				(int64_t)(int16_t)(x >> 16) * (int16_t)(y >> 16);
+		TEST_CHECK_EQ(dsp_smlald(x, y, ll_acc), ll_acc + ll_prod);
+		TEST_CHECK_EQ(dsp_smlad(x, y, (int32_t)ll_acc),
+				(int32_t)(uint32_t)((int32_t)ll_acc + ll_prod));
+		TEST_CHECK_EQ(dsp_smuad(x, x), (uint32_t)((int64_t)(int16_t)x *
+				(int16_t)x + (int64_t)(int16_t)(x >> 16) * (int16_t)(x >> 16)));
+		TEST_CHECK_EQ(dsp_pack(x, y), (x & 0xFFFF) | (y << 16));
+	}
+	TEST_CHECK_EQ(dsp_sat_q15(40000), 32767);
+	TEST_CHECK_EQ(dsp_sat_q15(-40000), -32768);
+	TEST_CHECK_EQ(dsp_sat_q15(-32768), -32768);
+	TEST_CHECK_EQ(dsp_sat_q15(1234), 1234);
+}
+
+/**
+ * \brief Conversions: exponents, rounding, saturation and headroom.
+ */
+static void test_convert(void)
+{
+	float32_t f_x[4] = { 0.25f, -0.5f, 0.1f, 0.0f };
+	float32_t f_back[4];
+	q15_t s_q[4];
+	uint32_t i;
+
+	TEST_CHECK_EQ(dsp_f32_exponent(f_x, 4), 0);
+	f_x[1] = -0.6f;
+	TEST_CHECK_EQ(dsp_f32_exponent(f_x, 4), 0);
+	f_x[1] = 1.0f;
+	TEST_CHECK_EQ(dsp_f32_exponent(f_x, 4), 1);
+	f_x[1] = 0.2f;
+	TEST_CHECK_EQ(dsp_f32_exponent(f_x, 4), -1);
+	TEST_CHECK_EQ(dsp_f32_exponent(&f_x[1], 2), -2);
+	TEST_CHECK_EQ(dsp_f32_exponent(&f_x[3], 1), 0);
+
+	f_x[1] = -0.5f;
+	dsp_f32_to_q15(f_x, s_q, 4, 0);
+	TEST_CHECK_EQ(s_q[0], 8192);
+	TEST_CHECK_EQ(s_q[1], -16384);
+	TEST_CHECK_EQ(s_q[2], 3277);
+	TEST_CHECK_EQ(s_q[3], 0);
+	dsp_q15_to_f32(s_q, f_back, 4, 0);
+	for (i = 0; i < 4; i++) {
+		TEST_CHECK_NEAR(f_back[i], f_x[i], 0.5 / 32768);
+	}
+	/* One bit up, half the value; past full scale, saturated. */
+	dsp_f32_to_q15(f_x, s_q, 4, 1);
+	TEST_CHECK_EQ(s_q[0], 4096);
+	dsp_f32_to_q15(f_x, s_q, 4, -2);
+	TEST_CHECK_EQ(s_q[0], 32767);
+	TEST_CHECK_EQ(s_q[1], -32768);
+	dsp_q15_to_f32(s_q, f_back, 4, -2);
+	TEST_CHECK_NEAR(f_back[1], -0.25, 1e-9);
+	TEST_CHECK_EQ(dsp_q15_headroom(s_q, 4), 0);
+	dsp_f32_to_q15(f_x, s_q, 4, 2);
+	TEST_CHECK_EQ(dsp_q15_headroom(s_q, 4), 2);
+	TEST_CHECK_EQ(dsp_q15_headroom(&s_q[3], 1), 15);
+}
+
+/**
+ * \brief FIR and biquad, over blocks: the Q15 output follows the float one
+ * within the resolution of Q15.
+ */
+static void test_filters(void)
+{
+	dsp_stage_t *ap_fir[] = {
+		&gs_to_q15.stage, &gs_fir_q15.stage, &gs_to_f32.stage
+	};
+	dsp_stage_t *ap_bq[] = {
+		&gs_to_q15.stage, &gs_biquad_q15.stage, &gs_to_f32.stage
+	};
+	dsp_block_t *p_block;
+	uint32_t ul_at;
+	uint32_t i;
+
+	test_signal(gs_f_in, TEST_LEN, 11);
+
+	for (ul_at = 0; ul_at < TEST_LEN; ul_at += CONF_DSP_BLOCK_SIZE) {
+		p_block = test_run(&gs_fir.stage, &gs_f_in[ul_at],
+				CONF_DSP_BLOCK_SIZE);
+		if (TEST_CHECK(p_block != NULL)) {
+			memcpy(&gs_f_ref[ul_at], p_block->p_data,
+					CONF_DSP_BLOCK_SIZE * sizeof(float32_t));
+			dsp_block_free(p_block);
+		}
+		p_block = test_chain(test_run(ap_fir[0], &gs_f_in[ul_at],
+				CONF_DSP_BLOCK_SIZE), &ap_fir[1], 2);
+		if (TEST_CHECK(p_block != NULL)) {
+			TEST_CHECK_EQ(p_block->uc_format, DSP_FORMAT_F32);
+			memcpy(&gs_f_out[ul_at], p_block->p_data,
+					CONF_DSP_BLOCK_SIZE * sizeof(float32_t));
+			dsp_block_free(p_block);
+		}
+	}
+	gs_d_snr_fir = test_snr(gs_f_ref, gs_f_out, TEST_LEN);
+	TEST_CHECK(gs_d_snr_fir > 70.0);
+
+	for (ul_at = 0; ul_at < TEST_LEN; ul_at += CONF_DSP_BLOCK_SIZE) {
+		p_block = test_run(&gs_biquad.stage, &gs_f_in[ul_at],
+				CONF_DSP_BLOCK_SIZE);
+		if (TEST_CHECK(p_block != NULL)) {
+			memcpy(&gs_f_ref[ul_at], p_block->p_data,
+					CONF_DSP_BLOCK_SIZE * sizeof(float32_t));
+			dsp_block_free(p_block);
+		}
+		p_block = test_chain(test_run(ap_bq[0], &gs_f_in[ul_at],
+				CONF_DSP_BLOCK_SIZE), &ap_bq[1], 2);
+		if (TEST_CHECK(p_block != NULL)) {
+			memcpy(&gs_f_out[ul_at], p_block->p_data,
+					CONF_DSP_BLOCK_SIZE * sizeof(float32_t));
+			dsp_block_free(p_block);
+		}
+	}
+	gs_d_snr_biquad = test_snr(gs_f_ref, gs_f_out, TEST_LEN);
+	TEST_CHECK(gs_d_snr_biquad > 60.0);
+
+	/* The state carries over: nothing but noise at the block edges. */
+	for (i = CONF_DSP_BLOCK_SIZE; i < TEST_LEN; i += CONF_DSP_BLOCK_SIZE) {
+		TEST_CHECK_NEAR(gs_f_out[i], gs_f_ref[i], 1e-3);
+	}
+	TEST_CHECK_EQ(dsp_pool_get_free(), CONF_DSP_POOL_BLOCKS);
+}
+
+/**
+ * \brief Power spectrum of a block scaled to its peak: the Q15 power
+ * follows the squared float magnitudes, and finds the same peak.
+ */
+static void test_power(void)
+{
+	dsp_block_t *p_block;
+	uint32_t ul_peak_ref = 0;
+	uint32_t ul_peak = 0;
+	uint32_t k;
+
+	/* Small, for the automatic exponent to scale it up: peak in
+	 * [2^-8, 2^-7). */
+	test_signal(gs_f_in, TEST_FFT_LEN, 12);
+	for (k = 0; k < TEST_FFT_LEN; k++) {
+		gs_f_in[k] *= 0.01f;
+	}
+
+	p_block = test_run(&gs_fft.stage, gs_f_in, TEST_FFT_LEN);
+	if (!TEST_CHECK(p_block != NULL)) {
+		return;
+	}
+	TEST_CHECK_EQ(p_block->ul_len, TEST_FFT_LEN / 2);
+	for (k = 0; k < TEST_FFT_LEN / 2; k++) {
+		gs_f_ref[k] = p_block->p_data[k] * p_block->p_data[k];
+	}
+	dsp_block_free(p_block);
+
+	p_block = test_run(&gs_to_q15_auto.stage, gs_f_in, TEST_FFT_LEN);
+	if (!TEST_CHECK(p_block != NULL)) {
+		return;
+	}
+	TEST_CHECK_EQ(p_block->c_exp, -7);
+	p_block = gs_power_q15.stage.process(&gs_power_q15.stage, p_block);
+	if (!TEST_CHECK(p_block != NULL)) {
+		return;
+	}
+	TEST_CHECK_EQ(p_block->ul_len, TEST_FFT_LEN / 2);
+	TEST_CHECK_EQ(p_block->uc_format, DSP_FORMAT_F32);
+	memcpy(gs_f_out, p_block->p_data, TEST_FFT_LEN / 2 * sizeof(float32_t));
+	dsp_block_free(p_block);
+
+	for (k = 1; k < TEST_FFT_LEN / 2; k++) {
+		if (gs_f_ref[k] > gs_f_ref[ul_peak_ref]) {
+			ul_peak_ref = k;
+		}
+		if (gs_f_out[k] > gs_f_out[ul_peak]) {
+			ul_peak = k;
+		}
+	}
+	TEST_CHECK_EQ(ul_peak, ul_peak_ref);
+	gs_d_snr_power = test_snr(gs_f_ref, gs_f_out, TEST_FFT_LEN / 2);
+	TEST_CHECK(gs_d_snr_power > 50.0);
+}
+
+/**
+ * \brief Each kind of stage drops the blocks of the other format.
+ */
+static void test_formats(void)
+{
+	dsp_stage_t *ap_q15[] = {
+		&gs_fir_q15.stage, &gs_biquad_q15.stage, &gs_power_q15.stage,
+		&gs_to_f32.stage
+	};
+	dsp_stage_t *ap_f32[] = {
+		&gs_fir.stage, &gs_biquad.stage, &gs_fft.stage
+	};
+	dsp_block_t *p_block;
+	uint32_t i;
+
+	for (i = 0; i < sizeof(ap_q15) / sizeof(ap_q15[0]); i++) {
+		ap_q15[i]->stats.ul_dropped = 0;
+		TEST_CHECK(test_run(ap_q15[i], gs_f_in, TEST_FFT_LEN) == NULL);
+		TEST_CHECK_EQ(ap_q15[i]->stats.ul_dropped, 1);
+	}
+	for (i = 0; i < sizeof(ap_f32) / sizeof(ap_f32[0]); i++) {
+		ap_f32[i]->stats.ul_dropped = 0;
+		p_block = test_run(&gs_to_q15.stage, gs_f_in, TEST_FFT_LEN);
+		TEST_CHECK(ap_f32[i]->process(ap_f32[i], p_block) == NULL);
+		TEST_CHECK_EQ(ap_f32[i]->stats.ul_dropped, 1);
+	}
+	gs_to_q15.stage.stats.ul_dropped = 0;
+	p_block = test_run(&gs_to_q15.stage, gs_f_in, TEST_FFT_LEN);
+	TEST_CHECK(gs_to_q15.stage.process(&gs_to_q15.stage, p_block) == NULL);
+	TEST_CHECK_EQ(gs_to_q15.stage.stats.ul_dropped, 1);
+	TEST_CHECK_EQ(dsp_pool_get_free(), CONF_DSP_POOL_BLOCKS);
+
+	/* Odd taps or shifts past Q15 are refused. */
+	TEST_CHECK(!dsp_fir_q15_init(&gs_fir_q15, "fir", gs_s_taps, 31, 0,
+			gs_s_fir_state));
+	TEST_CHECK(!dsp_fir_q15_init(&gs_fir_q15, "fir", gs_s_taps, 32, 16,
+			gs_s_fir_state));
+	TEST_CHECK(!dsp_power_q15_init(&gs_power_q15, "power", 16));
+	TEST_CHECK(!dsp_power_q15_init(&gs_power_q15, "power", 96));
+	TEST_CHECK(dsp_fir_q15_init(&gs_fir_q15, "fir", gs_s_taps,
+			TEST_FIR_TAPS, 0, gs_s_fir_state));
+	TEST_CHECK(dsp_power_q15_init(&gs_power_q15, "power", TEST_FFT_LEN));
+}
+
+/** A stage timed on blocks of one format. */
+typedef struct {
+	const char *p_name;
+	dsp_stage_t *p_stage;
+	enum dsp_format format;
+	const double *p_snr;
+} test_bench_t;
+
+static const test_bench_t gs_benches[] = {
+	{"fir f32", &gs_fir.stage, DSP_FORMAT_F32, NULL},
+	{"fir q15", &gs_fir_q15.stage, DSP_FORMAT_Q15, &gs_d_snr_fir},
+	{"biquad f32", &gs_biquad.stage, DSP_FORMAT_F32, NULL},
+	{"biquad q15", &gs_biquad_q15.stage, DSP_FORMAT_Q15, &gs_d_snr_biquad},
+	{"fft mag f32", &gs_fft.stage, DSP_FORMAT_F32, NULL},
+	{"power q15", &gs_power_q15.stage, DSP_FORMAT_Q15, &gs_d_snr_power},
+	{"to q15", &gs_to_q15.stage, DSP_FORMAT_F32, NULL},
+	{"to f32", &gs_to_f32.stage, DSP_FORMAT_Q15, NULL},
+};
+
+/**
+ * \brief Time of each stage on full blocks, with its SNR.
+ */
+static void test_throughput(void)
+{
+	static q15_t s_q15[CONF_DSP_BLOCK_SIZE];
+	uint32_t i;
+
+	test_signal(gs_f_in, CONF_DSP_BLOCK_SIZE, 13);
+	dsp_f32_to_q15(gs_f_in, s_q15, CONF_DSP_BLOCK_SIZE, 0);
+
+	printf("  %-12s %10s %12s %8s\n", "stage", "ns/block", "Msamples/s",
+			"SNR dB");
+	for (i = 0; i < sizeof(gs_benches) / sizeof(gs_benches[0]); i++) {
+		const test_bench_t *p_bench = &gs_benches[i];
+		uint32_t ul_calls = 0;
+		double f_start = test_seconds();
+		double f_time;
+
+		p_bench->p_stage->stats.ul_dropped = 0;
+		do {
+			dsp_block_t *p_block = dsp_block_alloc();
+
+			p_block->ul_len = CONF_DSP_BLOCK_SIZE;
+			p_block->uc_format = p_bench->format;
+			if (p_bench->format == DSP_FORMAT_Q15) {
+				memcpy(p_block->p_data, s_q15, sizeof(s_q15));
+			} else {
+				memcpy(p_block->p_data, gs_f_in,
+						CONF_DSP_BLOCK_SIZE * sizeof(float32_t));
+			}
+			dsp_block_free(p_bench->p_stage->process(p_bench->p_stage,
+					p_block));
+			ul_calls++;
+			f_time = test_seconds() - f_start;
+		} while (f_time < 0.1);
+		if (p_bench->p_snr) {
+			printf("  %-12s %10.0f %12.1f %8.1f\n", p_bench->p_name,
+					f_time * 1e9 / ul_calls,
+					(double)CONF_DSP_BLOCK_SIZE * ul_calls / f_time * 1e-6,
+					*p_bench->p_snr);
+		} else {
+			printf("  %-12s %10.0f %12.1f %8s\n", p_bench->p_name,
+					f_time * 1e9 / ul_calls,
+					(double)CONF_DSP_BLOCK_SIZE * ul_calls / f_time * 1e-6,
+					"-");
+		}
+		TEST_CHECK_EQ(p_bench->p_stage->stats.ul_dropped, 0);
+	}
+	TEST_CHECK_EQ(dsp_pool_get_free(), CONF_DSP_POOL_BLOCKS);
+}
+
+/**
+ * \brief Windowed sinc low-pass at fs / 8 and the RBJ biquad low-pass,
+ * float and Q15.
+ */
+static void test_setup(void)
+{
+	double d_w0 = 2 * M_PI / 10;
+	double d_alpha = sin(d_w0) / (2 * M_SQRT1_2);
+	double d_a0 = 1 + d_alpha;
+	double d_sum = 0.0;
+	uint32_t i;
+
+	for (i = 0; i < TEST_FIR_TAPS; i++) {
+		double d_t = i - (TEST_FIR_TAPS - 1) / 2.0;
+		double d_win = 0.54 - 0.46 * cos(2 * M_PI * i / (TEST_FIR_TAPS - 1));
+
+		gs_f_taps[i] = (float32_t)(sin(M_PI * d_t / 4) / (M_PI * d_t) *
+				d_win);
+		d_sum += gs_f_taps[i];
+	}
+	for (i = 0; i < TEST_FIR_TAPS; i++) {
+		gs_f_taps[i] /= (float32_t)d_sum;
+	}
+	dsp_f32_to_q15(gs_f_taps, gs_s_taps, TEST_FIR_TAPS, 0);
+
+	gs_f_biquad[0] = (float32_t)((1 - cos(d_w0)) / 2 / d_a0);
+	gs_f_biquad[1] = (float32_t)((1 - cos(d_w0)) / d_a0);
+	gs_f_biquad[2] = gs_f_biquad[0];
+	gs_f_biquad[3] = (float32_t)(2 * cos(d_w0) / d_a0);
+	gs_f_biquad[4] = (float32_t)(-(1 - d_alpha) / d_a0);
+	/* a1 is above 1: coefficients halved, post shift 1. */
+	dsp_f32_to_q15(gs_f_biquad, gs_s_biquad, 5, 1);
+
+	dsp_to_q15_init(&gs_to_q15, "to q15", 0);
+	dsp_to_q15_init(&gs_to_q15_auto, "to q15", DSP_Q15_EXP_AUTO);
+	dsp_to_f32_init(&gs_to_f32, "to f32");
+	dsp_fir_init(&gs_fir, "fir", gs_f_taps, TEST_FIR_TAPS, gs_f_fir_state);
+	TEST_CHECK(dsp_fir_q15_init(&gs_fir_q15, "fir", gs_s_taps,
+			TEST_FIR_TAPS, 0, gs_s_fir_state));
+	dsp_biquad_init(&gs_biquad, "biquad", gs_f_biquad, 1, gs_f_bq_state);
+	dsp_biquad_q15_init(&gs_biquad_q15, "biquad", gs_s_biquad, 1, 1,
+			gs_s_bq_state);
+	TEST_CHECK(dsp_fft_init(&gs_fft, "fft", TEST_FFT_LEN, true));
+	TEST_CHECK(dsp_power_q15_init(&gs_power_q15, "power", TEST_FFT_LEN));
+}
+
+int main(void)
+{
+	test_setup();
+	test_simd();
+	test_convert();
+	test_filters();
+	test_power();
+	test_formats();
+	test_throughput();
+	return test_end("dsp_q15");
+}
@@ -0,0 +1,534 @@
+/**
+ * \file
+ *
+ * \brief Agreement and throughput of the reference DSP kernels.
+ *
+ * Each kernel of dsp_ref.c is run on known vectors and on pseudo-random
+ * ones, and compared with the same computation done directly in double
+ * precision. The tolerances are those of float32_t arithmetic over the
+ * length of the sums, with a margin: the library sums in another order and
+ * lands within the same bounds. A throughput table follows.
+ *
+ */
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include "arm_math.h"
+#include "arm_const_structs.h"
+#include "conf_dsp.h"
+#include "test.h"
+
+#define TEST_FIR_TAPS     29
+#define TEST_FIR_LEN      1000
+#define TEST_DEC_M        4
+#define TEST_FFT_MAX      4096
+#define TEST_MAT_N        16
+
+/** Relative error allowed per term of a float sum. */
+#define TEST_EPS          (4.0 * FLT_EPSILON)
+
+static float32_t gs_x[TEST_FIR_LEN];
+static float32_t gs_y[TEST_FIR_LEN];
+static float32_t gs_coeffs[TEST_FIR_TAPS];
+static float32_t gs_state[TEST_FIR_TAPS + TEST_FIR_LEN];
+static float32_t gs_fft[2 * TEST_FFT_MAX];
+static float32_t gs_fft_out[2 * TEST_FFT_MAX];
+static double gs_ref[2 * TEST_FFT_MAX];
+static float32_t gs_fft_src[2 * TEST_FFT_MAX];
+static q15_t gs_q15_in[TEST_FFT_MAX];
+static q15_t gs_q15_out[2 * TEST_FFT_MAX];
+
+static const arm_cfft_instance_f32 *const gs_cffts[] = {
+	&arm_cfft_sR_f32_len16, &arm_cfft_sR_f32_len32, &arm_cfft_sR_f32_len64,
+	&arm_cfft_sR_f32_len128, &arm_cfft_sR_f32_len256,
+	&arm_cfft_sR_f32_len512, &arm_cfft_sR_f32_len1024,
+	&arm_cfft_sR_f32_len2048, &arm_cfft_sR_f32_len4096,
+};
+
+static void test_fill(float32_t *p, uint32_t ul_len, uint32_t ul_seed)
+{
+	uint32_t i;
+
+	for (i = 0; i < ul_len; i++) {
+		p[i] = (float32_t)test_rand_unit(&ul_seed);
+	}
+}
+
+/**
+ * \brief Direct FIR in double: output n of a filter whose coefficients are
+ * stored time reversed, as the library keeps them.
+ */
+static double test_fir_at(const float32_t *p_x, uint32_t n, double *p_bound)
+{
+	double f_sum = 0.0;
+	uint32_t k;
+
+	*p_bound = 0.0;
+	for (k = 0; k < TEST_FIR_TAPS; k++) {
+		int32_t l_i = (int32_t)n - (TEST_FIR_TAPS - 1) + (int32_t)k;
+
+		if (l_i >= 0) {
+			f_sum += (double)gs_coeffs[k] * p_x[l_i];
+			*p_bound += fabs((double)gs_coeffs[k] * p_x[l_i]);
+		}
+	}
+	return f_sum;
+}
+
+static void test_fir(void)
+{
+	static const uint32_t ul_pieces[] = { 1, 7, 256, 300, 436 };
+	arm_fir_instance_f32 fir;
+	uint32_t ul_done = 0;
+	uint32_t i, n;
+
+	/* The impulse response is the coefficients, in time order. */
+	test_fill(gs_coeffs, TEST_FIR_TAPS, 1);
+	arm_fir_init_f32(&fir, TEST_FIR_TAPS, gs_coeffs, gs_state,
+			TEST_FIR_LEN);
+	memset(gs_x, 0, sizeof(gs_x));
+	gs_x[0] = 1.0f;
+	arm_fir_f32(&fir, gs_x, gs_y, TEST_FIR_TAPS);
+	for (i = 0; i < TEST_FIR_TAPS; i++) {
+		TEST_CHECK(gs_y[i] == gs_coeffs[TEST_FIR_TAPS - 1 - i]);
+	}
+
+	/* Random input, in pieces of several lengths, one past the scratch. */
+	test_fill(gs_x, TEST_FIR_LEN, 2);
+	arm_fir_init_f32(&fir, TEST_FIR_TAPS, gs_coeffs, gs_state,
+			TEST_FIR_LEN);
+	for (i = 0; ul_done < TEST_FIR_LEN; i++) {
+		uint32_t ul_len = ul_pieces[i % 5];
+
+		if (ul_len > TEST_FIR_LEN - ul_done) {
+			ul_len = TEST_FIR_LEN - ul_done;
+		}
+		arm_fir_f32(&fir, gs_x + ul_done, gs_y + ul_done, ul_len);
+		ul_done += ul_len;
+	}
+	for (n = 0; n < TEST_FIR_LEN; n++) {
+		double f_bound;
+		double f_ref = test_fir_at(gs_x, n, &f_bound);
+
+		if (!TEST_CHECK_NEAR(gs_y[n], f_ref,
+				TEST_EPS * TEST_FIR_TAPS * f_bound)) {
+			break;
+		}
+	}
+}
+
+static void test_fir_decimate(void)
+{
+	arm_fir_decimate_instance_f32 dec;
+	uint32_t i;
+
+	test_fill(gs_coeffs, TEST_FIR_TAPS, 3);
+	test_fill(gs_x, TEST_FIR_LEN, 4);
+	TEST_CHECK(arm_fir_decimate_init_f32(&dec, TEST_FIR_TAPS, TEST_DEC_M,
+			gs_coeffs, gs_state, 6) == ARM_MATH_LENGTH_ERROR);
+	TEST_CHECK(arm_fir_decimate_init_f32(&dec, TEST_FIR_TAPS, TEST_DEC_M,
+			gs_coeffs, gs_state, 600) == ARM_MATH_SUCCESS);
+	arm_fir_decimate_f32(&dec, gs_x, gs_y, 600);
+	arm_fir_decimate_f32(&dec, gs_x + 600, gs_y + 600 / TEST_DEC_M, 400);
+
+	/* Output i is the full rate output i * M. */
+	for (i = 0; i < TEST_FIR_LEN / TEST_DEC_M; i++) {
+		double f_bound;
+		double f_ref = test_fir_at(gs_x, i * TEST_DEC_M, &f_bound);
+
+		if (!TEST_CHECK_NEAR(gs_y[i], f_ref,
+				TEST_EPS * TEST_FIR_TAPS * f_bound)) {
+			break;
+		}
+	}
+}
+
+/** Two sections, a 0.1 fs low pass then a 0.2 fs peak, a1 and a2 negated. */
+static float32_t gs_biquad[10] = {
+	0.0674553f, 0.1349106f, 0.0674553f, 1.1429805f, -0.4128016f,
+	1.0512474f, -0.7285318f, 0.4426043f, 0.7285318f, -0.4938517f,
+};
+
+static void test_biquad(bool b_df2t)
+{
+	arm_biquad_casd_df1_inst_f32 df1;
+	arm_biquad_cascade_df2T_instance_f32 df2t;
+	double f_x[3], f_y[3];
+	uint32_t ul_stage, n;
+	static double s_ref[TEST_FIR_LEN];
+
+	test_fill(gs_x, TEST_FIR_LEN, 5);
+	if (b_df2t) {
+		arm_biquad_cascade_df2T_init_f32(&df2t, 2, gs_biquad, gs_state);
+		arm_biquad_cascade_df2T_f32(&df2t, gs_x, gs_y, 333);
+		arm_biquad_cascade_df2T_f32(&df2t, gs_x + 333, gs_y + 333,
+				TEST_FIR_LEN - 333);
+	} else {
+		arm_biquad_cascade_df1_init_f32(&df1, 2, gs_biquad, gs_state);
+		arm_biquad_cascade_df1_f32(&df1, gs_x, gs_y, 333);
+		arm_biquad_cascade_df1_f32(&df1, gs_x + 333, gs_y + 333,
+				TEST_FIR_LEN - 333);
+	}
+
+	for (n = 0; n < TEST_FIR_LEN; n++) {
+		s_ref[n] = gs_x[n];
+	}
+	for (ul_stage = 0; ul_stage < 2; ul_stage++) {
+		const float32_t *p_c = &gs_biquad[5 * ul_stage];
+
+		memset(f_x, 0, sizeof(f_x));
+		memset(f_y, 0, sizeof(f_y));
+		for (n = 0; n < TEST_FIR_LEN; n++) {
+			f_x[2] = f_x[1];
+			f_x[1] = f_x[0];
+			f_x[0] = s_ref[n];
+			f_y[2] = f_y[1];
+			f_y[1] = f_y[0];
+			f_y[0] = p_c[0] * f_x[0] + p_c[1] * f_x[1] + p_c[2] * f_x[2] +
+					p_c[3] * f_y[1] + p_c[4] * f_y[2];
+			s_ref[n] = f_y[0];
+		}
+	}
+	/* Stable poles: the rounding noise stays near the signal epsilon. */
+	for (n = 0; n < TEST_FIR_LEN; n++) {
+		if (!TEST_CHECK_NEAR(gs_y[n], s_ref[n], 1e-5)) {
+			break;
+		}
+	}
+}
+
+/**
+ * \brief Direct DFT of ul_len complex values in double.
+ *
+ * \param l_sign -1 forward, +1 inverse.
+ */
+static void test_dft(const float32_t *p_in, double *p_out, uint32_t ul_len,
+		int l_sign, uint32_t ul_step)
+{
+	uint32_t k, n;
+
+	for (k = 0; k < ul_len; k++) {
+		double f_re = 0.0, f_im = 0.0;
+
+		for (n = 0; n < ul_len; n++) {
+			/* Exact phase: n * k taken modulo the length first. */
+			double f_a = l_sign * 2.0 * M_PI *
+					(double)((uint64_t)n * k % ul_len) / ul_len;
+			double f_xr = p_in[n * ul_step];
+			double f_xi = ul_step == 2 ? p_in[n * 2 + 1] : 0.0;
+
+			f_re += f_xr * cos(f_a) - f_xi * sin(f_a);
+			f_im += f_xr * sin(f_a) + f_xi * cos(f_a);
+		}
+		p_out[2 * k] = f_re;
+		p_out[2 * k + 1] = f_im;
+	}
+}
+
+/**
+ * \brief Largest error of ul_count values, relative to the RMS of the
+ * reference.
+ */
+static double test_rel_err(const float32_t *p_got, const double *p_ref,
+		uint32_t ul_count, double f_scale)
+{
+	double f_rms = 0.0, f_max = 0.0;
+	uint32_t i;
+
+	for (i = 0; i < ul_count; i++) {
+		f_rms += p_ref[i] * p_ref[i];
+	}
+	f_rms = sqrt(f_rms / ul_count);
+	for (i = 0; i < ul_count; i++) {
+		double f_err = fabs(p_got[i] * f_scale - p_ref[i]);
+
+		if (f_err > f_max) {
+			f_max = f_err;
+		}
+	}
+	return f_max / f_rms;
+}
+
+static void test_cfft(void)
+{
+	uint32_t i, k;
+
+	for (i = 0; i < sizeof(gs_cffts) / sizeof(gs_cffts[0]); i++) {
+		const arm_cfft_instance_f32 *p_fft = gs_cffts[i];
+		uint32_t ul_len = p_fft->fftLen;
+		double f_log2 = log2(ul_len);
+		static float32_t s_in[2 * TEST_FFT_MAX];
+
+		/* A cosine on bin 3: N/2 on bins 3 and N - 3, 0 elsewhere. */
+		for (k = 0; k < ul_len; k++) {
+			gs_fft[2 * k] = (float32_t)cos(2.0 * M_PI * 3 * k / ul_len);
+			gs_fft[2 * k + 1] = 0.0f;
+		}
+		arm_cfft_f32(p_fft, gs_fft, 0, 1);
+		for (k = 0; k < ul_len; k++) {
+			double f_want = (k == 3 || k == ul_len - 3) ? ul_len / 2.0 : 0.0;
+
+			if (!TEST_CHECK_NEAR(gs_fft[2 * k], f_want,
+					TEST_EPS * ul_len * f_log2) ||
+					!TEST_CHECK_NEAR(gs_fft[2 * k + 1], 0.0,
+					TEST_EPS * ul_len * f_log2)) {
+				break;
+			}
+		}
+
+		/* Noise, forward against the DFT, then back. */
+		test_fill(s_in, 2 * ul_len, 6 + i);
+		memcpy(gs_fft, s_in, 2 * ul_len * sizeof(float32_t));
+		arm_cfft_f32(p_fft, gs_fft, 0, 1);
+		test_dft(s_in, gs_ref, ul_len, -1, 2);
+		TEST_CHECK(test_rel_err(gs_fft, gs_ref, 2 * ul_len, 1.0) <
+				TEST_EPS * 2 * f_log2);
+
+		arm_cfft_f32(p_fft, gs_fft, 1, 1);
+		for (k = 0; k < 2 * ul_len; k++) {
+			gs_ref[k] = s_in[k];
+		}
+		TEST_CHECK(test_rel_err(gs_fft, gs_ref, 2 * ul_len, 1.0) <
+				TEST_EPS * 4 * f_log2);
+	}
+}
+
+static void test_rfft(void)
+{
+	arm_rfft_fast_instance_f32 rfft;
+	static float32_t s_in[TEST_FFT_MAX];
+	uint32_t ul_len, k;
+
+	TEST_CHECK(arm_rfft_fast_init_f32(&rfft, 16) != ARM_MATH_SUCCESS);
+	TEST_CHECK(arm_rfft_fast_init_f32(&rfft, 96) != ARM_MATH_SUCCESS);
+
+	for (ul_len = 32; ul_len <= TEST_FFT_MAX; ul_len *= 2) {
+		double f_log2 = log2(ul_len);
+
+		TEST_CHECK(arm_rfft_fast_init_f32(&rfft, ul_len) ==
+				ARM_MATH_SUCCESS);
+		test_fill(s_in, ul_len, 20 + ul_len);
+		memcpy(gs_fft, s_in, ul_len * sizeof(float32_t));
+		arm_rfft_fast_f32(&rfft, gs_fft, gs_fft_out, 0);
+
+		/* X[0] and X[N/2] real parts first, then X[1] to X[N/2 - 1]. */
+		test_dft(s_in, gs_ref, ul_len, -1, 1);
+		gs_ref[1] = gs_ref[ul_len];
+		TEST_CHECK(test_rel_err(gs_fft_out, gs_ref, ul_len, 1.0) <
+				TEST_EPS * 2 * f_log2);
+
+		arm_rfft_fast_f32(&rfft, gs_fft_out, gs_fft, 1);
+		for (k = 0; k < ul_len; k++) {
+			gs_ref[k] = s_in[k];
+		}
+		TEST_CHECK(test_rel_err(gs_fft, gs_ref, ul_len, 1.0) <
+				TEST_EPS * 4 * f_log2);
+	}
+}
+
+static void test_rfft_q15(void)
+{
+	arm_rfft_instance_q15 rfft;
+	static float32_t s_in[TEST_FFT_MAX];
+	uint32_t ul_seed = 40;
+	uint32_t ul_len, k;
+
+	TEST_CHECK(arm_rfft_init_q15(&rfft, 256, 1, 1) != ARM_MATH_SUCCESS);
+	TEST_CHECK(arm_rfft_init_q15(&rfft, 256, 0, 0) != ARM_MATH_SUCCESS);
+
+	for (ul_len = 32; ul_len <= 2048; ul_len *= 2) {
+		TEST_CHECK(arm_rfft_init_q15(&rfft, ul_len, 0, 1) ==
+				ARM_MATH_SUCCESS);
+		for (k = 0; k < ul_len; k++) {
+			/* Half scale, so that no bin of 2/N X saturates. */
+			gs_q15_in[k] = (q15_t)(test_rand(&ul_seed) % 32768 - 16384);
+			s_in[k] = gs_q15_in[k];
+		}
+		arm_rfft_q15(&rfft, gs_q15_in, gs_q15_out);
+
+		/* Every bin, conjugate upper half included, scaled by 2/N. */
+		test_dft(s_in, gs_ref, ul_len, -1, 1);
+		for (k = 0; k < 2 * ul_len; k++) {
+			if (!TEST_CHECK_NEAR(gs_q15_out[k], gs_ref[k] * 2.0 / ul_len,
+					1.0)) {
+				break;
+			}
+		}
+	}
+}
+
+static void test_mag_mat(void)
+{
+	static float32_t s_a[TEST_MAT_N * TEST_MAT_N];
+	static float32_t s_b[TEST_MAT_N * TEST_MAT_N];
+	static float32_t s_c[TEST_MAT_N * TEST_MAT_N];
+	arm_matrix_instance_f32 a, b, c;
+	uint32_t i, j, k;
+
+	/* In place, as the stages use it. */
+	test_fill(gs_fft, 512, 50);
+	for (i = 0; i < 256; i++) {
+		gs_ref[i] = hypot(gs_fft[2 * i], gs_fft[2 * i + 1]);
+	}
+	arm_cmplx_mag_f32(gs_fft, gs_fft, 256);
+	TEST_CHECK(test_rel_err(gs_fft, gs_ref, 256, 1.0) < TEST_EPS);
+
+	test_fill(s_a, TEST_MAT_N * TEST_MAT_N, 51);
+	test_fill(s_b, TEST_MAT_N * TEST_MAT_N, 52);
+	arm_mat_init_f32(&a, TEST_MAT_N, TEST_MAT_N, s_a);
+	arm_mat_init_f32(&b, TEST_MAT_N, TEST_MAT_N, s_b);
+	arm_mat_init_f32(&c, TEST_MAT_N, TEST_MAT_N, s_c);
+	TEST_CHECK(arm_mat_mult_f32(&a, &b, &c) == ARM_MATH_SUCCESS);
+	for (i = 0; i < TEST_MAT_N; i++) {
+		for (j = 0; j < TEST_MAT_N; j++) {
+			double f_sum = 0.0;
+
+			for (k = 0; k < TEST_MAT_N; k++) {
+				f_sum += (double)s_a[i * TEST_MAT_N + k] *
+						s_b[k * TEST_MAT_N + j];
+			}
+			gs_ref[i * TEST_MAT_N + j] = f_sum;
+		}
+	}
+	TEST_CHECK(test_rel_err(s_c, gs_ref, TEST_MAT_N * TEST_MAT_N, 1.0) <
+			TEST_EPS * TEST_MAT_N);
+}
+
+/*
+ * Throughput. Each kernel runs on one block for at least a tenth of a
+ * second; the table gives the time per call and the input samples per
+ * second. The float FFTs work in place, their times include copying the
+ * input back.
+ */
+
+static arm_fir_instance_f32 gs_b_fir;
+static arm_fir_decimate_instance_f32 gs_b_dec;
+static arm_biquad_casd_df1_inst_f32 gs_b_df1;
+static arm_biquad_cascade_df2T_instance_f32 gs_b_df2t;
+static arm_rfft_fast_instance_f32 gs_b_rfft;
+static arm_rfft_instance_q15 gs_b_rfft_q15;
+static arm_matrix_instance_f32 gs_b_ma, gs_b_mb, gs_b_mc;
+
+static void bench_fir(void)
+{
+	arm_fir_f32(&gs_b_fir, gs_x, gs_y, CONF_DSP_BLOCK_SIZE);
+}
+
+static void bench_dec(void)
+{
+	arm_fir_decimate_f32(&gs_b_dec, gs_x, gs_y, CONF_DSP_BLOCK_SIZE);
+}
+
+static void bench_df1(void)
+{
+	arm_biquad_cascade_df1_f32(&gs_b_df1, gs_x, gs_y, CONF_DSP_BLOCK_SIZE);
+}
+
+static void bench_df2t(void)
+{
+	arm_biquad_cascade_df2T_f32(&gs_b_df2t, gs_x, gs_y,
+			CONF_DSP_BLOCK_SIZE);
+}
+
+static void bench_cfft(void)
+{
+	memcpy(gs_fft, gs_fft_src, 2 * 256 * sizeof(float32_t));
+	arm_cfft_f32(&arm_cfft_sR_f32_len256, gs_fft, 0, 1);
+}
+
+static void bench_rfft(void)
+{
+	memcpy(gs_fft, gs_fft_src, 512 * sizeof(float32_t));
+	arm_rfft_fast_f32(&gs_b_rfft, gs_fft, gs_fft_out, 0);
+}
+
+static void bench_rfft_q15(void)
+{
+	arm_rfft_q15(&gs_b_rfft_q15, gs_q15_in, gs_q15_out);
+}
+
+static void bench_mag(void)
+{
+	arm_cmplx_mag_f32(gs_fft, gs_fft_out, CONF_DSP_BLOCK_SIZE);
+}
+
+static void bench_mat(void)
+{
+	arm_mat_mult_f32(&gs_b_ma, &gs_b_mb, &gs_b_mc);
+}
+
+typedef struct test_bench {
+	const char *p_name;
+	const char *p_size;
+	/** Input samples per call. */
+	uint32_t ul_samples;
+	void (*run)(void);
+} test_bench_t;
+
+static const test_bench_t gs_benches[] = {
+	{"fir", "29 taps", CONF_DSP_BLOCK_SIZE, bench_fir},
+	{"fir_dec", "29 taps /4", CONF_DSP_BLOCK_SIZE, bench_dec},
+	{"biquad", "df1 x2", CONF_DSP_BLOCK_SIZE, bench_df1},
+	{"biquad", "df2T x2", CONF_DSP_BLOCK_SIZE, bench_df2t},
+	{"cfft", "256", 256, bench_cfft},
+	{"rfft", "512", 512, bench_rfft},
+	{"rfft_q15", "512", 512, bench_rfft_q15},
+	{"cmplx_mag", "256", CONF_DSP_BLOCK_SIZE, bench_mag},
+	{"mat_mult", "16x16", TEST_MAT_N * TEST_MAT_N, bench_mat},
+};
+
+static void test_throughput(void)
+{
+	static float32_t s_m[3][TEST_MAT_N * TEST_MAT_N];
+	uint32_t i;
+
+	test_fill(gs_x, TEST_FIR_LEN, 60);
+	test_fill(gs_fft_src, 2 * TEST_FFT_MAX, 61);
+	memcpy(gs_fft, gs_fft_src, sizeof(gs_fft));
+	test_fill(s_m[0], TEST_MAT_N * TEST_MAT_N, 62);
+	test_fill(s_m[1], TEST_MAT_N * TEST_MAT_N, 63);
+	arm_fir_init_f32(&gs_b_fir, TEST_FIR_TAPS, gs_coeffs, gs_state,
+			CONF_DSP_BLOCK_SIZE);
+	arm_fir_decimate_init_f32(&gs_b_dec, TEST_FIR_TAPS, TEST_DEC_M,
+			gs_coeffs, gs_state, CONF_DSP_BLOCK_SIZE);
+	arm_biquad_cascade_df1_init_f32(&gs_b_df1, 2, gs_biquad, gs_state);
+	arm_biquad_cascade_df2T_init_f32(&gs_b_df2t, 2, gs_biquad, gs_state);
+	arm_rfft_fast_init_f32(&gs_b_rfft, 512);
+	arm_rfft_init_q15(&gs_b_rfft_q15, 512, 0, 1);
+	arm_mat_init_f32(&gs_b_ma, TEST_MAT_N, TEST_MAT_N, s_m[0]);
+	arm_mat_init_f32(&gs_b_mb, TEST_MAT_N, TEST_MAT_N, s_m[1]);
+	arm_mat_init_f32(&gs_b_mc, TEST_MAT_N, TEST_MAT_N, s_m[2]);
+
+	printf("  %-10s %-11s %12s %14s\n", "kernel", "size", "ns/call",
+			"Msamples/s");
+	for (i = 0; i < sizeof(gs_benches) / sizeof(gs_benches[0]); i++) {
+		const test_bench_t *p_bench = &gs_benches[i];
+		uint32_t ul_calls = 0;
+		double f_start = test_seconds();
+		double f_time;
+
+		do {
+			p_bench->run();
+			ul_calls++;
+			f_time = test_seconds() - f_start;
+		} while (f_time < 0.1);
+		printf("  %-10s %-11s %12.0f %14.1f\n", p_bench->p_name,
+				p_bench->p_size, f_time * 1e9 / ul_calls,
+				(double)p_bench->ul_samples * ul_calls / f_time * 1e-6);
+	}
+}
+
+int main(void)
+{
+	test_fir();
+	test_fir_decimate();
+	test_biquad(false);
+	test_biquad(true);
+	test_cfft();
+	test_rfft();
+	test_rfft_q15();
+	test_mag_mat();
+	test_throughput();
+	return test_end("dsp_ref");
+}
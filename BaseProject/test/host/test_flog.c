@@ -0,0 +1,645 @@
+/**
+ * \file
+ *
+ * \brief Host test of the flash log store on the flash emulator: recovery
+ * from power losses and failed commands, and write amplification.
+ *
+ * The store is built into the test, so that a reset can be played: its
+ * state is dropped and the log mounted again from the flash. The
+ * background task is not started, except by the last test; the test
+ * compacts the log as the task would.
+ *
+ */
+
+#include <string.h>
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "host_flash.h"
+#include "test.h"
+
+#define CONF_FLOG_ADDR          HOST_FLASH_ADDR
+#define FLOG_WRITE_PAGE(ul_addr, p_data) \
+	host_flash_write_page((ul_addr), (p_data))
+#define FLOG_ERASE_PAGES(ul_addr, ul_pages) \
+	host_flash_erase_pages((ul_addr), (ul_pages))
+#include "flog.c"
+
+/** Keys of the workload, 1 to TEST_KEYS - 1. */
+#define TEST_KEYS               24
+/** Longest value of the workload. */
+#define TEST_VALUE_MAX          96
+
+/**
+ * Model of the store. Each change of a key is a new version of it, and its
+ * value is made from the key and the version. Version 0 is no value.
+ *
+ * The versions set since the last flog_sync() may or may not be in the
+ * flash: after a reset, a key may hold any version from the one it had at
+ * that sync to its latest one.
+ */
+static uint32_t gs_ul_synced[TEST_KEYS];
+static uint32_t gs_ul_latest[TEST_KEYS];
+/** Events: number of the next one, and of the last one synced. */
+static uint32_t gs_ul_event_next;
+static uint32_t gs_ul_event_synced;
+static uint32_t gs_ul_rand;
+
+static uint32_t test_hash(uint32_t ul_key, uint32_t ul_version)
+{
+	uint32_t x = ul_key * 0x9E3779B1u ^ ul_version * 0x85EBCA77u;
+
+	x ^= x >> 15;
+	x *= 0x2C1B3C6Du;
+	x ^= x >> 12;
+	return x;
+}
+
+/** Whether a version of a key is a delete, or no value. */
+static bool test_is_none(uint32_t ul_key, uint32_t ul_version)
+{
+	return !ul_version || test_hash(ul_key, ul_version) % 8 == 0;
+}
+
+/**
+ * \brief Value of a version: the version, then bytes from the hash.
+ *
+ * \return Its length.
+ */
+static uint16_t test_value(uint32_t ul_key, uint32_t ul_version,
+		uint8_t *p_buf)
+{
+	uint32_t ul_hash = test_hash(ul_key, ul_version);
+	uint16_t us_len = 4 + ul_hash % (TEST_VALUE_MAX - 3);
+	uint16_t i;
+
+	memcpy(p_buf, &ul_version, 4);
+	for (i = 4; i < us_len; i++) {
+		p_buf[i] = (uint8_t)(ul_hash >> (i % 4 * 8)) ^ (uint8_t)i;
+	}
+	return us_len;
+}
+
+static void test_model_reset(void)
+{
+	memset(gs_ul_synced, 0, sizeof(gs_ul_synced));
+	memset(gs_ul_latest, 0, sizeof(gs_ul_latest));
+	gs_ul_event_next = 1;
+	gs_ul_event_synced = 0;
+	gs_ul_rand = 1;
+}
+
+/**
+ * \brief Reset: drop the state of the store, mount it again.
+ */
+static void test_reset(void)
+{
+	host_flash_disarm();
+	memset(&gs_stats, 0, sizeof(gs_stats));
+	gs_stats.ul_blocks = FLOG_BLOCKS;
+	/* The lock of the lost run may be held, as the stack is gone. */
+	gs_x_lock = xSemaphoreCreateMutex();
+	gs_x_task = NULL;
+	flog_mount();
+}
+
+/**
+ * \brief Compact as the background task would.
+ */
+static status_code_t test_gc(void)
+{
+	status_code_t status = STATUS_OK;
+	uint32_t ul_free;
+
+	xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+	while (flog_free() < CONF_FLOG_GC_FREE) {
+		ul_free = flog_free();
+		status = flog_compact();
+		if (status != STATUS_OK || flog_free() <= ul_free) {
+			break;
+		}
+	}
+	xSemaphoreGive(gs_x_lock);
+	return status;
+}
+
+static status_code_t test_sync(void)
+{
+	status_code_t status = flog_sync();
+	uint32_t i;
+
+	if (status == STATUS_OK) {
+		for (i = 0; i < TEST_KEYS; i++) {
+			gs_ul_synced[i] = gs_ul_latest[i];
+		}
+		gs_ul_event_synced = gs_ul_event_next - 1;
+	}
+	return status;
+}
+
+/**
+ * \brief One change: set or delete a key, or add an event.
+ */
+static status_code_t test_change(void)
+{
+	uint8_t auc_value[TEST_VALUE_MAX];
+	uint32_t ul_key;
+	uint32_t ul_version;
+	uint16_t us_len;
+	status_code_t status;
+
+	if (test_rand(&gs_ul_rand) % 5 == 0) {
+		memset(auc_value, 0xA5, sizeof(auc_value));
+		memcpy(auc_value, &gs_ul_event_next, 4);
+		status = flog_event(auc_value,
+				4 + gs_ul_event_next % (TEST_VALUE_MAX - 4));
+		if (status == STATUS_OK) {
+			gs_ul_event_next++;
+		}
+		return status;
+	}
+	ul_key = 1 + test_rand(&gs_ul_rand) % (TEST_KEYS - 1);
+	ul_version = gs_ul_latest[ul_key] + 1;
+	if (test_is_none(ul_key, ul_version)) {
+		status = flog_delete(ul_key);
+	} else {
+		us_len = test_value(ul_key, ul_version, auc_value);
+		status = flog_set(ul_key, auc_value, us_len);
+	}
+	if (status == STATUS_OK) {
+		gs_ul_latest[ul_key] = ul_version;
+	}
+	return status;
+}
+
+/**
+ * \brief Run changes, syncing and compacting every few.
+ */
+static bool test_workload(uint32_t ul_changes)
+{
+	uint32_t i;
+
+	for (i = 0; i < ul_changes; i++) {
+		if (!TEST_CHECK_EQ(test_change(), STATUS_OK)) {
+			return false;
+		}
+		if (test_rand(&gs_ul_rand) % 4 == 0) {
+			if (!TEST_CHECK_EQ(test_sync(), STATUS_OK) ||
+					!TEST_CHECK_EQ(test_gc(), STATUS_OK)) {
+				return false;
+			}
+		}
+	}
+	return TEST_CHECK_EQ(test_sync(), STATUS_OK);
+}
+
+struct test_events {
+	uint32_t ul_last;
+	uint32_t ul_count;
+	bool b_ok;
+};
+
+static void test_event_reader(const void *p_data, uint16_t us_len,
+		void *p_ctx)
+{
+	struct test_events *p_events = p_ctx;
+	uint32_t ul_number;
+
+	memcpy(&ul_number, p_data, 4);
+	if (us_len != 4 + ul_number % (TEST_VALUE_MAX - 4) ||
+			ul_number <= p_events->ul_last) {
+		p_events->b_ok = false;
+	}
+	p_events->ul_last = ul_number;
+	p_events->ul_count++;
+}
+
+/**
+ * \brief Check the store against the model, after a reset, and take what
+ * it holds as synced.
+ */
+static bool test_check_store(const char *p_when)
+{
+	uint8_t auc_value[TEST_VALUE_MAX];
+	uint8_t auc_expect[TEST_VALUE_MAX];
+	struct test_events events = { 0, 0, true };
+	flog_stats_t stats;
+	uint32_t ul_version;
+	uint32_t ul_key;
+	uint16_t us_len;
+	bool b_ok = true;
+
+	for (ul_key = 1; ul_key < TEST_KEYS; ul_key++) {
+		us_len = sizeof(auc_value);
+		if (!flog_get(ul_key, auc_value, &us_len)) {
+			/* The latest version of no value in the range. */
+			for (ul_version = gs_ul_latest[ul_key];
+					ul_version > gs_ul_synced[ul_key] &&
+					!test_is_none(ul_key, ul_version); ul_version--) {
+			}
+			if (!test_is_none(ul_key, ul_version)) {
+				printf("%s: key %u has no value, synced version %u\n",
+						p_when, ul_key, gs_ul_synced[ul_key]);
+				b_ok = false;
+			}
+		} else {
+			memcpy(&ul_version, auc_value, 4);
+			if (ul_version < gs_ul_synced[ul_key] ||
+					ul_version > gs_ul_latest[ul_key] ||
+					test_is_none(ul_key, ul_version) ||
+					us_len != test_value(ul_key, ul_version, auc_expect) ||
+					memcmp(auc_value, auc_expect, us_len)) {
+				printf("%s: key %u holds a bad value, versions %u to %u\n",
+						p_when, ul_key, gs_ul_synced[ul_key],
+						gs_ul_latest[ul_key]);
+				b_ok = false;
+			}
+		}
+		gs_ul_synced[ul_key] = gs_ul_latest[ul_key] = ul_version;
+	}
+
+	/* Compactions drop the oldest events, never the last synced one. */
+	flog_read_events(test_event_reader, &events);
+	if (!events.b_ok || events.ul_last >= gs_ul_event_next ||
+			events.ul_last < gs_ul_event_synced) {
+		printf("%s: events out of order or lost, last %u, synced %u\n",
+				p_when, events.ul_last, gs_ul_event_synced);
+		b_ok = false;
+	}
+	gs_ul_event_synced = events.ul_last;
+	gs_ul_event_next = events.ul_last + 1;
+
+	flog_get_stats(&stats);
+	if (stats.ul_events != events.ul_count) {
+		printf("%s: %u events counted, %u read\n", p_when, stats.ul_events,
+				events.ul_count);
+		b_ok = false;
+	}
+	return TEST_CHECK(b_ok);
+}
+
+/**
+ * \brief Start from an erased flash, with changes in the log up to the
+ * point where the background task compacts.
+ */
+static void test_fill(void)
+{
+	host_flash_erase_all();
+	test_model_reset();
+	test_reset();
+	while (flog_free() >= CONF_FLOG_GC_FREE) {
+		if (!TEST_CHECK_EQ(test_change(), STATUS_OK) ||
+				!TEST_CHECK_EQ(test_sync(), STATUS_OK)) {
+			return;
+		}
+	}
+}
+
+/**
+ * \brief Keep going after a reset: more changes, another reset, and check.
+ */
+static void test_recovery(const char *p_when)
+{
+	if (!test_workload(300)) {
+		return;
+	}
+	test_reset();
+	test_check_store(p_when);
+}
+
+static void test_basic(void)
+{
+	uint8_t auc_value[TEST_VALUE_MAX];
+	uint16_t us_len;
+
+	host_flash_erase_all();
+	test_model_reset();
+	test_reset();
+	TEST_CHECK_EQ(gs_ul_used, 0);
+	TEST_CHECK_EQ(flog_set(FLOG_KEY_EVENT, "x", 1), ERR_INVALID_ARG);
+	TEST_CHECK_EQ(flog_set(CONF_FLOG_KEYS, "x", 1), ERR_INVALID_ARG);
+	TEST_CHECK_EQ(flog_set(1, "x", 0), ERR_INVALID_ARG);
+	TEST_CHECK_EQ(flog_set(1, auc_value, FLOG_DATA_MAX + 1), ERR_INVALID_ARG);
+
+	/* Changes not synced are lost at a reset, synced ones are not. */
+	TEST_CHECK(test_workload(50));
+	test_change();
+	test_change();
+	test_reset();
+	TEST_CHECK(test_check_store("basic"));
+
+	/* The longest value fits a page. */
+	memset(auc_value, 0x5A, sizeof(auc_value));
+	TEST_CHECK_EQ(flog_set(TEST_KEYS, auc_value, sizeof(auc_value)),
+			STATUS_OK);
+	TEST_CHECK_EQ(flog_delete(TEST_KEYS), STATUS_OK);
+	us_len = sizeof(auc_value);
+	TEST_CHECK(!flog_get(TEST_KEYS, auc_value, &us_len));
+
+	/* Runs through the ring several times, compacting. */
+	TEST_CHECK(test_workload(5000));
+	TEST_CHECK(gs_stats.ul_compactions > 2 * FLOG_BLOCKS);
+	test_reset();
+	TEST_CHECK(test_check_store("basic, after compactions"));
+	TEST_CHECK_EQ(gs_stats.ul_bad_pages, 0);
+}
+
+/**
+ * \brief Power loss while the first page of a block, with its header, is
+ * written.
+ */
+static void test_torn_header(void)
+{
+	static const uint32_t aul_done[] = { 0, 1, 2, 3, 4, 6, 40 };
+	uint32_t ul_block;
+	uint32_t i;
+
+	for (i = 0; i < sizeof(aul_done) / sizeof(aul_done[0]); i++) {
+		test_fill();
+		/* Up to the last page of the head block. */
+		while (gs_ul_next_page < CONF_FLOG_BLOCK_PAGES) {
+			test_change();
+			test_sync();
+		}
+		ul_block = (gs_ul_head + 1) % FLOG_BLOCKS;
+		test_change();
+		test_change();
+		host_flash_cut(HOST_FLASH_WRITE, 0, aul_done[i],
+				HOST_FLASH_ERASE_LOW_FIRST);
+		if (!setjmp(host_flash_power_loss)) {
+			test_sync();
+			TEST_CHECK(0);
+		}
+		test_reset();
+		TEST_CHECK(test_check_store("torn header"));
+		/* Cut before the CRC, the block is not in the log. */
+		if (aul_done[i] < 3) {
+			TEST_CHECK(gs_ul_head != ul_block);
+			TEST_CHECK_EQ(gs_uc_state[ul_block], aul_done[i] ?
+					FLOG_BLOCK_DIRTY : FLOG_BLOCK_ERASED);
+		}
+		test_recovery("torn header, recovery");
+	}
+}
+
+/**
+ * \brief Power loss between the write of the copies of a compaction and
+ * the erase of the block they come from, and during that erase.
+ */
+static void test_compaction_loss(void)
+{
+	static const uint32_t aul_done[] = { 0, 1, 8, 15 };
+	uint32_t ul_tail;
+	uint32_t i;
+	uint32_t j;
+
+	for (i = 0; i < sizeof(aul_done) / sizeof(aul_done[0]); i++) {
+		for (j = 0; j < 2; j++) {
+			test_fill();
+			ul_tail = (gs_ul_head + FLOG_BLOCKS + 1 - gs_ul_used) %
+					FLOG_BLOCKS;
+			host_flash_cut(HOST_FLASH_ERASE, 0, aul_done[i],
+					j ? HOST_FLASH_ERASE_HIGH_FIRST :
+					HOST_FLASH_ERASE_LOW_FIRST);
+			if (!setjmp(host_flash_power_loss)) {
+				test_gc();
+				TEST_CHECK(0);
+			}
+			test_reset();
+			TEST_CHECK(test_check_store(aul_done[i] ?
+					"partly erased tail" : "loss before the erase"));
+			/*
+			 * Whole, the old tail is still in the log; partly erased, it is
+			 * if its header is left.
+			 */
+			TEST_CHECK_EQ(gs_uc_state[ul_tail] == FLOG_BLOCK_USED,
+					!aul_done[i] || j);
+			test_recovery("compaction loss, recovery");
+		}
+	}
+}
+
+/**
+ * \brief An erase of the compaction fails: the block keeps a valid header
+ * that follows on the new tail.
+ */
+static void test_failed_erase(void)
+{
+	flog_stats_t before;
+	flog_stats_t after;
+	uint32_t ul_tail;
+
+	test_fill();
+	ul_tail = (gs_ul_head + FLOG_BLOCKS + 1 - gs_ul_used) % FLOG_BLOCKS;
+	host_flash_fail(HOST_FLASH_ERASE, 0);
+	TEST_CHECK_EQ(test_gc(), ERR_IO_ERROR);
+	TEST_CHECK_EQ(gs_stats.ul_errors, 1);
+
+	/* What the store holds is what it will find at the next start. */
+	flog_get_stats(&before);
+	test_reset();
+	flog_get_stats(&after);
+	TEST_CHECK_EQ(after.ul_used_blocks, before.ul_used_blocks);
+	TEST_CHECK_EQ(after.ul_events, before.ul_events);
+	TEST_CHECK_EQ(after.ul_keys, before.ul_keys);
+	TEST_CHECK(test_check_store("failed erase"));
+	TEST_CHECK_EQ(gs_uc_state[ul_tail], FLOG_BLOCK_USED);
+
+	/* The next compaction takes the block. */
+	TEST_CHECK_EQ(test_gc(), STATUS_OK);
+	TEST_CHECK(gs_uc_state[ul_tail] == FLOG_BLOCK_ERASED);
+	test_recovery("failed erase, recovery");
+}
+
+/**
+ * \brief The write of the first page of a block fails: the records synced
+ * after it must not land in a block with no header.
+ */
+static void test_failed_header(void)
+{
+	test_fill();
+	while (gs_ul_next_page < CONF_FLOG_BLOCK_PAGES) {
+		test_change();
+		test_sync();
+	}
+	test_change();
+	host_flash_fail(HOST_FLASH_WRITE, 0);
+	TEST_CHECK_EQ(flog_sync(), ERR_IO_ERROR);
+	/* Lost, as flog_sync() says: the model goes back to the last sync. */
+	memcpy(gs_ul_latest, gs_ul_synced, sizeof(gs_ul_latest));
+	gs_ul_event_next = gs_ul_event_synced + 1;
+
+	TEST_CHECK(test_workload(40));
+	test_reset();
+	TEST_CHECK(test_check_store("failed header"));
+	test_recovery("failed header, recovery");
+}
+
+/**
+ * \brief Power loss at every flash command of a workload in turn, each cut
+ * short a different way.
+ */
+static void test_power_loss_sweep(void)
+{
+	host_flash_stats_t before;
+	host_flash_stats_t after;
+	volatile uint32_t ul_cut;
+	volatile uint32_t ul_losses = 0;
+	uint32_t ul_commands;
+	char ac_when[48];
+
+	test_fill();
+	host_flash_get_stats(&before);
+	test_workload(1000);
+	host_flash_get_stats(&after);
+	ul_commands = after.ul_writes + after.ul_erases - before.ul_writes -
+			before.ul_erases;
+
+	for (ul_cut = 0; ul_cut < ul_commands; ul_cut++) {
+		test_fill();
+		host_flash_cut(HOST_FLASH_ANY, ul_cut,
+				ul_cut * 7919 % (FLOG_PAGE_SIZE / 4 + 1),
+				ul_cut & 1 ? HOST_FLASH_ERASE_HIGH_FIRST :
+				HOST_FLASH_ERASE_LOW_FIRST);
+		if (!setjmp(host_flash_power_loss)) {
+			test_workload(1000);
+			host_flash_disarm();
+		} else {
+			ul_losses++;
+		}
+		snprintf(ac_when, sizeof(ac_when), "power loss %u", ul_cut);
+		test_reset();
+		if (!test_check_store(ac_when)) {
+			break;
+		}
+		test_recovery(ac_when);
+	}
+	TEST_CHECK(ul_losses > 0);
+	printf("flog: %u power losses over %u flash commands\n", ul_losses,
+			ul_commands);
+}
+
+/**
+ * \brief Run one write amplification workload, print its line.
+ *
+ * \param ul_hot Keys updated in turn.
+ * \param ul_cold Keys set once at the start, copied by the compactions.
+ * \param ul_sync Updates per flog_sync().
+ */
+static void test_wa_run(uint16_t us_len, uint32_t ul_hot, uint32_t ul_cold,
+		uint32_t ul_sync)
+{
+	const uint32_t ul_updates = 20000;
+	uint8_t auc_value[FLOG_DATA_MAX];
+	host_flash_stats_t start;
+	host_flash_stats_t end;
+	uint32_t ul_record_bytes;
+	uint32_t ul_key;
+	uint32_t n;
+
+	host_flash_erase_all();
+	test_reset();
+	memset(auc_value, 0x3C, sizeof(auc_value));
+	for (ul_key = 1; ul_key <= ul_cold; ul_key++) {
+		flog_set(ul_key, auc_value, us_len);
+	}
+	flog_sync();
+	memset(&gs_stats, 0, sizeof(gs_stats));
+	host_flash_get_stats(&start);
+
+	for (n = 0; n < ul_updates; n++) {
+		memcpy(auc_value, &n, 4);
+		ul_key = 1 + ul_cold + n % ul_hot;
+		if (!TEST_CHECK_EQ(flog_set(ul_key, auc_value, us_len), STATUS_OK)) {
+			return;
+		}
+		if ((n + 1) % ul_sync == 0) {
+			flog_sync();
+			test_gc();
+		}
+	}
+	host_flash_get_stats(&end);
+	ul_record_bytes = gs_stats.ul_append_bytes + gs_stats.ul_copy_bytes;
+	printf("%6u %4u %4u %5u %9.1f %6.1f%% %9.1f %9.2f %7.2f\n", us_len,
+			ul_hot, ul_cold, ul_sync, (double)ul_record_bytes / ul_updates,
+			100.0 * gs_stats.ul_copy_bytes / ul_record_bytes,
+			1000.0 * (end.ul_writes - start.ul_writes) / ul_updates,
+			1000.0 * (end.ul_erases - start.ul_erases) / ul_updates,
+			(double)(end.ul_writes - start.ul_writes) * FLOG_PAGE_SIZE /
+			((double)ul_updates * us_len));
+}
+
+/**
+ * \brief Write amplification: flash programmed and erased per byte of
+ * value, for a few value sizes, key sets and sync rates.
+ */
+static void test_write_amplification(void)
+{
+	static const uint16_t aus_len[] = { 8, 32, 128 };
+	static const uint32_t aul_keys[][2] = {
+		/* Hot, cold. */
+		{ 8, 0 }, { 48, 0 }, { 8, 12 }, { 8, 48 },
+	};
+	uint32_t i;
+	uint32_t j;
+
+	printf("\n%6s %4s %4s %5s %9s %7s %9s %9s %7s\n", "value", "hot",
+			"cold", "sync", "recB/upd", "copy", "pages/1k", "erase/1k",
+			"WA");
+	for (i = 0; i < sizeof(aus_len) / sizeof(aus_len[0]); i++) {
+		for (j = 0; j < sizeof(aul_keys) / sizeof(aul_keys[0]); j++) {
+			test_wa_run(aus_len[i], aul_keys[j][0], aul_keys[j][1], 1);
+			test_wa_run(aus_len[i], aul_keys[j][0], aul_keys[j][1], 16);
+		}
+	}
+	printf("hot: keys updated in turn; cold: keys set once; sync: updates "
+			"per flog_sync();\nrecB/upd: record bytes per update, copies "
+			"included; WA: bytes programmed per byte of value\n\n");
+}
+
+/**
+ * \brief The background task writes the records CONF_FLOG_SYNC_MS after
+ * the first one.
+ */
+static void test_task(void)
+{
+	uint8_t auc_value[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	uint16_t us_len = sizeof(auc_value);
+	flog_stats_t stats;
+
+	host_flash_erase_all();
+	memset(&gs_stats, 0, sizeof(gs_stats));
+	gs_x_lock = NULL;
+	TEST_CHECK(flog_init());
+	TEST_CHECK(!flog_init());
+	TEST_CHECK_EQ(flog_set(3, auc_value, sizeof(auc_value)), STATUS_OK);
+	vTaskDelay(pdMS_TO_TICKS(CONF_FLOG_SYNC_MS / 2));
+	flog_get_stats(&stats);
+	TEST_CHECK_EQ(stats.ul_pages, 0);
+	vTaskDelay(pdMS_TO_TICKS(CONF_FLOG_SYNC_MS));
+	flog_get_stats(&stats);
+	TEST_CHECK_EQ(stats.ul_pages, 1);
+
+	xSemaphoreTake(gs_x_lock, portMAX_DELAY);
+	flog_mount();
+	xSemaphoreGive(gs_x_lock);
+	memset(auc_value, 0, sizeof(auc_value));
+	TEST_CHECK(flog_get(3, auc_value, &us_len));
+	TEST_CHECK_EQ(auc_value[7], 8);
+}
+
+int main(void)
+{
+	if (!TEST_CHECK(host_flash_init(CONF_FLOG_SIZE, FLOG_PAGE_SIZE))) {
+		return test_end("flog");
+	}
+
+	test_basic();
+	test_torn_header();
+	test_compaction_loss();
+	test_failed_erase();
+	test_failed_header();
+	test_power_loss_sweep();
+	test_write_amplification();
+	test_task();
+	return test_end("flog");
+}
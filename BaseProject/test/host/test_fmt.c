@@ -0,0 +1,351 @@
+/**
+ * \file
+ *
+ * \brief Host test of the formatter, against the host C library.
+ *
+ * fmt_snprintf() is compared with snprintf() on fixed cases and on random
+ * conversions over the flags, widths, precisions and length modifiers it
+ * supports, then checked where it departs from the C library on purpose
+ * (\%p, truncation). A table follows of the time per call and of the stack
+ * used, next to the vsnprintf() of the host: the stack is measured on a
+ * thread whose stack is painted beforehand.
+ *
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fmt.h"
+#include "test.h"
+
+/** Random conversions compared with the C library. */
+#define TEST_SWEEP          200000
+
+/** Calls timed per formatter. */
+#define TEST_CALLS          1000000
+
+/** Stack of the measuring thread, and the paint of its unused part. */
+#define TEST_STACK_SIZE     (256 * 1024)
+#define TEST_STACK_PAINT    0xA5
+
+/**
+ * \brief Compare fmt_snprintf() with snprintf() on the same arguments.
+ */
+#define TEST_SAME(...) \
+	do { \
+		char ac_fmt[160], ac_lib[160]; \
+		int n_fmt = fmt_snprintf(ac_fmt, sizeof(ac_fmt), __VA_ARGS__); \
+		int n_lib = snprintf(ac_lib, sizeof(ac_lib), __VA_ARGS__); \
+		test_same(ac_fmt, n_fmt, ac_lib, n_lib, #__VA_ARGS__, __LINE__); \
+	} while (0)
+
+static bool test_same(const char *p_fmt, int n_fmt, const char *p_lib,
+		int n_lib, const char *p_what, int line)
+{
+	if (n_fmt != n_lib || strcmp(p_fmt, p_lib)) {
+		printf("%s:%d: %s: \"%s\" (%d), C library \"%s\" (%d)\n", __FILE__,
+				line, p_what, p_fmt, n_fmt, p_lib, n_lib);
+		gs_test_failures++;
+		return false;
+	}
+	return true;
+}
+
+static void test_cases(void)
+{
+	const char *volatile p_null = NULL;
+
+	/* Integers, widths and flags. */
+	TEST_SAME("%d %i %u", 0, -1, 4000000000u);
+	TEST_SAME("[%5d] [%-5d] [%05d] [%+d] [% d] [%+5d]", 42, 42, -42, 7, 7, -7);
+	TEST_SAME("[%.3d] [%8.3d] [%-8.3d] [%.0d] [%5.0d]", 7, -7, 7, 0, 0);
+	TEST_SAME("[%*d] [%-*d] [%*d] [%.*d] [%.*d]", 6, 1, 6, 1, -6, 1, 4, 1,
+			-4, 1);
+	TEST_SAME("%d %d", INT32_MIN, INT32_MAX);
+	TEST_SAME("%lld %llu %lld", (long long)INT64_MIN, (unsigned long long)
+			UINT64_MAX, 1234567890123ll);
+	TEST_SAME("%hhd %hhu %hd %hu", 0x1ff, 0x1ff, 0x1ffff, 0x1ffff);
+	TEST_SAME("%ld %lu %zu %td", -123456l, 123456ul, (size_t)99,
+			(ptrdiff_t)-99);
+
+	/* Hexadecimal and octal. */
+	TEST_SAME("%x %X %#x %#X %#x", 0xbeef, 0xbeef, 0xbeef, 0xbeef, 0);
+	TEST_SAME("[%08x] [%#010x] [%-#10x] [%.6x] [%#.6x]", 0x1f, 0x1f, 0x1f,
+			0x1f, 0x1f);
+	TEST_SAME("%llx %#llX", 0x123456789abcdefull, 0xfedcba9876543210ull);
+	TEST_SAME("%o %#o %#o %#.0o %.0o [%#5o]", 8, 8, 0, 0, 0, 8);
+
+	/* Characters and strings. */
+	TEST_SAME("[%c] [%3c] [%-3c] %%", 'a', 'b', 'c');
+	TEST_SAME("[%s] [%8s] [%-8s] [%.2s] [%8.2s] [%.0s]", "abc", "abc", "abc",
+			"abc", "abc", "abc");
+	TEST_SAME("[%.*s] [%.10s]", 3, "abcdef", "abc");
+	TEST_SAME("%s", "");
+
+	/* Floating point is not supported: printed as written. */
+	{
+		char ac_buf[32];
+
+		TEST_CHECK_EQ(fmt_snprintf(ac_buf, sizeof(ac_buf), "a%fb%5.2e", 1.0,
+				2.0), 9);
+		TEST_CHECK(!strcmp(ac_buf, "a%fb%5.2e"));
+	}
+
+	/* NULL strings, as the C library of the host prints them. */
+	{
+		char ac_buf[32];
+
+		fmt_snprintf(ac_buf, sizeof(ac_buf), "[%s] [%8s] [%.3s]", p_null,
+				p_null, p_null);
+		TEST_CHECK(!strcmp(ac_buf, "[(null)] [  (null)] [(nu]"));
+	}
+
+	/* Pointers: 0x and every digit of the pointer, NULL included. */
+	{
+		char ac_buf[64], ac_ref[64];
+		void *p = (void *)(uintptr_t)0xdead;
+
+		fmt_snprintf(ac_buf, sizeof(ac_buf), "%p", p);
+		snprintf(ac_ref, sizeof(ac_ref), "0x%0*lx", (int)(2 * sizeof(p)),
+				(unsigned long)0xdead);
+		TEST_CHECK(!strcmp(ac_buf, ac_ref));
+		fmt_snprintf(ac_buf, sizeof(ac_buf), "%p", NULL);
+		TEST_CHECK_EQ(strlen(ac_buf), 2 + 2 * sizeof(p));
+		TEST_CHECK(!strncmp(ac_buf, "0x0000", 6));
+		fmt_snprintf(ac_buf, sizeof(ac_buf), "[%-*p]",
+				(int)(4 + 2 * sizeof(p)), p);
+		TEST_CHECK_EQ(strlen(ac_buf), 6 + 2 * sizeof(p));
+		TEST_CHECK(!strcmp(&ac_buf[strlen(ac_buf) - 3], "  ]"));
+	}
+}
+
+static void test_truncation(void)
+{
+	char ac_buf[16];
+
+	/* The whole length is returned, the buffer is cut and terminated. */
+	memset(ac_buf, 'x', sizeof(ac_buf));
+	TEST_CHECK_EQ(fmt_snprintf(ac_buf, 8, "%d", 123456789), 9);
+	TEST_CHECK(!strcmp(ac_buf, "1234567"));
+	TEST_CHECK_EQ(ac_buf[8], 'x');
+	TEST_CHECK_EQ(fmt_snprintf(ac_buf, 8, "%-12s|", "ab"), 13);
+	TEST_CHECK(!strcmp(ac_buf, "ab     "));
+	TEST_CHECK_EQ(fmt_snprintf(ac_buf, 8, "%20d", 1), 20);
+	TEST_CHECK(!strcmp(ac_buf, "       "));
+	/* One byte: the terminator only. Nothing at all without room. */
+	memset(ac_buf, 'x', sizeof(ac_buf));
+	TEST_CHECK_EQ(fmt_snprintf(ac_buf, 1, "abc"), 3);
+	TEST_CHECK_EQ(ac_buf[0], '\0');
+	TEST_CHECK_EQ(ac_buf[1], 'x');
+	ac_buf[0] = 'x';
+	TEST_CHECK_EQ(fmt_snprintf(ac_buf, 0, "abc%d", 12), 5);
+	TEST_CHECK_EQ(ac_buf[0], 'x');
+	TEST_CHECK_EQ(fmt_snprintf(NULL, 0, "%s", "abcdef"), 6);
+	/* Exactly full. */
+	TEST_CHECK_EQ(fmt_snprintf(ac_buf, 4, "abc"), 3);
+	TEST_CHECK(!strcmp(ac_buf, "abc"));
+}
+
+/**
+ * \brief Random integer conversions, compared with the C library.
+ */
+static void test_sweep(void)
+{
+	static const char ac_flags[] = "-0+ #";
+	static const char ac_convs[] = "diuxXo";
+	static const char *const p_lens[] = { "", "hh", "h", "l", "ll" };
+	uint32_t ul_seed = 2028;
+	uint32_t ul_failed = 0;
+	uint32_t i, j, ul_r;
+	char ac_spec[32];
+	char ac_fmt[96], ac_lib[96];
+	int n_fmt, n_lib, pos;
+	unsigned long long ull_value;
+	const char *p_len;
+	char c_conv;
+
+	for (i = 0; i < TEST_SWEEP && ul_failed < 10; i++) {
+		ul_r = test_rand(&ul_seed);
+		pos = 0;
+		ac_spec[pos++] = '%';
+		for (j = 0; j < sizeof(ac_flags) - 1; j++) {
+			if (ul_r & (1u << j)) {
+				ac_spec[pos++] = ac_flags[j];
+			}
+		}
+		c_conv = ac_convs[(ul_r >> 5) % (sizeof(ac_convs) - 1)];
+		p_len = p_lens[(ul_r >> 8) % 5];
+		if (ul_r & (1u << 11)) {
+			pos += sprintf(&ac_spec[pos], "%u", (ul_r >> 12) % 24);
+		}
+		if (ul_r & (1u << 17)) {
+			pos += sprintf(&ac_spec[pos], ".%u", (ul_r >> 18) % 24);
+		}
+		/* '#' is undefined for the decimal conversions. */
+		if (c_conv == 'd' || c_conv == 'i' || c_conv == 'u') {
+			char *p_alt = memchr(ac_spec, '#', pos);
+
+			if (p_alt) {
+				*p_alt = '-';
+			}
+		}
+		sprintf(&ac_spec[pos], "%s%c", p_len, c_conv);
+
+		ull_value = ((unsigned long long)test_rand(&ul_seed) << 32) |
+				test_rand(&ul_seed);
+		/* Small values, and zero, as often as large ones. */
+		ull_value >>= test_rand(&ul_seed) % 65;
+		if (!strcmp(p_len, "ll")) {
+			n_fmt = fmt_snprintf(ac_fmt, sizeof(ac_fmt), ac_spec, ull_value);
+			n_lib = snprintf(ac_lib, sizeof(ac_lib), ac_spec, ull_value);
+		} else if (!strcmp(p_len, "l")) {
+			n_fmt = fmt_snprintf(ac_fmt, sizeof(ac_fmt), ac_spec,
+					(unsigned long)ull_value);
+			n_lib = snprintf(ac_lib, sizeof(ac_lib), ac_spec,
+					(unsigned long)ull_value);
+		} else {
+			n_fmt = fmt_snprintf(ac_fmt, sizeof(ac_fmt), ac_spec,
+					(unsigned int)ull_value);
+			n_lib = snprintf(ac_lib, sizeof(ac_lib), ac_spec,
+					(unsigned int)ull_value);
+		}
+		if (!test_same(ac_fmt, n_fmt, ac_lib, n_lib, ac_spec, __LINE__)) {
+			ul_failed++;
+		}
+	}
+}
+
+/** A formatter under measure. */
+typedef int (*test_vsnprintf_t)(char *p_buf, size_t ul_size,
+		const char *p_fmt, va_list ap);
+
+static int test_call(test_vsnprintf_t f, char *p_buf, size_t ul_size,
+		const char *p_fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start(ap, p_fmt);
+	n = f(p_buf, ul_size, p_fmt, ap);
+	va_end(ap);
+
+	return n;
+}
+
+/** Lines of the benchmark, as the firmware prints them. */
+static int test_line(test_vsnprintf_t f, char *p_buf, uint32_t i)
+{
+	switch (i % 4) {
+	case 0:
+		return test_call(f, p_buf, 128, "%-12s %10lu %9u %4lu\r\n", "adc",
+				(unsigned long)i * 977, i & 0xffff, (unsigned long)i % 13);
+	case 1:
+		return test_call(f, p_buf, 128, "task %s: %u%% stack %u\r\n",
+				"monitor", i % 100, i % 2048);
+	case 2:
+		return test_call(f, p_buf, 128, "0x%08x %d\r\n", i * 2654435761u,
+				(int)(i - 50000));
+	default:
+		return test_call(f, p_buf, 128, "%s\r\n", "ok");
+	}
+}
+
+/** Stack measure: formatter, and bytes used by one call of each line. */
+static struct {
+	test_vsnprintf_t f;
+	size_t ul_used;
+} gs_measure;
+
+static void *test_measure_main(void *pv)
+{
+	char ac_buf[128];
+	uint32_t i;
+
+	for (i = 0; gs_measure.f && i < 4; i++) {
+		test_line(gs_measure.f, ac_buf, i);
+	}
+	return NULL;
+}
+
+/**
+ * \brief Stack used on a painted thread stack: the deepest byte written.
+ *
+ * With \a f NULL the thread only starts and returns, which gives what the
+ * C library itself takes of the stack (thread descriptor, TLS).
+ */
+static size_t test_stack(test_vsnprintf_t f)
+{
+	static uint8_t uc_stack[TEST_STACK_SIZE] __attribute__((aligned(4096)));
+	pthread_attr_t attr;
+	pthread_t thread;
+	size_t i;
+
+	memset(uc_stack, TEST_STACK_PAINT, sizeof(uc_stack));
+	gs_measure.f = f;
+	pthread_attr_init(&attr);
+	pthread_attr_setstack(&attr, uc_stack, sizeof(uc_stack));
+	if (!TEST_CHECK(!pthread_create(&thread, &attr, test_measure_main,
+			NULL))) {
+		return 0;
+	}
+	pthread_join(thread, NULL);
+	pthread_attr_destroy(&attr);
+
+	/* The stack grows down: the lowest byte changed is the deepest. */
+	for (i = 0; i < sizeof(uc_stack) && uc_stack[i] == TEST_STACK_PAINT;
+			i++) {
+	}
+	return sizeof(uc_stack) - i;
+}
+
+static void test_bench(void)
+{
+	static const struct {
+		const char *p_name;
+		test_vsnprintf_t f;
+	} formatters[] = {
+		{ "fmt_vsnprintf", fmt_vsnprintf },
+		{ "C library", vsnprintf },
+	};
+	char ac_buf[128];
+	double d_start, d_ns[2];
+	size_t ul_stack[2], ul_base;
+	uint32_t m, i;
+	volatile int n = 0;
+
+	/* Both print the same lines. */
+	for (i = 0; i < 4; i++) {
+		char ac_ref[128];
+
+		test_line(fmt_vsnprintf, ac_buf, i);
+		test_line(vsnprintf, ac_ref, i);
+		TEST_CHECK(!strcmp(ac_buf, ac_ref));
+	}
+
+	ul_base = test_stack(NULL);
+	printf("%-14s %9s %9s\n", "formatter", "ns/call", "stack B");
+	for (m = 0; m < 2; m++) {
+		d_start = test_seconds();
+		for (i = 0; i < TEST_CALLS; i++) {
+			n += test_line(formatters[m].f, ac_buf, i);
+		}
+		d_ns[m] = (test_seconds() - d_start) * 1e9 / TEST_CALLS;
+		ul_stack[m] = test_stack(formatters[m].f) - ul_base;
+		printf("%-14s %9.1f %9zu\n", formatters[m].p_name, d_ns[m],
+				ul_stack[m]);
+	}
+	/* All its state is in one frame of the caller stack. */
+	TEST_CHECK(ul_stack[0] && ul_stack[0] < 1024);
+	TEST_CHECK(ul_stack[0] < ul_stack[1]);
+}
+
+int main(void)
+{
+	test_cases();
+	test_truncation();
+	test_sweep();
+	test_bench();
+	return test_end("fmt");
+}
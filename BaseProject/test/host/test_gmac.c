@@ -0,0 +1,1034 @@
+/**
+ * \file
+ *
+ * \brief Host test of the GMAC driver and the frame buffer pool, against a
+ * model of the MAC and its descriptor DMA, with a packet rate benchmark.
+ *
+ * The model walks the queue 0 rings from RBQB and TBQB as the GMAC does:
+ * on TSTART it sends the frames whose first descriptor is not used, one
+ * buffer list each, writes the used bit back into the first descriptor and
+ * loops the frame back into the receive ring in local loopback. Received
+ * frames are address filtered, written into the next slot the software
+ * does not own, and the slot handed back. It flags what the GMAC would
+ * trip on: a frame released before all its descriptors, a ring without a
+ * wrap bit, a queue base moved while transmitting.
+ *
+ * The driver keeps its Gmac pointer, so the model runs between the driver
+ * calls of the test and at each barrier of the driver. Interrupt enables
+ * and disables are taken after each call, and the status register is
+ * cleared when the handler reads it.
+ *
+ */
+
+#include <string.h>
+#include <asf.h>
+#include "conf_net.h"
+#include "net_buf.h"
+#include "test.h"
+
+static void test_gmac_run(void);
+
+/* gmac.c is built into the test, with the model running at its barriers. */
+#undef __DMB
+#define __DMB()             test_gmac_run()
+#include "gmac.c"
+
+/*
+ * The MAC takes the register writes as they come: the model runs after each
+ * driver call that writes them.
+ */
+#define TEST_RUN_AFTER(call) ({ \
+	__typeof__(call) x_ret = (call); \
+	test_gmac_run(); \
+	x_ret; \
+})
+#define TEST_RUN_AFTER_VOID(call) do { \
+	call; \
+	test_gmac_run(); \
+} while (0)
+#define gmac_rx_take(...)       TEST_RUN_AFTER(gmac_rx_take(__VA_ARGS__))
+#define gmac_rx_refill(...)     TEST_RUN_AFTER(gmac_rx_refill(__VA_ARGS__))
+#define gmac_tx_reclaim(...)    TEST_RUN_AFTER(gmac_tx_reclaim(__VA_ARGS__))
+#define gmac_tx_start(...)      TEST_RUN_AFTER_VOID(gmac_tx_start(__VA_ARGS__))
+#define gmac_enable(...)        TEST_RUN_AFTER_VOID(gmac_enable(__VA_ARGS__))
+#define gmac_enable_interrupt(...) \
+	TEST_RUN_AFTER_VOID(gmac_enable_interrupt(__VA_ARGS__))
+#define gmac_disable_interrupt(...) \
+	TEST_RUN_AFTER_VOID(gmac_disable_interrupt(__VA_ARGS__))
+
+#define TEST_GMAC           GMAC
+
+/** Descriptors of the rings and of the priority queues. */
+#define TEST_DESC_MAX       (CONF_NET_RX_DESC + CONF_NET_TX_DESC + 2)
+static gmac_desc_t gs_desc[TEST_DESC_MAX] __attribute__((aligned(8)));
+
+static const uint8_t gs_uc_mac[6] = CONF_NET_MAC_ADDR;
+static const uint8_t gs_uc_peer[6] = {0x02, 0x00, 0x00, 0x71, 0x00, 0x02};
+
+/** Frame type of the test frames, the local experimental one. */
+#define TEST_ETHERTYPE      0x88B5
+
+/** Length of the test frames, header included. */
+#define TEST_FRAME_LEN      128
+
+/** MAC state, besides its registers. */
+static struct {
+	/** Interrupt flags not read yet. */
+	uint32_t ul_isr;
+	uint32_t ul_ncr;
+	uint32_t ul_rbqb;
+	uint32_t ul_tbqb;
+	/** Next descriptor of each queue. */
+	gmac_desc_t *p_rx;
+	gmac_desc_t *p_tx;
+	bool b_tx_go;
+	/** Frames to fail with a retry limit error, from the next one. */
+	uint32_t ul_tx_fail;
+	bool b_busy;
+	/** What the driver did. */
+	uint32_t ul_tstarts;
+	uint32_t ul_irqs;
+	/** Rules broken. */
+	uint32_t ul_faults;
+	/** Frames sent, received, lost for want of a buffer, filtered out. */
+	uint32_t ul_sent;
+	uint32_t ul_received;
+	uint32_t ul_lost;
+	uint32_t ul_filtered;
+} gs_model;
+
+/** Last frame sent on the wire. */
+static uint8_t gs_uc_wire[GMAC_FRAME_SIZE_MAX];
+static uint32_t gs_ul_wire_len;
+
+static gmac_dev_t gs_dev;
+static gmac_config_t gs_cfg;
+
+static void test_fault(const char *p_what)
+{
+	printf("gmac model: %s\n", p_what);
+	gs_model.ul_faults++;
+}
+
+/**
+ * \brief Descriptor at an address the GMAC fetches, NULL and a fault if it
+ * is not one of the test descriptors.
+ */
+static gmac_desc_t *test_desc(uint32_t ul_addr)
+{
+	gmac_desc_t *p_desc = (gmac_desc_t *)(uintptr_t)ul_addr;
+
+	if (p_desc < gs_desc || p_desc >= gs_desc + TEST_DESC_MAX ||
+			(ul_addr & 7)) {
+		test_fault("descriptor out of the rings");
+		return NULL;
+	}
+	return p_desc;
+}
+
+/** Next descriptor of a queue, back to its base after the wrap bit. */
+static gmac_desc_t *test_next(gmac_desc_t *p_desc, bool b_wrap,
+		uint32_t ul_base)
+{
+	if (b_wrap) {
+		return test_desc(ul_base);
+	}
+	if (p_desc + 1 >= gs_desc + TEST_DESC_MAX) {
+		test_fault("ring without a wrap bit");
+		return test_desc(ul_base);
+	}
+	return p_desc + 1;
+}
+
+/**
+ * \brief A frame comes in, from the wire or looped back.
+ */
+static void test_gmac_receive(const uint8_t *p_frame, uint32_t ul_len)
+{
+	Gmac *p_gmac = TEST_GMAC;
+	uint32_t ul_buf_size = ((p_gmac->GMAC_DCFGR & GMAC_DCFGR_DRBS_Msk) >>
+			GMAC_DCFGR_DRBS_Pos) * GMAC_RX_UNIT_SIZE;
+	uint8_t uc_sa[6];
+	gmac_desc_t *p_desc = gs_model.p_rx;
+	uint32_t ul_addr;
+
+	if (!(gs_model.ul_ncr & GMAC_NCR_RXEN) || !p_desc) {
+		return;
+	}
+	uc_sa[0] = p_gmac->GMAC_SA[0].GMAC_SAB;
+	uc_sa[1] = p_gmac->GMAC_SA[0].GMAC_SAB >> 8;
+	uc_sa[2] = p_gmac->GMAC_SA[0].GMAC_SAB >> 16;
+	uc_sa[3] = p_gmac->GMAC_SA[0].GMAC_SAB >> 24;
+	uc_sa[4] = p_gmac->GMAC_SA[0].GMAC_SAT;
+	uc_sa[5] = p_gmac->GMAC_SA[0].GMAC_SAT >> 8;
+	if (!(p_gmac->GMAC_NCFGR & GMAC_NCFGR_CAF) && memcmp(p_frame, uc_sa, 6) &&
+			memcmp(p_frame, "\xFF\xFF\xFF\xFF\xFF\xFF", 6)) {
+		gs_model.ul_filtered++;
+		return;
+	}
+	if (ul_len > ul_buf_size) {
+		test_fault("frame longer than the receive buffers");
+		return;
+	}
+	if (p_desc->ul_addr & GMAC_RXD_OWNERSHIP) {
+		/* Owned by the software: the frame is lost. */
+		gs_model.ul_lost++;
+		gs_model.ul_isr |= GMAC_ISR_RXUBR;
+		return;
+	}
+	ul_addr = p_desc->ul_addr;
+	if (!net_buf_from_data((void *)(uintptr_t)(ul_addr & GMAC_RXD_ADDR_Msk))) {
+		test_fault("receive buffer out of the pool");
+		return;
+	}
+	memcpy((void *)(uintptr_t)(ul_addr & GMAC_RXD_ADDR_Msk), p_frame, ul_len);
+	p_desc->ul_status = ul_len | GMAC_RXD_SOF | GMAC_RXD_EOF;
+	p_desc->ul_addr = ul_addr | GMAC_RXD_OWNERSHIP;
+	gs_model.p_rx = test_next(p_desc, ul_addr & GMAC_RXD_WRAP,
+			gs_model.ul_rbqb);
+	gs_model.ul_received++;
+	gs_model.ul_isr |= GMAC_ISR_RCOMP;
+}
+
+/**
+ * \brief Send the frame at the transmit queue pointer.
+ *
+ * \return false if the transmitter stopped.
+ */
+static bool test_gmac_send(void)
+{
+	uint8_t uc_frame[GMAC_FRAME_SIZE_MAX];
+	gmac_desc_t *p_first = gs_model.p_tx;
+	gmac_desc_t *p_desc = p_first;
+	uint32_t ul_len = 0;
+	uint32_t ul_segs = 0;
+
+	if (!p_first || (p_first->ul_status & GMAC_TXD_USED)) {
+		gs_model.b_tx_go = false;
+		return false;
+	}
+	for (;;) {
+		uint32_t ul_status = p_desc->ul_status;
+		uint32_t ul_seg = ul_status & GMAC_TXD_LEN_Msk;
+
+		if (ul_segs && (ul_status & GMAC_TXD_USED)) {
+			test_fault("frame released before its descriptors");
+			gs_model.b_tx_go = false;
+			return false;
+		}
+		if (!net_buf_from_data((void *)(uintptr_t)p_desc->ul_addr) ||
+				!ul_seg ||
+				ul_len + ul_seg > GMAC_FRAME_SIZE_MAX) {
+			test_fault("transmit buffer out of range");
+			gs_model.b_tx_go = false;
+			return false;
+		}
+		memcpy(uc_frame + ul_len, (const void *)(uintptr_t)p_desc->ul_addr,
+				ul_seg);
+		ul_len += ul_seg;
+		ul_segs++;
+		p_desc = test_next(p_desc, ul_status & GMAC_TXD_WRAP,
+				gs_model.ul_tbqb);
+		if ((ul_status & GMAC_TXD_LAST) || !p_desc) {
+			break;
+		}
+	}
+
+	if (gs_model.ul_tx_fail) {
+		/* Retry limit: the transmitter stops and goes back to its base. */
+		gs_model.ul_tx_fail--;
+		p_first->ul_status |= GMAC_TXD_USED | GMAC_TXD_RLE;
+		gs_model.ul_isr |= GMAC_ISR_RLEX;
+		gs_model.p_tx = test_desc(gs_model.ul_tbqb);
+		gs_model.b_tx_go = false;
+		return false;
+	}
+	/* Only the first descriptor is written back. */
+	p_first->ul_status |= GMAC_TXD_USED;
+	gs_model.p_tx = p_desc;
+	gs_model.ul_sent++;
+	gs_model.ul_isr |= GMAC_ISR_TCOMP;
+	memcpy(gs_uc_wire, uc_frame, ul_len);
+	gs_ul_wire_len = ul_len;
+	if (gs_model.ul_ncr & GMAC_NCR_LBL) {
+		/* Padded to the minimum on the wire. */
+		if (ul_len < 60) {
+			memset(uc_frame + ul_len, 0, 60 - ul_len);
+			ul_len = 60;
+		}
+		test_gmac_receive(uc_frame, ul_len);
+	}
+	return true;
+}
+
+static void test_gmac_isr(void)
+{
+	HOST_REG(TEST_GMAC->GMAC_ISR) = gs_model.ul_isr;
+	/* Cleared on read. */
+	gs_model.ul_isr = 0;
+	GMAC_Handler();
+	HOST_REG(TEST_GMAC->GMAC_ISR) = 0;
+}
+
+/**
+ * \brief Interrupt, if an enabled flag is set.
+ */
+static void test_gmac_irq(void)
+{
+	Gmac *p_gmac = TEST_GMAC;
+
+	if (p_gmac->GMAC_IER) {
+		p_gmac->GMAC_IMR &= ~p_gmac->GMAC_IER;
+		p_gmac->GMAC_IER = 0;
+	}
+	if (p_gmac->GMAC_IDR) {
+		p_gmac->GMAC_IMR |= p_gmac->GMAC_IDR;
+		p_gmac->GMAC_IDR = 0;
+	}
+	if ((gs_model.ul_isr & ~p_gmac->GMAC_IMR) &&
+			host_nvic.uc_enabled[GMAC_IRQn]) {
+		gs_model.ul_irqs++;
+		host_irq(GMAC_IRQn, test_gmac_isr);
+		test_gmac_irq();
+	}
+}
+
+/**
+ * \brief Run the MAC: take the driver writes, send what was started, and
+ * interrupt after each frame.
+ */
+static void test_gmac_run(void)
+{
+	Gmac *p_gmac = TEST_GMAC;
+	uint32_t ul_ncr = p_gmac->GMAC_NCR;
+
+	if (gs_model.b_busy) {
+		return;
+	}
+	gs_model.b_busy = true;
+
+	if (p_gmac->GMAC_RBQB != gs_model.ul_rbqb) {
+		if (gs_model.ul_ncr & GMAC_NCR_RXEN) {
+			test_fault("RBQB written while receiving");
+		}
+		gs_model.ul_rbqb = p_gmac->GMAC_RBQB;
+		gs_model.p_rx = test_desc(gs_model.ul_rbqb);
+	}
+	if (p_gmac->GMAC_TBQB != gs_model.ul_tbqb) {
+		if (gs_model.ul_ncr & GMAC_NCR_TXEN) {
+			test_fault("TBQB written while transmitting");
+		}
+		gs_model.ul_tbqb = p_gmac->GMAC_TBQB;
+		gs_model.p_tx = test_desc(gs_model.ul_tbqb);
+	}
+	if (!(ul_ncr & GMAC_NCR_TXEN)) {
+		/* Disabling the transmitter resets it to its queue base. */
+		gs_model.b_tx_go = false;
+		gs_model.p_tx = gs_model.ul_tbqb ? test_desc(gs_model.ul_tbqb) :
+				NULL;
+	}
+	if (ul_ncr & GMAC_NCR_TSTART) {
+		gs_model.ul_tstarts++;
+		gs_model.b_tx_go = (ul_ncr & GMAC_NCR_TXEN) != 0;
+		ul_ncr &= ~GMAC_NCR_TSTART;
+		p_gmac->GMAC_NCR = ul_ncr;
+	}
+	gs_model.ul_ncr = ul_ncr;
+
+	test_gmac_irq();
+	while (gs_model.b_tx_go && test_gmac_send()) {
+		test_gmac_irq();
+	}
+	test_gmac_irq();
+	gs_model.b_busy = false;
+}
+
+/**
+ * \brief A frame from the wire, now.
+ */
+static void test_gmac_wire(const uint8_t *p_frame, uint32_t ul_len)
+{
+	test_gmac_run();
+	gs_model.b_busy = true;
+	test_gmac_receive(p_frame, ul_len);
+	gs_model.b_busy = false;
+	test_gmac_run();
+}
+
+/** Test frame carrying a sequence number, in a buffer of its own. */
+static void test_frame_fill(uint8_t *p_frame, uint32_t ul_len,
+		const uint8_t *p_dst, uint32_t ul_seq)
+{
+	uint32_t i;
+
+	memcpy(p_frame, p_dst, 6);
+	memcpy(p_frame + 6, gs_uc_peer, 6);
+	p_frame[12] = TEST_ETHERTYPE >> 8;
+	p_frame[13] = TEST_ETHERTYPE & 0xFF;
+	for (i = 14; i < ul_len; i++) {
+		p_frame[i] = (uint8_t)(ul_seq + i);
+	}
+	if (ul_len >= 18) {
+		memcpy(p_frame + 14, &ul_seq, 4);
+	}
+}
+
+/** Check a received test frame, \return its sequence number. */
+static uint32_t test_frame_check(const uint8_t *p_frame, uint32_t ul_len,
+		uint32_t ul_expected_len)
+{
+	uint8_t uc_ref[GMAC_FRAME_SIZE_MAX];
+	uint32_t ul_seq;
+
+	memcpy(&ul_seq, p_frame + 14, 4);
+	test_frame_fill(uc_ref, ul_expected_len, p_frame, ul_seq);
+	if (!TEST_CHECK_EQ(ul_len, ul_expected_len) ||
+			!TEST_CHECK(memcmp(p_frame, uc_ref, ul_len) == 0)) {
+		return UINT32_MAX;
+	}
+	return ul_seq;
+}
+
+/**
+ * \brief Reset the MAC and the model, init the driver on the
+ * configuration of gs_cfg and fill the receive ring from the pool.
+ */
+static status_code_t test_init_dev(void)
+{
+	Gmac *p_gmac = TEST_GMAC;
+	status_code_t status;
+	uint32_t i;
+
+	/* Whatever the last test left in the rings goes back to the pool. */
+	if (gs_dev.p_rx) {
+		for (i = 0; i < gs_dev.us_rx_count; i++) {
+			net_buf_free(net_buf_from_data((void *)(uintptr_t)
+					(gs_dev.p_rx[i].ul_addr & GMAC_RXD_ADDR_Msk)));
+		}
+		/* A frame owns the buffers linked to its first one. */
+		bool b_first = true;
+
+		for (i = 0; i < gs_dev.us_tx_posted; i++) {
+			gmac_desc_t *p_desc = &gs_dev.p_tx[(gs_dev.us_tx_reclaim + i) %
+					gs_dev.us_tx_count];
+
+			if (b_first) {
+				net_buf_free(net_buf_from_data((void *)(uintptr_t)
+						p_desc->ul_addr));
+			}
+			b_first = (p_desc->ul_status & GMAC_TXD_LAST) != 0;
+		}
+	}
+	memset(p_gmac, 0, sizeof(*p_gmac));
+	memset(&gs_model, 0, sizeof(gs_model));
+	memset(gs_desc, 0xA5, sizeof(gs_desc));
+	memset(&gs_dev, 0, sizeof(gs_dev));
+	p_gmac->GMAC_IMR = 0xFFFFFFFF;
+	HOST_REG(p_gmac->GMAC_NSR) = GMAC_NSR_IDLE;
+	gs_ul_wire_len = 0;
+
+	status = gmac_init(&gs_dev, p_gmac, &gs_cfg);
+	test_gmac_run();
+	if (status != STATUS_OK) {
+		return status;
+	}
+	for (i = 0; i < gs_cfg.us_rx_count; i++) {
+		net_buf_t *p_buf = net_buf_alloc();
+
+		if (!TEST_CHECK(p_buf != NULL)) {
+			break;
+		}
+		TEST_CHECK(gmac_rx_refill(&gs_dev, net_buf_start(p_buf)));
+	}
+	return status;
+}
+
+/** The configuration of netif.c, in loopback. */
+static void test_cfg_default(void)
+{
+	memset(&gs_cfg, 0, sizeof(gs_cfg));
+	gs_cfg.p_desc = gs_desc;
+	gs_cfg.us_rx_count = CONF_NET_RX_DESC;
+	gs_cfg.us_tx_count = CONF_NET_TX_DESC;
+	gs_cfg.us_rx_buf_size = NET_BUF_SIZE;
+	gs_cfg.ul_mck_hz = 150000000;
+	memcpy(gs_cfg.uc_mac, gs_uc_mac, sizeof(gs_cfg.uc_mac));
+	gs_cfg.b_rmii = true;
+	gs_cfg.b_loopback = true;
+}
+
+/**
+ * \brief Ring layout, MAC setup and management clock.
+ */
+static void test_init(void)
+{
+	static const uint32_t ul_mck[] = {
+		12000000, 20000000, 64000000, 120000000, 150000000, 240000000
+	};
+	Gmac *p_gmac = TEST_GMAC;
+	gmac_desc_t *p_dummy = gs_desc + CONF_NET_RX_DESC + CONF_NET_TX_DESC;
+	uint32_t i;
+
+	test_cfg_default();
+	TEST_CHECK_EQ(gmac_desc_size(&gs_cfg), sizeof(gs_desc));
+	TEST_CHECK_EQ(test_init_dev(), STATUS_OK);
+	TEST_CHECK_EQ(p_gmac->GMAC_RBQB, (uint32_t)(uintptr_t)gs_desc);
+	TEST_CHECK_EQ(p_gmac->GMAC_TBQB,
+			(uint32_t)(uintptr_t)(gs_desc + CONF_NET_RX_DESC));
+	for (i = 0; i < CONF_NET_RX_DESC; i++) {
+		TEST_CHECK_EQ(gs_desc[i].ul_addr & (GMAC_RXD_OWNERSHIP |
+				GMAC_RXD_WRAP), i == CONF_NET_RX_DESC - 1 ?
+				GMAC_RXD_WRAP : 0);
+		TEST_CHECK(net_buf_from_data((void *)(uintptr_t)
+				(gs_desc[i].ul_addr & GMAC_RXD_ADDR_Msk)) != NULL);
+	}
+	for (i = 0; i < CONF_NET_TX_DESC; i++) {
+		TEST_CHECK_EQ(gs_desc[CONF_NET_RX_DESC + i].ul_status,
+				GMAC_TXD_USED | (i == CONF_NET_TX_DESC - 1 ?
+				GMAC_TXD_WRAP : 0));
+	}
+	/* The priority queues idle on a descriptor of their own. */
+	for (i = 0; i < GMAC_PRIORITY_QUEUES; i++) {
+		TEST_CHECK_EQ(p_gmac->GMAC_RBQBAPQ[i],
+				(uint32_t)(uintptr_t)&p_dummy[0]);
+		TEST_CHECK_EQ(p_gmac->GMAC_TBQBAPQ[i],
+				(uint32_t)(uintptr_t)&p_dummy[1]);
+	}
+	TEST_CHECK(p_dummy[0].ul_addr & GMAC_RXD_OWNERSHIP);
+	TEST_CHECK(p_dummy[0].ul_addr & GMAC_RXD_WRAP);
+	TEST_CHECK(p_dummy[1].ul_status & GMAC_TXD_USED);
+	TEST_CHECK(p_dummy[1].ul_status & GMAC_TXD_WRAP);
+
+	TEST_CHECK_EQ((p_gmac->GMAC_DCFGR & GMAC_DCFGR_DRBS_Msk) >>
+			GMAC_DCFGR_DRBS_Pos, NET_BUF_SIZE / GMAC_RX_UNIT_SIZE);
+	TEST_CHECK_EQ(p_gmac->GMAC_SA[0].GMAC_SAB, gs_uc_mac[0] |
+			(gs_uc_mac[1] << 8) | (gs_uc_mac[2] << 16) |
+			((uint32_t)gs_uc_mac[3] << 24));
+	TEST_CHECK_EQ(p_gmac->GMAC_SA[0].GMAC_SAT,
+			gs_uc_mac[4] | (gs_uc_mac[5] << 8));
+	TEST_CHECK_EQ(p_gmac->GMAC_UR & GMAC_UR_RMII, 0);
+	TEST_CHECK(p_gmac->GMAC_NCFGR & GMAC_NCFGR_RFCS);
+	TEST_CHECK(p_gmac->GMAC_NCR & GMAC_NCR_LBL);
+	TEST_CHECK(!(p_gmac->GMAC_NCR & (GMAC_NCR_RXEN | GMAC_NCR_TXEN)));
+	TEST_CHECK_EQ(p_gmac->GMAC_IMR, 0xFFFFFFFF);
+
+	/* Management clock at most 2.5 MHz, as fast as the dividers allow. */
+	for (i = 0; i < sizeof(ul_mck) / sizeof(ul_mck[0]); i++) {
+		static const uint8_t uc_div[] = {8, 16, 32, 48, 64, 96};
+		uint32_t ul_clk;
+
+		gmac_set_mdc_clock(p_gmac, ul_mck[i]);
+		ul_clk = (p_gmac->GMAC_NCFGR & GMAC_NCFGR_CLK_Msk) >>
+				GMAC_NCFGR_CLK_Pos;
+		TEST_CHECK(ul_mck[i] / uc_div[ul_clk] <= 2500000);
+		TEST_CHECK(!ul_clk || ul_mck[i] / uc_div[ul_clk - 1] > 2500000);
+	}
+
+	/* Descriptors or buffers the GMAC cannot use. */
+	gs_cfg.p_desc = (gmac_desc_t *)((uint8_t *)gs_desc + 4);
+	TEST_CHECK_EQ(gmac_init(&gs_dev, p_gmac, &gs_cfg), ERR_INVALID_ARG);
+	test_cfg_default();
+	gs_cfg.us_tx_count = 0;
+	TEST_CHECK_EQ(gmac_init(&gs_dev, p_gmac, &gs_cfg), ERR_INVALID_ARG);
+	test_cfg_default();
+	gs_cfg.us_rx_buf_size = 1518;
+	TEST_CHECK_EQ(gmac_init(&gs_dev, p_gmac, &gs_cfg), ERR_INVALID_ARG);
+	gs_cfg.us_rx_buf_size = GMAC_FRAME_SIZE_MAX + 32;
+	TEST_CHECK_EQ(gmac_init(&gs_dev, p_gmac, &gs_cfg), ERR_INVALID_ARG);
+	test_cfg_default();
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+/**
+ * \brief Frames from the wire: filtered, handed over in place and in
+ * order, lost while the ring has no buffer.
+ */
+static void test_rx(void)
+{
+	uint8_t uc_frame[GMAC_FRAME_SIZE_MAX];
+	uint32_t ul_next = 0;
+	uint32_t ul_sent, ul_len;
+	void *p_taken[CONF_NET_RX_DESC];
+	void *p_data;
+	uint32_t i;
+
+	test_cfg_default();
+	gs_cfg.b_loopback = false;
+	TEST_CHECK_EQ(test_init_dev(), STATUS_OK);
+	TEST_CHECK_EQ(net_buf_get_free(), CONF_NET_BUF_COUNT - CONF_NET_RX_DESC);
+
+	/* Nothing before the receiver is on. */
+	test_frame_fill(uc_frame, 64, gs_uc_mac, 0);
+	test_gmac_wire(uc_frame, 64);
+	TEST_CHECK(!gmac_rx_pending(&gs_dev));
+	gmac_enable(&gs_dev, true);
+
+	/* Ours and broadcast only. */
+	test_frame_fill(uc_frame, 64, gs_uc_peer, 0);
+	test_gmac_wire(uc_frame, 64);
+	test_frame_fill(uc_frame, 64, (const uint8_t *)"\xFF\xFF\xFF\xFF\xFF\xFF",
+			0);
+	test_gmac_wire(uc_frame, 64);
+	TEST_CHECK_EQ(gs_model.ul_filtered, 1);
+	TEST_CHECK_EQ(gs_model.ul_received, 1);
+
+	/* Three times round the ring, with the buffers swapped for new ones
+	 * as the stack would. */
+	for (ul_sent = 0; ul_sent < 3 * CONF_NET_RX_DESC; ) {
+		for (i = 0; i < 4; i++, ul_sent++) {
+			uint32_t ul_len = 60 + (ul_sent * 97) % (GMAC_FRAME_SIZE_MAX - 60);
+
+			test_frame_fill(uc_frame, ul_len, gs_uc_mac, ul_sent);
+			test_gmac_wire(uc_frame, ul_len);
+		}
+		while (gmac_rx_pending(&gs_dev)) {
+			net_buf_t *p_buf;
+
+			p_data = gmac_rx_take(&gs_dev, &ul_len);
+			p_buf = net_buf_from_data(p_data);
+			if (!TEST_CHECK(p_buf != NULL)) {
+				break;
+			}
+			TEST_CHECK(p_data == net_buf_start(p_buf));
+			if (ul_next) {
+				TEST_CHECK_EQ(test_frame_check(p_data, ul_len,
+						60 + ((ul_next - 1) * 97) % (GMAC_FRAME_SIZE_MAX - 60)),
+						ul_next - 1);
+			}
+			ul_next++;
+			net_buf_free(p_buf);
+			TEST_CHECK(gmac_rx_refill(&gs_dev,
+					net_buf_start(net_buf_alloc())));
+		}
+	}
+	TEST_CHECK_EQ(ul_next, 1 + 3 * CONF_NET_RX_DESC);
+	TEST_CHECK(gmac_rx_take(&gs_dev, &ul_len) == NULL);
+	TEST_CHECK_EQ(net_buf_get_free(), CONF_NET_BUF_COUNT - CONF_NET_RX_DESC);
+
+	/* Not refilled: the frames past the ring are lost, the slots taken
+	 * stay with the software, and the ring picks up again once refilled. */
+	for (i = 0; i < CONF_NET_RX_DESC + 3; i++) {
+		test_frame_fill(uc_frame, 64, gs_uc_mac, i);
+		test_gmac_wire(uc_frame, 64);
+	}
+	TEST_CHECK_EQ(gs_model.ul_lost, 3);
+	for (i = 0; i < CONF_NET_RX_DESC; i++) {
+		p_taken[i] = gmac_rx_take(&gs_dev, &ul_len);
+		if (!TEST_CHECK(p_taken[i] != NULL)) {
+			break;
+		}
+		TEST_CHECK_EQ(test_frame_check(p_taken[i], ul_len, 64), i);
+	}
+	test_frame_fill(uc_frame, 64, gs_uc_mac, 98);
+	test_gmac_wire(uc_frame, 64);
+	TEST_CHECK_EQ(gs_model.ul_lost, 4);
+	for (i = 0; i < CONF_NET_RX_DESC; i++) {
+		TEST_CHECK_EQ(test_frame_check(p_taken[i], 64, 64), i);
+		TEST_CHECK(gmac_rx_refill(&gs_dev, p_taken[i]));
+	}
+	test_frame_fill(uc_frame, 64, gs_uc_mac, 99);
+	test_gmac_wire(uc_frame, 64);
+	p_data = gmac_rx_take(&gs_dev, &ul_len);
+	TEST_CHECK_EQ(test_frame_check(p_data, ul_len, 64), 99);
+	TEST_CHECK(gmac_rx_refill(&gs_dev, p_data));
+	TEST_CHECK_EQ(gs_dev.ul_rx_frames, gs_model.ul_received);
+	TEST_CHECK_EQ(gs_dev.ul_rx_errors, 0);
+
+	/* Everyone's, in promiscuous mode. */
+	gs_cfg.b_promiscuous = true;
+	TEST_CHECK_EQ(test_init_dev(), STATUS_OK);
+	gmac_enable(&gs_dev, true);
+	test_frame_fill(uc_frame, 64, gs_uc_peer, 7);
+	test_gmac_wire(uc_frame, 64);
+	TEST_CHECK(gmac_rx_pending(&gs_dev));
+	TEST_CHECK_EQ(gs_model.ul_filtered, 0);
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+/** Reclaim the sent frames into the pool, \return how many. */
+static uint32_t test_reclaim(void)
+{
+	uint32_t ul_count = 0;
+	void *p_data;
+
+	while ((p_data = gmac_tx_reclaim(&gs_dev)) != NULL) {
+		net_buf_free(net_buf_from_data(p_data));
+		ul_count++;
+	}
+	return ul_count;
+}
+
+/**
+ * \brief Post a test frame built in up to three pool buffers.
+ */
+static bool test_post(uint32_t ul_seq, uint32_t ul_len, uint32_t ul_segs)
+{
+	uint8_t uc_frame[GMAC_FRAME_SIZE_MAX];
+	gmac_seg_t segs[3];
+	net_buf_t *p_head = NULL, **p_p_link = &p_head;
+	uint32_t ul_done = 0;
+	uint32_t i;
+
+	test_frame_fill(uc_frame, ul_len, gs_uc_mac, ul_seq);
+	for (i = 0; i < ul_segs; i++) {
+		uint32_t ul_seg = i == ul_segs - 1 ? ul_len - ul_done :
+				(ul_len / ul_segs) | 1;
+		net_buf_t *p_buf = net_buf_alloc();
+
+		if (!p_buf) {
+			net_buf_free(p_head);
+			return false;
+		}
+		*p_p_link = p_buf;
+		p_p_link = &p_buf->p_next;
+		memcpy(p_buf->p_data, uc_frame + ul_done, ul_seg);
+		p_buf->us_len = ul_seg;
+		segs[i].p_data = p_buf->p_data;
+		segs[i].ul_len = ul_seg;
+		ul_done += ul_seg;
+	}
+	if (!gmac_tx_post(&gs_dev, segs, ul_segs)) {
+		net_buf_free(p_head);
+		return false;
+	}
+	return true;
+}
+
+/** Length of the test frame of a sequence number, from 60 to 1459. */
+static uint32_t test_tx_len(uint32_t ul_seq)
+{
+	return 60 + (ul_seq * 397) % 1400;
+}
+
+/**
+ * \brief Check the frames looped back, in sequence from \a p_ul_next, and
+ * put their buffers back in the ring.
+ */
+static void test_tx_drain(uint32_t *p_ul_next)
+{
+	uint32_t ul_len;
+	void *p_data;
+
+	while ((p_data = gmac_rx_take(&gs_dev, &ul_len)) != NULL) {
+		TEST_CHECK_EQ(test_frame_check(p_data, ul_len,
+				test_tx_len(*p_ul_next)), *p_ul_next);
+		(*p_ul_next)++;
+		TEST_CHECK(gmac_rx_refill(&gs_dev, p_data));
+	}
+}
+
+/**
+ * \brief Frames of several buffers go out as one, in order, from one
+ * start, across the end of the ring.
+ */
+static void test_tx(void)
+{
+	uint32_t ul_seq = 0;
+	uint32_t ul_next = 0;
+	uint32_t ul_len;
+	void *p_data;
+	uint32_t i, j;
+
+	test_cfg_default();
+	TEST_CHECK_EQ(test_init_dev(), STATUS_OK);
+	gmac_enable(&gs_dev, true);
+
+	/* Queued, not sent until started. */
+	for (i = 0; i < 3; i++, ul_seq++) {
+		TEST_CHECK(test_post(ul_seq, test_tx_len(ul_seq), i + 1));
+	}
+	TEST_CHECK_EQ(gmac_tx_free(&gs_dev), CONF_NET_TX_DESC - 6);
+	test_gmac_run();
+	TEST_CHECK_EQ(gs_model.ul_sent, 0);
+	TEST_CHECK(!gmac_tx_done_pending(&gs_dev));
+	gmac_tx_start(&gs_dev);
+	TEST_CHECK_EQ(gs_model.ul_sent, 3);
+	TEST_CHECK(gmac_tx_done_pending(&gs_dev));
+	TEST_CHECK_EQ(test_reclaim(), 3);
+	TEST_CHECK_EQ(gmac_tx_free(&gs_dev), CONF_NET_TX_DESC);
+	test_tx_drain(&ul_next);
+	TEST_CHECK_EQ(ul_next, 3);
+
+	/* More descriptors than free: refused whole. */
+	for (i = 0; i < CONF_NET_TX_DESC / 3; i++, ul_seq++) {
+		TEST_CHECK(test_post(ul_seq, test_tx_len(ul_seq), 3));
+	}
+	TEST_CHECK(!test_post(ul_seq, test_tx_len(ul_seq),
+			CONF_NET_TX_DESC % 3 + 1));
+	TEST_CHECK(test_post(ul_seq, test_tx_len(ul_seq), CONF_NET_TX_DESC % 3));
+	ul_seq++;
+	TEST_CHECK_EQ(gmac_tx_free(&gs_dev), 0);
+	TEST_CHECK(!test_post(ul_seq, test_tx_len(ul_seq), 1));
+	gmac_tx_start(&gs_dev);
+	test_tx_drain(&ul_next);
+
+	/* Round the ring a few times, with frames straddling its end. */
+	for (j = 0; j < 5; j++) {
+		for (i = 0; i < 4; i++, ul_seq++) {
+			test_reclaim();
+			TEST_CHECK(test_post(ul_seq, test_tx_len(ul_seq),
+					1 + (i + j) % 3));
+		}
+		gmac_tx_start(&gs_dev);
+		test_tx_drain(&ul_next);
+	}
+	test_reclaim();
+	TEST_CHECK_EQ(ul_next, ul_seq);
+	TEST_CHECK_EQ(gs_dev.ul_tx_frames, ul_seq);
+	TEST_CHECK_EQ(gs_dev.ul_tx_errors, 0);
+	TEST_CHECK_EQ(gmac_tx_free(&gs_dev), CONF_NET_TX_DESC);
+	/* Every sent buffer is back. */
+	TEST_CHECK_EQ(net_buf_get_free(), CONF_NET_BUF_COUNT - CONF_NET_RX_DESC);
+
+	/* The driver pads nothing, the MAC pads short frames. */
+	TEST_CHECK(test_post(ul_seq, 20, 1));
+	gmac_tx_start(&gs_dev);
+	TEST_CHECK_EQ(gs_ul_wire_len, 20);
+	p_data = gmac_rx_take(&gs_dev, &ul_len);
+	TEST_CHECK_EQ(ul_len, 60);
+	TEST_CHECK(gmac_rx_refill(&gs_dev, p_data));
+	TEST_CHECK_EQ(test_reclaim(), 1);
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+static uint32_t gs_ul_cb_isr;
+
+static void test_callback(gmac_dev_t *p_dev, uint32_t ul_isr)
+{
+	gs_ul_cb_isr |= ul_isr;
+}
+
+/**
+ * \brief A retry limit error stops the transmitter: the frames queued come
+ * back as failed and the transmitter restarts at the base of its ring.
+ */
+static void test_tx_fault(void)
+{
+	uint32_t ul_len;
+	void *p_data;
+	uint32_t i;
+
+	test_cfg_default();
+	TEST_CHECK_EQ(test_init_dev(), STATUS_OK);
+	gmac_set_callback(&gs_dev, test_callback, NULL);
+	gmac_enable_interrupt(&gs_dev, GMAC_IER_RCOMP | GMAC_IER_TX_FAULTS);
+	NVIC_EnableIRQ(GMAC_IRQn);
+	gmac_enable(&gs_dev, true);
+
+	/* Move away from the ring base first. */
+	for (i = 0; i < 5; i++) {
+		TEST_CHECK(test_post(i, 64, 1));
+	}
+	gmac_tx_start(&gs_dev);
+	TEST_CHECK_EQ(test_reclaim(), 5);
+
+	gs_model.ul_tx_fail = 1;
+	for (i = 0; i < 3; i++) {
+		TEST_CHECK(test_post(10 + i, 64, 2));
+	}
+	gmac_tx_start(&gs_dev);
+	TEST_CHECK(gs_ul_cb_isr & GMAC_IER_RLEX);
+	TEST_CHECK(gs_dev.b_tx_fault);
+	TEST_CHECK(!test_post(20, 64, 1));
+
+	/* Reclaimed as failed; then the transmitter is back. */
+	TEST_CHECK_EQ(test_reclaim(), 3);
+	TEST_CHECK_EQ(gs_dev.ul_tx_errors, 3);
+	test_reclaim();
+	TEST_CHECK(!gs_dev.b_tx_fault);
+	TEST_CHECK(gs_model.ul_ncr & GMAC_NCR_TXEN);
+	TEST_CHECK(gs_model.p_tx == gs_dev.p_tx);
+	TEST_CHECK(test_post(30, 64, 2));
+	gmac_tx_start(&gs_dev);
+	TEST_CHECK_EQ(test_reclaim(), 1);
+	TEST_CHECK_EQ(gs_dev.ul_tx_frames, 6);
+
+	for (i = 0; (p_data = gmac_rx_take(&gs_dev, &ul_len)) != NULL; i++) {
+		static const uint32_t ul_seqs[] = {0, 1, 2, 3, 4, 30};
+
+		if (TEST_CHECK(i < 6)) {
+			TEST_CHECK_EQ(test_frame_check(p_data, ul_len, 64), ul_seqs[i]);
+		}
+		gmac_rx_refill(&gs_dev, p_data);
+	}
+	TEST_CHECK_EQ(i, 6);
+	NVIC_DisableIRQ(GMAC_IRQn);
+	gmac_set_callback(&gs_dev, NULL, NULL);
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+/** A way of moving frames, for the benchmark. */
+typedef struct {
+	const char *p_name;
+	/** Frames per gmac_tx_start(). */
+	uint32_t ul_tx_batch;
+	/** Buffers per frame. */
+	uint32_t ul_segs;
+	/**
+	 * Receive as netif.c does: the interrupt masks itself and the frames
+	 * are polled CONF_NET_RX_BUDGET at a time. Otherwise the interrupt
+	 * takes the frames and stays on.
+	 */
+	bool b_coalesce;
+} test_bench_t;
+
+static const test_bench_t gs_benches[] = {
+	{"irq per frame", 1, 1, false},
+	{"coalesced", 1, 1, true},
+	{"coalesced, tx 8", 8, 1, true},
+	{"sg 2, tx 8", 8, 2, true},
+};
+
+static const test_bench_t *gs_p_bench;
+static bool gs_b_rx_poll;
+static uint32_t gs_ul_rx_seq;
+static uint32_t gs_ul_rx_bad;
+static uint32_t gs_ul_polls;
+
+/**
+ * \brief Up to \a ul_budget frames to the stack, which checks and frees
+ * them; the ring gets new buffers in their place.
+ */
+static uint32_t test_bench_rx(uint32_t ul_budget)
+{
+	uint32_t ul_done;
+
+	for (ul_done = 0; ul_done < ul_budget; ul_done++) {
+		uint32_t ul_len, ul_seq;
+		void *p_data = gmac_rx_take(&gs_dev, &ul_len);
+
+		if (!p_data) {
+			break;
+		}
+		memcpy(&ul_seq, (uint8_t *)p_data + 14, 4);
+		gs_ul_rx_bad += ul_len != TEST_FRAME_LEN || ul_seq != gs_ul_rx_seq ||
+				((uint8_t *)p_data)[TEST_FRAME_LEN - 1] !=
+				(uint8_t)(ul_seq + TEST_FRAME_LEN - 1);
+		gs_ul_rx_seq++;
+		net_buf_free(net_buf_from_data(p_data));
+		gmac_rx_refill(&gs_dev, net_buf_start(net_buf_alloc()));
+	}
+	return ul_done;
+}
+
+static void test_bench_callback(gmac_dev_t *p_dev, uint32_t ul_isr)
+{
+	if (!(ul_isr & GMAC_IER_RCOMP)) {
+		return;
+	}
+	if (gs_p_bench->b_coalesce) {
+		gmac_disable_interrupt(p_dev, GMAC_IER_RCOMP);
+		gs_b_rx_poll = true;
+	} else {
+		test_bench_rx(UINT32_MAX);
+	}
+}
+
+/**
+ * \brief The receive poll of netif.c, the flag standing for the task
+ * notification.
+ */
+static void test_bench_poll(void)
+{
+	while (gs_b_rx_poll) {
+		gs_b_rx_poll = false;
+		for (;;) {
+			uint32_t ul_done = test_bench_rx(CONF_NET_RX_BUDGET);
+
+			gs_ul_polls++;
+			if (ul_done == CONF_NET_RX_BUDGET) {
+				continue;
+			}
+			gmac_enable_interrupt(&gs_dev, GMAC_IER_RCOMP);
+			if (!gmac_rx_pending(&gs_dev)) {
+				break;
+			}
+			gmac_disable_interrupt(&gs_dev, GMAC_IER_RCOMP);
+		}
+	}
+}
+
+/**
+ * \brief Frames per second through the driver, the pool and the model, in
+ * loopback, with the interrupts and starts that each way costs.
+ */
+static void test_throughput(void)
+{
+	const uint32_t ul_frames = 200000;
+	uint32_t i;
+
+	printf("  %-16s %10s %8s %8s %8s\n", "mode", "frames/s", "irq/fr",
+			"start/fr", "poll/fr");
+	for (i = 0; i < sizeof(gs_benches) / sizeof(gs_benches[0]); i++) {
+		uint32_t ul_queued = 0;
+		double d_start, d_time;
+
+		gs_p_bench = &gs_benches[i];
+		gs_b_rx_poll = false;
+		gs_ul_rx_seq = gs_ul_rx_bad = gs_ul_polls = 0;
+		test_cfg_default();
+		TEST_CHECK_EQ(test_init_dev(), STATUS_OK);
+		gmac_set_callback(&gs_dev, test_bench_callback, NULL);
+		gmac_enable_interrupt(&gs_dev, GMAC_IER_RCOMP | GMAC_IER_TX_FAULTS);
+		NVIC_EnableIRQ(GMAC_IRQn);
+		gmac_enable(&gs_dev, true);
+
+		d_start = test_seconds();
+		while (gs_ul_rx_seq < ul_frames) {
+			uint32_t ul_batch = Min(gs_p_bench->ul_tx_batch,
+					ul_frames - ul_queued);
+			uint32_t j;
+
+			test_reclaim();
+			for (j = 0; j < ul_batch; j++) {
+				if (!test_post(ul_queued, TEST_FRAME_LEN,
+						gs_p_bench->ul_segs)) {
+					break;
+				}
+				ul_queued++;
+			}
+			if (j) {
+				gmac_tx_start(&gs_dev);
+			}
+			test_bench_poll();
+			if (!j && !gmac_tx_done_pending(&gs_dev) &&
+					!gmac_rx_pending(&gs_dev)) {
+				/* Nothing moves any more. */
+				break;
+			}
+		}
+		d_time = test_seconds() - d_start;
+		test_reclaim();
+		printf("  %-16s %10.0f %8.3f %8.3f %8.3f\n", gs_p_bench->p_name,
+				ul_frames / d_time, (double)gs_model.ul_irqs / ul_frames,
+				(double)gs_model.ul_tstarts / ul_frames,
+				(double)gs_ul_polls / ul_frames);
+		TEST_CHECK_EQ(gs_ul_rx_seq, ul_frames);
+		TEST_CHECK_EQ(gs_ul_rx_bad, 0);
+		TEST_CHECK_EQ(gs_model.ul_lost, 0);
+		TEST_CHECK_EQ(gs_model.ul_faults, 0);
+		TEST_CHECK_EQ(net_buf_get_free(),
+				CONF_NET_BUF_COUNT - CONF_NET_RX_DESC);
+		TEST_CHECK(gs_model.ul_tstarts <= ul_frames /
+				gs_p_bench->ul_tx_batch + 1);
+		if (gs_p_bench->b_coalesce && gs_p_bench->ul_tx_batch > 1) {
+			/* Per burst, not per frame: the first frame, and the flag
+			 * the others raised once the poll turns the interrupt back
+			 * on. */
+			TEST_CHECK(gs_model.ul_irqs <= 2 * (ul_frames /
+					gs_p_bench->ul_tx_batch + 1));
+		}
+		NVIC_DisableIRQ(GMAC_IRQn);
+		gmac_set_callback(&gs_dev, NULL, NULL);
+	}
+}
+
+int main(void)
+{
+	test_init();
+	test_rx();
+	test_tx();
+	test_tx_fault();
+	test_throughput();
+	return test_end("gmac");
+}
@@ -0,0 +1,144 @@
+/**
+ * \file
+ *
+ * \brief Host test of the GPIO events through the PIO interrupt dispatch,
+ * against a model of the PIO interrupt registers.
+ *
+ */
+
+#include <string.h>
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+#include "pio.h"
+#include "pio_handler.h"
+#include "conf_gpio_event.h"
+#include "gpio_event.h"
+#include "test.h"
+
+/** Pins of the test, on PIOA, and one of another handler between them. */
+#define TEST_PIN_LOW    PIO_PA3_IDX
+#define TEST_PIN_HIGH   PIO_PA17_IDX
+#define TEST_PIN_OTHER  PIO_PA30_IDX
+
+#define TEST_EVENTS     32
+
+static SemaphoreHandle_t gs_x_done;
+static gpio_event_t gs_events[TEST_EVENTS];
+static uint32_t gs_ul_events;
+
+static void test_callback(const gpio_event_t *p_event, void *p_ctx)
+{
+	if (gs_ul_events < TEST_EVENTS) {
+		gs_events[gs_ul_events++] = *p_event;
+	}
+	xSemaphoreGive(gs_x_done);
+}
+
+/**
+ * \brief Handler of another driver, first in the walk: it takes its time
+ * and the pins move meanwhile.
+ */
+static void test_other_isr(uint32_t ul_id, uint32_t ul_mask,
+		const pio_handler_snapshot_t *p_snapshot, void *p_ctx)
+{
+	DWT->CYCCNT += 1000;
+	HOST_REG(PIOA->PIO_PDSR) ^= 0xFFFFFFFF;
+}
+
+/**
+ * \brief Raise the PIOA interrupt with pins pending, as the controller
+ * would.
+ */
+static void test_pio_irq(uint32_t ul_pending, uint32_t ul_levels,
+		uint32_t ul_cycles)
+{
+	HOST_REG(PIOA->PIO_ISR) = ul_pending;
+	HOST_REG(PIOA->PIO_IMR) = PIO_PA3 | PIO_PA17 | PIO_PA30;
+	HOST_REG(PIOA->PIO_PDSR) = ul_levels;
+	DWT->CYCCNT = ul_cycles;
+	host_irq(PIOA_IRQn, PIOA_Handler);
+}
+
+/**
+ * \brief Wait for the consumer task to run the callbacks of \a ul_count
+ * events in all.
+ */
+static bool test_wait_events(uint32_t ul_count)
+{
+	while (gs_ul_events < ul_count) {
+		if (xSemaphoreTake(gs_x_done, 1000) != pdTRUE) {
+			return TEST_CHECK_EQ(gs_ul_events, ul_count);
+		}
+	}
+	return TEST_CHECK_EQ(gs_ul_events, ul_count);
+}
+
+/**
+ * \brief Pins pending together get the stamp and levels of the interrupt
+ * entry, whatever runs before them.
+ */
+static void test_snapshot(void)
+{
+	test_pio_irq(PIO_PA3 | PIO_PA17 | PIO_PA30, PIO_PA17, 5000);
+	if (!test_wait_events(2)) {
+		return;
+	}
+	/* From the highest pin down. */
+	TEST_CHECK_EQ(gs_events[0].ul_pin, TEST_PIN_HIGH);
+	TEST_CHECK_EQ(gs_events[0].ul_stamp, 5000);
+	TEST_CHECK_EQ(gs_events[0].b_level, true);
+	TEST_CHECK_EQ(gs_events[1].ul_pin, TEST_PIN_LOW);
+	TEST_CHECK_EQ(gs_events[1].ul_stamp, 5000);
+	TEST_CHECK_EQ(gs_events[1].b_level, false);
+
+	/* One pin, another interrupt. */
+	test_pio_irq(PIO_PA3, PIO_PA3, 9000);
+	if (test_wait_events(3)) {
+		TEST_CHECK_EQ(gs_events[2].ul_pin, TEST_PIN_LOW);
+		TEST_CHECK_EQ(gs_events[2].ul_stamp, 9000);
+		TEST_CHECK_EQ(gs_events[2].b_level, true);
+	}
+}
+
+/**
+ * \brief Edges of a pin unregistered before the task ran are dropped.
+ */
+static void test_unregister(void)
+{
+	gpio_event_stats_t stats;
+
+	vTaskSuspendAll();
+	test_pio_irq(PIO_PA3 | PIO_PA17, 0, 100);
+	gpio_event_unregister(TEST_PIN_HIGH);
+	xTaskResumeAll();
+	test_wait_events(4);
+	vTaskDelay(10);
+	TEST_CHECK_EQ(gs_ul_events, 4);
+	TEST_CHECK_EQ(gs_events[3].ul_pin, TEST_PIN_LOW);
+
+	gpio_event_get_stats(&stats);
+	TEST_CHECK_EQ(stats.ul_events, 5);
+	TEST_CHECK_EQ(stats.ul_overruns, 0);
+	TEST_CHECK_EQ(PIOA->PIO_IDR, PIO_PA17);
+}
+
+int main(void)
+{
+	gs_x_done = xSemaphoreCreateCounting(TEST_EVENTS, 0);
+	if (!TEST_CHECK(gs_x_done != NULL) || !TEST_CHECK(gpio_event_init())) {
+		return test_end("gpio_event");
+	}
+	TEST_CHECK(gpio_event_register(TEST_PIN_LOW, PIO_IT_EDGE,
+			GPIO_EVENT_NO_FILTER, 0, test_callback, NULL));
+	TEST_CHECK(gpio_event_register(TEST_PIN_HIGH, PIO_IT_EDGE,
+			GPIO_EVENT_GLITCH, 0, test_callback, NULL));
+	TEST_CHECK_EQ(pio_handler_set_pin_ctx(TEST_PIN_OTHER, PIO_IT_EDGE,
+			test_other_isr, NULL), 0);
+	TEST_CHECK(PIOA->PIO_IFER & PIO_PA17);
+	TEST_CHECK(host_nvic.uc_enabled[PIOA_IRQn]);
+
+	test_snapshot();
+	test_unregister();
+	return test_end("gpio_event");
+}
@@ -0,0 +1,383 @@
+/**
+ * \file
+ *
+ * \brief Host test of the LED pattern engine, against a model of the PWM
+ * channel registers: the duty cycles it programs, period after period.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <asf.h>
+#include "conf_led_pattern.h"
+#include "clock_scale.h"
+#include "led_pattern.h"
+#include "test.h"
+
+/** Channel of the LED of the test. */
+#define TEST_CH             PIN_PWM_LED0_CHANNEL
+#define TEST_CH_MASK        (1u << TEST_CH)
+
+/** Carrier period, one CLKA period per level, as in led_pattern.c. */
+#define TEST_LEVELS         255
+
+/** CDTYUPD when nothing was written to it since the last update. */
+#define TEST_NO_UPDATE      0xFFFFFFFFu
+
+/** Carrier periods recorded, several loops of every program. */
+#define TEST_PERIODS        9000
+
+/** Duty cycle of each carrier period, and the interrupts taken. */
+static uint32_t gs_ul_duty[TEST_PERIODS];
+static uint32_t gs_ul_irqs;
+
+static uint32_t gs_ul_mck = 150000000;
+static struct clock_scale_notifier *gs_p_notifier;
+
+uint32_t clock_scale_get_peripheral_hz(void)
+{
+	return gs_ul_mck;
+}
+
+void clock_scale_register(struct clock_scale_notifier *p_notifier)
+{
+	gs_p_notifier = p_notifier;
+}
+
+/**
+ * \brief PWM model: the status and mask registers follow the writes to the
+ * enable and disable registers. The engine disables before it enables,
+ * which is the order they are applied in.
+ */
+static void test_pwm_sync(void)
+{
+	Pwm *p_pwm = CONF_LED_PATTERN_PWM;
+
+	host_lock();
+	HOST_REG(p_pwm->PWM_SR) &= ~p_pwm->PWM_DIS;
+	p_pwm->PWM_DIS = 0;
+	HOST_REG(p_pwm->PWM_SR) |= p_pwm->PWM_ENA;
+	p_pwm->PWM_ENA = 0;
+	HOST_REG(p_pwm->PWM_IMR1) &= ~p_pwm->PWM_IDR1;
+	p_pwm->PWM_IDR1 = 0;
+	HOST_REG(p_pwm->PWM_IMR1) |= p_pwm->PWM_IER1;
+	p_pwm->PWM_IER1 = 0;
+	host_unlock();
+}
+
+/**
+ * \brief PWM model: end of a period of the channel. A duty cycle written to
+ * CDTYUPD takes effect for the next period, then the counter event raises
+ * the interrupt if it is enabled.
+ *
+ * \return Duty cycle of the next period, 0 if the channel is stopped.
+ */
+static uint32_t test_pwm_period(void)
+{
+	Pwm *p_pwm = CONF_LED_PATTERN_PWM;
+	PwmCh_num *p_ch = &p_pwm->PWM_CH_NUM[TEST_CH];
+	uint32_t ul_duty;
+
+	test_pwm_sync();
+	if (!(p_pwm->PWM_SR & TEST_CH_MASK)) {
+		return 0;
+	}
+	if (p_ch->PWM_CDTYUPD != TEST_NO_UPDATE) {
+		p_ch->PWM_CDTY = p_ch->PWM_CDTYUPD;
+		p_ch->PWM_CDTYUPD = TEST_NO_UPDATE;
+	}
+	ul_duty = p_ch->PWM_CDTY;
+	TEST_CHECK(ul_duty <= p_ch->PWM_CPRD);
+
+	HOST_REG(p_pwm->PWM_ISR1) = TEST_CH_MASK;
+	if (p_pwm->PWM_IMR1 & TEST_CH_MASK) {
+		host_irq(CONF_LED_PATTERN_PWM_IRQn, CONF_LED_PATTERN_PWM_Handler);
+		gs_ul_irqs++;
+	}
+	HOST_REG(p_pwm->PWM_ISR1) = 0;
+	test_pwm_sync();
+
+	return ul_duty;
+}
+
+/**
+ * \brief Record the duty cycles of \a ul_count periods.
+ */
+static void test_run(uint32_t ul_count)
+{
+	uint32_t i;
+
+	gs_ul_irqs = 0;
+	for (i = 0; i < ul_count; i++) {
+		gs_ul_duty[i] = test_pwm_period();
+	}
+}
+
+/**
+ * \brief Frequency of CLKA or CLKB as programmed in PWM_CLK.
+ */
+static double test_clk_hz(uint32_t ul_clk)
+{
+	uint32_t ul_div = ul_clk & PWM_CLK_DIVA_Msk;
+
+	if (!ul_div) {
+		return 0;
+	}
+	return (double)(gs_ul_mck >> ((ul_clk & PWM_CLK_PREA_Msk) >>
+			PWM_CLK_PREA_Pos)) / ul_div;
+}
+
+/**
+ * \brief Carrier frequency of a channel clocked by CLKA.
+ */
+static double test_carrier_hz(void)
+{
+	Pwm *p_pwm = CONF_LED_PATTERN_PWM;
+
+	return test_clk_hz(p_pwm->PWM_CLK) /
+			p_pwm->PWM_CH_NUM[TEST_CH].PWM_CPRD;
+}
+
+/**
+ * \brief Check the lit and dark runs of a recorded on/off program against
+ * one loop of it, in carrier periods.
+ */
+static void test_check_runs(const uint32_t *p_runs, uint32_t ul_count)
+{
+	uint32_t ul_full = TEST_LEVELS;
+	uint32_t ul_run = 0;
+	uint32_t ul_len;
+	uint32_t i;
+
+	for (i = 0; i < TEST_PERIODS; i += ul_len) {
+		for (ul_len = 0; i + ul_len < TEST_PERIODS &&
+				gs_ul_duty[i + ul_len] == gs_ul_duty[i]; ul_len++) {
+		}
+		if (i + ul_len == TEST_PERIODS) {
+			break;
+		}
+		/* Fully on or off, at the start of the program run. */
+		if (!TEST_CHECK(gs_ul_duty[i] == 0 || gs_ul_duty[i] == ul_full) ||
+				!TEST_CHECK_EQ(ul_len, p_runs[ul_run])) {
+			printf("run %lu at period %lu\n", (unsigned long)ul_run,
+					(unsigned long)i);
+			return;
+		}
+		/* Runs alternate, and every loop restarts lit. */
+		TEST_CHECK_EQ(gs_ul_duty[i] != 0, !(ul_run & 1));
+		ul_run = (ul_run + 1) % ul_count;
+	}
+}
+
+/**
+ * \brief The clocks and the carrier after init: CLKA gives the carrier,
+ * CLKB counts ms, LEDs off, polarity for LEDs lit by a low pin.
+ */
+static void test_init(void)
+{
+	Pwm *p_pwm = CONF_LED_PATTERN_PWM;
+	PwmCh_num *p_ch = &p_pwm->PWM_CH_NUM[TEST_CH];
+
+	memset(p_pwm, 0, sizeof(*p_pwm));
+	p_ch->PWM_CDTYUPD = TEST_NO_UPDATE;
+	TEST_CHECK(led_pattern_init());
+	test_pwm_sync();
+
+	TEST_CHECK(gs_p_notifier != NULL);
+	TEST_CHECK(host_nvic.uc_enabled[CONF_LED_PATTERN_PWM_IRQn]);
+	TEST_CHECK(p_pwm->PWM_SR & TEST_CH_MASK);
+	TEST_CHECK_EQ(p_pwm->PWM_IMR1 & TEST_CH_MASK, 0);
+	TEST_CHECK_EQ(p_ch->PWM_CMR & PWM_CMR_CPRE_Msk, PWM_CMR_CPRE_CLKA);
+	TEST_CHECK_EQ(!!(p_ch->PWM_CMR & PWM_CMR_CPOL),
+			CONF_LED_PATTERN_POLARITY == PWM_HIGH);
+	TEST_CHECK_EQ(p_ch->PWM_CDTY, 0);
+	TEST_CHECK_NEAR(test_carrier_hz(), CONF_LED_PATTERN_PWM_HZ,
+			CONF_LED_PATTERN_PWM_HZ / 100);
+	TEST_CHECK_NEAR(test_clk_hz(p_pwm->PWM_CLK >> 16), 1000, 10);
+}
+
+/**
+ * \brief Steady levels: the duty cycle goes as the square of the level,
+ * rises with it from off to fully on, and needs no interrupt.
+ */
+static void test_levels(void)
+{
+	uint32_t ul_prev = 0;
+	uint32_t ul_duty;
+	uint32_t i;
+
+	for (i = 0; i <= 255; i++) {
+		TEST_CHECK(led_pattern_set(LED_PATTERN_LED0, (uint8_t)i));
+		test_run(2);
+		ul_duty = gs_ul_duty[1];
+		TEST_CHECK_EQ(ul_duty, (i * i + 254) / 255);
+		TEST_CHECK(ul_duty >= ul_prev);
+		/* A lit LED never rounds to off. */
+		TEST_CHECK_EQ(ul_duty == 0, i == 0);
+		ul_prev = ul_duty;
+		TEST_CHECK_EQ(gs_ul_irqs, 0);
+	}
+	TEST_CHECK_EQ(ul_prev, TEST_LEVELS);
+	TEST_CHECK(!led_pattern_set(LED_PATTERN_NUM, 0));
+}
+
+/**
+ * \brief Blinks and the busy status: one period of the channel on CLKB,
+ * no interrupt.
+ */
+static void test_blink(void)
+{
+	Pwm *p_pwm = CONF_LED_PATTERN_PWM;
+	PwmCh_num *p_ch = &p_pwm->PWM_CH_NUM[TEST_CH];
+
+	TEST_CHECK(led_pattern_blink(LED_PATTERN_LED0, 300, 700));
+	test_run(10);
+	TEST_CHECK_EQ(p_ch->PWM_CMR & PWM_CMR_CPRE_Msk, PWM_CMR_CPRE_CLKB);
+	TEST_CHECK_EQ(p_ch->PWM_CPRD, 1000);
+	TEST_CHECK_EQ(gs_ul_duty[9], 300);
+	TEST_CHECK_EQ(gs_ul_irqs, 0);
+
+	TEST_CHECK(led_pattern_status(LED_PATTERN_LED0, LED_STATUS_BUSY));
+	test_run(10);
+	TEST_CHECK_EQ(p_ch->PWM_CPRD, 100);
+	TEST_CHECK_EQ(gs_ul_duty[9], 50);
+	TEST_CHECK_EQ(gs_ul_irqs, 0);
+
+	TEST_CHECK(!led_pattern_blink(LED_PATTERN_LED0, 0, 0));
+	TEST_CHECK(!led_pattern_blink(LED_PATTERN_LED0, 60000, 6000));
+
+	/* Back to the carrier. */
+	TEST_CHECK(led_pattern_status(LED_PATTERN_LED0, LED_STATUS_FAULT));
+	test_run(2);
+	TEST_CHECK_EQ(p_ch->PWM_CMR & PWM_CMR_CPRE_Msk, PWM_CMR_CPRE_CLKA);
+	TEST_CHECK_EQ(gs_ul_duty[1], TEST_LEVELS);
+}
+
+/**
+ * \brief The heartbeat and a blink code play their steps for as long as
+ * they last, loop after loop.
+ */
+static void test_programs(void)
+{
+	/* Heartbeat: two 80 ms pulses, 120 ms apart, each second. */
+	static const uint32_t ul_heartbeat[] = { 80, 120, 80, 720 };
+	/* Three flashes of 200 ms, 300 ms apart, and a 1.5 s pause. */
+	static const uint32_t ul_code[] = { 200, 300, 200, 300, 200, 1800 };
+
+	TEST_CHECK(led_pattern_status(LED_PATTERN_LED0, LED_STATUS_HEARTBEAT));
+	test_run(TEST_PERIODS);
+	test_check_runs(ul_heartbeat, 4);
+	/* The program is stepped from the counter event of each period. */
+	TEST_CHECK_EQ(gs_ul_irqs, TEST_PERIODS);
+
+	TEST_CHECK(led_pattern_code(LED_PATTERN_LED0, 3));
+	test_run(TEST_PERIODS);
+	test_check_runs(ul_code, 6);
+	TEST_CHECK(!led_pattern_code(LED_PATTERN_LED0, 0));
+	TEST_CHECK(!led_pattern_code(LED_PATTERN_LED0,
+			CONF_LED_PATTERN_CODE_MAX + 1));
+
+	/* A steady level stops the program and its interrupt. */
+	TEST_CHECK(led_pattern_set(LED_PATTERN_LED0, 0));
+	test_run(100);
+	TEST_CHECK_EQ(gs_ul_irqs, 0);
+	TEST_CHECK_EQ(CONF_LED_PATTERN_PWM->PWM_IMR1 & TEST_CH_MASK, 0);
+	TEST_CHECK_EQ(gs_ul_duty[99], 0);
+}
+
+/**
+ * \brief Breathing: the duty cycle ramps up then down, by no more than the
+ * square law moves for one step tick of the level, from off to fully on.
+ */
+static void test_breathe(void)
+{
+	uint32_t ul_tick = CONF_LED_PATTERN_PWM_HZ / CONF_LED_PATTERN_STEP_HZ;
+	uint32_t ul_loop = 2000 * CONF_LED_PATTERN_PWM_HZ / 1000;
+	/* Up to 3 levels a tick, 255 in 100 ticks, at two duty counts per
+	 * level at the top of the square law, and its rounding. */
+	int32_t l_max_step = 2 * 3 + 1;
+	uint32_t ul_max = 0;
+	uint32_t ul_min = 0xFFFFFFFF;
+	uint32_t ul_turns = 0;
+	int32_t l_dir = 0;
+	int32_t l_step;
+	uint32_t i;
+
+	TEST_CHECK(led_pattern_breathe(LED_PATTERN_LED0, 2000));
+	test_run(TEST_PERIODS);
+
+	for (i = 1; i < TEST_PERIODS; i++) {
+		l_step = (int32_t)gs_ul_duty[i] - (int32_t)gs_ul_duty[i - 1];
+		if (i % ul_tick) {
+			/* The duty cycle only moves on step ticks. */
+			if (!TEST_CHECK_EQ(l_step, 0)) {
+				return;
+			}
+			continue;
+		}
+		if (!TEST_CHECK(abs(l_step) <= l_max_step)) {
+			printf("period %lu: %lu to %lu\n", (unsigned long)i,
+					(unsigned long)gs_ul_duty[i - 1],
+					(unsigned long)gs_ul_duty[i]);
+			return;
+		}
+		if (l_step && (l_step > 0) != (l_dir > 0)) {
+			ul_turns++;
+			l_dir = l_step;
+		}
+		ul_max = Max(ul_max, gs_ul_duty[i]);
+		ul_min = Min(ul_min, gs_ul_duty[i]);
+	}
+	TEST_CHECK_EQ(ul_max, TEST_LEVELS);
+	TEST_CHECK_EQ(ul_min, 0);
+	/* One way up and one way down per breath. */
+	TEST_CHECK_NEAR(ul_turns, 2 * TEST_PERIODS / ul_loop, 1);
+	/* And a loop later, the same again. */
+	TEST_CHECK(memcmp(&gs_ul_duty[ul_loop], &gs_ul_duty[2 * ul_loop],
+			ul_loop * sizeof(gs_ul_duty[0])) == 0);
+
+	TEST_CHECK(!led_pattern_breathe(LED_PATTERN_LED0, 1));
+}
+
+/**
+ * \brief The carrier and the blink clock are regenerated at each MCK of
+ * the operating points.
+ */
+static void test_clock(void)
+{
+	static const uint32_t ul_mck[] = { 75000000, 12000000, 150000000 };
+	Pwm *p_pwm = CONF_LED_PATTERN_PWM;
+	clock_scale_freq_t freq;
+	uint32_t i;
+
+	if (!TEST_CHECK(gs_p_notifier != NULL)) {
+		return;
+	}
+	TEST_CHECK(led_pattern_status(LED_PATTERN_LED0, LED_STATUS_IDLE));
+	for (i = 0; i < sizeof(ul_mck) / sizeof(ul_mck[0]); i++) {
+		freq.ul_mck_hz = ul_mck[i];
+		freq.ul_cpu_hz = 2 * ul_mck[i];
+		gs_p_notifier->callback(CLOCK_SCALE_PRE_CHANGE, &freq,
+				gs_p_notifier->p_ctx);
+		gs_ul_mck = ul_mck[i];
+		gs_p_notifier->callback(CLOCK_SCALE_POST_CHANGE, &freq,
+				gs_p_notifier->p_ctx);
+		TEST_CHECK_NEAR(test_carrier_hz(), CONF_LED_PATTERN_PWM_HZ,
+				CONF_LED_PATTERN_PWM_HZ / 50);
+		TEST_CHECK_NEAR(test_clk_hz(p_pwm->PWM_CLK >> 16), 1000, 10);
+		/* The program goes on. */
+		test_run(100);
+		TEST_CHECK_EQ(gs_ul_irqs, 100);
+	}
+}
+
+int main(void)
+{
+	test_init();
+	test_levels();
+	test_blink();
+	test_programs();
+	test_breathe();
+	test_clock();
+	return test_end("led_pattern");
+}
@@ -0,0 +1,1297 @@
+/**
+ * \file
+ *
+ * \brief Host test of the MCAN driver, against a model of the controller
+ * and its message RAM, with a frame rate benchmark.
+ *
+ * The model reads the layout registers and the element formats of the
+ * datasheet: it finds the filters, FIFOs and elements through SIDFC,
+ * XIDFC, RXFnC, TXBC and the CCFG high address bits, filters the frames
+ * it receives, stores them in the receive FIFOs and sends the transmit
+ * FIFO elements requested through TXBAR, back into its own FIFOs in
+ * loopback. It flags the accesses that break the controller rules:
+ * elements out of the message RAM, acknowledges past the fill level,
+ * transmit requests out of FIFO order.
+ *
+ * The driver keeps its Mcan pointer, so its accesses cannot be trapped one
+ * by one. The model runs between driver calls, and at each barrier of the
+ * driver: frames may arrive between the read of a fill level and the
+ * acknowledge, as on the bus. Writes to the acknowledge, TXBAR and IR
+ * registers are seen from the values the model left there.
+ *
+ */
+
+#include <string.h>
+#include <asf.h>
+#include "conf_can_bus.h"
+#include "test.h"
+
+static void test_mcan_barrier(void);
+static void test_mcan_run(void);
+
+/* mcan.c is built into the test, with the model running at its barriers. */
+#undef __DMB
+#define __DMB()             test_mcan_barrier()
+#include "mcan.c"
+
+/*
+ * The controller updates its status as soon as it is written: the model
+ * runs around each driver call that reads or writes it.
+ */
+#define TEST_RUN_AROUND(call) ({ \
+	test_mcan_run(); \
+	__typeof__(call) x_ret = (call); \
+	test_mcan_run(); \
+	x_ret; \
+})
+#define mcan_rx_fifo_read(...)  TEST_RUN_AROUND(mcan_rx_fifo_read(__VA_ARGS__))
+#define mcan_rx_fifo_level(...) TEST_RUN_AROUND(mcan_rx_fifo_level(__VA_ARGS__))
+#define mcan_tx_fifo_write(...) TEST_RUN_AROUND(mcan_tx_fifo_write(__VA_ARGS__))
+#define mcan_tx_fifo_free(...)  TEST_RUN_AROUND(mcan_tx_fifo_free(__VA_ARGS__))
+#define mcan_tx_is_idle(...)    TEST_RUN_AROUND(mcan_tx_is_idle(__VA_ARGS__))
+
+#define TEST_MCAN           MCAN0
+#define TEST_CLOCK_HZ \
+	(BOARD_FREQ_MAINCK_XTAL / (CONF_CAN_BUS_PCK_PRES + 1))
+
+/** Message RAM, not crossing a 64 Kbyte window. */
+#define TEST_RAM_WORDS      4096
+static uint32_t gs_ul_ram[TEST_RAM_WORDS]
+		__attribute__((aligned(TEST_RAM_WORDS * 4)));
+
+/** RXFnA while not written since the model ran. */
+#define TEST_NO_ACK         0xFFFFFFFFu
+
+/**
+ * Kept pending in IR: no driver enables it, so every write to IR, a mask
+ * of the flags to clear, differs from what the model left there.
+ */
+#define TEST_IR_KEPT        MCAN_IR_TSW
+
+/** Frames logged as sent on the bus. */
+#define TEST_SENT_MAX       64
+
+/** Frames queued to arrive at the driver barriers. */
+#define TEST_INJECT_MAX     16
+
+/** Payload length of each data length code, from the datasheet. */
+static const uint8_t gs_uc_test_dlc_len[16] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64
+};
+
+/** Receive FIFO state. */
+typedef struct {
+	uint32_t ul_get;
+	uint32_t ul_put;
+	uint32_t ul_fill;
+} test_fifo_t;
+
+/** Controller state, besides its registers. */
+static struct {
+	/** Interrupt flags. */
+	uint32_t ul_ir;
+	test_fifo_t rx[2];
+	uint32_t ul_tx_get;
+	uint32_t ul_tx_put;
+	/** Bit times since reset, and timeout counter in ticks. */
+	uint64_t ull_bits;
+	uint32_t ul_toc;
+	/** Frames the bus may still carry out of the transmit FIFO. */
+	uint32_t ul_tx_left;
+	bool b_busy;
+	/** What the driver did. */
+	uint32_t ul_acks;
+	uint32_t ul_txbar_writes;
+	uint32_t ul_irqs;
+	/** Rules broken. */
+	uint32_t ul_faults;
+	/** Frames received: stored, lost on a full FIFO, rejected. */
+	uint32_t ul_stored;
+	uint32_t ul_lost;
+	uint32_t ul_rejected;
+} gs_model;
+
+static mcan_frame_t gs_sent[TEST_SENT_MAX];
+static uint32_t gs_ul_sent;
+
+static mcan_frame_t gs_inject[TEST_INJECT_MAX];
+static uint32_t gs_ul_inject_get;
+static uint32_t gs_ul_inject_put;
+
+static mcan_dev_t gs_dev;
+static mcan_config_t gs_cfg;
+
+/** Interrupt callback: flags seen, and frames read, as can_bus.c would. */
+static uint32_t gs_ul_cb_ir;
+static uint32_t gs_ul_cb_calls;
+static bool gs_b_cb_read;
+static mcan_frame_t gs_cb_frames[MCAN_RX_FIFO_MAX];
+static uint32_t gs_ul_cb_frames;
+/** Frames read out of order, each carrying its number as id and data. */
+static bool gs_b_cb_check;
+static uint32_t gs_ul_cb_bad;
+
+static void test_fault(const char *p_what)
+{
+	printf("mcan model: %s\n", p_what);
+	gs_model.ul_faults++;
+}
+
+/**
+ * \brief Word of the message RAM at an offset of the controller window,
+ * NULL and a fault if out of the RAM given to the driver.
+ */
+static volatile uint32_t *test_ram(uint32_t ul_offset, uint32_t ul_words)
+{
+	uint32_t ul_addr = (MATRIX->CCFG_CAN0 & CCFG_CAN0_CAN0DMABA_Msk) |
+			(ul_offset & 0xFFFF);
+	uint32_t ul_base = (uint32_t)(uintptr_t)gs_ul_ram;
+
+	if (ul_addr < ul_base || ul_addr + 4 * ul_words > ul_base +
+			mcan_ram_size(&gs_cfg)) {
+		test_fault("element out of the message RAM");
+		return NULL;
+	}
+	return (volatile uint32_t *)(uintptr_t)ul_addr;
+}
+
+/** Element payload size of an F0DS, F1DS or TBDS code. */
+static uint32_t test_elem_data(uint32_t ul_code)
+{
+	return gs_uc_test_dlc_len[8 + (ul_code & 7)];
+}
+
+static uint32_t test_frame_bits(const mcan_frame_t *p_frame)
+{
+	return ((p_frame->uc_flags & MCAN_FRAME_EXT) ? 67 : 47) +
+			8 * p_frame->uc_len;
+}
+
+/**
+ * \brief Advance the bus time: timestamps and the FIFO 0 timeout.
+ */
+static void test_mcan_bits(uint32_t ul_bits)
+{
+	Mcan *p_mcan = TEST_MCAN;
+	uint32_t ul_tick = ((p_mcan->MCAN_TSCC & MCAN_TSCC_TCP_Msk) >>
+			MCAN_TSCC_TCP_Pos) + 1;
+	uint32_t ul_before = gs_model.ull_bits / ul_tick;
+	uint32_t ul_ticks;
+
+	gs_model.ull_bits += ul_bits;
+	ul_ticks = gs_model.ull_bits / ul_tick - ul_before;
+	HOST_REG(p_mcan->MCAN_TSCV) = (gs_model.ull_bits / ul_tick) & 0xFFFF;
+
+	/* FIFO 0 control: counting down while it holds frames. */
+	if ((p_mcan->MCAN_TOCC & MCAN_TOCC_ETOC) &&
+			(p_mcan->MCAN_TOCC & MCAN_TOCC_TOS_Msk) ==
+			MCAN_TOCC_TOS_RX0_EV_TIMEOUT && gs_model.rx[0].ul_fill &&
+			gs_model.ul_toc) {
+		if (ul_ticks >= gs_model.ul_toc) {
+			gs_model.ul_toc = 0;
+			gs_model.ul_ir |= MCAN_IR_TOO;
+		} else {
+			gs_model.ul_toc -= ul_ticks;
+		}
+	}
+}
+
+/**
+ * \brief First filter of a list deciding on an identifier.
+ *
+ * \return The filter element configuration (0 for no match), and its
+ * index in \a p_index.
+ */
+static uint32_t test_filter(const mcan_frame_t *p_frame, uint32_t *p_index)
+{
+	Mcan *p_mcan = TEST_MCAN;
+	uint32_t ul_id = p_frame->ul_id;
+	uint32_t i;
+
+	if (p_frame->uc_flags & MCAN_FRAME_EXT) {
+		uint32_t ul_count = (p_mcan->MCAN_XIDFC & MCAN_XIDFC_LSE_Msk) >>
+				MCAN_XIDFC_LSE_Pos;
+		uint32_t ul_masked = ul_id & p_mcan->MCAN_XIDAM;
+		volatile uint32_t *p_list = test_ram(
+				p_mcan->MCAN_XIDFC & MCAN_XIDFC_FLESA_Msk, 2 * ul_count);
+
+		for (i = 0; p_list && i < ul_count; i++) {
+			uint32_t ul_efec = p_list[2 * i] >> 29;
+			uint32_t ul_id1 = p_list[2 * i] & 0x1FFFFFFF;
+			uint32_t ul_id2 = p_list[2 * i + 1] & 0x1FFFFFFF;
+			bool b_match;
+
+			switch (p_list[2 * i + 1] >> 30) {
+			case 0:
+				b_match = ul_masked >= ul_id1 && ul_masked <= ul_id2;
+				break;
+			case 1:
+				b_match = ul_masked == ul_id1 || ul_masked == ul_id2;
+				break;
+			case 2:
+				b_match = (ul_masked & ul_id2) == (ul_id1 & ul_id2);
+				break;
+			default:
+				b_match = ul_id >= ul_id1 && ul_id <= ul_id2;
+				break;
+			}
+			if (ul_efec > 3) {
+				test_fault("extended filter action not used by the driver");
+			}
+			if (ul_efec && b_match) {
+				*p_index = i;
+				return ul_efec;
+			}
+		}
+	} else {
+		uint32_t ul_count = (p_mcan->MCAN_SIDFC & MCAN_SIDFC_LSS_Msk) >>
+				MCAN_SIDFC_LSS_Pos;
+		volatile uint32_t *p_list = test_ram(
+				p_mcan->MCAN_SIDFC & MCAN_SIDFC_FLSSA_Msk, ul_count);
+
+		for (i = 0; p_list && i < ul_count; i++) {
+			uint32_t ul_sfec = (p_list[i] >> 27) & 7;
+			uint32_t ul_id1 = (p_list[i] >> 16) & 0x7FF;
+			uint32_t ul_id2 = p_list[i] & 0x7FF;
+			bool b_match;
+
+			switch (p_list[i] >> 30) {
+			case 0:
+				b_match = ul_id >= ul_id1 && ul_id <= ul_id2;
+				break;
+			case 1:
+				b_match = ul_id == ul_id1 || ul_id == ul_id2;
+				break;
+			case 2:
+				b_match = (ul_id & ul_id2) == (ul_id1 & ul_id2);
+				break;
+			default:
+				b_match = false;
+				break;
+			}
+			if (ul_sfec > 3) {
+				test_fault("standard filter action not used by the driver");
+			}
+			if (ul_sfec && b_match) {
+				*p_index = i;
+				return ul_sfec;
+			}
+		}
+	}
+	return 0;
+}
+
+static void test_fifo_status(uint32_t ul_fifo)
+{
+	Mcan *p_mcan = TEST_MCAN;
+	test_fifo_t *p_fifo = &gs_model.rx[ul_fifo];
+	uint32_t ul_size = ((ul_fifo ? p_mcan->MCAN_RXF1C : p_mcan->MCAN_RXF0C) &
+			MCAN_RXF0C_F0S_Msk) >> MCAN_RXF0C_F0S_Pos;
+	uint32_t ul_status = (p_fifo->ul_fill << MCAN_RXF0S_F0FL_Pos) |
+			(p_fifo->ul_get << MCAN_RXF0S_F0GI_Pos) |
+			(p_fifo->ul_put << MCAN_RXF0S_F0PI_Pos) |
+			(p_fifo->ul_fill == ul_size ? MCAN_RXF0S_F0F : 0);
+
+	if (ul_fifo) {
+		HOST_REG(p_mcan->MCAN_RXF1S) = ul_status;
+	} else {
+		HOST_REG(p_mcan->MCAN_RXF0S) = ul_status;
+	}
+}
+
+/**
+ * \brief A frame comes in, from the bus or looped back: filtered and
+ * stored in a receive FIFO.
+ */
+static void test_mcan_receive(const mcan_frame_t *p_frame)
+{
+	Mcan *p_mcan = TEST_MCAN;
+	uint32_t ul_index = 0;
+	uint32_t ul_action = test_filter(p_frame, &ul_index);
+	uint32_t ul_fifo, ul_size, ul_wm, ul_data, ul_dlc;
+	uint32_t ul_r0, ul_r1;
+	volatile uint32_t *p_elem;
+	test_fifo_t *p_fifo;
+	uint32_t ul_fc;
+
+	test_mcan_bits(test_frame_bits(p_frame));
+	if (p_mcan->MCAN_CCCR & MCAN_CCCR_INIT) {
+		/* Off the bus. */
+		return;
+	}
+	if (!ul_action) {
+		/* Non-matching: ANFS or ANFE, 0 FIFO 0, 1 FIFO 1, else reject. */
+		uint32_t ul_anf = (p_frame->uc_flags & MCAN_FRAME_EXT) ?
+				(p_mcan->MCAN_GFC & MCAN_GFC_ANFE_Msk) >> MCAN_GFC_ANFE_Pos :
+				(p_mcan->MCAN_GFC & MCAN_GFC_ANFS_Msk) >> MCAN_GFC_ANFS_Pos;
+
+		ul_action = ul_anf < 2 ? ul_anf + 1 : 3;
+		ul_index = MCAN_FILTER_NONE;
+	}
+	if (ul_action == 3) {
+		gs_model.ul_rejected++;
+		return;
+	}
+	ul_fifo = ul_action - 1;
+	p_fifo = &gs_model.rx[ul_fifo];
+	ul_fc = ul_fifo ? p_mcan->MCAN_RXF1C : p_mcan->MCAN_RXF0C;
+	ul_size = (ul_fc & MCAN_RXF0C_F0S_Msk) >> MCAN_RXF0C_F0S_Pos;
+	ul_wm = (ul_fc & MCAN_RXF0C_F0WM_Msk) >> MCAN_RXF0C_F0WM_Pos;
+	ul_data = test_elem_data(p_mcan->MCAN_RXESC >> (ul_fifo ? 4 : 0));
+
+	if (p_fifo->ul_fill == ul_size) {
+		/* Blocking mode: the new frame is lost. */
+		gs_model.ul_lost++;
+		gs_model.ul_ir |= ul_fifo ? MCAN_IR_RF1L : MCAN_IR_RF0L;
+		return;
+	}
+	p_elem = test_ram((ul_fc & MCAN_RXF0C_F0SA_Msk) +
+			4 * p_fifo->ul_put * (2 + ul_data / 4), 2 + ul_data / 4);
+	if (!p_elem) {
+		return;
+	}
+	ul_dlc = p_frame->uc_len;
+	if (p_frame->uc_len > 8) {
+		for (ul_dlc = 9; gs_uc_test_dlc_len[ul_dlc] < p_frame->uc_len;
+				ul_dlc++) {
+		}
+	}
+	if (p_frame->uc_flags & MCAN_FRAME_EXT) {
+		ul_r0 = (1u << 30) | (p_frame->ul_id & 0x1FFFFFFF);
+	} else {
+		ul_r0 = (p_frame->ul_id & 0x7FF) << 18;
+	}
+	ul_r0 |= (p_frame->uc_flags & MCAN_FRAME_RTR) ? 1u << 29 : 0;
+	ul_r0 |= (p_frame->uc_flags & MCAN_FRAME_ESI) ? 1u << 31 : 0;
+	ul_r1 = (ul_index == MCAN_FILTER_NONE ? 1u << 31 : ul_index << 24) |
+			((p_frame->uc_flags & MCAN_FRAME_FD) ? 1u << 21 : 0) |
+			((p_frame->uc_flags & MCAN_FRAME_BRS) ? 1u << 20 : 0) |
+			(ul_dlc << 16) | (p_mcan->MCAN_TSCV & 0xFFFF);
+	p_elem[0] = ul_r0;
+	p_elem[1] = ul_r1;
+	memcpy((void *)&p_elem[2], p_frame->uc_data,
+			Min(gs_uc_test_dlc_len[ul_dlc], ul_data));
+
+	if (!p_fifo->ul_fill && !ul_fifo) {
+		/* The timeout counts from the first frame of an empty FIFO 0. */
+		gs_model.ul_toc = (p_mcan->MCAN_TOCC & MCAN_TOCC_TOP_Msk) >>
+				MCAN_TOCC_TOP_Pos;
+	}
+	p_fifo->ul_put = (p_fifo->ul_put + 1) % ul_size;
+	p_fifo->ul_fill++;
+	gs_model.ul_stored++;
+	gs_model.ul_ir |= ul_fifo ? MCAN_IR_RF1N : MCAN_IR_RF0N;
+	if (ul_wm && p_fifo->ul_fill == ul_wm) {
+		gs_model.ul_ir |= ul_fifo ? MCAN_IR_RF1W : MCAN_IR_RF0W;
+	}
+	if (p_fifo->ul_fill == ul_size) {
+		gs_model.ul_ir |= ul_fifo ? MCAN_IR_RF1F : MCAN_IR_RF0F;
+	}
+	test_fifo_status(ul_fifo);
+}
+
+/**
+ * \brief Acknowledge of a receive FIFO: releases the elements up to the
+ * index written, which must hold a frame.
+ */
+static void test_mcan_ack(uint32_t ul_fifo, uint32_t ul_ack)
+{
+	Mcan *p_mcan = TEST_MCAN;
+	test_fifo_t *p_fifo = &gs_model.rx[ul_fifo];
+	uint32_t ul_size = ((ul_fifo ? p_mcan->MCAN_RXF1C : p_mcan->MCAN_RXF0C) &
+			MCAN_RXF0C_F0S_Msk) >> MCAN_RXF0C_F0S_Pos;
+	uint32_t ul_count = (ul_ack + ul_size - p_fifo->ul_get) % ul_size + 1;
+
+	gs_model.ul_acks++;
+	if (ul_ack >= ul_size || ul_count > p_fifo->ul_fill) {
+		test_fault("acknowledge of an empty element");
+		return;
+	}
+	p_fifo->ul_get = (ul_ack + 1) % ul_size;
+	p_fifo->ul_fill -= ul_count;
+	if (!ul_fifo && !p_fifo->ul_fill) {
+		gs_model.ul_toc = 0;
+	}
+	test_fifo_status(ul_fifo);
+}
+
+/**
+ * \brief Send the oldest requested transmit element on the bus.
+ *
+ * \return false if there is none.
+ */
+static bool test_mcan_send(void)
+{
+	Mcan *p_mcan = TEST_MCAN;
+	uint32_t ul_data = test_elem_data(p_mcan->MCAN_TXESC);
+	uint32_t ul_bit = 1u << gs_model.ul_tx_get;
+	uint32_t ul_size = (p_mcan->MCAN_TXBC & MCAN_TXBC_TFQS_Msk) >>
+			MCAN_TXBC_TFQS_Pos;
+	uint32_t ul_cmr = p_mcan->MCAN_CCCR & MCAN_CCCR_CMR_Msk;
+	volatile uint32_t *p_elem;
+	mcan_frame_t frame;
+	uint32_t ul_dlc;
+
+	if (!(p_mcan->MCAN_TXBRP & ul_bit) ||
+			(p_mcan->MCAN_CCCR & MCAN_CCCR_INIT)) {
+		return false;
+	}
+	p_elem = test_ram((p_mcan->MCAN_TXBC & MCAN_TXBC_TBSA_Msk) +
+			4 * gs_model.ul_tx_get * (2 + ul_data / 4), 2 + ul_data / 4);
+	if (!p_elem) {
+		return false;
+	}
+	memset(&frame, 0, sizeof(frame));
+	if (p_elem[0] & (1u << 30)) {
+		frame.ul_id = p_elem[0] & 0x1FFFFFFF;
+		frame.uc_flags |= MCAN_FRAME_EXT;
+	} else {
+		frame.ul_id = (p_elem[0] >> 18) & 0x7FF;
+	}
+	frame.uc_flags |= (p_elem[0] & (1u << 29)) ? MCAN_FRAME_RTR : 0;
+	ul_dlc = (p_elem[1] >> 16) & 0xF;
+	/* The format of every frame follows CCCR.CMR on this revision. */
+	if (ul_cmr == MCAN_CCCR_CMR_FD ||
+			ul_cmr == MCAN_CCCR_CMR_FD_BITRATE_SWITCH) {
+		frame.uc_flags |= MCAN_FRAME_FD;
+		frame.uc_flags |= ul_cmr == MCAN_CCCR_CMR_FD_BITRATE_SWITCH ?
+				MCAN_FRAME_BRS : 0;
+		frame.uc_len = gs_uc_test_dlc_len[ul_dlc];
+	} else {
+		frame.uc_len = Min(ul_dlc, 8);
+	}
+	if (frame.uc_len > ul_data) {
+		test_fault("transmit element longer than its room");
+		frame.uc_len = ul_data;
+	}
+	memcpy(frame.uc_data, (const void *)&p_elem[2], frame.uc_len);
+	if (gs_ul_sent < TEST_SENT_MAX) {
+		gs_sent[gs_ul_sent] = frame;
+	}
+	gs_ul_sent++;
+
+	HOST_REG(p_mcan->MCAN_TXBRP) &= ~ul_bit;
+	HOST_REG(p_mcan->MCAN_TXBTO) |= ul_bit;
+	if (p_mcan->MCAN_TXBTIE & ul_bit) {
+		gs_model.ul_ir |= MCAN_IR_TC;
+	}
+	gs_model.ul_tx_get = (gs_model.ul_tx_get + 1) % ul_size;
+	if (p_mcan->MCAN_TEST & MCAN_TEST_LBCK) {
+		test_mcan_receive(&frame);
+	} else {
+		test_mcan_bits(test_frame_bits(&frame));
+	}
+	return true;
+}
+
+static void test_tx_status(void)
+{
+	Mcan *p_mcan = TEST_MCAN;
+	uint32_t ul_size = (p_mcan->MCAN_TXBC & MCAN_TXBC_TFQS_Msk) >>
+			MCAN_TXBC_TFQS_Pos;
+	uint32_t ul_used = 0;
+	uint32_t i;
+
+	for (i = 0; i < ul_size; i++) {
+		ul_used += (p_mcan->MCAN_TXBRP >> i) & 1;
+	}
+	HOST_REG(p_mcan->MCAN_TXFQS) =
+			((ul_size - ul_used) << MCAN_TXFQS_TFFL_Pos) |
+			(gs_model.ul_tx_get << MCAN_TXFQS_TFGI_Pos) |
+			(gs_model.ul_tx_put << MCAN_TXFQS_TFQPI_Pos) |
+			(ul_used == ul_size ? MCAN_TXFQS_TFQF : 0);
+}
+
+/**
+ * \brief Take the writes of the driver since the model last ran.
+ */
+static void test_mcan_writes(void)
+{
+	Mcan *p_mcan = TEST_MCAN;
+	uint32_t ul_size = (p_mcan->MCAN_TXBC & MCAN_TXBC_TFQS_Msk) >>
+			MCAN_TXBC_TFQS_Pos;
+	uint32_t ul_req;
+
+	if (p_mcan->MCAN_IR != (gs_model.ul_ir | TEST_IR_KEPT)) {
+		gs_model.ul_ir &= ~p_mcan->MCAN_IR;
+	}
+	if (p_mcan->MCAN_RXF0A != TEST_NO_ACK) {
+		test_mcan_ack(0, p_mcan->MCAN_RXF0A & MCAN_RXF0A_F0AI_Msk);
+		p_mcan->MCAN_RXF0A = TEST_NO_ACK;
+	}
+	if (p_mcan->MCAN_RXF1A != TEST_NO_ACK) {
+		test_mcan_ack(1, p_mcan->MCAN_RXF1A & MCAN_RXF1A_F1AI_Msk);
+		p_mcan->MCAN_RXF1A = TEST_NO_ACK;
+	}
+	ul_req = p_mcan->MCAN_TXBAR;
+	if (ul_req) {
+		gs_model.ul_txbar_writes++;
+		/* A FIFO takes its requests from the put index on, in order. */
+		while (ul_req && ul_size) {
+			uint32_t ul_bit = 1u << gs_model.ul_tx_put;
+
+			if (!(ul_req & ul_bit) || (p_mcan->MCAN_TXBRP & ul_bit)) {
+				test_fault("transmit request out of FIFO order");
+				break;
+			}
+			ul_req &= ~ul_bit;
+			HOST_REG(p_mcan->MCAN_TXBRP) |= ul_bit;
+			HOST_REG(p_mcan->MCAN_TXBTO) &= ~ul_bit;
+			gs_model.ul_tx_put = (gs_model.ul_tx_put + 1) % ul_size;
+		}
+		p_mcan->MCAN_TXBAR = 0;
+	}
+	/* Leaving initialization after a bus off starts the recovery. */
+	if ((p_mcan->MCAN_PSR & MCAN_PSR_BO) &&
+			!(p_mcan->MCAN_CCCR & MCAN_CCCR_INIT)) {
+		HOST_REG(p_mcan->MCAN_PSR) &= ~MCAN_PSR_BO;
+	}
+	test_tx_status();
+}
+
+static void test_mcan_isr(void)
+{
+	TEST_MCAN->MCAN_IR = gs_model.ul_ir | TEST_IR_KEPT;
+	MCAN0_Handler();
+	test_mcan_writes();
+}
+
+/**
+ * \brief Interrupt the driver while an enabled flag is set.
+ */
+static void test_mcan_irq(void)
+{
+	Mcan *p_mcan = TEST_MCAN;
+	uint32_t ul_loops = 0;
+
+	while ((gs_model.ul_ir & p_mcan->MCAN_IE) &&
+			(p_mcan->MCAN_ILE & MCAN_ILE_EINT0) &&
+			host_nvic.uc_enabled[MCAN0_IRQn]) {
+		if (++ul_loops > 10) {
+			test_fault("interrupt flags never cleared");
+			break;
+		}
+		gs_model.ul_irqs++;
+		host_irq(MCAN0_IRQn, test_mcan_isr);
+	}
+}
+
+/**
+ * \brief Run the controller: take the driver writes, send the requested
+ * frames one by one, and interrupt.
+ */
+static void test_mcan_run(void)
+{
+	if (gs_model.b_busy) {
+		return;
+	}
+	gs_model.b_busy = true;
+	test_mcan_writes();
+	test_mcan_irq();
+	while (gs_model.ul_tx_left && test_mcan_send()) {
+		gs_model.ul_tx_left--;
+		test_tx_status();
+		test_mcan_irq();
+	}
+	TEST_MCAN->MCAN_IR = gs_model.ul_ir | TEST_IR_KEPT;
+	gs_model.b_busy = false;
+}
+
+/**
+ * \brief A frame from the bus, now.
+ */
+static void test_mcan_bus(const mcan_frame_t *p_frame)
+{
+	test_mcan_run();
+	gs_model.b_busy = true;
+	test_mcan_receive(p_frame);
+	gs_model.b_busy = false;
+	test_mcan_run();
+}
+
+/**
+ * \brief Barrier of the driver: the queued bus frames come in one by one.
+ */
+static void test_mcan_barrier(void)
+{
+	if (gs_model.b_busy) {
+		return;
+	}
+	if (gs_ul_inject_get != gs_ul_inject_put) {
+		gs_model.b_busy = true;
+		test_mcan_receive(&gs_inject[gs_ul_inject_get++ % TEST_INJECT_MAX]);
+		gs_model.b_busy = false;
+	}
+	test_mcan_run();
+}
+
+/**
+ * \brief Reset the controller and the model, and init the driver on the
+ * configuration of gs_cfg.
+ */
+static status_code_t test_init_dev(void)
+{
+	Mcan *p_mcan = TEST_MCAN;
+	status_code_t status;
+
+	memset(p_mcan, 0, sizeof(*p_mcan));
+	memset(&gs_model, 0, sizeof(gs_model));
+	gs_model.ul_tx_left = UINT32_MAX;
+	memset(gs_ul_ram, 0xA5, sizeof(gs_ul_ram));
+	p_mcan->MCAN_XIDAM = MCAN_XIDAM_EIDM_Msk;
+	p_mcan->MCAN_RXF0A = TEST_NO_ACK;
+	p_mcan->MCAN_RXF1A = TEST_NO_ACK;
+	p_mcan->MCAN_IR = TEST_IR_KEPT;
+	gs_ul_sent = 0;
+	gs_ul_inject_get = gs_ul_inject_put = 0;
+	gs_ul_cb_ir = gs_ul_cb_calls = gs_ul_cb_frames = 0;
+	gs_b_cb_read = false;
+
+	status = mcan_init(&gs_dev, p_mcan, gs_ul_ram, &gs_cfg);
+	test_mcan_run();
+	test_fifo_status(0);
+	test_fifo_status(1);
+	return status;
+}
+
+/** The configuration of can_bus.c. */
+static void test_cfg_default(void)
+{
+	memset(&gs_cfg, 0, sizeof(gs_cfg));
+	gs_cfg.ul_clock_hz = TEST_CLOCK_HZ;
+	gs_cfg.ul_bitrate = CONF_CAN_BUS_BITRATE;
+	gs_cfg.ul_data_bitrate = CONF_CAN_BUS_DATA_BITRATE;
+	gs_cfg.mode = CONF_CAN_BUS_MODE;
+	gs_cfg.uc_std_filters = CONF_CAN_BUS_STD_FILTERS;
+	gs_cfg.uc_ext_filters = CONF_CAN_BUS_EXT_FILTERS;
+	gs_cfg.uc_rx0_size = CONF_CAN_BUS_RX0_SIZE;
+	gs_cfg.uc_rx0_watermark = CONF_CAN_BUS_RX0_WATERMARK;
+	gs_cfg.uc_rx1_size = CONF_CAN_BUS_RX1_SIZE;
+	gs_cfg.uc_tx_size = CONF_CAN_BUS_TX_SIZE;
+	gs_cfg.uc_data_size = CONF_CAN_BUS_DATA_SIZE;
+	gs_cfg.nonmatch = MCAN_FILTER_TO_FIFO_0;
+	gs_cfg.ul_rx0_timeout = CONF_CAN_BUS_RX0_TIMEOUT;
+}
+
+static mcan_frame_t test_frame(uint32_t ul_id, uint8_t uc_flags,
+		uint8_t uc_len, uint8_t uc_seed)
+{
+	mcan_frame_t frame;
+	uint32_t i;
+
+	memset(&frame, 0, sizeof(frame));
+	frame.ul_id = ul_id;
+	frame.uc_flags = uc_flags;
+	frame.uc_len = uc_len;
+	for (i = 0; i < MCAN_DATA_MAX; i++) {
+		frame.uc_data[i] = (uint8_t)(uc_seed + i * 7);
+	}
+	return frame;
+}
+
+static void test_callback(mcan_dev_t *p_dev, uint32_t ul_ir)
+{
+	gs_ul_cb_ir |= ul_ir;
+	gs_ul_cb_calls++;
+	if (gs_b_cb_read) {
+		uint32_t ul_count = mcan_rx_fifo_read(p_dev, MCAN_RX_FIFO_0,
+				gs_cb_frames, MCAN_RX_FIFO_MAX);
+		uint32_t ul_id;
+		uint32_t i;
+
+		for (i = 0; gs_b_cb_check && i < ul_count; i++) {
+			memcpy(&ul_id, gs_cb_frames[i].uc_data, 4);
+			gs_ul_cb_bad += gs_cb_frames[i].ul_id != gs_ul_cb_frames + i ||
+					ul_id != gs_ul_cb_frames + i;
+		}
+		gs_ul_cb_frames += ul_count;
+	}
+}
+
+/**
+ * \brief Bit timing of a BTP or FBTP value, from the field layout the two
+ * registers share.
+ */
+static void test_check_timing(uint32_t ul_clock, uint32_t ul_bitrate,
+		uint32_t ul_brp, uint32_t ul_tseg1, uint32_t ul_tseg2)
+{
+	uint32_t ul_tq = 1 + ul_tseg1 + ul_tseg2;
+
+	TEST_CHECK_EQ(ul_clock % (ul_brp * ul_tq), 0);
+	TEST_CHECK_EQ(ul_clock / (ul_brp * ul_tq), ul_bitrate);
+	TEST_CHECK_NEAR((1.0 + ul_tseg1) / ul_tq, 0.8, 0.05);
+}
+
+/**
+ * \brief Layout of the message RAM and controller setup.
+ */
+static void test_init(void)
+{
+	Mcan *p_mcan = TEST_MCAN;
+	uint32_t ul_base = (uint32_t)(uintptr_t)gs_ul_ram;
+	uint32_t ul_words = 2 + CONF_CAN_BUS_DATA_SIZE / 4;
+	uint32_t ul_btp, ul_fbtp;
+
+	test_cfg_default();
+	TEST_CHECK_EQ(mcan_ram_size(&gs_cfg), 4 * (CONF_CAN_BUS_STD_FILTERS +
+			2 * CONF_CAN_BUS_EXT_FILTERS + ul_words *
+			(CONF_CAN_BUS_RX0_SIZE + CONF_CAN_BUS_RX1_SIZE +
+			CONF_CAN_BUS_TX_SIZE)));
+	TEST_CHECK_EQ(test_init_dev(), STATUS_OK);
+
+	TEST_CHECK_EQ(MATRIX->CCFG_CAN0 & CCFG_CAN0_CAN0DMABA_Msk,
+			ul_base & 0xFFFF0000);
+	TEST_CHECK(test_ram(p_mcan->MCAN_SIDFC & MCAN_SIDFC_FLSSA_Msk, 1) ==
+			gs_dev.p_std_filters);
+	TEST_CHECK(test_ram(p_mcan->MCAN_XIDFC & MCAN_XIDFC_FLESA_Msk, 1) ==
+			gs_dev.p_ext_filters);
+	TEST_CHECK(test_ram(p_mcan->MCAN_RXF0C & MCAN_RXF0C_F0SA_Msk, 1) ==
+			gs_dev.p_rx[0]);
+	TEST_CHECK(test_ram(p_mcan->MCAN_RXF1C & MCAN_RXF1C_F1SA_Msk, 1) ==
+			gs_dev.p_rx[1]);
+	TEST_CHECK(test_ram(p_mcan->MCAN_TXBC & MCAN_TXBC_TBSA_Msk,
+			ul_words * CONF_CAN_BUS_TX_SIZE) == gs_dev.p_tx);
+	TEST_CHECK(gs_dev.p_std_filters == gs_ul_ram);
+	TEST_CHECK(gs_dev.p_tx + ul_words * CONF_CAN_BUS_TX_SIZE ==
+			gs_ul_ram + mcan_ram_size(&gs_cfg) / 4);
+	TEST_CHECK_EQ(gs_ul_ram[0], 0);
+	TEST_CHECK_EQ(test_elem_data(p_mcan->MCAN_RXESC), CONF_CAN_BUS_DATA_SIZE);
+	TEST_CHECK_EQ(test_elem_data(p_mcan->MCAN_RXESC >> 4),
+			CONF_CAN_BUS_DATA_SIZE);
+	TEST_CHECK_EQ(test_elem_data(p_mcan->MCAN_TXESC), CONF_CAN_BUS_DATA_SIZE);
+	TEST_CHECK_EQ((p_mcan->MCAN_RXF0C & MCAN_RXF0C_F0WM_Msk) >>
+			MCAN_RXF0C_F0WM_Pos, CONF_CAN_BUS_RX0_WATERMARK);
+	TEST_CHECK_EQ((p_mcan->MCAN_TXBC & MCAN_TXBC_TFQS_Msk) >>
+			MCAN_TXBC_TFQS_Pos, CONF_CAN_BUS_TX_SIZE);
+	TEST_CHECK_EQ(p_mcan->MCAN_TXBC & MCAN_TXBC_NDTB_Msk, 0);
+	TEST_CHECK_EQ(p_mcan->MCAN_TXBTIE, (1u << CONF_CAN_BUS_TX_SIZE) - 1);
+	TEST_CHECK_EQ(p_mcan->MCAN_IE, 0);
+
+	ul_btp = p_mcan->MCAN_BTP;
+	test_check_timing(TEST_CLOCK_HZ, CONF_CAN_BUS_BITRATE,
+			((ul_btp & MCAN_BTP_BRP_Msk) >> MCAN_BTP_BRP_Pos) + 1,
+			((ul_btp & MCAN_BTP_TSEG1_Msk) >> MCAN_BTP_TSEG1_Pos) + 1,
+			((ul_btp & MCAN_BTP_TSEG2_Msk) >> MCAN_BTP_TSEG2_Pos) + 1);
+	ul_fbtp = p_mcan->MCAN_FBTP;
+	test_check_timing(TEST_CLOCK_HZ, CONF_CAN_BUS_DATA_BITRATE,
+			((ul_fbtp & MCAN_FBTP_FBRP_Msk) >> MCAN_FBTP_FBRP_Pos) + 1,
+			((ul_fbtp & MCAN_FBTP_FTSEG1_Msk) >> MCAN_FBTP_FTSEG1_Pos) + 1,
+			((ul_fbtp & MCAN_FBTP_FTSEG2_Msk) >> MCAN_FBTP_FTSEG2_Pos) + 1);
+	TEST_CHECK(ul_fbtp & MCAN_FBTP_TDC_ENABLED);
+
+	/* Stopped until started, then in the format of the configuration. */
+	TEST_CHECK(p_mcan->MCAN_CCCR & MCAN_CCCR_INIT);
+	TEST_CHECK_EQ(p_mcan->MCAN_CCCR & MCAN_CCCR_CME_Msk, MCAN_CCCR_CME(2));
+	mcan_start(&gs_dev);
+	TEST_CHECK(!(p_mcan->MCAN_CCCR & MCAN_CCCR_INIT));
+	TEST_CHECK_EQ(p_mcan->MCAN_CCCR & MCAN_CCCR_CMR_Msk,
+			MCAN_CCCR_CMR_FD_BITRATE_SWITCH);
+	mcan_stop(&gs_dev);
+	TEST_CHECK(p_mcan->MCAN_CCCR & MCAN_CCCR_INIT);
+
+	/* Layouts and rates out of reach. */
+	TEST_CHECK_EQ(mcan_init(&gs_dev, p_mcan, (uint8_t *)gs_ul_ram + 2,
+			&gs_cfg), ERR_INVALID_ARG);
+	TEST_CHECK_EQ(mcan_init(&gs_dev, p_mcan, (void *)(uintptr_t)0x2040FF00,
+			&gs_cfg), ERR_INVALID_ARG);
+	gs_cfg.uc_data_size = 10;
+	TEST_CHECK_EQ(mcan_init(&gs_dev, p_mcan, gs_ul_ram, &gs_cfg),
+			ERR_INVALID_ARG);
+	test_cfg_default();
+	gs_cfg.uc_rx0_watermark = gs_cfg.uc_rx0_size + 1;
+	TEST_CHECK_EQ(mcan_init(&gs_dev, p_mcan, gs_ul_ram, &gs_cfg),
+			ERR_INVALID_ARG);
+	test_cfg_default();
+	gs_cfg.uc_tx_size = 0;
+	TEST_CHECK_EQ(mcan_init(&gs_dev, p_mcan, gs_ul_ram, &gs_cfg),
+			ERR_INVALID_ARG);
+	test_cfg_default();
+	gs_cfg.ul_bitrate = 333333;
+	TEST_CHECK_EQ(mcan_init(&gs_dev, p_mcan, gs_ul_ram, &gs_cfg),
+			ERR_INVALID_ARG);
+	test_cfg_default();
+	gs_cfg.ul_data_bitrate = 7000000;
+	TEST_CHECK_EQ(mcan_init(&gs_dev, p_mcan, gs_ul_ram, &gs_cfg),
+			ERR_INVALID_ARG);
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+/**
+ * \brief Standard and extended filters route frames to either FIFO or
+ * reject them, the first match deciding.
+ */
+static void test_filters(void)
+{
+	static const mcan_filter_t std[] = {
+		{MCAN_FILTER_RANGE, MCAN_FILTER_TO_FIFO_1, 0x100, 0x1FF},
+		{MCAN_FILTER_DUAL, MCAN_FILTER_REJECT, 0x7FF, 0x000},
+		{MCAN_FILTER_MASK, MCAN_FILTER_TO_FIFO_0, 0x200, 0x700},
+		{MCAN_FILTER_RANGE, MCAN_FILTER_REJECT, 0x000, 0x7FF},
+	};
+	static const mcan_filter_t ext[] = {
+		{MCAN_FILTER_MASK, MCAN_FILTER_TO_FIFO_1, 0x1234500, 0x1FFFFF00},
+		{MCAN_FILTER_RANGE, MCAN_FILTER_REJECT, 0x10000, 0x1FFFF},
+		{MCAN_FILTER_DUAL, MCAN_FILTER_TO_FIFO_0, 0x10005, 0x1ABCDEF},
+	};
+	static const struct {
+		uint32_t ul_id;
+		uint8_t uc_flags;
+		/** FIFO, 2 for rejected, and filter index. */
+		uint8_t uc_fifo;
+		uint8_t uc_filter;
+	} frames[] = {
+		{0x150, 0, 1, 0},
+		{0x7FF, 0, 2, 0},
+		{0x000, 0, 2, 0},
+		{0x2AB, 0, 0, 2},
+		{0x1FF, 0, 1, 0},
+		{0x123, MCAN_FRAME_EXT, 0, MCAN_FILTER_NONE},
+		{0x12345AB, MCAN_FRAME_EXT, 1, 0},
+		{0x10005, MCAN_FRAME_EXT, 2, 0},
+		{0x1ABCDEF, MCAN_FRAME_EXT, 0, 2},
+		{0x1234600, MCAN_FRAME_EXT, 0, MCAN_FILTER_NONE},
+		/* A standard filter does not see extended frames. */
+		{0x150, MCAN_FRAME_EXT, 0, MCAN_FILTER_NONE},
+	};
+	mcan_frame_t rx[2][8];
+	mcan_frame_t frame;
+	uint32_t ul_count[2], ul_seen[2] = {0, 0};
+	uint32_t i;
+
+	test_cfg_default();
+	gs_cfg.uc_std_filters = 4;
+	gs_cfg.uc_ext_filters = 3;
+	TEST_CHECK_EQ(test_init_dev(), STATUS_OK);
+	for (i = 0; i < 4; i++) {
+		TEST_CHECK_EQ(mcan_set_std_filter(&gs_dev, i, &std[i]), STATUS_OK);
+	}
+	for (i = 0; i < 3; i++) {
+		TEST_CHECK_EQ(mcan_set_ext_filter(&gs_dev, i, &ext[i]), STATUS_OK);
+	}
+	TEST_CHECK_EQ(mcan_set_std_filter(&gs_dev, 4, &std[0]), ERR_INVALID_ARG);
+	TEST_CHECK_EQ(mcan_set_ext_filter(&gs_dev, 3, &ext[0]), ERR_INVALID_ARG);
+	mcan_start(&gs_dev);
+
+	for (i = 0; i < sizeof(frames) / sizeof(frames[0]); i++) {
+		frame = test_frame(frames[i].ul_id, frames[i].uc_flags, 8, i);
+		test_mcan_bus(&frame);
+	}
+	ul_count[0] = mcan_rx_fifo_read(&gs_dev, MCAN_RX_FIFO_0, rx[0], 8);
+	ul_count[1] = mcan_rx_fifo_read(&gs_dev, MCAN_RX_FIFO_1, rx[1], 8);
+	test_mcan_run();
+	for (i = 0; i < sizeof(frames) / sizeof(frames[0]); i++) {
+		uint32_t ul_fifo = frames[i].uc_fifo;
+		const mcan_frame_t *p_rx;
+
+		if (ul_fifo == 2) {
+			continue;
+		}
+		if (!TEST_CHECK(ul_seen[ul_fifo] < ul_count[ul_fifo])) {
+			continue;
+		}
+		p_rx = &rx[ul_fifo][ul_seen[ul_fifo]++];
+		TEST_CHECK_EQ(p_rx->ul_id, frames[i].ul_id);
+		TEST_CHECK_EQ(p_rx->uc_flags, frames[i].uc_flags);
+		TEST_CHECK_EQ(p_rx->uc_filter, frames[i].uc_filter);
+		TEST_CHECK_EQ(p_rx->uc_len, 8);
+		TEST_CHECK_EQ(p_rx->uc_data[7], (uint8_t)(i + 49));
+	}
+	TEST_CHECK_EQ(ul_seen[0], ul_count[0]);
+	TEST_CHECK_EQ(ul_seen[1], ul_count[1]);
+	TEST_CHECK_EQ(gs_model.ul_rejected, 3);
+
+	/* Filters change while running; non-matching frames rejected. */
+	frame = test_frame(0x150, 0, 0, 0);
+	mcan_set_std_filter(&gs_dev, 0, &(const mcan_filter_t){
+			MCAN_FILTER_RANGE, MCAN_FILTER_DISABLE, 0, 0x7FF});
+	test_mcan_bus(&frame);
+	TEST_CHECK_EQ(mcan_rx_fifo_level(&gs_dev, MCAN_RX_FIFO_1), 0);
+	TEST_CHECK_EQ(gs_model.ul_rejected, 4);
+
+	test_cfg_default();
+	gs_cfg.nonmatch = MCAN_FILTER_REJECT;
+	TEST_CHECK_EQ(test_init_dev(), STATUS_OK);
+	mcan_start(&gs_dev);
+	frame = test_frame(0x123, 0, 0, 0);
+	test_mcan_bus(&frame);
+	frame = test_frame(0x123, MCAN_FRAME_EXT, 0, 0);
+	test_mcan_bus(&frame);
+	TEST_CHECK_EQ(gs_model.ul_rejected, 2);
+	gs_cfg.nonmatch = MCAN_FILTER_TO_FIFO_1;
+	TEST_CHECK_EQ(test_init_dev(), STATUS_OK);
+	mcan_start(&gs_dev);
+	test_mcan_bus(&frame);
+	TEST_CHECK_EQ(mcan_rx_fifo_level(&gs_dev, MCAN_RX_FIFO_1), 1);
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+/**
+ * \brief Reads take everything a FIFO holds with one acknowledge, across
+ * the end of the FIFO and while frames keep coming.
+ */
+static void test_rx_batches(void)
+{
+	mcan_frame_t rx[32];
+	mcan_frame_t frame;
+	uint32_t ul_next = 0;
+	uint32_t ul_count;
+	uint32_t ul_acks;
+	uint16_t us_last = 0;
+	uint32_t i;
+
+	test_cfg_default();
+	TEST_CHECK_EQ(test_init_dev(), STATUS_OK);
+	mcan_start(&gs_dev);
+
+	for (i = 0; i < 10; i++) {
+		frame = test_frame(i, MCAN_FRAME_FD | MCAN_FRAME_BRS, 64, i);
+		test_mcan_bus(&frame);
+	}
+	TEST_CHECK_EQ(mcan_rx_fifo_level(&gs_dev, MCAN_RX_FIFO_0), 10);
+	ul_count = mcan_rx_fifo_read(&gs_dev, MCAN_RX_FIFO_0, rx, 4);
+	ul_count += mcan_rx_fifo_read(&gs_dev, MCAN_RX_FIFO_0, rx + 4, 32);
+	test_mcan_run();
+	TEST_CHECK_EQ(ul_count, 10);
+	TEST_CHECK_EQ(gs_model.ul_acks, 2);
+	for (i = 0; i < ul_count; i++) {
+		frame = test_frame(i, MCAN_FRAME_FD | MCAN_FRAME_BRS, 64, i);
+		TEST_CHECK_EQ(rx[i].ul_id, i);
+		TEST_CHECK_EQ(rx[i].uc_flags, frame.uc_flags);
+		TEST_CHECK_EQ(rx[i].uc_len, 64);
+		TEST_CHECK(memcmp(rx[i].uc_data, frame.uc_data, 64) == 0);
+		TEST_CHECK(rx[i].us_timestamp > us_last);
+		us_last = rx[i].us_timestamp;
+	}
+	ul_next = 10;
+
+	/* Across the end of the 16 elements. */
+	for (i = 0; i < 12; i++) {
+		frame = test_frame(ul_next + i, 0, i % 9, i);
+		test_mcan_bus(&frame);
+	}
+	ul_acks = gs_model.ul_acks;
+	ul_count = mcan_rx_fifo_read(&gs_dev, MCAN_RX_FIFO_0, rx, 32);
+	test_mcan_run();
+	TEST_CHECK_EQ(ul_count, 12);
+	TEST_CHECK_EQ(gs_model.ul_acks, ul_acks + 1);
+	for (i = 0; i < ul_count; i++) {
+		frame = test_frame(ul_next + i, 0, i % 9, i);
+		TEST_CHECK_EQ(rx[i].ul_id, ul_next + i);
+		TEST_CHECK_EQ(rx[i].uc_len, i % 9);
+		TEST_CHECK(memcmp(rx[i].uc_data, frame.uc_data, i % 9) == 0);
+		TEST_CHECK_EQ(rx[i].uc_filter, MCAN_FILTER_NONE);
+	}
+	ul_next += 12;
+
+	/* Frames arriving while the driver reads: each is read once, none is
+	 * released unread. */
+	for (i = 0; i < 3; i++) {
+		frame = test_frame(ul_next++, 0, 8, 0);
+		test_mcan_bus(&frame);
+	}
+	for (i = 0; i < 6; i++) {
+		gs_inject[gs_ul_inject_put++ % TEST_INJECT_MAX] =
+				test_frame(ul_next + i, 0, 8, 0);
+	}
+	ul_next -= 3;
+	while (gs_ul_inject_get != gs_ul_inject_put ||
+			mcan_rx_fifo_level(&gs_dev, MCAN_RX_FIFO_0)) {
+		ul_count = mcan_rx_fifo_read(&gs_dev, MCAN_RX_FIFO_0, rx, 32);
+		if (!TEST_CHECK(ul_count)) {
+			break;
+		}
+		for (i = 0; i < ul_count; i++) {
+			TEST_CHECK_EQ(rx[i].ul_id, ul_next++);
+		}
+		test_mcan_run();
+	}
+	TEST_CHECK_EQ(ul_next, 10 + 12 + 9);
+	TEST_CHECK_EQ(gs_dev.ul_rx_frames, 10 + 12 + 9);
+
+	/* Frames longer than the element room are cut to it. */
+	test_cfg_default();
+	gs_cfg.uc_data_size = 12;
+	TEST_CHECK_EQ(test_init_dev(), STATUS_OK);
+	mcan_start(&gs_dev);
+	frame = test_frame(1, MCAN_FRAME_FD, 48, 3);
+	test_mcan_bus(&frame);
+	TEST_CHECK_EQ(mcan_rx_fifo_read(&gs_dev, MCAN_RX_FIFO_0, rx, 1), 1);
+	TEST_CHECK_EQ(rx[0].uc_len, 12);
+	TEST_CHECK(memcmp(rx[0].uc_data, frame.uc_data, 12) == 0);
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+/**
+ * \brief FIFO 0 interrupts at its watermark or on its timeout, FIFO 1 on
+ * every frame, and a full FIFO counts its overflow.
+ */
+static void test_interrupts(void)
+{
+	mcan_frame_t frame = test_frame(0x10, 0, 8, 0);
+	mcan_frame_t rx[CONF_CAN_BUS_RX1_SIZE];
+	uint32_t i;
+
+	test_cfg_default();
+	TEST_CHECK_EQ(test_init_dev(), STATUS_OK);
+	mcan_set_std_filter(&gs_dev, 0, &(const mcan_filter_t){
+			MCAN_FILTER_DUAL, MCAN_FILTER_TO_FIFO_1, 0x001, 0x001});
+	mcan_set_callback(&gs_dev, test_callback, NULL);
+	mcan_enable_interrupt(&gs_dev, MCAN_IE_RF0WE | MCAN_IE_TOOE |
+			MCAN_IE_RF1NE | MCAN_IE_RF0LE);
+	NVIC_EnableIRQ(MCAN0_IRQn);
+	mcan_start(&gs_dev);
+	gs_b_cb_read = true;
+
+	for (i = 0; i < CONF_CAN_BUS_RX0_WATERMARK - 1; i++) {
+		test_mcan_bus(&frame);
+	}
+	TEST_CHECK_EQ(gs_ul_cb_calls, 0);
+	test_mcan_bus(&frame);
+	TEST_CHECK_EQ(gs_ul_cb_calls, 1);
+	TEST_CHECK_EQ(gs_ul_cb_ir, MCAN_IR_RF0W);
+	TEST_CHECK_EQ(gs_ul_cb_frames, CONF_CAN_BUS_RX0_WATERMARK);
+	TEST_CHECK_EQ(mcan_rx_fifo_level(&gs_dev, MCAN_RX_FIFO_0), 0);
+
+	/* A lone frame waits for the timeout, in bit times. */
+	gs_ul_cb_ir = 0;
+	test_mcan_bus(&frame);
+	test_mcan_bits(CONF_CAN_BUS_RX0_TIMEOUT - 2 * test_frame_bits(&frame));
+	test_mcan_run();
+	TEST_CHECK_EQ(gs_ul_cb_calls, 1);
+	test_mcan_bits(2 * test_frame_bits(&frame));
+	test_mcan_run();
+	TEST_CHECK_EQ(gs_ul_cb_calls, 2);
+	TEST_CHECK_EQ(gs_ul_cb_ir, MCAN_IR_TOO);
+	TEST_CHECK_EQ(gs_ul_cb_frames, CONF_CAN_BUS_RX0_WATERMARK + 1);
+
+	/* FIFO 1, every frame. */
+	gs_ul_cb_ir = 0;
+	frame.ul_id = 0x001;
+	test_mcan_bus(&frame);
+	TEST_CHECK_EQ(gs_ul_cb_calls, 3);
+	TEST_CHECK_EQ(gs_ul_cb_ir, MCAN_IR_RF1N);
+	test_mcan_bus(&frame);
+	TEST_CHECK_EQ(gs_ul_cb_calls, 4);
+	TEST_CHECK_EQ(mcan_rx_fifo_read(&gs_dev, MCAN_RX_FIFO_1, rx,
+			CONF_CAN_BUS_RX1_SIZE), 2);
+	test_mcan_run();
+
+	/* Nobody reading: FIFO 0 fills up and loses the next frame. */
+	gs_b_cb_read = false;
+	gs_ul_cb_ir = 0;
+	frame.ul_id = 0x10;
+	for (i = 0; i < CONF_CAN_BUS_RX0_SIZE + 1; i++) {
+		test_mcan_bus(&frame);
+	}
+	TEST_CHECK(gs_ul_cb_ir & MCAN_IR_RF0L);
+	TEST_CHECK_EQ(gs_dev.ul_rx_overflows, 1);
+	TEST_CHECK_EQ(gs_model.ul_lost, 1);
+	TEST_CHECK_EQ(mcan_rx_fifo_level(&gs_dev, MCAN_RX_FIFO_0),
+			CONF_CAN_BUS_RX0_SIZE);
+
+	/* Bus off: the handler rejoins the bus. */
+	mcan_enable_interrupt(&gs_dev, MCAN_IE_BOE);
+	TEST_MCAN->MCAN_CCCR |= MCAN_CCCR_INIT;
+	HOST_REG(TEST_MCAN->MCAN_PSR) |= MCAN_PSR_BO;
+	gs_model.ul_ir |= MCAN_IR_BO;
+	test_mcan_run();
+	TEST_CHECK_EQ(gs_dev.ul_bus_off, 1);
+	TEST_CHECK(!(TEST_MCAN->MCAN_CCCR & MCAN_CCCR_INIT));
+	TEST_CHECK(!(TEST_MCAN->MCAN_PSR & MCAN_PSR_BO));
+
+	TEST_CHECK_EQ(gs_model.ul_ir & TEST_MCAN->MCAN_IE, 0);
+	NVIC_DisableIRQ(MCAN0_IRQn);
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+/**
+ * \brief The transmit FIFO takes what fits with one request, sends in
+ * order, and the frame format follows the configuration.
+ */
+static void test_tx(void)
+{
+	mcan_frame_t tx[12];
+	uint32_t ul_count;
+	uint32_t i;
+
+	test_cfg_default();
+	TEST_CHECK_EQ(test_init_dev(), STATUS_OK);
+	mcan_set_callback(&gs_dev, test_callback, NULL);
+	mcan_enable_interrupt(&gs_dev, MCAN_IE_TCE);
+	NVIC_EnableIRQ(MCAN0_IRQn);
+	mcan_start(&gs_dev);
+	for (i = 0; i < 12; i++) {
+		static const uint8_t uc_lens[] = { 0, 8, 13, 64, 20, 9 };
+
+		tx[i] = test_frame(0x100 + i, i == 5 ? MCAN_FRAME_EXT : 0,
+				uc_lens[i % 6], i);
+	}
+	tx[7].uc_flags |= MCAN_FRAME_RTR;
+
+	/* Nothing goes out before the request. */
+	gs_model.ul_tx_left = 3;
+	ul_count = mcan_tx_fifo_write(&gs_dev, tx, 12);
+	TEST_CHECK_EQ(ul_count, CONF_CAN_BUS_TX_SIZE);
+	TEST_CHECK_EQ(gs_model.ul_txbar_writes, 1);
+	test_mcan_run();
+	TEST_CHECK_EQ(gs_ul_sent, 3);
+	TEST_CHECK_EQ(mcan_tx_fifo_free(&gs_dev), 3);
+	TEST_CHECK(gs_ul_cb_ir & MCAN_IR_TC);
+	TEST_CHECK(!mcan_tx_is_idle(&gs_dev));
+
+	/* The rest, across the end of the FIFO, with one more request. */
+	ul_count += mcan_tx_fifo_write(&gs_dev, tx + ul_count, 12 - ul_count);
+	TEST_CHECK_EQ(ul_count, CONF_CAN_BUS_TX_SIZE + 3);
+	TEST_CHECK_EQ(gs_model.ul_txbar_writes, 2);
+	gs_model.ul_tx_left = UINT32_MAX;
+	test_mcan_run();
+	ul_count += mcan_tx_fifo_write(&gs_dev, tx + ul_count, 12 - ul_count);
+	test_mcan_run();
+	TEST_CHECK_EQ(ul_count, 12);
+	TEST_CHECK(mcan_tx_is_idle(&gs_dev));
+	TEST_CHECK_EQ(gs_dev.ul_tx_frames, 12);
+
+	if (TEST_CHECK_EQ(gs_ul_sent, 12)) {
+		for (i = 0; i < 12; i++) {
+			/* Rounded up to a CAN FD length, padded with uc_data. */
+			uint32_t ul_len = tx[i].uc_len <= 8 ? tx[i].uc_len :
+					tx[i].uc_len <= 12 ? 12 : tx[i].uc_len <= 16 ? 16 :
+					tx[i].uc_len <= 20 ? 20 : 64;
+
+			TEST_CHECK_EQ(gs_sent[i].ul_id, tx[i].ul_id);
+			TEST_CHECK_EQ(gs_sent[i].uc_flags, tx[i].uc_flags |
+					MCAN_FRAME_FD | MCAN_FRAME_BRS);
+			TEST_CHECK_EQ(gs_sent[i].uc_len, ul_len);
+			TEST_CHECK(memcmp(gs_sent[i].uc_data, tx[i].uc_data, ul_len) == 0);
+		}
+	}
+
+	/* CAN 2.0: 8 bytes at most. */
+	test_cfg_default();
+	gs_cfg.mode = MCAN_MODE_CLASSIC;
+	TEST_CHECK_EQ(test_init_dev(), STATUS_OK);
+	mcan_start(&gs_dev);
+	TEST_CHECK_EQ(TEST_MCAN->MCAN_CCCR & MCAN_CCCR_CME_Msk, 0);
+	TEST_CHECK_EQ(mcan_tx_fifo_write(&gs_dev, &tx[3], 1), 1);
+	test_mcan_run();
+	TEST_CHECK_EQ(gs_ul_sent, 1);
+	TEST_CHECK_EQ(gs_sent[0].uc_flags, 0);
+	TEST_CHECK_EQ(gs_sent[0].uc_len, 8);
+	TEST_CHECK(memcmp(gs_sent[0].uc_data, tx[3].uc_data, 8) == 0);
+
+	/* Stopped: requests wait, the FIFO fills up. */
+	mcan_stop(&gs_dev);
+	TEST_CHECK_EQ(mcan_tx_fifo_write(&gs_dev, tx, 12), CONF_CAN_BUS_TX_SIZE);
+	test_mcan_run();
+	TEST_CHECK_EQ(gs_ul_sent, 1);
+	TEST_CHECK_EQ(mcan_tx_fifo_write(&gs_dev, tx, 12), 0);
+	TEST_CHECK_EQ(mcan_tx_fifo_free(&gs_dev), 0);
+	mcan_start(&gs_dev);
+	test_mcan_run();
+	TEST_CHECK_EQ(gs_ul_sent, 1 + CONF_CAN_BUS_TX_SIZE);
+
+	NVIC_DisableIRQ(MCAN0_IRQn);
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+/** A way of moving frames, for the benchmark. */
+typedef struct {
+	const char *p_name;
+	/** Frames per mcan_tx_fifo_write(). */
+	uint32_t ul_tx_batch;
+	/** FIFO 0 watermark, 0 to interrupt on each frame. */
+	uint8_t uc_watermark;
+} test_bench_t;
+
+static const test_bench_t gs_benches[] = {
+	{"frame by frame", 1, 0},
+	{"tx batch 8", 8, 0},
+	{"batch 8, wm 8", 8, 8},
+	{"batch 32, wm 32", 32, 32},
+};
+
+/**
+ * \brief Frames per second through the driver and the model, in loopback,
+ * with the interrupts and register accesses that each way costs.
+ */
+static void test_throughput(void)
+{
+	const uint32_t ul_frames = 200000;
+	uint32_t i;
+
+	printf("  %-16s %10s %8s %8s %8s\n", "mode", "frames/s", "irq/fr",
+			"ack/fr", "txbar/fr");
+	for (i = 0; i < sizeof(gs_benches) / sizeof(gs_benches[0]); i++) {
+		const test_bench_t *p_bench = &gs_benches[i];
+		mcan_frame_t tx[32];
+		uint32_t ul_queued = 0;
+		double d_start, d_time;
+		uint32_t j;
+
+		test_cfg_default();
+		gs_cfg.mode = MCAN_MODE_CLASSIC;
+		gs_cfg.uc_data_size = 8;
+		gs_cfg.uc_rx0_size = MCAN_RX_FIFO_MAX;
+		gs_cfg.uc_rx0_watermark = p_bench->uc_watermark;
+		/* The timeout only flushes the last frames, past the watermark. */
+		gs_cfg.ul_rx0_timeout = 200 * (p_bench->uc_watermark + 1);
+		gs_cfg.uc_tx_size = MCAN_TX_FIFO_MAX;
+		gs_cfg.b_loopback = true;
+		TEST_CHECK_EQ(test_init_dev(), STATUS_OK);
+		mcan_set_callback(&gs_dev, test_callback, NULL);
+		mcan_enable_interrupt(&gs_dev, p_bench->uc_watermark ?
+				MCAN_IE_RF0WE | MCAN_IE_TOOE : MCAN_IE_RF0NE);
+		NVIC_EnableIRQ(MCAN0_IRQn);
+		mcan_start(&gs_dev);
+		gs_b_cb_read = gs_b_cb_check = true;
+
+		d_start = test_seconds();
+		while (gs_ul_cb_frames < ul_frames) {
+			uint32_t ul_batch = Min(p_bench->ul_tx_batch,
+					ul_frames - ul_queued);
+			uint32_t ul_read = gs_ul_cb_frames;
+
+			for (j = 0; j < ul_batch; j++) {
+				tx[j] = test_frame(ul_queued + j, MCAN_FRAME_EXT, 8, 0);
+				memcpy(tx[j].uc_data, &tx[j].ul_id, 4);
+			}
+			ul_queued += mcan_tx_fifo_write(&gs_dev, tx, ul_batch);
+			if (gs_ul_cb_frames == ul_read && ul_queued == ul_frames) {
+				/* The bus idles until the timeout. */
+				test_mcan_bits(gs_cfg.ul_rx0_timeout);
+				test_mcan_run();
+				if (gs_ul_cb_frames == ul_read) {
+					break;
+				}
+			}
+		}
+		d_time = test_seconds() - d_start;
+		printf("  %-16s %10.0f %8.3f %8.3f %8.3f\n", p_bench->p_name,
+				ul_frames / d_time, (double)gs_model.ul_irqs / ul_frames,
+				(double)gs_model.ul_acks / ul_frames,
+				(double)gs_model.ul_txbar_writes / ul_frames);
+		TEST_CHECK_EQ(gs_ul_cb_frames, ul_frames);
+		TEST_CHECK_EQ(gs_ul_cb_bad, 0);
+		TEST_CHECK_EQ(gs_model.ul_lost, 0);
+		TEST_CHECK_EQ(gs_model.ul_faults, 0);
+		if (p_bench->uc_watermark) {
+			/* One interrupt, one acknowledge, per watermark. */
+			TEST_CHECK(gs_model.ul_irqs <= ul_frames /
+					p_bench->uc_watermark + 1);
+		}
+		TEST_CHECK(gs_model.ul_txbar_writes <= ul_frames /
+				p_bench->ul_tx_batch + 1);
+		NVIC_DisableIRQ(MCAN0_IRQn);
+	}
+}
+
+int main(void)
+{
+	test_init();
+	test_filters();
+	test_rx_batches();
+	test_interrupts();
+	test_tx();
+	test_throughput();
+	return test_end("mcan");
+}
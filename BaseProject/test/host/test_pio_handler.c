@@ -0,0 +1,253 @@
+/**
+ * \file
+ *
+ * \brief Host test of the PIO interrupt dispatch, against a model of the
+ * PIO interrupt registers, with a benchmark of 1, 8 and 32 pending pins.
+ *
+ * The test sets the interrupt status, mask and pin levels of the model and
+ * runs pio_handler_process() as the interrupt would. It checks the walk
+ * order, that a handler registered for several pins is called once with
+ * those pending, that the context handlers get the snapshot, and that the
+ * snapshot is only taken on a controller with a context handler: DWT reads
+ * are counted.
+ *
+ * The table gives the time of one dispatch and per pin, on the host, for
+ * one handler on all the pins, one handler per pin and a context handler,
+ * with the DWT reads per dispatch.
+ *
+ */
+
+#include <asf.h>
+
+/* The reads of the cycle counter are counted. */
+static DWT_Type *test_dwt(void);
+#undef DWT
+#define DWT                 test_dwt()
+
+/* pio_handler.c is built into the test, to count its DWT reads. */
+#include "pio_handler.c"
+#include "test.h"
+
+/** Dispatches timed per row of the table, over the pins pending. */
+#define TEST_PINS_TIMED     4000000
+
+/** Calls recorded by the handlers. */
+#define TEST_CALLS          64
+
+/** A handler call. */
+struct test_call {
+	uint32_t ul_id;
+	uint32_t ul_mask;
+	uint32_t ul_cycles;
+	uint32_t ul_levels;
+	bool b_ctx;
+	void *p_ctx;
+};
+
+static struct test_call gs_calls[TEST_CALLS];
+static uint32_t gs_ul_calls;
+static uint32_t gs_ul_dwt_reads;
+static volatile uint32_t gs_ul_sink;
+
+static DWT_Type *test_dwt(void)
+{
+	gs_ul_dwt_reads++;
+	return &host_dwt;
+}
+
+static void test_record(uint32_t ul_id, uint32_t ul_mask,
+		const pio_handler_snapshot_t *p_snapshot, void *p_ctx)
+{
+	struct test_call *p_call = &gs_calls[gs_ul_calls % TEST_CALLS];
+
+	p_call->ul_id = ul_id;
+	p_call->ul_mask = ul_mask;
+	p_call->b_ctx = p_snapshot != NULL;
+	p_call->ul_cycles = p_snapshot ? p_snapshot->ul_cycles : 0;
+	p_call->ul_levels = p_snapshot ? p_snapshot->ul_levels : 0;
+	p_call->p_ctx = p_ctx;
+	gs_ul_calls++;
+}
+
+static void test_handler(uint32_t ul_id, uint32_t ul_mask)
+{
+	test_record(ul_id, ul_mask, NULL, NULL);
+}
+
+static void test_ctx_handler(uint32_t ul_id, uint32_t ul_mask,
+		const pio_handler_snapshot_t *p_snapshot, void *p_ctx)
+{
+	test_record(ul_id, ul_mask, p_snapshot, p_ctx);
+}
+
+/** Handlers of the benchmark, as cheap as a handler can be. */
+static void test_bench_handler(uint32_t ul_id, uint32_t ul_mask)
+{
+	gs_ul_sink += ul_mask;
+}
+
+static void test_bench_ctx_handler(uint32_t ul_id, uint32_t ul_mask,
+		const pio_handler_snapshot_t *p_snapshot, void *p_ctx)
+{
+	gs_ul_sink += ul_mask ^ p_snapshot->ul_levels;
+}
+
+/**
+ * \brief Raise the interrupt of a controller: the pins pending, those with
+ * the interrupt enabled, and the levels, then the dispatch.
+ */
+static void test_irq(Pio *p_pio, uint32_t ul_id, uint32_t ul_pending,
+		uint32_t ul_enabled, uint32_t ul_levels)
+{
+	HOST_REG(p_pio->PIO_ISR) = ul_pending;
+	HOST_REG(p_pio->PIO_IMR) = ul_enabled;
+	HOST_REG(p_pio->PIO_PDSR) = ul_levels;
+	pio_handler_process(p_pio, ul_id);
+}
+
+static void test_dispatch(void)
+{
+	uint32_t i;
+
+	/* A group handler on 8..15, a context handler on 0..3 and 28, its own
+	 * handler on each of 16..19, and a pin of the group given to another
+	 * handler. */
+	pio_handler_set(PIOA, ID_PIOA, 0x0000FF00, PIO_IT_RISE_EDGE,
+			test_handler);
+	pio_handler_set_ctx(PIOA, 0x1000000F, PIO_IT_EDGE, test_ctx_handler,
+			(void *)PIOA);
+	for (i = 16; i < 20; i++) {
+		pio_handler_set(PIOA, ID_PIOA, 1u << i, PIO_IT_EDGE, test_handler);
+	}
+	pio_handler_set(PIOA, ID_PIOA, 1u << 12, PIO_IT_EDGE, test_handler);
+
+	host_dwt.CYCCNT = 12345;
+	gs_ul_calls = 0;
+	gs_ul_dwt_reads = 0;
+	/* 31 has no handler, 2 is masked. */
+	test_irq(PIOA, ID_PIOA, 0x900AB905, 0xFFFFFFFB, 0xA5A5A5A5);
+	TEST_CHECK_EQ(gs_ul_dwt_reads, 1);
+	if (TEST_CHECK_EQ(gs_ul_calls, 6)) {
+		static const struct {
+			uint32_t ul_mask;
+			bool b_ctx;
+		} expected[] = {
+			{ 1u << 28, true },
+			{ 1u << 19, false },
+			{ 1u << 17, false },
+			{ 1u << 15 | 1u << 13 | 1u << 11 | 1u << 8, false },
+			{ 1u << 12, false },
+			{ 1u << 0, true },
+		};
+
+		for (i = 0; i < 6; i++) {
+			TEST_CHECK_EQ(gs_calls[i].ul_id, ID_PIOA);
+			TEST_CHECK_EQ(gs_calls[i].ul_mask, expected[i].ul_mask);
+			TEST_CHECK_EQ(gs_calls[i].b_ctx, expected[i].b_ctx);
+			if (expected[i].b_ctx) {
+				/* Both get the one snapshot. */
+				TEST_CHECK_EQ(gs_calls[i].ul_cycles, 12345);
+				TEST_CHECK_EQ(gs_calls[i].ul_levels, 0xA5A5A5A5);
+				TEST_CHECK(gs_calls[i].p_ctx == (void *)PIOA);
+			}
+		}
+	}
+
+	/* No snapshot on a controller without context handler. */
+	pio_handler_set(PIOB, ID_PIOB, 0xFFFFFFFF, PIO_IT_EDGE, test_handler);
+	gs_ul_calls = 0;
+	gs_ul_dwt_reads = 0;
+	test_irq(PIOB, ID_PIOB, 0x00000101, 0xFFFFFFFF, 0);
+	TEST_CHECK_EQ(gs_ul_dwt_reads, 0);
+	TEST_CHECK_EQ(gs_ul_calls, 1);
+	TEST_CHECK_EQ(gs_calls[0].ul_mask, 0x00000101);
+
+	/* Nor once the context handlers are replaced and removed: 28 still
+	 * has one after 0..3 are replaced. */
+	pio_handler_set(PIOA, ID_PIOA, 0x0000000F, PIO_IT_EDGE, test_handler);
+	gs_ul_dwt_reads = 0;
+	test_irq(PIOA, ID_PIOA, 0x00000001, 0xFFFFFFFF, 0);
+	TEST_CHECK_EQ(gs_ul_dwt_reads, 1);
+	pio_handler_unset(PIOA, 1u << 28);
+	gs_ul_calls = 0;
+	gs_ul_dwt_reads = 0;
+	test_irq(PIOA, ID_PIOA, 0x10000001, 0xFFFFFFFF, 0);
+	TEST_CHECK_EQ(gs_ul_dwt_reads, 0);
+	TEST_CHECK_EQ(gs_ul_calls, 1);
+	TEST_CHECK_EQ(gs_calls[0].ul_mask, 0x00000001);
+	pio_handler_unset(PIOA, 0xFFFFFFFF);
+	pio_handler_unset(PIOB, 0xFFFFFFFF);
+}
+
+/** Registrations of the benchmark. */
+enum test_setup {
+	TEST_GROUP,
+	TEST_PER_PIN,
+	TEST_CONTEXT,
+	TEST_SETUPS,
+};
+
+static void test_setup(enum test_setup setup)
+{
+	uint32_t i;
+
+	switch (setup) {
+	case TEST_GROUP:
+		pio_handler_set(PIOA, ID_PIOA, 0xFFFFFFFF, PIO_IT_EDGE,
+				test_bench_handler);
+		break;
+	case TEST_PER_PIN:
+		for (i = 0; i < 32; i++) {
+			pio_handler_set(PIOA, ID_PIOA, 1u << i, PIO_IT_EDGE,
+					test_bench_handler);
+		}
+		break;
+	default:
+		pio_handler_set_ctx(PIOA, 0xFFFFFFFF, PIO_IT_EDGE,
+				test_bench_ctx_handler, NULL);
+		break;
+	}
+}
+
+static void test_bench(void)
+{
+	static const char *const p_names[TEST_SETUPS] = {
+		"one handler", "handler per pin", "context handler",
+	};
+	static const uint32_t ul_pending[] = {
+		1u << 20, 0x11111111, 0xFFFFFFFF,
+	};
+	static const uint32_t ul_pins[] = { 1, 8, 32 };
+	uint32_t ul_runs, ul_dwt, i, j, k;
+	double d_start, d_ns;
+
+	printf("%-16s %5s %9s %9s %9s\n", "handlers", "pins", "ns/irq", "ns/pin",
+			"dwt/irq");
+	for (i = 0; i < TEST_SETUPS; i++) {
+		test_setup((enum test_setup)i);
+		for (j = 0; j < 3; j++) {
+			ul_runs = TEST_PINS_TIMED / ul_pins[j];
+			HOST_REG(PIOA->PIO_IMR) = 0xFFFFFFFF;
+			gs_ul_dwt_reads = 0;
+			d_start = test_seconds();
+			for (k = 0; k < ul_runs; k++) {
+				HOST_REG(PIOA->PIO_ISR) = ul_pending[j];
+				pio_handler_process(PIOA, ID_PIOA);
+			}
+			d_ns = (test_seconds() - d_start) * 1e9 / ul_runs;
+			ul_dwt = gs_ul_dwt_reads / ul_runs;
+			printf("%-16s %5lu %9.1f %9.1f %9lu\n", p_names[i],
+					(unsigned long)ul_pins[j], d_ns, d_ns / ul_pins[j],
+					(unsigned long)ul_dwt);
+			TEST_CHECK_EQ(ul_dwt, i == TEST_CONTEXT);
+		}
+		pio_handler_unset(PIOA, 0xFFFFFFFF);
+	}
+}
+
+int main(void)
+{
+	test_dispatch();
+	test_bench();
+	return test_end("pio_handler");
+}
@@ -0,0 +1,410 @@
+/**
+ * \file
+ *
+ * \brief Host test of the QSPI serial flash driver, against a model of the
+ * board S25FL116K behind the QSPI and of the XDMAC memory copy.
+ *
+ */
+
+#include <string.h>
+#include <sys/mman.h>
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+#include "qspi.h"
+#include "xdmac.h"
+#include "clock_scale.h"
+#include "conf_qspi_flash.h"
+#include "test.h"
+
+/**
+ * Model of the flash, frame by frame. The memory window is mapped at
+ * QSPIMEM_ADDR as on the target: readable with the memory mode on, and
+ * unmapped otherwise, so that a read of it while frames run faults.
+ */
+static status_code_t test_flash_exec(const qspi_cmd_t *p_cmd, void *p_rx,
+		const void *p_tx, uint32_t ul_len);
+static void test_flash_memory_read(const qspi_cmd_t *p_cmd);
+
+#define QSPI_FLASH_EXEC(p_cmd, p_rx, p_tx, ul_len) \
+	test_flash_exec((p_cmd), (p_rx), (p_tx), (ul_len))
+#define QSPI_FLASH_MEMORY_READ(p_cmd) \
+	test_flash_memory_read(p_cmd)
+/* qspi_flash.c is built into the test, on the model. */
+#include "qspi_flash.c"
+
+#define TEST_MCK_HZ         150000000u
+
+/** JEDEC identification: Spansion, S25FL1-K, 2^21 bytes. */
+static const uint8_t gs_uc_id[3] = { 0x01, 0x40, 0x15 };
+
+/** Status polls a program, an erase and a status write stay busy for. */
+#define TEST_PP_POLLS       2
+#define TEST_SE_POLLS       3
+#define TEST_WRSR_POLLS     2
+
+/** Status register 1: write enable latch. */
+#define TEST_SR1_WEL        (1u << 1)
+
+static uint8_t gs_flash[CONF_QSPI_FLASH_SIZE];
+static uint8_t gs_uc_sr1;
+static uint8_t gs_uc_sr2;
+static uint32_t gs_ul_busy;
+static bool gs_b_memory;
+/** Status writes, which wear the non-volatile bits. */
+static uint32_t gs_ul_status_writes;
+/** Program and erase frames without a write enable, ignored. */
+static uint32_t gs_ul_ignored;
+
+/**
+ * \brief Tell whether the driver maps the window cached.
+ */
+static bool test_window_cached(void)
+{
+	return (MPU->RBAR & MPU_RBAR_REGION_Msk) == CONF_QSPI_FLASH_MPU_REGION &&
+			(MPU->RASR & MPU_RASR_ENABLE_Msk);
+}
+
+/**
+ * \brief Take the write enable latch for a program, erase or status write.
+ *
+ * \return false if the flash ignores the frame.
+ */
+static bool test_flash_write_enabled(void)
+{
+	if (!(gs_uc_sr1 & TEST_SR1_WEL)) {
+		gs_ul_ignored++;
+		return false;
+	}
+	/* Frames of the flash, not reads ahead in a cached window. */
+	TEST_CHECK(!test_window_cached());
+	return true;
+}
+
+static status_code_t test_flash_exec(const qspi_cmd_t *p_cmd, void *p_rx,
+		const void *p_tx, uint32_t ul_len)
+{
+	uint32_t ul_width = p_cmd->ul_ifr & QSPI_IFR_WIDTH_Msk;
+	uint32_t ul_type = p_cmd->ul_ifr & QSPI_IFR_TFRTYP_Msk;
+	uint8_t *p_rx8 = (uint8_t *)p_rx;
+	const uint8_t *p_tx8 = (const uint8_t *)p_tx;
+	uint32_t ul_page;
+	uint32_t i;
+
+	/* A frame ends the memory mode. */
+	if (gs_b_memory) {
+		gs_b_memory = false;
+		mprotect((void *)QSPIMEM_ADDR, CONF_QSPI_FLASH_SIZE, PROT_NONE);
+	}
+	TEST_CHECK(p_cmd->ul_ifr & QSPI_IFR_INSTEN);
+	TEST_CHECK_EQ(!!(p_cmd->ul_ifr & QSPI_IFR_DATAEN), ul_len != 0);
+	TEST_CHECK_EQ(ul_type, p_rx ? QSPI_IFR_TFRTYP_TRSFR_READ :
+			QSPI_IFR_TFRTYP_TRSFR_WRITE);
+	if (gs_ul_busy && p_cmd->uc_inst != QSPI_FLASH_RDSR1) {
+		TEST_CHECK(!"frame while busy");
+		return STATUS_OK;
+	}
+
+	switch (p_cmd->uc_inst) {
+	case QSPI_FLASH_RDID:
+		TEST_CHECK_EQ(ul_width, QSPI_IFR_WIDTH_SINGLE_BIT_SPI);
+		for (i = 0; i < ul_len; i++) {
+			p_rx8[i] = i < sizeof(gs_uc_id) ? gs_uc_id[i] : 0;
+		}
+		break;
+	case QSPI_FLASH_RDSR1:
+		TEST_CHECK_EQ(ul_width, QSPI_IFR_WIDTH_SINGLE_BIT_SPI);
+		p_rx8[0] = gs_uc_sr1;
+		if (gs_ul_busy && !--gs_ul_busy) {
+			gs_uc_sr1 &= ~(QSPI_FLASH_SR1_WIP | TEST_SR1_WEL);
+		}
+		break;
+	case QSPI_FLASH_RDSR2:
+		TEST_CHECK_EQ(ul_width, QSPI_IFR_WIDTH_SINGLE_BIT_SPI);
+		p_rx8[0] = gs_uc_sr2;
+		break;
+	case QSPI_FLASH_WREN:
+		TEST_CHECK_EQ(ul_width, QSPI_IFR_WIDTH_SINGLE_BIT_SPI);
+		gs_uc_sr1 |= TEST_SR1_WEL;
+		break;
+	case QSPI_FLASH_WRSR:
+		TEST_CHECK_EQ(ul_width, QSPI_IFR_WIDTH_SINGLE_BIT_SPI);
+		TEST_CHECK_EQ(ul_len, 2);
+		if (test_flash_write_enabled()) {
+			gs_uc_sr2 = p_tx8[1];
+			gs_ul_status_writes++;
+			gs_uc_sr1 |= QSPI_FLASH_SR1_WIP;
+			gs_ul_busy = TEST_WRSR_POLLS;
+		}
+		break;
+	case QSPI_FLASH_SE:
+		TEST_CHECK_EQ(ul_width, QSPI_IFR_WIDTH_SINGLE_BIT_SPI);
+		TEST_CHECK(p_cmd->ul_ifr & QSPI_IFR_ADDREN);
+		if (test_flash_write_enabled()) {
+			memset(&gs_flash[(p_cmd->ul_addr % CONF_QSPI_FLASH_SIZE) &
+					~(QSPI_FLASH_SECTOR_SIZE - 1)], 0xFF,
+					QSPI_FLASH_SECTOR_SIZE);
+			gs_uc_sr1 |= QSPI_FLASH_SR1_WIP;
+			gs_ul_busy = TEST_SE_POLLS;
+		}
+		break;
+	case QSPI_FLASH_QPP:
+		TEST_CHECK_EQ(ul_width, QSPI_IFR_WIDTH_QUAD_OUTPUT);
+		TEST_CHECK(gs_uc_sr2 & QSPI_FLASH_SR2_QE);
+		TEST_CHECK(p_cmd->ul_ifr & QSPI_IFR_ADDREN);
+		/* More than a page would overwrite its start. */
+		TEST_CHECK(ul_len <= QSPI_FLASH_PAGE_SIZE);
+		if (test_flash_write_enabled()) {
+			ul_page = (p_cmd->ul_addr % CONF_QSPI_FLASH_SIZE) &
+					~(QSPI_FLASH_PAGE_SIZE - 1);
+			/* The address wraps within the page; only bits are cleared. */
+			for (i = 0; i < ul_len; i++) {
+				gs_flash[ul_page + (p_cmd->ul_addr + i) %
+						QSPI_FLASH_PAGE_SIZE] &= p_tx8[i];
+			}
+			gs_uc_sr1 |= QSPI_FLASH_SR1_WIP;
+			gs_ul_busy = TEST_PP_POLLS;
+		}
+		break;
+	default:
+		TEST_CHECK_EQ(p_cmd->uc_inst, 0);
+		break;
+	}
+	return STATUS_OK;
+}
+
+static void test_flash_memory_read(const qspi_cmd_t *p_cmd)
+{
+	TEST_CHECK_EQ(p_cmd->uc_inst, QSPI_FLASH_QIOR);
+	TEST_CHECK_EQ(p_cmd->ul_ifr & QSPI_IFR_TFRTYP_Msk,
+			QSPI_IFR_TFRTYP_TRSFR_READ_MEMORY);
+	TEST_CHECK(p_cmd->ul_ifr & QSPI_IFR_ADDREN);
+	TEST_CHECK(gs_uc_sr2 & QSPI_FLASH_SR2_QE);
+	TEST_CHECK(!gs_ul_busy);
+
+	mprotect((void *)QSPIMEM_ADDR, CONF_QSPI_FLASH_SIZE,
+			PROT_READ | PROT_WRITE);
+	memcpy((void *)QSPIMEM_ADDR, gs_flash, CONF_QSPI_FLASH_SIZE);
+	mprotect((void *)QSPIMEM_ADDR, CONF_QSPI_FLASH_SIZE, PROT_READ);
+	gs_b_memory = true;
+}
+
+/* Clock scaling, as clock_scale.c would do it for the driver. */
+static uint32_t gs_ul_mck = TEST_MCK_HZ;
+static struct clock_scale_notifier *gs_p_notifier;
+
+uint32_t clock_scale_get_peripheral_hz(void)
+{
+	return gs_ul_mck;
+}
+
+uint32_t clock_scale_get_cpu_hz(void)
+{
+	return 2 * gs_ul_mck;
+}
+
+void clock_scale_register(struct clock_scale_notifier *p_notifier)
+{
+	gs_p_notifier = p_notifier;
+}
+
+/**
+ * \brief XDMAC model: copy each transfer enabled in memory to memory, from
+ * the window in memory mode, then raise the block end interrupt.
+ */
+static void test_dma_task(void *pv_param)
+{
+	for (;;) {
+		uint32_t ul_ch;
+
+		host_lock();
+		for (ul_ch = 0; ul_ch < XDMACCHID_NUMBER; ul_ch++) {
+			XdmacChid *p_chid = &XDMAC->XDMAC_CHID[ul_ch];
+			uint32_t ul_width;
+			uint32_t ul_len;
+
+			if (!(XDMAC->XDMAC_GE & (XDMAC_GE_EN0 << ul_ch))) {
+				continue;
+			}
+			XDMAC->XDMAC_GE &= ~(XDMAC_GE_EN0 << ul_ch);
+			TEST_CHECK_EQ(p_chid->XDMAC_CC & XDMAC_CC_TYPE,
+					XDMAC_CC_TYPE_MEM_TRAN);
+			TEST_CHECK(gs_b_memory);
+			ul_width = 1u << ((p_chid->XDMAC_CC & XDMAC_CC_DWIDTH_Msk) >>
+					XDMAC_CC_DWIDTH_Pos);
+			ul_len = (p_chid->XDMAC_CUBC & XDMAC_CUBC_UBLEN_Msk) * ul_width;
+			TEST_CHECK(!((p_chid->XDMAC_CSA | p_chid->XDMAC_CDA) &
+					(ul_width - 1)));
+			memcpy((void *)(uintptr_t)p_chid->XDMAC_CDA,
+					(const void *)(uintptr_t)p_chid->XDMAC_CSA, ul_len);
+
+			HOST_REG(XDMAC->XDMAC_GIM) = XDMAC_GIM_IM0 << ul_ch;
+			HOST_REG(XDMAC->XDMAC_GIS) = XDMAC_GIS_IS0 << ul_ch;
+			HOST_REG(p_chid->XDMAC_CIM) = p_chid->XDMAC_CIE;
+			HOST_REG(p_chid->XDMAC_CIS) = XDMAC_CIS_BIS;
+			host_irq(XDMAC_IRQn, XDMAC_Handler);
+			HOST_REG(p_chid->XDMAC_CIS) = 0;
+			HOST_REG(XDMAC->XDMAC_GIS) = 0;
+		}
+		host_unlock();
+		vTaskDelay(1);
+	}
+}
+
+/** Buffers of the reads, static for the 32-bit DMA addresses. */
+static uint8_t gs_uc_data[1024] __attribute__((aligned(32)));
+static uint8_t gs_uc_buf[1024] __attribute__((aligned(32)));
+
+/**
+ * \brief Start: identification, quad enable written once, cached window.
+ */
+static void test_init(void)
+{
+	qspi_flash_stats_t stats;
+
+	TEST_CHECK(qspi_flash_init());
+	TEST_CHECK(!qspi_flash_init());
+	TEST_CHECK(qspi_flash_get_stats(&stats));
+	TEST_CHECK(memcmp(stats.uc_id, gs_uc_id, sizeof(gs_uc_id)) == 0);
+	TEST_CHECK_EQ(stats.map, QSPI_FLASH_MAP_CACHED);
+	TEST_CHECK(test_window_cached());
+	TEST_CHECK(gs_uc_sr2 & QSPI_FLASH_SR2_QE);
+	TEST_CHECK_EQ(gs_ul_status_writes, 1);
+	TEST_CHECK(gs_b_memory);
+	TEST_CHECK(stats.ul_hz <= CONF_QSPI_FLASH_HZ);
+	TEST_CHECK_EQ(stats.ul_hz, TEST_MCK_HZ / 3);
+}
+
+/**
+ * \brief Erase, program across pages and read back, by the CPU and by the
+ * DMA, aligned or not, and in place.
+ */
+static void test_write_read(void)
+{
+	/* Across 4 pages, from the end of one. */
+	const uint32_t ul_addr = QSPI_FLASH_SECTOR_SIZE + 0x1F0;
+	const uint32_t ul_len = 700;
+	qspi_flash_stats_t start, stats;
+	uint32_t i;
+
+	for (i = 0; i < sizeof(gs_uc_data); i++) {
+		gs_uc_data[i] = (uint8_t)(i * 13 + 5);
+	}
+	qspi_flash_get_stats(&start);
+
+	TEST_CHECK_EQ(qspi_flash_erase(QSPI_FLASH_SECTOR_SIZE,
+			2 * QSPI_FLASH_SECTOR_SIZE), STATUS_OK);
+	TEST_CHECK_EQ(qspi_flash_write(ul_addr, gs_uc_data, ul_len), STATUS_OK);
+	TEST_CHECK(gs_b_memory);
+	TEST_CHECK(test_window_cached());
+	TEST_CHECK(memcmp(&gs_flash[ul_addr], gs_uc_data, ul_len) == 0);
+	TEST_CHECK_EQ(gs_flash[ul_addr - 1], 0xFF);
+	TEST_CHECK_EQ(gs_flash[ul_addr + ul_len], 0xFF);
+
+	/* DMA in words, DMA in bytes, CPU. */
+	memset(gs_uc_buf, 0, sizeof(gs_uc_buf));
+	TEST_CHECK_EQ(qspi_flash_read(ul_addr, gs_uc_buf, ul_len), STATUS_OK);
+	TEST_CHECK(memcmp(gs_uc_buf, gs_uc_data, ul_len) == 0);
+	memset(gs_uc_buf, 0, sizeof(gs_uc_buf));
+	TEST_CHECK_EQ(qspi_flash_read(ul_addr + 1, gs_uc_buf, 301), STATUS_OK);
+	TEST_CHECK(memcmp(gs_uc_buf, gs_uc_data + 1, 301) == 0);
+	memset(gs_uc_buf, 0, sizeof(gs_uc_buf));
+	TEST_CHECK_EQ(qspi_flash_read(ul_addr + 3, gs_uc_buf, 50), STATUS_OK);
+	TEST_CHECK(memcmp(gs_uc_buf, gs_uc_data + 3, 50) == 0);
+	TEST_CHECK(memcmp(qspi_flash_map(ul_addr), gs_uc_data, ul_len) == 0);
+
+	qspi_flash_get_stats(&stats);
+	TEST_CHECK_EQ(stats.ul_erases - start.ul_erases, 2);
+	TEST_CHECK_EQ(stats.ul_pages - start.ul_pages, 4);
+	TEST_CHECK_EQ(stats.ul_dma_reads - start.ul_dma_reads, 2);
+	TEST_CHECK_EQ(stats.ul_cpu_reads - start.ul_cpu_reads, 1);
+	TEST_CHECK_EQ(stats.ul_read_bytes - start.ul_read_bytes,
+			ul_len + 301 + 50);
+	TEST_CHECK_EQ(stats.ul_errors, 0);
+
+	/* Programming again only clears bits. */
+	memset(gs_uc_buf, 0x0F, 16);
+	TEST_CHECK_EQ(qspi_flash_write(ul_addr, gs_uc_buf, 16), STATUS_OK);
+	for (i = 0; i < 16; i++) {
+		TEST_CHECK_EQ(((const uint8_t *)qspi_flash_map(ul_addr))[i],
+				gs_uc_data[i] & 0x0F);
+	}
+
+	/* The uncached mapping reads the same. */
+	qspi_flash_set_map(QSPI_FLASH_MAP_UNCACHED);
+	TEST_CHECK(!test_window_cached());
+	TEST_CHECK_EQ(qspi_flash_read(ul_addr + 16, gs_uc_buf, 64), STATUS_OK);
+	TEST_CHECK(memcmp(gs_uc_buf, gs_uc_data + 16, 64) == 0);
+	qspi_flash_set_map(QSPI_FLASH_MAP_CACHED);
+	TEST_CHECK(test_window_cached());
+}
+
+/**
+ * \brief Ranges out of the flash or not on sectors are refused.
+ */
+static void test_args(void)
+{
+	TEST_CHECK_EQ(qspi_flash_read(CONF_QSPI_FLASH_SIZE - 4, gs_uc_buf, 8),
+			ERR_INVALID_ARG);
+	TEST_CHECK_EQ(qspi_flash_write(CONF_QSPI_FLASH_SIZE + 1, gs_uc_buf, 1),
+			ERR_INVALID_ARG);
+	TEST_CHECK_EQ(qspi_flash_erase(QSPI_FLASH_SECTOR_SIZE / 2,
+			QSPI_FLASH_SECTOR_SIZE), ERR_INVALID_ARG);
+	TEST_CHECK_EQ(qspi_flash_erase(0, QSPI_FLASH_PAGE_SIZE),
+			ERR_INVALID_ARG);
+	TEST_CHECK(qspi_flash_map(CONF_QSPI_FLASH_SIZE) == NULL);
+}
+
+/**
+ * \brief The serial clock follows the peripheral clock, never above the
+ * flash limit.
+ */
+static void test_clock(void)
+{
+	static const uint32_t ul_mck[] = { 75000000, 12000000, TEST_MCK_HZ };
+	clock_scale_freq_t freq = { 0 };
+	qspi_flash_stats_t stats;
+	uint32_t i;
+
+	if (!TEST_CHECK(gs_p_notifier != NULL)) {
+		return;
+	}
+	for (i = 0; i < sizeof(ul_mck) / sizeof(ul_mck[0]); i++) {
+		freq.ul_mck_hz = ul_mck[i];
+		gs_p_notifier->callback(CLOCK_SCALE_PRE_CHANGE, &freq,
+				gs_p_notifier->p_ctx);
+		/* Both clocks are served meanwhile. */
+		TEST_CHECK(Max(gs_ul_mck, ul_mck[i]) / (((QSPI->QSPI_SCR &
+				QSPI_SCR_SCBR_Msk) >> QSPI_SCR_SCBR_Pos) + 1) <=
+				CONF_QSPI_FLASH_HZ);
+		gs_ul_mck = ul_mck[i];
+		gs_p_notifier->callback(CLOCK_SCALE_POST_CHANGE, &freq,
+				gs_p_notifier->p_ctx);
+		qspi_flash_get_stats(&stats);
+		TEST_CHECK(stats.ul_hz <= CONF_QSPI_FLASH_HZ);
+		TEST_CHECK(stats.ul_hz >= ul_mck[i] / 2 ||
+				stats.ul_hz >= CONF_QSPI_FLASH_HZ / 2);
+	}
+}
+
+int main(void)
+{
+	void *p = mmap((void *)QSPIMEM_ADDR, CONF_QSPI_FLASH_SIZE, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+	if (!TEST_CHECK(p == (void *)QSPIMEM_ADDR)) {
+		return test_end("qspi_flash");
+	}
+	memset(gs_flash, 0xFF, sizeof(gs_flash));
+	HOST_REG(QSPI->QSPI_SR) = QSPI_SR_QSPIENS;
+	xTaskCreate(test_dma_task, "dma", configMINIMAL_STACK_SIZE, NULL, 1,
+			NULL);
+
+	test_init();
+	test_write_read();
+	test_args();
+	test_clock();
+	TEST_CHECK_EQ(gs_ul_ignored, 0);
+	TEST_CHECK_EQ(gs_ul_status_writes, 1);
+	return test_end("qspi_flash");
+}
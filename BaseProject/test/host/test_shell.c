@@ -0,0 +1,435 @@
+/**
+ * \file
+ *
+ * \brief Host test of the console shell, on the console USART model of
+ * test_console.c.
+ *
+ * The shell task runs against the console driver: characters typed go in
+ * through the receive interrupt, and the echo and command output are read
+ * off the wire. The checks cover the line editor (backspace, Ctrl-U,
+ * Ctrl-C, the up arrow, the line length), a CR LF entering one line only,
+ * argument splitting, and the perfect hash lookup of every command and of
+ * names that are not commands. The commands call stubs of the modules
+ * they report on.
+ *
+ */
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+/* console.c and shell.c are built into the test, to reach their state. */
+#include "console.c"
+#include "shell.c"
+#include "test.h"
+
+/** Ticks without any new output after which the shell is taken as idle. */
+#define TEST_QUIET          5
+
+/** Everything the USART sent since the last test_run(). */
+static char gs_wire[16 * 1024];
+static uint32_t gs_ul_wire;
+
+/** Calls of the stubbed commands. */
+static uint32_t gs_ul_bench_runs;
+static uint32_t gs_ul_boot_reports;
+static uint32_t gs_ul_dsp_resets;
+static int gs_clock_point = -1;
+
+void bench_run(void)
+{
+	gs_ul_bench_runs++;
+}
+
+void boot_report(void)
+{
+	gs_ul_boot_reports++;
+}
+
+bool can_bus_get_stats(can_bus_stats_t *p_stats)
+{
+	return false;
+}
+
+static const char *const gs_clock_names[CLOCK_SCALE_NUM] = {
+#define TEST_CLOCK_NAME(name, source, pres, mdiv) #name,
+	CONF_CLOCK_SCALE_POINTS(TEST_CLOCK_NAME)
+#undef TEST_CLOCK_NAME
+};
+
+status_code_t clock_scale_set(enum clock_scale_point point)
+{
+	gs_clock_point = point;
+	return STATUS_OK;
+}
+
+enum clock_scale_point clock_scale_get(void)
+{
+	return gs_clock_point < 0 ? (enum clock_scale_point)0 :
+			(enum clock_scale_point)gs_clock_point;
+}
+
+const char *clock_scale_get_name(enum clock_scale_point point)
+{
+	return gs_clock_names[point];
+}
+
+uint32_t clock_scale_get_cpu_hz(void)
+{
+	return 300000000;
+}
+
+uint32_t clock_scale_get_peripheral_hz(void)
+{
+	return 150000000;
+}
+
+void *dma_buf_alloc(size_t ul_size, uint32_t ul_flags)
+{
+	return NULL;
+}
+
+void dma_buf_free(void *p_buf)
+{
+}
+
+uint32_t dsp_pool_get_free(void)
+{
+	return 3;
+}
+
+uint32_t dsp_pool_get_min_free(void)
+{
+	return 1;
+}
+
+dsp_pipe_t *dsp_pipe_get(uint32_t ul_index)
+{
+	static dsp_pipe_t s_pipe = { .p_name = "adc" };
+
+	return ul_index == 0 ? &s_pipe : NULL;
+}
+
+void dsp_pipe_reset_stats(dsp_pipe_t *p_pipe)
+{
+	gs_ul_dsp_resets++;
+}
+
+bool flog_get_stats(flog_stats_t *p_stats)
+{
+	return false;
+}
+
+bool netif_get_stats(netif_stats_t *p_stats)
+{
+	return false;
+}
+
+uint32_t net_buf_get_free(void)
+{
+	return 0;
+}
+
+uint32_t net_buf_get_min_free(void)
+{
+	return 0;
+}
+
+bool qspi_flash_get_stats(qspi_flash_stats_t *p_stats)
+{
+	return false;
+}
+
+status_code_t qspi_flash_bench(uint32_t ul_addr, void *p_buf,
+		uint32_t ul_len, qspi_flash_bench_t *p_res)
+{
+	return ERR_IO_ERROR;
+}
+
+bool usb_cdc_get_stats(usb_cdc_stats_t *p_stats)
+{
+	return false;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+	return 2;
+}
+
+void vTaskList(char *pcWriteBuffer)
+{
+	strcpy(pcWriteBuffer, "shell\t\tR\t1\t100\t1\r\n");
+}
+
+/**
+ * \brief Model of the console USART transmitter, as in test_console.c: the
+ * line takes every byte in the ring at once, then TXRDY raises the
+ * interrupt if it is enabled. IMR follows the writes to IER and IDR.
+ *
+ * \return Number of bytes sent.
+ */
+static uint32_t test_usart_tx(void)
+{
+	Usart *p_usart = (Usart *)CONF_UART;
+	uint32_t ul_sent = 0;
+	uint32_t ul_tail;
+
+	host_lock();
+	HOST_REG(p_usart->US_IMR) |= p_usart->US_IER;
+	p_usart->US_IER = 0;
+	if (p_usart->US_IMR & US_IMR_TXRDY) {
+		for (ul_tail = gs_ul_tx_tail; ul_tail != gs_ul_tx_head; ul_tail++) {
+			if (gs_ul_wire < sizeof(gs_wire) - 1) {
+				gs_wire[gs_ul_wire++] = gs_tx_buf[ul_tail & TX_MASK];
+			}
+		}
+		ul_sent = gs_ul_tx_head - gs_ul_tx_tail;
+		HOST_REG(p_usart->US_CSR) = US_CSR_TXRDY;
+		host_irq(CONF_CONSOLE_IRQn, CONF_CONSOLE_Handler);
+		HOST_REG(p_usart->US_CSR) = 0;
+	}
+	HOST_REG(p_usart->US_IMR) &= ~p_usart->US_IDR;
+	p_usart->US_IDR = 0;
+	gs_wire[gs_ul_wire] = '\0';
+	host_unlock();
+
+	return ul_sent;
+}
+
+/**
+ * \brief Model of the console USART receiver: one interrupt per character.
+ */
+static void test_usart_rx(const char *p_str, size_t ul_len)
+{
+	Usart *p_usart = (Usart *)CONF_UART;
+
+	while (ul_len--) {
+		host_lock();
+		HOST_REG(p_usart->US_IMR) |= p_usart->US_IER;
+		p_usart->US_IER = 0;
+		HOST_REG(p_usart->US_RHR) = (uint8_t)*p_str++;
+		HOST_REG(p_usart->US_CSR) = US_CSR_RXRDY;
+		host_irq(CONF_CONSOLE_IRQn, CONF_CONSOLE_Handler);
+		HOST_REG(p_usart->US_CSR) = 0;
+		host_unlock();
+	}
+}
+
+/**
+ * \brief Type \a p_str and collect the output of the shell until it has
+ * read everything and stayed quiet for TEST_QUIET ticks.
+ *
+ * \return The output, NUL terminated.
+ */
+static const char *test_run_len(const char *p_str, size_t ul_len)
+{
+	uint32_t ul_quiet = 0;
+	uint32_t ul_ticks = 0;
+
+	gs_ul_wire = 0;
+	gs_wire[0] = '\0';
+	test_usart_rx(p_str, ul_len);
+	while (ul_quiet < TEST_QUIET && ul_ticks++ < 5000) {
+		vTaskDelay(1);
+		if (test_usart_tx() || gs_ul_rx_tail != gs_ul_rx_head) {
+			ul_quiet = 0;
+		} else {
+			ul_quiet++;
+		}
+	}
+
+	return gs_wire;
+}
+
+static const char *test_run(const char *p_str)
+{
+	return test_run_len(p_str, strlen(p_str));
+}
+
+/**
+ * \brief Check the output of \a p_str.
+ */
+#define TEST_OUTPUT(p_str, p_expected) \
+	test_output(test_run(p_str), p_expected, __LINE__)
+
+static bool test_output(const char *p_out, const char *p_expected, int line)
+{
+	if (strcmp(p_out, p_expected)) {
+		printf("%s:%d: output \"", __FILE__, line);
+		for (; *p_out; p_out++) {
+			printf(*p_out >= ' ' && *p_out < 0x7f ? "%c" : "\\x%02x",
+					(uint8_t)*p_out);
+		}
+		printf("\"\n");
+		gs_test_failures++;
+		return false;
+	}
+	return true;
+}
+
+static void test_editing(void)
+{
+	char ac_long[CONF_SHELL_LINE_SIZE + 21];
+	char ac_expected[CONF_SHELL_LINE_SIZE + 64];
+
+	/* Backspace and delete erase on the terminal too, not past the start. */
+	TEST_OUTPUT("boox\bt", "boox\b \bt");
+	TEST_OUTPUT("\r", "\r\n> ");
+	TEST_CHECK_EQ(gs_ul_boot_reports, 1);
+	TEST_OUTPUT("a\x7f\x7f\b", "a\b \b");
+	TEST_OUTPUT("\r", "\r\n> ");
+
+	/* Ctrl-U erases the line, Ctrl-C cancels it. */
+	TEST_OUTPUT("abc\x15", "abc\b \b\b \b\b \b");
+	TEST_OUTPUT("xyz\x03", "xyz^C\r\n> ");
+	TEST_OUTPUT("\r", "\r\n> ");
+
+	/* Control characters are not echoed nor stored. */
+	TEST_OUTPUT("bo\x01\x02ot\r", "boot\r\n> ");
+	TEST_CHECK_EQ(gs_ul_boot_reports, 2);
+
+	/* The up arrow recalls the last command, replacing the line. */
+	TEST_OUTPUT("he\x1b[A", "he\b \b\b \bboot");
+	TEST_OUTPUT("\r", "\r\n> ");
+	TEST_CHECK_EQ(gs_ul_boot_reports, 3);
+	/* Other sequences, with parameters, are skipped whole. */
+	TEST_OUTPUT("\x1b[1;5C\x1bOx", "x");
+	TEST_OUTPUT("\x15", "\b \b");
+	/* An empty line runs nothing and leaves the history alone. */
+	TEST_OUTPUT("\r", "\r\n> ");
+	TEST_OUTPUT("\x1b[A\r", "boot\r\n> ");
+	TEST_CHECK_EQ(gs_ul_boot_reports, 4);
+
+	/* Characters past the line size are dropped. */
+	memset(ac_long, 'z', sizeof(ac_long) - 1);
+	ac_long[sizeof(ac_long) - 1] = '\0';
+	memset(ac_expected, 'z', CONF_SHELL_LINE_SIZE);
+	ac_expected[CONF_SHELL_LINE_SIZE] = '\0';
+	TEST_OUTPUT(ac_long, ac_expected);
+	TEST_CHECK_EQ(gs_ul_line_len, CONF_SHELL_LINE_SIZE);
+	snprintf(ac_expected, sizeof(ac_expected),
+			"\r\n%s: unknown command, try help\r\n> ", &ac_long[20]);
+	TEST_OUTPUT("\r", ac_expected);
+}
+
+static void test_line_endings(void)
+{
+	/* CR LF, CR and LF each end one line. */
+	TEST_OUTPUT("boot\r\n", "boot\r\n> ");
+	TEST_CHECK_EQ(gs_ul_boot_reports, 5);
+	TEST_OUTPUT("boot\r", "boot\r\n> ");
+	TEST_OUTPUT("\n", "");
+	TEST_OUTPUT("boot\n", "boot\r\n> ");
+	TEST_CHECK_EQ(gs_ul_boot_reports, 7);
+	/* LF LF is two lines, CR CR too. Only the LF just after a CR goes. */
+	TEST_OUTPUT("\n\n", "\r\n> \r\n> ");
+	TEST_OUTPUT("\r\r\n", "\r\n> \r\n> ");
+	TEST_OUTPUT("\rboot\n", "\r\n> boot\r\n> ");
+	TEST_CHECK_EQ(gs_ul_boot_reports, 8);
+	/* The CR LF split across two reads. */
+	TEST_OUTPUT("bench\r", "bench\r\n> ");
+	TEST_OUTPUT("\nboot\r", "boot\r\n> ");
+	TEST_CHECK_EQ(gs_ul_bench_runs, 1);
+	TEST_CHECK_EQ(gs_ul_boot_reports, 9);
+	TEST_OUTPUT("\n", "");
+}
+
+static void test_lookup(void)
+{
+	char ac_line[64];
+	char ac_expected[96];
+	const char *p_out;
+	uint32_t i;
+
+	/* Every command is found in its own slot, by its name only. */
+	for (i = 0; i < SHELL_CMD_COUNT; i++) {
+		const char *p_name = gs_shell_cmds[i].p_name;
+
+		TEST_CHECK_EQ(gs_shell_slots[shell_hash(p_name) &
+				(SHELL_HASH_SIZE - 1)], i);
+		TEST_CHECK(shell_find(p_name) == &gs_shell_cmds[i]);
+		snprintf(ac_line, sizeof(ac_line), "%sx", p_name);
+		TEST_CHECK(shell_find(ac_line) == NULL);
+		snprintf(ac_line, sizeof(ac_line), "%.*s", (int)strlen(p_name) - 1,
+				p_name);
+		TEST_CHECK(shell_find(ac_line) == NULL);
+	}
+	TEST_CHECK(shell_find("") == NULL);
+	TEST_CHECK(shell_find("HELP") == NULL);
+
+	/* help lists them all, in order. */
+	p_out = test_run("help\r");
+	for (i = 0; i < SHELL_CMD_COUNT; i++) {
+		snprintf(ac_line, sizeof(ac_line), "  %-8s %s\r\n",
+				gs_shell_cmds[i].p_name, gs_shell_cmds[i].p_help);
+		p_out = strstr(p_out, ac_line);
+		if (!TEST_CHECK(p_out != NULL)) {
+			break;
+		}
+	}
+
+	/* Unknown names. */
+	TEST_OUTPUT("helpme\r", "helpme\r\nhelpme: unknown command, try help\r\n"
+			"> ");
+	TEST_OUTPUT("hel p\r", "hel p\r\nhel: unknown command, try help\r\n> ");
+
+	/* Arguments are split on runs of spaces. */
+	for (i = 0; i < CLOCK_SCALE_NUM; i++) {
+		snprintf(ac_line, sizeof(ac_line), "  clock   %s  \r",
+				gs_clock_names[i]);
+		snprintf(ac_expected, sizeof(ac_expected), "  clock   %s  \r\n"
+				"%s: cpu 300000000 Hz mck 150000000 Hz\r\n> ",
+				gs_clock_names[i], gs_clock_names[i]);
+		gs_clock_point = -1;
+		test_output(test_run(ac_line), ac_expected, __LINE__);
+		TEST_CHECK_EQ(gs_clock_point, i);
+	}
+	TEST_OUTPUT("clock slowest\r", "clock slowest\r\nunknown point slowest"
+			"\r\n> ");
+	for (i = 0; i < 2; i++) {
+		snprintf(ac_line, sizeof(ac_line), "%s\r", i ? "dsp" : "dsp reset");
+		snprintf(ac_expected, sizeof(ac_expected), "%.*s\r\npool: 3 free, "
+				"1 min, %u blocks of %u\r\nadc: 0 dropped\r\n> ",
+				(int)strlen(ac_line) - 1, ac_line, CONF_DSP_POOL_BLOCKS,
+				CONF_DSP_BLOCK_SIZE);
+		test_output(test_run(ac_line), ac_expected, __LINE__);
+		/* Only "dsp reset" clears the profiles. */
+		TEST_CHECK_EQ(gs_ul_dsp_resets, 1);
+	}
+	TEST_OUTPUT("can\r", "can\r\nnot started\r\n> ");
+}
+
+/**
+ * \brief Output longer than the transmit ring: the shell sleeps in
+ * console_write() until the interrupt makes room, and nothing is lost.
+ */
+static void test_long_output(void)
+{
+	console_stats_t stats;
+	const char *p_out;
+	uint32_t ul_lines = 0;
+
+	p_out = test_run("tasks\rtrace\rhelp\rhelp\r");
+	while ((p_out = strstr(p_out, "\r\n")) != NULL) {
+		p_out += 2;
+		ul_lines++;
+	}
+	TEST_CHECK(gs_ul_wire > 3 * CONF_CONSOLE_TX_BUFFER_SIZE);
+	TEST_CHECK_EQ(ul_lines, 4 + 3 + 2 * (1 + SHELL_CMD_COUNT));
+	console_get_stats(&stats);
+	TEST_CHECK_EQ(stats.ul_tx_dropped, 0);
+	TEST_CHECK_EQ(stats.ul_rx_overruns, 0);
+}
+
+int main(void)
+{
+	console_init();
+	xTaskCreate(shell_task, "shell", configMINIMAL_STACK_SIZE, NULL, 1,
+			NULL);
+	TEST_OUTPUT("", "\r\n> ");
+
+	test_editing();
+	test_line_endings();
+	test_lookup();
+	test_long_output();
+	return test_end("shell");
+}
@@ -0,0 +1,230 @@
+/**
+ * \file
+ *
+ * \brief Host test of the stack overflow check of the context switch, and
+ * time of vTaskSwitchContext() with the MPU guard or the fill pattern.
+ *
+ * The kernel is built into the test, without its scheduler: the test
+ * creates a few tasks of one priority and calls vTaskSwitchContext() as
+ * PendSV would, so the kernel takes them in turn. It is built twice, with
+ * TEST_STACK_GUARD 1 for CONF_STACK_GUARD, where the guard band follows the
+ * incoming task through traceTASK_SWITCHED_IN(), and 0 for the fill pattern
+ * check of configCHECK_FOR_STACK_OVERFLOW 2.
+ *
+ * The test checks that the guard region is moved to the bottom of each
+ * incoming stack, or that an overwritten fill pattern is reported, and
+ * times the switch. The host runs no MPU: the guard write is a store to
+ * memory, and its __DSB() a full fence of the host, which costs it more than
+ * the barrier does on the target.
+ *
+ */
+
+/* The stack check is chosen by the build of the test. */
+#include "conf_stack_guard.h"
+#undef CONF_STACK_GUARD
+#define CONF_STACK_GUARD    TEST_STACK_GUARD
+
+#include <asf.h>
+#include <stdlib.h>
+#include "FreeRTOS.h"
+
+/* Port optimised task selection, as in the Cortex-M7 port. */
+#define portRECORD_READY_PRIORITY(uxPriority, uxReadyPriorities) \
+	(uxReadyPriorities) |= (1UL << (uxPriority))
+#define portRESET_READY_PRIORITY(uxPriority, uxReadyPriorities) \
+	(uxReadyPriorities) &= ~(1UL << (uxPriority))
+#define portGET_HIGHEST_PRIORITY(uxTopPriority, uxReadyPriorities) \
+	uxTopPriority = (31UL - (uint32_t)__builtin_clz(uxReadyPriorities))
+
+/* The kernel is built into the test, see above. */
+#include "list.c"
+#include "tasks.c"
+#include "test.h"
+
+/** Tasks switched between. */
+#define TEST_TASKS          4
+
+/** Switches timed per round, and rounds. */
+#define TEST_SWITCHES       1000000
+#define TEST_ROUNDS         5
+
+static TaskHandle_t gs_x_tasks[TEST_TASKS];
+static TaskHandle_t gs_x_overflow;
+static uint32_t gs_ul_overflows;
+
+void vApplicationStackOverflowHook(TaskHandle_t xTask, char *pcTaskName)
+{
+	gs_x_overflow = xTask;
+	gs_ul_overflows++;
+}
+
+void vApplicationTickHook(void)
+{
+}
+
+void vApplicationMallocFailedHook(void)
+{
+}
+
+/* Port layer, no task ever runs. */
+StackType_t *pxPortInitialiseStack(StackType_t *pxTopOfStack,
+		TaskFunction_t pxCode, void *pvParameters)
+{
+	return pxTopOfStack - 16;
+}
+
+BaseType_t xPortStartScheduler(void)
+{
+	return pdFALSE;
+}
+
+void vPortEndScheduler(void)
+{
+}
+
+void vPortYield(void)
+{
+}
+
+void vPortEnterCritical(void)
+{
+}
+
+void vPortExitCritical(void)
+{
+}
+
+/* Lock of the host interrupts, with a single thread. */
+void host_lock(void)
+{
+}
+
+void host_unlock(void)
+{
+}
+
+UBaseType_t ulPortSetInterruptMask(void)
+{
+	return 0;
+}
+
+void vPortClearInterruptMask(UBaseType_t uxMask)
+{
+}
+
+void *pvPortMalloc(size_t xWantedSize)
+{
+	return malloc(xWantedSize);
+}
+
+void vPortFree(void *pv)
+{
+	free(pv);
+}
+
+BaseType_t xTimerCreateTimerTask(void)
+{
+	return pdPASS;
+}
+
+static void test_task(void *p_arg)
+{
+}
+
+static void test_create(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < TEST_TASKS; i++) {
+		char c_name[configMAX_TASK_NAME_LEN];
+
+		snprintf(c_name, sizeof(c_name), "task%lu", (unsigned long)i);
+		TEST_CHECK_EQ(xTaskCreate(test_task, c_name,
+				configMINIMAL_STACK_SIZE, NULL, 1, &gs_x_tasks[i]), pdPASS);
+	}
+}
+
+/** Each task comes in turn, the stack check follows it. */
+static void test_switch(void)
+{
+	TCB_t *p_tcbs[TEST_TASKS];
+	uint32_t i;
+
+	for (i = 0; i < TEST_TASKS; i++) {
+		p_tcbs[i] = (TCB_t *)gs_x_tasks[i];
+	}
+	for (i = 0; i < 2 * TEST_TASKS; i++) {
+		TCB_t *p_prev = pxCurrentTCB;
+
+		vTaskSwitchContext();
+		TEST_CHECK(pxCurrentTCB != p_prev);
+#if CONF_STACK_GUARD
+		{
+			uint32_t ul_base = ((uint32_t)(uintptr_t)pxCurrentTCB->pxStack +
+					STACK_GUARD_SIZE - 1) & ~(uint32_t)(STACK_GUARD_SIZE - 1);
+
+			TEST_CHECK_EQ(MPU->RBAR, ul_base | MPU_RBAR_VALID_Msk |
+					CONF_STACK_GUARD_MPU_REGION);
+		}
+#endif
+	}
+
+	/* An overflow of the outgoing task. */
+	for (i = 0; i < TEST_TASKS && p_tcbs[i] != pxCurrentTCB; i++) {
+	}
+	TEST_CHECK(i < TEST_TASKS);
+	pxCurrentTCB->pxStack[2] = 0;
+	gs_ul_overflows = 0;
+	gs_x_overflow = NULL;
+	vTaskSwitchContext();
+#if CONF_STACK_GUARD
+	/* Left to the MPU, which faults on the write. */
+	TEST_CHECK_EQ(gs_ul_overflows, 0);
+#else
+	TEST_CHECK_EQ(gs_ul_overflows, 1);
+	TEST_CHECK(gs_x_overflow == (TaskHandle_t)p_tcbs[i]);
+#endif
+	p_tcbs[i]->pxStack[2] = tskSTACK_FILL_BYTE * 0x01010101u;
+}
+
+static void test_time(void)
+{
+	double d_best = 1e9;
+	uint32_t i, j;
+
+	gs_ul_overflows = 0;
+	for (i = 0; i < TEST_ROUNDS; i++) {
+		double d_start = test_seconds();
+		double d_ns;
+
+		for (j = 0; j < TEST_SWITCHES; j++) {
+			vTaskSwitchContext();
+		}
+		d_ns = (test_seconds() - d_start) * 1e9 / TEST_SWITCHES;
+		if (d_ns < d_best) {
+			d_best = d_ns;
+		}
+	}
+	TEST_CHECK_EQ(gs_ul_overflows, 0);
+	printf("vTaskSwitchContext, %s: %.1f ns\n",
+			CONF_STACK_GUARD ? "mpu guard" : "fill pattern", d_best);
+#if CONF_STACK_GUARD
+	{
+		double d_start = test_seconds();
+
+		for (j = 0; j < TEST_SWITCHES; j++) {
+			__DSB();
+		}
+		printf("  of which the host fence of __DSB(): %.1f ns\n",
+				(test_seconds() - d_start) * 1e9 / TEST_SWITCHES);
+	}
+#endif
+}
+
+int main(void)
+{
+	test_create();
+	test_switch();
+	test_time();
+	return test_end(CONF_STACK_GUARD ? "switch_guard" : "switch_pattern");
+}
@@ -0,0 +1,276 @@
+/**
+ * \file
+ *
+ * \brief Host test of the USART asynchronous baud rate planner, at the
+ * master clocks of conf_clock.h and of the clock_scale operating points.
+ *
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "sysclk.h"
+#include "usart.h"
+#include "conf_clock_scale.h"
+#include "clock_scale.h"
+#include "test.h"
+
+/** Largest divider, CD and FP together, in 1/8 steps. */
+#define TEST_MAX_CD_FP      ((US_BRGR_CD_Msk >> US_BRGR_CD_Pos) * 8 + 7)
+
+/** Random rates tried at each clock. */
+#define TEST_SWEEP          100000
+
+/** A master clock of the board and where it comes from. */
+typedef struct {
+	const char *p_name;
+	uint32_t ul_mck_hz;
+} test_clock_t;
+
+/** Baud rates of the test, from the slowest console to the fastest SPI. */
+static const uint32_t gs_ul_bauds[] = {
+	300, 1200, 9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600,
+	1000000, 1500000, 2000000, 3000000, 4000000, 6000000, 8000000, 9375000,
+	12000000, 18750000,
+};
+
+static test_clock_t gs_clocks[8];
+static uint32_t gs_ul_clocks;
+
+/**
+ * \brief Master clocks of the board: the one sysclk_init() sets from
+ * conf_clock.h, then each operating point, worked out as clock_scale.c does.
+ */
+static void test_clocks(void)
+{
+	uint32_t ul_hz;
+
+	ul_hz = pll_get_default_rate(0);
+	if (CONFIG_SYSCLK_PRES == SYSCLK_PRES_3) {
+		ul_hz /= 3;
+	} else {
+		ul_hz >>= CONFIG_SYSCLK_PRES >> PMC_MCKR_PRES_Pos;
+	}
+	gs_clocks[gs_ul_clocks].p_name = "conf_clock";
+	gs_clocks[gs_ul_clocks++].ul_mck_hz = ul_hz / CONFIG_SYSCLK_DIV;
+
+#define CLOCK_SCALE_POINT(name, source, pres, mdiv) \
+	ul_hz = ((source) == CLOCK_SCALE_SRC_PLLA) ? pll_get_default_rate(0) : \
+			OSC_MAINCK_XTAL_HZ; \
+	ul_hz = ((pres) == SYSCLK_PRES_3) ? ul_hz / 3 : \
+			ul_hz >> ((pres) >> PMC_MCKR_PRES_Pos); \
+	gs_clocks[gs_ul_clocks].p_name = #name; \
+	gs_clocks[gs_ul_clocks++].ul_mck_hz = ul_hz / (mdiv);
+	CONF_CLOCK_SCALE_POINTS(CLOCK_SCALE_POINT)
+#undef CLOCK_SCALE_POINT
+}
+
+/**
+ * \brief Error of a divider, in ppm of the set point.
+ */
+static double test_error_ppm(uint32_t ul_mck, uint32_t ul_over,
+		uint32_t ul_cd_fp, uint32_t ul_baud)
+{
+	return (8.0 * ul_mck / ((double)ul_over * ul_cd_fp) - ul_baud) * 1e6 /
+			ul_baud;
+}
+
+/**
+ * \brief Smallest error of one oversampling over every divider.
+ *
+ * \return The error in ppm, or a negative value if no divider is in range.
+ */
+static double test_best_error(uint32_t ul_mck, uint32_t ul_over,
+		uint32_t ul_baud)
+{
+	double d_best = -1.0;
+	double d_err;
+	uint32_t ul_cd_fp;
+
+	for (ul_cd_fp = 8; ul_cd_fp <= TEST_MAX_CD_FP; ul_cd_fp++) {
+		d_err = fabs(test_error_ppm(ul_mck, ul_over, ul_cd_fp, ul_baud));
+		if (d_best < 0 || d_err < d_best) {
+			d_best = d_err;
+		}
+	}
+	return d_best;
+}
+
+/**
+ * \brief Each plan is the best divider of both oversamplings, 16x on a tie,
+ * and reports the rate and error it gives.
+ */
+static void test_plan(const test_clock_t *p_clock)
+{
+	usart_baud_plan_t plan;
+	double d_best_16;
+	double d_best_8;
+	double d_err;
+	uint32_t ul_cd_fp;
+	uint32_t i;
+
+	for (i = 0; i < sizeof(gs_ul_bauds) / sizeof(gs_ul_bauds[0]); i++) {
+		if (gs_ul_bauds[i] > p_clock->ul_mck_hz / 8) {
+			TEST_CHECK_EQ(usart_plan_async_baudrate(gs_ul_bauds[i],
+					p_clock->ul_mck_hz, &plan), 1);
+			continue;
+		}
+		if (!TEST_CHECK_EQ(usart_plan_async_baudrate(gs_ul_bauds[i],
+				p_clock->ul_mck_hz, &plan), 0)) {
+			printf("%s: %lu baud\n", p_clock->p_name,
+					(unsigned long)gs_ul_bauds[i]);
+			continue;
+		}
+		TEST_CHECK(plan.over == 16 || plan.over == 8);
+		TEST_CHECK(plan.cd >= 1 && plan.cd <= US_BRGR_CD_Msk);
+		TEST_CHECK(plan.fp <= 7);
+
+		ul_cd_fp = plan.cd * 8 + plan.fp;
+		d_err = test_error_ppm(p_clock->ul_mck_hz, plan.over, ul_cd_fp,
+				gs_ul_bauds[i]);
+		TEST_CHECK_NEAR(plan.actual_baudrate,
+				8.0 * p_clock->ul_mck_hz / (plan.over * ul_cd_fp), 1.0);
+		TEST_CHECK_NEAR(plan.error_ppm, d_err, 1.0);
+
+		/* The best divider of its oversampling. */
+		TEST_CHECK_NEAR(fabs(d_err), test_best_error(p_clock->ul_mck_hz,
+				plan.over, gs_ul_bauds[i]), 1e-6);
+		/*
+		 * And of both, to the ppm of the plan, 16x when the other is no
+		 * better by a ppm.
+		 */
+		d_best_16 = test_best_error(p_clock->ul_mck_hz, 16, gs_ul_bauds[i]);
+		d_best_8 = test_best_error(p_clock->ul_mck_hz, 8, gs_ul_bauds[i]);
+		if (d_best_16 < 0) {
+			TEST_CHECK_EQ(plan.over, 8);
+		} else if (d_best_8 < 0 || d_best_16 < d_best_8 + 1.0) {
+			TEST_CHECK_EQ(plan.over, 16);
+		} else {
+			TEST_CHECK(fabs(d_err) < d_best_16);
+		}
+		if (!TEST_CHECK(fabs(d_err) < Min(d_best_16 < 0 ? d_best_8 : d_best_16,
+				d_best_8 < 0 ? d_best_16 : d_best_8) + 1.0)) {
+			printf("%s: %lu baud, %lux %lu + %lu/8\n", p_clock->p_name,
+					(unsigned long)gs_ul_bauds[i], (unsigned long)plan.over,
+					(unsigned long)plan.cd, (unsigned long)plan.fp);
+		}
+	}
+
+	/* The limits of the dividers. */
+	TEST_CHECK_EQ(usart_plan_async_baudrate(0, p_clock->ul_mck_hz, &plan), 1);
+	TEST_CHECK_EQ(usart_plan_async_baudrate(p_clock->ul_mck_hz / 8,
+			p_clock->ul_mck_hz, &plan), 0);
+	TEST_CHECK_EQ(plan.over, 8);
+	TEST_CHECK_EQ(plan.cd, 1);
+	TEST_CHECK_EQ(plan.error_ppm, 0);
+	TEST_CHECK_EQ(usart_plan_async_baudrate(p_clock->ul_mck_hz / 7,
+			p_clock->ul_mck_hz, &plan), 1);
+	TEST_CHECK_EQ(usart_plan_async_baudrate(p_clock->ul_mck_hz /
+			(16 * (US_BRGR_CD_Msk >> US_BRGR_CD_Pos)) + 1,
+			p_clock->ul_mck_hz, &plan), 0);
+	TEST_CHECK_EQ(usart_plan_async_baudrate(p_clock->ul_mck_hz / (1 << 24),
+			p_clock->ul_mck_hz, &plan), 1);
+}
+
+/**
+ * \brief Over random rates, the plan is closer than the dividers next to
+ * it: the error is the smallest of its oversampling, as it only grows away
+ * from the best divider.
+ */
+static void test_sweep(const test_clock_t *p_clock)
+{
+	usart_baud_plan_t plan;
+	uint32_t ul_state = 0x2545F491;
+	uint32_t ul_baud;
+	uint32_t ul_cd_fp;
+	uint32_t ul_misses = 0;
+	double d_err;
+	uint32_t i;
+
+	for (i = 0; i < TEST_SWEEP; i++) {
+		ul_baud = 300 + test_rand(&ul_state) % (p_clock->ul_mck_hz / 8 - 300);
+		if (!TEST_CHECK_EQ(usart_plan_async_baudrate(ul_baud,
+				p_clock->ul_mck_hz, &plan), 0)) {
+			continue;
+		}
+		ul_cd_fp = plan.cd * 8 + plan.fp;
+		d_err = fabs(test_error_ppm(p_clock->ul_mck_hz, plan.over, ul_cd_fp,
+				ul_baud));
+		if ((ul_cd_fp > 8 && fabs(test_error_ppm(p_clock->ul_mck_hz,
+				plan.over, ul_cd_fp - 1, ul_baud)) < d_err) ||
+				(ul_cd_fp < TEST_MAX_CD_FP && fabs(test_error_ppm(
+				p_clock->ul_mck_hz, plan.over, ul_cd_fp + 1, ul_baud)) <
+				d_err)) {
+			ul_misses++;
+		}
+	}
+	TEST_CHECK_EQ(ul_misses, 0);
+}
+
+/**
+ * \brief usart_set_async_baudrate() programs the plan: OVER in MR, the rest
+ * of MR untouched, CD and FP in BRGR.
+ */
+static void test_set(const test_clock_t *p_clock)
+{
+	Usart *p_usart = USART1;
+	usart_baud_plan_t plan;
+	uint32_t ul_mr = US_MR_CHRL_8_BIT | US_MR_PAR_NO;
+	uint32_t i;
+
+	for (i = 0; i < sizeof(gs_ul_bauds) / sizeof(gs_ul_bauds[0]); i++) {
+		p_usart->US_MR = ul_mr | ((i & 1) ? US_MR_OVER : 0);
+		p_usart->US_BRGR = 0x1234;
+		if (usart_plan_async_baudrate(gs_ul_bauds[i], p_clock->ul_mck_hz,
+				&plan)) {
+			TEST_CHECK_EQ(usart_set_async_baudrate(p_usart, gs_ul_bauds[i],
+					p_clock->ul_mck_hz), 1);
+			TEST_CHECK_EQ(p_usart->US_BRGR, 0x1234);
+			continue;
+		}
+		TEST_CHECK_EQ(usart_set_async_baudrate(p_usart, gs_ul_bauds[i],
+				p_clock->ul_mck_hz), 0);
+		TEST_CHECK_EQ(p_usart->US_MR & ~US_MR_OVER, ul_mr);
+		TEST_CHECK_EQ(!!(p_usart->US_MR & US_MR_OVER), plan.over == 8);
+		TEST_CHECK_EQ(p_usart->US_BRGR,
+				US_BRGR_CD(plan.cd) | US_BRGR_FP(plan.fp));
+	}
+}
+
+int main(void)
+{
+	usart_baud_plan_t plan;
+	uint32_t i;
+
+	test_clocks();
+	TEST_CHECK_EQ(gs_clocks[0].ul_mck_hz, gs_clocks[1].ul_mck_hz);
+
+	printf("%-12s %10s %9s %4s %9s %10s\n", "clock", "mck", "baud", "over",
+			"actual", "error ppm");
+	for (i = 0; i < gs_ul_clocks; i++) {
+		test_plan(&gs_clocks[i]);
+		test_sweep(&gs_clocks[i]);
+		test_set(&gs_clocks[i]);
+		/* The USART1 rates of the request, where they can be reached. */
+		if (!usart_plan_async_baudrate(6000000, gs_clocks[i].ul_mck_hz,
+				&plan)) {
+			printf("%-12s %10lu %9u %4lu %9lu %10ld\n", gs_clocks[i].p_name,
+					(unsigned long)gs_clocks[i].ul_mck_hz, 6000000,
+					(unsigned long)plan.over,
+					(unsigned long)plan.actual_baudrate,
+					(long)plan.error_ppm);
+		}
+	}
+
+	/* The rates the request is about, from the 150 MHz MCK. */
+	TEST_CHECK_EQ(usart_plan_async_baudrate(6000000, 150000000, &plan), 0);
+	TEST_CHECK_EQ(plan.error_ppm, 0);
+	TEST_CHECK_EQ(usart_plan_async_baudrate(9375000, 150000000, &plan), 0);
+	TEST_CHECK_EQ(plan.over, 16);
+	TEST_CHECK_EQ(plan.cd, 1);
+	TEST_CHECK_EQ(usart_plan_async_baudrate(12500000, 150000000, &plan), 0);
+	TEST_CHECK_EQ(plan.over, 8);
+	TEST_CHECK_EQ(plan.cd * 8 + plan.fp, 12);
+	TEST_CHECK_EQ(plan.error_ppm, 0);
+
+	return test_end("usart_baud");
+}
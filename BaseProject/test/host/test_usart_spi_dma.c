@@ -0,0 +1,641 @@
+/**
+ * \file
+ *
+ * \brief Host test of the USART SPI master DMA engine, against a model of
+ * the XDMAC, of the USART in SPI master mode and of a slave on its bus.
+ *
+ * The XDMAC model follows the enable, disable and interrupt mask writes of
+ * the driver at each of its accesses, and stops a channel as soon as it is
+ * disabled. It clocks the bus one character at a time, at the pace the
+ * test asks: the transmit channel feeds THR, the slave answers each
+ * character with one that depends only on its position on the wire, and
+ * the receive channel stores the answer. The chip selects are hooked, so
+ * that every character is logged with the line asserted when it went out.
+ *
+ * The checks cover queued transfers and transfers submitted from the
+ * completion callback, USART_SPI_DMA_CS_HOLD across transfers, the
+ * transmit dummy and the receive sink, abort, a bus error on either
+ * channel, and the baud rate divisor.
+ *
+ */
+
+#include <asf.h>
+#include "dcache.h"
+#include "usart_spi_dma.h"
+
+/* The chip selects and the XDMAC accesses of the driver go to the model. */
+static void test_cs_pin(ioport_pin_t pin, bool b_level);
+static void test_cs_force(Usart *p_usart);
+static void test_cs_release(Usart *p_usart);
+static Xdmac *test_xdmac(void);
+#define ioport_set_pin_level            test_cs_pin
+#define usart_spi_force_chip_select     test_cs_force
+#define usart_spi_release_chip_select   test_cs_release
+#undef XDMAC
+#define XDMAC                           test_xdmac()
+
+/* xdmac.c and usart_spi_dma.c are built into the test, on the model. */
+#include "xdmac.c"
+#include "usart_spi_dma.c"
+#include "test.h"
+
+/** Chip select pins of the two slaves driven by GPIO. */
+#define TEST_CS_A           IOPORT_CREATE_PIN(PIOA, 5)
+#define TEST_CS_B           IOPORT_CREATE_PIN(PIOB, 2)
+
+/** Baud rate of the bus. */
+#define TEST_BAUD           10000000u
+
+/** Characters the wire log holds. */
+#define TEST_WIRE_SIZE      8192
+
+/** Transfers and buffers of the tests. */
+#define TEST_XFERS          6
+#define TEST_BUF_SIZE       256
+
+/** Value of the bytes a transfer must not touch. */
+#define TEST_GUARD          0xEE
+
+/** Chip select lines, and the value logged when none is asserted. */
+enum test_line {
+	TEST_LINE_A,
+	TEST_LINE_B,
+	TEST_LINE_HW,
+	TEST_LINES,
+	TEST_LINE_NONE = TEST_LINES,
+};
+
+static usart_spi_dma_t gs_spi;
+
+/** State of the lines, assertions of each, and overlapping assertions. */
+static bool gs_b_cs[TEST_LINES];
+static uint32_t gs_ul_asserts[TEST_LINES];
+static uint32_t gs_ul_overlaps;
+
+/** Every character on the bus, and the line asserted meanwhile. */
+static uint8_t gs_mosi[TEST_WIRE_SIZE];
+static uint8_t gs_line[TEST_WIRE_SIZE];
+static uint32_t gs_ul_wire;
+
+/** Channels running, as the model follows them. */
+static uint32_t gs_ul_running;
+
+/** Error to raise before the character at gs_ul_error_at. */
+static uint32_t gs_ul_error_at = UINT32_MAX;
+static uint32_t gs_ul_error_cis;
+static bool gs_b_error_on_tx;
+
+static struct usart_spi_xfer gs_xfers[TEST_XFERS];
+static uint8_t gs_tx[TEST_XFERS][TEST_BUF_SIZE] DCACHE_ALIGNED;
+static uint8_t gs_rx[TEST_XFERS][TEST_BUF_SIZE] DCACHE_ALIGNED;
+
+/** Completed transfers, in the order of their callbacks. */
+static struct usart_spi_xfer *gs_p_done[4 * TEST_XFERS];
+static uint32_t gs_ul_done;
+
+static void test_cs_set(enum test_line line, bool b_assert)
+{
+	uint32_t i;
+
+	if (b_assert && !gs_b_cs[line]) {
+		gs_ul_asserts[line]++;
+		for (i = 0; i < TEST_LINES; i++) {
+			if (gs_b_cs[i]) {
+				gs_ul_overlaps++;
+			}
+		}
+	}
+	gs_b_cs[line] = b_assert;
+}
+
+static void test_cs_pin(ioport_pin_t pin, bool b_level)
+{
+	if (TEST_CHECK(pin == TEST_CS_A || pin == TEST_CS_B)) {
+		test_cs_set(pin == TEST_CS_A ? TEST_LINE_A : TEST_LINE_B, !b_level);
+	}
+}
+
+static void test_cs_force(Usart *p_usart)
+{
+	TEST_CHECK(p_usart == USART0);
+	test_cs_set(TEST_LINE_HW, true);
+}
+
+static void test_cs_release(Usart *p_usart)
+{
+	TEST_CHECK(p_usart == USART0);
+	test_cs_set(TEST_LINE_HW, false);
+}
+
+/**
+ * \brief XDMAC model, run at each access of the driver: take the writes to
+ * the enable, disable and interrupt mask registers since the last one.
+ * A disabled channel stops at once, so GS always reads 0.
+ */
+static Xdmac *test_xdmac(void)
+{
+	Xdmac *p_xdmac = &host_xdmac;
+	uint32_t ul_ch;
+
+	host_lock();
+	gs_ul_running |= p_xdmac->XDMAC_GE;
+	gs_ul_running &= ~p_xdmac->XDMAC_GD;
+	p_xdmac->XDMAC_GE = 0;
+	p_xdmac->XDMAC_GD = 0;
+	HOST_REG(p_xdmac->XDMAC_GIM) |= p_xdmac->XDMAC_GIE;
+	HOST_REG(p_xdmac->XDMAC_GIM) &= ~p_xdmac->XDMAC_GID;
+	p_xdmac->XDMAC_GIE = 0;
+	p_xdmac->XDMAC_GID = 0;
+	for (ul_ch = 0; ul_ch < XDMACCHID_NUMBER; ul_ch++) {
+		XdmacChid *p_chid = &p_xdmac->XDMAC_CHID[ul_ch];
+
+		HOST_REG(p_chid->XDMAC_CIM) |= p_chid->XDMAC_CIE;
+		HOST_REG(p_chid->XDMAC_CIM) &= ~p_chid->XDMAC_CID;
+		p_chid->XDMAC_CIE = 0;
+		p_chid->XDMAC_CID = 0;
+	}
+	host_unlock();
+
+	return p_xdmac;
+}
+
+/**
+ * \brief Raise a channel interrupt, if both its source and the channel
+ * are unmasked.
+ */
+static void test_xdmac_irq(uint32_t ul_ch, uint32_t ul_cis)
+{
+	Xdmac *p_xdmac = &host_xdmac;
+	XdmacChid *p_chid = &p_xdmac->XDMAC_CHID[ul_ch];
+
+	if (!(p_chid->XDMAC_CIM & ul_cis) ||
+			!(p_xdmac->XDMAC_GIM & (XDMAC_GIM_IM0 << ul_ch))) {
+		return;
+	}
+	HOST_REG(p_xdmac->XDMAC_GIS) = XDMAC_GIS_IS0 << ul_ch;
+	HOST_REG(p_chid->XDMAC_CIS) = ul_cis;
+	host_irq(XDMAC_IRQn, XDMAC_Handler);
+	HOST_REG(p_chid->XDMAC_CIS) = 0;
+	HOST_REG(p_xdmac->XDMAC_GIS) = 0;
+}
+
+static bool test_in(const void *p_buf, size_t ul_size, uint32_t ul_addr)
+{
+	return ul_addr >= (uint32_t)p_buf && ul_addr < (uint32_t)p_buf + ul_size;
+}
+
+/** Character the slave answers at a position on the wire. */
+static uint8_t test_miso(uint32_t ul_pos)
+{
+	return (uint8_t)(ul_pos * 13 + (ul_pos >> 8) + 7);
+}
+
+/**
+ * \brief Clock one character, if both channels of the engine run: the
+ * transmit channel writes it to THR, and the receive channel stores the
+ * answer of the slave read from RHR. The channel that ends its block
+ * stops and raises BIS.
+ *
+ * \return Whether a character went out, or an error was raised.
+ */
+static bool test_char(void)
+{
+	Xdmac *p_xdmac;
+	XdmacChid *p_tx, *p_rx;
+	uint32_t ul_line;
+	uint8_t uc_mosi;
+
+	host_lock();
+	p_xdmac = test_xdmac();
+	p_tx = &p_xdmac->XDMAC_CHID[gs_spi.ul_tx_ch];
+	p_rx = &p_xdmac->XDMAC_CHID[gs_spi.ul_rx_ch];
+	if (!(gs_ul_running & (1u << gs_spi.ul_tx_ch)) ||
+			!(gs_ul_running & (1u << gs_spi.ul_rx_ch))) {
+		host_unlock();
+		return false;
+	}
+	if (gs_ul_wire == gs_ul_error_at) {
+		gs_ul_error_at = UINT32_MAX;
+		test_xdmac_irq(gs_b_error_on_tx ? gs_spi.ul_tx_ch : gs_spi.ul_rx_ch,
+				gs_ul_error_cis);
+		host_unlock();
+		return true;
+	}
+
+	/* Both channels as the USART needs them. */
+	TEST_CHECK_EQ(p_tx->XDMAC_CC & (XDMAC_CC_TYPE | XDMAC_CC_DSYNC |
+			XDMAC_CC_DWIDTH_Msk | XDMAC_CC_PERID_Msk),
+			XDMAC_CC_TYPE_PER_TRAN | XDMAC_CC_DSYNC_MEM2PER |
+			XDMAC_CC_DWIDTH_BYTE | XDMAC_CC_PERID(XDMAC_PERID_USART0_TX));
+	TEST_CHECK_EQ(p_tx->XDMAC_CDA, (uint32_t)&USART0->US_THR);
+	TEST_CHECK_EQ(p_rx->XDMAC_CC & (XDMAC_CC_TYPE | XDMAC_CC_DSYNC |
+			XDMAC_CC_DWIDTH_Msk | XDMAC_CC_PERID_Msk),
+			XDMAC_CC_TYPE_PER_TRAN | XDMAC_CC_DSYNC_PER2MEM |
+			XDMAC_CC_DWIDTH_BYTE | XDMAC_CC_PERID(XDMAC_PERID_USART0_RX));
+	TEST_CHECK_EQ(p_rx->XDMAC_CSA, (uint32_t)&USART0->US_RHR);
+	TEST_CHECK_EQ(p_tx->XDMAC_CUBC, p_rx->XDMAC_CUBC);
+
+	/* Within the buffers, or on the dummy and the sink. */
+	if (!TEST_CHECK(test_in(gs_tx, sizeof(gs_tx), p_tx->XDMAC_CSA) ||
+			p_tx->XDMAC_CSA == (uint32_t)&gs_uc_tx_dummy) ||
+			!TEST_CHECK(test_in(gs_rx, sizeof(gs_rx), p_rx->XDMAC_CDA) ||
+			p_rx->XDMAC_CDA == (uint32_t)gs_uc_rx_sink)) {
+		gs_ul_running = 0;
+		host_unlock();
+		return false;
+	}
+
+	uc_mosi = *(const uint8_t *)(uintptr_t)p_tx->XDMAC_CSA;
+	if ((p_tx->XDMAC_CC & XDMAC_CC_SAM_Msk) == XDMAC_CC_SAM_INCREMENTED_AM) {
+		p_tx->XDMAC_CSA++;
+	}
+	*(uint8_t *)(uintptr_t)p_rx->XDMAC_CDA = test_miso(gs_ul_wire);
+	if ((p_rx->XDMAC_CC & XDMAC_CC_DAM_Msk) == XDMAC_CC_DAM_INCREMENTED_AM) {
+		p_rx->XDMAC_CDA++;
+	}
+	for (ul_line = 0; ul_line < TEST_LINES && !gs_b_cs[ul_line];
+			ul_line++) {
+	}
+	if (gs_ul_wire < TEST_WIRE_SIZE) {
+		gs_mosi[gs_ul_wire] = uc_mosi;
+		gs_line[gs_ul_wire] = (uint8_t)ul_line;
+	}
+	gs_ul_wire++;
+
+	if (--p_tx->XDMAC_CUBC == 0) {
+		gs_ul_running &= ~(1u << gs_spi.ul_tx_ch);
+		test_xdmac_irq(gs_spi.ul_tx_ch, XDMAC_CIS_BIS);
+	}
+	if (--p_rx->XDMAC_CUBC == 0) {
+		gs_ul_running &= ~(1u << gs_spi.ul_rx_ch);
+		test_xdmac_irq(gs_spi.ul_rx_ch, XDMAC_CIS_BIS);
+	}
+	host_unlock();
+
+	return true;
+}
+
+/**
+ * \brief Clock the bus until the engine stops.
+ *
+ * \return Number of characters sent.
+ */
+static uint32_t test_clock(uint32_t ul_max)
+{
+	uint32_t ul_start = gs_ul_wire;
+
+	while (gs_ul_wire - ul_start < ul_max && test_char()) {
+	}
+
+	return gs_ul_wire - ul_start;
+}
+
+static void test_done(struct usart_spi_xfer *p_xfer)
+{
+	TEST_CHECK(p_xfer->l_status != OPERATION_IN_PROGRESS);
+	TEST_CHECK(p_xfer->p_next == NULL);
+	if (gs_ul_done < sizeof(gs_p_done) / sizeof(gs_p_done[0])) {
+		gs_p_done[gs_ul_done] = p_xfer;
+	}
+	gs_ul_done++;
+	/* Chained transfer, submitted from the callback. */
+	if (p_xfer->p_ctx && p_xfer->l_status == STATUS_OK) {
+		TEST_CHECK_EQ(usart_spi_dma_submit(&gs_spi,
+				(struct usart_spi_xfer *)p_xfer->p_ctx), STATUS_OK);
+	}
+}
+
+/**
+ * \brief Set up transfer \a i, with its buffers filled.
+ */
+static struct usart_spi_xfer *test_xfer(uint32_t i, uint32_t ul_len,
+		uint32_t ul_cs, uint32_t ul_flags, bool b_tx, bool b_rx)
+{
+	struct usart_spi_xfer *p_xfer = &gs_xfers[i];
+	uint32_t j;
+
+	for (j = 0; j < TEST_BUF_SIZE; j++) {
+		gs_tx[i][j] = (uint8_t)(j * 3 + i * 50 + 1);
+	}
+	memset(gs_rx[i], TEST_GUARD, TEST_BUF_SIZE);
+	memset(p_xfer, 0, sizeof(*p_xfer));
+	p_xfer->p_tx = b_tx ? gs_tx[i] : NULL;
+	p_xfer->p_rx = b_rx ? gs_rx[i] : NULL;
+	p_xfer->ul_len = ul_len;
+	p_xfer->ul_cs = ul_cs;
+	p_xfer->ul_flags = ul_flags;
+	p_xfer->callback = test_done;
+
+	return p_xfer;
+}
+
+/**
+ * \brief Check the characters of transfer \a i, sent from position
+ * \a ul_pos on the wire on \a line.
+ */
+static void test_wire(uint32_t i, uint32_t ul_pos, uint32_t ul_len,
+		enum test_line line)
+{
+	const struct usart_spi_xfer *p_xfer = &gs_xfers[i];
+	uint32_t ul_bad_mosi = 0, ul_bad_miso = 0, ul_bad_line = 0;
+	uint32_t j;
+
+	for (j = 0; j < ul_len; j++) {
+		uint8_t uc_mosi = p_xfer->p_tx ? gs_tx[i][j] : USART_SPI_DMA_DUMMY;
+
+		ul_bad_mosi += gs_mosi[ul_pos + j] != uc_mosi;
+		ul_bad_line += gs_line[ul_pos + j] != line;
+		if (p_xfer->p_rx) {
+			ul_bad_miso += gs_rx[i][j] != test_miso(ul_pos + j);
+		}
+	}
+	TEST_CHECK_EQ(ul_bad_mosi, 0);
+	TEST_CHECK_EQ(ul_bad_miso, 0);
+	TEST_CHECK_EQ(ul_bad_line, 0);
+	/* Nothing received past the characters exchanged, nor without a
+	 * buffer. */
+	for (j = p_xfer->p_rx ? ul_len : 0; j < TEST_BUF_SIZE; j++) {
+		if (!TEST_CHECK_EQ(gs_rx[i][j], TEST_GUARD)) {
+			break;
+		}
+	}
+}
+
+static void test_reset(void)
+{
+	memset(gs_ul_asserts, 0, sizeof(gs_ul_asserts));
+	gs_ul_overlaps = 0;
+	gs_ul_done = 0;
+	gs_spi.ul_completed = 0;
+	gs_spi.ul_errors = 0;
+}
+
+static void test_init(void)
+{
+	Xdmac *p_xdmac;
+
+	TEST_CHECK_EQ(usart_spi_dma_init(&gs_spi, USART0, TEST_BAUD,
+			XDMAC_PERID_USART0_TX, XDMAC_PERID_USART0_RX), STATUS_OK);
+	TEST_CHECK(gs_spi.ul_tx_ch != gs_spi.ul_rx_ch);
+	TEST_CHECK(usart_spi_dma_is_idle(&gs_spi));
+
+	/* Errors on both channels, the end of the block on receive only. */
+	p_xdmac = test_xdmac();
+	TEST_CHECK_EQ(p_xdmac->XDMAC_CHID[gs_spi.ul_tx_ch].XDMAC_CIM,
+			USART_SPI_DMA_ERRORS);
+	TEST_CHECK_EQ(p_xdmac->XDMAC_CHID[gs_spi.ul_rx_ch].XDMAC_CIM,
+			XDMAC_CIM_BIM | USART_SPI_DMA_ERRORS);
+	TEST_CHECK_EQ(gs_ul_running, 0);
+
+	/* Lengths the block counter cannot hold. */
+	test_xfer(0, 0, TEST_CS_A, 0, true, true);
+	TEST_CHECK_EQ(usart_spi_dma_submit(&gs_spi, &gs_xfers[0]),
+			ERR_INVALID_ARG);
+	test_xfer(0, XDMAC_UBLEN_MAX + 1, TEST_CS_A, 0, true, true);
+	TEST_CHECK_EQ(usart_spi_dma_submit(&gs_spi, &gs_xfers[0]),
+			ERR_INVALID_ARG);
+	TEST_CHECK(usart_spi_dma_is_idle(&gs_spi));
+	TEST_CHECK_EQ(gs_ul_asserts[TEST_LINE_A], 0);
+}
+
+/**
+ * \brief One transfer: chip select around it, both directions in step.
+ */
+static void test_single(void)
+{
+	uint32_t ul_pos = gs_ul_wire;
+
+	test_reset();
+	test_xfer(0, 100, TEST_CS_A, 0, true, true);
+	TEST_CHECK_EQ(usart_spi_dma_submit(&gs_spi, &gs_xfers[0]), STATUS_OK);
+	TEST_CHECK_EQ(gs_xfers[0].l_status, OPERATION_IN_PROGRESS);
+	TEST_CHECK(!usart_spi_dma_is_idle(&gs_spi));
+	TEST_CHECK(gs_b_cs[TEST_LINE_A]);
+
+	TEST_CHECK_EQ(test_clock(1000), 100);
+	test_wire(0, ul_pos, 100, TEST_LINE_A);
+	TEST_CHECK_EQ(gs_xfers[0].l_status, STATUS_OK);
+	TEST_CHECK_EQ(gs_ul_done, 1);
+	TEST_CHECK(!gs_b_cs[TEST_LINE_A]);
+	TEST_CHECK_EQ(gs_ul_asserts[TEST_LINE_A], 1);
+	TEST_CHECK(usart_spi_dma_is_idle(&gs_spi));
+	TEST_CHECK_EQ(gs_spi.ul_completed, 1);
+	TEST_CHECK_EQ(gs_ul_running, 0);
+}
+
+/**
+ * \brief Queued transfers run back to back, each with its chip select,
+ * which USART_SPI_DMA_CS_HOLD keeps for the next one on the same line.
+ */
+static void test_queue(void)
+{
+	uint32_t ul_pos = gs_ul_wire;
+	uint32_t i;
+
+	test_reset();
+	test_xfer(0, 40, TEST_CS_A, 0, true, true);
+	test_xfer(1, 30, TEST_CS_A, USART_SPI_DMA_CS_HOLD, true, true);
+	test_xfer(2, 20, TEST_CS_A, 0, true, true);
+	test_xfer(3, 10, TEST_CS_B, 0, true, true);
+	/* The last one is chained from the callback of the fourth. */
+	test_xfer(4, 5, USART_SPI_DMA_CS_HW, 0, true, true);
+	gs_xfers[3].p_ctx = &gs_xfers[4];
+	for (i = 0; i < 4; i++) {
+		TEST_CHECK_EQ(usart_spi_dma_submit(&gs_spi, &gs_xfers[i]),
+				STATUS_OK);
+	}
+	TEST_CHECK_EQ(gs_ul_done, 0);
+
+	TEST_CHECK_EQ(test_clock(1000), 105);
+	test_wire(0, ul_pos, 40, TEST_LINE_A);
+	test_wire(1, ul_pos + 40, 30, TEST_LINE_A);
+	test_wire(2, ul_pos + 70, 20, TEST_LINE_A);
+	test_wire(3, ul_pos + 90, 10, TEST_LINE_B);
+	test_wire(4, ul_pos + 100, 5, TEST_LINE_HW);
+	if (TEST_CHECK_EQ(gs_ul_done, 5)) {
+		for (i = 0; i < 5; i++) {
+			TEST_CHECK(gs_p_done[i] == &gs_xfers[i]);
+			TEST_CHECK_EQ(gs_xfers[i].l_status, STATUS_OK);
+		}
+	}
+	/* Released after the first, held from the second to the third. */
+	TEST_CHECK_EQ(gs_ul_asserts[TEST_LINE_A], 2);
+	TEST_CHECK_EQ(gs_ul_asserts[TEST_LINE_B], 1);
+	TEST_CHECK_EQ(gs_ul_asserts[TEST_LINE_HW], 1);
+	TEST_CHECK_EQ(gs_ul_overlaps, 0);
+	for (i = 0; i < TEST_LINES; i++) {
+		TEST_CHECK(!gs_b_cs[i]);
+	}
+	TEST_CHECK_EQ(gs_spi.ul_completed, 5);
+
+	/* Held past the end of the queue, until a transfer on another line. */
+	test_reset();
+	test_xfer(0, 8, TEST_CS_A, USART_SPI_DMA_CS_HOLD, true, true);
+	usart_spi_dma_submit(&gs_spi, &gs_xfers[0]);
+	TEST_CHECK_EQ(test_clock(1000), 8);
+	TEST_CHECK(usart_spi_dma_is_idle(&gs_spi));
+	TEST_CHECK(gs_b_cs[TEST_LINE_A]);
+	test_xfer(1, 8, TEST_CS_A, 0, true, true);
+	usart_spi_dma_submit(&gs_spi, &gs_xfers[1]);
+	test_xfer(2, 8, TEST_CS_B, 0, true, true);
+	usart_spi_dma_submit(&gs_spi, &gs_xfers[2]);
+	TEST_CHECK_EQ(test_clock(1000), 16);
+	TEST_CHECK_EQ(gs_ul_asserts[TEST_LINE_A], 1);
+	TEST_CHECK_EQ(gs_ul_asserts[TEST_LINE_B], 1);
+	TEST_CHECK_EQ(gs_ul_overlaps, 0);
+	TEST_CHECK(!gs_b_cs[TEST_LINE_A] && !gs_b_cs[TEST_LINE_B]);
+}
+
+/**
+ * \brief Without a transmit buffer the dummy character goes out, without
+ * a receive buffer the answer goes to the sink, and no chip select with
+ * USART_SPI_DMA_CS_NONE.
+ */
+static void test_dummy_sink(void)
+{
+	Xdmac *p_xdmac = &host_xdmac;
+	uint32_t ul_pos = gs_ul_wire;
+
+	test_reset();
+	test_xfer(0, 50, TEST_CS_A, 0, false, true);
+	test_xfer(1, 60, TEST_CS_B, 0, true, false);
+	test_xfer(2, 70, USART_SPI_DMA_CS_NONE, 0, false, false);
+	usart_spi_dma_submit(&gs_spi, &gs_xfers[0]);
+	usart_spi_dma_submit(&gs_spi, &gs_xfers[1]);
+	usart_spi_dma_submit(&gs_spi, &gs_xfers[2]);
+	TEST_CHECK_EQ(test_clock(1000), 180);
+	test_wire(0, ul_pos, 50, TEST_LINE_A);
+	test_wire(1, ul_pos + 50, 60, TEST_LINE_B);
+	test_wire(2, ul_pos + 110, 70, TEST_LINE_NONE);
+	TEST_CHECK_EQ(gs_ul_done, 3);
+
+	/* Both from a single fixed byte. */
+	TEST_CHECK_EQ(p_xdmac->XDMAC_CHID[gs_spi.ul_tx_ch].XDMAC_CSA,
+			(uint32_t)&gs_uc_tx_dummy);
+	TEST_CHECK_EQ(p_xdmac->XDMAC_CHID[gs_spi.ul_rx_ch].XDMAC_CDA,
+			(uint32_t)gs_uc_rx_sink);
+	TEST_CHECK_EQ(gs_uc_rx_sink[0], test_miso(ul_pos + 179));
+	TEST_CHECK_EQ(gs_uc_tx_dummy, USART_SPI_DMA_DUMMY);
+}
+
+/**
+ * \brief Abort stops the running transfer, fails the queue from the
+ * caller and releases the chip select, held or not. The engine then runs
+ * again.
+ */
+static void test_abort(void)
+{
+	uint32_t ul_pos;
+	uint32_t i;
+
+	test_reset();
+	test_xfer(0, 200, TEST_CS_A, 0, true, true);
+	test_xfer(1, 20, TEST_CS_B, 0, true, true);
+	test_xfer(2, 20, TEST_CS_A, 0, true, true);
+	for (i = 0; i < 3; i++) {
+		usart_spi_dma_submit(&gs_spi, &gs_xfers[i]);
+	}
+	TEST_CHECK_EQ(test_clock(50), 50);
+	usart_spi_dma_abort(&gs_spi);
+	if (TEST_CHECK_EQ(gs_ul_done, 3)) {
+		for (i = 0; i < 3; i++) {
+			TEST_CHECK(gs_p_done[i] == &gs_xfers[i]);
+			TEST_CHECK_EQ(gs_xfers[i].l_status, ERR_ABORTED);
+		}
+	}
+	TEST_CHECK(usart_spi_dma_is_idle(&gs_spi));
+	TEST_CHECK(!gs_b_cs[TEST_LINE_A] && !gs_b_cs[TEST_LINE_B]);
+	TEST_CHECK_EQ(gs_ul_asserts[TEST_LINE_B], 0);
+	TEST_CHECK_EQ(gs_spi.ul_errors, 3);
+	TEST_CHECK_EQ(test_clock(1000), 0);
+	(void)test_xdmac();
+	TEST_CHECK_EQ(gs_ul_running, 0);
+
+	/* A held chip select. */
+	test_reset();
+	test_xfer(0, 10, TEST_CS_B, USART_SPI_DMA_CS_HOLD, true, true);
+	usart_spi_dma_submit(&gs_spi, &gs_xfers[0]);
+	TEST_CHECK_EQ(test_clock(1000), 10);
+	TEST_CHECK(gs_b_cs[TEST_LINE_B]);
+	usart_spi_dma_abort(&gs_spi);
+	TEST_CHECK(!gs_b_cs[TEST_LINE_B]);
+	TEST_CHECK_EQ(gs_ul_done, 1);
+	TEST_CHECK_EQ(gs_spi.ul_errors, 0);
+
+	/* And again. */
+	test_reset();
+	ul_pos = gs_ul_wire;
+	test_xfer(0, 30, TEST_CS_A, 0, true, true);
+	usart_spi_dma_submit(&gs_spi, &gs_xfers[0]);
+	TEST_CHECK_EQ(test_clock(1000), 30);
+	test_wire(0, ul_pos, 30, TEST_LINE_A);
+	TEST_CHECK_EQ(gs_xfers[0].l_status, STATUS_OK);
+	TEST_CHECK_EQ(gs_ul_asserts[TEST_LINE_A], 1);
+}
+
+/**
+ * \brief A bus error on a channel fails the transfer, releases its chip
+ * select even if asked to hold it, and the queue goes on.
+ */
+static void test_error(bool b_on_tx, uint32_t ul_cis)
+{
+	uint32_t ul_pos = gs_ul_wire;
+
+	test_reset();
+	test_xfer(0, 100, TEST_CS_A, USART_SPI_DMA_CS_HOLD, true, true);
+	test_xfer(1, 20, TEST_CS_A, 0, true, true);
+	test_xfer(2, 20, TEST_CS_B, 0, true, true);
+	usart_spi_dma_submit(&gs_spi, &gs_xfers[0]);
+	usart_spi_dma_submit(&gs_spi, &gs_xfers[1]);
+	usart_spi_dma_submit(&gs_spi, &gs_xfers[2]);
+	gs_b_error_on_tx = b_on_tx;
+	gs_ul_error_cis = ul_cis;
+	gs_ul_error_at = ul_pos + 30;
+
+	TEST_CHECK_EQ(test_clock(1000), 70);
+	TEST_CHECK_EQ(gs_xfers[0].l_status, ERR_IO_ERROR);
+	TEST_CHECK_EQ(gs_xfers[1].l_status, STATUS_OK);
+	TEST_CHECK_EQ(gs_xfers[2].l_status, STATUS_OK);
+	test_wire(1, ul_pos + 30, 20, TEST_LINE_A);
+	test_wire(2, ul_pos + 50, 20, TEST_LINE_B);
+	/* Released after the error, asserted again for the next one. */
+	TEST_CHECK_EQ(gs_ul_asserts[TEST_LINE_A], 2);
+	TEST_CHECK_EQ(gs_ul_overlaps, 0);
+	TEST_CHECK(!gs_b_cs[TEST_LINE_A] && !gs_b_cs[TEST_LINE_B]);
+	TEST_CHECK_EQ(gs_spi.ul_errors, 1);
+	TEST_CHECK_EQ(gs_spi.ul_completed, 2);
+	TEST_CHECK(usart_spi_dma_is_idle(&gs_spi));
+}
+
+/**
+ * \brief The divisor for a new MCK, rounded and kept in range.
+ */
+static void test_set_clock(void)
+{
+	usart_spi_dma_set_clock(&gs_spi, 150000000);
+	TEST_CHECK_EQ(USART0->US_BRGR, US_BRGR_CD(15));
+	usart_spi_dma_set_clock(&gs_spi, 144000000);
+	TEST_CHECK_EQ(USART0->US_BRGR, US_BRGR_CD(14));
+	usart_spi_dma_set_clock(&gs_spi, 146000000);
+	TEST_CHECK_EQ(USART0->US_BRGR, US_BRGR_CD(15));
+	usart_spi_dma_set_clock(&gs_spi, 12000000);
+	TEST_CHECK_EQ(USART0->US_BRGR, US_BRGR_CD(USART_SPI_DMA_MIN_CD));
+	gs_spi.ul_baudrate = 1000;
+	usart_spi_dma_set_clock(&gs_spi, 150000000);
+	TEST_CHECK_EQ(USART0->US_BRGR, US_BRGR_CD(USART_SPI_DMA_MAX_CD));
+	gs_spi.ul_baudrate = TEST_BAUD;
+}
+
+int main(void)
+{
+	test_init();
+	test_single();
+	test_queue();
+	test_dummy_sink();
+	test_abort();
+	test_error(false, XDMAC_CIS_RBEIS);
+	test_error(true, XDMAC_CIS_WBEIS);
+	test_set_clock();
+	usart_spi_dma_deinit(&gs_spi);
+	return test_end("usart_spi_dma");
+}
@@ -0,0 +1,2092 @@
+/**
+ * \file
+ *
+ * \brief Host test of the USBHS device driver and the CDC serial port,
+ * against a model of the USBHS endpoints and of a USB host, with a
+ * benchmark of the endpoint banks.
+ *
+ * The model keeps the endpoint banks, their FIFO pointers and the DMA
+ * channels, and takes every register and FIFO access of the driver as it
+ * comes: the register block and the FIFO windows are mapped at their
+ * target addresses without access rights, each access traps, the model
+ * presents the register values, the access runs alone (single step) and
+ * the model takes what it wrote. A FIFO read or write moves one byte of
+ * the bank, as on the target.
+ *
+ * The host side runs transactions one bus tick each: a token takes or
+ * fills one bank, which the bus holds until the end of the tick, while the
+ * DMA moves its share of the other banks; the raised interrupts run at the
+ * end of the tick. The model flags what the USBHS would trip on: FIFO
+ * accesses past a bank, a bank sent or released twice, endpoint memory
+ * allocated or freed under a higher endpoint, a DMA channel changed while
+ * it runs, data toggles out of step with the host.
+ *
+ * The traps need x86-64 Linux.
+ *
+ */
+
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <asf.h>
+#include "test.h"
+
+/* The USBHS at its target address, where the model maps it. */
+#define TEST_USBHS_ADDR     0x40038000u
+#undef USBHS
+#define USBHS               ((Usbhs *)TEST_USBHS_ADDR)
+
+/* usb_cdc.c is built into the test, for its state to be checked. */
+#include "usb_cdc.c"
+
+/** Register block and FIFO windows mapped by the model. */
+#define TEST_REGS_SIZE      4096u
+#define TEST_FIFO_WINDOW    0x8000u
+#define TEST_FIFO_SIZE      (USBHS_DEV_EP_COUNT * TEST_FIFO_WINDOW)
+
+/** Endpoint memory (DPRAM). */
+#define TEST_DPRAM_SIZE     4096u
+
+/** x86 trap flag: run one instruction, then SIGTRAP. */
+#define TEST_EFLAGS_TF      0x100
+
+/** Interrupts in a row the model lets run before calling them stuck. */
+#define TEST_IRQ_MAX        32
+
+/** Ticks a host transaction is retried while the device NAKs it. */
+#define TEST_NAK_MAX        16
+
+/** Endpoint interrupt flags, and the status bits set with them. */
+#define TEST_EP_IRQ_Msk     0xFFu
+
+/** Outcome of a transaction. */
+typedef enum test_bus {
+	TEST_ACK,
+	TEST_NAK,
+	TEST_STALL,
+	/** No answer: wrong address, or endpoint off. */
+	TEST_NONE,
+} test_bus_t;
+
+/** Control transfer outcomes besides a byte count. */
+#define TEST_STALLED        (-1)
+#define TEST_FAILED         (-2)
+
+/** Endpoint state, besides its registers. */
+typedef struct test_ep {
+	uint8_t uc_bank[3][1024];
+	uint16_t us_len[3];
+	uint8_t uc_banks;
+	uint16_t us_size;
+	bool b_in;
+	/** Memory allocated, and the allocation fits. */
+	bool b_alloc;
+	bool b_cfgok;
+	/** Oldest busy bank, and busy banks: IN banks waiting for the host,
+	 * OUT banks received. */
+	uint8_t uc_first;
+	uint8_t uc_busy;
+	/** Bytes moved by the CPU or the DMA in the current bank: the first
+	 * free one (IN), the oldest busy one (OUT). */
+	uint16_t us_pos;
+	/** The bus holds a bank until the end of the tick: the oldest busy
+	 * one (IN), or the first free one it receives \a us_bus_len bytes in
+	 * (OUT). */
+	bool b_bus;
+	uint16_t us_bus_len;
+	/** Control endpoint: the IN bank was sent by the CPU. */
+	bool b_tx_ready;
+	uint32_t ul_isr;
+	uint32_t ul_imr;
+	uint8_t uc_toggle;
+} test_ep_t;
+
+/** DMA channel state. */
+typedef struct test_dma {
+	uint32_t ul_addr;
+	uint32_t ul_ctrl;
+	uint32_t ul_count;
+	uint32_t ul_status;
+	bool b_on;
+	bool b_irq;
+} test_dma_t;
+
+/** USBHS state, besides the driver's register view. */
+static struct {
+	uint32_t ul_ctrl;
+	uint32_t ul_devctrl;
+	/** Latched global interrupt flags, and their mask. */
+	uint32_t ul_devisr;
+	uint32_t ul_devimr;
+	uint32_t ul_devept;
+	uint32_t ul_cfg[USBHS_DEV_EP_COUNT];
+	test_ep_t ep[USBHS_DEV_EP_COUNT];
+	test_dma_t dma[USBHS_DEV_EP_DMA_MAX];
+	/** The UTMI clock never starts. */
+	bool b_no_clock;
+	bool b_high_speed;
+	/** Bytes each DMA channel moves in a tick. */
+	uint32_t ul_dma_rate;
+	uint32_t ul_faults;
+	uint32_t ul_irqs;
+	uint32_t ul_ticks;
+	uint32_t ul_packets;
+	uint32_t ul_naks;
+} gs_model;
+
+/** USB host state. */
+static struct {
+	uint8_t uc_addr;
+	/** The host can go high speed. */
+	bool b_high_speed;
+	uint8_t uc_toggle[USBHS_DEV_EP_COUNT];
+} gs_host;
+
+/** Registers as the driver reads them, see test_trap_segv(). */
+static Usbhs gs_view;
+
+/** Access being single stepped. */
+static struct {
+	volatile uint8_t *p_addr;
+	bool b_write;
+} gs_trap;
+
+/**
+ * \brief Flag what the USBHS would trip on.
+ */
+static void test_fault(const char *p_what, uint32_t ul_arg)
+{
+	printf("usbhs model: %s (%lu)\n", p_what, (unsigned long)ul_arg);
+	gs_model.ul_faults++;
+}
+
+/**
+ * \brief Empty the banks of an endpoint.
+ */
+static void test_ep_flush(test_ep_t *p_ep)
+{
+	p_ep->uc_first = 0;
+	p_ep->uc_busy = 0;
+	p_ep->us_pos = 0;
+	p_ep->b_bus = false;
+	p_ep->b_tx_ready = false;
+	p_ep->ul_isr = p_ep->b_in ? USBHS_DEVEPTISR_TXINI : 0;
+}
+
+/**
+ * \brief Validate the current IN bank: it waits for the host.
+ */
+static void test_ep_validate(test_ep_t *p_ep)
+{
+	uint8_t uc_bank = (p_ep->uc_first + p_ep->uc_busy) % p_ep->uc_banks;
+
+	p_ep->us_len[uc_bank] = p_ep->us_pos;
+	p_ep->us_pos = 0;
+	p_ep->uc_busy++;
+}
+
+/**
+ * \brief Free the oldest busy bank.
+ */
+static void test_ep_release(test_ep_t *p_ep)
+{
+	p_ep->uc_first = (p_ep->uc_first + 1) % p_ep->uc_banks;
+	p_ep->uc_busy--;
+	p_ep->us_pos = 0;
+}
+
+/**
+ * \brief Endpoint status register.
+ */
+static uint32_t test_ep_isr(uint8_t uc_ep)
+{
+	test_ep_t *p_ep = &gs_model.ep[uc_ep];
+	uint32_t ul_isr = p_ep->ul_isr;
+	uint32_t ul_count;
+
+	if (uc_ep == 0) {
+		ul_count = (ul_isr & (USBHS_DEVEPTISR_RXSTPI |
+				USBHS_DEVEPTISR_RXOUTI)) ?
+				p_ep->us_len[0] - p_ep->us_pos : p_ep->us_pos;
+	} else if (p_ep->b_in) {
+		ul_count = p_ep->us_pos;
+	} else {
+		ul_count = p_ep->uc_busy ?
+				p_ep->us_len[p_ep->uc_first] - p_ep->us_pos : 0;
+	}
+	/* TXINI follows the free banks of an IN endpoint. */
+	if (uc_ep && p_ep->b_in) {
+		ul_isr &= ~USBHS_DEVEPTISR_TXINI;
+		if (p_ep->uc_busy < p_ep->uc_banks) {
+			ul_isr |= USBHS_DEVEPTISR_TXINI;
+		}
+	}
+	ul_isr |= (uint32_t)p_ep->uc_toggle << USBHS_DEVEPTISR_DTSEQ_Pos;
+	ul_isr |= (uint32_t)p_ep->uc_busy << USBHS_DEVEPTISR_NBUSYBK_Pos;
+	ul_isr |= ul_count << USBHS_DEVEPTISR_BYCT_Pos;
+	if (p_ep->b_cfgok) {
+		ul_isr |= USBHS_DEVEPTISR_CFGOK;
+	}
+	return ul_isr;
+}
+
+/**
+ * \brief Endpoint mask register: FIFOCON is set while the CPU has a bank.
+ */
+static uint32_t test_ep_imr(uint8_t uc_ep)
+{
+	test_ep_t *p_ep = &gs_model.ep[uc_ep];
+	uint32_t ul_imr = p_ep->ul_imr;
+
+	if (uc_ep && p_ep->b_alloc && (p_ep->b_in ?
+			p_ep->uc_busy < p_ep->uc_banks : p_ep->uc_busy > 0)) {
+		ul_imr |= USBHS_DEVEPTIMR_FIFOCON;
+	}
+	return ul_imr;
+}
+
+/**
+ * \brief Global interrupt status: the latched flags, the endpoints with an
+ * enabled flag and the DMA channels that ended.
+ */
+static uint32_t test_devisr(void)
+{
+	uint32_t ul_isr = gs_model.ul_devisr;
+	uint8_t uc_ep;
+
+	for (uc_ep = 0; uc_ep < USBHS_DEV_EP_COUNT; uc_ep++) {
+		if (test_ep_isr(uc_ep) & gs_model.ep[uc_ep].ul_imr &
+				TEST_EP_IRQ_Msk) {
+			ul_isr |= USBHS_DEVISR_PEP_0 << uc_ep;
+		}
+	}
+	for (uc_ep = 1; uc_ep <= USBHS_DEV_EP_DMA_MAX; uc_ep++) {
+		if (gs_model.dma[uc_ep - 1].b_irq) {
+			ul_isr |= USBHS_DEVISR_DMA_1 << (uc_ep - 1);
+		}
+	}
+	return ul_isr;
+}
+
+/**
+ * \brief DMA channel status register.
+ */
+static uint32_t test_dma_status(const test_dma_t *p_dma)
+{
+	uint32_t ul_status = p_dma->ul_status |
+			(p_dma->ul_count << USBHS_DEVDMASTATUS_BUFF_COUNT_Pos);
+
+	if (p_dma->b_on) {
+		ul_status |= USBHS_DEVDMASTATUS_CHANN_ENB |
+				USBHS_DEVDMASTATUS_CHANN_ACT;
+	}
+	return ul_status;
+}
+
+/**
+ * \brief Registers as the driver reads them, into gs_view.
+ */
+static void test_usbhs_view(void)
+{
+	uint8_t uc_ep;
+
+	memset(&gs_view, 0, sizeof(gs_view));
+	gs_view.USBHS_CTRL = gs_model.ul_ctrl;
+	if ((gs_model.ul_ctrl & USBHS_CTRL_USBE) &&
+			!(gs_model.ul_ctrl & USBHS_CTRL_FRZCLK) &&
+			!gs_model.b_no_clock) {
+		HOST_REG(gs_view.USBHS_SR) |= USBHS_SR_CLKUSABLE;
+	}
+	if (gs_model.b_high_speed) {
+		HOST_REG(gs_view.USBHS_SR) |= USBHS_SR_SPEED_HIGH_SPEED;
+	}
+	gs_view.USBHS_DEVCTRL = gs_model.ul_devctrl;
+	HOST_REG(gs_view.USBHS_DEVISR) = test_devisr();
+	HOST_REG(gs_view.USBHS_DEVIMR) = gs_model.ul_devimr;
+	gs_view.USBHS_DEVEPT = gs_model.ul_devept;
+	for (uc_ep = 0; uc_ep < USBHS_DEV_EP_COUNT; uc_ep++) {
+		gs_view.USBHS_DEVEPTCFG[uc_ep] = gs_model.ul_cfg[uc_ep];
+		HOST_REG(gs_view.USBHS_DEVEPTISR[uc_ep]) = test_ep_isr(uc_ep);
+		HOST_REG(gs_view.USBHS_DEVEPTIMR[uc_ep]) = test_ep_imr(uc_ep);
+	}
+	for (uc_ep = 0; uc_ep < USBHS_DEV_EP_DMA_MAX; uc_ep++) {
+		UsbhsDevdma *p_view = &gs_view.USBHS_DEVDMA[uc_ep];
+		test_dma_t *p_dma = &gs_model.dma[uc_ep];
+
+		p_view->USBHS_DEVDMAADDRESS = p_dma->ul_addr;
+		p_view->USBHS_DEVDMACONTROL = p_dma->ul_ctrl;
+		p_view->USBHS_DEVDMASTATUS = test_dma_status(p_dma);
+	}
+}
+
+/**
+ * \brief A DMA channel ends a buffer or a transfer.
+ */
+static void test_dma_end(test_dma_t *p_dma, uint32_t ul_status,
+		uint32_t ul_irq)
+{
+	p_dma->b_on = false;
+	p_dma->ul_status |= ul_status;
+	if (p_dma->ul_ctrl & ul_irq) {
+		p_dma->b_irq = true;
+	}
+}
+
+/**
+ * \brief Run a DMA channel: fill the free banks of its IN endpoint from
+ * memory, or empty the busy banks of its OUT endpoint into memory.
+ *
+ * \param uc_ep Endpoint, 1 to USBHS_DEV_EP_DMA_MAX.
+ * \param ul_budget Bytes the channel may move.
+ */
+static void test_dma_run(uint8_t uc_ep, uint32_t ul_budget)
+{
+	test_dma_t *p_dma = &gs_model.dma[uc_ep - 1];
+	test_ep_t *p_ep = &gs_model.ep[uc_ep];
+	uint8_t *p_mem;
+	uint8_t uc_bank;
+	uint32_t ul_n;
+	bool b_short;
+
+	while (p_dma->b_on && p_dma->ul_count && ul_budget) {
+		p_mem = (uint8_t *)(uintptr_t)p_dma->ul_addr;
+		if (p_ep->b_in) {
+			if (p_ep->uc_busy == p_ep->uc_banks) {
+				break;
+			}
+			uc_bank = (p_ep->uc_first + p_ep->uc_busy) % p_ep->uc_banks;
+			ul_n = Min(p_ep->us_size - p_ep->us_pos, p_dma->ul_count);
+			ul_n = Min(ul_n, ul_budget);
+			memcpy(&p_ep->uc_bank[uc_bank][p_ep->us_pos], p_mem, ul_n);
+			p_ep->us_pos += ul_n;
+			if (p_ep->us_pos == p_ep->us_size) {
+				test_ep_validate(p_ep);
+			}
+		} else {
+			if (!p_ep->uc_busy) {
+				break;
+			}
+			uc_bank = p_ep->uc_first;
+			ul_n = Min(p_ep->us_len[uc_bank] - p_ep->us_pos,
+					p_dma->ul_count);
+			ul_n = Min(ul_n, ul_budget);
+			memcpy(p_mem, &p_ep->uc_bank[uc_bank][p_ep->us_pos], ul_n);
+			p_ep->us_pos += ul_n;
+		}
+		p_dma->ul_addr += ul_n;
+		p_dma->ul_count -= ul_n;
+		ul_budget -= ul_n;
+		if (!p_ep->b_in && p_ep->us_pos == p_ep->us_len[p_ep->uc_first]) {
+			b_short = p_ep->us_len[p_ep->uc_first] < p_ep->us_size;
+			test_ep_release(p_ep);
+			if (b_short && (p_dma->ul_ctrl &
+					USBHS_DEVDMACONTROL_END_TR_EN)) {
+				test_dma_end(p_dma, USBHS_DEVDMASTATUS_END_TR_ST,
+						USBHS_DEVDMACONTROL_END_TR_IT);
+				return;
+			}
+		}
+	}
+	if (p_dma->b_on && !p_dma->ul_count) {
+		if (p_ep->b_in && p_ep->us_pos &&
+				(p_dma->ul_ctrl & USBHS_DEVDMACONTROL_END_B_EN)) {
+			test_ep_validate(p_ep);
+		}
+		test_dma_end(p_dma, USBHS_DEVDMASTATUS_END_BF_ST,
+				USBHS_DEVDMACONTROL_END_BUFFIT);
+	}
+}
+
+/**
+ * \brief Allocate or free the memory of an endpoint on a configuration
+ * write. The USBHS lays the endpoints out in number order, so a change
+ * under an allocated higher endpoint moves it.
+ */
+static void test_ep_configure(uint8_t uc_ep, uint32_t ul_cfg)
+{
+	test_ep_t *p_ep = &gs_model.ep[uc_ep];
+	uint32_t ul_old = gs_model.ul_cfg[uc_ep];
+	uint32_t ul_used = 0;
+	uint8_t i;
+
+	gs_model.ul_cfg[uc_ep] = ul_cfg;
+	if ((ul_old & ul_cfg & USBHS_DEVEPTCFG_ALLOC) && ul_old != ul_cfg) {
+		test_fault("endpoint changed while allocated", uc_ep);
+	}
+	if (!((ul_old ^ ul_cfg) & USBHS_DEVEPTCFG_ALLOC)) {
+		return;
+	}
+	for (i = uc_ep + 1; i < USBHS_DEV_EP_COUNT; i++) {
+		if (gs_model.ep[i].b_alloc) {
+			test_fault("endpoint memory changed under a higher one", uc_ep);
+		}
+	}
+	if (!(ul_cfg & USBHS_DEVEPTCFG_ALLOC)) {
+		p_ep->b_alloc = false;
+		p_ep->b_cfgok = false;
+		return;
+	}
+
+	p_ep->us_size = 8u << ((ul_cfg & USBHS_DEVEPTCFG_EPSIZE_Msk) >>
+			USBHS_DEVEPTCFG_EPSIZE_Pos);
+	p_ep->uc_banks = ((ul_cfg & USBHS_DEVEPTCFG_EPBK_Msk) >>
+			USBHS_DEVEPTCFG_EPBK_Pos) + 1;
+	p_ep->b_in = uc_ep == 0 || (ul_cfg & USBHS_DEVEPTCFG_EPDIR);
+	for (i = 0; i < USBHS_DEV_EP_COUNT; i++) {
+		if (i != uc_ep && gs_model.ep[i].b_alloc) {
+			ul_used += gs_model.ep[i].us_size * gs_model.ep[i].uc_banks;
+		}
+	}
+	p_ep->b_alloc = true;
+	p_ep->b_cfgok = p_ep->uc_banks <= 3 &&
+			ul_used + p_ep->us_size * p_ep->uc_banks <= TEST_DPRAM_SIZE &&
+			(uc_ep ? p_ep->us_size <= 1024 : p_ep->us_size <= 64 &&
+			p_ep->uc_banks == 1);
+	p_ep->uc_toggle = 0;
+	test_ep_flush(p_ep);
+}
+
+/**
+ * \brief Endpoint interrupt clear register.
+ */
+static void test_ep_clear(uint8_t uc_ep, uint32_t ul_value)
+{
+	test_ep_t *p_ep = &gs_model.ep[uc_ep];
+
+	if (uc_ep == 0 && (ul_value & USBHS_DEVEPTICR_TXINIC)) {
+		/* The CPU sends the IN bank. */
+		if (!(p_ep->ul_isr & USBHS_DEVEPTISR_TXINI)) {
+			test_fault("IN bank sent while not free", uc_ep);
+		} else {
+			p_ep->us_len[0] = p_ep->us_pos;
+			p_ep->us_pos = 0;
+			p_ep->b_tx_ready = true;
+		}
+	}
+	if (uc_ep == 0 && (ul_value & p_ep->ul_isr &
+			(USBHS_DEVEPTICR_RXOUTIC | USBHS_DEVEPTICR_RXSTPIC))) {
+		/* The CPU frees the received bank. */
+		p_ep->us_len[0] = 0;
+		p_ep->us_pos = 0;
+	}
+	p_ep->ul_isr &= ~(ul_value & TEST_EP_IRQ_Msk);
+}
+
+/**
+ * \brief Endpoint interrupt disable register, and FIFOCON: the CPU gives
+ * the current bank to the USBHS.
+ */
+static void test_ep_disable(uint8_t uc_ep, uint32_t ul_value)
+{
+	test_ep_t *p_ep = &gs_model.ep[uc_ep];
+
+	p_ep->ul_imr &= ~ul_value;
+	if (!(ul_value & USBHS_DEVEPTIDR_FIFOCONC) || uc_ep == 0) {
+		return;
+	}
+	if (p_ep->b_in) {
+		if (p_ep->uc_busy == p_ep->uc_banks) {
+			test_fault("IN bank validated while none is free", uc_ep);
+			return;
+		}
+		test_ep_validate(p_ep);
+	} else {
+		if (!p_ep->uc_busy) {
+			test_fault("OUT bank released while none is full", uc_ep);
+			return;
+		}
+		test_ep_release(p_ep);
+	}
+}
+
+/**
+ * \brief DMA channel register write.
+ */
+static void test_dma_write(uint8_t uc_ep, uint32_t ul_reg, uint32_t ul_value)
+{
+	test_dma_t *p_dma = &gs_model.dma[uc_ep - 1];
+	test_ep_t *p_ep = &gs_model.ep[uc_ep];
+
+	switch (ul_reg) {
+	case 1:
+		if (p_dma->b_on) {
+			test_fault("DMA address changed while it runs", uc_ep);
+		}
+		p_dma->ul_addr = ul_value;
+		break;
+	case 2:
+		if (!(ul_value & USBHS_DEVDMACONTROL_CHANN_ENB)) {
+			/* Stopped: the count left stays readable. */
+			p_dma->ul_ctrl = ul_value;
+			p_dma->b_on = false;
+			break;
+		}
+		if (p_dma->b_on) {
+			test_fault("DMA restarted while it runs", uc_ep);
+		}
+		if (!p_ep->b_cfgok ||
+				!(gs_model.ul_devept & (USBHS_DEVEPT_EPEN0 << uc_ep))) {
+			test_fault("DMA started on an endpoint off", uc_ep);
+		}
+		p_dma->ul_ctrl = ul_value;
+		p_dma->ul_count = (ul_value & USBHS_DEVDMACONTROL_BUFF_LENGTH_Msk) >>
+				USBHS_DEVDMACONTROL_BUFF_LENGTH_Pos;
+		p_dma->ul_status = 0;
+		p_dma->b_on = true;
+		if (!p_dma->ul_count) {
+			test_fault("DMA started without a length", uc_ep);
+		}
+		break;
+	default:
+		test_fault("DMA register written", ul_reg);
+		break;
+	}
+}
+
+/**
+ * \brief Index of a register in a register array of gs_view, or -1.
+ */
+static int test_index(const volatile uint32_t *p_reg,
+		const volatile uint32_t *p_array, int n)
+{
+	return (p_reg >= p_array && p_reg < p_array + n) ?
+			(int)(p_reg - p_array) : -1;
+}
+
+/**
+ * \brief Take a register write of the driver.
+ *
+ * \param p_reg Register, in gs_view.
+ * \param ul_value Value written.
+ */
+static void test_usbhs_write(const volatile uint32_t *p_reg,
+		uint32_t ul_value)
+{
+	const volatile uint32_t *p_dma = (const volatile uint32_t *)
+			gs_view.USBHS_DEVDMA;
+	uint32_t ul_old;
+	int i;
+	uint8_t uc_ep;
+
+	if (p_reg == &gs_view.USBHS_CTRL) {
+		gs_model.ul_ctrl = ul_value;
+	} else if (p_reg == &gs_view.USBHS_DEVCTRL) {
+		gs_model.ul_devctrl = ul_value;
+	} else if (p_reg == &gs_view.USBHS_DEVICR) {
+		gs_model.ul_devisr &= ~ul_value;
+	} else if (p_reg == &gs_view.USBHS_DEVIFR) {
+		gs_model.ul_devisr |= ul_value;
+	} else if (p_reg == &gs_view.USBHS_DEVIER) {
+		gs_model.ul_devimr |= ul_value;
+	} else if (p_reg == &gs_view.USBHS_DEVIDR) {
+		gs_model.ul_devimr &= ~ul_value;
+	} else if (p_reg == &gs_view.USBHS_DEVEPT) {
+		ul_old = gs_model.ul_devept;
+		gs_model.ul_devept = ul_value;
+		for (uc_ep = 0; uc_ep < USBHS_DEV_EP_COUNT; uc_ep++) {
+			if (ul_value & ~ul_old & (USBHS_DEVEPT_EPRST0 << uc_ep)) {
+				test_ep_flush(&gs_model.ep[uc_ep]);
+			}
+			if (uc_ep && uc_ep <= USBHS_DEV_EP_DMA_MAX &&
+					gs_model.dma[uc_ep - 1].b_on &&
+					!(ul_value & (USBHS_DEVEPT_EPEN0 << uc_ep))) {
+				test_fault("endpoint disabled under its DMA", uc_ep);
+			}
+		}
+	} else if ((i = test_index(p_reg, gs_view.USBHS_DEVEPTCFG,
+			USBHS_DEV_EP_COUNT)) >= 0) {
+		test_ep_configure(i, ul_value);
+	} else if ((i = test_index(p_reg, gs_view.USBHS_DEVEPTICR,
+			USBHS_DEV_EP_COUNT)) >= 0) {
+		test_ep_clear(i, ul_value);
+	} else if ((i = test_index(p_reg, gs_view.USBHS_DEVEPTIFR,
+			USBHS_DEV_EP_COUNT)) >= 0) {
+		gs_model.ep[i].ul_isr |= ul_value & TEST_EP_IRQ_Msk;
+	} else if ((i = test_index(p_reg, gs_view.USBHS_DEVEPTIER,
+			USBHS_DEV_EP_COUNT)) >= 0) {
+		if (ul_value & USBHS_DEVEPTIER_RSTDTS) {
+			gs_model.ep[i].uc_toggle = 0;
+		}
+		gs_model.ep[i].ul_imr |= ul_value & ~(USBHS_DEVEPTIER_RSTDTS |
+				USBHS_DEVEPTIER_FIFOCONS | USBHS_DEVEPTIER_KILLBKS);
+	} else if ((i = test_index(p_reg, gs_view.USBHS_DEVEPTIDR,
+			USBHS_DEV_EP_COUNT)) >= 0) {
+		test_ep_disable(i, ul_value);
+	} else if ((i = test_index(p_reg, p_dma,
+			4 * USBHS_DEV_EP_DMA_MAX)) >= 0) {
+		test_dma_write(i / 4 + 1, i % 4, ul_value);
+	} else {
+		test_fault("register written",
+				(uint32_t)((const volatile uint8_t *)p_reg -
+				(const volatile uint8_t *)&gs_view));
+	}
+}
+
+/**
+ * \brief CPU read of an endpoint FIFO: the next byte of the bank.
+ */
+static uint8_t test_fifo_read(uint8_t uc_ep)
+{
+	test_ep_t *p_ep = &gs_model.ep[uc_ep];
+	uint8_t uc_bank = p_ep->uc_first;
+	bool b_full;
+
+	if (uc_ep == 0) {
+		b_full = (p_ep->ul_isr & (USBHS_DEVEPTISR_RXSTPI |
+				USBHS_DEVEPTISR_RXOUTI)) != 0;
+	} else {
+		b_full = !p_ep->b_in && p_ep->uc_busy;
+		if (uc_ep <= USBHS_DEV_EP_DMA_MAX && gs_model.dma[uc_ep - 1].b_on) {
+			test_fault("FIFO read under the DMA", uc_ep);
+		}
+	}
+	if (!b_full || p_ep->us_pos >= p_ep->us_len[uc_bank]) {
+		test_fault("FIFO read past the bank", uc_ep);
+		return 0;
+	}
+	return p_ep->uc_bank[uc_bank][p_ep->us_pos++];
+}
+
+/**
+ * \brief CPU write of an endpoint FIFO: the next byte of the bank.
+ */
+static void test_fifo_write(uint8_t uc_ep, uint8_t uc_byte)
+{
+	test_ep_t *p_ep = &gs_model.ep[uc_ep];
+	uint8_t uc_bank = 0;
+	bool b_free;
+
+	if (uc_ep == 0) {
+		if (p_ep->ul_isr & (USBHS_DEVEPTISR_RXSTPI |
+				USBHS_DEVEPTISR_RXOUTI)) {
+			test_fault("FIFO written over a received bank", uc_ep);
+			return;
+		}
+		b_free = (p_ep->ul_isr & USBHS_DEVEPTISR_TXINI) != 0;
+	} else {
+		b_free = p_ep->b_in && p_ep->uc_busy < p_ep->uc_banks;
+		uc_bank = (p_ep->uc_first + p_ep->uc_busy) % p_ep->uc_banks;
+		if (uc_ep <= USBHS_DEV_EP_DMA_MAX && gs_model.dma[uc_ep - 1].b_on) {
+			test_fault("FIFO written under the DMA", uc_ep);
+		}
+	}
+	if (!b_free || p_ep->us_pos >= p_ep->us_size) {
+		test_fault("FIFO written past the bank", uc_ep);
+		return;
+	}
+	p_ep->uc_bank[uc_bank][p_ep->us_pos++] = uc_byte;
+}
+
+/**
+ * \brief An access to the register block or a FIFO window: present what
+ * the access reads, and let it run alone.
+ */
+static void test_trap_segv(int sig, siginfo_t *p_info, void *p_context)
+{
+	ucontext_t *p_uc = (ucontext_t *)p_context;
+	uintptr_t ul_addr = (uintptr_t)p_info->si_addr;
+
+	gs_trap.p_addr = (volatile uint8_t *)p_info->si_addr;
+	gs_trap.b_write = (p_uc->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+	if (ul_addr - TEST_USBHS_ADDR < TEST_REGS_SIZE) {
+		test_usbhs_view();
+		mprotect((void *)TEST_USBHS_ADDR, TEST_REGS_SIZE,
+				PROT_READ | PROT_WRITE);
+		memcpy((void *)TEST_USBHS_ADDR, &gs_view, sizeof(gs_view));
+	} else if (ul_addr - USBHS_RAM_ADDR < TEST_FIFO_SIZE) {
+		mprotect((void *)(ul_addr & ~(uintptr_t)(TEST_REGS_SIZE - 1)),
+				TEST_REGS_SIZE, PROT_READ | PROT_WRITE);
+		if (!gs_trap.b_write) {
+			*gs_trap.p_addr = test_fifo_read(
+					(ul_addr - USBHS_RAM_ADDR) / TEST_FIFO_WINDOW);
+		}
+	} else {
+		/* Not ours: fault again, without the handler. */
+		signal(SIGSEGV, SIG_DFL);
+		return;
+	}
+	p_uc->uc_mcontext.gregs[REG_EFL] |= TEST_EFLAGS_TF;
+}
+
+/**
+ * \brief The access ran: take what it wrote, and map the page out again.
+ */
+static void test_trap_step(int sig, siginfo_t *p_info, void *p_context)
+{
+	ucontext_t *p_uc = (ucontext_t *)p_context;
+	uintptr_t ul_addr = (uintptr_t)gs_trap.p_addr;
+	uint32_t ul_index = (ul_addr - TEST_USBHS_ADDR) / 4;
+	const volatile uint32_t *p_reg =
+			&((const volatile uint32_t *)&gs_view)[ul_index];
+	int ch;
+
+	p_uc->uc_mcontext.gregs[REG_EFL] &= ~TEST_EFLAGS_TF;
+	if (ul_addr - TEST_USBHS_ADDR < TEST_REGS_SIZE) {
+		/* A write of the value read is a write all the same. */
+		if (gs_trap.b_write) {
+			test_usbhs_write(p_reg,
+					((const volatile uint32_t *)TEST_USBHS_ADDR)[ul_index]);
+		}
+		/* Reading the DMA status clears its end flags. */
+		for (ch = 0; ch < USBHS_DEV_EP_DMA_MAX; ch++) {
+			if (!gs_trap.b_write &&
+					p_reg == &gs_view.USBHS_DEVDMA[ch].USBHS_DEVDMASTATUS) {
+				gs_model.dma[ch].ul_status = 0;
+				gs_model.dma[ch].b_irq = false;
+			}
+		}
+		mprotect((void *)TEST_USBHS_ADDR, TEST_REGS_SIZE, PROT_NONE);
+	} else {
+		if (gs_trap.b_write) {
+			test_fifo_write((ul_addr - USBHS_RAM_ADDR) / TEST_FIFO_WINDOW,
+					*gs_trap.p_addr);
+		}
+		mprotect((void *)(ul_addr & ~(uintptr_t)(TEST_REGS_SIZE - 1)),
+				TEST_REGS_SIZE, PROT_NONE);
+	}
+}
+
+/**
+ * \brief Run the USBHS interrupt while one is raised and enabled.
+ */
+static void test_usbhs_irq(void)
+{
+	uint32_t n;
+
+	for (n = 0; host_nvic.uc_enabled[USBHS_IRQn] &&
+			(test_devisr() & gs_model.ul_devimr); n++) {
+		if (n == TEST_IRQ_MAX) {
+			test_fault("interrupt stuck", test_devisr());
+			break;
+		}
+		gs_model.ul_irqs++;
+		host_irq(USBHS_IRQn, USBHS_Handler);
+	}
+}
+
+/**
+ * \brief End a bus tick: the DMA moves its share, the banks the bus held
+ * are given back and the raised interrupts run.
+ */
+static void test_tick(void)
+{
+	test_ep_t *p_ep;
+	uint8_t uc_ep;
+
+	for (uc_ep = 1; uc_ep <= USBHS_DEV_EP_DMA_MAX; uc_ep++) {
+		test_dma_run(uc_ep, gs_model.ul_dma_rate);
+	}
+	for (uc_ep = 0; uc_ep < USBHS_DEV_EP_COUNT; uc_ep++) {
+		p_ep = &gs_model.ep[uc_ep];
+		if (!p_ep->b_bus) {
+			continue;
+		}
+		p_ep->b_bus = false;
+		if (uc_ep == 0 && p_ep->b_tx_ready) {
+			p_ep->b_tx_ready = false;
+			p_ep->ul_isr |= USBHS_DEVEPTISR_TXINI;
+		} else if (uc_ep == 0) {
+			p_ep->us_len[0] = p_ep->us_bus_len;
+			p_ep->us_pos = 0;
+			p_ep->ul_isr |= USBHS_DEVEPTISR_RXOUTI;
+		} else if (p_ep->b_in) {
+			test_ep_release(p_ep);
+		} else {
+			p_ep->us_len[(p_ep->uc_first + p_ep->uc_busy) %
+					p_ep->uc_banks] = p_ep->us_bus_len;
+			p_ep->uc_busy++;
+			p_ep->ul_isr |= USBHS_DEVEPTISR_RXOUTI;
+		}
+	}
+	gs_model.ul_ticks++;
+	test_usbhs_irq();
+}
+
+/**
+ * \brief Tell whether the device answers a token to an endpoint.
+ */
+static bool test_bus_answers(uint8_t uc_ep, bool b_in)
+{
+	uint32_t ul_devctrl = gs_model.ul_devctrl;
+	uint8_t uc_addr = (ul_devctrl & USBHS_DEVCTRL_ADDEN) ?
+			(ul_devctrl & USBHS_DEVCTRL_UADD_Msk) >>
+			USBHS_DEVCTRL_UADD_Pos : 0;
+	test_ep_t *p_ep = &gs_model.ep[uc_ep];
+
+	return !(ul_devctrl & USBHS_DEVCTRL_DETACH) &&
+			(gs_model.ul_ctrl & USBHS_CTRL_USBE) &&
+			uc_addr == gs_host.uc_addr && p_ep->b_cfgok &&
+			(gs_model.ul_devept & (USBHS_DEVEPT_EPEN0 << uc_ep)) &&
+			(uc_ep == 0 || p_ep->b_in == b_in);
+}
+
+/**
+ * \brief Check and advance the data toggle of a bulk transaction.
+ */
+static void test_bus_toggle(uint8_t uc_ep)
+{
+	if (gs_model.ep[uc_ep].uc_toggle != gs_host.uc_toggle[uc_ep]) {
+		test_fault("data toggle out of step", uc_ep);
+	}
+	gs_model.ep[uc_ep].uc_toggle = !gs_host.uc_toggle[uc_ep];
+	gs_host.uc_toggle[uc_ep] = gs_model.ep[uc_ep].uc_toggle;
+}
+
+/**
+ * \brief Host SETUP transaction on the control endpoint.
+ */
+static test_bus_t test_bus_setup(const void *p_req, uint32_t ul_len)
+{
+	test_ep_t *p_ep = &gs_model.ep[0];
+
+	if (!test_bus_answers(0, false)) {
+		test_tick();
+		return TEST_NONE;
+	}
+	/* A setup packet ends what was in progress on the endpoint. */
+	memcpy(p_ep->uc_bank[0], p_req, ul_len);
+	p_ep->us_len[0] = ul_len;
+	p_ep->us_pos = 0;
+	p_ep->b_tx_ready = false;
+	p_ep->ul_isr = USBHS_DEVEPTISR_RXSTPI | USBHS_DEVEPTISR_TXINI;
+	p_ep->ul_imr &= ~USBHS_DEVEPTIMR_STALLRQ;
+	test_tick();
+	return TEST_ACK;
+}
+
+/**
+ * \brief Host IN transaction.
+ *
+ * \param uc_ep Endpoint number.
+ * \param p_buf Packet received.
+ * \param p_len Its length.
+ */
+static test_bus_t test_bus_in(uint8_t uc_ep, uint8_t *p_buf,
+		uint32_t *p_len)
+{
+	test_ep_t *p_ep = &gs_model.ep[uc_ep];
+	test_bus_t result = TEST_NAK;
+	uint8_t uc_bank = p_ep->uc_first;
+
+	*p_len = 0;
+	if (!test_bus_answers(uc_ep, true)) {
+		result = TEST_NONE;
+	} else if (p_ep->ul_imr & USBHS_DEVEPTIMR_STALLRQ) {
+		p_ep->ul_isr |= USBHS_DEVEPTISR_STALLEDI;
+		result = TEST_STALL;
+	} else if (uc_ep == 0 ? p_ep->b_tx_ready : p_ep->uc_busy > 0) {
+		*p_len = p_ep->us_len[uc_bank];
+		memcpy(p_buf, p_ep->uc_bank[uc_bank], *p_len);
+		p_ep->b_bus = true;
+		if (uc_ep) {
+			test_bus_toggle(uc_ep);
+		}
+		gs_model.ul_packets++;
+		result = TEST_ACK;
+	} else {
+		p_ep->ul_isr |= USBHS_DEVEPTISR_NAKINI;
+		gs_model.ul_naks++;
+	}
+	test_tick();
+	return result;
+}
+
+/**
+ * \brief Host OUT transaction.
+ */
+static test_bus_t test_bus_out(uint8_t uc_ep, const void *p_data,
+		uint32_t ul_len)
+{
+	test_ep_t *p_ep = &gs_model.ep[uc_ep];
+	test_bus_t result = TEST_NAK;
+	uint8_t uc_bank;
+
+	if (!test_bus_answers(uc_ep, false)) {
+		result = TEST_NONE;
+	} else if (p_ep->ul_imr & USBHS_DEVEPTIMR_STALLRQ) {
+		p_ep->ul_isr |= USBHS_DEVEPTISR_STALLEDI;
+		result = TEST_STALL;
+	} else if (uc_ep == 0 ? !(p_ep->ul_isr & (USBHS_DEVEPTISR_RXSTPI |
+			USBHS_DEVEPTISR_RXOUTI)) && !p_ep->b_tx_ready :
+			p_ep->uc_busy < p_ep->uc_banks) {
+		if (!TEST_CHECK(ul_len <= p_ep->us_size)) {
+			ul_len = p_ep->us_size;
+		}
+		uc_bank = uc_ep ? (p_ep->uc_first + p_ep->uc_busy) %
+				p_ep->uc_banks : 0;
+		memcpy(p_ep->uc_bank[uc_bank], p_data, ul_len);
+		p_ep->us_bus_len = ul_len;
+		p_ep->b_bus = true;
+		if (uc_ep) {
+			test_bus_toggle(uc_ep);
+		}
+		gs_model.ul_packets++;
+		result = TEST_ACK;
+	} else {
+		p_ep->ul_isr |= USBHS_DEVEPTISR_NAKOUTI;
+		gs_model.ul_naks++;
+	}
+	test_tick();
+	return result;
+}
+
+/**
+ * \brief IN transaction, retried while the device NAKs it.
+ */
+static test_bus_t test_host_in(uint8_t uc_ep, uint8_t *p_buf,
+		uint32_t *p_len)
+{
+	test_bus_t result = TEST_NAK;
+	uint32_t n;
+
+	for (n = 0; n < TEST_NAK_MAX && result == TEST_NAK; n++) {
+		result = test_bus_in(uc_ep, p_buf, p_len);
+	}
+	return result;
+}
+
+/**
+ * \brief OUT transaction, retried while the device NAKs it.
+ */
+static test_bus_t test_host_out(uint8_t uc_ep, const void *p_data,
+		uint32_t ul_len)
+{
+	test_bus_t result = TEST_NAK;
+	uint32_t n;
+
+	for (n = 0; n < TEST_NAK_MAX && result == TEST_NAK; n++) {
+		result = test_bus_out(uc_ep, p_data, ul_len);
+	}
+	return result;
+}
+
+/**
+ * \brief Run a control transfer as the host does, packets of 64 bytes.
+ *
+ * \param p_req Request.
+ * \param p_data Data stage, read or written.
+ *
+ * \return Bytes of the data stage, TEST_STALLED or TEST_FAILED.
+ */
+static int32_t test_control(const usb_setup_t *p_req, void *p_data)
+{
+	uint8_t *p_bytes = (uint8_t *)p_data;
+	uint8_t uc_packet[USBHS_DEV_EP0_SIZE];
+	uint32_t ul_done = 0;
+	uint32_t ul_n;
+	test_bus_t result;
+
+	if (test_bus_setup(p_req, sizeof(*p_req)) != TEST_ACK) {
+		return TEST_FAILED;
+	}
+	if (p_req->wLength && (p_req->bmRequestType & USB_REQ_DIR_IN)) {
+		do {
+			result = test_host_in(0, uc_packet, &ul_n);
+			if (result != TEST_ACK) {
+				return result == TEST_STALL ? TEST_STALLED : TEST_FAILED;
+			}
+			if (!TEST_CHECK(ul_done + ul_n <= p_req->wLength)) {
+				return TEST_FAILED;
+			}
+			memcpy(&p_bytes[ul_done], uc_packet, ul_n);
+			ul_done += ul_n;
+		} while (ul_n == USBHS_DEV_EP0_SIZE && ul_done < p_req->wLength);
+		result = test_host_out(0, NULL, 0);
+	} else {
+		while (ul_done < p_req->wLength) {
+			ul_n = Min(p_req->wLength - ul_done, USBHS_DEV_EP0_SIZE);
+			result = test_host_out(0, &p_bytes[ul_done], ul_n);
+			if (result != TEST_ACK) {
+				return result == TEST_STALL ? TEST_STALLED : TEST_FAILED;
+			}
+			ul_done += ul_n;
+		}
+		result = test_host_in(0, uc_packet, &ul_n);
+		if (result == TEST_ACK && !TEST_CHECK(ul_n == 0)) {
+			return TEST_FAILED;
+		}
+	}
+	if (result != TEST_ACK) {
+		return result == TEST_STALL ? TEST_STALLED : TEST_FAILED;
+	}
+	return ul_done;
+}
+
+/**
+ * \brief Control transfer from its fields.
+ */
+static int32_t test_request(uint8_t uc_type, uint8_t uc_request,
+		uint16_t us_value, uint16_t us_index, uint16_t us_length,
+		void *p_data)
+{
+	usb_setup_t req = {uc_type, uc_request, us_value, us_index, us_length};
+
+	return test_control(&req, p_data);
+}
+
+/**
+ * \brief SET_ADDRESS, the host moving to the address once it is done.
+ */
+static bool test_set_address(uint8_t uc_addr)
+{
+	if (test_request(USB_REQ_TYPE_STANDARD | USB_REQ_RECIP_DEVICE,
+			USB_REQ_SET_ADDRESS, uc_addr, 0, 0, NULL) != 0) {
+		return false;
+	}
+	gs_host.uc_addr = uc_addr;
+	return true;
+}
+
+/**
+ * \brief Read a bulk IN transfer: packets until a short one, or \a ul_max
+ * bytes.
+ *
+ * \return Bytes read, or -1 if the endpoint stalled or did not answer.
+ */
+static int32_t test_read(uint8_t uc_ep, uint8_t *p_buf, uint32_t ul_max)
+{
+	uint8_t uc_packet[1024];
+	uint32_t ul_done = 0;
+	uint32_t ul_n;
+
+	do {
+		if (test_host_in(uc_ep, uc_packet, &ul_n) != TEST_ACK ||
+				!TEST_CHECK(ul_done + ul_n <= ul_max)) {
+			return -1;
+		}
+		memcpy(&p_buf[ul_done], uc_packet, ul_n);
+		ul_done += ul_n;
+	} while (ul_n == gs_model.ep[uc_ep].us_size && ul_done < ul_max);
+	return ul_done;
+}
+
+/**
+ * \brief Write a bulk OUT transfer, ended by a short or empty packet if
+ * \a b_end.
+ *
+ * \return false if a packet was not taken.
+ */
+static bool test_write(uint8_t uc_ep, const uint8_t *p_data, uint32_t ul_len,
+		bool b_end)
+{
+	uint32_t ul_size = gs_model.ep[uc_ep].us_size;
+	uint32_t ul_done = 0;
+	uint32_t ul_n;
+
+	do {
+		ul_n = Min(ul_len - ul_done, ul_size);
+		if (test_host_out(uc_ep, &p_data[ul_done], ul_n) != TEST_ACK) {
+			return false;
+		}
+		ul_done += ul_n;
+	} while (ul_done < ul_len || (b_end && ul_n == ul_size));
+	/* The DMA takes the last packet. */
+	test_tick();
+	return true;
+}
+
+/**
+ * \brief USB bus reset by the host.
+ */
+static void test_bus_reset(void)
+{
+	uint8_t uc_ep;
+
+	gs_host.uc_addr = 0;
+	memset(gs_host.uc_toggle, 0, sizeof(gs_host.uc_toggle));
+	if ((gs_model.ul_devctrl & USBHS_DEVCTRL_DETACH) ||
+			!(gs_model.ul_ctrl & USBHS_CTRL_USBE)) {
+		return;
+	}
+	gs_model.ul_devctrl &= ~(USBHS_DEVCTRL_UADD_Msk | USBHS_DEVCTRL_ADDEN);
+	gs_model.b_high_speed = gs_host.b_high_speed &&
+			(gs_model.ul_devctrl & USBHS_DEVCTRL_SPDCONF_Msk) !=
+			USBHS_DEVCTRL_SPDCONF_FORCED_FS;
+	for (uc_ep = 0; uc_ep < USBHS_DEV_EP_COUNT; uc_ep++) {
+		test_ep_flush(&gs_model.ep[uc_ep]);
+		gs_model.ep[uc_ep].uc_toggle = 0;
+	}
+	gs_model.ul_devisr |= USBHS_DEVISR_EORST;
+	test_usbhs_irq();
+}
+
+/**
+ * \brief Reset the model, the host high speed and its DMA as fast as can be.
+ */
+static void test_model_reset(void)
+{
+	memset(&gs_model, 0, sizeof(gs_model));
+	memset(&gs_host, 0, sizeof(gs_host));
+	gs_model.ul_devctrl = USBHS_DEVCTRL_DETACH;
+	gs_model.ul_dma_rate = UINT32_MAX;
+	gs_host.b_high_speed = true;
+	host_nvic.uc_enabled[USBHS_IRQn] = 0;
+}
+
+/** Driver tests: what the callbacks saw, and the control requests. */
+#define TEST_VENDOR             0x40
+#define TEST_REQ_READ           1
+#define TEST_REQ_WRITE          2
+#define TEST_REQ_NO_DATA        3
+
+static struct {
+	usbhs_dev_t dev;
+	uint8_t uc_answer[256];
+	uint16_t us_answer_len;
+	uint8_t uc_out[128];
+	uint32_t ul_resets;
+	uint32_t ul_suspends;
+	uint32_t ul_resumes;
+	uint32_t ul_ctrl_out;
+	uint32_t ul_setups;
+	uint32_t ul_done[USBHS_DEV_EP_COUNT];
+	uint32_t ul_done_len[USBHS_DEV_EP_COUNT];
+	uint32_t ul_last_arg;
+} gs_drv;
+
+static bool test_drv_setup(usbhs_dev_t *p_dev, const usb_setup_t *p_req)
+{
+	gs_drv.ul_setups++;
+	if ((p_req->bmRequestType & USB_REQ_TYPE_Msk) != TEST_VENDOR) {
+		return false;
+	}
+	switch (p_req->bRequest) {
+	case TEST_REQ_READ:
+		usbhs_dev_ctrl_data(p_dev, gs_drv.uc_answer, gs_drv.us_answer_len);
+		return true;
+	case TEST_REQ_WRITE:
+		usbhs_dev_ctrl_data(p_dev, gs_drv.uc_out, sizeof(gs_drv.uc_out));
+		return true;
+	case TEST_REQ_NO_DATA:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void test_drv_event(usbhs_dev_t *p_dev, usbhs_dev_event_t event,
+		uint8_t uc_ep, uint32_t ul_arg)
+{
+	gs_drv.ul_last_arg = ul_arg;
+	switch (event) {
+	case USBHS_DEV_RESET:
+		gs_drv.ul_resets++;
+		break;
+	case USBHS_DEV_SUSPEND:
+		gs_drv.ul_suspends++;
+		break;
+	case USBHS_DEV_RESUME:
+		gs_drv.ul_resumes++;
+		break;
+	case USBHS_DEV_CTRL_OUT:
+		gs_drv.ul_ctrl_out++;
+		break;
+	case USBHS_DEV_EP_DONE:
+		gs_drv.ul_done[uc_ep]++;
+		gs_drv.ul_done_len[uc_ep] = ul_arg;
+		break;
+	}
+}
+
+/**
+ * \brief Start the driver on a fresh model, attached and reset by the host.
+ */
+static bool test_drv_start(bool b_high_speed)
+{
+	usbhs_dev_config_t cfg = {b_high_speed, test_drv_setup, test_drv_event,
+			NULL};
+
+	test_model_reset();
+	memset(&gs_drv, 0, sizeof(gs_drv));
+	if (!TEST_CHECK_EQ(usbhs_dev_init(&gs_drv.dev, USBHS, &cfg), STATUS_OK)) {
+		return false;
+	}
+	NVIC_EnableIRQ(USBHS_IRQn);
+	usbhs_dev_attach(&gs_drv.dev);
+	test_bus_reset();
+	return TEST_CHECK_EQ(gs_drv.ul_resets, 1);
+}
+
+/** Transfer buffers, out of the thread stacks as the DMA reads them. */
+static uint8_t gs_uc_tx[USBHS_DEV_XFER_MAX];
+static uint8_t gs_uc_rx[USBHS_DEV_XFER_MAX + 1024];
+
+/**
+ * \brief Pattern of the transfers, from a seed.
+ */
+static void test_fill(uint8_t *p_buf, uint32_t ul_len, uint32_t ul_seed)
+{
+	uint32_t i;
+
+	for (i = 0; i < ul_len; i++) {
+		p_buf[i] = (uint8_t)(ul_seed + i * 7 + (i >> 8));
+	}
+}
+
+static void test_init(void)
+{
+	usbhs_dev_config_t cfg = {true, test_drv_setup, test_drv_event, NULL};
+	usbhs_dev_t dev;
+
+	test_model_reset();
+	cfg.setup = NULL;
+	TEST_CHECK_EQ(usbhs_dev_init(&dev, USBHS, &cfg), ERR_INVALID_ARG);
+	cfg.setup = test_drv_setup;
+
+	/* No UTMI clock: the USBHS is frozen again. */
+	gs_model.b_no_clock = true;
+	TEST_CHECK_EQ(usbhs_dev_init(&dev, USBHS, &cfg), ERR_TIMEOUT);
+	TEST_CHECK(USBHS->USBHS_CTRL & USBHS_CTRL_FRZCLK);
+	TEST_CHECK(!(USBHS->USBHS_CTRL & USBHS_CTRL_USBE));
+	gs_model.b_no_clock = false;
+
+	/* Detached until attached, at the speed asked. */
+	TEST_CHECK_EQ(usbhs_dev_init(&dev, USBHS, &cfg), STATUS_OK);
+	TEST_CHECK(USBHS->USBHS_DEVCTRL & USBHS_DEVCTRL_DETACH);
+	TEST_CHECK_EQ(USBHS->USBHS_DEVCTRL & USBHS_DEVCTRL_SPDCONF_Msk,
+			USBHS_DEVCTRL_SPDCONF_NORMAL);
+	TEST_CHECK_EQ(USBHS->USBHS_DEVIMR,
+			USBHS_DEVIMR_EORSTE | USBHS_DEVIMR_SUSPE);
+	NVIC_EnableIRQ(USBHS_IRQn);
+	test_bus_reset();
+	TEST_CHECK_EQ(gs_drv.ul_resets, 0);
+	TEST_CHECK_EQ(test_request(TEST_VENDOR | USB_REQ_DIR_IN, TEST_REQ_READ,
+			0, 0, 8, gs_drv.uc_out), TEST_FAILED);
+
+	/* Attached and reset: high speed, control endpoint only. */
+	TEST_CHECK(test_drv_start(true));
+	TEST_CHECK(usbhs_dev_is_high_speed(&gs_drv.dev));
+	TEST_CHECK_EQ(gs_drv.ul_last_arg, 1);
+	TEST_CHECK_EQ(USBHS->USBHS_DEVEPT, USBHS_DEVEPT_EPEN0);
+	TEST_CHECK(USBHS->USBHS_DEVEPTISR[0] & USBHS_DEVEPTISR_CFGOK);
+
+	/* Full speed asked, or the host only does full speed. */
+	TEST_CHECK(test_drv_start(false));
+	TEST_CHECK(!usbhs_dev_is_high_speed(&gs_drv.dev));
+	test_model_reset();
+	gs_host.b_high_speed = false;
+	cfg.b_high_speed = true;
+	TEST_CHECK_EQ(usbhs_dev_init(&gs_drv.dev, USBHS, &cfg), STATUS_OK);
+	NVIC_EnableIRQ(USBHS_IRQn);
+	usbhs_dev_attach(&gs_drv.dev);
+	test_bus_reset();
+	TEST_CHECK(!usbhs_dev_is_high_speed(&gs_drv.dev));
+
+	/* Bus events. */
+	TEST_CHECK(test_drv_start(true));
+	gs_model.ul_devisr |= USBHS_DEVISR_SUSP;
+	test_usbhs_irq();
+	gs_model.ul_devisr |= USBHS_DEVISR_SUSP;
+	test_usbhs_irq();
+	TEST_CHECK_EQ(gs_drv.ul_suspends, 1);
+	gs_model.ul_devisr |= USBHS_DEVISR_WAKEUP;
+	test_usbhs_irq();
+	TEST_CHECK_EQ(gs_drv.ul_resumes, 1);
+	TEST_CHECK_EQ(gs_drv.ul_suspends, 1);
+
+	/* Detached: the host loses the device. */
+	usbhs_dev_detach(&gs_drv.dev);
+	TEST_CHECK_EQ(test_request(TEST_VENDOR, TEST_REQ_NO_DATA, 0, 0, 0,
+			NULL), TEST_FAILED);
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+static void test_control_requests(void)
+{
+	uint8_t uc_data[300];
+	uint8_t uc_setup[8] = {0};
+	uint32_t i;
+
+	TEST_CHECK(test_drv_start(true));
+	for (i = 0; i < sizeof(gs_drv.uc_answer); i++) {
+		gs_drv.uc_answer[i] = (uint8_t)(i * 3 + 1);
+	}
+
+	/* Answers of 0 to 3 packets, cut to wLength, ended by a short or an
+	 * empty packet when shorter than asked. */
+	{
+		static const uint16_t us_cases[][3] = {
+			/* answer, wLength, expected */
+			{18, 64, 18}, {18, 8, 8}, {64, 64, 64}, {64, 255, 64},
+			{128, 255, 128}, {200, 255, 200}, {200, 100, 100},
+			{0, 16, 0}, {256, 256, 256},
+		};
+
+		for (i = 0; i < sizeof(us_cases) / sizeof(us_cases[0]); i++) {
+			gs_drv.us_answer_len = us_cases[i][0];
+			memset(uc_data, 0, sizeof(uc_data));
+			TEST_CHECK_EQ(test_request(TEST_VENDOR | USB_REQ_DIR_IN,
+					TEST_REQ_READ, 0, 0, us_cases[i][1], uc_data),
+					us_cases[i][2]);
+			TEST_CHECK(!memcmp(uc_data, gs_drv.uc_answer, us_cases[i][2]));
+		}
+	}
+
+	/* Data from the host, over several packets. */
+	for (i = 0; i < 100; i++) {
+		uc_data[i] = (uint8_t)(0xA0 ^ i);
+	}
+	TEST_CHECK_EQ(test_request(TEST_VENDOR, TEST_REQ_WRITE, 0, 0, 100,
+			uc_data), 100);
+	TEST_CHECK_EQ(gs_drv.ul_ctrl_out, 1);
+	TEST_CHECK_EQ(gs_drv.ul_last_arg, 100);
+	TEST_CHECK(!memcmp(gs_drv.uc_out, uc_data, 100));
+	TEST_CHECK_EQ(test_request(TEST_VENDOR, TEST_REQ_WRITE, 0, 0, 128,
+			uc_data), 128);
+	TEST_CHECK_EQ(gs_drv.ul_last_arg, 128);
+	/* More than the buffer holds. */
+	TEST_CHECK_EQ(test_request(TEST_VENDOR, TEST_REQ_WRITE, 0, 0, 129,
+			uc_data), TEST_STALLED);
+	TEST_CHECK_EQ(gs_drv.ul_ctrl_out, 2);
+
+	/* Refused requests stall, and the next setup clears the stall. */
+	TEST_CHECK_EQ(test_request(TEST_VENDOR | USB_REQ_DIR_IN, 99, 0, 0, 8,
+			uc_data), TEST_STALLED);
+	TEST_CHECK_EQ(test_request(TEST_VENDOR, 99, 0, 0, 0, NULL),
+			TEST_STALLED);
+	TEST_CHECK_EQ(test_request(TEST_VENDOR, TEST_REQ_NO_DATA, 0, 0, 0,
+			NULL), 0);
+	/* A setup packet of the wrong length. */
+	TEST_CHECK_EQ(test_bus_setup(uc_setup, 7), TEST_ACK);
+	TEST_CHECK_EQ(test_bus_in(0, uc_data, &i), TEST_STALL);
+	TEST_CHECK_EQ(gs_drv.ul_setups, 15);
+
+	/* SET_ADDRESS applies once its status stage is over: before, the
+	 * device still answers at 0, after, only at the new address. */
+	TEST_CHECK(test_set_address(42));
+	TEST_CHECK_EQ(USBHS->USBHS_DEVCTRL & (USBHS_DEVCTRL_UADD_Msk |
+			USBHS_DEVCTRL_ADDEN), USBHS_DEVCTRL_UADD(42) |
+			USBHS_DEVCTRL_ADDEN);
+	gs_drv.us_answer_len = 4;
+	TEST_CHECK_EQ(test_request(TEST_VENDOR | USB_REQ_DIR_IN, TEST_REQ_READ,
+			0, 0, 4, uc_data), 4);
+	gs_host.uc_addr = 0;
+	TEST_CHECK_EQ(test_request(TEST_VENDOR | USB_REQ_DIR_IN, TEST_REQ_READ,
+			0, 0, 4, uc_data), TEST_FAILED);
+	/* A bus reset goes back to address 0. */
+	test_bus_reset();
+	TEST_CHECK_EQ(test_request(TEST_VENDOR, TEST_REQ_NO_DATA, 0, 0, 0,
+			NULL), 0);
+	TEST_CHECK(test_set_address(43));
+	TEST_CHECK_EQ(test_request(TEST_VENDOR, TEST_REQ_NO_DATA, 0, 0, 0,
+			NULL), 0);
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+static void test_endpoints(void)
+{
+	TEST_CHECK(test_drv_start(true));
+
+	/* Arguments. */
+	TEST_CHECK_EQ(usbhs_dev_ep_configure(&gs_drv.dev, 0, USBHS_EP_BULK,
+			512, 2), ERR_INVALID_ARG);
+	TEST_CHECK_EQ(usbhs_dev_ep_configure(&gs_drv.dev, USBHS_DEV_EP_COUNT,
+			USBHS_EP_BULK, 512, 2), ERR_INVALID_ARG);
+	TEST_CHECK_EQ(usbhs_dev_ep_configure(&gs_drv.dev, 1, USBHS_EP_BULK,
+			500, 2), ERR_INVALID_ARG);
+	TEST_CHECK_EQ(usbhs_dev_ep_configure(&gs_drv.dev, 1, USBHS_EP_BULK,
+			2048, 2), ERR_INVALID_ARG);
+	TEST_CHECK_EQ(usbhs_dev_ep_configure(&gs_drv.dev, 1, USBHS_EP_BULK,
+			512, 0), ERR_INVALID_ARG);
+	TEST_CHECK_EQ(usbhs_dev_ep_configure(&gs_drv.dev, 1, USBHS_EP_BULK,
+			512, 4), ERR_INVALID_ARG);
+	TEST_CHECK_EQ(USBHS->USBHS_DEVEPT, USBHS_DEVEPT_EPEN0);
+
+	/* The endpoint memory runs out: the endpoint is left off and free. */
+	TEST_CHECK_EQ(usbhs_dev_ep_configure(&gs_drv.dev, 1 | USB_EP_DIR_IN,
+			USBHS_EP_BULK, 1024, 3), STATUS_OK);
+	TEST_CHECK_EQ(usbhs_dev_ep_configure(&gs_drv.dev, 2, USBHS_EP_BULK,
+			512, 2), ERR_NO_MEMORY);
+	TEST_CHECK(!(USBHS->USBHS_DEVEPT & USBHS_DEVEPT_EPEN2));
+	TEST_CHECK(!(USBHS->USBHS_DEVEPTCFG[2] & USBHS_DEVEPTCFG_ALLOC));
+	TEST_CHECK_EQ(usbhs_dev_ep_configure(&gs_drv.dev, 2, USBHS_EP_BULK,
+			512, 1), STATUS_OK);
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 3, gs_uc_rx, 512, false),
+			ERR_INVALID_ARG);
+
+	/* Freed from the top, configured again from the bottom. */
+	usbhs_dev_ep_unconfigure(&gs_drv.dev, 2);
+	usbhs_dev_ep_unconfigure(&gs_drv.dev, 1 | USB_EP_DIR_IN);
+	TEST_CHECK_EQ(USBHS->USBHS_DEVEPT, USBHS_DEVEPT_EPEN0);
+	TEST_CHECK_EQ(usbhs_dev_ep_configure(&gs_drv.dev, 1 | USB_EP_DIR_IN,
+			USBHS_EP_BULK, 512, 2), STATUS_OK);
+	TEST_CHECK_EQ(usbhs_dev_ep_configure(&gs_drv.dev, 2, USBHS_EP_BULK,
+			512, 2), STATUS_OK);
+	TEST_CHECK_EQ(usbhs_dev_ep_configure(&gs_drv.dev, 8 | USB_EP_DIR_IN,
+			USBHS_EP_INTERRUPT, 64, 1), STATUS_OK);
+
+	/* Transfers: arguments. */
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 0, gs_uc_tx, 8, false),
+			ERR_INVALID_ARG);
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 8, gs_uc_tx, 8, false),
+			ERR_INVALID_ARG);
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 1, gs_uc_tx,
+			USBHS_DEV_XFER_MAX + 1, false), ERR_INVALID_ARG);
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 2, gs_uc_rx, 0, false),
+			ERR_INVALID_ARG);
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 1, gs_uc_tx, 8, false),
+			STATUS_OK);
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 1, gs_uc_tx, 8, false),
+			ERR_BUSY);
+	TEST_CHECK(usbhs_dev_ep_is_busy(&gs_drv.dev, 1));
+	/* Aborted before the DMA moved anything. */
+	TEST_CHECK_EQ(usbhs_dev_ep_abort(&gs_drv.dev, 1), 0);
+	TEST_CHECK(!usbhs_dev_ep_is_busy(&gs_drv.dev, 1));
+
+	/* Halt: stalled tokens, and the data toggle back to DATA0. */
+	test_fill(gs_uc_tx, 512, 1);
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 1, gs_uc_tx, 512, false),
+			STATUS_OK);
+	TEST_CHECK_EQ(test_read(1, gs_uc_rx, 512), 512);
+	usbhs_dev_ep_set_halt(&gs_drv.dev, 1 | USB_EP_DIR_IN, true);
+	TEST_CHECK(usbhs_dev_ep_is_halted(&gs_drv.dev, 1));
+	TEST_CHECK_EQ(test_read(1, gs_uc_rx, 512), -1);
+	usbhs_dev_ep_set_halt(&gs_drv.dev, 1 | USB_EP_DIR_IN, false);
+	gs_host.uc_toggle[1] = 0;
+	TEST_CHECK(!usbhs_dev_ep_is_halted(&gs_drv.dev, 1));
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 1, gs_uc_tx, 100, false),
+			STATUS_OK);
+	TEST_CHECK_EQ(test_read(1, gs_uc_rx, 512), 100);
+	TEST_CHECK(!usbhs_dev_ep_is_halted(&gs_drv.dev, 12));
+
+	/* A bus reset removes them. */
+	test_bus_reset();
+	TEST_CHECK_EQ(USBHS->USBHS_DEVEPT, USBHS_DEVEPT_EPEN0);
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 1, gs_uc_tx, 8, false),
+			ERR_INVALID_ARG);
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+/**
+ * \brief IN transfers of several lengths: full packets but the last, an
+ * empty one after a multiple of the packet size when asked.
+ */
+static void test_in(uint8_t uc_banks)
+{
+	static const uint32_t ul_lens[] = {
+		1, 100, 511, 512, 513, 1024, 1500, 4096, 5000, USBHS_DEV_XFER_MAX,
+	};
+	uint32_t i, ul_len;
+	int b_zlp;
+
+	TEST_CHECK(test_drv_start(true));
+	TEST_CHECK_EQ(usbhs_dev_ep_configure(&gs_drv.dev, 1 | USB_EP_DIR_IN,
+			USBHS_EP_BULK, 512, uc_banks), STATUS_OK);
+	for (i = 0; i < sizeof(ul_lens) / sizeof(ul_lens[0]); i++) {
+		for (b_zlp = 0; b_zlp < 2; b_zlp++) {
+			ul_len = ul_lens[i];
+			test_fill(gs_uc_tx, ul_len, i);
+			memset(gs_uc_rx, 0, ul_len);
+			gs_drv.ul_done[1] = 0;
+			TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 1, gs_uc_tx,
+					ul_len, b_zlp), STATUS_OK);
+			TEST_CHECK_EQ(test_read(1, gs_uc_rx, ul_len), ul_len);
+			TEST_CHECK(!memcmp(gs_uc_rx, gs_uc_tx, ul_len));
+			/* The empty packet, and nothing after. */
+			if (b_zlp && !(ul_len % 512)) {
+				TEST_CHECK_EQ(test_read(1, gs_uc_rx, 512), 0);
+			}
+			TEST_CHECK_EQ(test_bus_in(1, gs_uc_rx, &ul_len), TEST_NAK);
+			TEST_CHECK_EQ(gs_drv.ul_done[1], 1);
+			TEST_CHECK_EQ(gs_drv.ul_done_len[1], ul_lens[i]);
+			TEST_CHECK(!usbhs_dev_ep_is_busy(&gs_drv.dev, 1));
+		}
+	}
+
+	/* An empty transfer. */
+	gs_drv.ul_done[1] = 0;
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 1, gs_uc_tx, 0, false),
+			STATUS_OK);
+	TEST_CHECK_EQ(test_read(1, gs_uc_rx, 0), 0);
+	TEST_CHECK_EQ(gs_drv.ul_done[1], 1);
+	TEST_CHECK_EQ(gs_drv.ul_done_len[1], 0);
+
+	/* Aborted with banks waiting: they are flushed. */
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 1, gs_uc_tx, 4096, true),
+			STATUS_OK);
+	test_tick();
+	TEST_CHECK_EQ(test_bus_in(1, gs_uc_rx, &ul_len), TEST_ACK);
+	TEST_CHECK_EQ(usbhs_dev_ep_abort(&gs_drv.dev, 1), 512 * uc_banks);
+	TEST_CHECK_EQ(test_bus_in(1, gs_uc_rx, &ul_len), TEST_NAK);
+	/* Aborted while its empty packet waits for a free bank. */
+	if (uc_banks == 1) {
+		TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 1, gs_uc_tx, 512,
+				true), STATUS_OK);
+		test_tick();
+		TEST_CHECK(usbhs_dev_ep_is_busy(&gs_drv.dev, 1));
+		TEST_CHECK_EQ(usbhs_dev_ep_abort(&gs_drv.dev, 1), 512);
+		TEST_CHECK_EQ(test_bus_in(1, gs_uc_rx, &ul_len), TEST_NAK);
+	}
+	TEST_CHECK_EQ(gs_drv.ul_done[1], 1);
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+/**
+ * \brief OUT transfers: a short packet or a full buffer ends them, and the
+ * host is held off while no transfer takes the banks.
+ */
+static void test_out(uint8_t uc_banks)
+{
+	static const uint32_t ul_lens[] = {
+		0, 1, 100, 511, 512, 513, 1024, 1500, 4096, 5000,
+	};
+	uint32_t i, ul_len;
+
+	TEST_CHECK(test_drv_start(true));
+	TEST_CHECK_EQ(usbhs_dev_ep_configure(&gs_drv.dev, 1 | USB_EP_DIR_IN,
+			USBHS_EP_BULK, 512, 1), STATUS_OK);
+	TEST_CHECK_EQ(usbhs_dev_ep_configure(&gs_drv.dev, 2, USBHS_EP_BULK,
+			512, uc_banks), STATUS_OK);
+	for (i = 0; i < sizeof(ul_lens) / sizeof(ul_lens[0]); i++) {
+		ul_len = ul_lens[i];
+		test_fill(gs_uc_tx, ul_len, i);
+		memset(gs_uc_rx, 0, ul_len);
+		gs_drv.ul_done[2] = 0;
+		TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 2, gs_uc_rx, 8192,
+				false), STATUS_OK);
+		TEST_CHECK(test_write(2, gs_uc_tx, ul_len, true));
+		TEST_CHECK_EQ(gs_drv.ul_done[2], 1);
+		TEST_CHECK_EQ(gs_drv.ul_done_len[2], ul_len);
+		TEST_CHECK(!memcmp(gs_uc_rx, gs_uc_tx, ul_len));
+	}
+
+	/* A full buffer ends the transfer, the next packets wait in the
+	 * banks, then the host is held off. */
+	test_fill(gs_uc_tx, 4096, 99);
+	gs_drv.ul_done[2] = 0;
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 2, gs_uc_rx, 1024,
+			false), STATUS_OK);
+	TEST_CHECK(test_write(2, gs_uc_tx, 1024 + 512 * uc_banks, false));
+	TEST_CHECK_EQ(gs_drv.ul_done[2], 1);
+	TEST_CHECK_EQ(gs_drv.ul_done_len[2], 1024);
+	TEST_CHECK_EQ(test_bus_out(2, gs_uc_tx, 512), TEST_NAK);
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 2, &gs_uc_rx[1024], 2048,
+			false), STATUS_OK);
+	TEST_CHECK(test_write(2, &gs_uc_tx[1024 + 512 * uc_banks],
+			3072 - 1024 - 512 * uc_banks, false));
+	TEST_CHECK_EQ(gs_drv.ul_done[2], 2);
+	TEST_CHECK(!memcmp(gs_uc_rx, gs_uc_tx, 3072));
+
+	/* Aborted with data in the banks: they are flushed. */
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 2, gs_uc_rx, 1024,
+			false), STATUS_OK);
+	TEST_CHECK(test_write(2, gs_uc_tx, 512, false));
+	TEST_CHECK_EQ(usbhs_dev_ep_abort(&gs_drv.dev, 2), 512);
+	TEST_CHECK_EQ(USBHS->USBHS_DEVEPTISR[2] & USBHS_DEVEPTISR_NBUSYBK_Msk,
+			0);
+	TEST_CHECK_EQ(gs_drv.ul_done[2], 2);
+
+	/* A transfer of the IN endpoint meanwhile. */
+	gs_drv.ul_done[2] = 0;
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 2, gs_uc_rx, 1024,
+			false), STATUS_OK);
+	TEST_CHECK_EQ(usbhs_dev_ep_start(&gs_drv.dev, 1, gs_uc_tx, 700, false),
+			STATUS_OK);
+	TEST_CHECK(test_write(2, gs_uc_tx, 300, true));
+	TEST_CHECK_EQ(test_read(1, &gs_uc_rx[2048], 1024), 700);
+	TEST_CHECK_EQ(gs_drv.ul_done[1], 1);
+	TEST_CHECK_EQ(gs_drv.ul_done[2], 1);
+	TEST_CHECK_EQ(gs_drv.ul_done_len[2], 300);
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+/** CDC tests: what the callback saw. */
+static struct {
+	uint32_t ul_opens;
+	uint32_t ul_closes;
+	uint32_t ul_tx_done;
+	const uint8_t *p_tx;
+	uint32_t ul_tx_len;
+	uint8_t uc_rx[4096];
+	uint32_t ul_rx_len;
+	uint32_t ul_rx_events;
+	/** Give the receive buffer back at once. */
+	bool b_release;
+} gs_cdc;
+
+static void test_cdc_event(usb_cdc_event_t event, const uint8_t *p_data,
+		uint32_t ul_len, void *p_ctx)
+{
+	TEST_CHECK(p_ctx == &gs_cdc);
+	switch (event) {
+	case USB_CDC_OPEN:
+		gs_cdc.ul_opens++;
+		break;
+	case USB_CDC_CLOSE:
+		gs_cdc.ul_closes++;
+		break;
+	case USB_CDC_TX_DONE:
+		gs_cdc.ul_tx_done++;
+		gs_cdc.p_tx = p_data;
+		gs_cdc.ul_tx_len = ul_len;
+		break;
+	case USB_CDC_RX:
+		if (TEST_CHECK(gs_cdc.ul_rx_len + ul_len <= sizeof(gs_cdc.uc_rx))) {
+			memcpy(&gs_cdc.uc_rx[gs_cdc.ul_rx_len], p_data, ul_len);
+			gs_cdc.ul_rx_len += ul_len;
+		}
+		gs_cdc.ul_rx_events++;
+		if (gs_cdc.b_release) {
+			usb_cdc_rx_release();
+		}
+		break;
+	}
+}
+
+/**
+ * \brief Packet size of an endpoint in a configuration descriptor, 0 if it
+ * is not there.
+ */
+static uint16_t test_ep_desc_size(const uint8_t *p_desc, uint8_t uc_addr)
+{
+	uint32_t ul_total = p_desc[2] | (p_desc[3] << 8);
+	uint32_t i;
+
+	for (i = 0; i < ul_total && p_desc[i]; i += p_desc[i]) {
+		if (p_desc[i + 1] == 5 && p_desc[i + 2] == uc_addr) {
+			return p_desc[i + 4] | (p_desc[i + 5] << 8);
+		}
+	}
+	return 0;
+}
+
+/**
+ * \brief Enumerate the CDC device as a host does, up to SET_CONFIGURATION.
+ */
+static bool test_cdc_enumerate(uint8_t uc_addr)
+{
+	uint8_t uc_desc[255];
+	uint16_t us_size = gs_host.b_high_speed ? 512 : 64;
+	int32_t l_len;
+
+	test_bus_reset();
+	if (!TEST_CHECK_EQ(test_request(USB_REQ_DIR_IN,
+			USB_REQ_GET_DESCRIPTOR, USB_DT_DEVICE << 8, 0, 64, uc_desc), 18)) {
+		return false;
+	}
+	TEST_CHECK_EQ(uc_desc[7], USBHS_DEV_EP0_SIZE);
+	TEST_CHECK_EQ(uc_desc[8] | (uc_desc[9] << 8), CONF_USB_CDC_VID);
+	TEST_CHECK_EQ(uc_desc[10] | (uc_desc[11] << 8), CONF_USB_CDC_PID);
+	if (!TEST_CHECK(test_set_address(uc_addr))) {
+		return false;
+	}
+	TEST_CHECK_EQ(test_request(USB_REQ_DIR_IN, USB_REQ_GET_DESCRIPTOR,
+			USB_DT_CONFIGURATION << 8, 0, 9, uc_desc), 9);
+	l_len = test_request(USB_REQ_DIR_IN, USB_REQ_GET_DESCRIPTOR,
+			USB_DT_CONFIGURATION << 8, 0, sizeof(uc_desc), uc_desc);
+	TEST_CHECK_EQ(l_len, 67);
+	TEST_CHECK_EQ(uc_desc[2] | (uc_desc[3] << 8), 67);
+	TEST_CHECK_EQ(test_ep_desc_size(uc_desc, USB_CDC_EP_DATA_IN), us_size);
+	TEST_CHECK_EQ(test_ep_desc_size(uc_desc, USB_CDC_EP_DATA_OUT), us_size);
+	TEST_CHECK_EQ(test_ep_desc_size(uc_desc, USB_CDC_EP_NOTIFY),
+			USB_CDC_NOTIFY_SIZE);
+	return TEST_CHECK_EQ(test_request(USB_REQ_TYPE_STANDARD,
+			USB_REQ_SET_CONFIGURATION, 1, 0, 0, NULL), 0);
+}
+
+/**
+ * \brief CDC class request to the communication interface.
+ */
+static int32_t test_cdc_request(uint8_t uc_dir, uint8_t uc_request,
+		uint16_t us_value, uint16_t us_length, void *p_data)
+{
+	return test_request(uc_dir | USB_REQ_TYPE_CLASS |
+			USB_REQ_RECIP_INTERFACE, uc_request, us_value, 0, us_length,
+			p_data);
+}
+
+static void test_cdc_enumeration(void)
+{
+	static const uint8_t uc_coding[USB_CDC_LINE_CODING_SIZE] = {
+		0x00, 0x10, 0x0E, 0x00, 0, 0, 8,
+	};
+	usb_cdc_stats_t stats;
+	uint8_t uc_desc[255];
+	int32_t l_len;
+
+	test_model_reset();
+	TEST_CHECK(!usb_cdc_get_stats(&stats));
+	TEST_CHECK(usb_cdc_init(test_cdc_event, &gs_cdc));
+	TEST_CHECK(!usb_cdc_init(test_cdc_event, &gs_cdc));
+	TEST_CHECK(host_nvic.uc_enabled[USBHS_IRQn]);
+	TEST_CHECK(!(USBHS->USBHS_DEVCTRL & USBHS_DEVCTRL_DETACH));
+	TEST_CHECK(gs_p_rx_buf && dma_buf_is_coherent(gs_p_rx_buf));
+
+	TEST_CHECK(test_cdc_enumerate(7));
+	TEST_CHECK(usb_cdc_get_stats(&stats));
+	TEST_CHECK(stats.b_high_speed);
+	TEST_CHECK(stats.b_configured);
+	TEST_CHECK(!stats.b_open);
+	TEST_CHECK_EQ(stats.ul_resets, 1);
+	TEST_CHECK_EQ(USBHS->USBHS_DEVEPT, USBHS_DEVEPT_EPEN0 |
+			USBHS_DEVEPT_EPEN1 | USBHS_DEVEPT_EPEN2 | USBHS_DEVEPT_EPEN3);
+	TEST_CHECK_EQ(test_request(USB_REQ_DIR_IN, USB_REQ_GET_CONFIGURATION,
+			0, 0, 1, uc_desc), 1);
+	TEST_CHECK_EQ(uc_desc[0], 1);
+
+	/* The other descriptors. */
+	TEST_CHECK_EQ(test_request(USB_REQ_DIR_IN, USB_REQ_GET_DESCRIPTOR,
+			USB_DT_DEVICE_QUALIFIER << 8, 0, sizeof(uc_desc), uc_desc), 10);
+	l_len = test_request(USB_REQ_DIR_IN, USB_REQ_GET_DESCRIPTOR,
+			USB_DT_OTHER_SPEED << 8, 0, sizeof(uc_desc), uc_desc);
+	TEST_CHECK_EQ(l_len, 67);
+	TEST_CHECK_EQ(uc_desc[1], USB_DT_OTHER_SPEED);
+	TEST_CHECK_EQ(test_ep_desc_size(uc_desc, USB_CDC_EP_DATA_IN), 64);
+	TEST_CHECK_EQ(test_request(USB_REQ_DIR_IN, USB_REQ_GET_DESCRIPTOR,
+			USB_DT_STRING << 8, 0, sizeof(uc_desc), uc_desc), 4);
+	l_len = test_request(USB_REQ_DIR_IN, USB_REQ_GET_DESCRIPTOR,
+			(USB_DT_STRING << 8) | 2, 0x0409, sizeof(uc_desc), uc_desc);
+	TEST_CHECK_EQ(l_len, 2 + 2 * strlen(CONF_USB_CDC_PRODUCT));
+	TEST_CHECK_EQ(uc_desc[2], CONF_USB_CDC_PRODUCT[0]);
+	TEST_CHECK_EQ(test_request(USB_REQ_DIR_IN, USB_REQ_GET_DESCRIPTOR,
+			(USB_DT_STRING << 8) | 4, 0x0409, sizeof(uc_desc), uc_desc),
+			TEST_STALLED);
+	TEST_CHECK_EQ(test_request(USB_REQ_TYPE_STANDARD,
+			USB_REQ_SET_CONFIGURATION, 2, 0, 0, NULL), TEST_STALLED);
+	TEST_CHECK_EQ(test_request(USB_REQ_TYPE_CLASS | 0x40, 1, 0, 0, 0,
+			NULL), TEST_STALLED);
+
+	/* Line coding: kept and given back, the data rate does not care. */
+	TEST_CHECK_EQ(test_cdc_request(0, USB_CDC_SET_LINE_CODING, 0,
+			sizeof(uc_coding), (void *)uc_coding), sizeof(uc_coding));
+	TEST_CHECK_EQ(test_cdc_request(USB_REQ_DIR_IN, USB_CDC_GET_LINE_CODING,
+			0, sizeof(uc_coding), uc_desc), sizeof(uc_coding));
+	TEST_CHECK(!memcmp(uc_desc, uc_coding, sizeof(uc_coding)));
+	usb_cdc_get_stats(&stats);
+	TEST_CHECK_EQ(stats.ul_baudrate, 921600);
+
+	/* The port opens with DTR. */
+	TEST_CHECK_EQ(test_cdc_request(0, USB_CDC_SET_CONTROL_LINE_STATE,
+			USB_CDC_DTR, 0, NULL), 0);
+	TEST_CHECK_EQ(gs_cdc.ul_opens, 1);
+	TEST_CHECK(usb_cdc_is_open());
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+static void test_cdc_data(void)
+{
+	static uint8_t uc_buf[4096];
+	usb_cdc_stats_t stats;
+	uint8_t uc_status[2];
+	uint32_t ul_n;
+
+	/* Writes: short packet at the end, or an empty one. */
+	test_fill(gs_uc_tx, 4096, 5);
+	TEST_CHECK(!usb_cdc_write(gs_uc_tx, 0));
+	TEST_CHECK(!usb_cdc_write(gs_uc_tx, USBHS_DEV_XFER_MAX + 1));
+	TEST_CHECK(usb_cdc_write(gs_uc_tx, 1000));
+	TEST_CHECK(!usb_cdc_write(gs_uc_tx, 10));
+	TEST_CHECK_EQ(test_read(1, uc_buf, sizeof(uc_buf)), 1000);
+	TEST_CHECK(!memcmp(uc_buf, gs_uc_tx, 1000));
+	TEST_CHECK_EQ(gs_cdc.ul_tx_done, 1);
+	TEST_CHECK(gs_cdc.p_tx == gs_uc_tx);
+	TEST_CHECK_EQ(gs_cdc.ul_tx_len, 1000);
+	TEST_CHECK(usb_cdc_write(&gs_uc_tx[1000], 1024));
+	TEST_CHECK_EQ(test_read(1, uc_buf, 1024), 1024);
+	TEST_CHECK_EQ(test_read(1, uc_buf, sizeof(uc_buf)), 0);
+	TEST_CHECK_EQ(gs_cdc.ul_tx_done, 2);
+	TEST_CHECK_EQ(gs_cdc.ul_tx_len, 1024);
+
+	/* Reads: the buffer is held until given back, the banks take what
+	 * they can meanwhile, then the host waits. */
+	gs_cdc.b_release = false;
+	TEST_CHECK(test_write(2, gs_uc_tx, 100, true));
+	TEST_CHECK_EQ(gs_cdc.ul_rx_events, 1);
+	TEST_CHECK(test_write(2, &gs_uc_tx[100], 512 * CONF_USB_CDC_BANKS,
+			false));
+	TEST_CHECK_EQ(test_bus_out(2, &gs_uc_tx[100 + 512 * CONF_USB_CDC_BANKS],
+			512), TEST_NAK);
+	TEST_CHECK_EQ(gs_cdc.ul_rx_events, 1);
+	for (ul_n = 0; ul_n < CONF_USB_CDC_BANKS; ul_n++) {
+		usb_cdc_rx_release();
+		test_tick();
+		TEST_CHECK_EQ(gs_cdc.ul_rx_events, 2 + ul_n);
+	}
+	gs_cdc.b_release = true;
+	usb_cdc_rx_release();
+	TEST_CHECK(test_write(2, &gs_uc_tx[100 + 512 * CONF_USB_CDC_BANKS], 300,
+			true));
+	TEST_CHECK_EQ(gs_cdc.ul_rx_len, 400 + 512 * CONF_USB_CDC_BANKS);
+	TEST_CHECK(!memcmp(gs_cdc.uc_rx, gs_uc_tx, gs_cdc.ul_rx_len));
+	/* An empty packet after a full buffer: nothing to pass on, the
+	 * reads go on. */
+	gs_cdc.ul_rx_len = 0;
+	TEST_CHECK(test_write(2, gs_uc_tx, CONF_USB_CDC_RX_SIZE, true));
+	TEST_CHECK(test_write(2, gs_uc_tx, 20, true));
+	TEST_CHECK_EQ(gs_cdc.ul_rx_len, CONF_USB_CDC_RX_SIZE + 20);
+	usb_cdc_get_stats(&stats);
+	TEST_CHECK_EQ(stats.ul_rx_bytes, 420 + 512 * CONF_USB_CDC_BANKS +
+			CONF_USB_CDC_RX_SIZE);
+	TEST_CHECK_EQ(stats.ul_tx_bytes, 2024);
+
+	/* Halt of the IN endpoint, and back. */
+	TEST_CHECK(usb_cdc_write(gs_uc_tx, 512));
+	TEST_CHECK_EQ(test_read(1, uc_buf, 512), 512);
+	TEST_CHECK_EQ(test_request(USB_REQ_RECIP_ENDPOINT,
+			USB_REQ_SET_FEATURE, USB_EP_FEATURE_HALT, USB_CDC_EP_DATA_IN, 0,
+			NULL), 0);
+	TEST_CHECK_EQ(test_request(USB_REQ_DIR_IN | USB_REQ_RECIP_ENDPOINT,
+			USB_REQ_GET_STATUS, 0, USB_CDC_EP_DATA_IN, 2, uc_status), 2);
+	TEST_CHECK_EQ(uc_status[0], 1);
+	TEST_CHECK_EQ(test_read(1, uc_buf, 512), -1);
+	TEST_CHECK_EQ(test_request(USB_REQ_RECIP_ENDPOINT,
+			USB_REQ_CLEAR_FEATURE, USB_EP_FEATURE_HALT, USB_CDC_EP_DATA_IN,
+			0, NULL), 0);
+	gs_host.uc_toggle[1] = 0;
+	TEST_CHECK_EQ(test_request(USB_REQ_DIR_IN | USB_REQ_RECIP_ENDPOINT,
+			USB_REQ_GET_STATUS, 0, USB_CDC_EP_DATA_IN, 2, uc_status), 2);
+	TEST_CHECK_EQ(uc_status[0], 0);
+	TEST_CHECK_EQ(test_read(1, uc_buf, 512), 0);
+	TEST_CHECK(usb_cdc_write(gs_uc_tx, 10));
+	TEST_CHECK_EQ(test_read(1, uc_buf, 512), 10);
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+static void test_cdc_close(void)
+{
+	usb_cdc_stats_t stats;
+	uint32_t ul_n;
+
+	/* DTR cleared: closed, nothing to write to. */
+	TEST_CHECK_EQ(test_cdc_request(0, USB_CDC_SET_CONTROL_LINE_STATE, 0, 0,
+			NULL), 0);
+	TEST_CHECK_EQ(gs_cdc.ul_closes, 1);
+	TEST_CHECK(!usb_cdc_write(gs_uc_tx, 10));
+	TEST_CHECK_EQ(test_cdc_request(0, USB_CDC_SET_CONTROL_LINE_STATE,
+			USB_CDC_DTR, 0, NULL), 0);
+	TEST_CHECK_EQ(gs_cdc.ul_opens, 2);
+
+	/* A suspend closes it, a write in progress dropped; the resume opens
+	 * it again. */
+	TEST_CHECK(usb_cdc_write(gs_uc_tx, 4096));
+	TEST_CHECK_EQ(test_host_in(1, gs_uc_rx, &ul_n), TEST_ACK);
+	gs_model.ul_devisr |= USBHS_DEVISR_SUSP;
+	test_usbhs_irq();
+	TEST_CHECK_EQ(gs_cdc.ul_closes, 2);
+	TEST_CHECK(!usb_cdc_is_open());
+	TEST_CHECK_EQ(gs_cdc.ul_tx_done, 4);
+	gs_model.ul_devisr |= USBHS_DEVISR_WAKEUP;
+	test_usbhs_irq();
+	TEST_CHECK_EQ(gs_cdc.ul_opens, 3);
+	TEST_CHECK_EQ(test_bus_in(1, gs_uc_rx, &ul_n), TEST_NAK);
+	TEST_CHECK(usb_cdc_write(gs_uc_tx, 10));
+	TEST_CHECK_EQ(test_read(1, gs_uc_rx, 512), 10);
+
+	/* A bus reset closes and unconfigures it. */
+	test_bus_reset();
+	TEST_CHECK_EQ(gs_cdc.ul_closes, 3);
+	usb_cdc_get_stats(&stats);
+	TEST_CHECK(!stats.b_configured);
+	TEST_CHECK_EQ(stats.ul_resets, 2);
+	TEST_CHECK_EQ(stats.ul_suspends, 1);
+	TEST_CHECK_EQ(USBHS->USBHS_DEVEPT, USBHS_DEVEPT_EPEN0);
+
+	/* Full speed host: 64 byte packets. */
+	gs_host.b_high_speed = false;
+	TEST_CHECK(test_cdc_enumerate(9));
+	usb_cdc_get_stats(&stats);
+	TEST_CHECK(!stats.b_high_speed);
+	TEST_CHECK_EQ(test_cdc_request(0, USB_CDC_SET_CONTROL_LINE_STATE,
+			USB_CDC_DTR, 0, NULL), 0);
+	TEST_CHECK_EQ(gs_cdc.ul_opens, 4);
+	TEST_CHECK(usb_cdc_write(gs_uc_tx, 100));
+	TEST_CHECK_EQ(test_host_in(1, gs_uc_rx, &ul_n), TEST_ACK);
+	TEST_CHECK_EQ(ul_n, 64);
+	TEST_CHECK_EQ(test_host_in(1, gs_uc_rx, &ul_n), TEST_ACK);
+	TEST_CHECK_EQ(ul_n, 36);
+	gs_cdc.ul_rx_len = 0;
+	TEST_CHECK(test_write(2, gs_uc_tx, 200, true));
+	TEST_CHECK_EQ(gs_cdc.ul_rx_len, 200);
+	TEST_CHECK_EQ(gs_model.ul_faults, 0);
+}
+
+/** Benchmark stream. */
+static struct {
+	uint8_t uc_ep;
+	uint32_t ul_xfer;
+	/** Bytes started and done by the device, and checked by the host. */
+	uint32_t ul_started;
+	uint32_t ul_done;
+	uint32_t ul_checked;
+	uint32_t ul_xfers;
+	uint32_t ul_bad;
+} gs_bench;
+
+/**
+ * \brief Byte \a ul_pos of the benchmark stream.
+ */
+static inline uint8_t test_bench_byte(uint32_t ul_pos)
+{
+	return (uint8_t)(ul_pos ^ (ul_pos >> 9));
+}
+
+/**
+ * \brief Start the next benchmark transfer: IN from the stream, or OUT
+ * into a buffer.
+ */
+static void test_bench_start(void)
+{
+	uint8_t *p_buf = gs_bench.uc_ep == 1 ? gs_uc_tx : gs_uc_rx;
+	uint32_t i;
+
+	if (gs_bench.uc_ep == 1) {
+		for (i = 0; i < gs_bench.ul_xfer; i++) {
+			p_buf[i] = test_bench_byte(gs_bench.ul_started + i);
+		}
+	}
+	if (usbhs_dev_ep_start(&gs_drv.dev, gs_bench.uc_ep, p_buf,
+			gs_bench.ul_xfer, false) == STATUS_OK) {
+		gs_bench.ul_started += gs_bench.ul_xfer;
+	}
+}
+
+static void test_bench_event(usbhs_dev_t *p_dev, usbhs_dev_event_t event,
+		uint8_t uc_ep, uint32_t ul_arg)
+{
+	uint32_t i;
+
+	if (event != USBHS_DEV_EP_DONE) {
+		return;
+	}
+	if (uc_ep == 2) {
+		for (i = 0; i < ul_arg; i++) {
+			if (gs_uc_rx[i] != test_bench_byte(gs_bench.ul_done + i)) {
+				gs_bench.ul_bad++;
+			}
+		}
+	}
+	gs_bench.ul_done += ul_arg;
+	gs_bench.ul_xfers++;
+	test_bench_start();
+}
+
+/**
+ * \brief Stream through one endpoint, the DMA as fast as the bus: with one
+ * bank they take turns, with two or more they overlap.
+ */
+static void test_bench(void)
+{
+	static const struct {
+		const char *p_name;
+		uint8_t uc_ep;
+		uint8_t uc_banks;
+		uint32_t ul_xfer;
+	} modes[] = {
+		{"in, 1 bank, 4 KB", 1, 1, 4096},
+		{"in, 2 banks, 4 KB", 1, 2, 4096},
+		{"in, 3 banks, 4 KB", 1, 3, 4096},
+		{"in, 2 banks, 32 KB", 1, 2, 32768},
+		{"out, 1 bank, 4 KB", 2, 1, 4096},
+		{"out, 2 banks, 4 KB", 2, 2, 4096},
+		{"out, 2 banks, 32 KB", 2, 2, 32768},
+	};
+	const uint32_t ul_total = 16u << 20;
+	uint8_t uc_packet[512];
+	uint32_t i, m, ul_n, ul_ticks, ul_irqs, ul_packets, ul_pos;
+	double d_start, d_seconds, d_use;
+	test_bus_t result;
+
+	printf("%-22s %9s %9s %9s\n", "usbhs stream", "pkt/tick", "irq/xfer",
+			"MB/s");
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		if (!TEST_CHECK(test_drv_start(true))) {
+			return;
+		}
+		gs_drv.dev.callback = test_bench_event;
+		usbhs_dev_ep_configure(&gs_drv.dev, 1 | USB_EP_DIR_IN,
+				USBHS_EP_BULK, 512, modes[m].uc_banks);
+		usbhs_dev_ep_configure(&gs_drv.dev, 2, USBHS_EP_BULK, 512,
+				modes[m].uc_banks);
+		memset(&gs_bench, 0, sizeof(gs_bench));
+		gs_bench.uc_ep = modes[m].uc_ep;
+		gs_bench.ul_xfer = modes[m].ul_xfer;
+		gs_model.ul_dma_rate = 512;
+		test_bench_start();
+
+		ul_ticks = gs_model.ul_ticks;
+		ul_irqs = gs_model.ul_irqs;
+		ul_packets = gs_model.ul_packets;
+		ul_pos = 0;
+		d_start = test_seconds();
+		for (i = 0; ul_pos < ul_total && i < 4 * ul_total / 512; i++) {
+			if (gs_bench.uc_ep == 1) {
+				result = test_bus_in(1, uc_packet, &ul_n);
+				if (result == TEST_ACK) {
+					while (ul_n--) {
+						if (uc_packet[ul_n] != test_bench_byte(ul_pos + ul_n)) {
+							gs_bench.ul_bad++;
+						}
+					}
+					ul_pos += 512;
+				}
+			} else {
+				for (ul_n = 0; ul_n < 512; ul_n++) {
+					uc_packet[ul_n] = test_bench_byte(ul_pos + ul_n);
+				}
+				if (test_bus_out(2, uc_packet, 512) == TEST_ACK) {
+					ul_pos += 512;
+				}
+			}
+		}
+		d_seconds = test_seconds() - d_start;
+		ul_ticks = gs_model.ul_ticks - ul_ticks;
+		ul_packets = gs_model.ul_packets - ul_packets;
+		d_use = (double)ul_packets / ul_ticks;
+
+		printf("%-22s %9.2f %9.2f %9.1f\n", modes[m].p_name, d_use,
+				(double)(gs_model.ul_irqs - ul_irqs) / gs_bench.ul_xfers,
+				ul_total / d_seconds / 1e6);
+		TEST_CHECK_EQ(ul_pos, ul_total);
+		TEST_CHECK_EQ(gs_bench.ul_bad, 0);
+		TEST_CHECK(gs_bench.ul_done >= ul_total - gs_bench.ul_xfer);
+		/* One interrupt per transfer, the end of its DMA. */
+		TEST_CHECK(gs_model.ul_irqs - ul_irqs <= gs_bench.ul_xfers + 1);
+		if (modes[m].uc_banks == 1) {
+			TEST_CHECK(d_use < 0.51);
+		} else {
+			TEST_CHECK(d_use > 0.95);
+		}
+		TEST_CHECK_EQ(gs_model.ul_faults, 0);
+	}
+}
+
+int main(void)
+{
+	struct sigaction action;
+	void *p_regs, *p_fifo;
+	uint8_t uc_banks;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_flags = SA_SIGINFO;
+	action.sa_sigaction = test_trap_segv;
+	sigaction(SIGSEGV, &action, NULL);
+	action.sa_sigaction = test_trap_step;
+	sigaction(SIGTRAP, &action, NULL);
+	p_regs = mmap((void *)TEST_USBHS_ADDR, TEST_REGS_SIZE, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	p_fifo = mmap((void *)USBHS_RAM_ADDR, TEST_FIFO_SIZE, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	if (!TEST_CHECK(p_regs == (void *)TEST_USBHS_ADDR) ||
+			!TEST_CHECK(p_fifo == (void *)USBHS_RAM_ADDR) ||
+			!TEST_CHECK(sizeof(Usbhs) <= TEST_REGS_SIZE)) {
+		return test_end("usbhs");
+	}
+	/* The UPLL locks at once. */
+	HOST_REG(PMC->PMC_SR) = PMC_SR_LOCKU;
+	dma_buf_init();
+
+	test_init();
+	test_control_requests();
+	test_endpoints();
+	for (uc_banks = 1; uc_banks <= 3; uc_banks++) {
+		test_in(uc_banks);
+		test_out(uc_banks);
+	}
+	gs_cdc.b_release = true;
+	test_cdc_enumeration();
+	test_cdc_data();
+	test_cdc_close();
+	test_bench();
+	return test_end("usbhs");
+}
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Generate the perfect hash table of the console shell commands.
+
+Reads the SHELL_CMD(name, help) entries of src/shell/shell_cmds.def, searches
+a seed for which the seeded FNV-1a hash of shell.c maps every command name to
+a distinct slot, and writes src/shell/shell_cmd_table.h. Run it again after
+editing shell_cmds.def.
+
+usage: gen_shell_table.py [DEF_FILE [OUT_FILE]]
+"""
+
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEF_FILE = os.path.join(HERE, "..", "src", "shell", "shell_cmds.def")
+OUT_FILE = os.path.join(HERE, "..", "src", "shell", "shell_cmd_table.h")
+
+
+def shell_hash(name, seed):
+    """Must match shell_hash() in shell.c."""
+    h = seed
+    for c in name.encode("ascii"):
+        h ^= c
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h ^ (h >> 16)
+
+
+def main():
+    def_file = sys.argv[1] if len(sys.argv) > 1 else DEF_FILE
+    out_file = sys.argv[2] if len(sys.argv) > 2 else OUT_FILE
+
+    with open(def_file) as f:
+        names = re.findall(r"^SHELL_CMD\(\s*(\w+)\s*,", f.read(), re.M)
+    if not names or len(names) > 127:
+        sys.exit("expected 1 to 127 commands in %s" % def_file)
+
+    size = 1
+    while size < 2 * len(names):
+        size *= 2
+
+    for seed in range(0x811C9DC5, 0x811C9DC5 + 1000000):
+        slots = [-1] * size
+        for index, name in enumerate(names):
+            slot = shell_hash(name, seed) & (size - 1)
+            if slots[slot] >= 0:
+                break
+            slots[slot] = index
+        else:
+            break
+    else:
+        sys.exit("no perfect hash seed found")
+
+    rows = []
+    for i in range(0, size, 8):
+        rows.append("\t" + ", ".join("%d" % s for s in slots[i:i + 8]))
+
+    with open(out_file, "w") as f:
+        f.write("""/**
+ * \\file
+ *
+ * \\brief Perfect hash table of the console shell commands.
+ *
+ * Generated by tools/gen_shell_table.py from shell_cmds.def, do not edit.
+ *
+ */
+
+#ifndef SHELL_CMD_TABLE_H_INCLUDED
+#define SHELL_CMD_TABLE_H_INCLUDED
+
+/** Seed of the command name hash. */
+#define SHELL_HASH_SEED    0x%08Xu
+
+/** Number of hash slots, power of two. */
+#define SHELL_HASH_SIZE    %d
+
+/** Number of commands in shell_cmds.def. */
+#define SHELL_CMD_COUNT    %d
+
+/** Index in shell_cmds.def of the command hashed to each slot, or -1. */
+static const int8_t gs_shell_slots[SHELL_HASH_SIZE] = {
+%s
+};
+
+#endif /* SHELL_CMD_TABLE_H_INCLUDED */
+""" % (seed, size, len(names), ",\n".join(rows)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+"""Decode the binary telemetry stream of the console USART.
+
+Reads either a serial port (requires pyserial) or a capture file, splits the
+stream on 0x00 delimiters, COBS-decodes and CRC-checks every frame, reports
+sequence gaps and prints the records. Text written with printf() between
+frames is passed through to stderr.
+
+The frame layout is documented in src/telemetry/telemetry.h.
+
+usage: tlm_decode.py [--baud 115200] PORT_OR_FILE
+"""
+
+import argparse
+import binascii
+import struct
+import sys
+
+TLM_HEADER_SIZE = 8
+TLM_FLAG_CRC32 = 0x01
+
+TYPE_NAMES = {
+    0x00: "raw",
+    0x01: "samples_i16",
+    0x02: "samples_i32",
+    0x03: "samples_f32",
+    0x04: "counter",
+    0x05: "heap",
+}
+
+
+def crc16_x25(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+    return crc ^ 0xFFFF
+
+
+def cobs_decode(block):
+    out = bytearray()
+    i = 0
+    while i < len(block):
+        code = block[i]
+        i += 1
+        if code == 0 or i + code - 1 > len(block):
+            return None
+        out += block[i:i + code - 1]
+        i += code - 1
+        if code != 0xFF and i < len(block):
+            out.append(0)
+    return bytes(out)
+
+
+def parse_frame(frame):
+    """Return (type, seq, timestamp, payload) or None if the frame is bad."""
+    if len(frame) < TLM_HEADER_SIZE + 2:
+        return None
+    rtype, flags, seq, stamp = struct.unpack_from("<BBHI", frame)
+    if flags & TLM_FLAG_CRC32:
+        body, crc = frame[:-4], struct.unpack("<I", frame[-4:])[0]
+        if binascii.crc32(body) & 0xFFFFFFFF != crc:
+            return None
+    else:
+        body, crc = frame[:-2], struct.unpack("<H", frame[-2:])[0]
+        if crc16_x25(body) != crc:
+            return None
+    return rtype, seq, stamp, body[TLM_HEADER_SIZE:]
+
+
+def format_payload(rtype, payload):
+    if rtype in (0x01, 0x02, 0x03) and len(payload) >= 2:
+        fmt = {0x01: "h", 0x02: "i", 0x03: "f"}[rtype]
+        n = (len(payload) - 2) // struct.calcsize(fmt)
+        values = struct.unpack_from("<%d%s" % (n, fmt), payload, 2)
+        return "ch=%d %s" % (payload[0], list(values))
+    if rtype == 0x04 and len(payload) == 6:
+        return "id=%d value=%d" % struct.unpack("<HI", payload)
+    if rtype == 0x05 and len(payload) == 10:
+        return "id=%d used=%d free=%d" % struct.unpack("<HII", payload)
+    return payload.hex()
+
+
+class Decoder:
+    def __init__(self, out=sys.stdout, text=sys.stderr):
+        self.out = out
+        self.text = text
+        self.pending = bytearray()
+        self.next_seq = None
+        self.frames = 0
+        self.lost = 0
+        self.bad = 0
+
+    def feed(self, data):
+        self.pending += data
+        while True:
+            end = self.pending.find(0)
+            if end < 0:
+                return
+            chunk = bytes(self.pending[:end])
+            del self.pending[:end + 1]
+            self.handle(chunk)
+
+    def handle(self, chunk):
+        if not chunk:
+            return
+        frame = cobs_decode(chunk)
+        record = parse_frame(frame) if frame else None
+        if record is None:
+            # Either console text preceding a frame or a corrupted frame.
+            printable = all(32 <= b < 127 or b in (9, 10, 13) for b in chunk)
+            if printable:
+                self.text.write(chunk.decode("ascii"))
+            else:
+                self.bad += 1
+            return
+        rtype, seq, stamp, payload = record
+        if self.next_seq is not None and seq != self.next_seq:
+            gap = (seq - self.next_seq) & 0xFFFF
+            self.lost += gap
+            self.out.write("# lost %d frame(s) before seq %d\n" % (gap, seq))
+        self.next_seq = (seq + 1) & 0xFFFF
+        self.frames += 1
+        self.out.write("%5d %10d %-12s %s\n" % (
+            seq, stamp, TYPE_NAMES.get(rtype, "type_%02x" % rtype),
+            format_payload(rtype, payload)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", help="serial port or capture file")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    decoder = Decoder()
+    try:
+        if args.source.startswith(("/dev/", "COM")):
+            import serial
+            with serial.Serial(args.source, args.baud, timeout=0.1) as port:
+                while True:
+                    decoder.feed(port.read(4096))
+        else:
+            with open(args.source, "rb") as capture:
+                decoder.feed(capture.read())
+    except KeyboardInterrupt:
+        pass
+    sys.stderr.write("\n%d frames, %d lost, %d corrupted\n" % (
+        decoder.frames, decoder.lost, decoder.bad))
+
+
+if __name__ == "__main__":
+    main()